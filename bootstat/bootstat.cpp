@@ -26,6 +26,7 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
 #include <iterator>
 #include <map>
@@ -620,6 +621,29 @@ class pstoreConsole {
     return count;
   }
 
+  // numError above checks the running error count from the end of the needle,
+  // and after 8 bytes allows at most 8 bit errors. So if the last 8 bytes at
+  // pos differ from the needle's by more than 8 bits in total, there is no
+  // match. This check is a lot cheaper than numError, and it rejects most
+  // positions during the fuzzy scans over the whole console.
+  static constexpr size_t kTailLength = sizeof(uint64_t);
+
+  static uint64_t tail(const char* s, size_t length) {
+    uint64_t word;
+    memcpy(&word, s + length - kTailLength, kTailLength);
+    return word;
+  }
+
+  bool mayMatch(size_t pos, const std::string& needle, uint64_t needle_tail) const {
+    if (needle.length() < kTailLength) return true;
+    uint64_t console_tail = tail(console.c_str() + pos, needle.length());
+    return std::bitset<64>(console_tail ^ needle_tail).count() <= kTailLength;
+  }
+
+  static uint64_t needleTail(const std::string& needle) {
+    return (needle.length() < kTailLength) ? 0 : tail(needle.c_str(), needle.length());
+  }
+
  public:
   explicit pstoreConsole(const std::string& console) : console(console) {}
   // scope of argument must be equal to or greater than scope of pstoreConsole
@@ -627,21 +651,27 @@ class pstoreConsole {
   explicit pstoreConsole(std::string&& console) = delete;
 
   // Our implementation of rfind, use exact match first, then resort to fuzzy.
+  // Both are looked for in the same pass from the end of the console.
   size_t rfind(const std::string& needle) const {
-    size_t pos = console.rfind(needle);  // exact match?
-    if (pos != std::string::npos) return pos;
-
     // Check to make sure needle fits in console string.
-    pos = console.length();
+    size_t pos = console.length();
     if (needle.length() > pos) return std::string::npos;
     pos -= needle.length();
-    // fuzzy match to maximum kBitErrorRate
+    // fuzzy match to maximum kBitErrorRate, unless there's an exact match
+    // further back.
+    size_t fuzzy_pos = std::string::npos;
+    const uint64_t needle_tail = needleTail(needle);
     for (;;) {
-      if (numError(pos, needle) != std::string::npos) return pos;
+      if (mayMatch(pos, needle, needle_tail)) {
+        if (console.compare(pos, needle.length(), needle) == 0) return pos;
+        if ((fuzzy_pos == std::string::npos) && (numError(pos, needle) != std::string::npos)) {
+          fuzzy_pos = pos;
+        }
+      }
       if (pos == 0) break;
       --pos;
     }
-    return std::string::npos;
+    return fuzzy_pos;
   }
 
   // Our implementation of find, use only fuzzy match.
@@ -650,8 +680,11 @@ class pstoreConsole {
     if (needle.length() > console.length()) return std::string::npos;
     const size_t last_pos = console.length() - needle.length();
     // fuzzy match to maximum kBitErrorRate
+    const uint64_t needle_tail = needleTail(needle);
     for (size_t pos = start; pos <= last_pos; ++pos) {
-      if (numError(pos, needle) != std::string::npos) return pos;
+      if (mayMatch(pos, needle, needle_tail) && numError(pos, needle) != std::string::npos) {
+        return pos;
+      }
     }
     return std::string::npos;
   }
@@ -1163,6 +1196,31 @@ void RecordInitBootTimeProp(BootEventRecordStore* boot_event_store, const char*
   }
 }
 
+// Records, for every service init started, how long it took from the start
+// request to the service's execv() in microseconds.  The times come from the
+// ro.boottime.init.start.<service> properties, of the form
+// 'phase1:offset1,...,phaseN:offsetN'.
+void RecordInitServiceStartTimes(BootEventRecordStore* boot_event_store) {
+  static constexpr std::string_view prefix = "ro.boottime.init.start.";
+  property_list(
+      [](const char* key, const char* value, void* cookie) {
+        std::string_view name = key;
+        if (!android::base::StartsWith(name, prefix)) return;
+        name.remove_prefix(prefix.size());
+
+        for (const auto& phase : android::base::Split(value, ",")) {
+          auto phase_values = android::base::Split(phase, ":");
+          int32_t time_us;
+          if (phase_values.size() == 2 && phase_values[0] == "exec" &&
+              android::base::ParseInt(phase_values[1], &time_us)) {
+            static_cast<BootEventRecordStore*>(cookie)->AddBootEventWithValue(
+                "boottime.init.start." + std::string(name), time_us);
+          }
+        }
+      },
+      boot_event_store);
+}
+
 // A map from bootloader timing stage to the time that stage took during boot.
 typedef std::map<std::string, int32_t> BootloaderTimingMap;
 
@@ -1342,7 +1400,11 @@ void RecordBootComplete() {
   RecordInitBootTimeProp(&boot_event_store, "ro.boottime.init");
   RecordInitBootTimeProp(&boot_event_store, "ro.boottime.init.first_stage");
   RecordInitBootTimeProp(&boot_event_store, "ro.boottime.init.selinux");
+  RecordInitBootTimeProp(&boot_event_store, "ro.boottime.init.selinux.compile");
+  RecordInitBootTimeProp(&boot_event_store, "ro.boottime.init.selinux.read");
+  RecordInitBootTimeProp(&boot_event_store, "ro.boottime.init.selinux.load");
   RecordInitBootTimeProp(&boot_event_store, "ro.boottime.init.cold_boot_wait");
+  RecordInitServiceStartTimes(&boot_event_store);
 
   const BootloaderTimingMap bootloader_timings = GetBootLoaderTimings();
   int32_t bootloader_boot_duration = GetBootloaderTime(bootloader_timings);
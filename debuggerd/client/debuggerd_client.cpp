@@ -19,14 +19,21 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <iomanip>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <android-base/cmsg.h>
 #include <android-base/file.h>
@@ -329,3 +336,77 @@ int dump_backtrace_to_file_timeout(pid_t tid, DebuggerdDumpType dump_type, int t
 
   return ret;
 }
+
+int dump_backtraces_to_file_timeout(const std::vector<pid_t>& tids, DebuggerdDumpType dump_type,
+                                    int timeout_secs, unsigned int max_parallel, int fd) {
+  struct Result {
+    bool done = false;
+    bool ok = false;
+    unique_fd output;
+  };
+  std::vector<Result> results(tids.size());
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  // Each dump goes to its own memfd, so that the output of processes being dumped at the same
+  // time isn't interleaved.
+  std::atomic<size_t> next = 0;
+  auto worker = [&]() {
+    for (size_t i = next++; i < tids.size(); i = next++) {
+      unique_fd output(memfd_create("debuggerd_backtrace", MFD_CLOEXEC));
+      bool ok = false;
+      if (output == -1) {
+        PLOG(ERROR) << TAG "failed to create memfd for pid " << tids[i];
+      } else {
+        ok = dump_backtrace_to_file_timeout(tids[i], dump_type, timeout_secs, output.get()) == 0;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      results[i].done = true;
+      results[i].ok = ok;
+      results[i].output = std::move(output);
+      cv.notify_all();
+    }
+  };
+
+  size_t workers = std::clamp<size_t>(max_parallel, 1, std::max<size_t>(tids.size(), 1));
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+
+  // Copy the results out in order as they finish, so the caller sees progress as it happens.
+  int failures = 0;
+  for (size_t i = 0; i < tids.size(); ++i) {
+    unique_fd output;
+    bool ok;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return results[i].done; });
+      output = std::move(results[i].output);
+      ok = results[i].ok;
+    }
+
+    if (!ok) {
+      ++failures;
+    }
+    if (output == -1) {
+      continue;
+    }
+
+    char buf[BUFSIZ];
+    ssize_t rc;
+    lseek(output.get(), 0, SEEK_SET);
+    while ((rc = TEMP_FAILURE_RETRY(read(output.get(), buf, sizeof(buf)))) > 0) {
+      if (!android::base::WriteFully(fd, buf, rc)) {
+        PLOG(WARNING) << TAG "failed to write backtrace of pid " << tids[i];
+        break;
+      }
+    }
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return failures;
+}
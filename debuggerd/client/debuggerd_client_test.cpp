@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <sys/eventfd.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include <chrono>
@@ -134,3 +135,47 @@ TEST(debuggerd_client, no_timeout) {
   ASSERT_TRUE(
       debuggerd_trigger_dump(forkpid, kDebuggerdNativeBacktrace, 0, std::move(output_write)));
 }
+
+TEST(debuggerd_client, batch) {
+  constexpr size_t kProcessCount = 8;
+
+  unique_fd pipe_read, pipe_write;
+  ASSERT_TRUE(Pipe(&pipe_read, &pipe_write));
+
+  std::vector<pid_t> pids;
+  for (size_t i = 0; i < kProcessCount; ++i) {
+    pid_t forkpid = fork();
+    ASSERT_NE(-1, forkpid);
+    if (forkpid == 0) {
+      pipe_write.reset();
+      char dummy;
+      TEMP_FAILURE_RETRY(read(pipe_read.get(), &dummy, sizeof(dummy)));
+      exit(0);
+    }
+    pids.push_back(forkpid);
+  }
+  pipe_read.reset();
+
+  TemporaryFile output;
+  ASSERT_EQ(0, dump_backtraces_to_file_timeout(pids, kDebuggerdNativeBacktrace, 60, 4, output.fd));
+  pipe_write.reset();
+  for (pid_t pid : pids) {
+    ASSERT_EQ(pid, TEMP_FAILURE_RETRY(waitpid(pid, nullptr, 0)));
+  }
+
+  std::string result;
+  ASSERT_TRUE(android::base::ReadFileToString(output.path, &result));
+
+  // Every process should be dumped exactly once, in the order requested.
+  size_t pos = 0;
+  for (pid_t pid : pids) {
+    std::string begin = android::base::StringPrintf("----- pid %d at", pid);
+    std::string end = android::base::StringPrintf("----- end %d -----", pid);
+    size_t begin_pos = result.find(begin, pos);
+    ASSERT_NE(std::string::npos, begin_pos) << "\nOutput: \n" << result;
+    size_t end_pos = result.find(end, begin_pos);
+    ASSERT_NE(std::string::npos, end_pos) << "\nOutput: \n" << result;
+    EXPECT_EQ(std::string::npos, result.find(begin, end_pos));
+    pos = end_pos;
+  }
+}
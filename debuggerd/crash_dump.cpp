@@ -53,10 +53,12 @@
 #include <utils/Trace.h>
 
 #include <unwindstack/AndroidUnwinder.h>
+#include <unwindstack/Elf.h>
 #include <unwindstack/Error.h>
 #include <unwindstack/MachineArm.h>
 #include <unwindstack/MachineArm64.h>
 #include <unwindstack/MachineRiscv64.h>
+#include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
 #include <unwindstack/RegsArm.h>
 #include <unwindstack/RegsArm64.h>
@@ -767,7 +769,15 @@ int main(int argc, char** argv) {
 
   // TODO: Use seccomp to lock ourselves down.
 
-  unwindstack::AndroidRemoteUnwinder unwinder(vm_pid, unwindstack::Regs::CurrentArch());
+  // The host and guest unwinders each build their own maps. With the Elf cache enabled, a library
+  // that appears in both is only opened and parsed once.
+  unwindstack::Elf::SetCachingEnabled(true);
+
+  // Threads are unwound in parallel, so the unwinder needs a memory cache that is safe to share
+  // between them. The arch is read from the vm process, which we're already tracing.
+  std::shared_ptr<unwindstack::Memory> process_memory =
+      unwindstack::Memory::CreateProcessMemoryThreadCached(vm_pid);
+  unwindstack::AndroidRemoteUnwinder unwinder(vm_pid, process_memory);
   unwindstack::ErrorData error_data;
   if (!unwinder.Initialize(error_data)) {
     LOG(FATAL) << "Failed to initialize unwinder object: "
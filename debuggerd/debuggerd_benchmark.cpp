@@ -17,6 +17,8 @@
 #include <err.h>
 #include <errno.h>
 #include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -122,7 +124,56 @@ static void BM_maximum_pause_debuggerd(benchmark::State& state) {
   BM_maximum_pause_impl(state, []() { PerformDump(); });
 }
 
+// End-to-end latency of `debuggerd -b`: from the request until the backtrace has been written.
+static void BM_backtrace_end_to_end(benchmark::State& state) {
+  for (auto _ : state) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    PerformDump();
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - begin;
+    state.SetIterationTime(elapsed.count());
+  }
+}
+
+// Time from a child raising a fatal signal until it is reaped. The signal handler doesn't return
+// until crash_dump has finished, so with the debuggerd handler this is the time until the
+// tombstone is written.
+static void CrashChild(benchmark::State& state, bool use_debuggerd_handler) {
+  for (auto _ : state) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    pid_t forkpid = fork();
+    if (forkpid == -1) {
+      err(1, "fork failed");
+    } else if (forkpid == 0) {
+      if (!use_debuggerd_handler) {
+        signal(SIGABRT, SIG_DFL);
+      }
+      abort();
+    }
+
+    int status;
+    if (waitpid(forkpid, &status, 0) == -1) {
+      err(1, "waitpid failed");
+    } else if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGABRT) {
+      errx(1, "child didn't die from SIGABRT (status = %d)", status);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - begin;
+    state.SetIterationTime(elapsed.count());
+  }
+}
+
+// Baseline for BM_native_crash_end_to_end: the same fork and abort, without a dump.
+static void BM_native_crash_no_handler(benchmark::State& state) {
+  CrashChild(state, false);
+}
+
+static void BM_native_crash_end_to_end(benchmark::State& state) {
+  CrashChild(state, true);
+}
+
 BENCHMARK(BM_maximum_pause_noop)->Iterations(128)->UseManualTime();
 BENCHMARK(BM_maximum_pause_debuggerd)->Iterations(128)->UseManualTime();
+BENCHMARK(BM_backtrace_end_to_end)->Iterations(32)->UseManualTime();
+BENCHMARK(BM_native_crash_no_handler)->Iterations(32)->UseManualTime();
+BENCHMARK(BM_native_crash_end_to_end)->Iterations(32)->UseManualTime();
 
 BENCHMARK_MAIN();
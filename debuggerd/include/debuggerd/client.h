@@ -20,6 +20,8 @@
 #include <sys/cdefs.h>
 #include <unistd.h>
 
+#include <vector>
+
 #include <android-base/unique_fd.h>
 
 #include "dump_type.h"
@@ -32,3 +34,9 @@ bool debuggerd_trigger_dump(pid_t tid, enum DebuggerdDumpType dump_type, unsigne
 int dump_backtrace_to_file(pid_t tid, enum DebuggerdDumpType dump_type, int output_fd);
 int dump_backtrace_to_file_timeout(pid_t tid, enum DebuggerdDumpType dump_type, int timeout_secs,
                                    int output_fd);
+
+// Dump each process in tids as dump_backtrace_to_file_timeout does, with up to max_parallel dumps
+// in flight at once. Each process's output is written to output_fd in one piece, in the order of
+// tids. Returns the number of processes that failed to dump.
+int dump_backtraces_to_file_timeout(const std::vector<pid_t>& tids, enum DebuggerdDumpType dump_type,
+                                    int timeout_secs, unsigned int max_parallel, int output_fd);
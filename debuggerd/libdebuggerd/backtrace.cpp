@@ -33,6 +33,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
@@ -58,16 +59,16 @@ static void dump_process_footer(log_t* log, pid_t pid) {
   _LOG(log, logtype::BACKTRACE, "\n----- end %d -----\n", pid);
 }
 
-void dump_backtrace_thread(int output_fd, unwindstack::AndroidUnwinder* unwinder,
-                           const ThreadInfo& thread) {
+static void log_backtrace_thread(int output_fd, unwindstack::AndroidUnwinder* unwinder,
+                                 const ThreadInfo& thread, bool unwind_ret,
+                                 unwindstack::AndroidUnwinderData& data) {
   log_t log;
   log.tfd = output_fd;
   log.amfd_data = nullptr;
 
   _LOG(&log, logtype::BACKTRACE, "\n\"%s\" sysTid=%d\n", thread.thread_name.c_str(), thread.tid);
 
-  unwindstack::AndroidUnwinderData data;
-  if (!unwinder->Unwind(thread.registers.get(), data)) {
+  if (!unwind_ret) {
     _LOG(&log, logtype::THREAD, "Unwind failed: tid = %d: Error %s\n", thread.tid,
          data.GetErrorString().c_str());
     return;
@@ -76,6 +77,13 @@ void dump_backtrace_thread(int output_fd, unwindstack::AndroidUnwinder* unwinder
   log_backtrace(&log, unwinder, data, "  ");
 }
 
+void dump_backtrace_thread(int output_fd, unwindstack::AndroidUnwinder* unwinder,
+                           const ThreadInfo& thread) {
+  unwindstack::AndroidUnwinderData data;
+  bool unwind_ret = unwinder->Unwind(thread.registers.get(), data);
+  log_backtrace_thread(output_fd, unwinder, thread, unwind_ret, data);
+}
+
 void dump_backtrace(android::base::unique_fd output_fd, unwindstack::AndroidUnwinder* unwinder,
                     const std::map<pid_t, ThreadInfo>& thread_info, pid_t target_thread) {
   log_t log;
@@ -90,12 +98,23 @@ void dump_backtrace(android::base::unique_fd output_fd, unwindstack::AndroidUnwi
 
   dump_process_header(&log, target->second.pid, target->second.command_line);
 
-  dump_backtrace_thread(output_fd.get(), unwinder, target->second);
+  // Unwind everything up front, spread over a few threads, then write the backtraces out in the
+  // usual order: the target thread first, followed by the others by tid.
+  std::vector<const ThreadInfo*> threads = {&target->second};
   for (const auto& [tid, info] : thread_info) {
     if (tid != target_thread) {
-      dump_backtrace_thread(output_fd.get(), unwinder, info);
+      threads.push_back(&info);
     }
   }
+  std::vector<unwindstack::AndroidUnwinderData> data(threads.size());
+  std::unique_ptr<bool[]> unwind_ret(new bool[threads.size()]);
+  run_in_parallel(threads.size(), [&](size_t i) {
+    unwind_ret[i] = unwinder->Unwind(threads[i]->registers.get(), data[i]);
+  });
+
+  for (size_t i = 0; i < threads.size(); ++i) {
+    log_backtrace_thread(output_fd.get(), unwinder, *threads[i], unwind_ret[i], data[i]);
+  }
 
   dump_process_footer(&log, target->second.pid);
 }
@@ -33,9 +33,17 @@ struct FDInfo {
 
 using OpenFilesList = std::map<int, FDInfo>;
 
+// Tombstones list this many fds individually. Any beyond that are only counted by type; see
+// get_open_file_type().
+constexpr size_t kMaxOpenFilesListed = 1024;
+
 // Populates the given list with open files for the given process.
 void populate_open_files_list(OpenFilesList* list, pid_t pid);
 
+// Returns the kind of file |path| names, for summarizing large fd tables: "socket", "pipe", the
+// anon_inode name, the path of a device node, or "file" for anything else on a filesystem.
+std::string get_open_file_type(const std::string& path);
+
 // Populates the given list with the target process's fdsan table.
 void populate_fdsan_table(OpenFilesList* list, std::shared_ptr<unwindstack::Memory> memory,
                           uint64_t fdsan_table_address);
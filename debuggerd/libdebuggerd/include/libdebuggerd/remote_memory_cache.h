@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <unwindstack/Memory.h>
+
+// A page cache in front of the memory of a stopped process, shared by the parts of the tombstone
+// that read allocator state, the abort message and the memory around registers.
+//
+// Pages that are not cached yet are read with as few process_vm_readv calls as possible, any
+// number of ranges at a time. Pages process_vm_readv can't read are read through the backing
+// memory instead, which may fall back to ptrace. Tags are not cached.
+//
+// Not thread safe.
+class RemoteMemoryCache : public unwindstack::Memory {
+ public:
+  // Start address and size of a range of remote memory.
+  using Range = std::pair<uint64_t, size_t>;
+
+  RemoteMemoryCache(pid_t pid, std::shared_ptr<unwindstack::Memory> backing);
+  virtual ~RemoteMemoryCache() = default;
+
+  // Reads every page of |ranges| that isn't cached yet. Pages that can't be read are remembered
+  // as such, so later reads of them fail without going back to the process.
+  void Prefetch(const std::vector<Range>& ranges);
+
+  size_t Read(uint64_t addr, void* dst, size_t size) override;
+  long ReadTag(uint64_t addr) override;
+
+ private:
+  uint64_t PageStart(uint64_t addr) const { return addr & ~(uint64_t{page_size_} - 1); }
+  std::vector<uint64_t> MissingPages(const std::vector<Range>& ranges) const;
+  void FetchPages(const std::vector<uint64_t>& pages, bool stop_at_unreadable);
+  bool FetchPageFromBacking(uint64_t page);
+
+  pid_t pid_;
+  std::shared_ptr<unwindstack::Memory> backing_;
+  size_t page_size_;
+  bool use_process_vm_readv_ = true;
+  // Unreadable pages map to nullptr.
+  std::unordered_map<uint64_t, std::unique_ptr<uint8_t[]>> pages_;
+};
@@ -27,6 +27,7 @@
 
 // Forward delcarations
 class Cause;
+class RemoteMemoryCache;
 class Tombstone;
 
 namespace unwindstack {
@@ -38,7 +39,7 @@ class ScudoCrashData {
  public:
   ScudoCrashData() = delete;
   ~ScudoCrashData() = default;
-  ScudoCrashData(unwindstack::Memory* process_memory, const ProcessInfo& process_info);
+  ScudoCrashData(RemoteMemoryCache* process_memory, const ProcessInfo& process_info);
 
   bool CrashIsMine() const;
 
@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include <sys/types.h>
 
+#include <functional>
 #include <string>
 
 #include <android-base/macros.h>
@@ -84,6 +85,10 @@ ssize_t dump_memory(void* out, size_t len, uint8_t* tags, size_t tags_len, uint6
                     unwindstack::Memory* memory);
 void dump_memory(log_t* log, unwindstack::Memory* backtrace, uint64_t addr, const std::string&);
 
+// Calls |fn| once for every index in [0, count), spreading the calls over a few worker threads when
+// there are enough of them to be worth it. |fn| must be safe to call concurrently.
+void run_in_parallel(size_t count, const std::function<void(size_t)>& fn);
+
 void drop_capabilities();
 
 bool signal_has_sender(const siginfo_t*, pid_t caller_pid);
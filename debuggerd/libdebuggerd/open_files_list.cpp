@@ -21,9 +21,12 @@
 #include <android/fdsan.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -32,6 +35,8 @@
 #include <vector>
 
 #include <android-base/file.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <log/log.h>
 #include <unwindstack/Memory.h>
 
@@ -40,30 +45,61 @@
 
 void populate_open_files_list(OpenFilesList* list, pid_t pid) {
   std::string fd_dir_name = "/proc/" + std::to_string(pid) + "/fd";
-  std::unique_ptr<DIR, int (*)(DIR*)> dir(opendir(fd_dir_name.c_str()), closedir);
-  if (dir == nullptr) {
+  android::base::unique_fd dir_fd(open(fd_dir_name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+  if (dir_fd == -1) {
     ALOGE("failed to open directory %s: %s", fd_dir_name.c_str(), strerror(errno));
     return;
   }
 
-  struct dirent* de;
-  while ((de = readdir(dir.get())) != nullptr) {
-    if (*de->d_name == '.') {
-      continue;
+  // Processes can have tens of thousands of fds, so read the directory in large batches with
+  // getdents64, and resolve each link relative to the directory instead of building its path.
+  std::vector<char> dents(64 * 1024);
+  char target[PATH_MAX];
+  while (true) {
+    long bytes = syscall(SYS_getdents64, dir_fd.get(), dents.data(), dents.size());
+    if (bytes == -1) {
+      ALOGE("failed to read directory %s: %s", fd_dir_name.c_str(), strerror(errno));
+      return;
+    }
+    if (bytes == 0) {
+      return;
     }
 
-    int fd = atoi(de->d_name);
-    std::string path = fd_dir_name + "/" + std::string(de->d_name);
-    std::string target;
-    if (android::base::Readlink(path, &target)) {
-      (*list)[fd].path = target;
-    } else {
-      (*list)[fd].path = "???";
-      ALOGE("failed to readlink %s: %s", path.c_str(), strerror(errno));
+    for (long offset = 0; offset < bytes;) {
+      auto* de = reinterpret_cast<struct dirent64*>(dents.data() + offset);
+      offset += de->d_reclen;
+      if (*de->d_name == '.') {
+        continue;
+      }
+
+      int fd = atoi(de->d_name);
+      ssize_t length = readlinkat(dir_fd.get(), de->d_name, target, sizeof(target));
+      if (length == -1) {
+        (*list)[fd].path = "???";
+        ALOGE("failed to readlink %s/%s: %s", fd_dir_name.c_str(), de->d_name, strerror(errno));
+      } else {
+        (*list)[fd].path = std::string(target, length);
+      }
     }
   }
 }
 
+std::string get_open_file_type(const std::string& path) {
+  // Kernel-generated names look like "socket:[1234]" or "anon_inode:[eventfd]". Drop the inode
+  // number from the former; the latter already names the kind of file.
+  if (auto bracket = path.find(":["); bracket != std::string::npos) {
+    std::string type = path.substr(0, bracket);
+    return type == "anon_inode" ? path : type;
+  }
+  if (android::base::StartsWith(path, "/dev/")) {
+    return path;
+  }
+  if (android::base::StartsWith(path, "/")) {
+    return "file";
+  }
+  return path;
+}
+
 void populate_fdsan_table(OpenFilesList* list, std::shared_ptr<unwindstack::Memory> memory,
                           uint64_t fdsan_table_address) {
   constexpr size_t inline_fds = sizeof(FdTable::entries) / sizeof(*FdTable::entries);
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "libdebuggerd/remote_memory_cache.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+RemoteMemoryCache::RemoteMemoryCache(pid_t pid, std::shared_ptr<unwindstack::Memory> backing)
+    : pid_(pid), backing_(std::move(backing)), page_size_(getpagesize()) {}
+
+std::vector<uint64_t> RemoteMemoryCache::MissingPages(const std::vector<Range>& ranges) const {
+  std::vector<uint64_t> missing;
+  for (const auto& [addr, size] : ranges) {
+    if (size == 0) {
+      continue;
+    }
+    uint64_t last = addr + (size - 1);
+    if (last < addr) {
+      last = UINT64_MAX;
+    }
+    uint64_t page = PageStart(addr);
+    while (true) {
+      if (pages_.find(page) == pages_.end()) {
+        missing.push_back(page);
+      }
+      if (last - page < page_size_) {
+        break;
+      }
+      page += page_size_;
+    }
+  }
+  std::sort(missing.begin(), missing.end());
+  missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+  return missing;
+}
+
+void RemoteMemoryCache::Prefetch(const std::vector<Range>& ranges) {
+  FetchPages(MissingPages(ranges), false);
+}
+
+// |pages| must be sorted. Each process_vm_readv call reads up to IOV_MAX pages into their own
+// buffers, with runs of adjacent pages read as one remote iovec. The call stops at the first page
+// it can't read; that page is read through the backing memory, and unless it can't be read that
+// way either and |stop_at_unreadable| is set, the call is repeated for the pages after it.
+void RemoteMemoryCache::FetchPages(const std::vector<uint64_t>& pages, bool stop_at_unreadable) {
+  size_t next = 0;
+  while (next < pages.size()) {
+    if (!use_process_vm_readv_) {
+      if (!FetchPageFromBacking(pages[next++]) && stop_at_unreadable) {
+        return;
+      }
+      continue;
+    }
+
+    std::vector<std::unique_ptr<uint8_t[]>> buffers;
+    std::vector<iovec> local;
+    std::vector<iovec> remote;
+    for (size_t i = next; i < pages.size() && local.size() < IOV_MAX; ++i) {
+      buffers.emplace_back(new uint8_t[page_size_]);
+      local.push_back({buffers.back().get(), page_size_});
+      if (i > next && pages[i] == pages[i - 1] + page_size_) {
+        remote.back().iov_len += page_size_;
+      } else {
+        remote.push_back({reinterpret_cast<void*>(static_cast<uintptr_t>(pages[i])), page_size_});
+      }
+    }
+
+    ssize_t rc =
+        process_vm_readv(pid_, local.data(), local.size(), remote.data(), remote.size(), 0);
+    if (rc == -1 && errno != EFAULT) {
+      // Not permitted, or not supported: read everything through the backing memory.
+      use_process_vm_readv_ = false;
+      continue;
+    }
+    size_t read_pages = rc > 0 ? rc / page_size_ : 0;
+    for (size_t i = 0; i < read_pages; ++i) {
+      pages_[pages[next + i]] = std::move(buffers[i]);
+    }
+    next += read_pages;
+    if (read_pages < buffers.size() && !FetchPageFromBacking(pages[next++]) &&
+        stop_at_unreadable) {
+      return;
+    }
+  }
+}
+
+bool RemoteMemoryCache::FetchPageFromBacking(uint64_t page) {
+  auto buffer = std::make_unique<uint8_t[]>(page_size_);
+  if (!backing_->ReadFully(page, buffer.get(), page_size_)) {
+    pages_[page] = nullptr;
+    return false;
+  }
+  pages_[page] = std::move(buffer);
+  return true;
+}
+
+size_t RemoteMemoryCache::Read(uint64_t addr, void* dst, size_t size) {
+  // Fetch the missing pages of the range together, up to the first one that can't be read.
+  FetchPages(MissingPages({{addr, size}}), true);
+
+  size_t bytes = 0;
+  while (bytes < size) {
+    uint64_t cur = addr + bytes;
+    uint64_t page = PageStart(cur);
+    auto it = pages_.find(page);
+    if (it == pages_.end() || it->second == nullptr) {
+      break;
+    }
+    size_t offset = cur - page;
+    size_t len = std::min(size - bytes, page_size_ - offset);
+    memcpy(static_cast<uint8_t*>(dst) + bytes, it->second.get() + offset, len);
+    bytes += len;
+    if (cur + len < cur) {
+      break;
+    }
+  }
+  return bytes;
+}
+
+long RemoteMemoryCache::ReadTag(uint64_t addr) {
+  return backing_->ReadTag(addr);
+}
@@ -17,6 +17,7 @@
 #if defined(USE_SCUDO)
 
 #include "libdebuggerd/scudo.h"
+#include "libdebuggerd/remote_memory_cache.h"
 #include "libdebuggerd/tombstone.h"
 
 #include "unwindstack/AndroidUnwinder.h"
@@ -37,12 +38,32 @@ std::unique_ptr<char[]> AllocAndReadFully(unwindstack::Memory* process_memory, u
   return buf;
 }
 
-ScudoCrashData::ScudoCrashData(unwindstack::Memory* process_memory,
+ScudoCrashData::ScudoCrashData(RemoteMemoryCache* process_memory,
                                const ProcessInfo& process_info) {
   if (!process_info.has_fault_address) {
     return;
   }
 
+  untagged_fault_addr_ = process_info.untagged_fault_address;
+  uintptr_t fault_page = untagged_fault_addr_ & ~(getpagesize() - 1);
+
+  uintptr_t memory_begin = fault_page - getpagesize() * 16;
+  if (memory_begin > fault_page) {
+    return;
+  }
+
+  uintptr_t memory_end = fault_page + getpagesize() * 16;
+  if (memory_end < fault_page) {
+    return;
+  }
+
+  // Read everything the allocator needs in one batch: the ring buffer and stack depot can be
+  // large, and most of the pages around the fault are usually readable.
+  process_memory->Prefetch({{process_info.scudo_region_info, __scudo_get_region_info_size()},
+                            {process_info.scudo_ring_buffer, process_info.scudo_ring_buffer_size},
+                            {process_info.scudo_stack_depot, process_info.scudo_stack_depot_size},
+                            {memory_begin, memory_end - memory_begin}});
+
   auto region_info = AllocAndReadFully(process_memory, process_info.scudo_region_info,
                                        __scudo_get_region_info_size());
   std::unique_ptr<char[]> ring_buffer;
@@ -59,19 +80,6 @@ ScudoCrashData::ScudoCrashData(unwindstack::Memory* process_memory,
     return;
   }
 
-  untagged_fault_addr_ = process_info.untagged_fault_address;
-  uintptr_t fault_page = untagged_fault_addr_ & ~(getpagesize() - 1);
-
-  uintptr_t memory_begin = fault_page - getpagesize() * 16;
-  if (memory_begin > fault_page) {
-    return;
-  }
-
-  uintptr_t memory_end = fault_page + getpagesize() * 16;
-  if (memory_end < fault_page) {
-    return;
-  }
-
   auto memory = std::make_unique<char[]>(memory_end - memory_begin);
   for (auto i = memory_begin; i != memory_end; i += getpagesize()) {
     process_memory->ReadFully(i, memory.get() + i - memory_begin, getpagesize());
@@ -14,13 +14,17 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
 #include <string>
+#include <vector>
 
 #include <android-base/file.h>
+#include <android-base/unique_fd.h>
 #include <gtest/gtest.h>
 
 #include "libdebuggerd/open_files_list.h"
@@ -46,3 +50,40 @@ TEST(OpenFilesListTest, BasicTest) {
   }
   EXPECT_TRUE(found);
 }
+
+TEST(OpenFilesListTest, ManyFiles) {
+  // Enough fds to need more than one getdents64 batch.
+  constexpr int kFileCount = 4000;
+  rlimit limit;
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &limit));
+  if (limit.rlim_cur < kFileCount + 256) {
+    if (limit.rlim_max < kFileCount + 256) {
+      GTEST_SKIP() << "RLIMIT_NOFILE is too low";
+    }
+    limit.rlim_cur = limit.rlim_max;
+    ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &limit));
+  }
+
+  std::vector<android::base::unique_fd> fds;
+  for (int i = 0; i < kFileCount; ++i) {
+    android::base::unique_fd fd(open("/dev/null", O_RDONLY | O_CLOEXEC));
+    ASSERT_NE(-1, fd.get());
+    fds.emplace_back(std::move(fd));
+  }
+
+  OpenFilesList list;
+  populate_open_files_list(&list, getpid());
+  for (const auto& fd : fds) {
+    ASSERT_EQ(1U, list.count(fd.get()));
+    EXPECT_EQ("/dev/null", list[fd.get()].path.value_or(""));
+  }
+}
+
+TEST(OpenFilesListTest, FileTypes) {
+  EXPECT_EQ("socket", get_open_file_type("socket:[12345]"));
+  EXPECT_EQ("pipe", get_open_file_type("pipe:[678]"));
+  EXPECT_EQ("anon_inode:[eventfd]", get_open_file_type("anon_inode:[eventfd]"));
+  EXPECT_EQ("/dev/binder", get_open_file_type("/dev/binder"));
+  EXPECT_EQ("file", get_open_file_type("/data/local/tmp/foo"));
+  EXPECT_EQ("???", get_open_file_type("???"));
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <unwindstack/Memory.h>
+
+#include "libdebuggerd/remote_memory_cache.h"
+
+// Reads the memory of this process directly, except for the pages marked unreadable, and counts
+// the reads it gets.
+class BackingMemory : public unwindstack::Memory {
+ public:
+  BackingMemory(uintptr_t unreadable_begin, uintptr_t unreadable_end)
+      : unreadable_begin_(unreadable_begin), unreadable_end_(unreadable_end) {}
+  virtual ~BackingMemory() = default;
+
+  size_t Read(uint64_t addr, void* buffer, size_t bytes) override {
+    reads_++;
+    if (addr < unreadable_end_ && addr + bytes > unreadable_begin_) {
+      return 0;
+    }
+    memcpy(buffer, reinterpret_cast<void*>(addr), bytes);
+    return bytes;
+  }
+
+  size_t reads() const { return reads_; }
+
+ private:
+  uintptr_t unreadable_begin_;
+  uintptr_t unreadable_end_;
+  size_t reads_ = 0;
+};
+
+class RemoteMemoryCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    page_size_ = getpagesize();
+    void* map = mmap(nullptr, kNumPages * page_size_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(MAP_FAILED, map);
+    pages_ = static_cast<uint8_t*>(map);
+    for (size_t i = 0; i < kNumPages * page_size_; ++i) {
+      pages_[i] = i / page_size_ + 1;
+    }
+    // The third page can't be read by anyone.
+    ASSERT_EQ(0, mprotect(Page(2), page_size_, PROT_NONE));
+    backing_ = std::make_shared<BackingMemory>(Addr(2), Addr(3));
+  }
+
+  void TearDown() override {
+    if (pages_ != nullptr) {
+      munmap(pages_, kNumPages * page_size_);
+    }
+  }
+
+  uint8_t* Page(size_t index) { return pages_ + index * page_size_; }
+  uintptr_t Addr(size_t index) { return reinterpret_cast<uintptr_t>(Page(index)); }
+
+  static constexpr size_t kNumPages = 4;
+  size_t page_size_;
+  uint8_t* pages_ = nullptr;
+  std::shared_ptr<BackingMemory> backing_;
+};
+
+TEST_F(RemoteMemoryCacheTest, read_within_and_across_pages) {
+  RemoteMemoryCache cache(getpid(), backing_);
+  std::vector<uint8_t> buffer(page_size_);
+
+  ASSERT_TRUE(cache.ReadFully(Addr(0) + page_size_ / 2, buffer.data(), buffer.size()));
+  EXPECT_EQ(1, buffer.front());
+  EXPECT_EQ(2, buffer.back());
+
+  // Both pages are cached now, so this doesn't go back to the process.
+  memset(Page(1), 0xff, page_size_);
+  ASSERT_TRUE(cache.ReadFully(Addr(1), buffer.data(), buffer.size()));
+  EXPECT_EQ(2, buffer.front());
+  EXPECT_EQ(0U, backing_->reads());
+}
+
+TEST_F(RemoteMemoryCacheTest, read_stops_at_unreadable_page) {
+  RemoteMemoryCache cache(getpid(), backing_);
+  std::vector<uint8_t> buffer(page_size_ * 2);
+
+  EXPECT_EQ(page_size_, cache.Read(Addr(1), buffer.data(), buffer.size()));
+  EXPECT_EQ(2, buffer[page_size_ - 1]);
+  EXPECT_EQ(1U, backing_->reads());
+
+  // The unreadable page is remembered.
+  EXPECT_EQ(0U, cache.Read(Addr(2), buffer.data(), 1));
+  EXPECT_EQ(1U, backing_->reads());
+}
+
+TEST_F(RemoteMemoryCacheTest, prefetch_continues_past_unreadable_page) {
+  RemoteMemoryCache cache(getpid(), backing_);
+  cache.Prefetch({{Addr(0), kNumPages * page_size_}});
+  EXPECT_EQ(1U, backing_->reads());
+
+  memset(Page(3), 0xff, page_size_);
+  uint8_t value;
+  ASSERT_TRUE(cache.ReadFully(Addr(3), &value, sizeof(value)));
+  EXPECT_EQ(4, value);
+  EXPECT_EQ(1U, backing_->reads());
+}
+
+TEST_F(RemoteMemoryCacheTest, prefetch_multiple_ranges) {
+  RemoteMemoryCache cache(getpid(), backing_);
+  cache.Prefetch({{Addr(3), 1}, {Addr(0), 1}, {Addr(0) + 1, page_size_}});
+
+  memset(Page(0), 0xff, page_size_ * 2);
+  memset(Page(3), 0xff, page_size_);
+  uint8_t value;
+  ASSERT_TRUE(cache.ReadFully(Addr(0), &value, sizeof(value)));
+  EXPECT_EQ(1, value);
+  ASSERT_TRUE(cache.ReadFully(Addr(1), &value, sizeof(value)));
+  EXPECT_EQ(2, value);
+  ASSERT_TRUE(cache.ReadFully(Addr(3), &value, sizeof(value)));
+  EXPECT_EQ(4, value);
+  EXPECT_EQ(0U, backing_->reads());
+}
+
+TEST_F(RemoteMemoryCacheTest, falls_back_to_backing_memory) {
+  // process_vm_readv fails for a pid that doesn't exist.
+  RemoteMemoryCache cache(-1, backing_);
+  std::vector<uint8_t> buffer(page_size_ * 2);
+
+  ASSERT_TRUE(cache.ReadFully(Addr(0), buffer.data(), buffer.size()));
+  EXPECT_EQ(1, buffer.front());
+  EXPECT_EQ(2, buffer.back());
+  EXPECT_EQ(2U, backing_->reads());
+
+  EXPECT_EQ(0U, cache.Read(Addr(2), buffer.data(), buffer.size()));
+  EXPECT_EQ(3U, backing_->reads());
+}
@@ -134,3 +134,14 @@ TEST_F(TombstoneProtoToTextTest, crash_detail_bytes) {
   ProtoToString();
   EXPECT_MATCH(text_, R"(CRASH_DETAIL_NAME: 'helloworld\\1\\255\\3')");
 }
+
+TEST_F(TombstoneProtoToTextTest, open_fds_summary) {
+  auto* fd = tombstone_->add_open_fds();
+  fd->set_fd(0);
+  fd->set_path("/dev/null");
+  auto* summary = tombstone_->add_open_fds_summary();
+  summary->set_type("socket");
+  summary->set_count(20000);
+  ProtoToString();
+  EXPECT_MATCH(text_, R"(fd 0: /dev/null \(unowned\)\n.*\.\.\. and more:\n.*20000 x socket)");
+}
@@ -18,6 +18,7 @@
 
 #include "libdebuggerd/tombstone.h"
 #include "libdebuggerd/gwp_asan.h"
+#include "libdebuggerd/remote_memory_cache.h"
 #if defined(USE_SCUDO)
 #include "libdebuggerd/scudo.h"
 #endif
@@ -33,10 +34,14 @@
 #include <sys/sysinfo.h>
 #include <time.h>
 
+#include <algorithm>
+#include <map>
 #include <memory>
 #include <optional>
 #include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <async_safe/log.h>
 
@@ -203,17 +208,17 @@ void set_human_readable_cause(Cause* cause, uint64_t fault_addr) {
 }
 
 static void dump_probable_cause(Tombstone* tombstone, unwindstack::AndroidUnwinder* unwinder,
-                                const ProcessInfo& process_info, const ThreadInfo& target_thread) {
+                                RemoteMemoryCache* process_memory, const ProcessInfo& process_info,
+                                const ThreadInfo& target_thread) {
 #if defined(USE_SCUDO)
-  ScudoCrashData scudo_crash_data(unwinder->GetProcessMemory().get(), process_info);
+  ScudoCrashData scudo_crash_data(process_memory, process_info);
   if (scudo_crash_data.CrashIsMine()) {
     scudo_crash_data.AddCauseProtos(tombstone, unwinder);
     return;
   }
 #endif
 
-  GwpAsanCrashData gwp_asan_crash_data(unwinder->GetProcessMemory().get(), process_info,
-                                       target_thread);
+  GwpAsanCrashData gwp_asan_crash_data(process_memory, process_info, target_thread);
   if (gwp_asan_crash_data.CrashIsMine()) {
     gwp_asan_crash_data.AddCauseProtos(tombstone, unwinder);
     return;
@@ -344,7 +349,15 @@ static void dump_abort_message(Tombstone* tombstone,
 
 static void dump_open_fds(Tombstone* tombstone, const OpenFilesList* open_files) {
   if (open_files) {
+    size_t listed = 0;
+    std::map<std::string, uint32_t> summary;
     for (auto& [fd, entry] : *open_files) {
+      if (listed == kMaxOpenFilesListed) {
+        summary[get_open_file_type(entry.path.value_or("<MISSING>"))]++;
+        continue;
+      }
+      listed++;
+
       FD f;
 
       f.set_fd(fd);
@@ -362,7 +375,13 @@ static void dump_open_fds(Tombstone* tombstone, const OpenFilesList* open_files)
         f.set_tag(value);
       }
 
-      *tombstone->add_open_fds() = f;
+      *tombstone->add_open_fds() = std::move(f);
+    }
+
+    for (const auto& [type, count] : summary) {
+      FDSummary* s = tombstone->add_open_fds_summary();
+      s->set_type(type);
+      s->set_count(count);
     }
   }
 }
@@ -401,21 +420,36 @@ void fill_in_backtrace_frame(BacktraceFrame* f, const unwindstack::FrameData& fr
   f->set_build_id(frame.map_info->GetPrintableBuildID());
 }
 
+// The memory around the registers is only dumped if |memory_dump| is set.
 static void dump_registers(unwindstack::AndroidUnwinder* unwinder,
                            const std::unique_ptr<unwindstack::Regs>& regs, Thread& thread,
-                           bool memory_dump) {
+                           RemoteMemoryCache* memory_dump) {
   if (regs == nullptr) {
     return;
   }
 
   unwindstack::Maps* maps = unwinder->GetMaps();
-  unwindstack::Memory* memory = unwinder->GetProcessMemory().get();
+  constexpr size_t kNumBytesAroundRegister = 256;
+
+  if (memory_dump) {
+    // Read the memory around all of the registers that point into a mapping in one batch. The
+    // dump starts at most 48 bytes before the register value.
+    std::vector<RemoteMemoryCache::Range> ranges;
+    regs->IterateRegisters([&ranges, maps](const char*, uint64_t value) {
+      uint64_t addr = untag_address(value);
+      if (maps->Find(addr)) {
+        uint64_t begin = addr - std::min<uint64_t>(addr, 48);
+        ranges.emplace_back(begin, addr - begin + kNumBytesAroundRegister);
+      }
+    });
+    memory_dump->Prefetch(ranges);
+  }
 
-  regs->IterateRegisters([&thread, memory_dump, maps, memory](const char* name, uint64_t value) {
+  regs->IterateRegisters([&thread, memory_dump, maps](const char* name, uint64_t value) {
     Register r;
     r.set_name(name);
     r.set_u64(value);
-    *thread.add_registers() = r;
+    *thread.add_registers() = std::move(r);
 
     if (memory_dump) {
       MemoryDump dump;
@@ -426,11 +460,10 @@ static void dump_registers(unwindstack::AndroidUnwinder* unwinder,
         dump.set_mapping_name(map_info->name());
       }
 
-      constexpr size_t kNumBytesAroundRegister = 256;
       constexpr size_t kNumTagsAroundRegister = kNumBytesAroundRegister / kTagGranuleSize;
       char buf[kNumBytesAroundRegister];
       uint8_t tags[kNumTagsAroundRegister];
-      ssize_t bytes = dump_memory(buf, sizeof(buf), tags, sizeof(tags), &value, memory);
+      ssize_t bytes = dump_memory(buf, sizeof(buf), tags, sizeof(tags), &value, memory_dump);
       if (bytes == -1) {
         return;
       }
@@ -481,11 +514,8 @@ static void dump_thread_backtrace(std::vector<unwindstack::FrameData>& frames, T
   }
 }
 
-static void dump_thread(Tombstone* tombstone, unwindstack::AndroidUnwinder* unwinder,
-                        const ThreadInfo& thread_info, bool memory_dump = false,
-                        unwindstack::AndroidUnwinder* guest_unwinder = nullptr) {
-  Thread thread;
-
+static void unwind_thread(unwindstack::AndroidUnwinder* unwinder, const ThreadInfo& thread_info,
+                          RemoteMemoryCache* memory_dump, Thread& thread) {
   thread.set_id(thread_info.tid);
   thread.set_name(thread_info.thread_name);
   thread.set_tagged_addr_ctrl(thread_info.tagged_addr_ctrl);
@@ -507,29 +537,73 @@ static void dump_thread(Tombstone* tombstone, unwindstack::AndroidUnwinder* unwi
     dump_thread_backtrace(data.frames, thread);
   }
   dump_registers(unwinder, *data.saved_initial_regs, thread, memory_dump);
+}
+
+static void dump_guest_thread(Tombstone* tombstone, unwindstack::AndroidUnwinder* guest_unwinder,
+                              const ThreadInfo& thread_info, RemoteMemoryCache* memory_dump) {
+  if (!thread_info.guest_registers) {
+    async_safe_format_log(ANDROID_LOG_INFO, LOG_TAG,
+                          "No guest state registers information for tid %d", thread_info.tid);
+    return;
+  }
+  Thread guest_thread;
+  unwindstack::AndroidUnwinderData guest_data;
+  guest_data.saved_initial_regs = std::make_optional<std::unique_ptr<unwindstack::Regs>>();
+  if (guest_unwinder->Unwind(thread_info.guest_registers.get(), guest_data)) {
+    dump_thread_backtrace(guest_data.frames, guest_thread);
+  } else {
+    async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
+                          "Unwind guest state registers failed for tid %d: Error %s",
+                          thread_info.tid, guest_data.GetErrorString().c_str());
+  }
+  dump_registers(guest_unwinder, *guest_data.saved_initial_regs, guest_thread, memory_dump);
+  auto& guest_threads = *tombstone->mutable_guest_threads();
+  guest_threads[thread_info.tid] = std::move(guest_thread);
+}
+
+static void dump_thread(Tombstone* tombstone, unwindstack::AndroidUnwinder* unwinder,
+                        const ThreadInfo& thread_info, RemoteMemoryCache* memory_dump = nullptr,
+                        unwindstack::AndroidUnwinder* guest_unwinder = nullptr) {
+  Thread thread;
+  unwind_thread(unwinder, thread_info, memory_dump, thread);
 
   auto& threads = *tombstone->mutable_threads();
-  threads[thread_info.tid] = thread;
+  threads[thread_info.tid] = std::move(thread);
 
   if (guest_unwinder) {
-    if (!thread_info.guest_registers) {
-      async_safe_format_log(ANDROID_LOG_INFO, LOG_TAG,
-                            "No guest state registers information for tid %d", thread_info.tid);
-      return;
+    dump_guest_thread(tombstone, guest_unwinder, thread_info, memory_dump);
+  }
+}
+
+// Dumps every thread other than the target. Threads whose registers were captured up front don't
+// need ptrace, so they are unwound on several threads and added to the tombstone afterwards.
+static void dump_other_threads(Tombstone* tombstone, unwindstack::AndroidUnwinder* unwinder,
+                               const std::map<pid_t, ThreadInfo>& threads, pid_t target_tid,
+                               unwindstack::AndroidUnwinder* guest_unwinder) {
+  std::vector<const ThreadInfo*> with_registers;
+  for (const auto& [tid, thread_info] : threads) {
+    if (tid == target_tid) {
+      continue;
     }
-    Thread guest_thread;
-    unwindstack::AndroidUnwinderData guest_data;
-    guest_data.saved_initial_regs = std::make_optional<std::unique_ptr<unwindstack::Regs>>();
-    if (guest_unwinder->Unwind(thread_info.guest_registers.get(), guest_data)) {
-      dump_thread_backtrace(guest_data.frames, guest_thread);
+    if (thread_info.registers != nullptr) {
+      with_registers.push_back(&thread_info);
     } else {
-      async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
-                            "Unwind guest state registers failed for tid %d: Error %s",
-                            thread_info.tid, guest_data.GetErrorString().c_str());
+      dump_thread(tombstone, unwinder, thread_info, /* memory_dump */ nullptr, guest_unwinder);
+    }
+  }
+
+  std::vector<Thread> unwound(with_registers.size());
+  run_in_parallel(with_registers.size(), [&](size_t i) {
+    unwind_thread(unwinder, *with_registers[i], /* memory_dump */ nullptr, unwound[i]);
+  });
+
+  auto& proto_threads = *tombstone->mutable_threads();
+  for (size_t i = 0; i < with_registers.size(); ++i) {
+    proto_threads[with_registers[i]->tid] = std::move(unwound[i]);
+    // The guest unwinder is only ever used from this thread.
+    if (guest_unwinder) {
+      dump_guest_thread(tombstone, guest_unwinder, *with_registers[i], /* memory_dump */ nullptr);
     }
-    dump_registers(guest_unwinder, *guest_data.saved_initial_regs, guest_thread, memory_dump);
-    auto& guest_threads = *tombstone->mutable_guest_threads();
-    guest_threads[thread_info.tid] = guest_thread;
   }
 }
 
@@ -702,7 +776,7 @@ static void dump_tags_around_fault_addr(Signal* signal, const Tombstone& tombsto
   }
 
   if (!mte_tags->empty()) {
-    *signal->mutable_fault_adjacent_metadata() = tag_dump;
+    *signal->mutable_fault_adjacent_metadata() = std::move(tag_dump);
   }
 }
 
@@ -724,6 +798,12 @@ void engrave_tombstone_proto(Tombstone* tombstone, unwindstack::AndroidUnwinder*
   result.set_timestamp(get_timestamp());
 
   const ThreadInfo& target_thread = threads.at(target_tid);
+  // Everything read from the process outside of unwinding goes through one cache, so that the
+  // memory dumps and the allocator state don't read the same pages twice.
+  auto memory_cache =
+      std::make_shared<RemoteMemoryCache>(target_thread.pid, unwinder->GetProcessMemory());
+  std::shared_ptr<unwindstack::Memory> process_memory = memory_cache;
+
   result.set_pid(target_thread.pid);
   result.set_tid(target_thread.tid);
   result.set_uid(target_thread.uid);
@@ -771,23 +851,19 @@ void engrave_tombstone_proto(Tombstone* tombstone, unwindstack::AndroidUnwinder*
     sig.set_has_fault_address(true);
     uintptr_t fault_addr = process_info.maybe_tagged_fault_address;
     sig.set_fault_address(fault_addr);
-    dump_tags_around_fault_addr(&sig, result, unwinder->GetProcessMemory(), fault_addr);
+    dump_tags_around_fault_addr(&sig, result, process_memory, fault_addr);
   }
 
-  *result.mutable_signal_info() = sig;
+  *result.mutable_signal_info() = std::move(sig);
 
-  dump_abort_message(&result, unwinder->GetProcessMemory(), process_info);
-  dump_crash_details(&result, unwinder->GetProcessMemory(), process_info);
+  dump_abort_message(&result, process_memory, process_info);
+  dump_crash_details(&result, process_memory, process_info);
   // Dump the target thread, but save the memory around the registers.
-  dump_thread(&result, unwinder, target_thread, /* memory_dump */ true, guest_unwinder);
+  dump_thread(&result, unwinder, target_thread, memory_cache.get(), guest_unwinder);
 
-  for (const auto& [tid, thread_info] : threads) {
-    if (tid != target_tid) {
-      dump_thread(&result, unwinder, thread_info, /* memory_dump */ false, guest_unwinder);
-    }
-  }
+  dump_other_threads(&result, unwinder, threads, target_tid, guest_unwinder);
 
-  dump_probable_cause(&result, unwinder, process_info, target_thread);
+  dump_probable_cause(&result, unwinder, memory_cache.get(), process_info, target_thread);
 
   dump_mappings(&result, unwinder->GetMaps(), unwinder->GetProcessMemory());
 
@@ -658,6 +658,12 @@ bool tombstone_proto_to_text(const Tombstone& tombstone, CallbackType callback)
 
       CBS("    fd %d: %s (%s)", fd.fd(), fd.path().c_str(), owner ? owner->c_str() : "unowned");
     }
+    if (tombstone.open_fds_summary().size() > 0) {
+      CBS("    ... and more:");
+      for (const auto& summary : tombstone.open_fds_summary()) {
+        CBS("    %u x %s", summary.count(), summary.type().c_str());
+      }
+    }
   }
 
   print_logs(callback, tombstone, 0);
@@ -28,8 +28,12 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
@@ -245,6 +249,38 @@ void dump_memory(log_t* log, unwindstack::Memory* memory, uint64_t addr, const s
   }
 }
 
+void run_in_parallel(size_t count, const std::function<void(size_t)>& fn) {
+  // Unwinding is mostly spent reading the target's memory and ELF files, so a handful of threads
+  // is enough; below the minimum the thread startup isn't worth it.
+  constexpr size_t kMaxWorkers = 4;
+  constexpr size_t kMinItemsPerWorker = 4;
+
+  size_t workers = std::min<size_t>(kMaxWorkers, std::thread::hardware_concurrency());
+  workers = std::min(workers, count / kMinItemsPerWorker);
+  if (workers <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next = 0;
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      fn(i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 void drop_capabilities() {
   __user_cap_header_struct capheader;
   memset(&capheader, 0, sizeof(capheader));
@@ -17,10 +17,17 @@
 #include <err.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
 #include <android-base/unique_fd.h>
 #include <libdebuggerd/tombstone.h>
+#include <zstd.h>
 
 #include "tombstone.pb.h"
 
@@ -29,9 +36,42 @@ using android::base::unique_fd;
 [[noreturn]] void usage(bool error) {
   fprintf(stderr, "usage: pbtombstone TOMBSTONE.PB\n");
   fprintf(stderr, "Convert a protobuf tombstone to text.\n");
+  fprintf(stderr, "Tombstones compressed by tombstoned (.pb.zst) are decompressed.\n");
   exit(error);
 }
 
+// tombstoned writes zstd-compressed tombstones when tombstoned.compress_artifacts is set.
+static bool is_zstd(const std::string& data) {
+  static constexpr uint8_t kMagic[] = {0x28, 0xb5, 0x2f, 0xfd};
+  return data.size() >= sizeof(kMagic) && memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+static std::string decompress(const std::string& data) {
+  std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+  if (!dctx) {
+    errx(1, "failed to create zstd context");
+  }
+
+  std::string result;
+  std::vector<char> out(ZSTD_DStreamOutSize());
+  ZSTD_inBuffer input = {data.data(), data.size(), 0};
+  ZSTD_outBuffer output;
+  size_t rc;
+  do {
+    output = {out.data(), out.size(), 0};
+    rc = ZSTD_decompressStream(dctx.get(), &output, &input);
+    if (ZSTD_isError(rc)) {
+      errx(1, "failed to decompress tombstone: %s", ZSTD_getErrorName(rc));
+    }
+    result.append(out.data(), output.pos);
+    // Until the frame ends, a full output buffer may leave data behind in the context.
+  } while (input.pos < input.size || (rc != 0 && output.pos == output.size));
+  if (rc != 0) {
+    errx(1, "compressed tombstone is truncated");
+  }
+  return result;
+}
+
 int main(int argc, const char* argv[]) {
   if (argc != 2) {
     usage(true);
@@ -46,9 +86,17 @@ int main(int argc, const char* argv[]) {
     err(1, "failed to open tombstone '%s'", argv[1]);
   }
 
+  std::string data;
+  if (!android::base::ReadFdToString(fd, &data)) {
+    err(1, "failed to read tombstone '%s'", argv[1]);
+  }
+  if (is_zstd(data)) {
+    data = decompress(data);
+  }
+
   Tombstone tombstone;
-  if (!tombstone.ParseFromFileDescriptor(fd.get())) {
-    err(1, "failed to parse tombstone");
+  if (!tombstone.ParseFromString(data)) {
+    errx(1, "failed to parse tombstone");
   }
 
   bool result = tombstone_proto_to_text(
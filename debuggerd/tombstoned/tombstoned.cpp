@@ -17,26 +17,39 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <condition_variable>
 #include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <event2/event.h>
 #include <event2/listener.h>
 #include <event2/thread.h>
 
 #include <android-base/cmsg.h>
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <cutils/sockets.h>
+#include <private/android_filesystem_config.h>
+#include <zstd.h>
 
 #include "debuggerd/handler.h"
 #include "dump_type.h"
@@ -45,6 +58,7 @@
 
 #include "intercept_manager.h"
 
+using android::base::GetBoolProperty;
 using android::base::GetIntProperty;
 using android::base::SendFileDescriptors;
 using android::base::StringPrintf;
@@ -54,6 +68,9 @@ using android::base::unique_fd;
 
 static InterceptManager* intercept_manager;
 
+// Compressed artifacts are named like uncompressed ones, plus this suffix.
+static constexpr char kCompressedSuffix[] = ".zst";
+
 enum CrashStatus {
   kCrashStatusRunning,
   kCrashStatusQueued,
@@ -91,28 +108,55 @@ struct Crash {
   event* crash_event = nullptr;
 
   DebuggerdDumpType crash_type;
+
+  // Whether the crash came from the app the user is looking at. These go ahead of other queued
+  // crashes, so a cascade of background crashes can't hold them up.
+  bool foreground = false;
 };
 
+// ActivityManager's FOREGROUND_APP_ADJ.
+static constexpr int kForegroundAppAdj = 0;
+
+static bool is_foreground_app(pid_t pid) {
+  std::string proc_path = StringPrintf("/proc/%d", pid);
+  struct stat st;
+  if (stat(proc_path.c_str(), &st) != 0 || st.st_uid < AID_APP_START) {
+    return false;
+  }
+
+  std::string adj_str;
+  int adj;
+  if (!android::base::ReadFileToString(proc_path + "/oom_score_adj", &adj_str) ||
+      !android::base::ParseInt(android::base::Trim(adj_str), &adj)) {
+    return false;
+  }
+  return adj == kForegroundAppAdj;
+}
+
 class CrashQueue {
  public:
   CrashQueue(const std::string& dir_path, const std::string& file_name_prefix, size_t max_artifacts,
-             size_t max_concurrent_dumps, bool supports_proto, bool world_readable)
+             size_t max_concurrent_dumps, bool supports_proto, bool world_readable,
+             bool compress_artifacts)
       : file_name_prefix_(file_name_prefix),
         dir_path_(dir_path),
         dir_fd_(open(dir_path.c_str(), O_DIRECTORY | O_RDONLY | O_CLOEXEC)),
         max_artifacts_(max_artifacts),
         next_artifact_(0),
-        max_concurrent_dumps_(max_concurrent_dumps),
+        max_concurrent_dumps_(std::min(max_concurrent_dumps, max_artifacts - 1)),
         num_concurrent_dumps_(0),
         supports_proto_(supports_proto),
-        world_readable_(world_readable) {
+        world_readable_(world_readable),
+        compress_artifacts_(compress_artifacts) {
     if (dir_fd_ == -1) {
       PLOG(FATAL) << "failed to open directory: " << dir_path;
     }
 
     // NOTE: If max_artifacts_ <= max_concurrent_dumps_, then theoretically the
-    // same filename could be handed out to multiple processes.
+    // same filename could be handed out to multiple processes. Configured
+    // concurrency is capped above to avoid that.
     CHECK(max_artifacts_ > max_concurrent_dumps_);
+    CHECK(max_concurrent_dumps_ > 0);
 
     find_oldest_artifact();
   }
@@ -128,16 +172,20 @@ class CrashQueue {
   static CrashQueue* for_tombstones() {
     static CrashQueue queue("/data/tombstones", "tombstone_" /* file_name_prefix */,
                             GetIntProperty("tombstoned.max_tombstone_count", 32),
-                            1 /* max_concurrent_dumps */, true /* supports_proto */,
-                            true /* world_readable */);
+                            GetIntProperty("tombstoned.max_concurrent_tombstones", 1, 1),
+                            true /* supports_proto */,
+                            true /* world_readable */,
+                            GetBoolProperty("tombstoned.compress_artifacts", false));
     return &queue;
   }
 
   static CrashQueue* for_anrs() {
     static CrashQueue queue("/data/anr", "trace_" /* file_name_prefix */,
                             GetIntProperty("tombstoned.max_anr_count", 64),
-                            4 /* max_concurrent_dumps */, false /* supports_proto */,
-                            false /* world_readable */);
+                            GetIntProperty("tombstoned.max_concurrent_anrs", 4, 1),
+                            false /* supports_proto */,
+                            false /* world_readable */,
+                            GetBoolProperty("tombstoned.compress_artifacts", false));
     return &queue;
   }
 
@@ -191,7 +239,9 @@ class CrashQueue {
     return result;
   }
 
-  borrowed_fd dir_fd() { return dir_fd_; }
+  borrowed_fd dir_fd() const { return dir_fd_; }
+
+  bool compress_artifacts() const { return compress_artifacts_; }
 
   CrashArtifactPaths get_next_artifact_paths() {
     CrashArtifactPaths result;
@@ -205,10 +255,21 @@ class CrashQueue {
     return result;
   }
 
+  // Native backtraces are only ever written to an intercept, never to an artifact, so they don't
+  // count against the concurrency limit. This lets a batch of `debuggerd -b` requests run at once.
+  static bool is_limited(const Crash* crash) {
+    return crash->crash_type != kDebuggerdNativeBacktrace;
+  }
+
   // Consumes crash if it returns true, otherwise leaves it untouched.
   bool maybe_enqueue_crash(std::unique_ptr<Crash>&& crash) {
-    if (num_concurrent_dumps_ == max_concurrent_dumps_) {
-      queued_requests_.emplace_back(std::move(crash));
+    if (is_limited(crash.get()) && num_concurrent_dumps_ >= max_concurrent_dumps_) {
+      auto it = queued_requests_.end();
+      if (crash->foreground) {
+        it = std::find_if(queued_requests_.begin(), queued_requests_.end(),
+                          [](const std::unique_ptr<Crash>& queued) { return !queued->foreground; });
+      }
+      queued_requests_.insert(it, std::move(crash));
       return true;
     }
 
@@ -223,9 +284,13 @@ class CrashQueue {
     }
   }
 
-  void on_crash_started() { ++num_concurrent_dumps_; }
+  void on_crash_started(const Crash* crash) {
+    if (is_limited(crash)) ++num_concurrent_dumps_;
+  }
 
-  void on_crash_completed() { --num_concurrent_dumps_; }
+  void on_crash_completed(const Crash* crash) {
+    if (is_limited(crash)) --num_concurrent_dumps_;
+  }
 
  private:
   void find_oldest_artifact() {
@@ -236,7 +301,12 @@ class CrashQueue {
       std::string path =
           StringPrintf("%s/%s%02zu", dir_path_.c_str(), file_name_prefix_.c_str(), i);
       struct stat st;
-      if (stat(path.c_str(), &st) != 0) {
+      int rc = stat(path.c_str(), &st);
+      if (rc != 0 && errno == ENOENT) {
+        path += kCompressedSuffix;
+        rc = stat(path.c_str(), &st);
+      }
+      if (rc != 0) {
         if (errno == ENOENT) {
           oldest_tombstone = i;
           break;
@@ -268,6 +338,7 @@ class CrashQueue {
 
   bool supports_proto_;
   bool world_readable_;
+  bool compress_artifacts_;
 
   std::deque<std::unique_ptr<Crash>> queued_requests_;
 
@@ -327,7 +398,7 @@ static void perform_request(std::unique_ptr<Crash> crash) {
   event_assign(crash->crash_event, base, crash->crash_socket_fd, EV_TIMEOUT | EV_READ,
                crash_completed_cb, crash.get());
   event_add(crash->crash_event, &timeout);
-  CrashQueue::for_crash(crash)->on_crash_started();
+  CrashQueue::for_crash(crash)->on_crash_started(crash.get());
 
   // The crash is now owned by the event loop.
   crash.release();
@@ -399,7 +470,9 @@ static void crash_request_cb(evutil_socket_t sockfd, short ev, void* arg) {
   }
 
   pid_t crash_pid = crash->crash_pid;
-  LOG(INFO) << "received crash request for pid " << crash_pid;
+  crash->foreground = is_foreground_app(crash_pid);
+  LOG(INFO) << "received crash request for pid " << crash_pid
+            << (crash->foreground ? " (foreground)" : "");
 
   if (CrashQueue::for_crash(crash)->maybe_enqueue_crash(std::move(crash))) {
     LOG(INFO) << "enqueueing crash request for pid " << crash_pid;
@@ -429,6 +502,143 @@ static bool rename_tombstone_fd(borrowed_fd fd, borrowed_fd dirfd, const std::st
   return true;
 }
 
+// Links fd at path, first removing the artifact that a different compression setting would have
+// left at the same slot.
+static bool link_artifact(borrowed_fd fd, borrowed_fd dirfd, const std::string& path) {
+  std::string other_path = path;
+  if (android::base::EndsWith(path, kCompressedSuffix)) {
+    other_path.resize(path.size() - strlen(kCompressedSuffix));
+  } else {
+    other_path += kCompressedSuffix;
+  }
+  if (unlinkat(dirfd.get(), other_path.c_str(), 0) != 0 && errno != ENOENT) {
+    PLOG(ERROR) << "failed to unlink tombstone at " << other_path;
+  }
+  return rename_tombstone_fd(fd, dirfd, path);
+}
+
+static void log_artifact_written(DebuggerdDumpType crash_type, pid_t crash_pid,
+                                 const std::string& path) {
+  if (crash_type == kDebuggerdJavaBacktrace) {
+    LOG(ERROR) << "Traces for pid " << crash_pid << " written to: " << path;
+  } else {
+    // NOTE: Several tools parse this log message to figure out where the
+    // tombstone associated with a given native crash was written. Any changes
+    // to this message must be carefully considered.
+    LOG(ERROR) << "Tombstone written to: " << path;
+  }
+}
+
+static bool compress_artifact(borrowed_fd fd, borrowed_fd output_fd) {
+  // The temporary file is write-only; reopen it to read it back.
+  std::string fd_path = StringPrintf("/proc/self/fd/%d", fd.get());
+  unique_fd input_fd(open(fd_path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (input_fd == -1) {
+    PLOG(ERROR) << "failed to reopen artifact for compression";
+    return false;
+  }
+
+  std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+  if (!cctx) {
+    LOG(ERROR) << "failed to create zstd context";
+    return false;
+  }
+  ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
+  ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_checksumFlag, 1);
+
+  std::vector<char> in(ZSTD_CStreamInSize());
+  std::vector<char> out(ZSTD_CStreamOutSize());
+  while (true) {
+    ssize_t rc = TEMP_FAILURE_RETRY(read(input_fd.get(), in.data(), in.size()));
+    if (rc == -1) {
+      PLOG(ERROR) << "failed to read artifact for compression";
+      return false;
+    }
+
+    ZSTD_EndDirective mode = rc == 0 ? ZSTD_e_end : ZSTD_e_continue;
+    ZSTD_inBuffer input = {in.data(), static_cast<size_t>(rc), 0};
+    bool done;
+    do {
+      ZSTD_outBuffer output = {out.data(), out.size(), 0};
+      size_t remaining = ZSTD_compressStream2(cctx.get(), &output, &input, mode);
+      if (ZSTD_isError(remaining)) {
+        LOG(ERROR) << "failed to compress artifact: " << ZSTD_getErrorName(remaining);
+        return false;
+      }
+      if (!android::base::WriteFully(output_fd, out.data(), output.pos)) {
+        PLOG(ERROR) << "failed to write compressed artifact";
+        return false;
+      }
+      done = (mode == ZSTD_e_end) ? remaining == 0 : input.pos == input.size;
+    } while (!done);
+
+    if (rc == 0) {
+      return true;
+    }
+  }
+}
+
+// Compresses completed artifacts on a thread of its own, so that neither the event loop nor the
+// crashes queued behind the current one wait for it. Each artifact is linked into place once it
+// is compressed; one that fails to compress is linked uncompressed instead.
+class ArtifactCompressor {
+ public:
+  struct Job {
+    unique_fd fd;
+    const CrashQueue* queue;
+    std::string path;
+    // Called with the path the artifact was linked at.
+    std::function<void(const std::string&)> on_linked;
+  };
+
+  static ArtifactCompressor* get() {
+    static ArtifactCompressor* compressor = new ArtifactCompressor();
+    return compressor;
+  }
+
+  void enqueue(Job job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+    cv_.notify_one();
+  }
+
+ private:
+  // Keeps compression out of the way of foreground work. With the default IO scheduling class,
+  // this lowers the IO priority of the thread as well.
+  static constexpr int kNice = 10;
+
+  ArtifactCompressor() { std::thread([this] { run(); }).detach(); }
+
+  void run() {
+    if (setpriority(PRIO_PROCESS, 0, kNice) != 0) {
+      PLOG(WARNING) << "failed to lower artifact compression priority";
+    }
+    while (true) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !jobs_.empty(); });
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+      }
+      process(job);
+    }
+  }
+
+  void process(const Job& job) {
+    CrashArtifact compressed = job.queue->create_temporary_file();
+    bool ok = compress_artifact(job.fd, compressed.fd);
+    std::string path = ok ? job.path + kCompressedSuffix : job.path;
+    if (link_artifact(ok ? compressed.fd : job.fd, job.queue->dir_fd(), path) && job.on_linked) {
+      job.on_linked(path);
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Job> jobs_;
+};
+
 static void crash_completed(borrowed_fd sockfd, std::unique_ptr<Crash> crash) {
   TombstonedCrashPacket request = {};
   CrashQueue* queue = CrashQueue::for_crash(crash);
@@ -455,24 +665,34 @@ static void crash_completed(borrowed_fd sockfd, std::unique_ptr<Crash> crash) {
   }
 
   CrashArtifactPaths paths = queue->get_next_artifact_paths();
+  auto on_linked = [crash_type = crash->crash_type,
+                    crash_pid = crash->crash_pid](const std::string& path) {
+    log_artifact_written(crash_type, crash_pid, path);
+  };
+
+  if (queue->compress_artifacts()) {
+    ArtifactCompressor* compressor = ArtifactCompressor::get();
+    if (crash->output.proto && crash->output.proto->fd != -1) {
+      if (!paths.proto) {
+        LOG(ERROR) << "missing path for proto tombstone";
+      } else {
+        compressor->enqueue({std::move(crash->output.proto->fd), queue, *paths.proto, nullptr});
+      }
+    }
+    compressor->enqueue({std::move(crash->output.text.fd), queue, paths.text, on_linked});
+    return;
+  }
 
   if (crash->output.proto && crash->output.proto->fd != -1) {
     if (!paths.proto) {
       LOG(ERROR) << "missing path for proto tombstone";
     } else {
-      rename_tombstone_fd(crash->output.proto->fd, queue->dir_fd(), *paths.proto);
+      link_artifact(crash->output.proto->fd, queue->dir_fd(), *paths.proto);
     }
   }
 
-  if (rename_tombstone_fd(crash->output.text.fd, queue->dir_fd(), paths.text)) {
-    if (crash->crash_type == kDebuggerdJavaBacktrace) {
-      LOG(ERROR) << "Traces for pid " << crash->crash_pid << " written to: " << paths.text;
-    } else {
-      // NOTE: Several tools parse this log message to figure out where the
-      // tombstone associated with a given native crash was written. Any changes
-      // to this message must be carefully considered.
-      LOG(ERROR) << "Tombstone written to: " << paths.text;
-    }
+  if (link_artifact(crash->output.text.fd, queue->dir_fd(), paths.text)) {
+    on_linked(paths.text);
   }
 }
 
@@ -480,7 +700,7 @@ static void crash_completed_cb(evutil_socket_t sockfd, short ev, void* arg) {
   std::unique_ptr<Crash> crash(static_cast<Crash*>(arg));
   CrashQueue* queue = CrashQueue::for_crash(crash);
 
-  queue->on_crash_completed();
+  queue->on_crash_completed(crash.get());
 
   if ((ev & EV_READ) == EV_READ) {
     crash_completed(sockfd, std::move(crash));
@@ -17,6 +17,7 @@
 
 #define FB_CMD_GETVAR "getvar"
 #define FB_CMD_DOWNLOAD "download"
+#define FB_CMD_DOWNLOAD_LZ4 "download-lz4"
 #define FB_CMD_UPLOAD "upload"
 #define FB_CMD_FLASH "flash"
 #define FB_CMD_ERASE "erase"
@@ -84,3 +85,11 @@
 #define FB_VAR_DMESG "dmesg"
 #define FB_VAR_BATTERY_SERIAL_NUMBER "battery-serial-number"
 #define FB_VAR_BATTERY_PART_STATUS "battery-part-status"
+#define FB_VAR_DOWNLOAD_COMPRESSION "download-compression"
+
+// The data of a "download-lz4" is a series of blocks, each one a little-endian 32-bit size followed
+// by that many bytes. Every block holds FB_LZ4_BLOCK_SIZE bytes of the download, except for the
+// last, compressed with LZ4_compress_default(). Blocks that don't compress are stored as they are,
+// with FB_LZ4_BLOCK_STORED set in their size.
+#define FB_LZ4_BLOCK_SIZE (1024 * 1024)
+#define FB_LZ4_BLOCK_STORED 0x80000000u
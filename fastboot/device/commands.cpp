@@ -17,11 +17,13 @@
 #include "commands.h"
 
 #include <inttypes.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
 #include <unordered_set>
 
+#include <android-base/endian.h>
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
 #include <android-base/properties.h>
@@ -37,6 +39,7 @@
 #include <liblp/builder.h>
 #include <liblp/liblp.h>
 #include <libsnapshot/snapshot.h>
+#include <lz4.h>
 #include <storage_literals/storage_literals.h>
 #include <uuid/uuid.h>
 
@@ -67,6 +70,9 @@ struct VariableHandlers {
     std::function<bool(FastbootDevice*, const std::vector<std::string>&, std::string*)> get;
     // Callback to retrieve all possible argument combinations, for getvar all.
     std::function<std::vector<std::vector<std::string>>(FastbootDevice*)> get_all_args;
+    // Whether the value only depends on partition state, and can be cached until a command
+    // modifies partitions. See FastbootDevice::variable_cache().
+    bool cached = false;
 };
 
 static bool IsSnapshotUpdateInProgress(FastbootDevice* device) {
@@ -87,11 +93,30 @@ static bool IsProtectedPartitionDuringMerge(FastbootDevice* device, const std::s
     return IsSnapshotUpdateInProgress(device);
 }
 
+static bool GetVariable(FastbootDevice* device, const std::string& name,
+                        const VariableHandlers& handlers, const std::vector<std::string>& args,
+                        std::string* message) {
+    if (!handlers.cached || !device->caches_enabled()) {
+        return handlers.get(device, args, message);
+    }
+
+    auto& cache = device->variable_cache();
+    std::string key = args.empty() ? name : name + ":" + android::base::Join(args, ":");
+    auto iter = cache.find(key);
+    if (iter == cache.end()) {
+        FastbootDevice::CachedVariable value;
+        value.ok = handlers.get(device, args, &value.message);
+        iter = cache.emplace(key, std::move(value)).first;
+    }
+    *message = iter->second.message;
+    return iter->second.ok;
+}
+
 static void GetAllVars(FastbootDevice* device, const std::string& name,
                        const VariableHandlers& handlers) {
     if (!handlers.get_all_args) {
         std::string message;
-        if (!handlers.get(device, std::vector<std::string>(), &message)) {
+        if (!GetVariable(device, name, handlers, std::vector<std::string>(), &message)) {
             return;
         }
         device->WriteInfo(android::base::StringPrintf("%s:%s", name.c_str(), message.c_str()));
@@ -101,7 +126,7 @@ static void GetAllVars(FastbootDevice* device, const std::string& name,
     auto all_args = handlers.get_all_args(device);
     for (const auto& args : all_args) {
         std::string message;
-        if (!handlers.get(device, args, &message)) {
+        if (!GetVariable(device, name, handlers, args, &message)) {
             continue;
         }
         std::string arg_string = android::base::Join(args, ":");
@@ -122,14 +147,15 @@ const std::unordered_map<std::string, VariableHandlers> kVariableMap = {
         {FB_VAR_SECURE, {GetSecure, nullptr}},
         {FB_VAR_UNLOCKED, {GetUnlocked, nullptr}},
         {FB_VAR_MAX_DOWNLOAD_SIZE, {GetMaxDownloadSize, nullptr}},
+        {FB_VAR_DOWNLOAD_COMPRESSION, {GetDownloadCompression, nullptr}},
         {FB_VAR_CURRENT_SLOT, {::GetCurrentSlot, nullptr}},
         {FB_VAR_SLOT_COUNT, {GetSlotCount, nullptr}},
-        {FB_VAR_HAS_SLOT, {GetHasSlot, GetAllPartitionArgsNoSlot}},
+        {FB_VAR_HAS_SLOT, {GetHasSlot, GetAllPartitionArgsNoSlot, true}},
         {FB_VAR_SLOT_SUCCESSFUL, {GetSlotSuccessful, nullptr}},
         {FB_VAR_SLOT_UNBOOTABLE, {GetSlotUnbootable, nullptr}},
-        {FB_VAR_PARTITION_SIZE, {GetPartitionSize, GetAllPartitionArgsWithSlot}},
-        {FB_VAR_PARTITION_TYPE, {GetPartitionType, GetAllPartitionArgsWithSlot}},
-        {FB_VAR_IS_LOGICAL, {GetPartitionIsLogical, GetAllPartitionArgsWithSlot}},
+        {FB_VAR_PARTITION_SIZE, {GetPartitionSize, GetAllPartitionArgsWithSlot, true}},
+        {FB_VAR_PARTITION_TYPE, {GetPartitionType, GetAllPartitionArgsWithSlot, true}},
+        {FB_VAR_IS_LOGICAL, {GetPartitionIsLogical, GetAllPartitionArgsWithSlot, true}},
         {FB_VAR_IS_USERSPACE, {GetIsUserspace, nullptr}},
         {FB_VAR_IS_FORCE_DEBUGGABLE, {GetIsForceDebuggable, nullptr}},
         {FB_VAR_OFF_MODE_CHARGE_STATE, {GetOffModeChargeState, nullptr}},
@@ -138,7 +164,7 @@ const std::unordered_map<std::string, VariableHandlers> kVariableMap = {
         {FB_VAR_BATTERY_SOC_OK, {GetBatterySoCOk, nullptr}},
         {FB_VAR_HW_REVISION, {GetHardwareRevision, nullptr}},
         {FB_VAR_SUPER_PARTITION_NAME, {GetSuperPartitionName, nullptr}},
-        {FB_VAR_SNAPSHOT_UPDATE_STATUS, {GetSnapshotUpdateStatus, nullptr}},
+        {FB_VAR_SNAPSHOT_UPDATE_STATUS, {GetSnapshotUpdateStatus, nullptr, true}},
         {FB_VAR_CPU_ABI, {GetCpuAbi, nullptr}},
         {FB_VAR_SYSTEM_FINGERPRINT, {GetSystemFingerprint, nullptr}},
         {FB_VAR_VENDOR_FINGERPRINT, {GetVendorFingerprint, nullptr}},
@@ -193,7 +219,7 @@ bool GetVarHandler(FastbootDevice* device, const std::vector<std::string>& args)
 
     std::string message;
     std::vector<std::string> getvar_args(args.begin() + 2, args.end());
-    if (!found_variable->second.get(device, getvar_args, &message)) {
+    if (!GetVariable(device, args[1], found_variable->second, getvar_args, &message)) {
         return device->WriteFail(message);
     }
     return device->WriteOkay(message);
@@ -317,6 +343,114 @@ bool DownloadHandler(FastbootDevice* device, const std::vector<std::string>& arg
     return device->WriteStatus(FastbootResult::FAIL, "Couldn't download data");
 }
 
+// Receives |compressed_size| bytes of LZ4 blocks, and decompresses them into the download buffer as
+// they arrive. All of the data is read even if it turns out to be invalid, so that the next command
+// isn't read from the middle of it.
+static bool ReceiveLz4Download(FastbootDevice* device, size_t compressed_size) {
+    constexpr size_t kReadSize = 1024 * 1024;
+    std::vector<char>& out = device->download_data();
+    const size_t max_block_size = LZ4_compressBound(FB_LZ4_BLOCK_SIZE);
+    std::vector<char> in;
+    size_t out_offset = 0;
+    bool valid = true;
+
+    for (size_t remaining = compressed_size;;) {
+        // Decompress every complete block that has been read.
+        size_t pos = 0;
+        while (valid && in.size() - pos >= sizeof(uint32_t)) {
+            uint32_t header;
+            memcpy(&header, in.data() + pos, sizeof(header));
+            header = le32toh(header);
+            size_t block_size = header & ~FB_LZ4_BLOCK_STORED;
+            size_t raw_size = std::min<size_t>(FB_LZ4_BLOCK_SIZE, out.size() - out_offset);
+            if (raw_size == 0 || block_size > max_block_size) {
+                LOG(ERROR) << "Invalid LZ4 block at offset " << out_offset;
+                valid = false;
+                break;
+            }
+            if (in.size() - pos - sizeof(header) < block_size) {
+                break;
+            }
+
+            const char* block = in.data() + pos + sizeof(header);
+            if (header & FB_LZ4_BLOCK_STORED) {
+                valid = block_size == raw_size;
+                if (valid) memcpy(out.data() + out_offset, block, raw_size);
+            } else {
+                valid = LZ4_decompress_safe(block, out.data() + out_offset, block_size, raw_size) ==
+                        static_cast<int>(raw_size);
+            }
+            if (!valid) {
+                LOG(ERROR) << "Failed to decompress LZ4 block at offset " << out_offset;
+                break;
+            }
+            out_offset += raw_size;
+            pos += sizeof(header) + block_size;
+        }
+        if (!valid) {
+            in.clear();
+        } else {
+            in.erase(in.begin(), in.begin() + pos);
+        }
+
+        if (remaining == 0) {
+            break;
+        }
+        size_t n = std::min(remaining, kReadSize);
+        size_t old_size = in.size();
+        in.resize(old_size + n);
+        if (!device->HandleData(true, in.data() + old_size, n)) {
+            return false;
+        }
+        remaining -= n;
+    }
+
+    if (valid && (!in.empty() || out_offset != out.size())) {
+        LOG(ERROR) << "LZ4 download has " << out_offset << " bytes, expected " << out.size();
+        valid = false;
+    }
+    return valid;
+}
+
+bool DownloadLz4Handler(FastbootDevice* device, const std::vector<std::string>& args) {
+    if (args.size() < 3) {
+        return device->WriteStatus(FastbootResult::FAIL, "size arguments unspecified");
+    }
+
+    if (GetDeviceLockStatus()) {
+        return device->WriteStatus(FastbootResult::FAIL,
+                                   "Download is not allowed on locked devices");
+    }
+
+    // arg[1] is the size of the compressed data that will be sent, and arg[2] the size of the
+    // download once decompressed. Both should always be 8 bytes.
+    if (args[1].length() != 8 || args[2].length() != 8) {
+        return device->WriteStatus(FastbootResult::FAIL, "Invalid size (length of size != 8)");
+    }
+    unsigned int compressed_size;
+    unsigned int size;
+    if (!android::base::ParseUint("0x" + args[1], &compressed_size) ||
+        !android::base::ParseUint("0x" + args[2], &size, kMaxDownloadSizeDefault)) {
+        return device->WriteStatus(FastbootResult::FAIL, "Invalid size");
+    }
+    if (compressed_size == 0 || size == 0) {
+        return device->WriteStatus(FastbootResult::FAIL, "Invalid size (0)");
+    }
+    device->download_data().resize(size);
+    if (!device->WriteStatus(FastbootResult::DATA,
+                             android::base::StringPrintf("%08x", compressed_size))) {
+        return false;
+    }
+
+    if (ReceiveLz4Download(device, compressed_size)) {
+        return device->WriteStatus(FastbootResult::OKAY, "");
+    }
+
+    device->download_data().clear();
+    LOG(ERROR) << "Couldn't download data";
+    return device->WriteStatus(FastbootResult::FAIL, "Couldn't download data");
+}
+
 bool SetActiveHandler(FastbootDevice* device, const std::vector<std::string>& args) {
     if (args.size() < 2) {
         return device->WriteStatus(FastbootResult::FAIL, "Missing slot argument");
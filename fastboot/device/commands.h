@@ -35,6 +35,7 @@ enum class FastbootResult {
 using CommandHandler = std::function<bool(FastbootDevice*, const std::vector<std::string>&)>;
 
 bool DownloadHandler(FastbootDevice* device, const std::vector<std::string>& args);
+bool DownloadLz4Handler(FastbootDevice* device, const std::vector<std::string>& args);
 bool SetActiveHandler(FastbootDevice* device, const std::vector<std::string>& args);
 bool ShutDownHandler(FastbootDevice* device, const std::vector<std::string>& args);
 bool RebootHandler(FastbootDevice* device, const std::vector<std::string>& args);
@@ -93,6 +93,7 @@ FastbootDevice::FastbootDevice()
     : kCommandMap({
               {FB_CMD_SET_ACTIVE, SetActiveHandler},
               {FB_CMD_DOWNLOAD, DownloadHandler},
+              {FB_CMD_DOWNLOAD_LZ4, DownloadLz4Handler},
               {FB_CMD_GETVAR, GetVarHandler},
               {FB_CMD_SHUTDOWN, ShutDownHandler},
               {FB_CMD_REBOOT, RebootHandler},
@@ -237,12 +238,31 @@ void FastbootDevice::ExecuteCommands() {
             WriteStatus(FastbootResult::FAIL, "Unrecognized command " + args[0]);
             continue;
         }
-        if (!found_command->second(this, args)) {
+
+        // Drop the caches on both sides of a command that can modify partitions, so it never
+        // sees stale metadata and subsequent getvars see its changes.
+        bool read_only = cmd_name == FB_CMD_GETVAR || cmd_name == FB_CMD_DOWNLOAD ||
+                         cmd_name == FB_CMD_DOWNLOAD_LZ4;
+        if (!read_only) {
+            DropCaches();
+        }
+        caches_enabled_ = read_only;
+        bool keep_going = found_command->second(this, args);
+        if (!read_only) {
+            DropCaches();
+        }
+        if (!keep_going) {
             return;
         }
     }
 }
 
+void FastbootDevice::DropCaches() {
+    caches_enabled_ = false;
+    variable_cache_.clear();
+    metadata_cache_.clear();
+}
+
 bool FastbootDevice::WriteOkay(const std::string& message) {
     return WriteStatus(FastbootResult::OKAY, message);
 }
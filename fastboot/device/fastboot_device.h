@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -25,6 +26,7 @@
 #include <BootControlClient.h>
 #include <aidl/android/hardware/fastboot/IFastboot.h>
 #include <aidl/android/hardware/health/IHealth.h>
+#include <liblp/liblp.h>
 
 #include "commands.h"
 #include "transport.h"
@@ -59,7 +61,23 @@ class FastbootDevice {
 
     void set_active_slot(const std::string& active_slot) { active_slot_ = active_slot; }
 
+    // Host tools issue long runs of getvar commands while flashing, most of which end up reading
+    // super metadata. Results are cached for as long as only getvar and download commands run;
+    // any other command may change partitions or the active slot, so it drops the caches.
+    struct CachedVariable {
+        bool ok;
+        std::string message;
+    };
+    bool caches_enabled() const { return caches_enabled_; }
+    std::unordered_map<std::string, CachedVariable>& variable_cache() { return variable_cache_; }
+    std::map<std::pair<std::string, uint32_t>, std::shared_ptr<const android::fs_mgr::LpMetadata>>&
+    metadata_cache() {
+        return metadata_cache_;
+    }
+
   private:
+    void DropCaches();
+
     const std::unordered_map<std::string, CommandHandler> kCommandMap;
 
     std::unique_ptr<Transport> transport_;
@@ -68,4 +86,9 @@ class FastbootDevice {
     std::shared_ptr<aidl::android::hardware::fastboot::IFastboot> fastboot_hal_;
     std::vector<char> download_data_;
     std::string active_slot_;
+
+    bool caches_enabled_ = false;
+    std::unordered_map<std::string, CachedVariable> variable_cache_;
+    std::map<std::pair<std::string, uint32_t>, std::shared_ptr<const android::fs_mgr::LpMetadata>>
+            metadata_cache_;
 };
@@ -37,6 +37,7 @@
 #include <liblp/builder.h>
 #include <liblp/liblp.h>
 #include <libsnapshot/snapshot.h>
+#include <liburing.h>
 #include <sparse/sparse.h>
 
 #include "fastboot_device.h"
@@ -74,6 +75,201 @@ void WipeOverlayfsForPartition(FastbootDevice* device, const std::string& partit
     }
 }
 
+// Writes a partition through io_uring, from a small ring of buffers, so that decoding the sparse
+// image and filling the next buffer overlap with the block device writing the previous ones.
+class AsyncPartitionWriter {
+  public:
+    static constexpr size_t kBufferSize = 1048576;
+    static constexpr unsigned kBufferCount = 4;
+
+    explicit AsyncPartitionWriter(PartitionHandle* handle) : handle_(handle) {}
+    ~AsyncPartitionWriter();
+
+    // Returns false if io_uring isn't available.
+    bool Init();
+    int Write(const char* data, size_t len);
+    int Skip(size_t len);
+    // Waits for all of the writes, and returns the first error.
+    int Finish();
+
+  private:
+    struct Buffer {
+        std::unique_ptr<void, decltype(&free)> data{nullptr, free};
+        size_t len = 0;
+        bool in_flight = false;
+    };
+
+    int Submit();
+    int Reap();
+    int Drain();
+
+    PartitionHandle* handle_;
+    struct io_uring ring_;
+    bool ring_initialized_ = false;
+    bool ring_failed_ = false;
+    Buffer buffers_[kBufferCount];
+    unsigned current_ = 0;
+    unsigned in_flight_ = 0;
+    uint64_t offset_ = 0;
+};
+
+AsyncPartitionWriter::~AsyncPartitionWriter() {
+    if (ring_initialized_) {
+        // The kernel may still be reading the buffers.
+        Drain();
+        for (auto& buffer : buffers_) {
+            if (buffer.in_flight) {
+                buffer.data.release();
+            }
+        }
+        io_uring_queue_exit(&ring_);
+    }
+}
+
+bool AsyncPartitionWriter::Init() {
+    int ret = io_uring_queue_init(kBufferCount, &ring_, 0);
+    if (ret < 0) {
+        LOG(WARNING) << "io_uring_queue_init failed, writing synchronously: " << strerror(-ret);
+        return false;
+    }
+    ring_initialized_ = true;
+
+    for (auto& buffer : buffers_) {
+        void* data;
+        if (posix_memalign(&data, 4096, kBufferSize)) {
+            PLOG(ERROR) << "Failed to allocate write buffer";
+            return false;
+        }
+        buffer.data.reset(data);
+    }
+    return true;
+}
+
+int AsyncPartitionWriter::Write(const char* data, size_t len) {
+    while (len > 0) {
+        Buffer& buffer = buffers_[current_];
+        size_t n = std::min(kBufferSize - buffer.len, len);
+        memcpy(static_cast<char*>(buffer.data.get()) + buffer.len, data, n);
+        buffer.len += n;
+        data += n;
+        len -= n;
+        if (buffer.len == kBufferSize) {
+            if (int ret = Submit(); ret < 0) {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+int AsyncPartitionWriter::Skip(size_t len) {
+    if (int ret = Submit(); ret < 0) {
+        return ret;
+    }
+    offset_ += len;
+    return 0;
+}
+
+int AsyncPartitionWriter::Finish() {
+    int ret = Submit();
+    int drain_ret = Drain();
+    return ret < 0 ? ret : drain_ret;
+}
+
+int AsyncPartitionWriter::Submit() {
+    Buffer& buffer = buffers_[current_];
+    if (buffer.len == 0) {
+        return 0;
+    }
+    if (ring_failed_) {
+        return -EIO;
+    }
+
+    // In case of non 4KB aligned writes, reopen without O_DIRECT flag
+    if ((buffer.len | offset_) & 0xFFF) {
+        if (int ret = Drain(); ret < 0) {
+            return ret;
+        }
+        if (handle_->Reset(O_WRONLY) != true) {
+            PLOG(ERROR) << "Failed to reset file descriptor";
+            return -EIO;
+        }
+    }
+
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    if (sqe == nullptr) {
+        LOG(ERROR) << "Submission queue run out of space.";
+        return -EIO;
+    }
+    io_uring_prep_write(sqe, handle_->fd(), buffer.data.get(), buffer.len, offset_);
+    io_uring_sqe_set_data(sqe, &buffer);
+    int ret = io_uring_submit(&ring_);
+    if (ret < 0) {
+        LOG(ERROR) << "io_uring_submit failed: " << strerror(-ret);
+        return ret;
+    }
+    buffer.in_flight = true;
+    in_flight_++;
+    offset_ += buffer.len;
+
+    current_ = (current_ + 1) % kBufferCount;
+    while (buffers_[current_].in_flight && !ring_failed_) {
+        if (ret = Reap(); ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int AsyncPartitionWriter::Reap() {
+    struct io_uring_cqe* cqe;
+    int ret;
+    do {
+        ret = io_uring_wait_cqe(&ring_, &cqe);
+    } while (ret == -EINTR);
+    if (ret < 0) {
+        LOG(ERROR) << "io_uring_wait_cqe failed: " << strerror(-ret);
+        ring_failed_ = true;
+        return ret;
+    }
+    Buffer* buffer = static_cast<Buffer*>(io_uring_cqe_get_data(cqe));
+    int res = cqe->res;
+    io_uring_cqe_seen(&ring_, cqe);
+
+    size_t len = buffer->len;
+    buffer->in_flight = false;
+    buffer->len = 0;
+    in_flight_--;
+    if (res < 0) {
+        LOG(ERROR) << "Failed to flash data of len " << len << ": " << strerror(-res);
+        return res;
+    }
+    if (static_cast<size_t>(res) != len) {
+        LOG(ERROR) << "Short write flashing data of len " << len << ": " << res;
+        return -EIO;
+    }
+    return 0;
+}
+
+int AsyncPartitionWriter::Drain() {
+    int ret = 0;
+    while (in_flight_ > 0 && !ring_failed_) {
+        int reap_ret = Reap();
+        if (reap_ret < 0 && ret == 0) {
+            ret = reap_ret;
+        }
+    }
+    return ret;
+}
+
+int AsyncWriteCallback(void* priv, const void* data, size_t len) {
+    AsyncPartitionWriter* writer = reinterpret_cast<AsyncPartitionWriter*>(priv);
+    if (!data) {
+        return writer->Skip(len);
+    }
+    return writer->Write(reinterpret_cast<const char*>(data), len);
+}
+
 }  // namespace
 
 int FlashRawDataChunk(PartitionHandle* handle, const char* data, size_t len) {
@@ -131,7 +327,8 @@ int WriteCallback(void* priv, const void* data, size_t len) {
     return FlashRawDataChunk(handle, reinterpret_cast<const char*>(data), len);
 }
 
-int FlashSparseData(PartitionHandle* handle, std::vector<char>& downloaded_data) {
+int FlashSparseData(std::vector<char>& downloaded_data,
+                    int (*write)(void* priv, const void* data, size_t len), void* priv) {
     struct sparse_file* file = sparse_file_import_buf(downloaded_data.data(),
                                                       downloaded_data.size(), true, false);
     if (!file) {
@@ -139,17 +336,33 @@ int FlashSparseData(PartitionHandle* handle, std::vector<char>& downloaded_data)
         LOG(ERROR) << "Unable to open sparse data for flashing";
         return -EINVAL;
     }
-    return sparse_file_callback(file, false, false, WriteCallback, reinterpret_cast<void*>(handle));
+    int ret = sparse_file_callback(file, false, false, write, priv);
+    sparse_file_destroy(file);
+    return ret;
 }
 
 int FlashBlockDevice(PartitionHandle* handle, std::vector<char>& downloaded_data) {
     lseek64(handle->fd(), 0, SEEK_SET);
-    if (downloaded_data.size() >= sizeof(SPARSE_HEADER_MAGIC) &&
-        *reinterpret_cast<uint32_t*>(downloaded_data.data()) == SPARSE_HEADER_MAGIC) {
-        return FlashSparseData(handle, downloaded_data);
-    } else {
+    bool sparse = downloaded_data.size() >= sizeof(SPARSE_HEADER_MAGIC) &&
+                  *reinterpret_cast<uint32_t*>(downloaded_data.data()) == SPARSE_HEADER_MAGIC;
+
+    AsyncPartitionWriter writer(handle);
+    if (!writer.Init()) {
+        if (sparse) {
+            return FlashSparseData(downloaded_data, WriteCallback,
+                                   reinterpret_cast<void*>(handle));
+        }
         return FlashRawData(handle, downloaded_data);
     }
+
+    int ret;
+    if (sparse) {
+        ret = FlashSparseData(downloaded_data, AsyncWriteCallback, &writer);
+    } else {
+        ret = writer.Write(downloaded_data.data(), downloaded_data.size());
+    }
+    int finish_ret = writer.Finish();
+    return ret < 0 ? ret : finish_ret;
 }
 
 static void CopyAVBFooter(std::vector<char>* data, const uint64_t block_device_size) {
@@ -104,6 +104,24 @@ std::optional<std::string> FindPhysicalPartition(const std::string& name) {
     return path;
 }
 
+// Returns the super metadata for |slot_number|, reading it at most once while the device's
+// caches are enabled.
+static std::shared_ptr<const LpMetadata> ReadSuperMetadata(FastbootDevice* device,
+                                                           const std::string& super_partition,
+                                                           uint32_t slot_number) {
+    if (!device->caches_enabled()) {
+        return ReadMetadata(super_partition, slot_number);
+    }
+
+    auto& cache = device->metadata_cache();
+    auto key = std::make_pair(super_partition, slot_number);
+    auto iter = cache.find(key);
+    if (iter == cache.end()) {
+        iter = cache.emplace(key, ReadMetadata(super_partition, slot_number)).first;
+    }
+    return iter->second;
+}
+
 static const LpMetadataPartition* FindLogicalPartition(const LpMetadata& metadata,
                                                        const std::string& name) {
     for (const auto& partition : metadata.partitions) {
@@ -122,7 +140,7 @@ bool LogicalPartitionExists(FastbootDevice* device, const std::string& name, boo
         return false;
     }
 
-    std::unique_ptr<LpMetadata> metadata = ReadMetadata(path->c_str(), slot_number);
+    auto metadata = ReadSuperMetadata(device, *path, slot_number);
     if (!metadata) {
         return false;
     }
@@ -166,18 +184,18 @@ std::vector<std::string> ListPartitions(FastbootDevice* device) {
 
     // Find metadata in each super partition (on retrofit devices, there will
     // be two).
-    std::vector<std::unique_ptr<LpMetadata>> metadata_list;
+    std::vector<std::shared_ptr<const LpMetadata>> metadata_list;
 
     uint32_t current_slot = SlotNumberForSlotSuffix(device->GetCurrentSlot());
     std::string super_name = fs_mgr_get_super_partition_name(current_slot);
-    if (auto metadata = ReadMetadata(super_name, current_slot)) {
+    if (auto metadata = ReadSuperMetadata(device, super_name, current_slot)) {
         metadata_list.emplace_back(std::move(metadata));
     }
 
     uint32_t other_slot = (current_slot == 0) ? 1 : 0;
     std::string other_super = fs_mgr_get_super_partition_name(other_slot);
     if (super_name != other_super) {
-        if (auto metadata = ReadMetadata(other_super, other_slot)) {
+        if (auto metadata = ReadSuperMetadata(device, other_super, other_slot)) {
             metadata_list.emplace_back(std::move(metadata));
         }
     }
@@ -283,6 +283,12 @@ bool GetMaxDownloadSize(FastbootDevice* /* device */, const std::vector<std::str
     return true;
 }
 
+bool GetDownloadCompression(FastbootDevice* /* device */,
+                            const std::vector<std::string>& /* args */, std::string* message) {
+    *message = "lz4";
+    return true;
+}
+
 bool GetUnlocked(FastbootDevice* /* device */, const std::vector<std::string>& /* args */,
                  std::string* message) {
     *message = GetDeviceLockStatus() ? "no" : "yes";
@@ -42,10 +42,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <regex>
 #include <string>
 #include <thread>
@@ -84,6 +86,12 @@
 #include "util.h"
 #include "vendor_boot_img_utils.h"
 
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <poll.h>
+#include <sys/wait.h>
+#endif
+
 using android::base::borrowed_fd;
 using android::base::ReadFully;
 using android::base::Split;
@@ -94,6 +102,14 @@ using namespace std::placeholders;
 #define FASTBOOT_INFO_VERSION 1
 
 static const char* serial = nullptr;
+// Every -s option, for flashing several devices at once.
+static std::vector<std::string> g_serials;
+// When flashing several devices, the images in the update zip are extracted here once, before
+// starting a process per device.
+static std::string g_update_images_dir;
+// Where images extracted from zips are kept between runs, if anywhere.
+static std::string g_image_cache_dir;
+static constexpr uint64_t DEFAULT_IMAGE_CACHE_SIZE = 16ULL * 1024 * 1024 * 1024;
 
 static bool g_long_listing = false;
 // Don't resparse files in too-big chunks.
@@ -109,6 +125,7 @@ static std::string g_dtb_path;
 
 static bool g_disable_verity = false;
 static bool g_disable_verification = false;
+static bool g_disable_download_compression = false;
 
 fastboot::FastBootDriver* fb = nullptr;
 
@@ -621,6 +638,8 @@ static int show_help() {
             " -w                         Wipe userdata.\n"
             " -s SERIAL                  Specify a USB device.\n"
             " -s tcp|udp:HOST[:PORT]     Specify a network device.\n"
+            "                            Repeat -s to run the commands on several devices\n"
+            "                            at once.\n"
             " -S SIZE[K|M|G]             Break into sparse files no larger than SIZE.\n"
             " --force                    Force a flash operation that may be unsafe.\n"
             " --slot SLOT                Use SLOT; 'all' for both slots, 'other' for\n"
@@ -633,6 +652,15 @@ static int show_help() {
             " --disable-super-optimization\n"
             "                            Disables optimizations on flashing super partition.\n"
             " --disable-fastboot-info    Will collects tasks from image list rather than $OUT/fastboot-info.txt.\n"
+            " --disable-download-compression\n"
+            "                            Don't compress downloads, even if the device\n"
+            "                            supports it.\n"
+            " --image-cache DIR          Keep images extracted from zips in DIR, to reuse\n"
+            "                            in later runs (default: $FASTBOOT_IMAGE_CACHE).\n"
+            "                            The least recently used images are removed once\n"
+            "                            the cache is over $FASTBOOT_IMAGE_CACHE_SIZE\n"
+            "                            (default: 16G).\n"
+            " --no-image-cache           Don't use the image cache.\n"
             " --fs-options=OPTION[,OPTION]\n"
             "                            Enable filesystem features. OPTION supports casefold, projid, compress\n"
             // TODO: remove --unbuffered?
@@ -778,9 +806,109 @@ static int make_temporary_fd(const char* what) {
 
 #endif
 
-static unique_fd UnzipToFile(ZipArchiveHandle zip, const char* entry_name) {
-    unique_fd fd(make_temporary_fd(entry_name));
+#if !defined(_WIN32)
+
+// Images in the cache are named after the CRC and size from the zip's central directory, so that a
+// lookup doesn't need to read the image.
+static std::string ImageCachePath(const ZipEntry64& entry, const char* entry_name) {
+    std::string name = android::base::Basename(entry_name);
+    return android::base::StringPrintf("%s/%08x-%016" PRIx64 "-%s", g_image_cache_dir.c_str(),
+                                       entry.crc32, entry.uncompressed_length, name.c_str());
+}
+
+// Removes the least recently used images until the cache fits in its size limit. |keep| is never
+// removed.
+static void TrimImageCache(const std::string& keep) {
+    uint64_t limit = DEFAULT_IMAGE_CACHE_SIZE;
+    if (const char* size = getenv("FASTBOOT_IMAGE_CACHE_SIZE")) {
+        if (!android::base::ParseByteCount(size, &limit)) {
+            die("invalid FASTBOOT_IMAGE_CACHE_SIZE %s", size);
+        }
+    }
+
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(g_image_cache_dir.c_str()), closedir);
+    if (!dir) {
+        return;
+    }
+    std::vector<std::pair<time_t, std::string>> files;
+    uint64_t total = 0;
+    while (dirent* de = readdir(dir.get())) {
+        std::string path = g_image_cache_dir + "/" + de->d_name;
+        struct stat st;
+        if (de->d_name[0] == '.' || stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        total += st.st_size;
+        if (path != keep) {
+            files.emplace_back(st.st_mtime, path);
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+    for (const auto& [mtime, path] : files) {
+        if (total <= limit) {
+            break;
+        }
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && unlink(path.c_str()) == 0) {
+            total -= st.st_size;
+        }
+    }
+}
+
+// Returns the image from the cache, extracting it there first if needed. Returns an invalid fd if
+// the cache can't be used, so that the caller extracts to a temporary file instead.
+static unique_fd UnzipToCache(ZipArchiveHandle zip, ZipEntry64* entry, const char* entry_name) {
+    std::string path = ImageCachePath(*entry, entry_name);
+    unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    struct stat st;
+    if (fd >= 0 && fstat(fd.get(), &st) == 0 &&
+        static_cast<uint64_t>(st.st_size) == entry->uncompressed_length) {
+        fprintf(stderr, "using cached %s (%" PRIu64 " MB)\n", entry_name,
+                entry->uncompressed_length / 1024 / 1024);
+        // The modification time records use, for trimming.
+        utimes(path.c_str(), nullptr);
+        return fd;
+    }
+
+    if (mkdir(g_image_cache_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "not caching %s: failed to create %s: %s\n", entry_name,
+                g_image_cache_dir.c_str(), strerror(errno));
+        return unique_fd();
+    }
+    // Extract under a temporary name, so that another fastboot never sees a partial image.
+    std::string tmp_path = g_image_cache_dir + "/.tmp-XXXXXX";
+    fd.reset(mkstemp(&tmp_path[0]));
+    if (fd < 0) {
+        fprintf(stderr, "not caching %s: failed to create temporary file in %s: %s\n",
+                entry_name, g_image_cache_dir.c_str(), strerror(errno));
+        return unique_fd();
+    }
+
+    fprintf(stderr, "extracting %s (%" PRIu64 " MB) to cache...", entry_name,
+            entry->uncompressed_length / 1024 / 1024);
+    double start = now();
+    int error = ExtractEntryToFile(zip, entry, fd.get());
+    if (error != 0) {
+        unlink(tmp_path.c_str());
+        die("\nfailed to extract '%s': %s", entry_name, ErrorCodeString(error));
+    }
+    if (fchmod(fd.get(), 0444) != 0 || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "\nnot caching %s: %s", entry_name, strerror(errno));
+        unlink(tmp_path.c_str());
+    }
+    if (lseek(fd.get(), 0, SEEK_SET) != 0) {
+        die("\nlseek on extracted file '%s' failed: %s", entry_name, strerror(errno));
+    }
+    fprintf(stderr, " took %.3fs\n", now() - start);
+
+    TrimImageCache(path);
+    return fd;
+}
 
+#endif
+
+static unique_fd UnzipToFile(ZipArchiveHandle zip, const char* entry_name) {
     ZipEntry64 zip_entry;
     if (FindEntry(zip, entry_name, &zip_entry) != 0) {
         fprintf(stderr, "archive does not contain '%s'\n", entry_name);
@@ -788,6 +916,17 @@ static unique_fd UnzipToFile(ZipArchiveHandle zip, const char* entry_name) {
         return unique_fd();
     }
 
+#if !defined(_WIN32)
+    if (!g_image_cache_dir.empty()) {
+        unique_fd fd = UnzipToCache(zip, &zip_entry, entry_name);
+        if (fd >= 0) {
+            return fd;
+        }
+    }
+#endif
+
+    unique_fd fd(make_temporary_fd(entry_name));
+
     fprintf(stderr, "extracting %s (%" PRIu64 " MB) to disk...", entry_name,
             zip_entry.uncompressed_length / 1024 / 1024);
     double start = now();
@@ -1931,6 +2070,13 @@ bool ZipImageSource::ReadFile(const std::string& name, std::vector<char>* out) c
 }
 
 unique_fd ZipImageSource::OpenFile(const std::string& name) const {
+    if (!g_update_images_dir.empty()) {
+        std::string path = g_update_images_dir + "/" + name;
+        unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_BINARY)));
+        if (fd >= 0) {
+            return fd;
+        }
+    }
     return UnzipToFile(zip_, name.c_str());
 }
 
@@ -1973,6 +2119,197 @@ static std::string next_arg(std::vector<std::string>* args) {
     return result;
 }
 
+#if defined(_WIN32)
+
+static std::optional<int> RunOnDevices(const std::vector<std::string>& /*args*/) {
+    die("running on several devices at once isn't supported on Windows");
+}
+
+#else
+
+// Extracts the images at the top level of |filename| into |dir|, and returns their names.
+static std::vector<std::string> ExtractUpdateImages(const std::string& filename,
+                                                    const std::string& dir) {
+    ZipArchiveHandle zip;
+    int error = OpenArchive(filename.c_str(), &zip);
+    if (error != 0) {
+        die("failed to open zip file '%s': %s", filename.c_str(), ErrorCodeString(error));
+    }
+
+    void* cookie;
+    error = StartIteration(zip, &cookie, "", ".img");
+    if (error != 0) {
+        die("failed to iterate over '%s': %s", filename.c_str(), ErrorCodeString(error));
+    }
+
+    std::vector<std::string> names;
+    ZipEntry64 entry;
+    std::string name;
+    while ((error = Next(cookie, &entry, &name)) == 0) {
+        if (name.find('/') != std::string::npos) {
+            continue;
+        }
+        std::string path = dir + "/" + name;
+        unique_fd fd(TEMP_FAILURE_RETRY(
+                open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0600)));
+        if (fd < 0) {
+            die("failed to create '%s': %s", path.c_str(), strerror(errno));
+        }
+        names.emplace_back(name);
+
+        fprintf(stderr, "extracting %s (%" PRIu64 " MB) to disk...", name.c_str(),
+                entry.uncompressed_length / 1024 / 1024);
+        double start = now();
+        error = ExtractEntryToFile(zip, &entry, fd.get());
+        if (error != 0) {
+            die("\nfailed to extract '%s': %s", name.c_str(), ErrorCodeString(error));
+        }
+        fprintf(stderr, " took %.3fs\n", now() - start);
+    }
+    if (error != -1) {
+        die("failed to iterate over '%s': %s", filename.c_str(), ErrorCodeString(error));
+    }
+
+    EndIteration(cookie);
+    CloseArchive(zip);
+    return names;
+}
+
+struct DeviceProcess {
+    std::string serial;
+    pid_t pid;
+    unique_fd output;
+    std::string line;
+    int status;
+};
+
+// Copies what the device processes print to stdout, a line at a time with the serial in front.
+static void ForwardOutput(std::vector<DeviceProcess>& devices) {
+    std::vector<pollfd> fds;
+    for (const auto& device : devices) {
+        fds.push_back({.fd = device.output.get(), .events = POLLIN});
+    }
+
+    size_t open_count = devices.size();
+    while (open_count > 0) {
+        if (TEMP_FAILURE_RETRY(poll(fds.data(), fds.size(), -1)) < 0) {
+            die("poll failed: %s", strerror(errno));
+        }
+        for (size_t i = 0; i < devices.size(); i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            DeviceProcess& device = devices[i];
+            char buf[4096];
+            ssize_t n = TEMP_FAILURE_RETRY(read(device.output.get(), buf, sizeof(buf)));
+            if (n > 0) {
+                device.line.append(buf, n);
+            }
+            size_t pos;
+            while ((pos = device.line.find('\n')) != std::string::npos) {
+                printf("%s: %.*s\n", device.serial.c_str(), static_cast<int>(pos),
+                       device.line.c_str());
+                device.line.erase(0, pos + 1);
+            }
+            if (n <= 0) {
+                if (!device.line.empty()) {
+                    printf("%s: %s\n", device.serial.c_str(), device.line.c_str());
+                }
+                fds[i].fd = -1;
+                open_count--;
+            }
+        }
+        fflush(stdout);
+    }
+}
+
+// Runs the command line once per device given with -s, each in its own process. The images in an
+// update zip are extracted once beforehand, so that the devices share the work. Returns the exit
+// status in the parent. In the child, selects its device and returns nothing, so that the caller
+// goes on to run the commands.
+static std::optional<int> RunOnDevices(const std::vector<std::string>& args) {
+    std::string images_dir;
+    std::vector<std::string> images;
+    auto update = std::find(args.begin(), args.end(), "update");
+    if (update != args.end()) {
+        std::string filename = "update.zip";
+        if (update + 1 != args.end()) {
+            filename = *(update + 1);
+        }
+        const char* tmpdir = getenv("TMPDIR");
+        if (tmpdir == nullptr) tmpdir = P_tmpdir;
+        images_dir = std::string(tmpdir) + "/fastboot_update_XXXXXX";
+        if (mkdtemp(&images_dir[0]) == nullptr) {
+            die("failed to create temporary directory %s: %s", images_dir.c_str(),
+                strerror(errno));
+        }
+        images = ExtractUpdateImages(filename, images_dir);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    std::vector<DeviceProcess> devices;
+    for (const auto& device_serial : g_serials) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            die("pipe failed: %s", strerror(errno));
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            die("fork failed: %s", strerror(errno));
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            dup2(fds[1], STDOUT_FILENO);
+            dup2(fds[1], STDERR_FILENO);
+            close(fds[1]);
+            setvbuf(stdout, nullptr, _IOLBF, 0);
+            serial = device_serial.c_str();
+            g_update_images_dir = images_dir;
+            return std::nullopt;
+        }
+        close(fds[1]);
+        devices.push_back({.serial = device_serial, .pid = pid, .output = unique_fd(fds[0])});
+    }
+
+    ForwardOutput(devices);
+
+    int failures = 0;
+    for (auto& device : devices) {
+        if (TEMP_FAILURE_RETRY(waitpid(device.pid, &device.status, 0)) != device.pid) {
+            die("waitpid failed: %s", strerror(errno));
+        }
+        if (!WIFEXITED(device.status) || WEXITSTATUS(device.status) != 0) {
+            failures++;
+        }
+    }
+
+    for (const auto& image : images) {
+        unlink((images_dir + "/" + image).c_str());
+    }
+    if (!images_dir.empty()) {
+        rmdir(images_dir.c_str());
+    }
+
+    fprintf(stderr, "\n");
+    for (const auto& device : devices) {
+        if (WIFEXITED(device.status) && WEXITSTATUS(device.status) == 0) {
+            fprintf(stderr, "%-22s OKAY\n", device.serial.c_str());
+        } else if (WIFEXITED(device.status)) {
+            fprintf(stderr, "%-22s FAILED (exit status %d)\n", device.serial.c_str(),
+                    WEXITSTATUS(device.status));
+        } else {
+            fprintf(stderr, "%-22s FAILED (%s)\n", device.serial.c_str(),
+                    strsignal(WTERMSIG(device.status)));
+        }
+    }
+    fprintf(stderr, "Finished on %zu of %zu devices.\n", devices.size() - failures,
+            devices.size());
+    return failures == 0 ? 0 : 1;
+}
+
+#endif
+
 static void do_oem_command(const std::string& cmd, std::vector<std::string>* args) {
     if (args->empty()) syntax_error("empty oem command");
 
@@ -2226,11 +2563,14 @@ int FastBootTool::Main(int argc, char* argv[]) {
                                       {"disable-super-optimization", no_argument, 0, 0},
                                       {"exclude-dynamic-partitions", no_argument, 0, 0},
                                       {"disable-fastboot-info", no_argument, 0, 0},
+                                      {"disable-download-compression", no_argument, 0, 0},
                                       {"force", no_argument, 0, 0},
                                       {"fs-options", required_argument, 0, 0},
                                       {"header-version", required_argument, 0, 0},
                                       {"help", no_argument, 0, 'h'},
+                                      {"image-cache", required_argument, 0, 0},
                                       {"kernel-offset", required_argument, 0, 0},
+                                      {"no-image-cache", no_argument, 0, 0},
                                       {"os-patch-level", required_argument, 0, 0},
                                       {"os-version", required_argument, 0, 0},
                                       {"page-size", required_argument, 0, 0},
@@ -2252,6 +2592,10 @@ int FastBootTool::Main(int argc, char* argv[]) {
         serial = getenv("ANDROID_SERIAL");
     }
 
+    if (const char* cache = getenv("FASTBOOT_IMAGE_CACHE")) {
+        g_image_cache_dir = cache;
+    }
+
     int c;
     while ((c = getopt_long(argc, argv, "a::hls:S:vw", longopts, &longindex)) != -1) {
         if (c == 0) {
@@ -2271,6 +2615,8 @@ int FastBootTool::Main(int argc, char* argv[]) {
                 fp->should_optimize_flash_super = false;
             } else if (name == "disable-fastboot-info") {
                 fp->should_use_fastboot_info = false;
+            } else if (name == "disable-download-compression") {
+                g_disable_download_compression = true;
             } else if (name == "force") {
                 fp->force_flash = true;
             } else if (name == "fs-options") {
@@ -2279,6 +2625,10 @@ int FastBootTool::Main(int argc, char* argv[]) {
                 g_boot_img_hdr.header_version = strtoul(optarg, nullptr, 0);
             } else if (name == "dtb") {
                 g_dtb_path = optarg;
+            } else if (name == "image-cache") {
+                g_image_cache_dir = optarg;
+            } else if (name == "no-image-cache") {
+                g_image_cache_dir.clear();
             } else if (name == "kernel-offset") {
                 g_boot_img_hdr.kernel_addr = strtoul(optarg, 0, 16);
             } else if (name == "os-patch-level") {
@@ -2324,6 +2674,7 @@ int FastBootTool::Main(int argc, char* argv[]) {
                     break;
                 case 's':
                     serial = optarg;
+                    g_serials.emplace_back(optarg);
                     break;
                 case 'S':
                     if (!android::base::ParseByteCount(optarg, &fp->sparse_limit)) {
@@ -2370,6 +2721,13 @@ int FastBootTool::Main(int argc, char* argv[]) {
         return show_help();
     }
 
+    if (g_serials.size() > 1) {
+        std::vector<std::string> args(argv, argv + argc);
+        if (std::optional<int> status = RunOnDevices(args)) {
+            return *status;
+        }
+    }
+
     std::unique_ptr<Transport> transport = open_device();
     if (!transport) {
         return 1;
@@ -2382,6 +2740,7 @@ int FastBootTool::Main(int argc, char* argv[]) {
     };
 
     fastboot::FastBootDriver fastboot_driver(std::move(transport), driver_callbacks, false);
+    fastboot_driver.set_compress_downloads(!g_disable_download_compression);
     fb = &fastboot_driver;
     fp->fb = &fastboot_driver;
 
@@ -47,6 +47,7 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
+#include <lz4.h>
 #include <storage_literals/storage_literals.h>
 
 #include "constants.h"
@@ -57,6 +58,66 @@ using namespace android::storage_literals;
 
 namespace fastboot {
 
+namespace {
+
+// Compresses a download into the blocks that FB_CMD_DOWNLOAD_LZ4 takes. The whole download is
+// compressed before it is sent, since the command starts with its compressed size.
+class Lz4DownloadWriter {
+  public:
+    explicit Lz4DownloadWriter(size_t size) { out_.reserve(size / 2); }
+
+    void Write(const char* data, size_t len) {
+        while (len > 0) {
+            // Compress whole blocks straight from |data|.
+            if (block_.empty() && len >= FB_LZ4_BLOCK_SIZE) {
+                AddBlock(data, FB_LZ4_BLOCK_SIZE);
+                data += FB_LZ4_BLOCK_SIZE;
+                len -= FB_LZ4_BLOCK_SIZE;
+                continue;
+            }
+            size_t n = std::min(FB_LZ4_BLOCK_SIZE - block_.size(), len);
+            block_.insert(block_.end(), data, data + n);
+            data += n;
+            len -= n;
+            if (block_.size() == FB_LZ4_BLOCK_SIZE) {
+                AddBlock(block_.data(), block_.size());
+                block_.clear();
+            }
+        }
+    }
+
+    std::vector<char> Finish() {
+        if (!block_.empty()) {
+            AddBlock(block_.data(), block_.size());
+            block_.clear();
+        }
+        return std::move(out_);
+    }
+
+  private:
+    void AddBlock(const char* data, size_t len) {
+        size_t pos = out_.size();
+        int bound = LZ4_compressBound(len);
+        out_.resize(pos + sizeof(uint32_t) + bound);
+        char* block = out_.data() + pos + sizeof(uint32_t);
+        int n = LZ4_compress_default(data, block, len, bound);
+        uint32_t header = n;
+        if (n <= 0 || static_cast<size_t>(n) >= len) {
+            memcpy(block, data, len);
+            n = len;
+            header = len | FB_LZ4_BLOCK_STORED;
+        }
+        header = htole32(header);
+        memcpy(out_.data() + pos, &header, sizeof(header));
+        out_.resize(pos + sizeof(header) + n);
+    }
+
+    std::vector<char> out_;
+    std::vector<char> block_;
+};
+
+}  // namespace
+
 /*************************** PUBLIC *******************************/
 FastBootDriver::FastBootDriver(std::unique_ptr<Transport> transport,
                                DriverCallbacks driver_callbacks,
@@ -204,6 +265,24 @@ RetCode FastBootDriver::Download(android::base::borrowed_fd fd, size_t size, std
     }
 
     uint32_t u32size = static_cast<uint32_t>(size);
+    if (UseCompressedDownload()) {
+        static constexpr size_t MAX_MAP_SIZE = 512 * 1024 * 1024;
+        Lz4DownloadWriter writer(size);
+        for (size_t offset = 0; offset < size; offset += MAX_MAP_SIZE) {
+            size_t len = std::min(size - offset, MAX_MAP_SIZE);
+            auto mapping{android::base::MappedFile::FromFd(fd, offset, len, PROT_READ)};
+            if (!mapping) {
+                error_ = "Creating filemap failed";
+                return IO_ERROR;
+            }
+            writer.Write(mapping->data(), mapping->size());
+        }
+        std::vector<char> compressed = writer.Finish();
+        if (compressed.size() < size) {
+            return DownloadCompressed(compressed, u32size, response, info);
+        }
+    }
+
     if ((ret = DownloadCommand(u32size, response, info))) {
         return ret;
     }
@@ -234,6 +313,15 @@ RetCode FastBootDriver::Download(const std::vector<char>& buf, std::string* resp
         return BAD_ARG;
     }
 
+    if (UseCompressedDownload()) {
+        Lz4DownloadWriter writer(buf.size());
+        writer.Write(buf.data(), buf.size());
+        std::vector<char> compressed = writer.Finish();
+        if (compressed.size() < buf.size()) {
+            return DownloadCompressed(compressed, buf.size(), response, info);
+        }
+    }
+
     if ((ret = DownloadCommand(buf.size(), response, info))) {
         return ret;
     }
@@ -268,6 +356,22 @@ RetCode FastBootDriver::Download(sparse_file* s, bool use_crc, std::string* resp
 
     RetCode ret;
     uint32_t u32size = static_cast<uint32_t>(size);
+    if (UseCompressedDownload()) {
+        Lz4DownloadWriter writer(size);
+        auto cb = [](void* priv, const void* buf, size_t len) -> int {
+            static_cast<Lz4DownloadWriter*>(priv)->Write(static_cast<const char*>(buf), len);
+            return 0;
+        };
+        if (sparse_file_callback(s, true, use_crc, cb, &writer) < 0) {
+            error_ = "Error reading sparse file";
+            return IO_ERROR;
+        }
+        std::vector<char> compressed = writer.Finish();
+        if (compressed.size() < size) {
+            return DownloadCompressed(compressed, u32size, response, info);
+        }
+    }
+
     if ((ret = DownloadCommand(u32size, response, info))) {
         return ret;
     }
@@ -277,6 +381,7 @@ RetCode FastBootDriver::Download(sparse_file* s, bool use_crc, std::string* resp
         std::vector<char> tpbuf;
     } cb_priv;
     cb_priv.self = this;
+    cb_priv.tpbuf.reserve(SPARSE_BUFFER_SIZE);
 
     auto cb = [](void* priv, const void* buf, size_t len) -> int {
         SparseCBPrivate* data = static_cast<SparseCBPrivate*>(priv);
@@ -531,6 +636,9 @@ std::string FastBootDriver::ErrnoStr(const std::string& msg) {
 /******************************* PRIVATE **************************************/
 RetCode FastBootDriver::SendBuffer(android::base::borrowed_fd fd, size_t size) {
     static constexpr uint32_t MAX_MAP_SIZE = 512 * 1024 * 1024;
+    // The mapping is sent in pieces so that the kernel can read the next piece from disk while the
+    // current one is being written to the device, rather than stalling on each page fault.
+    static constexpr size_t SEND_SIZE = 8 * 1024 * 1024;
     off64_t offset = 0;
     uint32_t remaining = size;
     RetCode ret;
@@ -544,8 +652,16 @@ RetCode FastBootDriver::SendBuffer(android::base::borrowed_fd fd, size_t size) {
             return IO_ERROR;
         }
 
-        if ((ret = SendBuffer(mapping->data(), mapping->size()))) {
-            return ret;
+        const char* data = mapping->data();
+        for (size_t sent = 0; sent < len;) {
+            size_t n = std::min(len - sent, SEND_SIZE);
+            if (sent + n < len) {
+                Prefetch(fd, offset + sent + n, std::min(len - sent - n, SEND_SIZE));
+            }
+            if ((ret = SendBuffer(data + sent, n))) {
+                return ret;
+            }
+            sent += n;
         }
 
         remaining -= len;
@@ -555,6 +671,17 @@ RetCode FastBootDriver::SendBuffer(android::base::borrowed_fd fd, size_t size) {
     return SUCCESS;
 }
 
+void FastBootDriver::Prefetch(android::base::borrowed_fd fd, int64_t offset, size_t len) {
+#if defined(__linux__)
+    // Only a hint, so failures don't matter.
+    posix_fadvise(fd.get(), offset, len, POSIX_FADV_WILLNEED);
+#else
+    (void)fd;
+    (void)offset;
+    (void)len;
+#endif
+}
+
 RetCode FastBootDriver::SendBuffer(const std::vector<char>& buf) {
     // Write the buffer
     return SendBuffer(buf.data(), buf.size());
@@ -596,40 +723,81 @@ RetCode FastBootDriver::ReadBuffer(void* buf, size_t size) {
 }
 
 int FastBootDriver::SparseWriteCallback(std::vector<char>& tpbuf, const char* data, size_t len) {
-    size_t total = 0;
-    size_t to_write = std::min(TRANSPORT_CHUNK_SIZE - tpbuf.size(), len);
-
-    // Handle the residual
-    tpbuf.insert(tpbuf.end(), data, data + to_write);
-    if (tpbuf.size() < TRANSPORT_CHUNK_SIZE) {  // Nothing enough to send rn
+    // Most pieces from libsparse are chunk headers and fill values of a few bytes each, so collect
+    // them rather than paying for a transfer each time. The buffer never reaches SPARSE_BUFFER_SIZE,
+    // so when this doesn't fit, |len| is enough to fill the buffer to a multiple of the chunk size.
+    if (tpbuf.size() + len < SPARSE_BUFFER_SIZE) {
+        tpbuf.insert(tpbuf.end(), data, data + len);
         return 0;
     }
 
-    if (SendBuffer(tpbuf)) {
+    size_t to_write = (TRANSPORT_CHUNK_SIZE - tpbuf.size() % TRANSPORT_CHUNK_SIZE) %
+                      TRANSPORT_CHUNK_SIZE;
+    tpbuf.insert(tpbuf.end(), data, data + to_write);
+    data += to_write;
+    len -= to_write;
+    if (tpbuf.size() && SendBuffer(tpbuf)) {
         error_ = ErrnoStr("Send failed in SparseWriteCallback()");
         return -1;
     }
     tpbuf.clear();
-    total += to_write;
 
-    // Now we need to send a multiple of chunk size
-    size_t nchunks = (len - total) / TRANSPORT_CHUNK_SIZE;
-    size_t nbytes = TRANSPORT_CHUNK_SIZE * nchunks;
-    if (nbytes && SendBuffer(data + total, nbytes)) {  // Don't send a ZLP
+    if (len < SPARSE_BUFFER_SIZE) {
+        tpbuf.assign(data, data + len);
+        return 0;
+    }
+
+    // Send large pieces straight from libsparse's buffer, in a multiple of chunk size
+    size_t nbytes = len - len % TRANSPORT_CHUNK_SIZE;
+    if (SendBuffer(data, nbytes)) {
         error_ = ErrnoStr("Send failed in SparseWriteCallback()");
         return -1;
     }
-    total += nbytes;
 
-    if (len - total > 0) {  // We have residual data to save for next time
-        tpbuf.assign(data + total, data + len);
+    // We have residual data to save for next time
+    tpbuf.assign(data + nbytes, data + len);
+    return 0;
+}
+
+bool FastBootDriver::UseCompressedDownload() {
+    if (!compress_downloads_) {
+        return false;
+    }
+    if (!lz4_download_supported_) {
+        std::string value;
+        lz4_download_supported_ = false;
+        if (GetVar(FB_VAR_DOWNLOAD_COMPRESSION, &value) == SUCCESS) {
+            auto algorithms = android::base::Split(value, ",");
+            lz4_download_supported_ =
+                    std::find(algorithms.begin(), algorithms.end(), "lz4") != algorithms.end();
+        }
+        error_ = "";
+    }
+    return *lz4_download_supported_;
+}
+
+RetCode FastBootDriver::DownloadCompressed(const std::vector<char>& compressed, uint32_t size,
+                                           std::string* response,
+                                           std::vector<std::string>* info) {
+    RetCode ret;
+    std::string cmd(android::base::StringPrintf("%s:%08zx:%08" PRIx32, FB_CMD_DOWNLOAD_LZ4,
+                                                compressed.size(), size));
+    if ((ret = RawCommand(cmd, response, info))) {
+        return ret;
     }
 
-    return 0;
+    // Write the buffer
+    if ((ret = SendBuffer(compressed))) {
+        return ret;
+    }
+
+    // Wait for response
+    return HandleResponse(response, info);
 }
 
 void FastBootDriver::set_transport(std::unique_ptr<Transport> transport) {
     transport_ = std::move(transport);
+    lz4_download_supported_.reset();
 }
 
 }  // End namespace fastboot
@@ -30,6 +30,7 @@
 #include <functional>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -123,6 +124,8 @@ class FastBootDriver : public IFastBootDriver {
     RetCode WaitForDisconnect() override;
 
     void set_transport(std::unique_ptr<Transport> transport);
+    // Compresses downloads if the device supports it.
+    void set_compress_downloads(bool compress) { compress_downloads_ = compress; }
 
     RetCode RawCommand(const std::string& cmd, const std::string& message,
                        std::string* response = nullptr, std::vector<std::string>* info = nullptr,
@@ -145,15 +148,23 @@ class FastBootDriver : public IFastBootDriver {
     RetCode SendBuffer(android::base::borrowed_fd fd, size_t size);
     RetCode SendBuffer(const std::vector<char>& buf);
     RetCode SendBuffer(const void* buf, size_t size);
+    // Asks the kernel to start reading part of |fd| that is about to be sent.
+    static void Prefetch(android::base::borrowed_fd fd, int64_t offset, size_t len);
 
     RetCode ReadBuffer(void* buf, size_t size);
 
+    bool UseCompressedDownload();
+    RetCode DownloadCompressed(const std::vector<char>& compressed, uint32_t size,
+                               std::string* response, std::vector<std::string>* info);
+
     RetCode UploadInner(const std::string& outfile, std::string* response = nullptr,
                         std::vector<std::string>* info = nullptr);
     RetCode RunAndReadBuffer(const std::string& cmd, std::string* response,
                              std::vector<std::string>* info,
                              const std::function<RetCode(const char*, uint64_t)>& write_fn);
 
+    // How much of the sparse stream is collected before it is sent.
+    static constexpr size_t SPARSE_BUFFER_SIZE = 1024 * 1024;
     int SparseWriteCallback(std::vector<char>& tpbuf, const char* data, size_t len);
 
     std::string error_;
@@ -162,6 +173,9 @@ class FastBootDriver : public IFastBootDriver {
     std::function<void(const std::string&)> info_;
     std::function<void(const std::string&)> text_;
     bool disable_checks_;
+    bool compress_downloads_ = false;
+    // Whether the device takes "download-lz4", once asked.
+    std::optional<bool> lz4_download_supported_;
 };
 
 }  // namespace fastboot
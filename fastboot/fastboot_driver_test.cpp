@@ -19,7 +19,10 @@
 #include <memory>
 #include <optional>
 
+#include <android-base/stringprintf.h>
 #include <gtest/gtest.h>
+#include <lz4.h>
+#include "constants.h"
 #include "mock_transport.h"
 
 using namespace ::testing;
@@ -97,3 +100,60 @@ TEST_F(DriverTest, TextMessage) {
               " Indeed we can do that now with a TEXT message whenever we feel like it."
               " Isn't that truly super cool?");
 }
+
+TEST_F(DriverTest, CompressedDownload) {
+    std::unique_ptr<MockTransport> transport_pointer = std::make_unique<MockTransport>();
+    MockTransport* transport = transport_pointer.get();
+    FastBootDriver driver(std::move(transport_pointer));
+    driver.set_compress_downloads(true);
+
+    // A full block and a short one, both of which compress.
+    std::vector<char> data(FB_LZ4_BLOCK_SIZE + 4096, 'x');
+    std::vector<char> block(LZ4_compressBound(FB_LZ4_BLOCK_SIZE));
+    size_t compressed_size =
+            2 * sizeof(uint32_t) +
+            LZ4_compress_default(data.data(), block.data(), FB_LZ4_BLOCK_SIZE, block.size()) +
+            LZ4_compress_default(data.data(), block.data(), 4096, block.size());
+    std::string command = android::base::StringPrintf("download-lz4:%08zx:%08zx", compressed_size,
+                                                      data.size());
+    std::string reply = android::base::StringPrintf("DATA%08zx", compressed_size);
+
+    EXPECT_CALL(*transport, Write(_, _))
+            .With(AllArgs(RawData("getvar:download-compression")))
+            .WillOnce(ReturnArg<1>());
+    EXPECT_CALL(*transport, Read(_, _)).WillOnce(Invoke(CopyData("OKAYlz4")));
+    EXPECT_CALL(*transport, Write(_, _))
+            .With(AllArgs(RawData(command.c_str())))
+            .WillOnce(ReturnArg<1>());
+    EXPECT_CALL(*transport, Read(_, _)).WillOnce(Invoke(CopyData(reply.c_str())));
+    EXPECT_CALL(*transport, Write(_, compressed_size)).WillOnce(ReturnArg<1>());
+    EXPECT_CALL(*transport, Read(_, _)).WillOnce(Invoke(CopyData("OKAY")));
+
+    ASSERT_EQ(driver.Download(data), SUCCESS) << driver.Error();
+}
+
+TEST_F(DriverTest, CompressedDownloadUnsupported) {
+    std::unique_ptr<MockTransport> transport_pointer = std::make_unique<MockTransport>();
+    MockTransport* transport = transport_pointer.get();
+    FastBootDriver driver(std::move(transport_pointer));
+    driver.set_compress_downloads(true);
+
+    std::vector<char> data(4096, 'x');
+
+    EXPECT_CALL(*transport, Write(_, _))
+            .With(AllArgs(RawData("getvar:download-compression")))
+            .WillOnce(ReturnArg<1>());
+    EXPECT_CALL(*transport, Read(_, _)).WillOnce(Invoke(CopyData("FAILunknown variable")));
+    for (int i = 0; i < 2; i++) {
+        EXPECT_CALL(*transport, Write(_, _))
+                .With(AllArgs(RawData("download:00001000")))
+                .WillOnce(ReturnArg<1>());
+        EXPECT_CALL(*transport, Read(_, _)).WillOnce(Invoke(CopyData("DATA00001000")));
+        EXPECT_CALL(*transport, Write(_, 4096)).WillOnce(ReturnArg<1>());
+        EXPECT_CALL(*transport, Read(_, _)).WillOnce(Invoke(CopyData("OKAY")));
+    }
+
+    // The device is only asked once.
+    ASSERT_EQ(driver.Download(data), SUCCESS) << driver.Error();
+    ASSERT_EQ(driver.Download(data), SUCCESS) << driver.Error();
+}
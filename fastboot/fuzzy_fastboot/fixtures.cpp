@@ -341,4 +341,64 @@ void ExtensionsPartition<UNLOCKED>::SetUp() {
 template class ExtensionsPartition<true>;
 template class ExtensionsPartition<false>;
 
+std::string BenchmarkRecorder::output_file = "";
+
+void BenchmarkRecorder::DescribeDevice(FastBootDriver* fb) {
+    // No error checking, these only label the results
+    fb->GetVar("product", &product);
+    std::string value;
+    fb->GetVar("is-userspace", &value);
+    userspace = value == "yes";
+}
+
+void BenchmarkRecorder::Record(const std::string& metric, double value, const std::string& unit) {
+    const std::string formatted = android::base::StringPrintf("%.3f", value);
+    testing::Test::RecordProperty(metric, formatted);
+    GTEST_LOG_(INFO) << metric << ": " << formatted << " " << unit;
+
+    const testing::TestInfo* info = testing::UnitTest::GetInstance()->current_test_info();
+    // Device reported strings are the only ones that could need escaping
+    std::string escaped;
+    for (char c : product) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (c >= 0x20) escaped += c;
+    }
+    std::ofstream out(output_file, std::ios::app);
+    out << android::base::StringPrintf(
+            "{\"test\":\"%s.%s\",\"product\":\"%s\",\"fastbootd\":%s,\"metric\":\"%s\","
+            "\"value\":%s,\"unit\":\"%s\"}\n",
+            info->test_case_name(), info->name(), escaped.c_str(), userspace ? "true" : "false",
+            metric.c_str(), formatted.c_str(), unit.c_str());
+    EXPECT_TRUE(out.good()) << "Failed to write benchmark results to '" << output_file << "'";
+}
+
+void Benchmark::SetUp() {
+    if (!Enabled()) {
+        GTEST_SKIP() << "Benchmarks only run with --benchmark=<file>";
+    }
+    ASSERT_NO_FATAL_FAILURE(ModeTest<true>::SetUp());
+    DescribeDevice(fb.get());
+}
+
+void Benchmark::TearDown() {
+    // Nothing to tear down if it was skipped
+    if (fb) {
+        ModeTest<true>::TearDown();
+    }
+}
+
+void BenchmarkPartition::SetUp() {
+    if (!Enabled()) {
+        GTEST_SKIP() << "Benchmarks only run with --benchmark=<file>";
+    }
+    ASSERT_NO_FATAL_FAILURE(ExtensionsPartition<true>::SetUp());
+    DescribeDevice(fb.get());
+}
+
+void BenchmarkPartition::TearDown() {
+    if (fb) {
+        ExtensionsPartition<true>::TearDown();
+    }
+}
+
 }  // end namespace fastboot
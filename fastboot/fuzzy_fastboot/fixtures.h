@@ -143,4 +143,33 @@ class UserdataPartition : public ExtensionsPartition<true> {};
 
 class SparseTestPartition : public ExtensionsPartition<true> {};
 
+// Benchmarks are skipped unless --benchmark=<file> is given. Every result is recorded as a gtest
+// property and appended to that file as one JSON object per line, tagged with the product and
+// whether it was measured in the bootloader or fastbootd, so runs can be compared
+class BenchmarkRecorder {
+  public:
+    static std::string output_file;
+
+  protected:
+    static bool Enabled() { return !output_file.empty(); }
+    void DescribeDevice(FastBootDriver* fb);
+    void Record(const std::string& metric, double value, const std::string& unit);
+
+  private:
+    std::string product;
+    bool userspace = false;
+};
+
+class Benchmark : public ModeTest<true>, public BenchmarkRecorder {
+  protected:
+    void SetUp() override;
+    void TearDown() override;
+};
+
+class BenchmarkPartition : public ExtensionsPartition<true>, public BenchmarkRecorder {
+  protected:
+    void SetUp() override;
+    void TearDown() override;
+};
+
 }  // end namespace fastboot
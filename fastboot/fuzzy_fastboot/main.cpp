@@ -27,12 +27,14 @@
  */
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <fstream>
@@ -1790,6 +1792,207 @@ TEST_P(SparseTestPartition, SparseMultiple) {
 INSTANTIATE_TEST_CASE_P(XMLSparseTest, SparseTestPartition,
                         ::testing::ValuesIn(SINGLE_PARTITION_XML_WRITE_HASHABLE));
 
+// Benchmarks
+double ElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+}
+
+double MiBPerSec(int64_t bytes, double ms) {
+    return ms > 0 ? (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) : 0;
+}
+
+// samples must be sorted
+double Percentile(const std::vector<double>& samples, double p) {
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+}
+
+const int GETVAR_BENCHMARK_ITERATIONS = 200;
+// Flash benchmarks are limited to this much data per image, so they finish in reasonable time
+const int64_t FLASH_BENCHMARK_MAX_SIZE = 64 * 1024 * 1024;
+
+TEST_F(Benchmark, GetVarRoundTrip) {
+    std::vector<double> samples;
+    std::string var;
+    for (int i = 0; i < GETVAR_BENCHMARK_ITERATIONS; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        ASSERT_EQ(fb->GetVar("version", &var), SUCCESS) << "getvar:version failed";
+        samples.push_back(ElapsedMs(start) * 1000);
+    }
+    std::sort(samples.begin(), samples.end());
+    Record("getvar_min", samples.front(), "us");
+    Record("getvar_p50", Percentile(samples, 0.5), "us");
+    Record("getvar_p90", Percentile(samples, 0.9), "us");
+    Record("getvar_p99", Percentile(samples, 0.99), "us");
+    Record("getvar_max", samples.back(), "us");
+}
+
+// Small downloads show the per command overhead, large ones the transfer rate
+TEST_F(Benchmark, DownloadThroughput) {
+    std::string var;
+    ASSERT_EQ(fb->GetVar("max-download-size", &var), SUCCESS) << "getvar:max-download-size failed";
+    const int64_t max_dl = strtoll(var.c_str(), nullptr, 16);
+    ASSERT_GT(max_dl, 0) << "Max download size reported was invalid";
+
+    for (int64_t size = 4096; size <= std::min<int64_t>(max_dl, 256 * 1024 * 1024); size *= 4) {
+        // Random data, so compressed downloads don't make it look faster than it is
+        const std::vector<char> buf = RandomBuf(size);
+        // Move at least 64 MiB for every size, so the small ones aren't just noise
+        const int iterations = std::clamp<int64_t>((64 * 1024 * 1024) / size, 3, 100);
+        std::vector<double> samples;
+        for (int i = 0; i < iterations; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            ASSERT_EQ(fb->Download(buf), SUCCESS) << "Download of " << size << " bytes failed";
+            samples.push_back(ElapsedMs(start));
+        }
+        std::sort(samples.begin(), samples.end());
+        const std::string name =
+                android::base::StringPrintf("download_%" PRId64 "KiB", size / 1024);
+        Record(name + "_p50", Percentile(samples, 0.5), "ms");
+        Record(name + "_throughput", MiBPerSec(size, Percentile(samples, 0.5)), "MiB/s");
+    }
+}
+
+// Only fastbootd can create logical partitions
+TEST_F(Benchmark, LogicalPartitionFlash) {
+    if (!UserSpaceFastboot()) {
+        GTEST_SKIP() << "Logical partitions can only be flashed from fastbootd";
+    }
+    std::string test_partition_name = "test_partition";
+    std::string var;
+    EXPECT_EQ(fb->GetVar("slot-count", &var), SUCCESS) << "getvar slot-count failed";
+    if (strtol(var.c_str(), nullptr, 10) > 0) {
+        std::string current_slot;
+        EXPECT_EQ(fb->GetVar("current-slot", &current_slot), SUCCESS)
+                << "getvar current-slot failed";
+        test_partition_name += "_" + current_slot;
+    }
+    ASSERT_EQ(fb->GetVar("max-download-size", &var), SUCCESS) << "getvar:max-download-size failed";
+    const int64_t max_dl = strtoll(var.c_str(), nullptr, 16);
+    const int64_t size = std::min(max_dl, FLASH_BENCHMARK_MAX_SIZE) / 4096 * 4096;
+    ASSERT_GT(size, 0) << "Max download size reported was invalid";
+    const std::vector<char> buf = RandomBuf(size);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(fb->CreatePartition(test_partition_name, "0"), SUCCESS)
+            << "create-logical-partition failed";
+    Record("logical_create", ElapsedMs(start), "ms");
+
+    // From here on the partition has to be deleted again, even on failure
+    start = std::chrono::steady_clock::now();
+    EXPECT_EQ(fb->ResizePartition(test_partition_name, std::to_string(size)), SUCCESS)
+            << "resize-logical-partition failed";
+    Record("logical_resize", ElapsedMs(start), "ms");
+
+    if (!HasFailure()) {
+        start = std::chrono::steady_clock::now();
+        EXPECT_EQ(fb->Download(buf), SUCCESS) << "Download failed";
+        const double download_ms = ElapsedMs(start);
+        start = std::chrono::steady_clock::now();
+        EXPECT_EQ(fb->Flash(test_partition_name), SUCCESS) << "Flashing logical partition failed";
+        const double flash_ms = ElapsedMs(start);
+        Record("logical_download", download_ms, "ms");
+        Record("logical_flash", flash_ms, "ms");
+        Record("logical_flash_throughput", MiBPerSec(size, flash_ms), "MiB/s");
+    }
+
+    start = std::chrono::steady_clock::now();
+    EXPECT_EQ(fb->DeletePartition(test_partition_name), SUCCESS)
+            << "delete-logical-partition failed";
+    Record("logical_delete", ElapsedMs(start), "ms");
+}
+
+// Times the download and the flash of a raw image and of a sparse image of the same size, half
+// of it data and half of it a fill
+TEST_P(BenchmarkPartition, FlashLatency) {
+    const std::string part = real_parts.front();
+    const int64_t size = std::min(max_flash, FLASH_BENCHMARK_MAX_SIZE) / 4096 * 4096;
+    ASSERT_GT(size, 0) << "Partition is too small to benchmark";
+    const std::vector<char> buf = RandomBuf(size);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(fb->Download(buf), SUCCESS) << "Download failed";
+    Record(part + "_raw_download", ElapsedMs(start), "ms");
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(fb->Flash(part), SUCCESS) << "Flashing raw image failed";
+    double flash_ms = ElapsedMs(start);
+    Record(part + "_raw_flash", flash_ms, "ms");
+    Record(part + "_raw_flash_throughput", MiBPerSec(size, flash_ms), "MiB/s");
+
+    SparseWrapper sparse(4096, size);
+    ASSERT_TRUE(*sparse) << "Sparse image creation failed";
+    const int64_t data_size = std::max<int64_t>(4096, size / 2 / 4096 * 4096);
+    ASSERT_EQ(sparse_file_add_data(*sparse, const_cast<char*>(buf.data()), data_size, 0), 0)
+            << "Adding data failed to sparse file: " << sparse.Rep();
+    if (size > data_size) {
+        ASSERT_EQ(sparse_file_add_fill(*sparse, 0xdeadbeef, size - data_size, data_size / 4096),
+                  0)
+                << "Adding fill failed to sparse file: " << sparse.Rep();
+    }
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(fb->Download(*sparse), SUCCESS) << "Download sparse failed: " << sparse.Rep();
+    Record(part + "_sparse_download", ElapsedMs(start), "ms");
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(fb->Flash(part), SUCCESS) << "Flashing sparse image failed: " << sparse.Rep();
+    flash_ms = ElapsedMs(start);
+    Record(part + "_sparse_flash", flash_ms, "ms");
+    Record(part + "_sparse_flash_throughput", MiBPerSec(size, flash_ms), "MiB/s");
+}
+
+// What the fastboot tool does with a sparse image bigger than max-download-size: the host cost of
+// splitting it up, and the cost of flashing it piece by piece
+TEST_P(BenchmarkPartition, SparseResparse) {
+    const std::string part = real_parts.front();
+    const int64_t size =
+            std::min({part_size, 4 * max_dl, 4 * FLASH_BENCHMARK_MAX_SIZE}) / (1024 * 1024) *
+            (1024 * 1024);
+    ASSERT_GT(size, 0) << "Partition is too small to benchmark";
+    // Split it up even when the whole image would fit in one download
+    const int64_t limit = std::min(max_dl, size / 4);
+
+    // Alternating MiBs of data and fill; the data is shared, libsparse doesn't copy it
+    const std::vector<char> data = RandomBuf(1024 * 1024);
+    SparseWrapper sparse(4096, size);
+    ASSERT_TRUE(*sparse) << "Sparse image creation failed";
+    for (int64_t offset = 0; offset < size; offset += data.size()) {
+        const unsigned int block = offset / 4096;
+        const int ret = (offset / data.size()) % 2
+                                ? sparse_file_add_fill(*sparse, 0, data.size(), block)
+                                : sparse_file_add_data(*sparse, const_cast<char*>(data.data()),
+                                                       data.size(), block);
+        ASSERT_EQ(ret, 0) << "Building sparse file failed: " << sparse.Rep();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    const int count = sparse_file_resparse(*sparse, limit, nullptr, 0);
+    ASSERT_GT(count, 0) << "Computing the resparse boundaries failed";
+    std::vector<sparse_file*> pieces(count);
+    ASSERT_EQ(sparse_file_resparse(*sparse, limit, pieces.data(), count), count)
+            << "Resparsing failed";
+    Record(part + "_resparse", ElapsedMs(start), "ms");
+    Record(part + "_resparse_pieces", count, "files");
+    std::vector<std::unique_ptr<SparseWrapper>> owned;
+    for (sparse_file* piece : pieces) {
+        owned.emplace_back(new SparseWrapper(piece));
+    }
+
+    double download_ms = 0, flash_ms = 0;
+    for (auto& piece : owned) {
+        start = std::chrono::steady_clock::now();
+        ASSERT_EQ(fb->Download(**piece), SUCCESS) << "Download sparse failed: " << piece->Rep();
+        download_ms += ElapsedMs(start);
+        start = std::chrono::steady_clock::now();
+        ASSERT_EQ(fb->Flash(part), SUCCESS) << "Flashing sparse failed: " << piece->Rep();
+        flash_ms += ElapsedMs(start);
+    }
+    Record(part + "_resparsed_download", download_ms, "ms");
+    Record(part + "_resparsed_flash", flash_ms, "ms");
+    Record(part + "_resparsed_flash_throughput", MiBPerSec(size, download_ms + flash_ms), "MiB/s");
+}
+
+INSTANTIATE_TEST_CASE_P(XMLBenchmarkPartitions, BenchmarkPartition,
+                        ::testing::ValuesIn(PARTITION_XML_WRITEABLE));
+
 void GenerateXmlTests(const extension::Configuration& config) {
     // Build the getvar tests
     for (const auto& it : config.getvars) {
@@ -1879,6 +2082,10 @@ int main(int argc, char** argv) {
         fastboot::GenerateXmlTests(fastboot::config);
     }
 
+    if (args.find("benchmark") != args.end()) {
+        fastboot::BenchmarkRecorder::output_file = args.at("benchmark");
+    }
+
     if (args.find("serial") != args.end()) {
         fastboot::FastBootTest::device_serial = args.at("serial");
     }
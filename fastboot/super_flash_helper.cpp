@@ -16,6 +16,10 @@
 
 #include "super_flash_helper.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include <android-base/logging.h>
 
 #include "util.h"
@@ -70,6 +74,42 @@ bool SuperFlashHelper::AddPartition(const std::string& partition, const std::str
     return true;
 }
 
+void SuperFlashHelper::OpenImages(
+        const std::vector<std::pair<std::string, std::string>>& partitions) {
+    std::vector<std::string> names;
+    for (const auto& [partition, image_name] : partitions) {
+        if (IncludeInSuper(partition) && image_fds_.find(image_name) == image_fds_.end() &&
+            std::find(names.begin(), names.end(), image_name) == names.end()) {
+            names.emplace_back(image_name);
+        }
+    }
+
+    std::vector<unique_fd> fds(names.size());
+    std::atomic<size_t> next = 0;
+    auto open_images = [&]() {
+        for (size_t i; (i = next++) < names.size();) {
+            fds[i] = source_.OpenFile(names[i]);
+        }
+    };
+    size_t thread_count =
+            std::min<size_t>(names.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; i++) {
+        threads.emplace_back(open_images);
+    }
+    open_images();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Images that are missing or sparse are left for AddPartition() to report.
+    for (size_t i = 0; i < names.size(); i++) {
+        if (fds[i] >= 0 && !is_sparse_file(fds[i])) {
+            image_fds_.emplace(names[i], std::move(fds[i]));
+        }
+    }
+}
+
 SparsePtr SuperFlashHelper::GetSparseLayout() {
     // Cache extents since the sparse ptr depends on data pointers.
     if (extents_.empty()) {
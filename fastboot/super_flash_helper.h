@@ -20,6 +20,8 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 #include <liblp/liblp.h>
@@ -34,6 +36,9 @@ class SuperFlashHelper final {
     bool Open(android::base::borrowed_fd fd);
     bool IncludeInSuper(const std::string& partition);
     bool AddPartition(const std::string& partition, const std::string& image_name, bool optional);
+    // Opens the images of the given (partition, image name) pairs on several threads, ahead of
+    // AddPartition(), since extracting them from a zip is the slow part of building the layout.
+    void OpenImages(const std::vector<std::pair<std::string, std::string>>& partitions);
 
     // Note: the SparsePtr if non-null should not outlive SuperFlashHelper, since
     // it depends on open fds and data pointers.
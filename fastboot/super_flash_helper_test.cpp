@@ -86,3 +86,16 @@ TEST(SuperFlashHelper, ImageEquality) {
         ASSERT_EQ(expected[i], 0) << "byte mismatch at position " << i;
     }
 }
+
+TEST(SuperFlashHelper, OpenImages) {
+    auto super_empty_fd = OpenTestFile("super_empty.img", O_RDONLY);
+    ASSERT_GE(super_empty_fd, 0);
+
+    TestImageSource source;
+    SuperFlashHelper helper(source);
+    ASSERT_TRUE(helper.Open(super_empty_fd));
+    helper.OpenImages({{"system_a", "system.img"}, {"vendor_a", "missing.img"}});
+    ASSERT_TRUE(helper.AddPartition("system_a", "system.img", false));
+    ASSERT_TRUE(helper.WillFlash("system_a"));
+    ASSERT_NE(helper.GetSparseLayout(), nullptr);
+}
@@ -208,6 +208,14 @@ std::unique_ptr<OptimizedFlashSuperTask> OptimizedFlashSuperTask::Initialize(
         return nullptr;
     }
 
+    std::vector<std::pair<std::string, std::string>> partitions;
+    for (const auto& task : tasks) {
+        if (auto flash_task = task->AsFlashTask()) {
+            partitions.emplace_back(flash_task->GetPartitionAndSlot(), flash_task->GetImageName());
+        }
+    }
+    helper->OpenImages(partitions);
+
     for (const auto& task : tasks) {
         if (auto flash_task = task->AsFlashTask()) {
             auto partition = flash_task->GetPartitionAndSlot();
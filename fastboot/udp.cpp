@@ -33,6 +33,8 @@
 #include <errno.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <deque>
 #include <list>
 #include <memory>
 #include <vector>
@@ -131,11 +133,27 @@ class UdpTransport : public Transport {
                                    uint8_t* rx_data, size_t rx_length, int attempts,
                                    std::string* error);
 
+    // Alternative to SendData() for multi-packet writes once a window has been negotiated. Keeps
+    // up to |window_size_| packets in flight and only re-sends the ones that haven't been
+    // acknowledged when a response times out. Returns the number of data bytes the target sent
+    // back in its ACKs, or -1 and fills |error| on failure.
+    ssize_t SendWindowedData(Id id, const uint8_t* tx_data, size_t tx_length, int attempts,
+                             std::string* error);
+
+    // Adjusts |packet_data_length_| after a timeout or a successful ACK in windowed mode.
+    void ShrinkPacketSize();
+    void GrowPacketSize();
+
     std::unique_ptr<Socket> socket_;
     int sequence_ = -1;
     size_t max_data_length_ = kMinPacketSize - kHeaderSize;
     std::vector<uint8_t> rx_packet_;
 
+    // Windowed mode state; a window size of 1 is the original one-packet-at-a-time protocol.
+    size_t window_size_ = 1;
+    size_t packet_data_length_ = kMinPacketSize - kHeaderSize;
+    int clean_packets_ = 0;
+
     DISALLOW_COPY_AND_ASSIGN(UdpTransport);
 };
 
@@ -151,7 +169,7 @@ std::unique_ptr<UdpTransport> UdpTransport::NewTransport(std::unique_ptr<Socket>
 }
 
 bool UdpTransport::InitializeProtocol(std::string* error) {
-    uint8_t rx_data[4];
+    uint8_t rx_data[6];
 
     sequence_ = 0;
     rx_packet_.resize(kMinPacketSize);
@@ -182,9 +200,10 @@ bool UdpTransport::InitializeProtocol(std::string* error) {
     }
 
     // The first two data bytes contain the version, the second two bytes contain the target max
-    // supported packet size, which must be at least 512 bytes.
+    // supported packet size, which must be at least 512 bytes. Version 2 targets may follow this
+    // with their maximum window size.
     uint16_t version = ExtractUint16(rx_data);
-    if (version < kProtocolVersion) {
+    if (version < kMinProtocolVersion) {
         *error = android::base::StringPrintf("target reported invalid protocol version %d",
                                              version);
         return false;
@@ -197,8 +216,15 @@ bool UdpTransport::InitializeProtocol(std::string* error) {
 
     packet_size = std::min(kHostMaxPacketSize, packet_size);
     max_data_length_ = packet_size - kHeaderSize;
+    packet_data_length_ = max_data_length_;
     rx_packet_.resize(packet_size);
 
+    window_size_ = 1;
+    if (std::min(kProtocolVersion, version) >= 2 && rx_bytes >= 6) {
+        uint16_t window_size = std::min(kHostMaxWindowSize, ExtractUint16(rx_data + 4));
+        window_size_ = std::max<size_t>(1, window_size);
+    }
+
     return true;
 }
 
@@ -211,6 +237,12 @@ ssize_t UdpTransport::SendData(Id id, const uint8_t* tx_data, size_t tx_length,
         return -1;
     }
 
+    // Large writes are the only case where the host has more than one packet ready to go, so
+    // that's all the window is used for. Reads still prompt the target one packet at a time.
+    if (window_size_ > 1 && rx_data == nullptr && tx_length > packet_data_length_) {
+        return SendWindowedData(id, tx_data, tx_length, attempts, error);
+    }
+
     Header header;
     size_t packet_data_length;
     ssize_t ret = 0;
@@ -325,6 +357,113 @@ ssize_t UdpTransport::SendSinglePacketHelper(
     return total_data_bytes;
 }
 
+// A packet sent by SendWindowedData() which may still be waiting for its ACK.
+struct WindowPacket {
+    Header header;
+    const uint8_t* data;
+    size_t length;
+    bool acked;
+};
+
+ssize_t UdpTransport::SendWindowedData(Id id, const uint8_t* tx_data, size_t tx_length,
+                                       const int attempts, std::string* error) {
+    std::deque<WindowPacket> window;
+    // Sequence number of window.front().
+    uint16_t window_start = sequence_;
+    ssize_t total_data_bytes = 0;
+    error->clear();
+
+    int attempts_left = attempts;
+    while (tx_length > 0 || !window.empty()) {
+        // Top up the window with new packets.
+        while (tx_length > 0 && window.size() < window_size_) {
+            WindowPacket packet{{}, tx_data, std::min(tx_length, packet_data_length_), false};
+            packet.header.Set(id, sequence_,
+                              packet.length < tx_length ? kFlagContinuation : kFlagNone);
+            if (!socket_->Send({{packet.header.bytes(), kHeaderSize}, {tx_data, packet.length}})) {
+                *error = Socket::GetErrorMessage();
+                return -1;
+            }
+            ++sequence_;
+            tx_data += packet.length;
+            tx_length -= packet.length;
+            window.emplace_back(packet);
+        }
+
+        ssize_t bytes = socket_->Receive(rx_packet_.data(), rx_packet_.size(), kResponseTimeoutMs);
+        if (bytes == -1) {
+            if (!socket_->ReceiveTimedOut()) {
+                *error = Socket::GetErrorMessage();
+                return -1;
+            }
+            if (--attempts_left <= 0) {
+                *error = "no response from target";
+                return -1;
+            }
+
+            // Treat the timeout as loss: back off the size of new packets, and re-send only what
+            // the target hasn't acknowledged yet.
+            ShrinkPacketSize();
+            for (const auto& packet : window) {
+                if (packet.acked) {
+                    continue;
+                }
+                if (!socket_->Send({{packet.header.bytes(), kHeaderSize},
+                                    {packet.data, packet.length}})) {
+                    *error = Socket::GetErrorMessage();
+                    return -1;
+                }
+            }
+            continue;
+        } else if (bytes < static_cast<ssize_t>(kHeaderSize)) {
+            *error = "protocol error: incomplete header";
+            return -1;
+        }
+
+        // Anything outside the window is a stale retransmission and is ignored.
+        uint16_t index = ExtractUint16(rx_packet_.data() + kIndexSeqH) - window_start;
+        if (index >= window.size() || !window[index].header.Matches(rx_packet_.data())) {
+            continue;
+        }
+
+        if (rx_packet_[kIndexId] == kIdError) {
+            error->assign(rx_packet_.data() + kHeaderSize, rx_packet_.data() + bytes);
+            *error = "target reported error: " + *error;
+            return -1;
+        }
+
+        // Duplicate ACKs are expected when the target answers a retransmission.
+        if (!window[index].acked) {
+            window[index].acked = true;
+            total_data_bytes += bytes - kHeaderSize;
+            GrowPacketSize();
+        }
+        attempts_left = attempts;
+
+        while (!window.empty() && window.front().acked) {
+            window.pop_front();
+            ++window_start;
+        }
+    }
+
+    return total_data_bytes;
+}
+
+// Large packets get fragmented at the IP layer when they exceed the path MTU, and losing any one
+// fragment loses the whole packet, so halve the packet size on loss and slowly grow it back.
+void UdpTransport::ShrinkPacketSize() {
+    packet_data_length_ = std::max(kMinPacketSize - kHeaderSize, packet_data_length_ / 2);
+    clean_packets_ = 0;
+}
+
+void UdpTransport::GrowPacketSize() {
+    if (++clean_packets_ < kPacketSizeGrowthInterval) {
+        return;
+    }
+    packet_data_length_ = std::min(max_data_length_, packet_data_length_ * 2);
+    clean_packets_ = 0;
+}
+
 ssize_t UdpTransport::Read(void* data, size_t length) {
     // Read from the target by sending an empty packet.
     std::string error;
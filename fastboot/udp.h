@@ -45,11 +45,20 @@ std::unique_ptr<Transport> Connect(const std::string& hostname, int port, std::s
 // Internal namespace for test use only.
 namespace internal {
 
-constexpr uint16_t kProtocolVersion = 1;
+constexpr uint16_t kProtocolVersion = 2;
+constexpr uint16_t kMinProtocolVersion = 1;
 
 // This will be negotiated with the device so may end up being smaller.
 constexpr uint16_t kHostMaxPacketSize = 8192;
 
+// Maximum number of unacknowledged packets in flight when writing with protocol version 2. The
+// device advertises its own limit in the Init response, and the smaller of the two is used.
+constexpr uint16_t kHostMaxWindowSize = 32;
+
+// In windowed mode the packet size backs off on loss and grows again after this many packets are
+// acknowledged without a timeout.
+constexpr int kPacketSizeGrowthInterval = 16;
+
 // Retransmission constants. Retransmission timeout must be at least 500ms, and the host must
 // attempt to send packets for at least 1 minute once the device has connected. See
 // fastboot_protocol.txt for more information.
@@ -309,15 +309,21 @@ class UdpTest : public ::testing::Test {
     }
 
     // Sets up |mock_socket_| to correctly initialize the protocol and creates |transport_|. This
-    // can be called multiple times in a test if needed.
-    bool InitializeTransport(uint16_t starting_sequence, int device_max_packet_size = 512) {
+    // can be called multiple times in a test if needed. A non-zero |window_size| is advertised by
+    // the device after its max packet size.
+    bool InitializeTransport(uint16_t starting_sequence, int device_max_packet_size = 512,
+                             uint16_t window_size = 0, uint16_t device_version = kProtocolVersion) {
         mock_socket_ = new SocketMock;
         mock_socket_->ExpectSend(QueryPacket(0));
         mock_socket_->AddReceive(QueryPacket(0, starting_sequence));
         mock_socket_->ExpectSend(
                 InitPacket(starting_sequence, kProtocolVersion, kHostMaxPacketSize));
-        mock_socket_->AddReceive(
-                InitPacket(starting_sequence, kProtocolVersion, device_max_packet_size));
+        std::string init_response =
+                InitPacket(starting_sequence, device_version, device_max_packet_size);
+        if (window_size) {
+            init_response += PacketValue(window_size);
+        }
+        mock_socket_->AddReceive(init_response);
 
         std::string error;
         transport_ = Connect(std::unique_ptr<Socket>(mock_socket_), &error);
@@ -522,6 +528,97 @@ TEST_F(UdpTest, ErrorResponse) {
     EXPECT_FALSE(Write("foo"));
 }
 
+// Tests that a version 2 device advertising a window gets multiple packets in flight.
+TEST_F(UdpTest, WindowedWrite) {
+    ASSERT_TRUE(InitializeTransport(0, 512, 2));
+
+    std::string data(508 * 3, 'x');
+    mock_socket_->ExpectSend(FastbootPacket(1, data.substr(0, 508), kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(2, data.substr(508, 508), kFlagContinuation));
+    mock_socket_->AddReceive(FastbootPacket(1));
+    mock_socket_->ExpectSend(FastbootPacket(3, data.substr(1016)));
+    mock_socket_->AddReceive(FastbootPacket(2));
+    mock_socket_->AddReceive(FastbootPacket(3));
+    EXPECT_TRUE(Write(data));
+
+    // Reads and single-packet writes are unchanged.
+    mock_socket_->ExpectSend(FastbootPacket(4, "foo"));
+    mock_socket_->AddReceive(FastbootPacket(4));
+    mock_socket_->ExpectSend(FastbootPacket(5));
+    mock_socket_->AddReceive(FastbootPacket(5, "bar"));
+    EXPECT_TRUE(Write("foo"));
+    EXPECT_TRUE(Read("bar"));
+}
+
+// Tests that only unacknowledged packets are re-sent after a timeout.
+TEST_F(UdpTest, WindowedSelectiveRetransmit) {
+    ASSERT_TRUE(InitializeTransport(0xFFFE, 512, 3));
+
+    std::string data(508 * 3, 'x');
+    std::string chunks[] = {data.substr(0, 508), data.substr(508, 508), data.substr(1016)};
+    mock_socket_->ExpectSend(FastbootPacket(0xFFFF, chunks[0], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(0x0000, chunks[1], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(0x0001, chunks[2]));
+    mock_socket_->AddReceive(FastbootPacket(0x0000));
+    mock_socket_->AddReceive(FastbootPacket(0xFFFE, "stale"));
+    mock_socket_->AddReceive(FastbootPacket(0x0001));
+    mock_socket_->AddReceiveTimeout();
+    mock_socket_->ExpectSend(FastbootPacket(0xFFFF, chunks[0], kFlagContinuation));
+    mock_socket_->AddReceive(FastbootPacket(0x0000));
+    mock_socket_->AddReceive(FastbootPacket(0xFFFF));
+    EXPECT_TRUE(Write(data));
+
+    mock_socket_->ExpectSend(FastbootPacket(0x0002));
+    mock_socket_->AddReceive(FastbootPacket(0x0002, "OKAY"));
+    EXPECT_TRUE(Read("OKAY"));
+}
+
+// Tests that packets get smaller after loss in windowed mode.
+TEST_F(UdpTest, WindowedPacketSizeBackoff) {
+    ASSERT_TRUE(InitializeTransport(0, 1024, 2));
+
+    std::string data(1020 * 3, '\0');
+    for (size_t i = 0; i < data.length(); ++i) {
+        data[i] = i;
+    }
+    mock_socket_->ExpectSend(FastbootPacket(1, data.substr(0, 1020), kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(2, data.substr(1020, 1020), kFlagContinuation));
+    mock_socket_->AddReceiveTimeout();
+    mock_socket_->ExpectSend(FastbootPacket(1, data.substr(0, 1020), kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(2, data.substr(1020, 1020), kFlagContinuation));
+    mock_socket_->AddReceive(FastbootPacket(1));
+    mock_socket_->ExpectSend(FastbootPacket(3, data.substr(2040, 510), kFlagContinuation));
+    mock_socket_->AddReceive(FastbootPacket(2));
+    mock_socket_->ExpectSend(FastbootPacket(4, data.substr(2550)));
+    mock_socket_->AddReceive(FastbootPacket(3));
+    mock_socket_->AddReceive(FastbootPacket(4));
+    EXPECT_TRUE(Write(data));
+}
+
+// Tests that an error response inside the window aborts the write.
+TEST_F(UdpTest, WindowedErrorResponse) {
+    ASSERT_TRUE(InitializeTransport(0, 512, 2));
+
+    std::string data(508 * 2, 'x');
+    mock_socket_->ExpectSend(FastbootPacket(1, data.substr(0, 508), kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(2, data.substr(508)));
+    mock_socket_->AddReceive(FastbootPacket(1));
+    mock_socket_->AddReceive(ErrorPacket(2, "test error"));
+    EXPECT_FALSE(Write(data));
+}
+
+// Tests that a window size is ignored from a version 1 device.
+TEST_F(UdpTest, WindowIgnoredForVersion1) {
+    ASSERT_TRUE(InitializeTransport(0, 512, 4, 1));
+
+    std::string data(508 * 2, 'x');
+    mock_socket_->ExpectSend(FastbootPacket(1, data.substr(0, 508), kFlagContinuation));
+    mock_socket_->AddReceive(FastbootPacket(1));
+    mock_socket_->ExpectSend(FastbootPacket(2, data.substr(508)));
+    mock_socket_->AddReceive(FastbootPacket(2));
+    EXPECT_TRUE(Write(data));
+}
+
 // Tests that attempting to use a closed transport returns -1 without making any socket calls.
 TEST_F(UdpTest, CloseTransport) {
     char buffer[32];
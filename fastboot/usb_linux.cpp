@@ -96,6 +96,10 @@ using namespace std::chrono_literals;
 // something has gone badly wrong.
 #define MIN_USBFS_BULK_WRITE_SIZE (16 * 1024)
 
+// With only two writes queued the bus goes idle whenever we're late to resubmit, so keep a few
+// more in flight. Each one is a separate URB, so this doesn't need more contiguous memory.
+#define MAX_USBFS_WRITES_IN_FLIGHT 4
+
 struct usb_handle
 {
     char fname[64];
@@ -419,8 +423,8 @@ ssize_t LinuxUsbTransport::Write(const void* _data, size_t len)
 {
     unsigned char *data = (unsigned char*) _data;
     unsigned count = 0;
-    struct usbdevfs_urb urb[2] = {};
-    bool pending[2] = {};
+    struct usbdevfs_urb urb[MAX_USBFS_WRITES_IN_FLIGHT] = {};
+    bool pending[MAX_USBFS_WRITES_IN_FLIGHT] = {};
 
     if (handle_->ep_out == 0 || handle_->desc == -1) {
         return -1;
@@ -464,7 +468,7 @@ ssize_t LinuxUsbTransport::Write(const void* _data, size_t len)
                 return false;
             }
             size_t done = (size_t)urbp->usercontext;
-            if (done >= 2 || !pending[done]) {
+            if (done >= MAX_USBFS_WRITES_IN_FLIGHT || !pending[done]) {
                 DBG("unexpected urb\n");
                 return false;
             }
@@ -477,32 +481,23 @@ ssize_t LinuxUsbTransport::Write(const void* _data, size_t len)
         return true;
     };
 
-    if (!submit_urb(0)) {
-        return -1;
-    }
-    while (len > 0) {
-        if (!submit_urb(1)) {
-            return -1;
-        }
-        if (!reap_urb(0)) {
-            return -1;
-        }
-        if (len <= 0) {
-            if (!reap_urb(1)) {
+    // URBs are submitted and reaped in order, as a ring. The first one is submitted even if
+    // |len| is 0.
+    size_t submitted = 0;
+    size_t reaped = 0;
+    do {
+        while ((len > 0 || submitted == 0) &&
+               submitted - reaped < MAX_USBFS_WRITES_IN_FLIGHT) {
+            if (!submit_urb(submitted % MAX_USBFS_WRITES_IN_FLIGHT)) {
                 return -1;
             }
-            return count;
-        }
-        if (!submit_urb(0)) {
-            return -1;
+            submitted++;
         }
-        if (!reap_urb(1)) {
+        if (!reap_urb(reaped % MAX_USBFS_WRITES_IN_FLIGHT)) {
             return -1;
         }
-    }
-    if (!reap_urb(0)) {
-        return -1;
-    }
+        reaped++;
+    } while (reaped < submitted);
     return count;
 }
 
@@ -17,6 +17,13 @@
 #include "vendor_boot_img_utils.h"
 
 #include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/result.h>
@@ -25,107 +32,213 @@
 
 namespace {
 
+using android::base::borrowed_fd;
 using android::base::Result;
 
-// Updates a given buffer by creating a new one.
-class DataUpdater {
-  public:
-    DataUpdater(const std::string& old_data) : old_data_(&old_data) {
-        old_data_ptr_ = old_data_->data();
-        new_data_.resize(old_data_->size(), '\0');
-        new_data_ptr_ = new_data_.data();
-    }
-    // Copy |num_bytes| from src to dst.
-    [[nodiscard]] Result<void> Copy(uint32_t num_bytes) {
-        if (num_bytes == 0) return {};
-        if (auto res = CheckAdvance(old_data_ptr_, old_end(), num_bytes, __FUNCTION__); !res.ok())
-            return res;
-        if (auto res = CheckAdvance(new_data_ptr_, new_end(), num_bytes, __FUNCTION__); !res.ok())
-            return res;
-        memcpy(new_data_ptr_, old_data_ptr_, num_bytes);
-        old_data_ptr_ += num_bytes;
-        new_data_ptr_ += num_bytes;
-        return {};
-    }
-    // Replace |old_num_bytes| from src with new data.
-    [[nodiscard]] Result<void> Replace(uint32_t old_num_bytes, const std::string& new_data) {
-        return Replace(old_num_bytes, new_data.data(), new_data.size());
-    }
-    [[nodiscard]] Result<void> Replace(uint32_t old_num_bytes, const void* new_data,
-                                       uint32_t new_data_size) {
-        if (auto res = CheckAdvance(old_data_ptr_, old_end(), old_num_bytes, __FUNCTION__);
-            !res.ok())
-            return res;
-        old_data_ptr_ += old_num_bytes;
+// Sections that move are copied, and new data is written, in chunks of this size.
+constexpr size_t kCopyChunkSize = 1024 * 1024;
+
+// A range of the repacked vendor boot image, and where its content comes from.
+struct Extent {
+    enum class Source {
+        // The vendor boot image itself, at |src_offset|.
+        kVendorBoot,
+        // The new ramdisk, at |src_offset|.
+        kNewRamdisk,
+        // |data|.
+        kData,
+        // Zeros.
+        kZero,
+    };
+
+    Source source;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t src_offset = 0;
+    std::string data = {};
+};
 
-        if (new_data_size == 0) return {};
-        if (auto res = CheckAdvance(new_data_ptr_, new_end(), new_data_size, __FUNCTION__);
-            !res.ok())
-            return res;
-        memcpy(new_data_ptr_, new_data, new_data_size);
-        new_data_ptr_ += new_data_size;
-        return {};
+// Seek to |offset| and read |size| bytes into |data|.
+[[nodiscard]] Result<void> read_at(borrowed_fd fd, uint64_t offset, void* data, size_t size,
+                                   const char* what) {
+    if (lseek(fd.get(), offset, SEEK_SET) != static_cast<off_t>(offset)) {
+        return ErrnoErrorf("Cannot seek to 0x{:x} of {}", offset, what);
     }
-    // Skip |old_skip| from src and |new_skip| from dst, respectively.
-    [[nodiscard]] Result<void> Skip(uint32_t old_skip, uint32_t new_skip) {
-        if (auto res = CheckAdvance(old_data_ptr_, old_end(), old_skip, __FUNCTION__); !res.ok())
-            return res;
-        old_data_ptr_ += old_skip;
-        if (auto res = CheckAdvance(new_data_ptr_, new_end(), new_skip, __FUNCTION__); !res.ok())
-            return res;
-        new_data_ptr_ += new_skip;
-        return {};
+    if (!android::base::ReadFully(fd, data, size)) {
+        return ErrnoErrorf("Cannot read 0x{:x} bytes at 0x{:x} of {}", size, offset, what);
     }
+    return {};
+}
+
+[[nodiscard]] Result<std::string> read_string_at(borrowed_fd fd, uint64_t offset, size_t size,
+                                                 const char* what) {
+    std::string data(size, '\0');
+    if (auto res = read_at(fd, offset, data.data(), size, what); !res.ok()) return res.error();
+    return data;
+}
 
-    [[nodiscard]] Result<void> Seek(uint32_t offset) {
-        if (offset > size()) return Errorf("Cannot seek 0x{:x}, size is 0x{:x}", offset, size());
-        old_data_ptr_ = old_begin() + offset;
-        new_data_ptr_ = new_begin() + offset;
-        return {};
+// Seek to |offset| and write |size| bytes of |data|.
+[[nodiscard]] Result<void> write_at(borrowed_fd fd, uint64_t offset, const void* data, size_t size,
+                                    const char* what) {
+    if (lseek(fd.get(), offset, SEEK_SET) != static_cast<off_t>(offset)) {
+        return ErrnoErrorf("Cannot seek to 0x{:x} of {} before writing", offset, what);
     }
+    if (!android::base::WriteFully(fd, data, size)) {
+        return ErrnoErrorf("Cannot write 0x{:x} bytes at 0x{:x} of {}", size, offset, what);
+    }
+    return {};
+}
 
-    std::string Finish() {
-        new_data_ptr_ = nullptr;
-        return std::move(new_data_);
+// Check that the file is |expected_size| bytes, without reading it.
+[[nodiscard]] Result<void> check_file_size(borrowed_fd fd, uint64_t expected_size,
+                                           const char* what) {
+    off_t size = lseek(fd.get(), 0, SEEK_END);
+    if (size == -1) {
+        return ErrnoErrorf("Cannot seek to the end of {} image", what);
+    }
+    if (static_cast<uint64_t>(size) != expected_size) {
+        return Errorf("Size of {} does not match, expected 0x{:x}, actual 0x{:x}", what,
+                      expected_size, static_cast<uint64_t>(size));
     }
+    return {};
+}
 
-    [[nodiscard]] Result<void> CheckOffset(uint32_t old_offset, uint32_t new_offset) {
-        if (old_begin() + old_offset != old_cur())
-            return Errorf("Old offset mismatch: expected: 0x{:x}, actual: 0x{:x}", old_offset,
-                          old_cur() - old_begin());
-        if (new_begin() + new_offset != new_cur())
-            return Errorf("New offset mismatch: expected: 0x{:x}, actual: 0x{:x}", new_offset,
-                          new_cur() - new_begin());
-        return {};
+// Plans the repacked image as a list of extents, in the order they appear in it.
+class LayoutBuilder {
+  public:
+    // Append |size| bytes found at |src_offset| of the vendor boot image.
+    void CopyVendorBoot(uint64_t src_offset, uint64_t size) {
+        if (size == 0) return;
+        if (!extents_.empty()) {
+            Extent& last = extents_.back();
+            if (last.source == Extent::Source::kVendorBoot &&
+                last.src_offset + last.size == src_offset) {
+                last.size += size;
+                end_ += size;
+                return;
+            }
+        }
+        Add({Extent::Source::kVendorBoot, end_, size, src_offset});
+    }
+    // Append the whole new ramdisk.
+    void CopyNewRamdisk(uint64_t size) {
+        if (size == 0) return;
+        Add({Extent::Source::kNewRamdisk, end_, size, 0});
+    }
+    void Append(std::string data) {
+        if (data.empty()) return;
+        uint64_t size = data.size();
+        Add({Extent::Source::kData, end_, size, 0, std::move(data)});
+    }
+    void Zero(uint64_t size) {
+        if (size == 0) return;
+        Add({Extent::Source::kZero, end_, size});
+    }
+    // Place |data| at |offset|, after everything appended so far. Nothing can be appended after
+    // this.
+    void Overwrite(uint64_t offset, std::string data) {
+        uint64_t size = data.size();
+        extents_.push_back({Extent::Source::kData, offset, size, 0, std::move(data)});
     }
 
-    uint64_t size() const { return old_data_->size(); }
-    const char* old_begin() const { return old_data_->data(); }
-    const char* old_cur() { return old_data_ptr_; }
-    const char* old_end() const { return old_data_->data() + old_data_->size(); }
-    char* new_begin() { return new_data_.data(); }
-    char* new_cur() { return new_data_ptr_; }
-    char* new_end() { return new_data_.data() + new_data_.size(); }
+    uint64_t size() const { return end_; }
+    std::vector<Extent> Finish() { return std::move(extents_); }
 
   private:
-    // Check if it is okay to advance |num_bytes| from |current|.
-    [[nodiscard]] Result<void> CheckAdvance(const char* current, const char* end,
-                                            uint32_t num_bytes, const char* op) {
-        auto new_end = current + num_bytes;
-        if (new_end < current /* add overflow */)
-            return Errorf("{}: Addition overflow: 0x{} + 0x{:x} < 0x{}", op, fmt::ptr(current),
-                          num_bytes, fmt::ptr(current));
-        if (new_end > end)
-            return Errorf("{}: Boundary overflow: 0x{} + 0x{:x} > 0x{}", op, fmt::ptr(current),
-                          num_bytes, fmt::ptr(end));
-        return {};
-    }
-    const std::string* old_data_;
-    std::string new_data_;
-    const char* old_data_ptr_;
-    char* new_data_ptr_;
+    void Add(Extent extent) {
+        end_ += extent.size;
+        extents_.push_back(std::move(extent));
+    }
+
+    std::vector<Extent> extents_;
+    uint64_t end_ = 0;
 };
 
+// Copy |size| bytes within the vendor boot image from |src_offset| to |offset|. The ranges may
+// overlap, so the copy runs backwards if the data moves towards the end of the image.
+[[nodiscard]] Result<void> move_range(borrowed_fd fd, uint64_t src_offset, uint64_t offset,
+                                      uint64_t size, std::string* buffer) {
+    const bool backwards = offset > src_offset;
+    for (uint64_t done = 0; done < size;) {
+        size_t chunk = std::min<uint64_t>(size - done, buffer->size());
+        uint64_t pos = backwards ? size - done - chunk : done;
+        if (auto res = read_at(fd, src_offset + pos, buffer->data(), chunk, "vendor boot");
+            !res.ok())
+            return res;
+        if (auto res = write_at(fd, offset + pos, buffer->data(), chunk, "new vendor boot image");
+            !res.ok())
+            return res;
+        done += chunk;
+    }
+    return {};
+}
+
+// Write the planned image into the vendor boot image in place. Sections that don't move are not
+// touched at all, and the others are copied straight from where they are in the file.
+//
+// Sections of the old image play out in the same order in the new one, so they can be moved
+// without losing anything that is still needed: first the ones moving towards the end of the
+// image, last to first, then the ones moving towards the start, first to last. Everything else
+// only overwrites data that has been moved by then.
+[[nodiscard]] Result<void> write_layout(borrowed_fd vendor_boot_fd, borrowed_fd new_ramdisk_fd,
+                                        const std::vector<Extent>& extents) {
+    std::string buffer(kCopyChunkSize, '\0');
+    for (auto it = extents.rbegin(); it != extents.rend(); ++it) {
+        if (it->source != Extent::Source::kVendorBoot || it->offset <= it->src_offset) continue;
+        if (auto res = move_range(vendor_boot_fd, it->src_offset, it->offset, it->size, &buffer);
+            !res.ok())
+            return res;
+    }
+    for (const auto& extent : extents) {
+        if (extent.source != Extent::Source::kVendorBoot || extent.offset >= extent.src_offset) {
+            continue;
+        }
+        if (auto res = move_range(vendor_boot_fd, extent.src_offset, extent.offset, extent.size,
+                                  &buffer);
+            !res.ok())
+            return res;
+    }
+
+    for (const auto& extent : extents) {
+        switch (extent.source) {
+            case Extent::Source::kVendorBoot:
+                break;
+            case Extent::Source::kNewRamdisk:
+                for (uint64_t done = 0; done < extent.size;) {
+                    size_t chunk = std::min<uint64_t>(extent.size - done, buffer.size());
+                    if (auto res = read_at(new_ramdisk_fd, extent.src_offset + done, buffer.data(),
+                                           chunk, "new vendor ramdisk");
+                        !res.ok())
+                        return res;
+                    if (auto res = write_at(vendor_boot_fd, extent.offset + done, buffer.data(),
+                                            chunk, "new vendor boot image");
+                        !res.ok())
+                        return res;
+                    done += chunk;
+                }
+                break;
+            case Extent::Source::kData:
+                if (auto res = write_at(vendor_boot_fd, extent.offset, extent.data.data(),
+                                        extent.data.size(), "new vendor boot image");
+                    !res.ok())
+                    return res;
+                break;
+            case Extent::Source::kZero:
+                memset(buffer.data(), 0, buffer.size());
+                for (uint64_t done = 0; done < extent.size;) {
+                    size_t chunk = std::min<uint64_t>(extent.size - done, buffer.size());
+                    if (auto res = write_at(vendor_boot_fd, extent.offset + done, buffer.data(),
+                                            chunk, "new vendor boot image");
+                        !res.ok())
+                        return res;
+                    done += chunk;
+                }
+                break;
+        }
+    }
+    return {};
+}
+
 // Get the size of vendor boot header.
 [[nodiscard]] Result<uint32_t> get_vendor_boot_header_size(const vendor_boot_img_hdr_v3* hdr) {
     if (hdr->header_version == 3) return sizeof(vendor_boot_img_hdr_v3);
@@ -161,117 +274,134 @@ class DataUpdater {
     return {};
 }
 
-// Wrapper of ReadFdToString. Seek to the beginning and read the whole file to string.
-[[nodiscard]] Result<std::string> load_file(android::base::borrowed_fd fd, uint64_t expected_size,
-                                            const char* what) {
-    if (lseek(fd.get(), 0, SEEK_SET) != 0) {
-        return ErrnoErrorf("Can't seek to the beginning of {} image", what);
-    }
-    std::string content;
-    if (!android::base::ReadFdToString(fd, &content)) {
-        return ErrnoErrorf("Cannot read {} to string", what);
-    }
-    if (content.size() != expected_size) {
-        return Errorf("Size of {} does not match, expected 0x{:x}, read 0x{:x}", what,
-                      expected_size, content.size());
-    }
-    return content;
+// round |value| up to a multiple of |page_size|.
+inline uint64_t round_up(uint64_t value, uint32_t page_size) {
+    return (value + page_size - 1) / page_size * page_size;
 }
 
-// Wrapper of WriteStringToFd. Seek to the beginning and write the whole file to string.
-[[nodiscard]] Result<void> store_file(android::base::borrowed_fd fd, const std::string& data,
-                                      const char* what) {
-    if (lseek(fd.get(), 0, SEEK_SET) != 0) {
-        return ErrnoErrorf("Cannot seek to beginning of {} before writing", what);
+// The parts of a vendor boot image that are needed to plan a repack.
+struct VendorBootImage {
+    uint64_t size = 0;
+    // The header, up to the page boundary.
+    std::string header;
+    // Refer to bootimg.h for details. Numbers are in bytes.
+    uint64_t o = 0, p = 0, q = 0, r = 0, s = 0;
+    // The AVB footer, or empty if there is none.
+    std::string avb_footer;
+
+    const vendor_boot_img_hdr_v3* hdr() const {
+        return reinterpret_cast<const vendor_boot_img_hdr_v3*>(header.data());
     }
-    if (!android::base::WriteStringToFd(data, fd)) {
-        return ErrnoErrorf("Cannot write new content to {}", what);
+    // The end of the last section.
+    uint64_t end() const { return o + p + q + r + s; }
+};
+
+// Read the header and AVB footer of the vendor boot image, which must have a header version of at
+// least |version|. The sections themselves are left in the file.
+[[nodiscard]] Result<VendorBootImage> load_vendor_boot(borrowed_fd fd, uint64_t size,
+                                                       uint32_t version) {
+    VendorBootImage image;
+    image.size = size;
+
+    auto header = read_string_at(fd, 0, std::min<uint64_t>(size, sizeof(vendor_boot_img_hdr_v4)),
+                                 "vendor boot");
+    if (!header.ok()) return header.error();
+    if (auto res = check_vendor_boot_hdr(*header, version); !res.ok()) return res.error();
+    auto hdr = reinterpret_cast<const vendor_boot_img_hdr_v3*>(header->data());
+    auto hdr_size = get_vendor_boot_header_size(hdr);
+    if (!hdr_size.ok()) return hdr_size.error();
+    image.o = round_up(*hdr_size, hdr->page_size);
+    image.p = round_up(hdr->vendor_ramdisk_size, hdr->page_size);
+    image.q = round_up(hdr->dtb_size, hdr->page_size);
+    if (hdr->header_version >= 4) {
+        auto hdr_v4 = static_cast<const vendor_boot_img_hdr_v4*>(hdr);
+        image.r = round_up(hdr_v4->vendor_ramdisk_table_size, hdr->page_size);
+        image.s = round_up(hdr_v4->bootconfig_size, hdr->page_size);
     }
-    if (TEMP_FAILURE_RETRY(ftruncate(fd.get(), data.size())) == -1) {
-        return ErrnoErrorf("Truncating new vendor boot image to 0x{:x} fails", data.size());
+    if (image.end() > size) {
+        return Errorf("Vendor boot image size is too small, overflow");
     }
-    return {};
-}
 
-// Copy AVB footer if it exists in the old buffer.
-[[nodiscard]] Result<void> copy_avb_footer(DataUpdater* updater) {
-    if (updater->size() < AVB_FOOTER_SIZE) return {};
-    if (auto res = updater->Seek(updater->size() - AVB_FOOTER_SIZE); !res.ok()) return res;
-    if (memcmp(updater->old_cur(), AVB_FOOTER_MAGIC, AVB_FOOTER_MAGIC_LEN) != 0) return {};
-    return updater->Copy(AVB_FOOTER_SIZE);
+    auto header_page = read_string_at(fd, 0, image.o, "vendor boot");
+    if (!header_page.ok()) return header_page.error();
+    image.header = std::move(*header_page);
+
+    if (size >= AVB_FOOTER_SIZE) {
+        auto footer = read_string_at(fd, size - AVB_FOOTER_SIZE, AVB_FOOTER_SIZE, "vendor boot");
+        if (!footer.ok()) return footer.error();
+        if (memcmp(footer->data(), AVB_FOOTER_MAGIC, AVB_FOOTER_MAGIC_LEN) == 0) {
+            image.avb_footer = std::move(*footer);
+        }
+    }
+    return image;
 }
 
-// round |value| up to a multiple of |page_size|.
-// aware that this can be integer overflow if value is too large
-inline uint32_t round_up(uint32_t value, uint32_t page_size) {
-    return (value + page_size - 1) / page_size * page_size;
+// Finish the layout of the repacked image: clear what is left of the old sections past the new
+// ones, and keep the AVB footer if there is one.
+[[nodiscard]] Result<std::vector<Extent>> finish_layout(const VendorBootImage& image,
+                                                        LayoutBuilder* layout) {
+    if (layout->size() > image.size) {
+        return Errorf("New vendor boot image is 0x{:x} bytes, larger than the old one: 0x{:x}",
+                      layout->size(), image.size);
+    }
+    if (image.end() > layout->size()) {
+        layout->Zero(image.end() - layout->size());
+    }
+    if (!image.avb_footer.empty()) {
+        layout->Overwrite(image.size - AVB_FOOTER_SIZE, image.avb_footer);
+    }
+    return layout->Finish();
 }
 
 // Replace the vendor ramdisk as a whole.
-[[nodiscard]] Result<std::string> replace_default_vendor_ramdisk(const std::string& vendor_boot,
-                                                                 const std::string& new_ramdisk) {
-    if (auto res = check_vendor_boot_hdr(vendor_boot, 3); !res.ok()) return res.error();
-    auto hdr = reinterpret_cast<const vendor_boot_img_hdr_v3*>(vendor_boot.data());
-    auto hdr_size = get_vendor_boot_header_size(hdr);
-    if (!hdr_size.ok()) return hdr_size.error();
-    // Refer to bootimg.h for details. Numbers are in bytes.
-    const uint32_t o = round_up(*hdr_size, hdr->page_size);
-    const uint32_t p = round_up(hdr->vendor_ramdisk_size, hdr->page_size);
-    const uint32_t q = round_up(hdr->dtb_size, hdr->page_size);
-
-    DataUpdater updater(vendor_boot);
-
-    // Copy header (O bytes), then update fields in header.
-    if (auto res = updater.Copy(o); !res.ok()) return res.error();
-    auto new_hdr = reinterpret_cast<vendor_boot_img_hdr_v3*>(updater.new_begin());
-    new_hdr->vendor_ramdisk_size = new_ramdisk.size();
+[[nodiscard]] Result<std::vector<Extent>> layout_default_vendor_ramdisk(
+        borrowed_fd vendor_boot_fd, uint64_t vendor_boot_size, uint64_t new_ramdisk_size) {
+    auto image = load_vendor_boot(vendor_boot_fd, vendor_boot_size, 3);
+    if (!image.ok()) return image.error();
+    const uint64_t o = image->o;
+    const uint64_t p = image->p;
+    const uint64_t q = image->q;
+    const uint64_t r = image->r;
+    const uint64_t s = image->s;
+
+    // Update fields in header.
+    std::string new_header = image->header;
+    auto new_hdr = reinterpret_cast<vendor_boot_img_hdr_v3*>(new_header.data());
+    new_hdr->vendor_ramdisk_size = new_ramdisk_size;
     // Because it is unknown how the new ramdisk is fragmented, the whole table is replaced
     // with a single entry representing the full ramdisk.
+    std::string new_table;
     if (new_hdr->header_version >= 4) {
         auto new_hdr_v4 = static_cast<vendor_boot_img_hdr_v4*>(new_hdr);
         new_hdr_v4->vendor_ramdisk_table_entry_size = sizeof(vendor_ramdisk_table_entry_v4);
         new_hdr_v4->vendor_ramdisk_table_entry_num = 1;
         new_hdr_v4->vendor_ramdisk_table_size = new_hdr_v4->vendor_ramdisk_table_entry_num *
                                                 new_hdr_v4->vendor_ramdisk_table_entry_size;
-    }
-
-    // Copy the new ramdisk.
-    if (auto res = updater.Replace(hdr->vendor_ramdisk_size, new_ramdisk); !res.ok())
-        return res.error();
-    const uint32_t new_p = round_up(new_hdr->vendor_ramdisk_size, new_hdr->page_size);
-    if (auto res = updater.Skip(p - hdr->vendor_ramdisk_size, new_p - new_hdr->vendor_ramdisk_size);
-        !res.ok())
-        return res.error();
-    if (auto res = updater.CheckOffset(o + p, o + new_p); !res.ok()) return res.error();
 
-    // Copy DTB (Q bytes).
-    if (auto res = updater.Copy(q); !res.ok()) return res.error();
-
-    if (new_hdr->header_version >= 4) {
-        auto hdr_v4 = static_cast<const vendor_boot_img_hdr_v4*>(hdr);
-        const uint32_t r = round_up(hdr_v4->vendor_ramdisk_table_size, hdr_v4->page_size);
-        const uint32_t s = round_up(hdr_v4->bootconfig_size, hdr_v4->page_size);
-
-        auto new_entry = reinterpret_cast<vendor_ramdisk_table_entry_v4*>(updater.new_cur());
-        auto new_hdr_v4 = static_cast<const vendor_boot_img_hdr_v4*>(new_hdr);
-        auto new_r = round_up(new_hdr_v4->vendor_ramdisk_table_size, new_hdr->page_size);
-        if (auto res = updater.Skip(r, new_r); !res.ok()) return res.error();
-        if (auto res = updater.CheckOffset(o + p + q + r, o + new_p + q + new_r); !res.ok())
-            return res.error();
-
-        // Replace table with single entry representing the full ramdisk.
+        new_table.resize(round_up(new_hdr_v4->vendor_ramdisk_table_size, new_hdr->page_size));
+        auto new_entry = reinterpret_cast<vendor_ramdisk_table_entry_v4*>(new_table.data());
         new_entry->ramdisk_size = new_hdr->vendor_ramdisk_size;
         new_entry->ramdisk_offset = 0;
         new_entry->ramdisk_type = VENDOR_RAMDISK_TYPE_NONE;
         memset(new_entry->ramdisk_name, '\0', VENDOR_RAMDISK_NAME_SIZE);
         memset(new_entry->board_id, '\0', VENDOR_RAMDISK_TABLE_ENTRY_BOARD_ID_SIZE);
-
+    }
+    const uint64_t new_p = round_up(new_hdr->vendor_ramdisk_size, new_hdr->page_size);
+    const bool has_table = new_hdr->header_version >= 4;
+
+    LayoutBuilder layout;
+    layout.Append(std::move(new_header));
+    // The new ramdisk, padded to page boundary.
+    layout.CopyNewRamdisk(new_ramdisk_size);
+    layout.Zero(new_p - new_ramdisk_size);
+    // Copy DTB (Q bytes).
+    layout.CopyVendorBoot(o + p, q);
+    if (has_table) {
+        layout.Append(std::move(new_table));
         // Copy bootconfig (S bytes).
-        if (auto res = updater.Copy(s); !res.ok()) return res.error();
+        layout.CopyVendorBoot(o + p + q + r, s);
     }
-
-    if (auto res = copy_avb_footer(&updater); !res.ok()) return res.error();
-    return updater.Finish();
+    return finish_layout(*image, &layout);
 }
 
 // Find a ramdisk fragment with a unique name. Abort if none or multiple fragments are found.
@@ -299,107 +429,87 @@ inline uint32_t round_up(uint32_t value, uint32_t page_size) {
     return ret;
 }
 
-// Find the vendor ramdisk fragment with |ramdisk_name| within the content of |vendor_boot|, and
-// replace it with the content of |new_ramdisk|.
-[[nodiscard]] Result<std::string> replace_vendor_ramdisk_fragment(const std::string& ramdisk_name,
-                                                                  const std::string& vendor_boot,
-                                                                  const std::string& new_ramdisk) {
-    if (auto res = check_vendor_boot_hdr(vendor_boot, 4); !res.ok()) return res.error();
-    auto hdr = reinterpret_cast<const vendor_boot_img_hdr_v4*>(vendor_boot.data());
-    auto hdr_size = get_vendor_boot_header_size(hdr);
-    if (!hdr_size.ok()) return hdr_size.error();
-    // Refer to bootimg.h for details. Numbers are in bytes.
-    const uint32_t o = round_up(*hdr_size, hdr->page_size);
-    const uint32_t p = round_up(hdr->vendor_ramdisk_size, hdr->page_size);
-    const uint32_t q = round_up(hdr->dtb_size, hdr->page_size);
-    const uint32_t r = round_up(hdr->vendor_ramdisk_table_size, hdr->page_size);
-    const uint32_t s = round_up(hdr->bootconfig_size, hdr->page_size);
-
-    uint64_t total_size = (uint64_t)o + p + q + r + s;
-    if (total_size > vendor_boot.size()) {
-        return Errorf("Vendor boot image size is too small, overflow");
-    }
-
-    if ((uint64_t)hdr->vendor_ramdisk_table_entry_num * sizeof(vendor_ramdisk_table_entry_v4) >
-        (uint64_t)o + p + q + r) {
+// Find the vendor ramdisk fragment with |ramdisk_name| within the vendor boot image, and replace
+// it with the new ramdisk.
+[[nodiscard]] Result<std::vector<Extent>> layout_vendor_ramdisk_fragment(
+        const std::string& ramdisk_name, borrowed_fd vendor_boot_fd, uint64_t vendor_boot_size,
+        uint64_t new_ramdisk_size) {
+    auto image = load_vendor_boot(vendor_boot_fd, vendor_boot_size, 4);
+    if (!image.ok()) return image.error();
+    auto hdr = static_cast<const vendor_boot_img_hdr_v4*>(image->hdr());
+    const uint64_t o = image->o;
+    const uint64_t p = image->p;
+    const uint64_t q = image->q;
+    const uint64_t r = image->r;
+    const uint64_t s = image->s;
+
+    const uint64_t entry_size = std::max<uint64_t>(hdr->vendor_ramdisk_table_entry_size,
+                                                   sizeof(vendor_ramdisk_table_entry_v4));
+    if (hdr->vendor_ramdisk_table_entry_num * entry_size > r) {
         return Errorf("Too many vendor ramdisk entries in table, overflow");
     }
+    auto table = read_string_at(vendor_boot_fd, o + p + q, r, "vendor boot");
+    if (!table.ok()) return table.error();
 
     // Find entry with name |ramdisk_name|.
-    auto old_table_start =
-            reinterpret_cast<const vendor_ramdisk_table_entry_v4*>(vendor_boot.data() + o + p + q);
+    auto old_table_start = reinterpret_cast<const vendor_ramdisk_table_entry_v4*>(table->data());
     auto find_res =
             find_unique_ramdisk(ramdisk_name, old_table_start, hdr->vendor_ramdisk_table_entry_num);
     if (!find_res.ok()) return find_res.error();
     const vendor_ramdisk_table_entry_v4* replace_entry = *find_res;
     uint32_t replace_idx = replace_entry - old_table_start;
 
-    // Now reconstruct.
-    DataUpdater updater(vendor_boot);
-
-    // Copy header (O bytes), then update fields in header.
-    if (auto res = updater.Copy(o); !res.ok()) return res.error();
-    auto new_hdr = reinterpret_cast<vendor_boot_img_hdr_v4*>(updater.new_begin());
-
-    // Copy ramdisk fragments, replace for the matching index.
-    {
-        auto old_ramdisk_entry = reinterpret_cast<const vendor_ramdisk_table_entry_v4*>(
-                vendor_boot.data() + o + p + q);
-        uint32_t new_total_ramdisk_size = 0;
-        for (uint32_t new_ramdisk_idx = 0; new_ramdisk_idx < hdr->vendor_ramdisk_table_entry_num;
-             new_ramdisk_idx++, old_ramdisk_entry++) {
-            if (new_ramdisk_idx == replace_idx) {
-                if (auto res = updater.Replace(replace_entry->ramdisk_size, new_ramdisk); !res.ok())
-                    return res.error();
-                new_total_ramdisk_size += new_ramdisk.size();
-            } else {
-                if (auto res = updater.Copy(old_ramdisk_entry->ramdisk_size); !res.ok())
-                    return res.error();
-                new_total_ramdisk_size += old_ramdisk_entry->ramdisk_size;
-            }
-        }
-        new_hdr->vendor_ramdisk_size = new_total_ramdisk_size;
-    }
-
-    // Pad ramdisk to page boundary.
-    const uint32_t new_p = round_up(new_hdr->vendor_ramdisk_size, new_hdr->page_size);
-    if (auto res = updater.Skip(p - hdr->vendor_ramdisk_size, new_p - new_hdr->vendor_ramdisk_size);
-        !res.ok())
-        return res.error();
-    if (auto res = updater.CheckOffset(o + p, o + new_p); !res.ok()) return res.error();
-
-    // Copy DTB (Q bytes).
-    if (auto res = updater.Copy(q); !res.ok()) return res.error();
-
-    // Copy table, but with corresponding entries modified, including:
+    // Update the table, including:
     // - ramdisk_size of the entry replaced
     // - ramdisk_offset of subsequent entries.
-    for (uint32_t new_total_ramdisk_size = 0, new_entry_idx = 0;
-         new_entry_idx < hdr->vendor_ramdisk_table_entry_num; new_entry_idx++) {
-        auto new_entry = reinterpret_cast<vendor_ramdisk_table_entry_v4*>(updater.new_cur());
-        if (auto res = updater.Copy(hdr->vendor_ramdisk_table_entry_size); !res.ok())
-            return res.error();
+    // Fragments are laid out in the order of the table, so the ones before the replaced one stay
+    // where they are and the ones after it move together.
+    std::string new_table = *table;
+    uint64_t old_total_ramdisk_size = 0;
+    uint64_t new_total_ramdisk_size = 0;
+    uint64_t replace_offset = 0;
+    for (uint32_t idx = 0; idx < hdr->vendor_ramdisk_table_entry_num; idx++) {
+        auto new_entry = reinterpret_cast<vendor_ramdisk_table_entry_v4*>(
+                new_table.data() + idx * hdr->vendor_ramdisk_table_entry_size);
+        if (idx == replace_idx) {
+            replace_offset = old_total_ramdisk_size;
+        }
+        old_total_ramdisk_size += new_entry->ramdisk_size;
         new_entry->ramdisk_offset = new_total_ramdisk_size;
-
-        if (new_entry_idx == replace_idx) {
-            new_entry->ramdisk_size = new_ramdisk.size();
+        if (idx == replace_idx) {
+            new_entry->ramdisk_size = new_ramdisk_size;
         }
         new_total_ramdisk_size += new_entry->ramdisk_size;
     }
+    if (old_total_ramdisk_size != hdr->vendor_ramdisk_size) {
+        return Errorf("Vendor ramdisk fragments add up to 0x{:x}, but ramdisk size is 0x{:x}",
+                      old_total_ramdisk_size, hdr->vendor_ramdisk_size);
+    }
+    if (new_total_ramdisk_size > std::numeric_limits<uint32_t>::max()) {
+        return Errorf("New vendor ramdisk is too big");
+    }
 
-    // Copy padding of R pages; this is okay because table size is not changed.
-    if (auto res = updater.Copy(r - hdr->vendor_ramdisk_table_entry_num *
-                                            hdr->vendor_ramdisk_table_entry_size);
-        !res.ok())
-        return res.error();
-    if (auto res = updater.CheckOffset(o + p + q + r, o + new_p + q + r); !res.ok())
-        return res.error();
-
+    // Update fields in header.
+    std::string new_header = image->header;
+    auto new_hdr = reinterpret_cast<vendor_boot_img_hdr_v4*>(new_header.data());
+    new_hdr->vendor_ramdisk_size = new_total_ramdisk_size;
+    const uint64_t new_p = round_up(new_hdr->vendor_ramdisk_size, new_hdr->page_size);
+
+    LayoutBuilder layout;
+    layout.Append(std::move(new_header));
+    // Ramdisk fragments, with the matching one replaced, padded to page boundary.
+    const uint64_t replace_end = replace_offset + replace_entry->ramdisk_size;
+    layout.CopyVendorBoot(o, replace_offset);
+    layout.CopyNewRamdisk(new_ramdisk_size);
+    layout.CopyVendorBoot(o + replace_end, old_total_ramdisk_size - replace_end);
+    layout.Zero(new_p - new_total_ramdisk_size);
+    // Copy DTB (Q bytes).
+    layout.CopyVendorBoot(o + p, q);
+    // The table keeps its size.
+    layout.Append(std::move(new_table));
     // Copy bootconfig (S bytes).
-    if (auto res = updater.Copy(s); !res.ok()) return res.error();
-
-    if (auto res = copy_avb_footer(&updater); !res.ok()) return res.error();
-    return updater.Finish();
+    layout.CopyVendorBoot(o + p + q + r, s);
+    return finish_layout(*image, &layout);
 }
 
 }  // namespace
@@ -413,20 +523,20 @@ inline uint32_t round_up(uint32_t value, uint32_t page_size) {
         return Errorf("New vendor ramdisk is too big");
     }
 
-    auto vendor_boot = load_file(vendor_boot_fd, vendor_boot_size, "vendor boot");
-    if (!vendor_boot.ok()) return vendor_boot.error();
-    auto new_ramdisk = load_file(new_ramdisk_fd, new_ramdisk_size, "new vendor ramdisk");
-    if (!new_ramdisk.ok()) return new_ramdisk.error();
+    if (auto res = check_file_size(vendor_boot_fd, vendor_boot_size, "vendor boot"); !res.ok())
+        return res;
+    if (auto res = check_file_size(new_ramdisk_fd, new_ramdisk_size, "new vendor ramdisk");
+        !res.ok())
+        return res;
 
-    Result<std::string> new_vendor_boot;
+    // Plan the whole image before writing anything, so that an invalid image is left untouched.
+    Result<std::vector<Extent>> layout;
     if (ramdisk_name == "default") {
-        new_vendor_boot = replace_default_vendor_ramdisk(*vendor_boot, *new_ramdisk);
+        layout = layout_default_vendor_ramdisk(vendor_boot_fd, vendor_boot_size, new_ramdisk_size);
     } else {
-        new_vendor_boot = replace_vendor_ramdisk_fragment(ramdisk_name, *vendor_boot, *new_ramdisk);
+        layout = layout_vendor_ramdisk_fragment(ramdisk_name, vendor_boot_fd, vendor_boot_size,
+                                                new_ramdisk_size);
     }
-    if (!new_vendor_boot.ok()) return new_vendor_boot.error();
-    if (auto res = store_file(vendor_boot_fd, *new_vendor_boot, "new vendor boot image"); !res.ok())
-        return res.error();
-
-    return {};
+    if (!layout.ok()) return layout.error();
+    return write_layout(vendor_boot_fd, new_ramdisk_fd, *layout);
 }
@@ -152,3 +152,26 @@ Result<void> ConfigureQueueDepth(const std::string& loop_device_path,
     }
     return {};
 }
+
+// Return the largest discard the queue backing `blockdev_path` accepts in a
+// single request, or 0 if it does not support discard.
+Result<uint64_t> BlockDeviceDiscardMaxBytes(const std::string& blockdev_path) {
+    struct stat statbuf;
+    if (stat(blockdev_path.c_str(), &statbuf) < 0) {
+        return ErrnoError() << "stat(" << blockdev_path << ")";
+    }
+    if (!S_ISBLK(statbuf.st_mode)) {
+        return Error() << blockdev_path << " is not a block device";
+    }
+    // Partitions don't have a queue directory of their own; theirs is the
+    // parent disk's.
+    const std::string sysfs_dir = StringPrintf("/sys/dev/block/%u:%u", major(statbuf.st_rdev),
+                                               minor(statbuf.st_rdev));
+    std::string value;
+    if (!android::base::ReadFileToString(sysfs_dir + "/queue/discard_max_bytes", &value) &&
+        !android::base::ReadFileToString(sysfs_dir + "/../queue/discard_max_bytes", &value)) {
+        return Errorf("Failed to read discard_max_bytes for {}", blockdev_path);
+    }
+    rtrim(value);
+    return strtoull(value.c_str(), nullptr, 0);
+}
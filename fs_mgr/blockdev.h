@@ -19,3 +19,4 @@
 
 android::base::Result<void> ConfigureQueueDepth(const std::string& loop_device_path,
                                                 const std::string& file_path);
+android::base::Result<uint64_t> BlockDeviceDiscardMaxBytes(const std::string& blockdev_path);
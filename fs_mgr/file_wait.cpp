@@ -25,8 +25,11 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <functional>
+#include <set>
 #include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -224,6 +227,112 @@ bool WaitForFile(const std::string& path, const std::chrono::milliseconds relati
 #endif
 }
 
+static bool PollForFiles(const std::vector<std::string>& paths,
+                         const std::chrono::time_point<std::chrono::steady_clock>& start_time,
+                         const std::chrono::milliseconds relative_timeout) {
+    for (const auto& path : paths) {
+        auto timeout = relative_timeout;
+        if (timeout != std::chrono::milliseconds::max()) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start_time);
+            timeout = std::max(relative_timeout - elapsed, 0ms);
+        }
+        if (!PollForFile(path, timeout)) return false;
+    }
+    return true;
+}
+
+#if defined(__linux__)
+static bool FileExists(const std::string& path) {
+    return !access(path.c_str(), F_OK) || errno != ENOENT;
+}
+
+// Drop every path that has appeared since the last check.
+static void PrunePendingFiles(std::vector<std::string>* pending) {
+    pending->erase(std::remove_if(pending->begin(), pending->end(), FileExists), pending->end());
+}
+#endif
+
+bool WaitForFiles(const std::vector<std::string>& paths,
+                  const std::chrono::milliseconds relative_timeout) {
+#if defined(__linux__)
+    auto start_time = std::chrono::steady_clock::now();
+
+    std::vector<std::string> pending = paths;
+    PrunePendingFiles(&pending);
+    if (pending.empty()) return true;
+
+    unique_fd inotify_fd(inotify_init1(IN_CLOEXEC | IN_NONBLOCK));
+    if (inotify_fd < 0) {
+        PLOG(ERROR) << "inotify_init1 failed";
+        return PollForFiles(pending, start_time, relative_timeout);
+    }
+
+    // Device nodes for a batch usually share a directory, so this is
+    // typically a single watch.
+    std::set<std::string> dirs;
+    for (const auto& path : pending) {
+        dirs.emplace(android::base::Dirname(path));
+    }
+    for (const auto& dir : dirs) {
+        if (inotify_add_watch(inotify_fd, dir.c_str(), IN_CREATE) < 0) {
+            PLOG(ERROR) << "inotify_add_watch failed: " << dir;
+            return PollForFiles(pending, start_time, relative_timeout);
+        }
+    }
+
+    // Files may have appeared before the watches were added.
+    PrunePendingFiles(&pending);
+
+    static constexpr size_t kBufferSize = sizeof(struct inotify_event) + NAME_MAX + 1;
+    char buffer[kBufferSize];
+    while (!pending.empty()) {
+        int remaining_ms = -1;
+        if (relative_timeout != std::chrono::milliseconds::max()) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start_time);
+            auto remaining = (relative_timeout - elapsed).count();
+            if (remaining <= 0) break;
+            remaining_ms = static_cast<int>(std::min<int64_t>(remaining, INT_MAX));
+        }
+
+        struct pollfd event = {
+                .fd = inotify_fd,
+                .events = POLLIN,
+                .revents = 0,
+        };
+        int rv = poll(&event, 1, remaining_ms);
+        if (rv < 0) {
+            if (errno == EINTR) continue;
+            PLOG(ERROR) << "poll for inotify failed";
+            return PollForFiles(pending, start_time, relative_timeout);
+        }
+        if (event.revents & POLLERR) {
+            LOG(ERROR) << "error reading inotify";
+            return PollForFiles(pending, start_time, relative_timeout);
+        }
+
+        // As in OneShotInotify, it's cheaper to re-check the pending set than
+        // to match event names against it.
+        while (true) {
+            ssize_t n = TEMP_FAILURE_RETRY(read(inotify_fd, buffer, sizeof(buffer)));
+            if (n > 0) continue;
+            if (n < 0 && errno != EAGAIN) {
+                PLOG(ERROR) << "read inotify failed";
+                return PollForFiles(pending, start_time, relative_timeout);
+            }
+            break;
+        }
+        PrunePendingFiles(&pending);
+    }
+
+    PrunePendingFiles(&pending);
+    return pending.empty();
+#else
+    return PollForFiles(paths, std::chrono::steady_clock::now(), relative_timeout);
+#endif
+}
+
 // Wait at most |relative_timeout| milliseconds for |path| to stop existing.
 bool WaitForFileDeleted(const std::string& path, const std::chrono::milliseconds relative_timeout) {
 #if defined(__linux__)
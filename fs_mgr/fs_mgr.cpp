@@ -35,9 +35,11 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <numeric>
@@ -727,6 +729,68 @@ static bool check_if_preventative_fsck_needed(const FstabEntry& entry) {
     return true;
 }
 
+// Results of fsck runs triggered only by the "check" fstab flag are cached here, one file per
+// mount point. A cached ext4 filesystem is not checked again as long as it is clean and has
+// been mounted exactly once, by us, since the cached result was recorded. Enabled with
+// ro.fs_mgr.fsck_cache.
+static constexpr char kFsckCacheDir[] = "/metadata/fsck";
+
+static std::string fsck_cache_path(const FstabEntry& entry) {
+    return std::string(kFsckCacheDir) + "/" + Basename(entry.mount_point);
+}
+
+static std::string fsck_cache_key(const struct ext4_super_block* sb) {
+    std::string uuid;
+    for (auto byte : sb->s_uuid) {
+        uuid += StringPrintf("%02x", byte);
+    }
+    return uuid + " " + std::to_string(le16_to_cpu(sb->s_mnt_count));
+}
+
+static bool fsck_cache_enabled(const FstabEntry& entry) {
+    return is_extfs(entry.fs_type) && entry.mount_point != "/" &&
+           GetBoolProperty("ro.fs_mgr.fsck_cache", false);
+}
+
+// Returns true if the filesystem is unchanged since its last cached check, i.e. it is clean
+// and the only mount since the check is the one that followed it.
+static bool is_fsck_cached(const std::string& blk_device, const FstabEntry& entry) {
+    if (!fsck_cache_enabled(entry)) return false;
+
+    struct ext4_super_block sb;
+    int fs_stat = 0;
+    if (!read_ext4_superblock(blk_device, &sb, &fs_stat)) return false;
+    if ((sb.s_state & EXT4_VALID_FS) == 0 || (sb.s_state & EXT4_ERROR_FS) != 0 ||
+        (sb.s_feature_incompat & EXT4_FEATURE_INCOMPAT_RECOVER) != 0) {
+        return false;
+    }
+
+    std::string cached;
+    if (!android::base::ReadFileToString(fsck_cache_path(entry), &cached)) return false;
+    auto last_mount = sb;
+    last_mount.s_mnt_count = cpu_to_le16(le16_to_cpu(sb.s_mnt_count) - 1);
+    return android::base::Trim(cached) == fsck_cache_key(&last_mount);
+}
+
+// Records the superblock state after a check, or forgets it if the check did not succeed.
+static void record_fsck_result(const std::string& blk_device, const FstabEntry& entry,
+                               int fs_stat) {
+    if (!fsck_cache_enabled(entry)) return;
+
+    const auto path = fsck_cache_path(entry);
+    struct ext4_super_block sb;
+    if ((fs_stat & (FS_STAT_FSCK_FAILED | FS_STAT_RO_MOUNT_FAILED | FS_STAT_RO_UNMOUNT_FAILED)) ||
+        !read_ext4_superblock(blk_device, &sb, &fs_stat)) {
+        unlink(path.c_str());
+        return;
+    }
+    // /metadata is not mounted yet during first stage mount, so silently skip the cache.
+    if (mkdir(kFsckCacheDir, 0700) && errno != EEXIST) return;
+    if (!android::base::WriteStringToFile(fsck_cache_key(&sb), path)) {
+        PERROR << "Failed to write " << path;
+    }
+}
+
 //
 // Prepare the filesystem on the given block device to be mounted.
 //
@@ -777,9 +841,16 @@ static int prepare_fs_for_mount(const std::string& blk_device, const FstabEntry&
         }
     }
 
-    if (check_if_preventative_fsck_needed(entry) || entry.fs_mgr_flags.check ||
-        (fs_stat & (FS_STAT_UNCLEAN_SHUTDOWN | FS_STAT_QUOTA_ENABLED))) {
-        check_fs(blk_device, entry.fs_type, mount_point, &fs_stat);
+    const bool preventative_fsck = check_if_preventative_fsck_needed(entry);
+    const bool needs_fsck = preventative_fsck ||
+                            (fs_stat & (FS_STAT_UNCLEAN_SHUTDOWN | FS_STAT_QUOTA_ENABLED));
+    if (needs_fsck || entry.fs_mgr_flags.check) {
+        if (!needs_fsck && is_fsck_cached(blk_device, entry)) {
+            LINFO << "Skipping fsck on " << realpath(blk_device) << ", unchanged since last check";
+        } else {
+            check_fs(blk_device, entry.fs_type, mount_point, &fs_stat);
+        }
+        record_fsck_result(blk_device, entry, fs_stat);
     }
 
     if (is_extfs(entry.fs_type) &&
@@ -1422,8 +1493,66 @@ static bool IsMountPointMounted(const std::string& mount_point) {
     return GetEntryForMountPoint(&fstab, mount_point) != nullptr;
 }
 
+// A group of fstab entries for one mount point that fs_mgr_mount_all() mounts on its own
+// thread. Only entries whose failure handling does not involve formatting, encryption or
+// checkpointing are queued, so the result can be reported without re-entering the main loop.
+struct ParallelMount {
+    int start_idx;
+    int end_idx;
+    int attempted_idx = -1;
+    int mount_errno = 0;
+    bool mounted = false;
+};
+
+static bool CanMountInParallel(const Fstab& fstab, int start_idx, int end_idx) {
+    for (int i = start_idx; i <= end_idx; i++) {
+        const auto& entry = fstab[i];
+        if (entry.mount_point == "/data" || entry.fs_mgr_flags.formattable ||
+            entry.fs_mgr_flags.file_encryption || should_use_metadata_encryption(entry) ||
+            entry.fs_mgr_flags.checkpoint_blk || entry.fs_mgr_flags.checkpoint_fs) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns true if |entry| has to wait for |pending| to be mounted, i.e. one mount point is
+// nested inside the other or both use the same block device.
+static bool DependsOnPendingMount(const FstabEntry& entry, const FstabEntry& pending) {
+    if (entry.blk_device == pending.blk_device) {
+        return true;
+    }
+    const auto& a = entry.mount_point;
+    const auto& b = pending.mount_point;
+    return a == b || StartsWith(a, b + "/") || StartsWith(b, a + "/");
+}
+
+static void RunParallelMounts(Fstab* fstab, std::vector<ParallelMount>* mounts) {
+    Timer t;
+    std::vector<std::thread> threads;
+    for (auto& mount : *mounts) {
+        threads.emplace_back([fstab, &mount] {
+            Timer entry_timer;
+            mount.mounted = mount_with_alternatives(*fstab, mount.start_idx, &mount.end_idx,
+                                                    &mount.attempted_idx);
+            mount.mount_errno = errno;
+            LINFO << "Parallel mount of " << (*fstab)[mount.start_idx].mount_point
+                  << (mount.mounted ? " succeeded" : " failed") << " in "
+                  << entry_timer.duration().count() << "ms";
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    LINFO << "Mounted " << mounts->size() << " fstab entries in parallel in "
+          << t.duration().count() << "ms";
+}
+
 // When multiple fstab records share the same mount_point, it will try to mount each
 // one in turn, and ignore any duplicates after a first successful mount.
+// If ro.fs_mgr.mount_all.parallel is set, mount points that do not need formatting,
+// encryption or checkpointing are mounted concurrently. A queued mount point is always
+// mounted before any entry nested inside it and before the next sequential mount.
 // Returns -1 on error, and  FS_MGR_MNTALL_* otherwise.
 MountAllResult fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
     int encryptable = FS_MGR_MNTALL_DEV_NOT_ENCRYPTABLE;
@@ -1439,6 +1568,39 @@ MountAllResult fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
 
     bool scratch_can_be_mounted = true;
 
+    const bool parallel = GetBoolProperty("ro.fs_mgr.mount_all.parallel", false);
+    std::vector<ParallelMount> pending_mounts;
+    auto flush_pending_mounts = [&]() {
+        if (pending_mounts.empty()) {
+            return;
+        }
+        RunParallelMounts(fstab, &pending_mounts);
+        for (const auto& mount : pending_mounts) {
+            auto& attempted_entry = (*fstab)[mount.attempted_idx];
+            if (mount.mounted) {
+                MountOverlayfs(attempted_entry, &scratch_can_be_mounted);
+                continue;
+            }
+            wiped = partition_wiped((*fstab)[mount.start_idx].blk_device.c_str());
+            errno = mount.mount_errno;
+            if (attempted_entry.fs_mgr_flags.no_fail) {
+                PERROR << android::base::StringPrintf(
+                        "Ignoring failure to mount an un-encryptable or wiped "
+                        "partition on %s at %s options: %s",
+                        attempted_entry.blk_device.c_str(), attempted_entry.mount_point.c_str(),
+                        attempted_entry.fs_options.c_str());
+            } else {
+                PERROR << android::base::StringPrintf(
+                        "Failed to mount an un-encryptable or wiped partition "
+                        "on %s at %s options: %s",
+                        attempted_entry.blk_device.c_str(), attempted_entry.mount_point.c_str(),
+                        attempted_entry.fs_options.c_str());
+                ++error_count;
+            }
+        }
+        pending_mounts.clear();
+    };
+
     // Keep i int to prevent unsigned integer overflow from (i = top_idx - 1),
     // where top_idx is 0. It will give SIGABRT
     for (int i = 0; i < static_cast<int>(fstab->size()); i++) {
@@ -1512,6 +1674,7 @@ MountAllResult fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
                 avb_handle = AvbHandle::Open();
                 if (!avb_handle) {
                     LERROR << "Failed to open AvbHandle";
+                    flush_pending_mounts();
                     set_type_property(encryptable);
                     return {FS_MGR_MNTALL_FAIL, userdata_mounted};
                 }
@@ -1532,6 +1695,27 @@ MountAllResult fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
             }
         }
 
+        if (parallel) {
+            int end_idx = i;
+            while (end_idx + 1 < static_cast<int>(fstab->size()) &&
+                   (*fstab)[end_idx + 1].mount_point == current_entry.mount_point) {
+                end_idx++;
+            }
+            if (CanMountInParallel(*fstab, i, end_idx)) {
+                for (const auto& mount : pending_mounts) {
+                    if (DependsOnPendingMount(current_entry, (*fstab)[mount.start_idx])) {
+                        flush_pending_mounts();
+                        break;
+                    }
+                }
+                pending_mounts.push_back({.start_idx = i, .end_idx = end_idx});
+                i = end_idx;
+                continue;
+            }
+        }
+        // Everything queued before this entry must be mounted first.
+        flush_pending_mounts();
+
         int last_idx_inspected;
         int top_idx = i;
         int attempted_idx = -1;
@@ -1662,6 +1846,8 @@ MountAllResult fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
             continue;
         }
     }
+    flush_pending_mounts();
+
     if (userdata_mounted) {
         Fstab mounted_fstab;
         if (!ReadFstabFromFile("/proc/mounts", &mounted_fstab)) {
@@ -2092,7 +2278,7 @@ static bool PrepareZramBackingDevice(off64_t size) {
     // Allocate loop device and attach it to file_path.
     LoopControl loop_control;
     std::string loop_device;
-    if (!loop_control.Attach(target_fd.get(), 5s, &loop_device)) {
+    if (!loop_control.Attach(target_fd.get(), 5s, &loop_device, true /* direct_io */)) {
         return false;
     }
 
@@ -2102,7 +2288,6 @@ static bool PrepareZramBackingDevice(off64_t size) {
         LOG(DEBUG) << "Failed to config queue depth: " << ret.error().message();
     }
 
-    // set block size & direct IO
     unique_fd loop_fd(TEMP_FAILURE_RETRY(open(loop_device.c_str(), O_RDWR | O_CLOEXEC)));
     if (loop_fd.get() == -1) {
         PERROR << "Cannot open " << loop_device;
@@ -2111,23 +2296,45 @@ static bool PrepareZramBackingDevice(off64_t size) {
     if (!LoopControl::SetAutoClearStatus(loop_fd.get())) {
         PERROR << "Failed set LO_FLAGS_AUTOCLEAR for " << loop_device;
     }
-    if (!LoopControl::EnableDirectIo(loop_fd.get())) {
-        return false;
-    }
 
     return InstallZramDevice(loop_device);
 }
 
 bool fs_mgr_swapon_all(const Fstab& fstab) {
+    // Setting up the zram backing device means allocating a file on /data and
+    // waiting for a loop device, which is the slowest part of this function.
+    // Start it now so that it overlaps with waiting for the zram node and with
+    // any swap entries listed ahead of it. Only the first zram entry is
+    // prepared ahead of time, since every entry shares the same backing file.
+    auto zram_entry = std::find_if(fstab.begin(), fstab.end(), [](const auto& entry) {
+        return entry.fs_type == "swap" && entry.zram_size > 0;
+    });
+    std::future<bool> zram_backing_dev;
+    if (zram_entry != fstab.end() && zram_entry->zram_backingdev_size > 0) {
+        zram_backing_dev = std::async(std::launch::async, PrepareZramBackingDevice,
+                                      zram_entry->zram_backingdev_size);
+    }
+
     bool ret = true;
-    for (const auto& entry : fstab) {
+    for (auto it = fstab.begin(); it != fstab.end(); ++it) {
+        const auto& entry = *it;
         // Skip non-swap entries.
         if (entry.fs_type != "swap") {
             continue;
         }
 
         if (entry.zram_size > 0) {
-            if (!PrepareZramBackingDevice(entry.zram_backingdev_size)) {
+            if (entry.fs_mgr_flags.wait && !WaitForFile(entry.blk_device, 20s)) {
+                LERROR << "Skipping zram setup for '" << entry.blk_device << "'";
+                ret = false;
+                continue;
+            }
+
+            // The backing device must be installed before disksize is set.
+            bool backing_dev_ok = (it == zram_entry && zram_backing_dev.valid())
+                                          ? zram_backing_dev.get()
+                                          : PrepareZramBackingDevice(entry.zram_backingdev_size);
+            if (!backing_dev_ok) {
                 LERROR << "Failure of zram backing device file for '" << entry.blk_device << "'";
             }
             // A zram_size was specified, so we need to configure the
@@ -138,7 +138,7 @@ bool CreateDmTable(CreateLogicalPartitionParams params, DmTable* table) {
 
 bool CreateLogicalPartitions(const std::string& block_device) {
     uint32_t slot = SlotNumberForSlotSuffix(fs_mgr_get_slot_suffix());
-    auto metadata = ReadMetadata(block_device.c_str(), slot);
+    auto metadata = ReadMetadataView(PartitionOpener(), block_device, slot);
     if (!metadata) {
         LOG(ERROR) << "Could not read partition table.";
         return true;
@@ -159,6 +159,8 @@ bool CreateLogicalPartitions(const LpMetadata& metadata, const std::string& supe
             .force_writable = true,
 #endif
     };
+    android::dm::DmTransaction transaction;
+    std::vector<std::string> names;
     for (const auto& partition : metadata.partitions) {
         if (!partition.num_extents) {
             LINFO << "Skipping zero-length logical partition: " << GetPartitionName(partition);
@@ -169,13 +171,30 @@ bool CreateLogicalPartitions(const LpMetadata& metadata, const std::string& supe
             continue;
         }
 
-        params.partition = &partition;
+        auto partition_params = params;
+        partition_params.partition = &partition;
 
-        std::string ignore_path;
-        if (!CreateLogicalPartition(params, &ignore_path)) {
+        CreateLogicalPartitionParams::OwnedData owned_data;
+        DmTable table;
+        if (!partition_params.InitDefaults(&owned_data) ||
+            !CreateDmTableInternal(partition_params, &table)) {
             LERROR << "Could not create logical partition: " << GetPartitionName(partition);
             return false;
         }
+        transaction.CreateDevice(partition_params.GetDeviceName(), table);
+        names.emplace_back(partition_params.GetDeviceName());
+    }
+
+    // Nothing waits on these devices here, so issue all of the ioctls in one
+    // transaction rather than one CreateDevice round-trip per partition.
+    if (!transaction.Commit(std::chrono::milliseconds::zero())) {
+        LERROR << "Could not create logical partitions on " << super_device;
+        return false;
+    }
+    for (const auto& name : names) {
+        std::string path;
+        transaction.GetDevicePath(name, &path);
+        LINFO << "Created logical partition " << name << " on device " << path;
     }
     return true;
 }
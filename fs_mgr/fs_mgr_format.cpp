@@ -23,7 +23,14 @@
 #include <errno.h>
 #include <cutils/partition_utils.h>
 #include <sys/mount.h>
+#include <linux/fs.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <android-base/chrono_utils.h>
 #include <android-base/properties.h>
 #include <android-base/unique_fd.h>
 #include <ext4_utils/ext4.h>
@@ -34,6 +41,7 @@
 #include <selinux/selinux.h>
 #include <string>
 
+#include "blockdev.h"
 #include "fs_mgr_priv.h"
 
 using android::base::unique_fd;
@@ -57,8 +65,73 @@ static int get_dev_sz(const std::string& fs_blkdev, uint64_t* dev_sz) {
     return 0;
 }
 
+// Discard the first |size| bytes of |fs_blkdev| from several threads at once,
+// in batches sized to the queue's discard limit, so that mkfs can be told to
+// skip its own single-threaded discard. Returns false if the device does not
+// support discard or any batch failed, in which case mkfs should discard as
+// it normally would.
+static bool discard_blkdev(const std::string& fs_blkdev, uint64_t size) {
+    // Each ioctl covers several maximally sized requests so the queue stays
+    // busy without one huge discard serializing behind the others.
+    constexpr uint64_t kRequestsPerBatch = 8;
+    constexpr unsigned int kMaxThreads = 4;
+
+    auto discard_max = BlockDeviceDiscardMaxBytes(fs_blkdev);
+    if (!discard_max.ok()) {
+        LERROR << discard_max.error();
+        return false;
+    }
+    // Keep batches sector aligned; discard_max_bytes always is, but be
+    // defensive since a misaligned range fails with EINVAL.
+    const uint64_t batch = (*discard_max * kRequestsPerBatch) & ~uint64_t(511);
+    size &= ~uint64_t(511);
+    if (!batch || !size) {
+        return false;
+    }
+
+    android::base::Timer t;
+    std::atomic<uint64_t> next_offset = 0;
+    std::atomic<bool> failed = false;
+    auto worker = [&]() {
+        unique_fd fd(TEMP_FAILURE_RETRY(open(fs_blkdev.c_str(), O_RDWR | O_CLOEXEC)));
+        if (fd < 0) {
+            PERROR << "Cannot open " << fs_blkdev << " for discard";
+            failed = true;
+            return;
+        }
+        while (!failed) {
+            uint64_t offset = next_offset.fetch_add(batch);
+            if (offset >= size) break;
+            uint64_t range[2] = {offset, std::min(batch, size - offset)};
+            if (ioctl(fd, BLKDISCARD, &range) < 0) {
+                PERROR << "BLKDISCARD failed on " << fs_blkdev << " at offset " << offset;
+                failed = true;
+            }
+        }
+    };
+
+    const uint64_t num_batches = (size + batch - 1) / batch;
+    unsigned int num_threads = std::min(std::thread::hardware_concurrency(), kMaxThreads);
+    num_threads = std::max(1u, static_cast<unsigned int>(std::min<uint64_t>(num_threads,
+                                                                            num_batches)));
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (failed) {
+        return false;
+    }
+    LINFO << "Discarded " << size << " bytes of " << fs_blkdev << " with " << num_threads
+          << " threads in " << t.duration().count() << "ms";
+    return true;
+}
+
 static int format_ext4(const std::string& fs_blkdev, const std::string& fs_mnt_point,
-                       bool needs_projid, bool needs_metadata_csum) {
+                       bool needs_projid, bool needs_metadata_csum, bool parallel_discard) {
     uint64_t dev_sz;
     int rc = 0;
 
@@ -80,6 +153,11 @@ static int format_ext4(const std::string& fs_blkdev, const std::string& fs_mnt_p
 
     std::vector<const char*> mke2fs_args = {"/system/bin/mke2fs", "-t", "ext4", "-b", "4096"};
 
+    if (parallel_discard && discard_blkdev(fs_blkdev, (dev_sz / 4096) * 4096)) {
+        mke2fs_args.push_back("-E");
+        mke2fs_args.push_back("nodiscard");
+    }
+
     // Project ID's require wider inodes. The Quotas themselves are enabled by tune2fs during boot.
     if (needs_projid) {
         mke2fs_args.push_back("-I");
@@ -126,7 +204,7 @@ static int format_ext4(const std::string& fs_blkdev, const std::string& fs_mnt_p
 
 static int format_f2fs(const std::string& fs_blkdev, uint64_t dev_sz, bool needs_projid,
                        bool needs_casefold, bool fs_compress, bool is_zoned,
-                       const std::vector<std::string>& user_devices) {
+                       const std::vector<std::string>& user_devices, bool parallel_discard) {
     if (!dev_sz) {
         int rc = get_dev_sz(fs_blkdev, &dev_sz);
         if (rc) {
@@ -164,6 +242,13 @@ static int format_f2fs(const std::string& fs_blkdev, uint64_t dev_sz, bool needs
     if (is_zoned) {
         args.push_back("-m");
     }
+    // Zoned and multi-device layouts span more than |fs_blkdev|, so leave
+    // discarding those to make_f2fs.
+    if (parallel_discard && !is_zoned && user_devices.empty() &&
+        discard_blkdev(fs_blkdev, (dev_sz / getpagesize()) * getpagesize())) {
+        args.push_back("-t");
+        args.push_back("0");
+    }
     for (auto& device : user_devices) {
         args.push_back("-c");
         args.push_back(device.c_str());
@@ -188,13 +273,18 @@ int fs_mgr_do_format(const FstabEntry& entry) {
         needs_casefold = android::base::GetBoolProperty("external_storage.casefold.enabled", false);
     }
 
+    // Discard the device up front from several threads instead of letting
+    // mkfs do it in one pass.
+    bool parallel_discard = android::base::GetBoolProperty("ro.fs_mgr.format.parallel_discard",
+                                                           false);
+
     if (entry.fs_type == "f2fs") {
         return format_f2fs(entry.blk_device, entry.length, needs_projid, needs_casefold,
                            entry.fs_mgr_flags.fs_compress, entry.fs_mgr_flags.is_zoned,
-                           entry.user_devices);
+                           entry.user_devices, parallel_discard);
     } else if (entry.fs_type == "ext4") {
         return format_ext4(entry.blk_device, entry.mount_point, needs_projid,
-                           entry.fs_mgr_flags.ext_meta_csum);
+                           entry.fs_mgr_flags.ext_meta_csum, parallel_discard);
     } else {
         LERROR << "File system type '" << entry.fs_type << "' is not supported";
         return -EINVAL;
@@ -30,6 +30,7 @@
 #include <string>
 #include <vector>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
@@ -383,6 +384,8 @@ static std::string GetDsuScratchDevice() {
 bool MakeScratchFilesystem(const std::string& scratch_device) {
     // Force mkfs by design for overlay support of adb remount, simplify and
     // thus do not rely on fsck to correct problems that could creep in.
+    // Scratch is freshly allocated and only holds overrides, so skip the discard pass over the
+    // whole device, which dominates mkfs time on large super partitions.
     auto fs_type = ""s;
     auto command = ""s;
     if (!access(kMkF2fs, X_OK) && fs_mgr_filesystem_available("f2fs")) {
@@ -391,10 +394,11 @@ bool MakeScratchFilesystem(const std::string& scratch_device) {
         command += std::to_string(getpagesize());
         command = kMkF2fs + " -b "s;
         command += std::to_string(getpagesize());
-        command += " -f -d1 -l" + android::base::Basename(kScratchMountPoint);
+        command += " -f -d1 -t0 -l" + android::base::Basename(kScratchMountPoint);
     } else if (!access(kMkExt4, X_OK) && fs_mgr_filesystem_available("ext4")) {
         fs_type = "ext4";
-        command = kMkExt4 + " -F -b 4096 -t ext4 -m 0 -O has_journal -M "s + kScratchMountPoint;
+        command = kMkExt4 + " -F -b 4096 -t ext4 -m 0 -O has_journal -E nodiscard -M "s +
+                  kScratchMountPoint;
     } else {
         LERROR << "No supported mkfs command or filesystem driver available, supported filesystems "
                   "are: f2fs, ext4";
@@ -673,6 +677,8 @@ bool fs_mgr_overlayfs_setup(const Fstab& fstab, const char* mount_point, bool* w
         return false;
     }
 
+    android::base::Timer t;
+
     auto candidates = fs_mgr_overlayfs_candidate_list(fstab);
     for (auto it = candidates.begin(); it != candidates.end();) {
         if (mount_point &&
@@ -726,6 +732,8 @@ bool fs_mgr_overlayfs_setup(const Fstab& fstab, const char* mount_point, bool* w
         auto fstab_mount_point = fs_mgr_mount_point(entry.mount_point);
         ok &= fs_mgr_overlayfs_setup_one(overlay, fstab_mount_point, want_reboot);
     }
+    LOG(INFO) << "Set up " << candidates.size() << " overlays on " << dir << " in "
+              << t.duration().count() << "ms";
     return ok;
 }
 
@@ -31,6 +31,7 @@
 #include <string>
 #include <vector>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/macros.h>
 #include <android-base/properties.h>
@@ -644,6 +645,28 @@ bool fs_mgr_wants_overlayfs(FstabEntry* entry) {
     return true;
 }
 
+// Same as fs_mgr_overlayfs_already_mounted(), checked against an already parsed /proc/mounts so
+// callers looking at many mount points don't have to read it again for each of them.
+static bool fs_mgr_overlayfs_already_mounted(const Fstab& mounts, const std::string& mount_point,
+                                             bool overlay_only = true) {
+    const auto lowerdir = kLowerdirOption + mount_point;
+    for (const auto& entry : GetEntriesForMountPoint(&mounts, mount_point)) {
+        if (!overlay_only) {
+            return true;
+        }
+        if (entry->fs_type != "overlay" && entry->fs_type != "overlayfs") {
+            continue;
+        }
+        const auto options = android::base::Split(entry->fs_options, ",");
+        for (const auto& opt : options) {
+            if (opt == lowerdir) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 Fstab fs_mgr_overlayfs_candidate_list(const Fstab& fstab) {
     android::fs_mgr::Fstab mounts;
     if (!android::fs_mgr::ReadFstabFromFile("/proc/mounts", &mounts)) {
@@ -663,7 +686,7 @@ Fstab fs_mgr_overlayfs_candidate_list(const Fstab& fstab) {
         }
 
         FstabEntry new_entry = entry;
-        if (!fs_mgr_overlayfs_already_mounted(entry.mount_point) &&
+        if (!fs_mgr_overlayfs_already_mounted(mounts, entry.mount_point) &&
             !fs_mgr_wants_overlayfs(&new_entry)) {
             continue;
         }
@@ -725,12 +748,22 @@ bool fs_mgr_overlayfs_mount_all(Fstab* fstab) {
         rmdir(kMoveMountTempDir);
     });
 
+    android::base::Timer t;
+    Fstab mounts;
+    if (!ReadFstabFromProcMounts(&mounts)) {
+        PLOG(ERROR) << "Failed to read /proc/mounts";
+        return false;
+    }
     auto ret = true;
-    auto scratch_can_be_mounted = !fs_mgr_overlayfs_already_mounted(kScratchMountPoint, false);
+    auto mounted = 0;
+    auto scratch_can_be_mounted = !fs_mgr_overlayfs_already_mounted(mounts, kScratchMountPoint,
+                                                                    false);
     for (const auto& entry : fs_mgr_overlayfs_candidate_list(*fstab)) {
         if (fs_mgr_is_verity_enabled(entry)) continue;
         auto mount_point = fs_mgr_mount_point(entry.mount_point);
-        if (fs_mgr_overlayfs_already_mounted(mount_point)) {
+        // Candidates have distinct mount points and each one only mounts on its own, so the
+        // snapshot of /proc/mounts taken above stays valid for this check.
+        if (fs_mgr_overlayfs_already_mounted(mounts, mount_point)) {
             continue;
         }
         if (scratch_can_be_mounted) {
@@ -738,7 +771,9 @@ bool fs_mgr_overlayfs_mount_all(Fstab* fstab) {
             TryMountScratch();
         }
         ret &= fs_mgr_overlayfs_mount_one(entry);
+        mounted++;
     }
+    LINFO << "Mounted " << mounted << " overlays in " << t.duration().count() << "ms";
     return ret;
 }
 
@@ -763,22 +798,7 @@ bool fs_mgr_overlayfs_already_mounted(const std::string& mount_point, bool overl
     if (!ReadFstabFromProcMounts(&fstab)) {
         return false;
     }
-    const auto lowerdir = kLowerdirOption + mount_point;
-    for (const auto& entry : GetEntriesForMountPoint(&fstab, mount_point)) {
-        if (!overlay_only) {
-            return true;
-        }
-        if (entry->fs_type != "overlay" && entry->fs_type != "overlayfs") {
-            continue;
-        }
-        const auto options = android::base::Split(entry->fs_options, ",");
-        for (const auto& opt : options) {
-            if (opt == lowerdir) {
-                return true;
-            }
-        }
-    }
-    return false;
+    return fs_mgr_overlayfs_already_mounted(fstab, mount_point, overlay_only);
 }
 
 namespace android {
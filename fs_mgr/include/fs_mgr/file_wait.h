@@ -16,6 +16,7 @@
 
 #include <chrono>
 #include <string>
+#include <vector>
 
 namespace android {
 namespace fs_mgr {
@@ -28,6 +29,14 @@ namespace fs_mgr {
 // block indefinitely.
 bool WaitForFile(const std::string& path, const std::chrono::milliseconds relative_timeout);
 
+// Wait at most |relative_timeout| milliseconds for every path in |paths| to
+// exist. This is equivalent to calling WaitForFile() on each path in turn, but
+// uses a single inotify instance for the whole batch, so waiting on many
+// device nodes costs one wakeup per directory change rather than one setup
+// per node.
+bool WaitForFiles(const std::vector<std::string>& paths,
+                  const std::chrono::milliseconds relative_timeout);
+
 // Wait at most |relative_timeout| milliseconds for |path| to stop existing.
 // Note that this only returns true if the inode itself no longer exists, i.e.,
 // all outstanding file descriptors have been closed.
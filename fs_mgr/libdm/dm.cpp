@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/utsname.h>
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <string_view>
@@ -32,6 +33,7 @@
 #include <android-base/macros.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
+#include <fs_mgr/file_wait.h>
 #include <uuid/uuid.h>
 
 #include "utility.h"
@@ -178,6 +180,21 @@ static bool IsRecovery() {
     return access("/system/bin/recovery", F_OK) == 0;
 }
 
+// Old recovery ueventd does not create by-uuid links, so callers must wait
+// for the dm-N path instead.
+static bool UseLegacyDevicePath() {
+    if (!IsRecovery()) {
+        return false;
+    }
+    bool non_ab_device = android::base::GetProperty("ro.build.ab_update", "").empty();
+    int sdk = android::base::GetIntProperty("ro.build.version.sdk", 0);
+    if (non_ab_device && sdk && sdk <= 29) {
+        LOG(INFO) << "Detected ueventd incompatibility, reverting to legacy libdm behavior.";
+        return true;
+    }
+    return false;
+}
+
 bool DeviceMapper::CreateEmptyDevice(const std::string& name) {
     std::string uuid = GenerateUuid();
     return CreateDevice(name, uuid);
@@ -198,13 +215,8 @@ bool DeviceMapper::WaitForDevice(const std::string& name,
         return true;
     }
 
-    if (IsRecovery()) {
-        bool non_ab_device = android::base::GetProperty("ro.build.ab_update", "").empty();
-        int sdk = android::base::GetIntProperty("ro.build.version.sdk", 0);
-        if (non_ab_device && sdk && sdk <= 29) {
-            LOG(INFO) << "Detected ueventd incompatibility, reverting to legacy libdm behavior.";
-            unique_path = *path;
-        }
+    if (UseLegacyDevicePath()) {
+        unique_path = *path;
     }
 
     if (!WaitForFile(unique_path, timeout_ms)) {
@@ -318,7 +330,7 @@ bool DeviceMapper::CreateDevice(const std::string& name, const DmTable& table) {
 
 bool DeviceMapper::LoadTable(const std::string& name, const DmTable& table) {
     std::string ioctl_buffer(sizeof(struct dm_ioctl), 0);
-    ioctl_buffer += table.Serialize();
+    table.SerializeTo(&ioctl_buffer);
 
     struct dm_ioctl* io = reinterpret_cast<struct dm_ioctl*>(&ioctl_buffer[0]);
     InitIo(io, name);
@@ -789,5 +801,167 @@ bool DeviceMapper::SendMessage(const std::string& name, uint64_t sector,
     return true;
 }
 
+DmTransaction::Entry& DmTransaction::AddEntry(const std::string& name, const DmTable* table) {
+    auto& entry = entries_.emplace_back();
+    entry.name = name;
+    if (table) {
+        entry.has_table = true;
+        entry.table = table->Serialize();
+        entry.num_targets = static_cast<uint32_t>(table->num_targets());
+        entry.readonly = table->readonly();
+    }
+    return entry;
+}
+
+void DmTransaction::CreateDevice(const std::string& name, const DmTable& table) {
+    auto& entry = AddEntry(name, &table);
+    entry.create = true;
+    entry.resume = true;
+    entry.uuid = GenerateUuid();
+}
+
+void DmTransaction::LoadTable(const std::string& name, const DmTable& table) {
+    AddEntry(name, &table);
+}
+
+void DmTransaction::Resume(const std::string& name) {
+    AddEntry(name, nullptr).resume = true;
+}
+
+bool DmTransaction::Ioctl(const std::string& name, const char* op, unsigned long request,
+                          struct dm_ioctl* io) {
+    auto start = std::chrono::steady_clock::now();
+    int rv = ioctl(dm_.fd_, request, io);
+    int saved_errno = errno;
+    timings_.emplace_back(IoctlTiming{name, op, std::chrono::steady_clock::now() - start});
+    if (rv) {
+        errno = saved_errno;
+        PLOG(ERROR) << "DmTransaction: " << op << " failed for [" << name << "]";
+        return false;
+    }
+    return true;
+}
+
+bool DmTransaction::IssueIoctls(std::vector<std::string>* created) {
+    for (const auto& entry : entries_) {
+        if (!entry.create) continue;
+        if (entry.name.empty() || entry.name.size() >= DM_NAME_LEN) {
+            LOG(ERROR) << "[" << entry.name << "] is not a valid device mapper name";
+            return false;
+        }
+        struct dm_ioctl io;
+        dm_.InitIo(&io, entry.name);
+        snprintf(io.uuid, sizeof(io.uuid), "%s", entry.uuid.c_str());
+        if (!Ioctl(entry.name, "create", DM_DEV_CREATE, &io)) {
+            return false;
+        }
+        created->emplace_back(entry.name);
+    }
+
+    for (const auto& entry : entries_) {
+        if (!entry.has_table) continue;
+        std::string ioctl_buffer(sizeof(struct dm_ioctl), 0);
+        ioctl_buffer += entry.table;
+
+        struct dm_ioctl* io = reinterpret_cast<struct dm_ioctl*>(&ioctl_buffer[0]);
+        dm_.InitIo(io, entry.name);
+        io->data_size = ioctl_buffer.size();
+        io->data_start = sizeof(struct dm_ioctl);
+        io->target_count = entry.num_targets;
+        if (entry.readonly) {
+            io->flags |= DM_READONLY_FLAG;
+        }
+        if (!Ioctl(entry.name, "load", DM_TABLE_LOAD, io)) {
+            return false;
+        }
+    }
+
+    // The resume reply carries the device number, which is all that is
+    // needed to build the dm-N path and major:minor string.
+    for (const auto& entry : entries_) {
+        if (!entry.resume) continue;
+        struct dm_ioctl io;
+        dm_.InitIo(&io, entry.name);
+        if (!Ioctl(entry.name, "resume", DM_DEV_SUSPEND, &io)) {
+            return false;
+        }
+        devices_[entry.name] = io.dev;
+    }
+    return true;
+}
+
+bool DmTransaction::WaitForDevices(const std::chrono::milliseconds& timeout_ms) {
+    bool legacy = UseLegacyDevicePath();
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::string> paths;
+    for (const auto& entry : entries_) {
+        if (!entry.create) continue;
+
+        std::string path = "/dev/block/mapper/by-uuid/"s + entry.uuid;
+        if (legacy) {
+            GetDevicePath(entry.name, &path);
+        }
+        paths.emplace_back(std::move(path));
+    }
+
+    // Wait for the whole batch at once; ueventd processes the devices
+    // concurrently, so there is no point in waiting for them one at a time.
+    bool ok = android::fs_mgr::WaitForFiles(paths, timeout_ms);
+    if (!ok) {
+        LOG(ERROR) << "Failed waiting for device paths: " << android::base::Join(paths, ", ");
+    }
+    wait_time_ = std::chrono::steady_clock::now() - begin;
+    return ok;
+}
+
+bool DmTransaction::Commit(const std::chrono::milliseconds& timeout_ms) {
+    CHECK(!committed_) << "DmTransaction can only be committed once";
+    committed_ = true;
+
+    std::vector<std::string> created;
+    bool ok = IssueIoctls(&created);
+    if (ok && timeout_ms > 0ms) {
+        ok = WaitForDevices(timeout_ms);
+    }
+
+    std::chrono::nanoseconds ioctl_time = {};
+    for (const auto& timing : timings_) {
+        ioctl_time += timing.duration;
+    }
+    LOG(INFO) << "DmTransaction: " << timings_.size() << " ioctls for " << entries_.size()
+              << " operations took "
+              << std::chrono::duration_cast<std::chrono::microseconds>(ioctl_time).count()
+              << "us, waited "
+              << std::chrono::duration_cast<std::chrono::microseconds>(wait_time_).count()
+              << "us for devices";
+
+    if (!ok) {
+        for (auto iter = created.rbegin(); iter != created.rend(); iter++) {
+            dm_.DeleteDevice(*iter);
+        }
+        devices_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool DmTransaction::GetDevicePath(const std::string& name, std::string* path) const {
+    auto iter = devices_.find(name);
+    if (iter == devices_.end()) {
+        return false;
+    }
+    *path = "/dev/block/dm-" + std::to_string(minor(iter->second));
+    return true;
+}
+
+bool DmTransaction::GetDeviceString(const std::string& name, std::string* dev) const {
+    auto iter = devices_.find(name);
+    if (iter == devices_.end()) {
+        return false;
+    }
+    *dev = std::to_string(major(iter->second)) + ":" + std::to_string(minor(iter->second));
+    return true;
+}
+
 }  // namespace dm
 }  // namespace android
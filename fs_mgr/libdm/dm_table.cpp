@@ -58,15 +58,24 @@ uint64_t DmTable::num_sectors() const {
 // with sector == 0, and iterate over each target to get its table
 // serialized.
 std::string DmTable::Serialize() const {
+    std::string table;
+    SerializeTo(&table);
+    return table;
+}
+
+void DmTable::SerializeTo(std::string* out) const {
     if (!valid()) {
-        return "";
+        return;
     }
 
-    std::string table;
+    // Most targets are linear targets over a /dev/block path, which fit in
+    // this much space; reserving it up front avoids most reallocations.
+    static constexpr size_t kTypicalParameterSize = 64;
+    out->reserve(out->size() + targets_.size() * (sizeof(dm_target_spec) + kTypicalParameterSize));
+
     for (const auto& target : targets_) {
-        table += target->Serialize();
+        target->SerializeTo(out);
     }
-    return table;
 }
 
 }  // namespace dm
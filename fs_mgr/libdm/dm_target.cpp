@@ -20,6 +20,9 @@
 #include <stdio.h>
 #include <sys/types.h>
 
+#include <charconv>
+#include <limits>
+
 #include <android-base/logging.h>
 #include <android-base/macros.h>
 #include <android-base/parseint.h>
@@ -31,25 +34,28 @@ namespace android {
 namespace dm {
 
 std::string DmTarget::Serialize() const {
-    // Create a string containing a dm_target_spec, parameter data, and an
-    // explicit null terminator.
-    std::string data(sizeof(dm_target_spec), '\0');
-    data += GetParameterString();
-    data.push_back('\0');
+    std::string data;
+    SerializeTo(&data);
+    return data;
+}
+
+void DmTarget::SerializeTo(std::string* out) const {
+    // Append a dm_target_spec, parameter data, and an explicit null
+    // terminator.
+    size_t offset = out->size();
+    out->resize(offset + sizeof(dm_target_spec), '\0');
+    AppendParameterString(out);
+    out->push_back('\0');
 
     // The kernel expects each target to be 8-byte aligned.
-    size_t padding = DM_ALIGN(data.size()) - data.size();
-    for (size_t i = 0; i < padding; i++) {
-        data.push_back('\0');
-    }
+    out->resize(offset + DM_ALIGN(out->size() - offset), '\0');
 
     // Finally fill in the dm_target_spec.
-    struct dm_target_spec* spec = reinterpret_cast<struct dm_target_spec*>(&data[0]);
+    struct dm_target_spec* spec = reinterpret_cast<struct dm_target_spec*>(&(*out)[offset]);
     spec->sector_start = start();
     spec->length = size();
     snprintf(spec->target_type, sizeof(spec->target_type), "%s", name().c_str());
-    spec->next = (uint32_t)data.size();
-    return data;
+    spec->next = (uint32_t)(out->size() - offset);
 }
 
 std::string DmTargetZero::GetParameterString() const {
@@ -58,7 +64,17 @@ std::string DmTargetZero::GetParameterString() const {
 }
 
 std::string DmTargetLinear::GetParameterString() const {
-    return block_device_ + " " + std::to_string(physical_sector_);
+    std::string params;
+    AppendParameterString(&params);
+    return params;
+}
+
+void DmTargetLinear::AppendParameterString(std::string* out) const {
+    char sector[std::numeric_limits<uint64_t>::digits10 + 1];
+    auto result = std::to_chars(sector, sector + sizeof(sector), physical_sector_);
+    out->append(block_device_);
+    out->push_back(' ');
+    out->append(sector, result.ptr);
 }
 
 std::string DmTargetStripe::GetParameterString() const {
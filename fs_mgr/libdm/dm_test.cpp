@@ -183,6 +183,24 @@ TEST_F(DmTest, DmSuspendResume) {
     ASSERT_EQ(dm.GetState(dev.name()), DmDeviceState::ACTIVE);
 }
 
+TEST_F(DmTest, LinearArgs) {
+    DmTargetLinear target(0, 4096, "/dev/loop0", UINT64_MAX);
+    ASSERT_EQ(target.name(), "linear");
+    ASSERT_TRUE(target.Valid());
+    ASSERT_EQ(target.GetParameterString(), "/dev/loop0 18446744073709551615");
+
+    DmTable table;
+    ASSERT_TRUE(table.Emplace<DmTargetLinear>(0, 8, "/dev/loop0", 0));
+    ASSERT_TRUE(table.Emplace<DmTargetLinear>(8, 8, "/dev/loop1", 1234));
+    std::string expected = DmTargetLinear(0, 8, "/dev/loop0", 0).Serialize() +
+                           DmTargetLinear(8, 8, "/dev/loop1", 1234).Serialize();
+    ASSERT_EQ(table.Serialize(), expected);
+
+    std::string prefixed = "header";
+    table.SerializeTo(&prefixed);
+    ASSERT_EQ(prefixed, "header" + expected);
+}
+
 TEST_F(DmTest, StripeArgs) {
     DmTargetStripe target(0, 4096, 1024, "/dev/loop0", "/dev/loop1");
     ASSERT_EQ(target.name(), "striped");
@@ -763,6 +781,60 @@ TEST_F(DmTest, UeventAfterLoadTable) {
     ASSERT_TRUE(dm.DeleteDevice(test_name_));
 }
 
+TEST_F(DmTest, Transaction) {
+    auto& dm = DeviceMapper::Instance();
+    std::vector<std::string> names = {test_name_ + "-a", test_name_ + "-b"};
+    auto guard = make_scope_guard([&]() {
+        for (const auto& name : names) {
+            dm.DeleteDeviceIfExists(name, 5s);
+        }
+    });
+
+    DmTransaction transaction;
+    for (const auto& name : names) {
+        DmTable table;
+        ASSERT_TRUE(table.Emplace<DmTargetZero>(0, 1));
+        transaction.CreateDevice(name, table);
+    }
+    ASSERT_TRUE(transaction.Commit(5s));
+
+    // One create, load and resume per device.
+    ASSERT_EQ(transaction.timings().size(), names.size() * 3);
+    for (const auto& name : names) {
+        ASSERT_EQ(dm.GetState(name), DmDeviceState::ACTIVE);
+
+        std::string path, expected_path;
+        ASSERT_TRUE(transaction.GetDevicePath(name, &path));
+        ASSERT_TRUE(dm.GetDmDevicePathByName(name, &expected_path));
+        EXPECT_EQ(path, expected_path);
+        EXPECT_EQ(access(path.c_str(), F_OK), 0);
+
+        std::string dev, expected_dev;
+        ASSERT_TRUE(transaction.GetDeviceString(name, &dev));
+        ASSERT_TRUE(dm.GetDeviceString(name, &expected_dev));
+        EXPECT_EQ(dev, expected_dev);
+    }
+}
+
+TEST_F(DmTest, TransactionRollback) {
+    auto& dm = DeviceMapper::Instance();
+    std::string name = test_name_ + "-a";
+    auto guard = make_scope_guard([&]() { dm.DeleteDeviceIfExists(name, 5s); });
+
+    DmTable table;
+    ASSERT_TRUE(table.Emplace<DmTargetZero>(0, 1));
+
+    // The second create of the same name fails, so the first is undone.
+    DmTransaction transaction;
+    transaction.CreateDevice(name, table);
+    transaction.CreateDevice(name, table);
+    ASSERT_FALSE(transaction.Commit(0ms));
+    ASSERT_EQ(dm.GetState(name), DmDeviceState::INVALID);
+
+    std::string path;
+    ASSERT_FALSE(transaction.GetDevicePath(name, &path));
+}
+
 TEST_F(DmTest, GetNameAndUuid) {
     auto& dm = DeviceMapper::Instance();
     ASSERT_TRUE(dm.CreatePlaceholderDevice(test_name_));
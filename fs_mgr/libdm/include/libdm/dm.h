@@ -328,6 +328,8 @@ class DeviceMapper final : public IDeviceMapper {
 
     DeviceMapper();
 
+    friend class DmTransaction;
+
     int fd_;
     // Non-copyable & Non-movable
     DeviceMapper(const DeviceMapper&) = delete;
@@ -336,6 +338,84 @@ class DeviceMapper final : public IDeviceMapper {
     DeviceMapper(DeviceMapper&&) = delete;
 };
 
+// Queues create, load and resume operations for several device-mapper
+// devices, and issues them back to back when Commit() is called. All ioctls
+// are sent before any uevent wait starts, so ueventd works through the whole
+// batch while the first device node is awaited, and each wait only covers
+// time that has not already elapsed.
+//
+// Compared to calling DeviceMapper::CreateDevice in a loop, a transaction
+// also skips the DM_DEV_STATUS round-trips used to look up each device's
+// path, since the create and resume replies already carry that information.
+//
+// Tables are serialized when queued, so they cannot refer to devices created
+// by the same transaction. Stacked devices need one transaction per layer.
+class DmTransaction final {
+  public:
+    struct IoctlTiming {
+        std::string name;
+        // One of "create", "load" or "resume".
+        const char* op;
+        std::chrono::nanoseconds duration;
+    };
+
+    explicit DmTransaction(DeviceMapper& dm = DeviceMapper::Instance()) : dm_(dm) {}
+
+    // Create a new device with a unique path, load |table| and activate it.
+    void CreateDevice(const std::string& name, const DmTable& table);
+
+    // Load |table| into the inactive slot of an existing device.
+    void LoadTable(const std::string& name, const DmTable& table);
+
+    // Resume an existing device, activating its inactive table.
+    void Resume(const std::string& name);
+
+    // Issue all queued operations: every create, then every load, then every
+    // resume, each group in the order queued. If |timeout_ms| is non-zero,
+    // then wait, against a single deadline, for the unique path of each
+    // created device to appear.
+    //
+    // On failure, every device created by this transaction is deleted, and
+    // false is returned. A transaction can only be committed once.
+    bool Commit(const std::chrono::milliseconds& timeout_ms);
+
+    // After a successful Commit(), return the /dev/block/dm-N path or the
+    // major:minor string of a device that was created or resumed.
+    bool GetDevicePath(const std::string& name, std::string* path) const;
+    bool GetDeviceString(const std::string& name, std::string* dev) const;
+
+    // Per-ioctl timings from the last Commit(), in the order issued.
+    const std::vector<IoctlTiming>& timings() const { return timings_; }
+
+    // Time Commit() spent waiting for device nodes.
+    std::chrono::nanoseconds wait_time() const { return wait_time_; }
+
+  private:
+    struct Entry {
+        std::string name;
+        bool create = false;
+        bool resume = false;
+        bool has_table = false;
+        std::string table;
+        uint32_t num_targets = 0;
+        bool readonly = false;
+        std::string uuid;
+    };
+
+    Entry& AddEntry(const std::string& name, const DmTable* table);
+    bool Ioctl(const std::string& name, const char* op, unsigned long request,
+               struct dm_ioctl* io);
+    bool IssueIoctls(std::vector<std::string>* created);
+    bool WaitForDevices(const std::chrono::milliseconds& timeout_ms);
+
+    DeviceMapper& dm_;
+    std::vector<Entry> entries_;
+    std::map<std::string, dev_t> devices_;
+    std::vector<IoctlTiming> timings_;
+    std::chrono::nanoseconds wait_time_ = {};
+    bool committed_ = false;
+};
+
 }  // namespace dm
 }  // namespace android
 
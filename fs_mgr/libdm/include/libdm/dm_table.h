@@ -68,6 +68,11 @@ class DmTable {
     // as part of the DM_TABLE_LOAD ioctl.
     std::string Serialize() const;
 
+    // Appends what Serialize() would return to |out|. Tables for fragmented
+    // images can have thousands of targets, so this writes them straight
+    // into the caller's buffer.
+    void SerializeTo(std::string* out) const;
+
     void set_readonly(bool readonly) { readonly_ = readonly; }
     bool readonly() const { return readonly_; }
 
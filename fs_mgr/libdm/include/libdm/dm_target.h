@@ -80,6 +80,10 @@ class DmTarget {
     // must implement this, for it to be used on a device.
     std::string Serialize() const;
 
+    // Appends what Serialize() would return to |out|, without building the
+    // target in a temporary string first.
+    void SerializeTo(std::string* out) const;
+
     virtual bool Valid() const { return true; }
 
   protected:
@@ -87,6 +91,10 @@ class DmTarget {
     // for this target type.
     virtual std::string GetParameterString() const = 0;
 
+    // Append the parameter string to |out|. Target types that appear in very
+    // large tables override this to skip the temporary string.
+    virtual void AppendParameterString(std::string* out) const { *out += GetParameterString(); }
+
   private:
     // logical sector number start and total length (in terms of 512-byte sectors) represented
     // by this target within a DmTable.
@@ -111,6 +119,9 @@ class DmTargetLinear final : public DmTarget {
     std::string GetParameterString() const override;
     const std::string& block_device() const { return block_device_; }
 
+  protected:
+    void AppendParameterString(std::string* out) const override;
+
   private:
     std::string block_device_;
     uint64_t physical_sector_;
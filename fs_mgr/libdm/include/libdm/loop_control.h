@@ -19,6 +19,7 @@
 
 #include <chrono>
 #include <string>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 
@@ -37,8 +38,20 @@ class LoopControl final {
     //
     // The caller does not have to call WaitForFile(); it is implicitly called.
     // The given |timeout_ms| covers both potential sources of timeout.
-    bool Attach(int file_fd, const std::chrono::milliseconds& timeout_ms,
-                std::string* loopdev) const;
+    //
+    // If |direct_io| is true, the device is also switched to direct I/O with
+    // a 4096-byte logical block size, as EnableDirectIo() does. Where the
+    // kernel supports LOOP_CONFIGURE (5.8+), this happens atomically with
+    // attaching the file.
+    bool Attach(int file_fd, const std::chrono::milliseconds& timeout_ms, std::string* loopdev,
+                bool direct_io = false) const;
+
+    // Pre-allocate and open up to |count| free loop devices, so that the next
+    // |count| calls to Attach() do not have to wait for ueventd to create and
+    // label device nodes. This is useful before attaching many loop devices
+    // in a row. Devices that another process takes in the meantime are
+    // skipped by Attach(). Returns false if no device could be reserved.
+    bool Reserve(size_t count, const std::chrono::milliseconds& timeout_ms);
 
     // Detach the loop device given by 'loopdev' from the attached backing file.
     bool Detach(const std::string& loopdev) const;
@@ -55,11 +68,21 @@ class LoopControl final {
     LoopControl(LoopControl&&) = default;
 
   private:
+    struct ReservedDevice {
+        std::string path;
+        android::base::unique_fd fd;
+    };
+
     bool FindFreeLoopDevice(std::string* loopdev) const;
+    bool AttachReserved(int file_fd, std::string* loopdev, bool direct_io) const;
+    static int Configure(int loop_fd, int file_fd, bool direct_io);
 
     static constexpr const char* kLoopControlDevice = "/dev/loop-control";
 
     android::base::unique_fd control_fd_;
+    // Consumed by Attach(), which is const because attaching does not change
+    // which loop-control node this object refers to.
+    mutable std::vector<ReservedDevice> reserved_;
 };
 
 // Create a temporary loop device around a file descriptor or path.
@@ -23,6 +23,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <android-base/unique_fd.h>
@@ -40,7 +43,11 @@ LoopControl::LoopControl() : control_fd_(-1) {
 }
 
 bool LoopControl::Attach(int file_fd, const std::chrono::milliseconds& timeout_ms,
-                         std::string* loopdev) const {
+                         std::string* loopdev, bool direct_io) const {
+    if (AttachReserved(file_fd, loopdev, direct_io)) {
+        return true;
+    }
+
     auto start_time = std::chrono::steady_clock::now();
     auto condition = [&]() -> WaitResult {
         if (!FindFreeLoopDevice(loopdev)) {
@@ -62,11 +69,11 @@ bool LoopControl::Attach(int file_fd, const std::chrono::milliseconds& timeout_m
             return WaitResult::Fail;
         }
 
-        if (int rc = ioctl(loop_fd, LOOP_SET_FD, file_fd); rc == 0) {
+        if (int rc = Configure(loop_fd, file_fd, direct_io); rc == 0) {
             return WaitResult::Done;
         }
         if (errno != EBUSY) {
-            PLOG(ERROR) << "Failed LOOP_SET_FD";
+            PLOG(ERROR) << "Failed to attach " << *loopdev;
             return WaitResult::Fail;
         }
         return WaitResult::Wait;
@@ -78,6 +85,122 @@ bool LoopControl::Attach(int file_fd, const std::chrono::milliseconds& timeout_m
     return true;
 }
 
+bool LoopControl::AttachReserved(int file_fd, std::string* loopdev, bool direct_io) const {
+    while (!reserved_.empty()) {
+        ReservedDevice device = std::move(reserved_.back());
+        reserved_.pop_back();
+
+        if (Configure(device.fd, file_fd, direct_io) == 0) {
+            *loopdev = std::move(device.path);
+            return true;
+        }
+        if (errno != EBUSY) {
+            PLOG(ERROR) << "Failed to attach " << device.path;
+            return false;
+        }
+        // Another process attached this device after we reserved it.
+    }
+    return false;
+}
+
+// Returns 0 on success, or -1 with errno set. EBUSY means the device was
+// taken by someone else and a different one should be tried.
+int LoopControl::Configure(int loop_fd, int file_fd, bool direct_io) {
+#if defined(LOOP_CONFIGURE)
+    // Kernels before 5.8 do not have LOOP_CONFIGURE; remember that so we only
+    // probe once.
+    static std::atomic<bool> has_loop_configure = true;
+    if (has_loop_configure) {
+        struct loop_config config = {};
+        config.fd = file_fd;
+        if (direct_io) {
+            config.block_size = 4096;
+            config.info.lo_flags = LO_FLAGS_DIRECT_IO;
+        }
+        if (ioctl(loop_fd, LOOP_CONFIGURE, &config) == 0) {
+            if (!direct_io) {
+                return 0;
+            }
+            // LOOP_CONFIGURE quietly falls back to buffered I/O if the backing
+            // file can't do direct I/O, whereas LOOP_SET_DIRECT_IO fails.
+            struct loop_info64 info = {};
+            if (ioctl(loop_fd, LOOP_GET_STATUS64, &info) == 0 &&
+                (info.lo_flags & LO_FLAGS_DIRECT_IO)) {
+                return 0;
+            }
+            LOG(ERROR) << "Could not set loop direct IO";
+            ioctl(loop_fd, LOOP_CLR_FD, 0);
+            errno = EINVAL;
+            return -1;
+        }
+        if (errno != EINVAL && errno != ENOTTY) {
+            return -1;
+        }
+        has_loop_configure = false;
+    }
+#endif
+
+    if (ioctl(loop_fd, LOOP_SET_FD, file_fd)) {
+        return -1;
+    }
+    if (direct_io && !EnableDirectIo(loop_fd)) {
+        int saved_errno = errno;
+        ioctl(loop_fd, LOOP_CLR_FD, 0);
+        // Don't let a direct I/O failure look like a busy device.
+        errno = (saved_errno == EBUSY) ? EIO : saved_errno;
+        return -1;
+    }
+    return 0;
+}
+
+bool LoopControl::Reserve(size_t count, const std::chrono::milliseconds& timeout_ms) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    int index = ioctl(control_fd_, LOOP_CTL_GET_FREE);
+    if (index < 0) {
+        PLOG(ERROR) << "Failed to get free loop device";
+        return false;
+    }
+
+    // LOOP_CTL_GET_FREE keeps returning the same device until it is bound, so
+    // reserve consecutive indices starting at the first free one, creating
+    // the ones that do not exist yet. Bound devices are skipped, but give up
+    // after a while so that a busy system cannot keep us here.
+    size_t reserved = 0;
+    for (size_t attempts = 0; reserved < count && attempts < count * 2; attempts++, index++) {
+        if (ioctl(control_fd_, LOOP_CTL_ADD, index) < 0 && errno != EEXIST) {
+            PLOG(ERROR) << "Failed to add loop device " << index;
+            break;
+        }
+
+        auto path = ::android::base::StringPrintf("/dev/block/loop%d", index);
+        auto now = std::chrono::steady_clock::now();
+        auto time_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time);
+        if (!WaitForFile(path, timeout_ms - time_elapsed)) {
+            LOG(ERROR) << "Timed out waiting for path: " << path;
+            break;
+        }
+
+        android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDWR | O_CLOEXEC)));
+        if (fd < 0) {
+            PLOG(ERROR) << "Failed to open: " << path;
+            break;
+        }
+
+        // Unbound devices fail LOOP_GET_STATUS64 with ENXIO.
+        struct loop_info64 info;
+        if (ioctl(fd, LOOP_GET_STATUS64, &info) == 0 || errno != ENXIO) {
+            continue;
+        }
+        reserved_.push_back({std::move(path), std::move(fd)});
+        reserved++;
+    }
+
+    // Attach() takes devices from the back.
+    std::reverse(reserved_.end() - reserved, reserved_.end());
+    return reserved > 0;
+}
+
 bool LoopControl::Detach(const std::string& loopdev) const {
     if (loopdev.empty()) {
         LOG(ERROR) << "Must provide a loop device";
@@ -62,3 +62,25 @@ TEST(libdm, LoopControl) {
     ASSERT_TRUE(android::base::ReadFully(loop_fd, buffer, sizeof(buffer)));
     ASSERT_EQ(memcmp(buffer, "Hello", 6), 0);
 }
+
+TEST(libdm, LoopControlReserve) {
+    LoopControl control;
+    ASSERT_TRUE(control.Reserve(2, 10s));
+
+    unique_fd fds[2] = {TempFile(), TempFile()};
+    std::string devices[2];
+    for (size_t i = 0; i < 2; i++) {
+        ASSERT_GE(fds[i], 0);
+        ASSERT_TRUE(control.Attach(fds[i], 10s, &devices[i]));
+    }
+    EXPECT_NE(devices[0], devices[1]);
+
+    for (const auto& device : devices) {
+        char buffer[6];
+        unique_fd loop_fd(open(device.c_str(), O_RDWR));
+        ASSERT_GE(loop_fd, 0);
+        ASSERT_TRUE(android::base::ReadFully(loop_fd, buffer, sizeof(buffer)));
+        ASSERT_EQ(memcmp(buffer, "Hello", 6), 0);
+        ASSERT_TRUE(control.Detach(device));
+    }
+}
@@ -20,6 +20,7 @@
 #include <thread>
 
 #include <android-base/logging.h>
+#include <fs_mgr/file_wait.h>
 
 using namespace std::literals;
 
@@ -43,33 +44,11 @@ bool WaitForCondition(const std::function<WaitResult()>& condition,
 }
 
 bool WaitForFile(const std::string& path, const std::chrono::milliseconds& timeout_ms) {
-    auto condition = [&]() -> WaitResult {
-        // If the file exists but returns EPERM or something, we consider the
-        // condition met.
-        if (access(path.c_str(), F_OK) != 0) {
-            if (errno == ENOENT) {
-                return WaitResult::Wait;
-            }
-            PLOG(ERROR) << "access failed: " << path;
-            return WaitResult::Fail;
-        }
-        return WaitResult::Done;
-    };
-    return WaitForCondition(condition, timeout_ms);
+    return android::fs_mgr::WaitForFile(path, timeout_ms);
 }
 
 bool WaitForFileDeleted(const std::string& path, const std::chrono::milliseconds& timeout_ms) {
-    auto condition = [&]() -> WaitResult {
-        if (access(path.c_str(), F_OK) == 0) {
-            return WaitResult::Wait;
-        }
-        if (errno != ENOENT) {
-            PLOG(ERROR) << "access failed: " << path;
-            return WaitResult::Fail;
-        }
-        return WaitResult::Done;
-    };
-    return WaitForCondition(condition, timeout_ms);
+    return android::fs_mgr::WaitForFileDeleted(path, timeout_ms);
 }
 
 }  // namespace dm
@@ -60,6 +60,9 @@ class ImageManagerBinder final : public IImageManager {
     bool IsImageMapped(const std::string& name) override;
     bool MapImageWithDeviceMapper(const IPartitionOpener& opener, const std::string& name,
                                   std::string* dev) override;
+    bool MapImagesWithDeviceMapper(const IPartitionOpener& opener,
+                                   const std::vector<std::string>& names,
+                                   std::map<std::string, std::string>* devs) override;
     FiemapStatus ZeroFillNewImage(const std::string& name, uint64_t bytes) override;
     bool RemoveAllImages() override;
     bool DisableImage(const std::string& name) override;
@@ -170,6 +173,16 @@ bool ImageManagerBinder::MapImageWithDeviceMapper(const IPartitionOpener& opener
     return false;
 }
 
+bool ImageManagerBinder::MapImagesWithDeviceMapper(const IPartitionOpener& opener,
+                                                   const std::vector<std::string>& names,
+                                                   std::map<std::string, std::string>* devs) {
+    (void)opener;
+    (void)names;
+    (void)devs;
+    LOG(ERROR) << "MapImagesWithDeviceMapper is not available over binder.";
+    return false;
+}
+
 std::vector<std::string> ImageManagerBinder::GetAllBackingImages() {
     std::vector<std::string> retval;
     auto status = manager_->getAllBackingImages(&retval);
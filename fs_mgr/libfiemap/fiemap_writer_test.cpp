@@ -286,7 +286,34 @@ TEST_F(SplitFiemapTest, Create) {
         EXPECT_EQ(access(path.c_str(), F_OK), 0);
     }
 
-    ASSERT_GE(extents.size(), files.size());
+    // Extents that are contiguous across pieces are merged, so there may be
+    // fewer extents than pieces, but they must still cover the whole file.
+    ASSERT_FALSE(extents.empty());
+    uint64_t total = 0;
+    for (const auto& extent : extents) {
+        total += extent.fe_length;
+    }
+    ASSERT_GE(total, 1024 * 768);
+}
+
+TEST_F(SplitFiemapTest, MergeContiguousExtents) {
+    auto ptr = SplitFiemap::Create(testfile, 1024 * 768, 1024 * 32);
+    ASSERT_NE(ptr, nullptr);
+
+    const auto& extents = ptr->extents();
+    ASSERT_FALSE(extents.empty());
+    ASSERT_LE(extents.size(), ptr->piece_extent_count());
+
+    uint64_t logical = 0;
+    for (size_t i = 0; i < extents.size(); i++) {
+        EXPECT_EQ(extents[i].fe_logical, logical);
+        logical += extents[i].fe_length;
+        if (i > 0) {
+            EXPECT_NE(extents[i - 1].fe_physical + extents[i - 1].fe_length,
+                      extents[i].fe_physical);
+        }
+    }
+    EXPECT_GE(logical, ptr->size());
 }
 
 TEST_F(SplitFiemapTest, Open) {
@@ -299,7 +326,8 @@ TEST_F(SplitFiemapTest, Open) {
     ASSERT_NE(ptr, nullptr);
 
     auto extents = ptr->extents();
-    ASSERT_GE(extents.size(), 24);
+    ASSERT_FALSE(extents.empty());
+    ASSERT_GE(ptr->piece_extent_count(), 24);
 }
 
 TEST_F(SplitFiemapTest, DeleteOnFail) {
@@ -419,6 +447,56 @@ TEST_F(SplitFiemapTest, WriteFileInChunks2) {
     EXPECT_EQ(memcmp(expected.data(), actual.data(), actual.size()), 0);
 }
 
+TEST_F(SplitFiemapTest, FlushPartialBlock) {
+    static constexpr size_t kChunkSize = 32768;
+    static constexpr size_t kSize = kChunkSize * 3;
+    auto ptr = SplitFiemap::Create(testfile, kSize, kChunkSize);
+    ASSERT_NE(ptr, nullptr);
+
+    auto buffer = std::make_unique<int[]>(kSize / sizeof(int));
+    for (size_t i = 0; i < kSize / sizeof(int); i++) {
+        buffer[i] = i;
+    }
+    char* data = reinterpret_cast<char*>(buffer.get());
+
+    // The write ends in the middle of a block of the second file.
+    static constexpr size_t kPartialSize = kChunkSize + 1000;
+    ASSERT_TRUE(ptr->Write(data, kPartialSize));
+    ASSERT_TRUE(ptr->Flush());
+    auto actual = ReadSplitFiles(testfile, 3);
+    ASSERT_EQ(actual.size(), kSize);
+    EXPECT_EQ(memcmp(data, actual.data(), kPartialSize), 0);
+
+    // Writing can continue after a flush.
+    ASSERT_TRUE(ptr->Write(data + kPartialSize, kSize - kPartialSize));
+    actual = ReadSplitFiles(testfile, 3);
+    ASSERT_EQ(actual.size(), kSize);
+    EXPECT_EQ(memcmp(data, actual.data(), kSize), 0);
+}
+
+TEST_F(SplitFiemapTest, WriteProgress) {
+    static constexpr size_t kChunkSize = 32768;
+    static constexpr size_t kSize = kChunkSize * 3;
+    auto ptr = SplitFiemap::Create(testfile, kSize, kChunkSize);
+    ASSERT_NE(ptr, nullptr);
+
+    uint64_t last_written = 0;
+    ptr->SetWriteProgressCallback([&](uint64_t written, uint64_t total) -> bool {
+        EXPECT_GT(written, last_written);
+        EXPECT_EQ(total, kSize);
+        last_written = written;
+        return written < kSize;
+    });
+
+    std::string data(kSize, 'x');
+    ASSERT_TRUE(ptr->Write(data.data(), kChunkSize));
+    EXPECT_EQ(last_written, kChunkSize);
+
+    // The callback cancels the write once everything was written.
+    ASSERT_FALSE(ptr->Write(data.data(), kSize - kChunkSize));
+    EXPECT_EQ(last_written, kSize);
+}
+
 TEST_F(SplitFiemapTest, WritePastEnd) {
     static constexpr size_t kChunkSize = 32768;
     static constexpr size_t kSize = kChunkSize * 3;
@@ -21,6 +21,7 @@
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
+#include <android-base/scopeguard.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <ext4_utils/ext4_utils.h>
@@ -51,6 +52,7 @@ using android::fs_mgr::DestroyLogicalPartition;
 using android::fs_mgr::GetBlockDevicePartitionName;
 using android::fs_mgr::GetBlockDevicePartitionNames;
 using android::fs_mgr::GetPartitionName;
+using android::fs_mgr::LpMetadata;
 
 static constexpr char kTestImageMetadataDir[] = "/metadata/gsi/test";
 static constexpr char kOtaTestImageMetadataDir[] = "/metadata/gsi/ota/test";
@@ -201,8 +203,11 @@ FiemapStatus ImageManager::CreateBackingImage(
     }
 
     bool readonly = !!(flags & CREATE_IMAGE_READONLY);
-    if (!UpdateMetadata(metadata_dir_, name, fw.get(), size, readonly)) {
-        return FiemapStatus::Error();
+    {
+        std::lock_guard<std::mutex> guard(metadata_lock_);
+        if (!UpdateMetadata(metadata_dir_, name, fw.get(), size, readonly)) {
+            return FiemapStatus::Error();
+        }
     }
 
     if (flags & CREATE_IMAGE_ZERO_FILL) {
@@ -290,6 +295,7 @@ bool ImageManager::DeleteBackingImage(const std::string& name) {
     if (!android::base::RemoveFileIfExists(status_file)) {
         LOG(ERROR) << "Error removing " << status_file << ": " << message;
     }
+    std::lock_guard<std::mutex> guard(metadata_lock_);
     return RemoveImageMetadata(metadata_dir_, name);
 }
 
@@ -302,13 +308,18 @@ bool ImageManager::MapWithDmLinear(const IPartitionOpener& opener, const std::st
     if (!metadata) {
         return false;
     }
+    return MapWithDmLinear(opener, *metadata.get(), name, timeout_ms, path);
+}
 
-    auto super = android::fs_mgr::GetMetadataSuperBlockDevice(*metadata.get());
+bool ImageManager::MapWithDmLinear(const IPartitionOpener& opener, const LpMetadata& metadata,
+                                   const std::string& name,
+                                   const std::chrono::milliseconds& timeout_ms, std::string* path) {
+    auto super = android::fs_mgr::GetMetadataSuperBlockDevice(metadata);
     auto block_device = android::fs_mgr::GetBlockDevicePartitionName(*super);
 
     CreateLogicalPartitionParams params = {
             .block_device = block_device,
-            .metadata = metadata.get(),
+            .metadata = &metadata,
             .partition_name = name,
             .force_writable = true,
             .timeout_ms = timeout_ms,
@@ -338,7 +349,9 @@ static bool CreateLoopDevice(LoopControl& control, const std::string& file,
         PLOG(ERROR) << "Could not open file: " << file;
         return false;
     }
-    if (!control.Attach(file_fd, timeout_ms, path)) {
+    // Direct I/O avoids caching the image in both the loop device and the
+    // backing file, which would use double the memory.
+    if (!control.Attach(file_fd, timeout_ms, path, true /* direct_io */)) {
         LOG(ERROR) << "Could not create loop device for: " << file;
         return false;
     }
@@ -440,20 +453,6 @@ bool ImageManager::MapWithLoopDeviceList(const std::vector<std::string>& device_
     return true;
 }
 
-static bool OptimizeLoopDevices(const std::vector<std::string>& device_list) {
-    for (const auto& device : device_list) {
-        unique_fd fd(open(device.c_str(), O_RDWR | O_CLOEXEC | O_NOFOLLOW));
-        if (fd < 0) {
-            PLOG(ERROR) << "Open failed: " << device;
-            return false;
-        }
-        if (!LoopControl::EnableDirectIo(fd)) {
-            return false;
-        }
-    }
-    return true;
-}
-
 // Helper to use one or more loop devices around image files.
 bool ImageManager::MapWithLoopDevice(const std::string& name,
                                      const std::chrono::milliseconds& timeout_ms,
@@ -471,6 +470,12 @@ bool ImageManager::MapWithLoopDevice(const std::string& name,
     std::vector<std::string> loop_devices;
     AutoDetachLoopDevices auto_detach(control, loop_devices);
 
+    // Split images need one loop device per file; set them all up front
+    // rather than waiting for each node in turn.
+    if (file_list.size() > 1) {
+        control.Reserve(file_list.size(), timeout_ms);
+    }
+
     auto start_time = std::chrono::steady_clock::now();
     for (const auto& file : file_list) {
         auto now = std::chrono::steady_clock::now();
@@ -487,11 +492,6 @@ bool ImageManager::MapWithLoopDevice(const std::string& name,
         return false;
     }
 
-    // If OptimizeLoopDevices fails, we'd use double the memory.
-    if (!OptimizeLoopDevices(loop_devices)) {
-        return false;
-    }
-
     // If there's only one loop device (by far the most common case, splits
     // will normally only happen on sdcards with FAT32), then just return that
     // as the block device. Otherwise, we need to use dm-linear to stitch
@@ -581,6 +581,47 @@ bool ImageManager::MapImageWithDeviceMapper(const IPartitionOpener& opener, cons
     return true;
 }
 
+bool ImageManager::MapImagesWithDeviceMapper(const IPartitionOpener& opener,
+                                             const std::vector<std::string>& names,
+                                             std::map<std::string, std::string>* devs) {
+    // Read the metadata once for the whole batch, rather than once per image.
+    auto metadata = OpenMetadata(metadata_dir_);
+    if (!metadata) {
+        return false;
+    }
+
+    // Issue all of the create/load ioctls first. Resolving the device strings
+    // afterward means each dm device has had the whole batch to settle.
+    std::vector<std::string> mapped;
+    auto unmap_on_failure = android::base::make_scope_guard([&]() -> void {
+        for (const auto& name : mapped) {
+            UnmapImageDevice(name, true);
+        }
+    });
+    for (const auto& name : names) {
+        std::string ignore_path;
+        if (!MapWithDmLinear(opener, *metadata.get(), name, {}, &ignore_path)) {
+            return false;
+        }
+        mapped.emplace_back(name);
+    }
+
+    auto& dm = DeviceMapper::Instance();
+    std::map<std::string, std::string> result;
+    for (const auto& name : mapped) {
+        std::string dev;
+        if (!dm.GetDeviceString(name, &dev)) {
+            LOG(ERROR) << "Could not determine major/minor for image " << name;
+            return false;
+        }
+        result.emplace(name, std::move(dev));
+    }
+
+    unmap_on_failure.Disable();
+    *devs = std::move(result);
+    return true;
+}
+
 bool ImageManager::UnmapImageDevice(const std::string& name) {
     return UnmapImageDevice(name, false);
 }
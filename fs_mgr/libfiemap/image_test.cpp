@@ -24,6 +24,7 @@
 
 #include <chrono>
 #include <iostream>
+#include <map>
 #include <thread>
 
 #include <android-base/file.h>
@@ -139,6 +140,38 @@ TEST_F(NativeTest, GetMappedImageDevice) {
     ASSERT_TRUE(manager_->UnmapImageDevice(base_name_));
 }
 
+TEST_F(NativeTest, MapImagesWithDeviceMapper) {
+    std::vector<std::string> names = {base_name_ + "_a", base_name_ + "_b"};
+    for (const auto& name : names) {
+        ASSERT_TRUE(manager_->CreateBackingImage(name, kTestImageSize, false, nullptr));
+    }
+
+    TestPartitionOpener opener;
+    std::map<std::string, std::string> devs;
+    ASSERT_TRUE(manager_->MapImagesWithDeviceMapper(opener, names, &devs));
+    ASSERT_EQ(devs.size(), names.size());
+
+    auto& dm = DeviceMapper::Instance();
+    for (const auto& name : names) {
+        ASSERT_TRUE(manager_->IsImageMapped(name));
+        std::string dev;
+        ASSERT_TRUE(dm.GetDeviceString(name, &dev));
+        EXPECT_EQ(devs[name], dev);
+    }
+
+    // A missing image fails the whole batch and leaves nothing mapped.
+    for (const auto& name : names) {
+        ASSERT_TRUE(manager_->UnmapImageDevice(name));
+    }
+    auto bad_names = names;
+    bad_names.emplace_back(base_name_ + "_missing");
+    ASSERT_FALSE(manager_->MapImagesWithDeviceMapper(opener, bad_names, &devs));
+    for (const auto& name : names) {
+        EXPECT_FALSE(manager_->IsImageMapped(name));
+        ASSERT_TRUE(manager_->DeleteBackingImage(name));
+    }
+}
+
 namespace {
 
 struct IsSubdirTestParam {
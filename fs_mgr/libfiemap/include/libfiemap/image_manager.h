@@ -20,16 +20,23 @@
 
 #include <chrono>
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 #include <libfiemap/fiemap_status.h>
 #include <liblp/partition_opener.h>
 
 namespace android {
+namespace fs_mgr {
+struct LpMetadata;
+}  // namespace fs_mgr
+
 namespace fiemap {
 
 class IImageManager {
@@ -97,6 +104,16 @@ class IImageManager {
     virtual bool MapImageWithDeviceMapper(const IPartitionOpener& opener, const std::string& name,
                                           std::string* dev) = 0;
 
+    // Map several images using device-mapper in one batch. The image metadata
+    // is read once, and all devices are created before any device strings are
+    // resolved. On success, |devs| maps each name to its major:minor device
+    // string. On failure, any image mapped by this call is unmapped again.
+    // Like MapImageWithDeviceMapper, this is only intended for first-stage
+    // init and is not available over binder.
+    virtual bool MapImagesWithDeviceMapper(const IPartitionOpener& opener,
+                                           const std::vector<std::string>& names,
+                                           std::map<std::string, std::string>* devs) = 0;
+
     // If an image was mapped, return the path to its device. Otherwise, return
     // false. Errors are not reported in this case, calling IsImageMapped is
     // not necessary.
@@ -157,6 +174,9 @@ class ImageManager final : public IImageManager {
     bool IsImageMapped(const std::string& name) override;
     bool MapImageWithDeviceMapper(const IPartitionOpener& opener, const std::string& name,
                                   std::string* dev) override;
+    bool MapImagesWithDeviceMapper(const IPartitionOpener& opener,
+                                   const std::vector<std::string>& names,
+                                   std::map<std::string, std::string>* devs) override;
     bool RemoveAllImages() override;
     bool DisableImage(const std::string& name) override;
     bool RemoveDisabledImages() override;
@@ -189,6 +209,9 @@ class ImageManager final : public IImageManager {
                                const std::chrono::milliseconds& timeout_ms, std::string* path);
     bool MapWithDmLinear(const IPartitionOpener& opener, const std::string& name,
                          const std::chrono::milliseconds& timeout_ms, std::string* path);
+    bool MapWithDmLinear(const IPartitionOpener& opener, const android::fs_mgr::LpMetadata& metadata,
+                         const std::string& name, const std::chrono::milliseconds& timeout_ms,
+                         std::string* path);
     bool UnmapImageDevice(const std::string& name, bool force);
     bool IsUnreliablePinningAllowed() const;
     bool MetadataDirIsTest() const;
@@ -202,6 +225,10 @@ class ImageManager final : public IImageManager {
     std::string data_dir_;
     std::unique_ptr<IPartitionOpener> partition_opener_;
     DeviceInfo device_info_;
+
+    // Serializes read-modify-write cycles of the metadata file, so that
+    // distinct images can be created concurrently.
+    std::mutex metadata_lock_;
 };
 
 // RAII helper class for mapping and opening devices with an ImageManager.
@@ -17,8 +17,11 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdlib.h>
 
+#include <chrono>
 #include <functional>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
@@ -65,12 +68,29 @@ class SplitFiemap final {
 
     // Helper method for writing data that spans files. Note there is no seek
     // method (yet); this starts at 0 and increments the position by |bytes|.
+    //
+    // Data is staged in block-aligned buffers and written in large O_DIRECT
+    // chunks; one buffer is written in the background while the next one is
+    // filled. Whole blocks are on disk by the time Write() returns. A trailing
+    // partial block is held back until more data arrives or Flush() is called.
     bool Write(const void* data, uint64_t bytes);
 
-    // Flush all writes to all split files.
+    // Write out any partial block held back by Write(), and flush all writes
+    // to all split files.
     bool Flush();
 
+    // Called from Write() with the number of bytes written so far and the
+    // total size. If it returns false, the write fails.
+    void SetWriteProgressCallback(ProgressCallback progress) {
+        write_progress_ = std::move(progress);
+    }
+
+    // Extents of the whole split file, in order. Extents that are physically
+    // contiguous across pieces are merged, and fe_logical is relative to the
+    // start of the first piece.
     const std::vector<struct fiemap_extent>& extents();
+    // Number of extents before merging across pieces.
+    size_t piece_extent_count() const;
     uint32_t block_size() const;
     uint64_t size() const { return total_size_; }
     const std::string& bdev_path() const;
@@ -84,6 +104,10 @@ class SplitFiemap final {
   private:
     SplitFiemap() = default;
     void AddFile(FiemapUniquePtr&& file);
+    bool OpenCursor(FiemapWriter* file);
+    bool WaitForWrite();
+    bool WritePartialBlock();
+    uint8_t* write_buffer(size_t index) const;
 
     bool creating_ = false;
     std::string list_file_;
@@ -95,6 +119,19 @@ class SplitFiemap final {
     size_t cursor_index_ = 0;
     uint64_t cursor_file_pos_ = 0;
     android::base::unique_fd cursor_fd_;
+
+    // Staging for Write(): two aligned buffers, the current one holding
+    // |buffered_| bytes starting at |cursor_file_pos_|, and the write of the
+    // other one in flight, if any.
+    std::unique_ptr<uint8_t, decltype(&::free)> write_buffers_{nullptr, ::free};
+    size_t buffer_index_ = 0;
+    size_t buffered_ = 0;
+    std::future<bool> pending_write_;
+    size_t pending_bytes_ = 0;
+
+    uint64_t bytes_written_ = 0;
+    ProgressCallback write_progress_;
+    std::chrono::steady_clock::time_point write_start_;
 };
 
 }  // namespace fiemap
@@ -16,12 +16,17 @@
 
 #include <libfiemap/split_fiemap_writer.h>
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
@@ -42,6 +47,9 @@ using android::base::unique_fd;
 // We use a four-digit suffix at the end of filenames.
 static const size_t kMaxFilePieces = 500;
 
+// Size of each of the two staging buffers used by Write().
+static const size_t kWriteBufferSize = 1024 * 1024;
+
 std::unique_ptr<SplitFiemap> SplitFiemap::Create(const std::string& file_path, uint64_t file_size,
                                                  uint64_t max_piece_size,
                                                  ProgressCallback progress) {
@@ -138,6 +146,12 @@ FiemapStatus SplitFiemap::Create(const std::string& file_path, uint64_t file_siz
     }
     fsync(fd.get());
 
+    // Each extent becomes a dm-linear target when the image is mapped, so the
+    // count is a good measure of how fragmented the allocation is.
+    LOG(INFO) << "Created " << file_path << " in " << out->files_.size() << " pieces with "
+              << out->extents().size() << " extents (" << out->piece_extent_count()
+              << " before merging across pieces)";
+
     // Unset this bit, so we don't unlink on destruction.
     out->creating_ = false;
     *out_val = std::move(out);
@@ -214,70 +228,186 @@ bool SplitFiemap::HasPinnedExtents() const {
 
 const std::vector<struct fiemap_extent>& SplitFiemap::extents() {
     if (extents_.empty()) {
+        // Pieces are allocated one after another, so the last extent of a
+        // piece is often physically followed by the first extent of the next.
+        // Merge those, so that the dm-linear table built from these extents
+        // has fewer targets.
+        uint64_t logical = 0;
         for (const auto& file : files_) {
-            const auto& extents = file->extents();
-            extents_.insert(extents_.end(), extents.begin(), extents.end());
+            for (const auto& extent : file->extents()) {
+                if (!extents_.empty()) {
+                    auto& last = extents_.back();
+                    if (last.fe_physical + last.fe_length == extent.fe_physical) {
+                        last.fe_length += extent.fe_length;
+                        last.fe_flags = extent.fe_flags;
+                        logical += extent.fe_length;
+                        continue;
+                    }
+                }
+                auto& added = extents_.emplace_back(extent);
+                added.fe_logical = logical;
+                logical += extent.fe_length;
+            }
         }
     }
     return extents_;
 }
 
+size_t SplitFiemap::piece_extent_count() const {
+    size_t count = 0;
+    for (const auto& file : files_) {
+        count += file->extents().size();
+    }
+    return count;
+}
+
+uint8_t* SplitFiemap::write_buffer(size_t index) const {
+    return write_buffers_.get() + index * kWriteBufferSize;
+}
+
+bool SplitFiemap::OpenCursor(FiemapWriter* file) {
+    // Pieces are a multiple of the block size, and Write() only writes whole
+    // blocks from aligned buffers, so the page cache can be bypassed. Fall
+    // back to buffered writes if the filesystem does not support O_DIRECT.
+    cursor_fd_.reset(open(file->file_path().c_str(), O_CLOEXEC | O_WRONLY | O_DIRECT));
+    if (cursor_fd_ < 0 && errno == EINVAL) {
+        cursor_fd_.reset(open(file->file_path().c_str(), O_CLOEXEC | O_WRONLY));
+    }
+    if (cursor_fd_ < 0) {
+        PLOG(ERROR) << "open failed: " << file->file_path();
+        return false;
+    }
+    CHECK(cursor_file_pos_ == 0);
+
+    // This is checked once per piece, and again for all of them in Flush().
+    if (!FiemapWriter::HasPinnedExtents(file->file_path())) {
+        LOG(ERROR) << "file is no longer pinned: " << file->file_path();
+        return false;
+    }
+    return true;
+}
+
+bool SplitFiemap::WaitForWrite() {
+    if (!pending_write_.valid()) {
+        return true;
+    }
+    if (!pending_write_.get()) {
+        return false;
+    }
+    bytes_written_ += pending_bytes_;
+    pending_bytes_ = 0;
+    if (write_progress_ && !write_progress_(bytes_written_, total_size_)) {
+        LOG(ERROR) << "write cancelled at " << bytes_written_ << " of " << total_size_ << " bytes";
+        return false;
+    }
+    return true;
+}
+
 bool SplitFiemap::Write(const void* data, uint64_t bytes) {
-    // Open the current file.
-    FiemapWriter* file = files_[cursor_index_].get();
+    if (bytes > total_size_ - bytes_written_ - buffered_) {
+        LOG(ERROR) << "write past end of file requested";
+        return false;
+    }
+    if (!write_buffers_) {
+        void* addr;
+        if (posix_memalign(&addr, getpagesize(), 2 * kWriteBufferSize)) {
+            LOG(ERROR) << "posix_memalign failed";
+            return false;
+        }
+        write_buffers_.reset(reinterpret_cast<uint8_t*>(addr));
+        write_start_ = std::chrono::steady_clock::now();
+    }
 
+    const uint64_t block_mask = block_size() - 1;
     const uint8_t* data_ptr = reinterpret_cast<const uint8_t*>(data);
     uint64_t bytes_remaining = bytes;
     while (bytes_remaining) {
-        // How many bytes can we write into the current file?
-        uint64_t file_bytes_left = file->size() - cursor_file_pos_;
-        if (!file_bytes_left) {
-            if (cursor_index_ == files_.size() - 1) {
-                LOG(ERROR) << "write past end of file requested";
+        FiemapWriter* file = files_[cursor_index_].get();
+        if (cursor_file_pos_ == file->size()) {
+            // No space left in the current file, so prep the next one. The
+            // write in flight may still be using the current fd.
+            if (!WaitForWrite()) {
                 return false;
             }
-
-            // No space left in the current file, but we have more files to
-            // use, so prep the next one.
             cursor_fd_ = {};
             cursor_file_pos_ = 0;
             file = files_[++cursor_index_].get();
-            file_bytes_left = file->size();
-        }
-
-        // Open the current file if it's not open.
-        if (cursor_fd_ < 0) {
-            cursor_fd_.reset(open(file->file_path().c_str(), O_CLOEXEC | O_WRONLY));
-            if (cursor_fd_ < 0) {
-                PLOG(ERROR) << "open failed: " << file->file_path();
-                return false;
-            }
-            CHECK(cursor_file_pos_ == 0);
         }
-
-        if (!FiemapWriter::HasPinnedExtents(file->file_path())) {
-            LOG(ERROR) << "file is no longer pinned: " << file->file_path();
+        if (cursor_fd_ < 0 && !OpenCursor(file)) {
             return false;
         }
 
-        uint64_t bytes_to_write = std::min(file_bytes_left, bytes_remaining);
-        if (!android::base::WriteFully(cursor_fd_, data_ptr, bytes_to_write)) {
-            PLOG(ERROR) << "write failed: " << file->file_path();
+        uint64_t file_bytes_left = file->size() - cursor_file_pos_ - buffered_;
+        uint64_t buffer_left = kWriteBufferSize - buffered_;
+        uint64_t bytes_to_copy = std::min({bytes_remaining, buffer_left, file_bytes_left});
+        memcpy(write_buffer(buffer_index_) + buffered_, data_ptr, bytes_to_copy);
+        buffered_ += bytes_to_copy;
+        data_ptr += bytes_to_copy;
+        bytes_remaining -= bytes_to_copy;
+
+        // Keep filling the buffer until it is full, the current file is
+        // complete, or the input runs out.
+        if (bytes_remaining && buffered_ < kWriteBufferSize && bytes_to_copy < file_bytes_left) {
+            continue;
+        }
+        size_t bytes_to_write = buffered_ & ~block_mask;
+        if (!bytes_to_write) {
+            continue;
+        }
+        if (!WaitForWrite()) {
             return false;
         }
-        data_ptr += bytes_to_write;
-        bytes_remaining -= bytes_to_write;
+
+        // Write this buffer in the background while the caller's data is
+        // copied into the other one.
+        const uint8_t* buffer = write_buffer(buffer_index_);
+        int fd = cursor_fd_.get();
+        uint64_t offset = cursor_file_pos_;
+        std::string path = file->file_path();
+        pending_write_ = std::async(std::launch::async, [=]() -> bool {
+            if (!android::base::WriteFullyAtOffset(fd, buffer, bytes_to_write, offset)) {
+                PLOG(ERROR) << "write failed: " << path;
+                return false;
+            }
+            return true;
+        });
+        pending_bytes_ = bytes_to_write;
         cursor_file_pos_ += bytes_to_write;
+
+        // Carry a trailing partial block over.
+        buffer_index_ ^= 1;
+        buffered_ -= bytes_to_write;
+        memcpy(write_buffer(buffer_index_), buffer + bytes_to_write, buffered_);
+    }
+    return WaitForWrite();
+}
+
+bool SplitFiemap::WritePartialBlock() {
+    if (!buffered_) {
+        return true;
     }
 
-    // If we've reached the end of the current file, close it.
-    if (cursor_file_pos_ == file->size()) {
-        cursor_fd_ = {};
+    // O_DIRECT needs whole blocks, so this goes through the page cache. The
+    // data stays buffered, and is written again with the rest of its block if
+    // Write() is called again.
+    FiemapWriter* file = files_[cursor_index_].get();
+    unique_fd fd(open(file->file_path().c_str(), O_CLOEXEC | O_WRONLY));
+    if (fd < 0) {
+        PLOG(ERROR) << "open failed: " << file->file_path();
+        return false;
+    }
+    if (!android::base::WriteFullyAtOffset(fd, write_buffer(buffer_index_), buffered_,
+                                           cursor_file_pos_)) {
+        PLOG(ERROR) << "write failed: " << file->file_path();
+        return false;
     }
     return true;
 }
 
 bool SplitFiemap::Flush() {
+    if (!WritePartialBlock()) {
+        return false;
+    }
     for (const auto& file : files_) {
         unique_fd fd(open(file->file_path().c_str(), O_RDONLY | O_CLOEXEC));
         if (fd < 0) {
@@ -288,12 +418,26 @@ bool SplitFiemap::Flush() {
             PLOG(ERROR) << "fsync failed: " << file->file_path();
             return false;
         }
+        if (write_buffers_ && !FiemapWriter::HasPinnedExtents(file->file_path())) {
+            LOG(ERROR) << "file is no longer pinned: " << file->file_path();
+            return false;
+        }
+    }
+
+    if (write_buffers_) {
+        using namespace std::chrono;
+        uint64_t bytes = bytes_written_ + buffered_;
+        uint64_t ms = duration_cast<milliseconds>(steady_clock::now() - write_start_).count();
+        LOG(INFO) << "Wrote " << bytes << " bytes in " << ms << "ms ("
+                  << bytes * 1000 / std::max<uint64_t>(ms, 1) / (1024 * 1024) << " MiB/s)";
     }
     return true;
 }
 
 SplitFiemap::~SplitFiemap() {
     if (!creating_) {
+        // Don't drop a partial block held back by Write().
+        WritePartialBlock();
         return;
     }
 
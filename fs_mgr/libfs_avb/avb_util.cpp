@@ -19,7 +19,11 @@
 #include <unistd.h>
 
 #include <array>
+#include <functional>
+#include <future>
+#include <iterator>
 #include <sstream>
+#include <string_view>
 
 #include <android-base/file.h>
 #include <android-base/strings.h>
@@ -116,12 +120,13 @@ bool HashtreeDmVeritySetup(FstabEntry* fstab_entry, const FsAvbHashtreeDescripto
     return true;
 }
 
-std::unique_ptr<FsAvbHashtreeDescriptor> GetHashtreeDescriptor(
-        const std::string& partition_name, const std::vector<VBMetaData>& vbmeta_images) {
-    bool found = false;
-    const uint8_t* desc_partition_name;
-    auto hashtree_desc = std::make_unique<FsAvbHashtreeDescriptor>();
-
+// Calls |visit| with every valid AVB HASHTREE descriptor in |vbmeta_images|, in order, until it
+// returns false. |raw| points at the descriptor in the vbmeta image and |desc| is its host byte
+// order copy.
+static void ForEachHashtreeDescriptor(
+        const std::vector<VBMetaData>& vbmeta_images,
+        const std::function<bool(const uint8_t* raw, const AvbHashtreeDescriptor& desc,
+                                 std::string_view partition_name)>& visit) {
     for (const auto& vbmeta : vbmeta_images) {
         size_t num_descriptors;
         std::unique_ptr<const AvbDescriptor* [], decltype(&avb_free)> descriptors(
@@ -131,52 +136,83 @@ std::unique_ptr<FsAvbHashtreeDescriptor> GetHashtreeDescriptor(
             continue;
         }
 
-        for (size_t n = 0; n < num_descriptors && !found; n++) {
+        for (size_t n = 0; n < num_descriptors; n++) {
             AvbDescriptor desc;
             if (!avb_descriptor_validate_and_byteswap(descriptors[n], &desc)) {
                 LWARNING << "Descriptor[" << n << "] is invalid";
                 continue;
             }
-            if (desc.tag == AVB_DESCRIPTOR_TAG_HASHTREE) {
-                desc_partition_name =
-                        (const uint8_t*)descriptors[n] + sizeof(AvbHashtreeDescriptor);
-                if (!avb_hashtree_descriptor_validate_and_byteswap(
-                        (AvbHashtreeDescriptor*)descriptors[n], hashtree_desc.get())) {
-                    continue;
-                }
-                if (hashtree_desc->partition_name_len != partition_name.length()) {
-                    continue;
-                }
-                // Notes that desc_partition_name is not NUL-terminated.
-                std::string hashtree_partition_name((const char*)desc_partition_name,
-                                                    hashtree_desc->partition_name_len);
-                if (hashtree_partition_name == partition_name) {
-                    found = true;
-                }
+            if (desc.tag != AVB_DESCRIPTOR_TAG_HASHTREE) {
+                continue;
+            }
+            AvbHashtreeDescriptor hashtree_desc;
+            if (!avb_hashtree_descriptor_validate_and_byteswap(
+                        (AvbHashtreeDescriptor*)descriptors[n], &hashtree_desc)) {
+                continue;
+            }
+            // Notes that the partition name is not NUL-terminated.
+            const uint8_t* raw = (const uint8_t*)descriptors[n];
+            std::string_view partition_name((const char*)raw + sizeof(AvbHashtreeDescriptor),
+                                            hashtree_desc.partition_name_len);
+            if (!visit(raw, hashtree_desc, partition_name)) {
+                return;
             }
         }
-
-        if (found) break;
     }
+}
 
-    if (!found) {
-        LERROR << "Hashtree descriptor not found: " << partition_name;
-        return nullptr;
-    }
+static FsAvbHashtreeDescriptor MakeHashtreeDescriptor(const uint8_t* raw,
+                                                      const AvbHashtreeDescriptor& desc,
+                                                      std::string_view partition_name) {
+    FsAvbHashtreeDescriptor hashtree_desc;
+    static_cast<AvbHashtreeDescriptor&>(hashtree_desc) = desc;
+    hashtree_desc.partition_name = partition_name;
 
-    hashtree_desc->partition_name = partition_name;
+    const uint8_t* desc_salt = raw + sizeof(AvbHashtreeDescriptor) + desc.partition_name_len;
+    hashtree_desc.salt = BytesToHex(desc_salt, desc.salt_len);
 
-    const uint8_t* desc_salt = desc_partition_name + hashtree_desc->partition_name_len;
-    hashtree_desc->salt = BytesToHex(desc_salt, hashtree_desc->salt_len);
+    const uint8_t* desc_digest = desc_salt + desc.salt_len;
+    hashtree_desc.root_digest = BytesToHex(desc_digest, desc.root_digest_len);
 
-    const uint8_t* desc_digest = desc_salt + hashtree_desc->salt_len;
-    hashtree_desc->root_digest = BytesToHex(desc_digest, hashtree_desc->root_digest_len);
+    return hashtree_desc;
+}
+
+std::unique_ptr<FsAvbHashtreeDescriptor> GetHashtreeDescriptor(
+        const std::string& partition_name, const std::vector<VBMetaData>& vbmeta_images) {
+    std::unique_ptr<FsAvbHashtreeDescriptor> hashtree_desc;
+    ForEachHashtreeDescriptor(vbmeta_images, [&](const uint8_t* raw,
+                                                 const AvbHashtreeDescriptor& desc,
+                                                 std::string_view name) {
+        if (name != partition_name) {
+            return true;
+        }
+        hashtree_desc = std::make_unique<FsAvbHashtreeDescriptor>(
+                MakeHashtreeDescriptor(raw, desc, name));
+        return false;
+    });
 
+    if (!hashtree_desc) {
+        LERROR << "Hashtree descriptor not found: " << partition_name;
+    }
     return hashtree_desc;
 }
 
+HashtreeDescriptorIndex GetHashtreeDescriptors(const std::vector<VBMetaData>& vbmeta_images) {
+    HashtreeDescriptorIndex index;
+    ForEachHashtreeDescriptor(vbmeta_images, [&](const uint8_t* raw,
+                                                 const AvbHashtreeDescriptor& desc,
+                                                 std::string_view name) {
+        // Keep the first descriptor for a partition, as GetHashtreeDescriptor() does.
+        if (index.find(name) == index.end()) {
+            index.emplace(std::string(name), MakeHashtreeDescriptor(raw, desc, name));
+        }
+        return true;
+    });
+    return index;
+}
+
 bool LoadAvbHashtreeToEnableVerity(FstabEntry* fstab_entry, bool wait_for_verity_dev,
-                                   const std::vector<VBMetaData>& vbmeta_images,
+                                   const HashtreeDescriptorIndex& hashtree_descriptors,
                                    const std::string& ab_suffix,
                                    const std::string& ab_other_suffix) {
     // Derives partition_name from blk_device to query the corresponding AVB HASHTREE descriptor
@@ -188,15 +224,15 @@ bool LoadAvbHashtreeToEnableVerity(FstabEntry* fstab_entry, bool wait_for_verity
         return false;
     }
 
-    std::unique_ptr<FsAvbHashtreeDescriptor> hashtree_descriptor =
-            GetHashtreeDescriptor(partition_name, vbmeta_images);
-    if (!hashtree_descriptor) {
+    auto hashtree_descriptor = hashtree_descriptors.find(partition_name);
+    if (hashtree_descriptor == hashtree_descriptors.end()) {
+        LERROR << "Hashtree descriptor not found: " << partition_name;
         return false;
     }
 
     // Converts HASHTREE descriptor to verity table to load into kernel.
     // When success, the new device path will be returned, e.g., /dev/block/dm-2.
-    return HashtreeDmVeritySetup(fstab_entry, *hashtree_descriptor, wait_for_verity_dev);
+    return HashtreeDmVeritySetup(fstab_entry, hashtree_descriptor->second, wait_for_verity_dev);
 }
 
 // Converts a AVB partition_name (without A/B suffix) to a device partition name.
@@ -575,12 +611,27 @@ VBMetaVerifyResult LoadAndVerifyVbmetaByPartition(
         if (fatal_error) {
             return VBMetaVerifyResult::kError;
         }
-        for (auto& chain : chain_partitions) {
-            auto sub_ret = LoadAndVerifyVbmetaByPartition(
-                chain.partition_name, ab_suffix, ab_other_suffix, chain.public_key_blob,
-                allow_verification_error, load_chained_vbmeta, rollback_protection,
-                device_path_constructor, true, /* is_chained_vbmeta */
-                out_vbmeta_images);
+        // Each chained partition costs a device open, a read and a signature check, and they
+        // don't depend on each other. Load them concurrently, then merge the results in
+        // descriptor order so |out_vbmeta_images| is the same as when loading them one by one.
+        const auto policy =
+                chain_partitions.size() > 1 ? std::launch::async : std::launch::deferred;
+        std::vector<std::vector<VBMetaData>> chain_images(chain_partitions.size());
+        std::vector<std::future<VBMetaVerifyResult>> chain_results;
+        for (size_t i = 0; i < chain_partitions.size(); i++) {
+            chain_results.emplace_back(std::async(policy, [&, i] {
+                const auto& chain = chain_partitions[i];
+                return LoadAndVerifyVbmetaByPartition(
+                        chain.partition_name, ab_suffix, ab_other_suffix, chain.public_key_blob,
+                        allow_verification_error, load_chained_vbmeta, rollback_protection,
+                        device_path_constructor, true, /* is_chained_vbmeta */
+                        &chain_images[i]);
+            }));
+        }
+        for (size_t i = 0; i < chain_partitions.size(); i++) {
+            auto sub_ret = chain_results[i].get();
+            std::move(chain_images[i].begin(), chain_images[i].end(),
+                      std::back_inserter(*out_vbmeta_images));
             if (sub_ret != VBMetaVerifyResult::kSuccess) {
                 verify_result = sub_ret;  // might be 'ERROR' or 'ERROR VERIFICATION'.
                 if (verify_result == VBMetaVerifyResult::kError) {
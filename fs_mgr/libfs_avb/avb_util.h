@@ -41,15 +41,19 @@ struct ChainInfo {
 std::unique_ptr<FsAvbHashtreeDescriptor> GetHashtreeDescriptor(
         const std::string& partition_name, const std::vector<VBMetaData>& vbmeta_images);
 
+// Parses all AVB HASHTREE descriptors in vbmeta_images at once. If several vbmeta images
+// describe the same partition, the first one wins, like GetHashtreeDescriptor().
+HashtreeDescriptorIndex GetHashtreeDescriptors(const std::vector<VBMetaData>& vbmeta_images);
+
 bool ConstructVerityTable(const FsAvbHashtreeDescriptor& hashtree_desc,
                           const std::string& blk_device, android::dm::DmTable* table);
 
 bool HashtreeDmVeritySetup(FstabEntry* fstab_entry, const FsAvbHashtreeDescriptor& hashtree_desc,
                            bool wait_for_verity_dev);
 
-// Searches a Avb hashtree descriptor in vbmeta_images for fstab_entry, to enable dm-verity.
+// Looks up the Avb hashtree descriptor for fstab_entry, to enable dm-verity.
 bool LoadAvbHashtreeToEnableVerity(FstabEntry* fstab_entry, bool wait_for_verity_dev,
-                                   const std::vector<VBMetaData>& vbmeta_images,
+                                   const HashtreeDescriptorIndex& hashtree_descriptors,
                                    const std::string& ab_suffix, const std::string& ab_other_suffix);
 
 // Converts AVB partition name to a device partition name.
@@ -556,7 +556,10 @@ AvbHashtreeResult AvbHandle::SetUpAvbHashtree(FstabEntry* fstab_entry, bool wait
         return AvbHashtreeResult::kDisabled;
     }
 
-    if (!LoadAvbHashtreeToEnableVerity(fstab_entry, wait_for_verity_dev, vbmeta_images_,
+    if (!hashtree_descriptors_) {
+        hashtree_descriptors_ = GetHashtreeDescriptors(vbmeta_images_);
+    }
+    if (!LoadAvbHashtreeToEnableVerity(fstab_entry, wait_for_verity_dev, *hashtree_descriptors_,
                                        slot_suffix_, other_slot_suffix_)) {
         return AvbHashtreeResult::kFail;
     }
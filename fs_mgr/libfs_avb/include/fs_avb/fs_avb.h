@@ -18,6 +18,7 @@
 
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -140,6 +141,8 @@ class AvbHandle {
     AvbHandle();
 
     std::vector<VBMetaData> vbmeta_images_;
+    // HASHTREE descriptors of vbmeta_images_, parsed on the first SetUpAvbHashtree() call.
+    std::optional<HashtreeDescriptorIndex> hashtree_descriptors_;
     VBMetaInfo vbmeta_info_;  // A summary info for vbmeta_images_.
     AvbHandleStatus status_;
     std::string avb_version_;
@@ -17,8 +17,11 @@
 #pragma once
 
 #include <cstring>
+#include <functional>
+#include <map>
 #include <memory>
 #include <ostream>
+#include <string>
 
 #include <libavb/libavb.h>
 
@@ -67,6 +70,9 @@ struct FsAvbHashtreeDescriptor : AvbHashtreeDescriptor {
     std::string root_digest;
 };
 
+// AVB HASHTREE descriptors keyed by partition name (without A/B suffix).
+using HashtreeDescriptorIndex = std::map<std::string, FsAvbHashtreeDescriptor, std::less<>>;
+
 class VBMetaData {
   public:
     // Constructors
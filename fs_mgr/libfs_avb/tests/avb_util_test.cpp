@@ -291,6 +291,43 @@ TEST_F(AvbUtilTest, GetAvbPropertyDescriptor_Basic) {
     EXPECT_EQ("", GetAvbPropertyDescriptor("non-existent", vbmeta_images));
 }
 
+TEST_F(AvbUtilTest, GetHashtreeDescriptors) {
+    // Generates two raw images with AVB Hashtree Footers, use a smaller size to speed-up test.
+    const size_t image_size = 5 * 1024 * 1024;
+    const size_t partition_size = 10 * 1024 * 1024;
+    base::FilePath system_path = GenerateImage("system.img", image_size);
+    AddAvbFooter(system_path, "hashtree", "system", partition_size, "SHA256_RSA2048", 10,
+                 data_dir_.Append("testkey_rsa2048.pem"), "d00df00d",
+                 "--internal_release_string \"unit test\"");
+    base::FilePath vendor_path = GenerateImage("vendor.img", image_size);
+    AddAvbFooter(vendor_path, "hashtree", "vendor", partition_size, "SHA256_RSA2048", 10,
+                 data_dir_.Append("testkey_rsa2048.pem"), "f00df00d",
+                 "--internal_release_string \"unit test\"");
+
+    std::vector<VBMetaData> vbmeta_images;
+    vbmeta_images.emplace_back(ExtractAndLoadVBMetaData(system_path, "system-vbmeta.img"));
+    vbmeta_images.emplace_back(ExtractAndLoadVBMetaData(vendor_path, "vendor-vbmeta.img"));
+
+    auto index = GetHashtreeDescriptors(vbmeta_images);
+    ASSERT_EQ(2UL, index.size());
+
+    // Each entry matches what GetHashtreeDescriptor() finds for the same partition.
+    for (const auto& partition_name : {"system", "vendor"}) {
+        auto it = index.find(partition_name);
+        ASSERT_NE(index.end(), it);
+        auto hashtree_desc = GetHashtreeDescriptor(partition_name, vbmeta_images);
+        ASSERT_NE(nullptr, hashtree_desc);
+        EXPECT_EQ(hashtree_desc->partition_name, it->second.partition_name);
+        EXPECT_EQ(hashtree_desc->salt, it->second.salt);
+        EXPECT_EQ(hashtree_desc->root_digest, it->second.root_digest);
+        EXPECT_EQ(hashtree_desc->image_size, it->second.image_size);
+        EXPECT_EQ(hashtree_desc->tree_offset, it->second.tree_offset);
+    }
+    EXPECT_EQ("d00df00d", index.find("system")->second.salt);
+    EXPECT_EQ("f00df00d", index.find("vendor")->second.salt);
+    EXPECT_EQ(index.end(), index.find("product"));
+}
+
 TEST_F(AvbUtilTest, GetAvbPropertyDescriptor_SecurityPatchLevel) {
     // Generates a raw boot.img
     const size_t boot_image_size = 5 * 1024 * 1024;
@@ -26,6 +26,8 @@
 
 #include <algorithm>
 #include <array>
+#include <iterator>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -54,29 +56,88 @@ namespace {
 constexpr char kProcMountsPath[] = "/proc/mounts";
 
 struct FlagList {
-    const char* name;
+    std::string_view name;
     uint64_t flag;
 };
 
-FlagList kMountFlagsList[] = {
+// Sorted by name, see FindFlag().
+constexpr FlagList kMountFlagsList[] = {
+        {"bind", MS_BIND},
+        {"defaults", 0},
         {"noatime", MS_NOATIME},
-        {"noexec", MS_NOEXEC},
-        {"nosuid", MS_NOSUID},
         {"nodev", MS_NODEV},
         {"nodiratime", MS_NODIRATIME},
+        {"noexec", MS_NOEXEC},
+        {"nosuid", MS_NOSUID},
+        {"private", MS_PRIVATE},
+        {"rec", MS_REC},
+        {"remount", MS_REMOUNT},
         {"ro", MS_RDONLY},
         {"rw", 0},
+        {"shared", MS_SHARED},
+        {"slave", MS_SLAVE},
         {"sync", MS_SYNCHRONOUS},
-        {"remount", MS_REMOUNT},
-        {"bind", MS_BIND},
-        {"rec", MS_REC},
         {"unbindable", MS_UNBINDABLE},
-        {"private", MS_PRIVATE},
-        {"slave", MS_SLAVE},
-        {"shared", MS_SHARED},
-        {"defaults", 0},
 };
 
+struct FsMgrFlagList {
+    std::string_view name;
+    void (*set)(FstabEntry::FsMgrFlags* flags);
+};
+
+#define FS_MGR_FLAG(flag_name, value) \
+    { flag_name, [](FstabEntry::FsMgrFlags* flags) { flags->value = true; } }
+
+// fs_mgr flags that simply set a boolean. Sorted by name, see FindFlag().
+constexpr FsMgrFlagList kFsMgrFlagsList[] = {
+        FS_MGR_FLAG("avb", avb),
+        FS_MGR_FLAG("check", check),
+        FS_MGR_FLAG("checkpoint=block", checkpoint_blk),
+        FS_MGR_FLAG("checkpoint=fs", checkpoint_fs),
+        FS_MGR_FLAG("first_stage_mount", first_stage_mount),
+        FS_MGR_FLAG("formattable", formattable),
+        FS_MGR_FLAG("fscompress", fs_compress),
+        FS_MGR_FLAG("fsverity", fs_verity),
+        FS_MGR_FLAG("latemount", late_mount),
+        FS_MGR_FLAG("logical", logical),
+        FS_MGR_FLAG("metadata_csum", ext_meta_csum),
+        FS_MGR_FLAG("noemulatedsd", no_emulated_sd),
+        FS_MGR_FLAG("nofail", no_fail),
+        FS_MGR_FLAG("nonremovable", nonremovable),
+        FS_MGR_FLAG("notrim", no_trim),
+        FS_MGR_FLAG("overlayfs_remove_missing_lowerdir", overlayfs_remove_missing_lowerdir),
+        FS_MGR_FLAG("quota", quota),
+        FS_MGR_FLAG("recoveryonly", recovery_only),
+        FS_MGR_FLAG("slotselect", slot_select),
+        FS_MGR_FLAG("slotselect_other", slot_select_other),
+        FS_MGR_FLAG("wait", wait),
+        FS_MGR_FLAG("wrappedkey", wrapped_key),
+};
+
+#undef FS_MGR_FLAG
+
+template <typename T, size_t N>
+constexpr bool IsSortedByName(const T (&list)[N]) {
+    for (size_t i = 1; i < N; i++) {
+        if (!(list[i - 1].name < list[i].name)) return false;
+    }
+    return true;
+}
+
+static_assert(IsSortedByName(kMountFlagsList), "kMountFlagsList must be sorted by name");
+static_assert(IsSortedByName(kFsMgrFlagsList), "kFsMgrFlagsList must be sorted by name");
+
+// Every fstab line goes through these tables once per option, so they are binary searched
+// instead of compared one by one.
+template <typename T, size_t N>
+const T* FindFlag(const T (&list)[N], std::string_view name) {
+    auto it = std::lower_bound(
+            std::begin(list), std::end(list), name,
+            [](const T& entry, std::string_view key) { return entry.name < key; });
+    if (it == std::end(list) || it->name != name) return nullptr;
+    return it;
+}
+
 off64_t CalculateZramSize(int percentage) {
     off64_t total;
 
@@ -109,11 +170,9 @@ void ParseFileEncryption(const std::string& arg, FstabEntry* entry) {
 }
 
 bool SetMountFlag(const std::string& flag, FstabEntry* entry) {
-    for (const auto& [name, value] : kMountFlagsList) {
-        if (flag == name) {
-            entry->flags |= value;
-            return true;
-        }
+    if (auto mount_flag = FindFlag(kMountFlagsList, flag)) {
+        entry->flags |= mount_flag->flag;
+        return true;
     }
     return false;
 }
@@ -179,36 +238,10 @@ bool ParseFsMgrFlags(const std::string& flags, FstabEntry* entry) {
         }
 
         // First handle flags that simply set a boolean.
-#define CheckFlag(flag_name, value)       \
-    if (flag == flag_name) {              \
-        entry->fs_mgr_flags.value = true; \
-        continue;                         \
-    }
-
-        CheckFlag("wait", wait);
-        CheckFlag("check", check);
-        CheckFlag("nonremovable", nonremovable);
-        CheckFlag("recoveryonly", recovery_only);
-        CheckFlag("noemulatedsd", no_emulated_sd);
-        CheckFlag("notrim", no_trim);
-        CheckFlag("formattable", formattable);
-        CheckFlag("slotselect", slot_select);
-        CheckFlag("latemount", late_mount);
-        CheckFlag("nofail", no_fail);
-        CheckFlag("quota", quota);
-        CheckFlag("avb", avb);
-        CheckFlag("logical", logical);
-        CheckFlag("checkpoint=block", checkpoint_blk);
-        CheckFlag("checkpoint=fs", checkpoint_fs);
-        CheckFlag("first_stage_mount", first_stage_mount);
-        CheckFlag("slotselect_other", slot_select_other);
-        CheckFlag("fsverity", fs_verity);
-        CheckFlag("metadata_csum", ext_meta_csum);
-        CheckFlag("fscompress", fs_compress);
-        CheckFlag("overlayfs_remove_missing_lowerdir", overlayfs_remove_missing_lowerdir);
-        CheckFlag("wrappedkey", wrapped_key);
-
-#undef CheckFlag
+        if (auto fs_mgr_flag = FindFlag(kFsMgrFlagsList, flag)) {
+            fs_mgr_flag->set(&entry->fs_mgr_flags);
+            continue;
+        }
 
         // Then handle flags that take an argument.
         if (StartsWith(flag, "encryptable=")) {
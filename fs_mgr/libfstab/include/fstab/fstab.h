@@ -105,6 +105,8 @@ bool SkipMountingPartitions(Fstab* fstab, bool verbose = false);
 
 // The Fstab can contain multiple entries for the same mount point with different configurations.
 std::vector<FstabEntry*> GetEntriesForMountPoint(Fstab* fstab, const std::string& path);
+std::vector<const FstabEntry*> GetEntriesForMountPoint(const Fstab* fstab,
+                                                       const std::string& path);
 
 // Like GetEntriesForMountPoint() but return only the first entry or nullptr if no entry is found.
 FstabEntry* GetEntryForMountPoint(Fstab* fstab, const std::string& path);
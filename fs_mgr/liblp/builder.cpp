@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include <algorithm>
+#include <atomic>
 #include <limits>
 
 #include <android-base/unique_fd.h>
@@ -96,9 +97,17 @@ bool ZeroExtent::operator==(const android::fs_mgr::Extent& other) const {
 }
 
 Partition::Partition(std::string_view name, std::string_view group_name, uint32_t attributes)
-    : name_(name), group_name_(group_name), attributes_(attributes), size_(0) {}
+    : name_(name), group_name_(group_name), attributes_(attributes), size_(0) {
+    UpdateGeneration();
+}
+
+void Partition::UpdateGeneration() {
+    static std::atomic<uint64_t> next_generation = 0;
+    generation_ = ++next_generation;
+}
 
 void Partition::AddExtent(std::unique_ptr<Extent>&& extent) {
+    UpdateGeneration();
     size_ += extent->num_sectors() * LP_SECTOR_SIZE;
 
     if (LinearExtent* new_extent = extent->AsLinearExtent()) {
@@ -119,6 +128,7 @@ void Partition::AddExtent(std::unique_ptr<Extent>&& extent) {
 }
 
 void Partition::RemoveExtents() {
+    UpdateGeneration();
     size_ = 0;
     extents_.clear();
 }
@@ -128,6 +138,7 @@ void Partition::ShrinkTo(uint64_t aligned_size) {
         RemoveExtents();
         return;
     }
+    UpdateGeneration();
 
     // Remove or shrink extents of any kind until the total partition size is
     // equal to the requested size.
@@ -610,6 +621,81 @@ void MetadataBuilder::ExtentsToFreeList(const std::vector<Interval>& extents,
 }
 
 auto MetadataBuilder::GetFreeRegions() const -> std::vector<Interval> {
+    if (!IsFreeRegionCacheValid()) {
+        free_region_cache_.regions = ComputeFreeRegions();
+        free_region_cache_.partitions.clear();
+        for (const auto& partition : partitions_) {
+            free_region_cache_.partitions.emplace_back(partition.get(), partition->generation());
+        }
+        free_region_cache_.valid = true;
+    }
+    return free_region_cache_.regions;
+}
+
+bool MetadataBuilder::IsFreeRegionCacheValid() const {
+    const auto& cache = free_region_cache_;
+    if (!cache.valid || cache.partitions.size() != partitions_.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < partitions_.size(); i++) {
+        if (cache.partitions[i].first != partitions_[i].get() ||
+            cache.partitions[i].second != partitions_[i]->generation()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Called after GrowPartition() has added extents covering |allocated| to
+// |partition|. If the cache was valid before that, carve the new extents out
+// of it, which gives the same result as recomputing it from scratch.
+void MetadataBuilder::UpdateFreeRegionCache(const Partition* partition,
+                                            const std::vector<Interval>& allocated) {
+    auto& cache = free_region_cache_;
+    auto iter = std::find_if(cache.partitions.begin(), cache.partitions.end(),
+                             [&](const auto& entry) { return entry.first == partition; });
+    if (!cache.valid || iter == cache.partitions.end()) {
+        cache.valid = false;
+        return;
+    }
+    iter->second = partition->generation();
+
+    for (const auto& interval : allocated) {
+        if (!RemoveFromFreeRegionCache(interval)) {
+            cache.valid = false;
+            return;
+        }
+    }
+}
+
+bool MetadataBuilder::RemoveFromFreeRegionCache(const Interval& allocated) {
+    auto& regions = free_region_cache_.regions;
+    auto iter = std::find_if(regions.begin(), regions.end(), [&](const Interval& region) {
+        return region.device_index == allocated.device_index && region.start <= allocated.start &&
+               allocated.end <= region.end;
+    });
+    if (iter == regions.end()) {
+        return false;
+    }
+
+    // Mirror ExtentsToFreeList(): the space before the new extent stays free,
+    // and the space after it is free from the next aligned sector onwards.
+    Interval region = *iter;
+    uint64_t aligned;
+    if (!AlignSector(block_devices_[region.device_index], allocated.end, &aligned)) {
+        return false;
+    }
+    iter = regions.erase(iter);
+    if (aligned < region.end) {
+        iter = regions.emplace(iter, region.device_index, aligned, region.end);
+    }
+    if (region.start < allocated.start) {
+        regions.emplace(iter, region.device_index, region.start, allocated.start);
+    }
+    return true;
+}
+
+auto MetadataBuilder::ComputeFreeRegions() const -> std::vector<Interval> {
     std::vector<Interval> free_regions;
 
     // Collect all extents in the partition table, per-device, then sort them
@@ -683,11 +769,58 @@ Interval Interval::Intersect(const Interval& a, const Interval& b) {
 
 std::vector<Interval> Interval::Intersect(const std::vector<Interval>& a,
                                           const std::vector<Interval>& b) {
+    // Index |b| by device and start sector, so that each interval in |a| only
+    // visits the intervals in |b| that can overlap it. |b| may contain
+    // overlapping intervals, so track the furthest end sector seen so far to
+    // know where to start looking.
+    std::vector<size_t> order(b.size());
+    for (size_t i = 0; i < b.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+        if (b[lhs].device_index != b[rhs].device_index) {
+            return b[lhs].device_index < b[rhs].device_index;
+        }
+        return b[lhs] < b[rhs];
+    });
+    std::vector<uint64_t> max_end(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        const Interval& interval = b[order[i]];
+        bool same_device = i > 0 && b[order[i - 1]].device_index == interval.device_index;
+        max_end[i] = same_device ? std::max(max_end[i - 1], interval.end) : interval.end;
+    }
+
     std::vector<Interval> ret;
+    std::vector<size_t> matches;
     for (const Interval& a_interval : a) {
-        for (const Interval& b_interval : b) {
-            auto intersect = Intersect(a_interval, b_interval);
-            if (intersect.length() > 0) ret.emplace_back(std::move(intersect));
+        // Binary search for the first interval on this device that could end
+        // after |a_interval| starts.
+        size_t low = 0, high = order.size();
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            const Interval& interval = b[order[mid]];
+            bool before = (interval.device_index != a_interval.device_index)
+                                  ? interval.device_index < a_interval.device_index
+                                  : max_end[mid] <= a_interval.start;
+            if (before) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        matches.clear();
+        for (size_t i = low; i < order.size(); i++) {
+            const Interval& b_interval = b[order[i]];
+            if (b_interval.device_index != a_interval.device_index ||
+                b_interval.start >= a_interval.end) {
+                break;
+            }
+            if (Intersect(a_interval, b_interval).length() > 0) matches.emplace_back(order[i]);
+        }
+
+        // Keep the order of |b|, as callers may have ordered it by preference.
+        std::sort(matches.begin(), matches.end());
+        for (size_t index : matches) {
+            ret.emplace_back(Intersect(a_interval, b[index]));
         }
     }
     return ret;
@@ -729,6 +862,10 @@ bool MetadataBuilder::GrowPartition(Partition* partition, uint64_t aligned_size,
         new_extents.emplace_back(std::move(extent));
     }
 
+    // Extents carved out of |free_regions|, as opposed to the one from
+    // ExtendFinalExtent(), which was never part of a free region.
+    std::vector<Interval> allocated;
+
     for (auto& region : free_regions) {
         // Note: this comes first, since we may enter the loop not needing any
         // more sectors.
@@ -756,6 +893,7 @@ bool MetadataBuilder::GrowPartition(Partition* partition, uint64_t aligned_size,
         CHECK(sectors % sectors_per_block == 0);
 
         auto extent = std::make_unique<LinearExtent>(sectors, region.device_index, region.start);
+        allocated.emplace_back(extent->AsInterval());
         new_extents.push_back(std::move(extent));
         sectors_needed -= sectors;
     }
@@ -768,6 +906,7 @@ bool MetadataBuilder::GrowPartition(Partition* partition, uint64_t aligned_size,
     for (auto& extent : new_extents) {
         partition->AddExtent(std::move(extent));
     }
+    UpdateFreeRegionCache(partition, allocated);
     return true;
 }
 
@@ -1063,6 +1202,7 @@ bool MetadataBuilder::UpdateBlockDeviceInfo(size_t index, const BlockDeviceInfo&
     if (device_info.alignment_offset) {
         block_device.alignment_offset = device_info.alignment_offset;
     }
+    free_region_cache_.valid = false;
     return true;
 }
 
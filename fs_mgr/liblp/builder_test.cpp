@@ -1091,3 +1091,50 @@ TEST_F(BuilderTest, VerifyExtent) {
     ASSERT_FALSE(target_builder->VerifyExtentsAgainstSourceMetadata(
             *source_builder, 0, *target_builder, 1, std::vector<std::string>{"vendor"}));
 }
+
+TEST_F(BuilderTest, ManyExtents) {
+    BlockDeviceInfo super("super", 8_GiB, 4096, 0, 4096);
+    unique_ptr<MetadataBuilder> builder = MetadataBuilder::New({super}, "super", 1_MiB, 2);
+    ASSERT_NE(builder, nullptr);
+
+    // Fill the start of super with small partitions, then free every other
+    // one so that growing a partition has to stitch together many extents.
+    std::vector<Partition*> partitions;
+    for (size_t i = 0; i < 2400; i++) {
+        Partition* p = builder->AddPartition("p" + std::to_string(i), 0);
+        ASSERT_NE(p, nullptr);
+        ASSERT_TRUE(builder->ResizePartition(p, 4096));
+        partitions.emplace_back(p);
+    }
+    for (size_t i = 0; i < partitions.size(); i += 2) {
+        ASSERT_TRUE(builder->ResizePartition(partitions[i], 0));
+    }
+
+    // Grow the freed partitions back in turn; each takes an interleaved
+    // sector from the start, then the rest comes from the end of super.
+    Partition* big = builder->AddPartition("big", 0);
+    ASSERT_NE(big, nullptr);
+    ASSERT_TRUE(builder->ResizePartition(big, 600 * 4096));
+    EXPECT_EQ(big->extents().size(), 600);
+    for (size_t i = 0; i < partitions.size(); i += 2) {
+        ASSERT_TRUE(builder->ResizePartition(partitions[i], 2 * 4096));
+    }
+
+    // The free list kept up to date across resizes must match one computed
+    // from scratch.
+    auto exported = builder->Export();
+    ASSERT_NE(exported, nullptr);
+    auto fresh = MetadataBuilder::New(*exported.get());
+    ASSERT_NE(fresh, nullptr);
+    EXPECT_EQ(builder->GetFreeRegions(), fresh->GetFreeRegions());
+
+    // Shrinking invalidates the list; growing afterwards must not reuse
+    // space that is still allocated.
+    ASSERT_TRUE(builder->ResizePartition(big, 300 * 4096));
+    ASSERT_TRUE(builder->ResizePartition(partitions[1], 310 * 4096));
+    exported = builder->Export();
+    ASSERT_NE(exported, nullptr);
+    fresh = MetadataBuilder::New(*exported.get());
+    ASSERT_NE(fresh, nullptr);
+    EXPECT_EQ(builder->GetFreeRegions(), fresh->GetFreeRegions());
+}
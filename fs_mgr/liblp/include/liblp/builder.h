@@ -25,6 +25,7 @@
 #include <optional>
 #include <set>
 #include <string_view>
+#include <utility>
 
 #include "liblp.h"
 #include "partition_opener.h"
@@ -156,11 +157,18 @@ class Partition final {
     void ShrinkTo(uint64_t aligned_size);
     void set_group_name(std::string_view group_name) { group_name_ = group_name; }
 
+    // Changes whenever the extent list changes. Values are never reused, even
+    // across partitions, so MetadataBuilder can tell whether cached free
+    // regions are still accurate.
+    uint64_t generation() const { return generation_; }
+    void UpdateGeneration();
+
     std::string name_;
     std::string group_name_;
     std::vector<std::unique_ptr<Extent>> extents_;
     uint32_t attributes_;
     uint64_t size_;
+    uint64_t generation_;
 };
 
 // An interval in the metadata. This is similar to a LinearExtent with one difference.
@@ -411,6 +419,10 @@ class MetadataBuilder {
     void ExtentsToFreeList(const std::vector<Interval>& extents,
                            std::vector<Interval>* free_regions) const;
     std::vector<Interval> PrioritizeSecondHalfOfSuper(const std::vector<Interval>& free_list);
+    std::vector<Interval> ComputeFreeRegions() const;
+    bool IsFreeRegionCacheValid() const;
+    void UpdateFreeRegionCache(const Partition* partition, const std::vector<Interval>& allocated);
+    bool RemoveFromFreeRegionCache(const Interval& allocated);
     std::unique_ptr<LinearExtent> ExtendFinalExtent(Partition* partition,
                                                     const std::vector<Interval>& free_list,
                                                     uint64_t sectors_needed) const;
@@ -424,6 +436,17 @@ class MetadataBuilder {
     std::vector<std::unique_ptr<PartitionGroup>> groups_;
     std::vector<LpMetadataBlockDevice> block_devices_;
     bool auto_slot_suffixing_;
+
+    // The result of the last ComputeFreeRegions(), and the generation of each
+    // partition it was computed from. GrowPartition() carves its allocations
+    // out of this list, so resizing many partitions in a row does not rescan
+    // and re-sort every extent each time.
+    struct FreeRegionCache {
+        bool valid = false;
+        std::vector<Interval> regions;
+        std::vector<std::pair<const Partition*, uint64_t>> partitions;
+    };
+    mutable FreeRegionCache free_region_cache_;
 };
 
 // Read BlockDeviceInfo for a given block device. This always returns false
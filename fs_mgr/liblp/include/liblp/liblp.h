@@ -64,6 +64,16 @@ bool UpdatePartitionTable(const IPartitionOpener& opener, const std::string& sup
 std::unique_ptr<LpMetadata> ReadMetadata(const IPartitionOpener& opener,
                                          const std::string& super_partition, uint32_t slot_number);
 
+// Same as ReadMetadata, but returns a shared read-only view instead of a copy.
+// Results are kept in a process-wide cache keyed by super partition and slot.
+// A cache hit still reads the geometry and metadata header from disk, and only
+// reuses the cached tables if that header (which carries the tables checksum)
+// is unchanged. Writes through FlashPartitionTable or UpdatePartitionTable
+// drop the cached entries for that super partition.
+std::shared_ptr<const LpMetadata> ReadMetadataView(const IPartitionOpener& opener,
+                                                   const std::string& super_partition,
+                                                   uint32_t slot_number);
+
 // Helper functions that use the default PartitionOpener.
 bool FlashPartitionTable(const std::string& super_partition, const LpMetadata& metadata);
 bool UpdatePartitionTable(const std::string& super_partition, const LpMetadata& metadata,
@@ -22,6 +22,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 #include <liblp/builder.h>
@@ -100,5 +101,18 @@ class SuperLayoutBuilder final {
 
 std::ostream& operator<<(std::ostream& stream, const SuperImageExtent& extent);
 
+// Write the raw super image described by |extents|, as returned by
+// SuperLayoutBuilder::GetImageLayout(), to |fd| starting at its current
+// position. PARTITION extents are copied from |images|, which is keyed by
+// image name; an image shorter than its extent is padded with zeroes.
+//
+// Partition images are copied in large chunks, and no extent is ever held in
+// memory in full. If |fd| is seekable, DONTCARE extents are skipped rather
+// than written, and a regular file is extended to the full image size.
+// Returns false on any I/O error.
+bool WriteSuperImage(const std::vector<SuperImageExtent>& extents,
+                     const std::unordered_map<std::string, android::base::borrowed_fd>& images,
+                     android::base::borrowed_fd fd);
+
 }  // namespace fs_mgr
 }  // namespace android
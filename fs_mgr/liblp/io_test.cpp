@@ -255,6 +255,41 @@ TEST_F(LiblpTest, UpdateAnyMetadataSlot) {
     }
 }
 
+TEST_F(LiblpTest, ReadMetadataView) {
+    unique_fd fd = CreateFlashedDisk();
+    ASSERT_GE(fd, 0);
+    unique_fd other_fd = CreateFlashedDisk();
+    ASSERT_GE(other_fd, 0);
+
+    DefaultPartitionOpener opener(fd);
+
+    // Repeated reads share one cached copy.
+    auto view = ReadMetadataView(opener, "super", 0);
+    ASSERT_NE(view, nullptr);
+    EXPECT_EQ(ReadMetadataView(opener, "super", 0), view);
+    EXPECT_NE(ReadMetadataView(opener, "super", 1), view);
+
+    // Updating the table drops the cached copy.
+    unique_ptr<LpMetadata> metadata = ReadMetadata(opener, "super", 0);
+    ASSERT_NE(metadata, nullptr);
+    strncpy(metadata->partitions[0].name, "vendor", sizeof(metadata->partitions[0].name));
+    ASSERT_TRUE(UpdatePartitionTable(opener, "super", *metadata.get(), 0));
+
+    auto updated = ReadMetadataView(opener, "super", 0);
+    ASSERT_NE(updated, nullptr);
+    EXPECT_NE(updated, view);
+    EXPECT_EQ(GetPartitionName(updated->partitions[0]), "vendor");
+
+    // A different disk behind the same name is detected by its header, even
+    // though nothing invalidated the cache.
+    DefaultPartitionOpener other_opener(other_fd);
+
+    auto other = ReadMetadataView(other_opener, "super", 0);
+    ASSERT_NE(other, nullptr);
+    EXPECT_NE(other, updated);
+    EXPECT_EQ(GetPartitionName(other->partitions[0]), "system");
+}
+
 TEST_F(LiblpTest, InvalidMetadataSlot) {
     unique_fd fd = CreateFlashedDisk();
     ASSERT_GE(fd, 0);
@@ -22,6 +22,9 @@
 #include <unistd.h>
 
 #include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
 
 #include <android-base/file.h>
 #include <android-base/unique_fd.h>
@@ -434,10 +437,78 @@ bool AdjustMetadataForSlot(LpMetadata* metadata, uint32_t slot_number) {
     return true;
 }
 
+class MetadataCache final {
+  public:
+    using Key = std::pair<std::string, uint32_t>;
+
+    std::shared_ptr<const LpMetadata> Get(const Key& key) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = entries_.find(key);
+        return iter == entries_.end() ? nullptr : iter->second;
+    }
+    void Put(const Key& key, std::shared_ptr<const LpMetadata> metadata) {
+        std::lock_guard<std::mutex> lock(lock_);
+        entries_[key] = std::move(metadata);
+    }
+    void Erase(const Key& key) {
+        std::lock_guard<std::mutex> lock(lock_);
+        entries_.erase(key);
+    }
+    void EraseAll(const std::string& super_partition) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = entries_.lower_bound({super_partition, 0});
+        while (iter != entries_.end() && iter->first.first == super_partition) {
+            iter = entries_.erase(iter);
+        }
+    }
+
+  private:
+    std::mutex lock_;
+    std::map<Key, std::shared_ptr<const LpMetadata>> entries_;
+};
+
+MetadataCache& GetMetadataCache() {
+    static MetadataCache* cache = new MetadataCache();
+    return *cache;
+}
+
+// Return true if either copy of the on-disk header for |slot_number| is
+// identical to |cached|'s. The header carries the tables checksum, so this
+// proves the cached tables are current without reading or hashing them.
+bool IsCachedMetadataCurrent(int fd, const LpMetadataGeometry& geometry, uint32_t slot_number,
+                             const LpMetadata& cached) {
+    if (memcmp(&geometry, &cached.geometry, sizeof(geometry)) != 0) {
+        return false;
+    }
+    std::vector<int64_t> offsets = {
+            GetPrimaryMetadataOffset(geometry, slot_number),
+            GetBackupMetadataOffset(geometry, slot_number),
+    };
+    for (const auto& offset : offsets) {
+        if (SeekFile64(fd, offset, SEEK_SET) < 0) {
+            continue;
+        }
+        FileReader reader(fd);
+        LpMetadata header_only;
+        if (!ReadMetadataHeader(&reader, &header_only)) {
+            continue;
+        }
+        if (memcmp(&header_only.header, &cached.header, sizeof(LpMetadataHeader)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 }  // namespace
 
-std::unique_ptr<LpMetadata> ReadMetadata(const IPartitionOpener& opener,
-                                         const std::string& super_partition, uint32_t slot_number) {
+void InvalidateMetadataCache(const std::string& super_partition) {
+    GetMetadataCache().EraseAll(super_partition);
+}
+
+std::shared_ptr<const LpMetadata> ReadMetadataView(const IPartitionOpener& opener,
+                                                   const std::string& super_partition,
+                                                   uint32_t slot_number) {
     android::base::unique_fd fd = opener.Open(super_partition, O_RDONLY);
     if (fd < 0) {
         PERROR << __PRETTY_FUNCTION__ << " open failed: " << super_partition;
@@ -453,6 +524,15 @@ std::unique_ptr<LpMetadata> ReadMetadata(const IPartitionOpener& opener,
         return nullptr;
     }
 
+    auto& cache = GetMetadataCache();
+    MetadataCache::Key key = {super_partition, slot_number};
+    if (auto cached = cache.Get(key)) {
+        if (IsCachedMetadataCurrent(fd, geometry, slot_number, *cached.get())) {
+            return cached;
+        }
+        cache.Erase(key);
+    }
+
     std::vector<int64_t> offsets = {
             GetPrimaryMetadataOffset(geometry, slot_number),
             GetBackupMetadataOffset(geometry, slot_number),
@@ -471,7 +551,19 @@ std::unique_ptr<LpMetadata> ReadMetadata(const IPartitionOpener& opener,
     if (!metadata || !AdjustMetadataForSlot(metadata.get(), slot_number)) {
         return nullptr;
     }
-    return metadata;
+
+    std::shared_ptr<const LpMetadata> view = std::move(metadata);
+    cache.Put(key, view);
+    return view;
+}
+
+std::unique_ptr<LpMetadata> ReadMetadata(const IPartitionOpener& opener,
+                                         const std::string& super_partition, uint32_t slot_number) {
+    auto view = ReadMetadataView(opener, super_partition, slot_number);
+    if (!view) {
+        return nullptr;
+    }
+    return std::make_unique<LpMetadata>(*view.get());
 }
 
 std::unique_ptr<LpMetadata> ReadMetadata(const std::string& super_partition, uint32_t slot_number) {
@@ -20,6 +20,7 @@
 #include <stddef.h>
 
 #include <memory>
+#include <string>
 
 #include <liblp/liblp.h>
 
@@ -46,6 +47,9 @@ std::unique_ptr<LpMetadata> ReadPrimaryMetadata(int fd, const LpMetadataGeometry
 std::unique_ptr<LpMetadata> ReadBackupMetadata(int fd, const LpMetadataGeometry& geometry,
                                                uint32_t slot_number);
 
+// Drop all cached metadata (see ReadMetadataView) for |super_partition|.
+void InvalidateMetadataCache(const std::string& super_partition);
+
 }  // namespace fs_mgr
 }  // namespace android
 
@@ -16,9 +16,13 @@
 #include <liblp/super_layout_builder.h>
 
 #include <liblp/liblp.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
 
+#include <android-base/file.h>
+
 #include "images.h"
 #include "utility.h"
 #include "writer.h"
@@ -198,6 +202,113 @@ std::vector<SuperImageExtent> SuperLayoutBuilder::GetImageLayout() {
     return extents;
 }
 
+// Partition images are copied through a buffer this large.
+static constexpr size_t kCopyBufferSize = 1024 * 1024;
+
+static bool WriteZeroes(borrowed_fd fd, uint64_t size, std::vector<char>* buffer) {
+    std::fill(buffer->begin(), buffer->end(), 0);
+    while (size) {
+        size_t chunk = std::min<uint64_t>(size, buffer->size());
+        if (!android::base::WriteFully(fd, buffer->data(), chunk)) {
+            PLOG(ERROR) << "write failed";
+            return false;
+        }
+        size -= chunk;
+    }
+    return true;
+}
+
+static bool CopyImage(borrowed_fd image, uint64_t image_offset, uint64_t size, borrowed_fd fd,
+                      std::vector<char>* buffer) {
+    uint64_t image_size;
+    if (!GetDescriptorSize(image.get(), &image_size)) {
+        return false;
+    }
+    // The image may end before the partition does; the rest is zeroes.
+    uint64_t available = image_offset < image_size ? image_size - image_offset : 0;
+    uint64_t to_copy = std::min(size, available);
+
+    while (to_copy) {
+        size_t chunk = std::min<uint64_t>(to_copy, buffer->size());
+        if (!android::base::ReadFullyAtOffset(image, buffer->data(), chunk, image_offset)) {
+            PLOG(ERROR) << "read failed at offset " << image_offset;
+            return false;
+        }
+        if (!android::base::WriteFully(fd, buffer->data(), chunk)) {
+            PLOG(ERROR) << "write failed";
+            return false;
+        }
+        image_offset += chunk;
+        to_copy -= chunk;
+        size -= chunk;
+    }
+    return WriteZeroes(fd, size, buffer);
+}
+
+bool WriteSuperImage(const std::vector<SuperImageExtent>& extents,
+                     const std::unordered_map<std::string, borrowed_fd>& images, borrowed_fd fd) {
+    int64_t start = SeekFile64(fd.get(), 0, SEEK_CUR);
+    bool seekable = start >= 0;
+
+    std::vector<char> buffer(kCopyBufferSize);
+    uint64_t end = 0;
+    for (const auto& extent : extents) {
+        if (extent.offset != end) {
+            LOG(ERROR) << "Super image extents are not contiguous at " << extent;
+            return false;
+        }
+        end = extent.offset + extent.size;
+
+        switch (extent.type) {
+            case SuperImageExtent::Type::DONTCARE:
+                if (seekable) {
+                    if (SeekFile64(fd.get(), start + end, SEEK_SET) < 0) {
+                        PLOG(ERROR) << "lseek failed";
+                        return false;
+                    }
+                    break;
+                }
+                [[fallthrough]];
+            case SuperImageExtent::Type::ZERO:
+                if (!WriteZeroes(fd, extent.size, &buffer)) {
+                    return false;
+                }
+                break;
+            case SuperImageExtent::Type::DATA:
+                if (!android::base::WriteFully(fd, extent.blob->data(), extent.size)) {
+                    PLOG(ERROR) << "write failed";
+                    return false;
+                }
+                break;
+            case SuperImageExtent::Type::PARTITION: {
+                auto iter = images.find(extent.image_name);
+                if (iter == images.end()) {
+                    LOG(ERROR) << "No file given for image: " << extent.image_name;
+                    return false;
+                }
+                if (!CopyImage(iter->second, extent.image_offset, extent.size, fd, &buffer)) {
+                    return false;
+                }
+                break;
+            }
+            default:
+                LOG(ERROR) << "Unrecognized extent type in super image layout";
+                return false;
+        }
+    }
+
+    // Skipping a trailing DONTCARE extent leaves a regular file short.
+    struct stat s;
+    if (seekable && fstat(fd.get(), &s) == 0 && S_ISREG(s.st_mode) &&
+        static_cast<uint64_t>(s.st_size) < start + end) {
+        if (ftruncate(fd.get(), start + end) < 0) {
+            PLOG(ERROR) << "ftruncate failed";
+            return false;
+        }
+    }
+    return true;
+}
+
 bool SuperImageExtent::operator==(const SuperImageExtent& other) const {
     if (offset != other.offset) {
         return false;
@@ -14,6 +14,7 @@
 // limitations under the License.
 //
 
+#include <android-base/file.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <liblp/builder.h>
@@ -139,3 +140,47 @@ TEST(SuperImageTool, LargeAlignedMetadata) {
     auto extents = tool.GetImageLayout();
     ASSERT_TRUE(extents.empty());
 }
+
+TEST(SuperImageTool, WriteImage) {
+    auto builder = MetadataBuilder::New(4_MiB, 8_KiB, 2);
+    ASSERT_NE(builder, nullptr);
+    ASSERT_NE(builder->AddPartition("system_a", LP_PARTITION_ATTR_READONLY), nullptr);
+    auto metadata = builder->Export();
+    ASSERT_NE(metadata, nullptr);
+
+    // The image is shorter than the partition, so the tail is zero-filled.
+    std::string image_data(12_KiB, '\0');
+    for (size_t i = 0; i < image_data.size(); i++) {
+        image_data[i] = static_cast<char>(i % 251);
+    }
+    TemporaryFile image;
+    ASSERT_TRUE(android::base::WriteStringToFd(image_data, image.fd));
+
+    SuperLayoutBuilder tool;
+    ASSERT_TRUE(tool.Open(*metadata.get()));
+    ASSERT_TRUE(tool.AddPartition("system_a", "system.img", 16_KiB));
+    auto extents = tool.GetImageLayout();
+    ASSERT_FALSE(extents.empty());
+
+    TemporaryFile output;
+    std::unordered_map<std::string, android::base::borrowed_fd> images = {
+            {"system.img", image.fd}};
+    ASSERT_TRUE(WriteSuperImage(extents, images, output.fd));
+
+    std::string contents;
+    ASSERT_TRUE(android::base::ReadFileToString(output.path, &contents));
+    ASSERT_EQ(contents.size(), extents.back().offset + extents.back().size);
+    EXPECT_EQ(contents.substr(0, 4_KiB), std::string(4_KiB, '\0'));
+    for (const auto& extent : extents) {
+        if (extent.type == SuperImageExtent::Type::DATA) {
+            EXPECT_EQ(contents.substr(extent.offset, extent.size), *extent.blob);
+        } else if (extent.type == SuperImageExtent::Type::PARTITION) {
+            EXPECT_EQ(contents.substr(extent.offset, image_data.size()), image_data);
+            EXPECT_EQ(contents.substr(extent.offset + image_data.size(), 4_KiB),
+                      std::string(4_KiB, '\0'));
+        }
+    }
+
+    images.clear();
+    EXPECT_FALSE(WriteSuperImage(extents, images, output.fd));
+}
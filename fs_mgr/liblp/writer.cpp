@@ -253,6 +253,10 @@ bool FlashPartitionTable(const IPartitionOpener& opener, const std::string& supe
         return false;
     }
 
+    // Drop cached reads before touching the disk, so a partial write can't be
+    // masked by a stale entry.
+    InvalidateMetadataCache(super_partition);
+
     // This is only used in update_engine and fastbootd, where the super
     // partition should be specified as a name (or by-name link), and
     // therefore, we should be able to extract a slot suffix.
@@ -329,6 +333,10 @@ bool UpdatePartitionTable(const IPartitionOpener& opener, const std::string& sup
         return false;
     }
 
+    // Drop cached reads before touching the disk, so a partial write can't be
+    // masked by a stale entry.
+    InvalidateMetadataCache(super_partition);
+
     std::string slot_suffix = SlotSuffixForSlotNumber(slot_number);
 
     // Before writing geometry and/or logical partition tables, perform some
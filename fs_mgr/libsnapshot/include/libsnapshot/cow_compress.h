@@ -17,6 +17,7 @@
 #pragma once
 
 #include <memory>
+#include <string_view>
 #include <vector>
 
 #include "libsnapshot/cow_format.h"
@@ -38,7 +39,8 @@ class ICompressor {
     static std::unique_ptr<ICompressor> Lz4(const int32_t compression_level,
                                             const uint32_t block_size);
     static std::unique_ptr<ICompressor> Zstd(const int32_t compression_level,
-                                             const uint32_t block_size);
+                                             const uint32_t block_size,
+                                             std::string_view dictionary = {});
 
     static std::unique_ptr<ICompressor> Create(CowCompression compression,
                                                const uint32_t block_size);
@@ -17,9 +17,12 @@
 #include <stdint.h>
 
 #include <limits>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string_view>
 #include <type_traits>
+#include <vector>
 
 namespace android {
 namespace snapshot {
@@ -42,6 +45,8 @@ static constexpr uint32_t kMaxCowVersion = 3;
 //      +-----------------------+
 //      |     Scratch space     |
 //      +-----------------------+
+//      | Dictionary (v3, opt.) |
+//      +-----------------------+
 //      | Operation  (variable) |
 //      | Data       (variable) |
 //      +-----------------------+
@@ -115,8 +120,17 @@ struct CowHeaderV3 : public CowHeader {
     uint32_t compression_algorithm;
     // Max compression size supported
     uint32_t max_compression_size;
+    // Size of the compression dictionary stored after the resume buffer, or 0
+    // if blocks are compressed without one. Only covered by header_size when a
+    // dictionary is present; see kCowHeaderV3BaseSize.
+    uint32_t dictionary_size;
 } __attribute__((packed));
 
+// Size of a v3 header without |dictionary_size|. COWs without a dictionary use
+// this as their header size, so their layout is unchanged and they remain
+// readable by readers that predate dictionaries.
+static constexpr uint16_t kCowHeaderV3BaseSize = sizeof(CowHeaderV3) - sizeof(uint32_t);
+
 enum class CowOperationType : uint8_t {
     kCowCopyOp = 1,
     kCowReplaceOp = 2,
@@ -196,6 +210,10 @@ static constexpr uint64_t kCowOpSourceInfoTypeBit = 60;
 static constexpr uint64_t kCowOpSourceInfoTypeNumBits = 4;
 static constexpr uint64_t kCowOpSourceInfoTypeMask = (1ULL << kCowOpSourceInfoTypeNumBits) - 1;
 
+// Set on replace ops whose data is shared with an earlier op, see
+// CowOperationV3::shared_data().
+static constexpr uint64_t kCowOpSourceInfoSharedDataBit = 48;
+
 static constexpr uint64_t kCowOpSourceInfoCompressionBit = 57;
 static constexpr uint64_t kCowOpSourceInfoCompressionNumBits = 3;
 static constexpr uint64_t kCowOpSourceInfoCompressionMask =
@@ -211,8 +229,8 @@ struct CowOperationV3 {
     uint32_t new_block;
 
     // source_info with have the following layout
-    // |--- 4 bits -- | --------- 3 bits ------ | --- 9 bits --- | --- 48 bits ---|
-    // |--- type ---  | -- compression factor --| --- unused --- | --- source --- |
+    // |- 4 bits -|------- 3 bits -------|- 8 bits -|- 1 bit  -|--- 48 bits ---|
+    // |-- type --|- compression factor -|- unused -|- shared -|--- source ----|
     //
     // The value of |source| depends on the operation code.
     //
@@ -226,6 +244,10 @@ struct CowOperationV3 {
     //  Bits 47-62 are reserved and must be zero.
     // A block is compressed if it’s data is < block_sz
     //
+    // Bit 48 marks a replace op whose |source| points at data already stored
+    // for an earlier replace op with identical content. Such an op does not
+    // occupy any space of its own in the data section.
+    //
     // Bits [57-59] represents the compression factor.
     //
     //       Compression - factor
@@ -270,6 +292,13 @@ struct CowOperationV3 {
                 (source_info_ >> kCowOpSourceInfoCompressionBit) & kCowOpSourceInfoCompressionMask;
         return static_cast<uint8_t>(compression_factor);
     }
+    constexpr bool shared_data() const {
+        return (source_info_ >> kCowOpSourceInfoSharedDataBit) & 1;
+    }
+    constexpr void set_shared_data(bool shared) {
+        source_info_ &= ~(1ULL << kCowOpSourceInfoSharedDataBit);
+        source_info_ |= static_cast<uint64_t>(shared) << kCowOpSourceInfoSharedDataBit;
+    }
 } __attribute__((packed));
 
 // Ensure that getters/setters added to CowOperationV3 does not increases size
@@ -278,6 +307,26 @@ static_assert(std::is_trivially_copyable_v<CowOperationV3>);
 static_assert(std::is_standard_layout_v<CowOperationV3>);
 static_assert(sizeof(CowOperationV2) == sizeof(CowFooterOperation));
 
+// Read-only view of a COW's operations. |owner| keeps the storage behind |ops|
+// alive, which is either a heap buffer or a mapping of the v3 op section, so
+// copies of the view can be shared cheaply between readers and iterators.
+struct CowOpsView {
+    std::shared_ptr<const void> owner;
+    std::span<const CowOperationV3> ops;
+
+    size_t size() const { return ops.size(); }
+    const CowOperationV3* data() const { return ops.data(); }
+    auto begin() const { return ops.begin(); }
+    auto end() const { return ops.end(); }
+    const CowOperationV3& operator[](size_t index) const { return ops[index]; }
+};
+
+// Wrap |ops| in a view that owns it.
+static inline CowOpsView MakeCowOpsView(std::shared_ptr<std::vector<CowOperationV3>> ops) {
+    std::span<const CowOperationV3> span(ops->data(), ops->size());
+    return CowOpsView{std::move(ops), span};
+}
+
 enum CowCompressionAlgorithm : uint8_t {
     kCowCompressNone = 0,
     kCowCompressGz = 1,
@@ -288,6 +337,9 @@ enum CowCompressionAlgorithm : uint8_t {
 struct CowCompression {
     CowCompressionAlgorithm algorithm = kCowCompressNone;
     int32_t compression_level = 0;
+    // Optional pre-trained dictionary (zstd only). Not owned; it only needs to
+    // outlive the call to ICompressor::Create.
+    std::string_view dictionary;
 };
 
 static constexpr uint8_t kCowReadAheadNotStarted = 0;
@@ -302,8 +354,12 @@ static constexpr off_t GetResumeOffset(const CowHeaderV3& header) {
     return GetSequenceOffset(header) + (header.sequence_data_count * sizeof(uint32_t));
 }
 
+static constexpr off_t GetDictionaryOffset(const CowHeaderV3& header) {
+    return GetResumeOffset(header) + (header.resume_point_max * sizeof(ResumePoint));
+}
+
 static constexpr off_t GetOpOffset(uint32_t op_index, const CowHeaderV3& header) {
-    return GetResumeOffset(header) + (header.resume_point_max * sizeof(ResumePoint)) +
+    return GetDictionaryOffset(header) + header.dictionary_size +
            (op_index * sizeof(CowOperationV3));
 }
 
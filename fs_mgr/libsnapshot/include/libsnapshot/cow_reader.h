@@ -31,6 +31,7 @@ class FileDescriptor;
 namespace android {
 namespace snapshot {
 
+class CowDictionary;
 class ICowOpIter;
 
 // Interface for reading from a snapuserd COW.
@@ -79,6 +80,15 @@ class ICowReader {
     virtual bool GetSourceOffset(const CowOperation* op, uint64_t* source_offset) = 0;
 };
 
+// A single data op to be decoded by CowReader::ReadDataParallel.
+struct CowReadRequest {
+    const CowOperation* op;
+    void* buffer;
+    size_t buffer_size;
+    // Set to the return value of ReadData() for this op.
+    ssize_t result = -1;
+};
+
 static constexpr uint64_t GetBlockFromOffset(const CowHeader& header, uint64_t offset) {
     return offset / header.block_size;
 }
@@ -144,6 +154,14 @@ class CowReader final : public ICowReader {
     ssize_t ReadData(const CowOperation* op, void* buffer, size_t buffer_size,
                      size_t ignore_bytes = 0) override;
 
+    // Same as ReadData, for a batch of ops. Decompression is spread across
+    // up to |num_threads| threads (including the caller), and each op is
+    // decoded directly into its own buffer.
+    //
+    // Returns true if every request filled its whole buffer. The result of
+    // each op is stored in its request.
+    bool ReadDataParallel(std::vector<CowReadRequest>* requests, size_t num_threads);
+
     CowHeader& GetHeader() override { return header_; }
     const CowHeaderV3& header_v3() const { return header_; }
 
@@ -179,6 +197,7 @@ class CowReader final : public ICowReader {
                          std::unordered_map<uint32_t, int>* block_map);
     uint64_t FindNumCopyops();
     uint8_t GetCompressionType();
+    bool ReadDictionary();
 
     android::base::unique_fd owned_fd_;
     android::base::borrowed_fd fd_;
@@ -186,13 +205,14 @@ class CowReader final : public ICowReader {
     std::optional<CowFooter> footer_;
     uint64_t fd_size_;
     std::optional<uint64_t> last_label_;
-    std::shared_ptr<std::vector<CowOperation>> ops_;
+    CowOpsView ops_;
     uint64_t merge_op_start_{};
     std::shared_ptr<std::vector<int>> block_pos_index_;
     uint64_t num_total_data_ops_{};
     uint64_t num_ordered_ops_to_merge_{};
     bool has_seq_ops_{};
     std::shared_ptr<std::unordered_map<uint64_t, uint64_t>> xor_data_loc_;
+    std::shared_ptr<const CowDictionary> dictionary_;
     ReaderFlags reader_flag_;
     bool is_merge_{};
 };
@@ -63,6 +63,20 @@ struct CowOptions {
 
     // Compression factor
     uint64_t compression_factor = 4096;
+
+    // Pre-trained compression dictionary, e.g. from "zstd --train" over the
+    // partition's blocks. Stored in the COW and used for every compressed
+    // block; only supported with zstd in v3.
+    std::string compression_dictionary;
+
+    // Store identical replace data only once; later copies become replace ops
+    // that share the earlier op's data. Used in v3 only, and not while
+    // estimating the COW size.
+    bool dedup_blocks = false;
+
+    // Number of threads decoding ahead of the read position in file
+    // descriptors from OpenFileDescriptor(). 0 decodes each read in place.
+    uint16_t num_read_ahead_threads = 0;
 };
 
 // Interface for writing to a snapuserd COW. All operations are ordered; merges
@@ -163,5 +177,14 @@ std::unique_ptr<ICowWriter> CreateCowWriter(uint32_t version, const CowOptions&
                                             android::base::unique_fd&& fd,
                                             std::optional<uint64_t> label = {});
 
+// Rewrite the COW in |in_fd| as a v3 COW in |out_fd|, laid out for merging:
+// copy and xor ops keep their merge sequence and come first, followed by the
+// replace and zero ops in ascending block order, with the replace data stored
+// in that same order. Merge order, reads of the COW data and writes to the
+// base device then all move forward together. Adjacent replace blocks are
+// recompressed together using the compression settings in |options|.
+bool RewriteCowInMergeOrder(android::base::borrowed_fd in_fd, const CowOptions& options,
+                            android::base::unique_fd&& out_fd);
+
 }  // namespace snapshot
 }  // namespace android
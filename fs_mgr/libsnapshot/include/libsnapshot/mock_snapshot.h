@@ -31,7 +31,8 @@ class MockSnapshotManager : public ISnapshotManager {
     MOCK_METHOD(bool, InitiateMerge, (), (override));
 
     MOCK_METHOD(UpdateState, ProcessUpdateState,
-                (const std::function<bool()>& callback, const std::function<bool()>& before_cancel),
+                (const std::function<bool()>& callback, const std::function<bool()>& before_cancel,
+                 const std::function<void(double)>& progress),
                 (override));
     MOCK_METHOD(UpdateState, GetUpdateState, (double* progress), (override));
     MOCK_METHOD(bool, UpdateUsesCompression, (), (override));
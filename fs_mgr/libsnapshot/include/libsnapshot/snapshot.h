@@ -153,6 +153,8 @@ class ISnapshotManager {
     //    - Callback is called periodically during the merge. If callback()
     //      returns false during the merge, ProcessUpdateState() will pause
     //      and returns Merging.
+    //    - Progress, if set, is called with the merge completion percentage
+    //      each time the merge advances.
     // If a merge or update was cancelled, this will clean up any
     // update artifacts and return.
     //
@@ -173,8 +175,10 @@ class ISnapshotManager {
     //
     // The optional callback allows the caller to periodically check the
     // progress with GetUpdateState().
-    virtual UpdateState ProcessUpdateState(const std::function<bool()>& callback = {},
-                                           const std::function<bool()>& before_cancel = {}) = 0;
+    virtual UpdateState ProcessUpdateState(
+            const std::function<bool()>& callback = {},
+            const std::function<bool()>& before_cancel = {},
+            const std::function<void(double)>& progress = {}) = 0;
 
     // If ProcessUpdateState() returned MergeFailed, this returns the appropriate
     // code. Otherwise, MergeFailureCode::Ok is returned.
@@ -354,7 +358,8 @@ class SnapshotManager final : public ISnapshotManager {
     MergeFailureCode ReadMergeFailureCode() override;
     bool InitiateMerge() override;
     UpdateState ProcessUpdateState(const std::function<bool()>& callback = {},
-                                   const std::function<bool()>& before_cancel = {}) override;
+                                   const std::function<bool()>& before_cancel = {},
+                                   const std::function<void(double)>& progress = {}) override;
     UpdateState GetUpdateState(double* progress = nullptr) override;
     bool UpdateUsesCompression() override;
     bool UpdateUsesUserSnapshots() override;
@@ -520,6 +525,10 @@ class SnapshotManager final : public ISnapshotManager {
                       const std::string& base_device, const std::string& base_path_merge,
                       const std::chrono::milliseconds& timeout_ms, std::string* path);
 
+    // Initialize and attach the snapuserd handlers that MapDmUserCow() left
+    // preparing in the background.
+    bool StartPreparedDmUsers();
+
     // Map the source device used for dm-user.
     bool MapSourceDevice(LockedFile* lock, const std::string& name,
                          const std::chrono::milliseconds& timeout_ms, std::string* path);
@@ -528,6 +537,10 @@ class SnapshotManager final : public ISnapshotManager {
     std::optional<std::string> MapCowImage(const std::string& name,
                                            const std::chrono::milliseconds& timeout_ms);
 
+    // Map the COW images of all live snapshots in |metadata| with a single
+    // ImageManager call. The resulting devices are handed out by MapCowImage.
+    void PremapCowImages(LockedFile* lock, const LpMetadata& metadata);
+
     // Remove the backing copy-on-write image and snapshot states for the named snapshot. The
     // caller is responsible for ensuring that the snapshot is unmapped.
     bool DeleteSnapshot(LockedFile* lock, const std::string& name);
@@ -641,6 +654,15 @@ class SnapshotManager final : public ISnapshotManager {
         MergeFailureCode failure_code;
     };
 
+    // Block until snapuserd reports that the merge advanced, and return the
+    // new completion percentage. Returns false if the update does not use
+    // snapuserd or it cannot report progress; callers should poll instead.
+    bool WaitForMergeProgress(double* percentage);
+
+    // Add snapuserd's merge statistics for a snapshot to the merge report,
+    // before its handler goes away.
+    void RecordPartitionMergeStats(const std::string& name);
+
     // Only the following UpdateStates are used here:
     //   UpdateState::Merging
     //   UpdateState::MergeCompleted
@@ -841,6 +863,17 @@ class SnapshotManager final : public ISnapshotManager {
     std::unique_ptr<IDeviceInfo> device_;
     std::string metadata_dir_;
     std::unique_ptr<IImageManager> images_;
+    // COW image name -> major:minor device string, populated by PremapCowImages().
+    std::map<std::string, std::string> premapped_cow_images_;
+    // dm-user devices whose handlers snapuserd is initializing in the
+    // background; MapDmUserCow() only fills this in while it is non-null.
+    struct PreparedDmUser {
+        std::string misc_name;
+        std::string cow_file;
+        std::string base_device;
+        std::string base_path_merge;
+    };
+    std::vector<PreparedDmUser>* prepared_dm_users_ = nullptr;
     bool use_first_stage_snapuserd_ = false;
     bool in_factory_data_reset_ = false;
     std::function<bool(const std::string&)> uevent_regen_callback_;
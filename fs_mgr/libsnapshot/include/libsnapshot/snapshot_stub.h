@@ -32,7 +32,8 @@ class SnapshotManagerStub : public ISnapshotManager {
     MergeFailureCode ReadMergeFailureCode() override;
     bool InitiateMerge() override;
     UpdateState ProcessUpdateState(const std::function<bool()>& callback = {},
-                                   const std::function<bool()>& before_cancel = {}) override;
+                                   const std::function<bool()>& before_cancel = {},
+                                   const std::function<void(double)>& progress = {}) override;
     UpdateState GetUpdateState(double* progress = nullptr) override;
     bool UpdateUsesCompression() override;
     bool UpdateUsesUserSnapshots() override;
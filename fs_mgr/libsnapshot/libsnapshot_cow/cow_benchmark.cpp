@@ -0,0 +1,179 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Throughput benchmarks for CowWriterV3 and CowReader. Every case reports
+// bytes_per_second and items_per_second (COW ops/s). For machine-readable
+// results, run with:
+//
+//   cow_benchmark --benchmark_out=cow.json --benchmark_out_format=json
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <libsnapshot/cow_reader.h>
+#include <libsnapshot/cow_writer.h>
+#include <storage_literals/storage_literals.h>
+
+namespace android {
+namespace snapshot {
+
+using android::base::unique_fd;
+using namespace android::storage_literals;
+
+static constexpr uint32_t kBlockSize = 4_KiB;
+static constexpr size_t kNumBlocks = 4096;
+
+static const char* const kAlgorithms[] = {"none", "gz", "brotli", "lz4", "zstd"};
+
+// 16MiB of deterministic data that compresses roughly 2:1: each block is half
+// random bytes and half a repeating pattern.
+static const std::string& GetBlockData() {
+    static const std::string data = [] {
+        std::mt19937 rng(0);
+        std::string data(kNumBlocks * kBlockSize, '\0');
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<char>((i % kBlockSize) < kBlockSize / 2 ? rng() : i % 7);
+        }
+        return data;
+    }();
+    return data;
+}
+
+static CowOptions GetOptions(const benchmark::State& state) {
+    CowOptions options;
+    options.block_size = kBlockSize;
+    options.compression = kAlgorithms[state.range(0)];
+    options.compression_factor = state.range(1);
+    options.op_count_max = kNumBlocks;
+    return options;
+}
+
+static bool WriteCow(const CowOptions& options, int fd) {
+    const auto& data = GetBlockData();
+    auto writer = CreateCowWriter(3, options, unique_fd(dup(fd)));
+    if (!writer) {
+        return false;
+    }
+    return writer->AddRawBlocks(0, data.data(), data.size()) && writer->Finalize();
+}
+
+// Args: algorithm index, compression factor, compression threads.
+static void BM_CowWriterV3(benchmark::State& state) {
+    auto options = GetOptions(state);
+    options.num_compress_threads = state.range(2);
+    state.SetLabel(options.compression);
+
+    TemporaryFile cow;
+    for (auto _ : state) {
+        state.PauseTiming();
+        if (ftruncate(cow.fd, 0) < 0) {
+            state.SkipWithError("ftruncate failed");
+            break;
+        }
+        state.ResumeTiming();
+
+        if (!WriteCow(options, cow.fd)) {
+            state.SkipWithError("writing the COW failed");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * GetBlockData().size());
+    state.SetItemsProcessed(state.iterations() * kNumBlocks);
+}
+BENCHMARK(BM_CowWriterV3)
+        ->ArgsProduct({benchmark::CreateDenseRange(0, std::size(kAlgorithms) - 1, 1),
+                       {4_KiB, 16_KiB, 64_KiB},
+                       {1, 2, 4}})
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+
+// Shared by the reader benchmarks so each COW is only written once.
+static TemporaryFile* GetReaderCow(const benchmark::State& state) {
+    static std::map<std::pair<int64_t, int64_t>, std::unique_ptr<TemporaryFile>> cows;
+
+    auto& cow = cows[{state.range(0), state.range(1)}];
+    if (!cow) {
+        cow = std::make_unique<TemporaryFile>();
+        if (!WriteCow(GetOptions(state), cow->fd)) {
+            cow = nullptr;
+        }
+    }
+    return cow.get();
+}
+
+static void RunReaderBenchmark(benchmark::State& state, bool shuffle) {
+    state.SetLabel(kAlgorithms[state.range(0)]);
+
+    auto cow = GetReaderCow(state);
+    CowReader reader;
+    if (!cow || !reader.Parse(cow->fd)) {
+        state.SkipWithError("preparing the COW failed");
+        return;
+    }
+
+    std::vector<const CowOperation*> ops;
+    for (auto iter = reader.GetOpIter(); !iter->AtEnd(); iter->Next()) {
+        ops.emplace_back(iter->Get());
+    }
+    if (shuffle) {
+        std::shuffle(ops.begin(), ops.end(), std::mt19937(0));
+    }
+
+    std::string buffer(state.range(1), '\0');
+    size_t bytes = 0;
+    for (auto _ : state) {
+        for (const auto& op : ops) {
+            ssize_t rv = reader.ReadData(op, buffer.data(), buffer.size());
+            if (rv < 0) {
+                state.SkipWithError("ReadData failed");
+                return;
+            }
+            bytes += rv;
+        }
+    }
+    state.SetBytesProcessed(bytes);
+    state.SetItemsProcessed(state.iterations() * ops.size());
+}
+
+// Args: algorithm index, compression factor.
+static void BM_CowReaderSequential(benchmark::State& state) {
+    RunReaderBenchmark(state, false);
+}
+BENCHMARK(BM_CowReaderSequential)
+        ->ArgsProduct({benchmark::CreateDenseRange(0, std::size(kAlgorithms) - 1, 1),
+                       {4_KiB, 64_KiB}})
+        ->Unit(benchmark::kMillisecond);
+
+static void BM_CowReaderRandom(benchmark::State& state) {
+    RunReaderBenchmark(state, true);
+}
+BENCHMARK(BM_CowReaderRandom)
+        ->ArgsProduct({benchmark::CreateDenseRange(0, std::size(kAlgorithms) - 1, 1),
+                       {4_KiB, 64_KiB}})
+        ->Unit(benchmark::kMillisecond);
+
+}  // namespace snapshot
+}  // namespace android
+
+BENCHMARK_MAIN();
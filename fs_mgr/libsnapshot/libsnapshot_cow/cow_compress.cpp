@@ -59,6 +59,11 @@ std::optional<CowCompressionAlgorithm> CompressionAlgorithmFromString(std::strin
 
 std::unique_ptr<ICompressor> ICompressor::Create(CowCompression compression,
                                                  const uint32_t block_size) {
+    if (!compression.dictionary.empty() && compression.algorithm != kCowCompressZstd) {
+        LOG(ERROR) << "Compression dictionaries are not supported for algorithm "
+                   << static_cast<int>(compression.algorithm);
+        return nullptr;
+    }
     switch (compression.algorithm) {
         case kCowCompressLz4:
             return ICompressor::Lz4(compression.compression_level, block_size);
@@ -67,7 +72,8 @@ std::unique_ptr<ICompressor> ICompressor::Create(CowCompression compression,
         case kCowCompressGz:
             return ICompressor::Gz(compression.compression_level, block_size);
         case kCowCompressZstd:
-            return ICompressor::Zstd(compression.compression_level, block_size);
+            return ICompressor::Zstd(compression.compression_level, block_size,
+                                     compression.dictionary);
         case kCowCompressNone:
             return nullptr;
     }
@@ -188,6 +194,18 @@ class ZstdCompressor final : public ICompressor {
         ZSTD_CCtx_setParameter(zstd_context_.get(), ZSTD_c_windowLog, log2(GetBlockSize()));
     };
 
+    bool LoadDictionary(std::string_view dictionary) {
+        // The dictionary is copied and sticks to the context, so it is digested
+        // once and applied to every block compressed after this.
+        const auto rv = ZSTD_CCtx_loadDictionary(zstd_context_.get(), dictionary.data(),
+                                                 dictionary.size());
+        if (ZSTD_isError(rv)) {
+            LOG(ERROR) << "ZSTD_CCtx_loadDictionary failed: " << ZSTD_getErrorName(rv);
+            return false;
+        }
+        return true;
+    }
+
     std::vector<uint8_t> Compress(const void* data, size_t length) const override {
         std::vector<uint8_t> buffer(ZSTD_compressBound(length), '\0');
         const auto compressed_size =
@@ -335,8 +353,13 @@ std::unique_ptr<ICompressor> ICompressor::Lz4(const int32_t compression_level,
 }
 
 std::unique_ptr<ICompressor> ICompressor::Zstd(const int32_t compression_level,
-                                               const uint32_t block_size) {
-    return std::make_unique<ZstdCompressor>(compression_level, block_size);
+                                               const uint32_t block_size,
+                                               std::string_view dictionary) {
+    auto compressor = std::make_unique<ZstdCompressor>(compression_level, block_size);
+    if (!dictionary.empty() && !compressor->LoadDictionary(dictionary)) {
+        return nullptr;
+    }
+    return compressor;
 }
 
 void CompressWorker::Finalize() {
@@ -334,8 +334,36 @@ class Lz4Decompressor final : public IDecompressor {
     }
 };
 
+class ZstdDictionary final : public CowDictionary {
+  public:
+    explicit ZstdDictionary(ZSTD_DDict* ddict) : ddict_(ddict, ZSTD_freeDDict) {}
+
+    const ZSTD_DDict* get() const { return ddict_.get(); }
+
+  private:
+    std::unique_ptr<ZSTD_DDict, decltype(&ZSTD_freeDDict)> ddict_;
+};
+
+std::shared_ptr<const CowDictionary> CowDictionary::Create(CowCompressionAlgorithm algorithm,
+                                                           std::string_view data) {
+    if (algorithm != kCowCompressZstd) {
+        LOG(ERROR) << "Compression dictionaries are not supported for algorithm "
+                   << static_cast<int>(algorithm);
+        return nullptr;
+    }
+    ZSTD_DDict* ddict = ZSTD_createDDict(data.data(), data.size());
+    if (!ddict) {
+        LOG(ERROR) << "Failed to load ZSTD dictionary of " << data.size() << " bytes";
+        return nullptr;
+    }
+    return std::make_shared<ZstdDictionary>(ddict);
+}
+
 class ZstdDecompressor final : public IDecompressor {
   public:
+    explicit ZstdDecompressor(std::shared_ptr<const CowDictionary> dictionary)
+        : dictionary_(std::move(dictionary)) {}
+
     ssize_t Decompress(void* buffer, size_t buffer_size, size_t decompressed_size,
                        size_t ignore_bytes = 0) override {
         if (buffer_size < decompressed_size - ignore_bytes) {
@@ -366,8 +394,18 @@ class ZstdDecompressor final : public IDecompressor {
                        << " actual: " << bytes_read;
             return false;
         }
-        const auto bytes_decompressed = ZSTD_decompress(output_buffer, output_size,
-                                                        input_buffer.data(), input_buffer.size());
+        size_t bytes_decompressed;
+        if (dictionary_) {
+            std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(),
+                                                                      ZSTD_freeDCtx);
+            const auto ddict = static_cast<const ZstdDictionary*>(dictionary_.get())->get();
+            bytes_decompressed =
+                    ZSTD_decompress_usingDDict(dctx.get(), output_buffer, output_size,
+                                               input_buffer.data(), input_buffer.size(), ddict);
+        } else {
+            bytes_decompressed = ZSTD_decompress(output_buffer, output_size, input_buffer.data(),
+                                                 input_buffer.size());
+        }
         if (bytes_decompressed != output_size) {
             LOG(ERROR) << "Failed to decompress ZSTD block, expected output size: " << output_size
                        << ", actual: " << bytes_decompressed;
@@ -375,6 +413,9 @@ class ZstdDecompressor final : public IDecompressor {
         }
         return true;
     }
+
+  private:
+    std::shared_ptr<const CowDictionary> dictionary_;
 };
 
 std::unique_ptr<IDecompressor> IDecompressor::Brotli() {
@@ -389,8 +430,9 @@ std::unique_ptr<IDecompressor> IDecompressor::Lz4() {
     return std::make_unique<Lz4Decompressor>();
 }
 
-std::unique_ptr<IDecompressor> IDecompressor::Zstd() {
-    return std::make_unique<ZstdDecompressor>();
+std::unique_ptr<IDecompressor> IDecompressor::Zstd(
+        std::shared_ptr<const CowDictionary> dictionary) {
+    return std::make_unique<ZstdDecompressor>(std::move(dictionary));
 }
 
 }  // namespace snapshot
@@ -38,6 +38,18 @@ class IByteStream {
     ssize_t ReadFully(void* buffer, size_t length);
 };
 
+// A compression dictionary read from a COW. It is digested once when the COW
+// is parsed and then shared by every decompressor the reader creates.
+class CowDictionary {
+  public:
+    virtual ~CowDictionary() {}
+
+    // Returns null if |algorithm| does not support dictionaries or |data| is
+    // not a valid dictionary.
+    static std::shared_ptr<const CowDictionary> Create(CowCompressionAlgorithm algorithm,
+                                                       std::string_view data);
+};
+
 class IDecompressor {
   public:
     virtual ~IDecompressor() {}
@@ -47,7 +59,8 @@ class IDecompressor {
     static std::unique_ptr<IDecompressor> Gz();
     static std::unique_ptr<IDecompressor> Brotli();
     static std::unique_ptr<IDecompressor> Lz4();
-    static std::unique_ptr<IDecompressor> Zstd();
+    static std::unique_ptr<IDecompressor> Zstd(
+            std::shared_ptr<const CowDictionary> dictionary = nullptr);
 
     static std::unique_ptr<IDecompressor> FromString(std::string_view compressor);
 
@@ -99,6 +99,9 @@ std::ostream& operator<<(std::ostream& os, CowOperationV3 const& op) {
     } else if (op.type() == kCowClusterOp) {
         os << ", cluster_data:" << op.source();
     }
+    if (op.shared_data()) {
+        os << ", shared";
+    }
     // V3 op stores resume points in header, so CowOp can never be Label.
     os << ")";
     return os;
@@ -17,7 +17,11 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <optional>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -87,6 +91,7 @@ std::unique_ptr<CowReader> CowReader::CloneCowReader() {
     cow->num_total_data_ops_ = num_total_data_ops_;
     cow->num_ordered_ops_to_merge_ = num_ordered_ops_to_merge_;
     cow->xor_data_loc_ = xor_data_loc_;
+    cow->dictionary_ = dictionary_;
     cow->block_pos_index_ = block_pos_index_;
     cow->is_merge_ = is_merge_;
     return cow;
@@ -159,11 +164,36 @@ bool CowReader::Parse(android::base::borrowed_fd fd, std::optional<uint64_t> lab
     last_label_ = parser->last_label();
     xor_data_loc_ = parser->xor_data_loc();
 
+    if (!ReadDictionary()) {
+        return false;
+    }
+
     // If we're resuming a write, we're not ready to merge
     if (label.has_value()) return true;
     return PrepMergeOps();
 }
 
+bool CowReader::ReadDictionary() {
+    dictionary_ = nullptr;
+    if (header_.prefix.major_version != 3 || !header_.dictionary_size) {
+        return true;
+    }
+    const off_t offset = GetDictionaryOffset(header_);
+    if (offset + header_.dictionary_size > fd_size_) {
+        LOG(ERROR) << "Compression dictionary of " << header_.dictionary_size
+                   << " bytes at offset " << offset << " exceeds COW size " << fd_size_;
+        return false;
+    }
+    std::string data(header_.dictionary_size, '\0');
+    if (!android::base::ReadFullyAtOffset(fd_, data.data(), data.size(), offset)) {
+        PLOG(ERROR) << "read compression dictionary failed";
+        return false;
+    }
+    dictionary_ = CowDictionary::Create(
+            static_cast<CowCompressionAlgorithm>(header_.compression_algorithm), data);
+    return dictionary_ != nullptr;
+}
+
 uint32_t CowReader::GetMaxCompressionSize() {
     switch (header_.prefix.major_version) {
         case 1:
@@ -331,21 +361,14 @@ bool CowReader::PrepMergeOps() {
         merge_op_start_ = header_.num_merge_ops;
     }
 
-    if (is_merge_) {
-        // Metadata ops are not required for merge. Thus, just re-arrange
-        // the ops vector as required for merge operations.
-        auto merge_ops_buffer = std::make_shared<std::vector<CowOperation>>();
-        merge_ops_buffer->reserve(num_total_data_ops_);
-        for (auto block : merge_op_blocks) {
-            merge_ops_buffer->emplace_back(ops_->data()[block_map.at(block)]);
-        }
-        ops_->clear();
-        ops_ = merge_ops_buffer;
-        ops_->shrink_to_fit();
-    } else {
-        for (auto block : merge_op_blocks) {
-            block_pos_index_->push_back(block_map.at(block));
-        }
+    // The ops themselves are never copied into merge order: for v3 they are
+    // a read-only mapping of the op section, and a reordered heap copy would
+    // pin all of them in memory for the lifetime of the merge. Instead, the
+    // merge iterators walk this index. Metadata ops are not part of it, so a
+    // merge reader does not need them.
+    block_pos_index_->reserve(merge_op_blocks.size());
+    for (auto block : merge_op_blocks) {
+        block_pos_index_->push_back(block_map.at(block));
     }
 
     block_map.clear();
@@ -360,8 +383,8 @@ bool CowReader::GetSequenceDataV2(std::vector<uint32_t>* merge_op_blocks,
     auto seq_ops_set = std::unordered_set<uint32_t>();
     size_t num_seqs = 0;
     size_t read;
-    for (size_t i = 0; i < ops_->size(); i++) {
-        auto& current_op = ops_->data()[i];
+    for (size_t i = 0; i < ops_.size(); i++) {
+        auto& current_op = ops_[i];
 
         if (current_op.type() == kCowSequenceOp) {
             size_t seq_len = current_op.data_length / sizeof(uint32_t);
@@ -411,8 +434,8 @@ bool CowReader::GetSequenceData(std::vector<uint32_t>* merge_op_blocks, std::vec
         seq_ops_set.insert(i);
     }
     // read ordered op data
-    for (size_t i = 0; i < ops_->size(); i++) {
-        auto& current_op = ops_->data()[i];
+    for (size_t i = 0; i < ops_.size(); i++) {
+        auto& current_op = ops_[i];
         // Sequence ops must be the first ops in the stream.
         if (seq_ops_set.empty()) {
             merge_op_blocks->emplace_back(current_op.new_block);
@@ -497,7 +520,7 @@ bool CowReader::GetLastLabel(uint64_t* label) {
 
 class CowOpIter final : public ICowOpIter {
   public:
-    CowOpIter(std::shared_ptr<std::vector<CowOperation>>& ops, uint64_t start);
+    CowOpIter(const CowOpsView& ops, uint64_t start);
 
     bool AtEnd() override;
     const CowOperation* Get() override;
@@ -507,17 +530,17 @@ class CowOpIter final : public ICowOpIter {
     bool AtBegin() override;
 
   private:
-    std::shared_ptr<std::vector<CowOperation>> ops_;
-    std::vector<CowOperation>::iterator op_iter_;
+    CowOpsView ops_;
+    std::span<const CowOperation>::iterator op_iter_;
 };
 
-CowOpIter::CowOpIter(std::shared_ptr<std::vector<CowOperation>>& ops, uint64_t start) {
+CowOpIter::CowOpIter(const CowOpsView& ops, uint64_t start) {
     ops_ = ops;
-    op_iter_ = ops_->begin() + start;
+    op_iter_ = ops_.begin() + start;
 }
 
 bool CowOpIter::AtBegin() {
-    return op_iter_ == ops_->begin();
+    return op_iter_ == ops_.begin();
 }
 
 void CowOpIter::Prev() {
@@ -526,7 +549,7 @@ void CowOpIter::Prev() {
 }
 
 bool CowOpIter::AtEnd() {
-    return op_iter_ == ops_->end();
+    return op_iter_ == ops_.end();
 }
 
 void CowOpIter::Next() {
@@ -541,7 +564,7 @@ const CowOperation* CowOpIter::Get() {
 
 class CowRevMergeOpIter final : public ICowOpIter {
   public:
-    explicit CowRevMergeOpIter(std::shared_ptr<std::vector<CowOperation>> ops,
+    explicit CowRevMergeOpIter(const CowOpsView& ops,
                                std::shared_ptr<std::vector<int>> block_pos_index, uint64_t start);
 
     bool AtEnd() override;
@@ -552,7 +575,7 @@ class CowRevMergeOpIter final : public ICowOpIter {
     bool AtBegin() override;
 
   private:
-    std::shared_ptr<std::vector<CowOperation>> ops_;
+    CowOpsView ops_;
     std::vector<int>::reverse_iterator block_riter_;
     std::shared_ptr<std::vector<int>> cow_op_index_vec_;
     uint64_t start_;
@@ -560,7 +583,7 @@ class CowRevMergeOpIter final : public ICowOpIter {
 
 class CowMergeOpIter final : public ICowOpIter {
   public:
-    explicit CowMergeOpIter(std::shared_ptr<std::vector<CowOperation>> ops,
+    explicit CowMergeOpIter(const CowOpsView& ops,
                             std::shared_ptr<std::vector<int>> block_pos_index, uint64_t start);
 
     bool AtEnd() override;
@@ -571,13 +594,13 @@ class CowMergeOpIter final : public ICowOpIter {
     bool AtBegin() override;
 
   private:
-    std::shared_ptr<std::vector<CowOperation>> ops_;
+    CowOpsView ops_;
     std::vector<int>::iterator block_iter_;
     std::shared_ptr<std::vector<int>> cow_op_index_vec_;
     uint64_t start_;
 };
 
-CowMergeOpIter::CowMergeOpIter(std::shared_ptr<std::vector<CowOperation>> ops,
+CowMergeOpIter::CowMergeOpIter(const CowOpsView& ops,
                                std::shared_ptr<std::vector<int>> block_pos_index, uint64_t start) {
     ops_ = ops;
     start_ = start;
@@ -605,10 +628,10 @@ void CowMergeOpIter::Next() {
 
 const CowOperation* CowMergeOpIter::Get() {
     CHECK(!AtEnd());
-    return &ops_->data()[*block_iter_];
+    return &ops_[*block_iter_];
 }
 
-CowRevMergeOpIter::CowRevMergeOpIter(std::shared_ptr<std::vector<CowOperation>> ops,
+CowRevMergeOpIter::CowRevMergeOpIter(const CowOpsView& ops,
                                      std::shared_ptr<std::vector<int>> block_pos_index,
                                      uint64_t start) {
     ops_ = ops;
@@ -637,10 +660,15 @@ void CowRevMergeOpIter::Next() {
 
 const CowOperation* CowRevMergeOpIter::Get() {
     CHECK(!AtEnd());
-    return &ops_->data()[*block_riter_];
+    return &ops_[*block_riter_];
 }
 
 std::unique_ptr<ICowOpIter> CowReader::GetOpIter(bool merge_progress) {
+    if (is_merge_) {
+        // Merge readers only present data ops, in merge order.
+        return std::make_unique<CowMergeOpIter>(ops_, block_pos_index_,
+                                                merge_progress ? merge_op_start_ : 0);
+    }
     return std::make_unique<CowOpIter>(ops_, merge_progress ? merge_op_start_ : 0);
 }
 
@@ -673,11 +701,9 @@ bool CowReader::GetRawBytes(uint64_t offset, void* buffer, size_t len, size_t* r
         LOG(ERROR) << "invalid data offset: " << offset << ", " << len << " bytes";
         return false;
     }
-    if (lseek(fd_.get(), offset, SEEK_SET) < 0) {
-        PLOG(ERROR) << "lseek to read raw bytes failed";
-        return false;
-    }
-    ssize_t rv = TEMP_FAILURE_RETRY(::read(fd_.get(), buffer, len));
+    // pread() rather than lseek()+read() so that ops can be decoded from
+    // several threads at once.
+    ssize_t rv = TEMP_FAILURE_RETRY(::pread(fd_.get(), buffer, len, offset));
     if (rv < 0) {
         PLOG(ERROR) << "read failed";
         return false;
@@ -739,7 +765,7 @@ ssize_t CowReader::ReadData(const CowOperation* op, void* buffer, size_t buffer_
             break;
         case kCowCompressZstd:
             if (op_buf_size != op->data_length) {
-                decompressor = IDecompressor::Zstd();
+                decompressor = IDecompressor::Zstd(dictionary_);
             }
             break;
         case kCowCompressLz4:
@@ -769,6 +795,35 @@ ssize_t CowReader::ReadData(const CowOperation* op, void* buffer, size_t buffer_
     return decompressor->Decompress(buffer, buffer_size, op_buf_size, ignore_bytes);
 }
 
+bool CowReader::ReadDataParallel(std::vector<CowReadRequest>* requests, size_t num_threads) {
+    if (requests->empty()) {
+        return true;
+    }
+    num_threads = std::clamp<size_t>(num_threads, 1, requests->size());
+
+    std::atomic<size_t> next_request = 0;
+    auto decode = [&]() -> void {
+        size_t index;
+        while ((index = next_request++) < requests->size()) {
+            auto& request = (*requests)[index];
+            request.result = ReadData(request.op, request.buffer, request.buffer_size);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_threads; i++) {
+        threads.emplace_back(decode);
+    }
+    decode();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return std::all_of(requests->begin(), requests->end(), [](const CowReadRequest& request) {
+        return request.result == static_cast<ssize_t>(request.buffer_size);
+    });
+}
+
 bool CowReader::GetSourceOffset(const CowOperation* op, uint64_t* source_offset) {
     switch (op->type()) {
         case kCowCopyOp:
@@ -0,0 +1,229 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <libsnapshot/cow_reader.h>
+#include <libsnapshot/cow_writer.h>
+
+namespace android {
+namespace snapshot {
+
+using android::base::borrowed_fd;
+using android::base::unique_fd;
+
+namespace {
+
+// Data buffered for one run before it is handed to the writer, in units of
+// the compression factor.
+constexpr size_t kRunUnits = 16;
+
+class MergeOrderRewriter {
+  public:
+    MergeOrderRewriter(CowReader* reader, ICowWriter* writer, size_t max_run_bytes)
+        : reader_(reader),
+          writer_(writer),
+          block_size_(reader->GetHeader().block_size),
+          max_run_bytes_(max_run_bytes) {}
+
+    bool WriteOrdered(const std::vector<CowOperation>& ops);
+    bool WriteNonOrdered(const std::vector<CowOperation>& ops);
+
+  private:
+    bool AppendData(const CowOperation& op);
+    bool FlushRun();
+
+    CowReader* reader_;
+    ICowWriter* writer_;
+    const uint32_t block_size_;
+    const size_t max_run_bytes_;
+
+    // Pending run of contiguous blocks of one op type.
+    CowOperationType run_type_ = kCowLabelOp;
+    uint64_t run_start_ = 0;
+    uint64_t run_blocks_ = 0;
+    uint64_t run_source_ = 0;
+    std::string run_data_;
+};
+
+bool MergeOrderRewriter::AppendData(const CowOperation& op) {
+    const size_t size = CowOpCompressionSize(&op, block_size_);
+    const size_t pos = run_data_.size();
+    run_data_.resize(pos + size);
+    if (reader_->ReadData(&op, run_data_.data() + pos, size) != static_cast<ssize_t>(size)) {
+        LOG(ERROR) << "Failed to read data for op: " << op;
+        return false;
+    }
+    return true;
+}
+
+bool MergeOrderRewriter::FlushRun() {
+    bool ok = true;
+    switch (run_type_) {
+        case kCowCopyOp:
+            ok = writer_->AddCopy(run_start_, run_source_ / block_size_, run_blocks_);
+            break;
+        case kCowXorOp:
+            ok = writer_->AddXorBlocks(run_start_, run_data_.data(), run_data_.size(),
+                                       run_source_ / block_size_, run_source_ % block_size_);
+            break;
+        case kCowReplaceOp:
+            ok = writer_->AddRawBlocks(run_start_, run_data_.data(), run_data_.size());
+            break;
+        case kCowZeroOp:
+            ok = writer_->AddZeroBlocks(run_start_, run_blocks_);
+            break;
+        default:
+            break;
+    }
+    if (!ok) {
+        LOG(ERROR) << "Failed to write " << run_blocks_ << " blocks of type " << run_type_
+                   << " at " << run_start_;
+    }
+    run_type_ = kCowLabelOp;
+    run_blocks_ = 0;
+    run_data_.clear();
+    return ok;
+}
+
+// Ordered ops keep their merge sequence. Consecutive copies are combined when
+// both the source and the destination advance block by block; xor ops are
+// written one by one, so that the ops written match the sequence data.
+bool MergeOrderRewriter::WriteOrdered(const std::vector<CowOperation>& ops) {
+    for (const auto& op : ops) {
+        uint64_t source;
+        if (!reader_->GetSourceOffset(&op, &source)) {
+            LOG(ERROR) << "Failed to get source offset for op: " << op;
+            return false;
+        }
+        const bool contiguous = run_type_ == kCowCopyOp && op.type() == kCowCopyOp &&
+                                op.new_block == run_start_ + run_blocks_ &&
+                                source == run_source_ + run_blocks_ * block_size_;
+        if (!contiguous) {
+            if (!FlushRun()) {
+                return false;
+            }
+            run_type_ = op.type();
+            run_start_ = op.new_block;
+            run_source_ = source;
+        }
+        if (op.type() == kCowXorOp) {
+            if (!AppendData(op)) {
+                return false;
+            }
+            run_blocks_ += CowOpCompressionSize(&op, block_size_) / block_size_;
+        } else {
+            run_blocks_++;
+        }
+    }
+    return FlushRun();
+}
+
+// |ops| must be sorted by new_block. Adjacent replace and zero ops are
+// combined, so that a replace run can be compressed with the writer's
+// compression factor even if the original COW split it up.
+bool MergeOrderRewriter::WriteNonOrdered(const std::vector<CowOperation>& ops) {
+    for (const auto& op : ops) {
+        const uint64_t num_blocks = CowOpCompressionSize(&op, block_size_) / block_size_;
+        const bool contiguous = run_type_ == op.type() &&
+                                op.new_block == run_start_ + run_blocks_ &&
+                                run_data_.size() < max_run_bytes_;
+        if (!contiguous) {
+            if (!FlushRun()) {
+                return false;
+            }
+            run_type_ = op.type();
+            run_start_ = op.new_block;
+        }
+        if (op.type() == kCowReplaceOp) {
+            if (!AppendData(op)) {
+                return false;
+            }
+            run_blocks_ += num_blocks;
+        } else {
+            run_blocks_++;
+        }
+    }
+    return FlushRun();
+}
+
+}  // namespace
+
+bool RewriteCowInMergeOrder(borrowed_fd in_fd, const CowOptions& options, unique_fd&& out_fd) {
+    // Userspace merge order walks the non-ordered ops in ascending block order.
+    CowReader reader(CowReader::ReaderFlags::USERSPACE_MERGE);
+    if (!reader.Parse(in_fd)) {
+        LOG(ERROR) << "Failed to parse COW to rewrite";
+        return false;
+    }
+    if (reader.GetHeader().block_size != options.block_size) {
+        LOG(ERROR) << "Block size mismatch: COW has " << reader.GetHeader().block_size
+                   << ", options have " << options.block_size;
+        return false;
+    }
+
+    std::vector<CowOperation> ordered_ops;
+    std::vector<CowOperation> other_ops;
+    std::vector<uint32_t> sequence;
+    uint64_t total_blocks = 0;
+    for (auto iter = reader.GetMergeOpIter(true); !iter->AtEnd(); iter->Next()) {
+        const CowOperation* op = iter->Get();
+        total_blocks += CowOpCompressionSize(op, options.block_size) / options.block_size;
+        if (IsOrderedOp(*op)) {
+            ordered_ops.emplace_back(*op);
+            sequence.emplace_back(op->new_block);
+        } else {
+            other_ops.emplace_back(*op);
+        }
+    }
+    // Without sequence data every op merges in the order it was written, so
+    // the non-ordered ops may not be sorted yet. Ordered ops never depend on
+    // them; moving all of them past the ordered ops keeps the COW valid.
+    std::stable_sort(other_ops.begin(), other_ops.end(),
+                     [](const CowOperation& a, const CowOperation& b) {
+                         return a.new_block < b.new_block;
+                     });
+
+    CowOptions writer_options = options;
+    if (!writer_options.max_blocks && writer_options.op_count_max < total_blocks) {
+        writer_options.op_count_max = total_blocks;
+    }
+    auto writer = CreateCowWriter(3, writer_options, std::move(out_fd));
+    if (!writer) {
+        return false;
+    }
+    if (!sequence.empty() && !writer->AddSequenceData(sequence.size(), sequence.data())) {
+        return false;
+    }
+
+    const size_t max_run_bytes = std::max<size_t>(options.compression_factor, options.block_size) *
+                                 kRunUnits;
+    MergeOrderRewriter rewriter(&reader, writer.get(), max_run_bytes);
+    if (!rewriter.WriteOrdered(ordered_ops) || !rewriter.WriteNonOrdered(other_ops)) {
+        return false;
+    }
+    if (!writer->Finalize()) {
+        LOG(ERROR) << "Failed to finalize rewritten COW";
+        return false;
+    }
+    LOG(INFO) << "Rewrote COW in merge order: " << ordered_ops.size() << " ordered ops, "
+              << other_ops.size() << " other ops";
+    return true;
+}
+
+}  // namespace snapshot
+}  // namespace android
@@ -1,6 +1,7 @@
 #include <linux/types.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -13,6 +14,7 @@
 #include <limits>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -31,12 +33,12 @@
 #include <gflags/gflags.h>
 #include <libsnapshot/cow_writer.h>
 
-#include <openssl/sha.h>
-
 DEFINE_string(source, "", "Source partition image");
 DEFINE_string(target, "", "Target partition image");
 DEFINE_string(compression, "lz4",
               "Compression algorithm. Default is set to lz4. Available options: lz4, zstd, gz");
+DEFINE_string(dictionary, "", "Pre-trained compression dictionary. Only supported with zstd");
+DEFINE_bool(mmap, false, "Memory-map the input images instead of reading them in chunks");
 
 namespace android {
 namespace snapshot {
@@ -48,10 +50,74 @@ using android::base::unique_fd;
 using android::snapshot::CreateCowWriter;
 using android::snapshot::ICowWriter;
 
+/*
+ * Read-only view of an input image, either memory-mapped or read on demand.
+ */
+class InputImage {
+  public:
+    ~InputImage();
+    bool Open(const std::string& path, bool use_mmap);
+    uint64_t size() const { return size_; }
+
+    /*
+     * Returns |length| bytes at |offset|. Unless the image is mapped, they
+     * are read into |buffer|, which must be large enough.
+     */
+    const uint8_t* Read(uint64_t offset, size_t length, uint8_t* buffer) const;
+
+  private:
+    std::string path_;
+    unique_fd fd_;
+    uint64_t size_ = 0;
+    void* map_ = MAP_FAILED;
+};
+
+InputImage::~InputImage() {
+    if (map_ != MAP_FAILED) {
+        munmap(map_, size_);
+    }
+}
+
+bool InputImage::Open(const std::string& path, bool use_mmap) {
+    path_ = path;
+    fd_.reset(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd_ < 0) {
+        PLOG(ERROR) << "open failed: " << path;
+        return false;
+    }
+    off_t size = lseek(fd_.get(), 0, SEEK_END);
+    if (size <= 0) {
+        LOG(ERROR) << "Could not determine block device size: " << path;
+        return false;
+    }
+    size_ = size;
+    if (use_mmap) {
+        map_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_.get(), 0);
+        if (map_ == MAP_FAILED) {
+            PLOG(ERROR) << "mmap failed: " << path;
+            return false;
+        }
+    }
+    return true;
+}
+
+const uint8_t* InputImage::Read(uint64_t offset, size_t length, uint8_t* buffer) const {
+    if (map_ != MAP_FAILED) {
+        return static_cast<const uint8_t*>(map_) + offset;
+    }
+    if (!android::base::ReadFullyAtOffset(fd_.get(), buffer, length, offset)) {
+        PLOG(ERROR) << "Failed to read " << length << " bytes at offset " << offset
+                    << " from: " << path_;
+        return nullptr;
+    }
+    return buffer;
+}
+
 class CreateSnapshot {
   public:
     CreateSnapshot(const std::string& src_file, const std::string& target_file,
-                   const std::string& patch_file, const std::string& compression);
+                   const std::string& patch_file, const std::string& compression,
+                   const std::string& dictionary_file, bool use_mmap);
     bool CreateSnapshotPatch();
 
   private:
@@ -62,19 +128,26 @@ class CreateSnapshot {
     /* snapshot-patch generated */
     std::string patch_file_;
 
+    InputImage source_;
+    InputImage target_;
+    bool use_mmap_ = false;
+
     /*
-     * Active file which is being parsed by this instance.
+     * Active image which is being parsed by this instance.
      * It will either be source.img or target.img.
      */
-    std::string parsing_file_;
+    const InputImage* parsing_image_ = nullptr;
     bool create_snapshot_patch_ = false;
 
-    const int kNumThreads = 6;
     const size_t kBlockSizeToRead = 1_MiB;
     const size_t compression_factor_ = 64_KiB;
     size_t replace_ops_ = 0, copy_ops_ = 0, zero_ops_ = 0, in_place_ops_ = 0;
 
-    std::unordered_map<std::string, int> source_block_hash_;
+    /*
+     * Block hash -> first source block with that hash. The hash is only used
+     * to find candidates; a copy is emitted only if the blocks are equal.
+     */
+    std::unordered_map<uint64_t, uint64_t> source_block_hash_;
     std::mutex source_block_hash_lock_;
 
     std::unique_ptr<ICowWriter> writer_;
@@ -83,24 +156,34 @@ class CreateSnapshot {
     std::unique_ptr<uint8_t[]> zblock_;
 
     std::string compression_ = "lz4";
+    std::string dictionary_file_;
     unique_fd cow_fd_;
-    unique_fd target_fd_;
 
     std::vector<uint64_t> zero_blocks_;
     std::vector<uint64_t> replace_blocks_;
     std::unordered_map<uint64_t, uint64_t> copy_blocks_;
 
+    /*
+     * Ops found by one ReadBlocks() thread, merged once it is done.
+     */
+    struct BlockDiff {
+        std::vector<uint64_t> zero_blocks;
+        std::vector<uint64_t> replace_blocks;
+        std::vector<std::pair<uint64_t, uint64_t>> copy_blocks;
+        size_t in_place_ops = 0;
+    };
+
     const int BLOCK_SZ = 4_KiB;
-    void SHA256(const void* data, size_t length, uint8_t out[32]);
+    uint64_t HashBlock(const void* data);
     bool IsBlockAligned(uint64_t read_size) { return ((read_size & (BLOCK_SZ - 1)) == 0); }
     bool ReadBlocks(off_t offset, const int skip_blocks, const uint64_t dev_sz);
-    std::string ToHexString(const uint8_t* buf, size_t len);
 
     bool CreateSnapshotFile();
     bool FindSourceBlockHash();
-    bool PrepareParse(std::string& parsing_file, const bool createSnapshot);
+    bool PrepareParse(InputImage* image, const std::string& file, const bool createSnapshot);
     bool ParsePartition();
-    void PrepareMergeBlock(const void* buffer, uint64_t block, std::string& block_hash);
+    bool PrepareMergeBlock(const uint8_t* buffer, uint64_t block, uint8_t* source_buffer,
+                           BlockDiff* diff);
     bool WriteV3Snapshots();
     size_t PrepareWrite(size_t* pending_ops, size_t start_index);
 
@@ -120,15 +203,24 @@ void CreateSnapshotLogger(android::base::LogId, android::base::LogSeverity sever
 }
 
 CreateSnapshot::CreateSnapshot(const std::string& src_file, const std::string& target_file,
-                               const std::string& patch_file, const std::string& compression)
-    : src_file_(src_file), target_file_(target_file), patch_file_(patch_file) {
+                               const std::string& patch_file, const std::string& compression,
+                               const std::string& dictionary_file, bool use_mmap)
+    : src_file_(src_file),
+      target_file_(target_file),
+      patch_file_(patch_file),
+      use_mmap_(use_mmap),
+      dictionary_file_(dictionary_file) {
     if (!compression.empty()) {
         compression_ = compression;
     }
 }
 
-bool CreateSnapshot::PrepareParse(std::string& parsing_file, const bool createSnapshot) {
-    parsing_file_ = parsing_file;
+bool CreateSnapshot::PrepareParse(InputImage* image, const std::string& file,
+                                  const bool createSnapshot) {
+    if (!image->Open(file, use_mmap_)) {
+        return false;
+    }
+    parsing_image_ = image;
     create_snapshot_patch_ = createSnapshot;
 
     if (createSnapshot) {
@@ -138,11 +230,6 @@ bool CreateSnapshot::PrepareParse(std::string& parsing_file, const bool createSn
             return false;
         }
 
-        target_fd_.reset((open(parsing_file_.c_str(), O_RDONLY)));
-        if (target_fd_ < 0) {
-            LOG(ERROR) << "open failed: " << parsing_file_;
-            return false;
-        }
         zblock_ = std::make_unique<uint8_t[]>(BLOCK_SZ);
         std::memset(zblock_.get(), 0, BLOCK_SZ);
     }
@@ -150,22 +237,22 @@ bool CreateSnapshot::PrepareParse(std::string& parsing_file, const bool createSn
 }
 
 /*
- * Create per-block sha256 hash of source partition
+ * Create per-block hash of source partition
  */
 bool CreateSnapshot::FindSourceBlockHash() {
-    if (!PrepareParse(src_file_, false)) {
+    if (!PrepareParse(&source_, src_file_, false)) {
         return false;
     }
     return ParsePartition();
 }
 
 /*
- * Create snapshot file by comparing sha256 per block
- * of target.img with the constructed per-block sha256 hash
+ * Create snapshot file by comparing the hash per block
+ * of target.img with the constructed per-block hash
  * of source partition.
  */
 bool CreateSnapshot::CreateSnapshotFile() {
-    if (!PrepareParse(target_file_, true)) {
+    if (!PrepareParse(&target_, target_file_, true)) {
         return false;
     }
     return ParsePartition();
@@ -181,45 +268,37 @@ bool CreateSnapshot::CreateSnapshotPatch() {
     return CreateSnapshotFile();
 }
 
-void CreateSnapshot::SHA256(const void* data, size_t length, uint8_t out[32]) {
-    SHA256_CTX c;
-    SHA256_Init(&c);
-    SHA256_Update(&c, data, length);
-    SHA256_Final(out, &c);
+uint64_t CreateSnapshot::HashBlock(const void* data) {
+    std::string_view block(static_cast<const char*>(data), BLOCK_SZ);
+    return std::hash<std::string_view>{}(block);
 }
 
-std::string CreateSnapshot::ToHexString(const uint8_t* buf, size_t len) {
-    char lookup[] = "0123456789abcdef";
-    std::string out(len * 2 + 1, '\0');
-    char* outp = out.data();
-    for (; len > 0; len--, buf++) {
-        *outp++ = (char)lookup[*buf >> 4];
-        *outp++ = (char)lookup[*buf & 0xf];
-    }
-    return out;
-}
-
-void CreateSnapshot::PrepareMergeBlock(const void* buffer, uint64_t block,
-                                       std::string& block_hash) {
+bool CreateSnapshot::PrepareMergeBlock(const uint8_t* buffer, uint64_t block,
+                                       uint8_t* source_buffer, BlockDiff* diff) {
     if (std::memcmp(zblock_.get(), buffer, BLOCK_SZ) == 0) {
-        std::lock_guard<std::mutex> lock(write_lock_);
-        zero_blocks_.push_back(block);
-        return;
+        diff->zero_blocks.push_back(block);
+        return true;
     }
 
-    auto iter = source_block_hash_.find(block_hash);
+    auto iter = source_block_hash_.find(HashBlock(buffer));
     if (iter != source_block_hash_.end()) {
-        std::lock_guard<std::mutex> lock(write_lock_);
-        // In-place copy is skipped
-        if (block != iter->second) {
-            copy_blocks_[block] = iter->second;
-        } else {
-            in_place_ops_ += 1;
+        const uint8_t* source =
+                source_.Read(iter->second * BLOCK_SZ, BLOCK_SZ, source_buffer);
+        if (!source) {
+            return false;
+        }
+        if (std::memcmp(source, buffer, BLOCK_SZ) == 0) {
+            // In-place copy is skipped
+            if (block != iter->second) {
+                diff->copy_blocks.emplace_back(block, iter->second);
+            } else {
+                diff->in_place_ops += 1;
+            }
+            return true;
         }
-        return;
     }
-    std::lock_guard<std::mutex> lock(write_lock_);
-    replace_blocks_.push_back(block);
+    diff->replace_blocks.push_back(block);
+    return true;
 }
 
 size_t CreateSnapshot::PrepareWrite(size_t* pending_ops, size_t start_index) {
@@ -239,49 +318,67 @@ size_t CreateSnapshot::PrepareWrite(size_t* pending_ops, size_t start_index) {
 }
 
 bool CreateSnapshot::CreateSnapshotWriter() {
-    uint64_t dev_sz = lseek(target_fd_.get(), 0, SEEK_END);
+    uint64_t dev_sz = target_.size();
     CowOptions options;
     options.compression = compression_;
-    options.num_compress_threads = 2;
+    options.num_compress_threads = std::max(std::thread::hardware_concurrency(), 2u);
     options.batch_write = true;
     options.cluster_ops = 600;
     options.compression_factor = compression_factor_;
     options.max_blocks = {dev_sz / options.block_size};
+    if (!dictionary_file_.empty() &&
+        !android::base::ReadFileToString(dictionary_file_, &options.compression_dictionary)) {
+        PLOG(ERROR) << "Failed to read dictionary: " << dictionary_file_;
+        return false;
+    }
     writer_ = CreateCowWriter(3, options, std::move(cow_fd_));
-    return true;
+    return writer_ != nullptr;
 }
 
 bool CreateSnapshot::WriteNonOrderedSnapshots() {
+    // Zero and replace ops are written in a single pass in ascending block
+    // order, so that merging them walks both the COW data and the base
+    // device forward.
+    std::sort(zero_blocks_.begin(), zero_blocks_.end());
     zero_ops_ = zero_blocks_.size();
-    for (auto it = zero_blocks_.begin(); it != zero_blocks_.end(); it++) {
-        if (!writer_->AddZeroBlocks(*it, 1)) {
-            return false;
-        }
-    }
-    std::string buffer(compression_factor_, '\0');
-
     replace_ops_ = replace_blocks_.size();
-    size_t blocks_to_compress = replace_blocks_.size();
-    size_t num_ops = 0;
+
+    std::string buffer(compression_factor_, '\0');
+    size_t zero_index = 0;
     size_t block_index = 0;
-    while (blocks_to_compress) {
-        num_ops = std::min((compression_factor_ / BLOCK_SZ), blocks_to_compress);
+    while (zero_index < zero_blocks_.size() || block_index < replace_blocks_.size()) {
+        if (block_index == replace_blocks_.size() ||
+            (zero_index < zero_blocks_.size() &&
+             zero_blocks_[zero_index] < replace_blocks_[block_index])) {
+            size_t zero_blocks = 1;
+            while (zero_index + zero_blocks < zero_blocks_.size() &&
+                   zero_blocks_[zero_index + zero_blocks] ==
+                           zero_blocks_[zero_index] + zero_blocks) {
+                zero_blocks += 1;
+            }
+            if (!writer_->AddZeroBlocks(zero_blocks_[zero_index], zero_blocks)) {
+                return false;
+            }
+            zero_index += zero_blocks;
+            continue;
+        }
+
+        size_t num_ops =
+                std::min((compression_factor_ / BLOCK_SZ), replace_blocks_.size() - block_index);
         auto linear_blocks = PrepareWrite(&num_ops, block_index);
-        if (!android::base::ReadFullyAtOffset(target_fd_.get(), buffer.data(),
-                                              (linear_blocks * BLOCK_SZ),
-                                              replace_blocks_[block_index] * BLOCK_SZ)) {
-            LOG(ERROR) << "Failed to read at offset: " << replace_blocks_[block_index] * BLOCK_SZ
-                       << " size: " << linear_blocks * BLOCK_SZ;
+        const uint8_t* data =
+                target_.Read(replace_blocks_[block_index] * BLOCK_SZ, linear_blocks * BLOCK_SZ,
+                             reinterpret_cast<uint8_t*>(buffer.data()));
+        if (!data) {
             return false;
         }
-        if (!writer_->AddRawBlocks(replace_blocks_[block_index], buffer.data(),
+        if (!writer_->AddRawBlocks(replace_blocks_[block_index], data,
                                    linear_blocks * BLOCK_SZ)) {
             LOG(ERROR) << "AddRawBlocks failed";
             return false;
         }
 
         block_index += linear_blocks;
-        blocks_to_compress -= linear_blocks;
     }
     if (!writer_->Finalize()) {
         return false;
@@ -292,7 +389,12 @@ bool CreateSnapshot::WriteNonOrderedSnapshots() {
 bool CreateSnapshot::WriteOrderedSnapshots() {
     std::unordered_map<uint64_t, uint64_t> overwritten_blocks;
     std::vector<std::pair<uint64_t, uint64_t>> merge_sequence;
-    for (auto it = copy_blocks_.begin(); it != copy_blocks_.end(); it++) {
+    // Walk the copies in block order; this keeps both their sources and
+    // their destinations as sequential as the dependencies allow.
+    std::vector<std::pair<uint64_t, uint64_t>> copy_blocks(copy_blocks_.begin(),
+                                                           copy_blocks_.end());
+    std::sort(copy_blocks.begin(), copy_blocks.end());
+    for (auto it = copy_blocks.begin(); it != copy_blocks.end(); it++) {
         if (overwritten_blocks.count(it->second)) {
             replace_blocks_.push_back(it->first);
             continue;
@@ -354,28 +456,26 @@ bool CreateSnapshot::WriteV3Snapshots() {
 }
 
 bool CreateSnapshot::ReadBlocks(off_t offset, const int skip_blocks, const uint64_t dev_sz) {
-    unique_fd fd(TEMP_FAILURE_RETRY(open(parsing_file_.c_str(), O_RDONLY)));
-    if (fd < 0) {
-        LOG(ERROR) << "open failed: " << parsing_file_;
-        return false;
-    }
-
     loff_t file_offset = offset;
     const uint64_t read_sz = kBlockSizeToRead;
     std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(read_sz);
+    std::unique_ptr<uint8_t[]> source_buffer = std::make_unique<uint8_t[]>(BLOCK_SZ);
+
+    // Results are kept per thread and merged once at the end, so that the
+    // threads do not contend on a lock for every block.
+    std::unordered_map<uint64_t, uint64_t> block_hash;
+    BlockDiff diff;
 
     while (true) {
         size_t to_read = std::min((dev_sz - file_offset), read_sz);
 
-        if (!android::base::ReadFullyAtOffset(fd.get(), buffer.get(), to_read, file_offset)) {
-            LOG(ERROR) << "Failed to read block from block device: " << parsing_file_
-                       << " at offset: " << file_offset << " read-size: " << to_read
-                       << " block-size: " << dev_sz;
+        if (!IsBlockAligned(to_read)) {
+            LOG(ERROR) << "unable to parse the un-aligned request: " << to_read;
             return false;
         }
 
-        if (!IsBlockAligned(to_read)) {
-            LOG(ERROR) << "unable to parse the un-aligned request: " << to_read;
+        const uint8_t* data = parsing_image_->Read(file_offset, to_read, buffer.get());
+        if (!data) {
             return false;
         }
 
@@ -384,22 +484,17 @@ bool CreateSnapshot::ReadBlocks(off_t offset, const int skip_blocks, const uint6
         off_t foffset = file_offset;
 
         while (num_blocks) {
-            const void* bufptr = (char*)buffer.get() + buffer_offset;
+            const uint8_t* bufptr = data + buffer_offset;
             uint64_t blkindex = foffset / BLOCK_SZ;
 
-            uint8_t checksum[32];
-            SHA256(bufptr, BLOCK_SZ, checksum);
-            std::string hash = ToHexString(checksum, sizeof(checksum));
-
             if (create_snapshot_patch_) {
-                PrepareMergeBlock(bufptr, blkindex, hash);
-            } else {
-                std::lock_guard<std::mutex> lock(source_block_hash_lock_);
-                {
-                    if (source_block_hash_.count(hash) == 0) {
-                        source_block_hash_[hash] = blkindex;
-                    }
+                if (!PrepareMergeBlock(bufptr, blkindex, source_buffer.get(), &diff)) {
+                    return false;
                 }
+            } else {
+                // Blocks are visited in increasing order, so this keeps the
+                // first block with a given hash.
+                block_hash.try_emplace(HashBlock(bufptr), blkindex);
             }
             buffer_offset += BLOCK_SZ;
             foffset += BLOCK_SZ;
@@ -412,28 +507,33 @@ bool CreateSnapshot::ReadBlocks(off_t offset, const int skip_blocks, const uint6
         }
     }
 
+    if (create_snapshot_patch_) {
+        std::lock_guard<std::mutex> lock(write_lock_);
+        zero_blocks_.insert(zero_blocks_.end(), diff.zero_blocks.begin(), diff.zero_blocks.end());
+        replace_blocks_.insert(replace_blocks_.end(), diff.replace_blocks.begin(),
+                               diff.replace_blocks.end());
+        copy_blocks_.insert(diff.copy_blocks.begin(), diff.copy_blocks.end());
+        in_place_ops_ += diff.in_place_ops;
+    } else {
+        std::lock_guard<std::mutex> lock(source_block_hash_lock_);
+        for (const auto& [hash, block] : block_hash) {
+            auto [iter, inserted] = source_block_hash_.try_emplace(hash, block);
+            if (!inserted && block < iter->second) {
+                iter->second = block;
+            }
+        }
+    }
     return true;
 }
 
 bool CreateSnapshot::ParsePartition() {
-    unique_fd fd(TEMP_FAILURE_RETRY(open(parsing_file_.c_str(), O_RDONLY)));
-    if (fd < 0) {
-        LOG(ERROR) << "open failed: " << parsing_file_;
-        return false;
-    }
-
-    uint64_t dev_sz = lseek(fd.get(), 0, SEEK_END);
-    if (!dev_sz) {
-        LOG(ERROR) << "Could not determine block device size: " << parsing_file_;
-        return false;
-    }
-
+    uint64_t dev_sz = parsing_image_->size();
     if (!IsBlockAligned(dev_sz)) {
         LOG(ERROR) << "dev_sz: " << dev_sz << " is not block aligned";
         return false;
     }
 
-    int num_threads = kNumThreads;
+    int num_threads = std::max(std::thread::hardware_concurrency(), 1u);
 
     std::vector<std::future<bool>> threads;
     off_t start_offset = 0;
@@ -475,6 +575,8 @@ SYNOPSIS
     source.img -> Source partition image
     target.img -> Target partition image
     compressoin -> compression algorithm. Default set to lz4. Supported types are gz, lz4, zstd.
+    dictionary -> optional dictionary file trained with "zstd --train". Requires zstd.
+    mmap -> memory-map the input images instead of reading them in chunks.
 
 EXAMPLES
 
@@ -497,7 +599,7 @@ int main(int argc, char* argv[]) {
     auto parts = android::base::Split(fname, ".");
     std::string snapshotfile = parts[0] + ".patch";
     android::snapshot::CreateSnapshot snapshot(FLAGS_source, FLAGS_target, snapshotfile,
-                                               FLAGS_compression);
+                                               FLAGS_compression, FLAGS_dictionary, FLAGS_mmap);
 
     if (!snapshot.CreateSnapshotPatch()) {
         LOG(ERROR) << "Snapshot creation failed";
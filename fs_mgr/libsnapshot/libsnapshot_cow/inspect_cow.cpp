@@ -20,6 +20,7 @@
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
@@ -40,6 +41,8 @@ DEFINE_bool(verify_merge_sequence, false, "Verify merge order sequencing");
 DEFINE_bool(show_merge_sequence, false, "Show merge order sequence");
 DEFINE_bool(show_raw_ops, false, "Show raw ops directly from the underlying parser");
 DEFINE_string(extract_to, "", "Extract the COW contents to the given file");
+DEFINE_uint32(decompress_threads, std::thread::hardware_concurrency(),
+              "Number of threads used to decompress data ops");
 
 namespace android {
 namespace snapshot {
@@ -74,6 +77,41 @@ static void ShowBad(CowReader& reader, const CowOperation* op) {
     }
 }
 
+// Number of replace ops decompressed together by ReadDataParallel.
+static constexpr size_t kDecompressBatchOps = 256;
+
+// Decompress a batch of replace ops, then report failures and extract them
+// in op order.
+static bool FlushDecompressBatch(CowReader& reader, const CowHeader& header,
+                                 std::vector<CowReadRequest>* batch, borrowed_fd extract_to,
+                                 bool* success) {
+    if (batch->empty()) {
+        return true;
+    }
+
+    // Failures are reported per-op below.
+    reader.ReadDataParallel(batch, FLAGS_decompress_threads);
+
+    for (const auto& request : *batch) {
+        const CowOperation* op = request.op;
+        if (request.result < 0) {
+            std::cerr << "Failed to decompress for :" << *op << "\n";
+            *success = false;
+            if (FLAGS_show_bad_data) ShowBad(reader, op);
+        }
+        if (extract_to.get() >= 0) {
+            off_t offset = uint64_t(op->new_block) * header.block_size;
+            if (!android::base::WriteFullyAtOffset(extract_to, request.buffer, request.buffer_size,
+                                                   offset)) {
+                PLOG(ERROR) << "failed to write block " << op->new_block;
+                return false;
+            }
+        }
+    }
+    batch->clear();
+    return true;
+}
+
 static bool ShowRawOpStreamV2(borrowed_fd fd, const CowHeaderV3& header) {
     CowParserV2 parser;
     if (!parser.Parse(fd, header)) {
@@ -145,6 +183,10 @@ static bool Inspect(const std::string& path) {
         std::cout << "Block size: " << header.block_size << "\n";
         std::cout << "Merge ops: " << header.num_merge_ops << "\n";
         std::cout << "Readahead buffer: " << header.buffer_size << " bytes\n";
+        if (header.prefix.major_version >= 3) {
+            std::cout << "Compression dictionary: " << reader.header_v3().dictionary_size
+                      << " bytes\n";
+        }
         if (has_footer) {
             std::cout << "Footer: ops usage: " << footer.op.ops_size << " bytes\n";
             std::cout << "Footer: op count: " << footer.op.num_ops << "\n";
@@ -175,7 +217,9 @@ static bool Inspect(const std::string& path) {
         iter = reader.GetMergeOpIter(FLAGS_show_merged);
     }
 
-    std::string buffer(header.block_size, '\0');
+    // Replace ops are decompressed in batches, each op into its own slot.
+    std::vector<uint8_t> batch_buffer(kDecompressBatchOps * header.block_size);
+    std::vector<CowReadRequest> batch;
 
     if (!FLAGS_silent && FLAGS_show_raw_ops) {
         std::cout << "\n";
@@ -194,24 +238,18 @@ static bool Inspect(const std::string& path) {
 
     bool success = true;
     uint64_t xor_ops = 0, copy_ops = 0, replace_ops = 0, zero_ops = 0;
+    uint64_t shared_ops = 0, replace_bytes = 0, shared_bytes = 0;
     while (!iter->AtEnd()) {
         const CowOperation* op = iter->Get();
 
         if (!FLAGS_silent && FLAGS_show_ops) std::cout << *op << "\n";
 
         if ((FLAGS_decompress || extract_to >= 0) && op->type() == kCowReplaceOp) {
-            if (reader.ReadData(op, buffer.data(), buffer.size()) < 0) {
-                std::cerr << "Failed to decompress for :" << *op << "\n";
-                success = false;
-                if (FLAGS_show_bad_data) ShowBad(reader, op);
-            }
-            if (extract_to >= 0) {
-                off_t offset = uint64_t(op->new_block) * header.block_size;
-                if (!android::base::WriteFullyAtOffset(extract_to, buffer.data(), buffer.size(),
-                                                       offset)) {
-                    PLOG(ERROR) << "failed to write block " << op->new_block;
-                    return false;
-                }
+            void* slot = batch_buffer.data() + batch.size() * header.block_size;
+            batch.push_back({op, slot, header.block_size});
+            if (batch.size() == kDecompressBatchOps &&
+                !FlushDecompressBatch(reader, header, &batch, extract_to, &success)) {
+                return false;
             }
         } else if (extract_to >= 0 && !IsMetadataOp(*op) && op->type() != kCowZeroOp) {
             PLOG(ERROR) << "Cannot extract op yet: " << *op;
@@ -240,6 +278,11 @@ static bool Inspect(const std::string& path) {
             copy_ops++;
         } else if (op->type() == kCowReplaceOp) {
             replace_ops++;
+            replace_bytes += op->data_length;
+            if (op->shared_data()) {
+                shared_ops++;
+                shared_bytes += op->data_length;
+            }
         } else if (op->type() == kCowZeroOp) {
             zero_ops++;
         } else if (op->type() == kCowXorOp) {
@@ -249,6 +292,10 @@ static bool Inspect(const std::string& path) {
         iter->Next();
     }
 
+    if (!FlushDecompressBatch(reader, header, &batch, extract_to, &success)) {
+        return false;
+    }
+
     if (!FLAGS_silent) {
         auto total_ops = replace_ops + zero_ops + copy_ops + xor_ops;
         std::cout << "Data ops: " << total_ops << "\n";
@@ -256,6 +303,13 @@ static bool Inspect(const std::string& path) {
         std::cout << "Zero ops: " << zero_ops << "\n";
         std::cout << "Copy ops: " << copy_ops << "\n";
         std::cout << "Xor ops: " << xor_ops << "\n";
+        if (shared_ops) {
+            std::cout << "Shared replace ops: " << shared_ops << " (" << shared_bytes
+                      << " bytes not stored)\n";
+            std::cout << "Dedup ratio: "
+                      << static_cast<double>(replace_bytes) / (replace_bytes - shared_bytes)
+                      << "\n";
+        }
     }
 
     return success;
@@ -27,7 +27,7 @@ namespace snapshot {
 
 struct TranslatedCowOps {
     CowHeaderV3 header;
-    std::shared_ptr<std::vector<CowOperationV3>> ops;
+    CowOpsView ops;
 };
 
 class CowParserBase {
@@ -198,13 +198,13 @@ bool CowParserV2::ParseOps(borrowed_fd fd, std::optional<uint64_t> label) {
 }
 
 bool CowParserV2::Translate(TranslatedCowOps* out) {
-    out->ops = std::make_shared<std::vector<CowOperationV3>>(v2_ops_->size());
+    auto ops = std::make_shared<std::vector<CowOperationV3>>(v2_ops_->size());
 
     // Translate the operation buffer from on disk to in memory
-    for (size_t i = 0; i < out->ops->size(); i++) {
+    for (size_t i = 0; i < ops->size(); i++) {
         const auto& v2_op = v2_ops_->at(i);
 
-        auto& new_op = out->ops->at(i);
+        auto& new_op = ops->at(i);
         new_op.set_type(v2_op.type);
         // v2 ops always have 4k compression
         new_op.set_compression_bits(0);
@@ -237,6 +237,7 @@ bool CowParserV2::Translate(TranslatedCowOps* out) {
         new_op.set_source(source_info);
     }
 
+    out->ops = MakeCowOpsView(std::move(ops));
     out->header = header_;
     return true;
 }
@@ -13,8 +13,11 @@
 // limitations under the License.
 #include "parser_v3.h"
 
+#include <sys/mman.h>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/mapped_file.h>
 #include <android-base/strings.h>
 
 #include <libsnapshot/cow_format.h>
@@ -25,7 +28,29 @@ namespace snapshot {
 
 using android::base::borrowed_fd;
 
-bool CowParserV3::Parse(borrowed_fd fd, const CowHeaderV3& header, std::optional<uint64_t> label) {
+// Check that |op| refers to data where the data section says it should be, and
+// advance |data_pos| past any data it stores. |data_start| is where the data
+// section begins.
+static bool AdvanceDataPos(const CowOperationV3& op, uint64_t data_start, uint64_t* data_pos) {
+    if (op.type() == kCowReplaceOp && op.shared_data()) {
+        // Shared data was stored by an earlier op and takes no new space.
+        if (op.source() < data_start || op.source() + op.data_length > *data_pos) {
+            LOG(ERROR) << "Invalid shared data location for operation " << op
+                       << ", data ends at: " << *data_pos;
+            return false;
+        }
+        return true;
+    }
+    if (op.type() == kCowReplaceOp && *data_pos != op.source()) {
+        LOG(ERROR) << "Invalid data location for operation " << op
+                   << ", expected: " << *data_pos;
+        return false;
+    }
+    *data_pos += op.data_length;
+    return true;
+}
+
+bool CowParserV3::ValidateHeader(borrowed_fd fd, const CowHeaderV3& header) {
     auto pos = lseek(fd.get(), 0, SEEK_END);
     if (pos < 0) {
         PLOG(ERROR) << "lseek end failed";
@@ -57,6 +82,13 @@ bool CowParserV3::Parse(borrowed_fd fd, const CowHeaderV3& header, std::optional
                    << ", expected: " << kCowVersionMinor;
         return false;
     }
+    return true;
+}
+
+bool CowParserV3::Parse(borrowed_fd fd, const CowHeaderV3& header, std::optional<uint64_t> label) {
+    if (!ValidateHeader(fd, header)) {
+        return false;
+    }
 
     std::optional<uint32_t> op_index = header_.op_count;
     if (label) {
@@ -74,6 +106,22 @@ bool CowParserV3::Parse(borrowed_fd fd, const CowHeaderV3& header, std::optional
     return ParseOps(fd, op_index.value());
 }
 
+bool CowParserV3::ParseForAppend(borrowed_fd fd, const CowHeaderV3& header, uint64_t label) {
+    if (!ValidateHeader(fd, header)) {
+        return false;
+    }
+    if (!ReadResumeBuffer(fd)) {
+        PLOG(ERROR) << "Failed to read resume buffer";
+        return false;
+    }
+    auto op_index = FindResumeOp(label);
+    if (op_index == std::nullopt) {
+        LOG(ERROR) << "failed to get op index from given label: " << label;
+        return false;
+    }
+    return ScanOps(fd, op_index.value());
+}
+
 bool CowParserV3::ReadResumeBuffer(borrowed_fd fd) {
     resume_points_ = std::make_shared<std::vector<ResumePoint>>(header_.resume_point_count);
 
@@ -95,14 +143,16 @@ std::optional<uint32_t> CowParserV3::FindResumeOp(const uint64_t label) {
 }
 
 bool CowParserV3::ParseOps(borrowed_fd fd, const uint32_t op_index) {
-    ops_ = std::make_shared<std::vector<CowOperationV3>>();
-    ops_->resize(op_index);
-
     // read beginning of operation buffer -> so op_index = 0
     const off_t offset = GetOpOffset(0, header_);
-    if (!android::base::ReadFullyAtOffset(fd, ops_->data(), ops_->size() * sizeof(CowOperationV3),
-                                          offset)) {
-        PLOG(ERROR) << "read ops failed";
+    const size_t size = op_index * sizeof(CowOperationV3);
+    // Mapped pages past the end of the file would fault when touched.
+    if (static_cast<uint64_t>(offset) + size > fd_size_) {
+        LOG(ERROR) << "Op section of " << op_index << " ops at offset " << offset
+                   << " exceeds COW size " << fd_size_;
+        return false;
+    }
+    if (!MapOps(fd, offset, op_index) && !ReadOps(fd, offset, op_index)) {
         return false;
     }
 
@@ -111,24 +161,75 @@ bool CowParserV3::ParseOps(borrowed_fd fd, const uint32_t op_index) {
 
     xor_data_loc_ = std::make_shared<std::unordered_map<uint64_t, uint64_t>>();
 
-    for (auto op : *ops_) {
+    for (const auto& op : ops_) {
         if (op.type() == kCowXorOp) {
             xor_data_loc_->insert({op.new_block, data_pos});
-        } else if (op.type() == kCowReplaceOp) {
-            if (data_pos != op.source()) {
-                LOG(ERROR) << "Invalid data location for operation " << op
-                           << ", expected: " << data_pos;
-                return false;
-            }
         }
-        data_pos += op.data_length;
+        if (!AdvanceDataPos(op, GetDataOffset(header_), &data_pos)) {
+            return false;
+        }
     }
     // :TODO: sequence buffer & resume buffer follow
     // Once we implement labels, we'll have to discard unused ops and adjust
     // the header as needed.
 
-    ops_->shrink_to_fit();
+    return true;
+}
+
+bool CowParserV3::MapOps(borrowed_fd fd, off_t offset, uint32_t op_count) {
+    if (!op_count) {
+        ops_ = {};
+        return true;
+    }
+    // The mapping is shared by every reader cloned from this one, and being
+    // file-backed, the kernel can drop its pages under memory pressure.
+    std::shared_ptr<android::base::MappedFile> mapping = android::base::MappedFile::FromFd(
+            fd, offset, op_count * sizeof(CowOperationV3), PROT_READ);
+    if (!mapping) {
+        PLOG(WARNING) << "mmap of " << op_count << " ops failed, reading them instead";
+        return false;
+    }
+    std::span<const CowOperationV3> ops(
+            reinterpret_cast<const CowOperationV3*>(mapping->data()), op_count);
+    ops_ = CowOpsView{std::move(mapping), ops};
+    return true;
+}
+
+bool CowParserV3::ReadOps(borrowed_fd fd, off_t offset, uint32_t op_count) {
+    auto ops = std::make_shared<std::vector<CowOperationV3>>(op_count);
+    if (!android::base::ReadFullyAtOffset(fd, ops->data(), ops->size() * sizeof(CowOperationV3),
+                                          offset)) {
+        PLOG(ERROR) << "read ops failed";
+        return false;
+    }
+    ops_ = MakeCowOpsView(std::move(ops));
+    return true;
+}
+
+bool CowParserV3::ScanOps(borrowed_fd fd, const uint32_t op_index) {
+    // Only a bounded window of the op section is resident at a time, so
+    // resuming a COW with millions of ops does not need them all in memory.
+    std::vector<CowOperationV3> ops(std::min(op_index, kScanChunkOps));
+    uint64_t data_pos = GetDataOffset(header_);
+
+    for (uint32_t index = 0; index < op_index;) {
+        const size_t count = std::min<size_t>(op_index - index, ops.size());
+        const off_t offset = GetOpOffset(index, header_);
+        if (!android::base::ReadFullyAtOffset(fd, ops.data(), count * sizeof(CowOperationV3),
+                                              offset)) {
+            PLOG(ERROR) << "read ops failed at op index " << index;
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (!AdvanceDataPos(ops[i], GetDataOffset(header_), &data_pos)) {
+                return false;
+            }
+        }
+        index += count;
+    }
 
+    op_count_ = op_index;
+    data_end_ = data_pos;
     return true;
 }
 
@@ -47,13 +47,32 @@ class CowParserV3 final : public CowParserBase {
     bool Translate(TranslatedCowOps* out) override;
     std::shared_ptr<std::vector<ResumePoint>> resume_points() const { return resume_points_; }
 
+    // Used by the writer to resume after |label|. Validates the ops up to the
+    // label and records where their data ends, streaming the op section in
+    // fixed-size chunks instead of loading it. Translate() cannot be used
+    // afterwards.
+    bool ParseForAppend(android::base::borrowed_fd fd, const CowHeaderV3& header, uint64_t label);
+    uint32_t op_count() const { return op_count_; }
+    uint64_t data_end() const { return data_end_; }
+
   private:
+    // 64KiB worth of ops.
+    static constexpr uint32_t kScanChunkOps = 4096;
+
+    bool ValidateHeader(android::base::borrowed_fd fd, const CowHeaderV3& header);
     bool ParseOps(android::base::borrowed_fd fd, const uint32_t op_index);
+    // Map |op_count| ops at |offset| read-only. ReadOps is the fallback for
+    // files that cannot be mapped.
+    bool MapOps(android::base::borrowed_fd fd, off_t offset, uint32_t op_count);
+    bool ReadOps(android::base::borrowed_fd fd, off_t offset, uint32_t op_count);
+    bool ScanOps(android::base::borrowed_fd fd, const uint32_t op_index);
     std::optional<uint32_t> FindResumeOp(const uint64_t label);
     CowHeaderV3 header_ = {};
-    std::shared_ptr<std::vector<CowOperationV3>> ops_;
+    CowOpsView ops_;
     bool ReadResumeBuffer(android::base::borrowed_fd fd);
     std::shared_ptr<std::vector<ResumePoint>> resume_points_;
+    uint32_t op_count_ = 0;
+    uint64_t data_end_ = 0;
 };
 
 }  // namespace snapshot
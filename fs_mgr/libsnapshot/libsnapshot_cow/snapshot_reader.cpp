@@ -16,6 +16,8 @@
 
 #include "snapshot_reader.h"
 
+#include <algorithm>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 
@@ -61,6 +63,142 @@ CompressedSnapshotReader::CompressedSnapshotReader(std::unique_ptr<ICowReader>&&
     }
 }
 
+CompressedSnapshotReader::~CompressedSnapshotReader() {
+    StopReadAhead();
+}
+
+void CompressedSnapshotReader::EnableReadAhead(size_t num_threads, size_t window_blocks) {
+    CHECK(ra_threads_.empty());
+    if (!num_threads || !window_blocks) {
+        return;
+    }
+
+    ra_window_blocks_ = window_blocks;
+    ra_max_windows_ = num_threads * 2;
+    for (size_t i = 0; i < num_threads; i++) {
+        ra_threads_.emplace_back([this]() -> void { ReadAheadThread(); });
+    }
+}
+
+void CompressedSnapshotReader::StopReadAhead() {
+    {
+        std::lock_guard<std::mutex> lock(ra_lock_);
+        ra_stop_ = true;
+        ra_queue_.clear();
+        ra_windows_.clear();
+    }
+    ra_queue_cv_.notify_all();
+    for (auto& thread : ra_threads_) {
+        thread.join();
+    }
+    ra_threads_.clear();
+}
+
+void CompressedSnapshotReader::ReadAheadThread() {
+    while (true) {
+        std::shared_ptr<ReadAheadWindow> window;
+        {
+            std::unique_lock<std::mutex> lock(ra_lock_);
+            ra_queue_cv_.wait(lock, [this]() -> bool { return ra_stop_ || !ra_queue_.empty(); });
+            if (ra_stop_) {
+                return;
+            }
+            window = std::move(ra_queue_.front());
+            ra_queue_.pop_front();
+        }
+
+        // Windows abandoned by a seek are still decoded; the reader has
+        // already dropped them and the memory goes with the last reference.
+        window->data.resize(window->num_blocks * block_size_);
+        int error = 0;
+        for (size_t i = 0; i < window->num_blocks; i++) {
+            uint8_t* block = window->data.data() + i * block_size_;
+            if (ReadBlock(window->start_chunk + i, 0, block, block_size_) < 0) {
+                error = errno ? errno : EIO;
+                break;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(ra_lock_);
+            window->error = error;
+            window->done = true;
+        }
+        ra_done_cv_.notify_all();
+    }
+}
+
+// Returns the window holding |chunk|, waiting for it to be decoded, or
+// nullptr if |chunk| is past the end of the device.
+std::shared_ptr<CompressedSnapshotReader::ReadAheadWindow>
+CompressedSnapshotReader::GetReadAheadWindow(uint64_t chunk) {
+    uint64_t num_chunks = block_device_size_ ? block_device_size_ / block_size_ : ops_.size();
+    if (chunk >= num_chunks) {
+        return nullptr;
+    }
+
+    std::unique_lock<std::mutex> lock(ra_lock_);
+    // Drop the windows the reader has moved past.
+    while (!ra_windows_.empty()) {
+        const auto& front = ra_windows_.front();
+        if (chunk < front->start_chunk + front->num_blocks) {
+            break;
+        }
+        ra_windows_.pop_front();
+    }
+    if (ra_windows_.empty() || chunk < ra_windows_.front()->start_chunk) {
+        // The reader seeked away; start over from here.
+        ra_windows_.clear();
+        ra_queue_.clear();
+        ra_next_chunk_ = chunk;
+    }
+
+    while (ra_windows_.size() < ra_max_windows_ && ra_next_chunk_ < num_chunks) {
+        auto window = std::make_shared<ReadAheadWindow>();
+        window->start_chunk = ra_next_chunk_;
+        window->num_blocks = std::min<uint64_t>(ra_window_blocks_, num_chunks - ra_next_chunk_);
+        ra_next_chunk_ += window->num_blocks;
+        ra_windows_.emplace_back(window);
+        ra_queue_.emplace_back(std::move(window));
+        ra_queue_cv_.notify_one();
+    }
+
+    auto window = ra_windows_.front();
+    ra_done_cv_.wait(lock, [&]() -> bool { return window->done; });
+    return window;
+}
+
+ssize_t CompressedSnapshotReader::ReadAhead(void* buf, size_t count) {
+    uint8_t* buf_pos = reinterpret_cast<uint8_t*>(buf);
+    size_t buf_remaining = count;
+    while (buf_remaining) {
+        uint64_t chunk = offset_ / block_size_;
+        size_t start_offset = offset_ % block_size_;
+        size_t bytes = std::min(block_size_ - start_offset, buf_remaining);
+
+        auto window = GetReadAheadWindow(chunk);
+        if (!window) {
+            // Past the end of the device, which ReadBlock() handles.
+            ssize_t rv = ReadBlock(chunk, start_offset, buf_pos, bytes);
+            if (rv < 0) {
+                return -1;
+            }
+        } else if (window->error) {
+            errno = window->error;
+            return -1;
+        } else {
+            size_t window_offset = (chunk - window->start_chunk) * block_size_ + start_offset;
+            memcpy(buf_pos, window->data.data() + window_offset, bytes);
+        }
+        offset_ += bytes;
+        buf_pos += bytes;
+        buf_remaining -= bytes;
+    }
+
+    errno = 0;
+    return count;
+}
+
 // Not supported.
 bool CompressedSnapshotReader::Open(const char*, int, mode_t) {
     errno = EINVAL;
@@ -83,6 +221,8 @@ bool CompressedSnapshotReader::BlkIoctl(int, uint64_t, uint64_t, int*) {
 }
 
 borrowed_fd CompressedSnapshotReader::GetSourceFd() {
+    // Read-ahead threads may race to open the source device.
+    std::lock_guard<std::mutex> lock(source_fd_lock_);
     if (source_fd_ < 0) {
         if (!source_device_) {
             LOG(ERROR) << "CompressedSnapshotReader needs source device, but none was set";
@@ -99,6 +239,10 @@ borrowed_fd CompressedSnapshotReader::GetSourceFd() {
 }
 
 ssize_t CompressedSnapshotReader::Read(void* buf, size_t count) {
+    if (!ra_threads_.empty()) {
+        return ReadAhead(buf, count);
+    }
+
     // Find the start and end chunks, inclusive.
     uint64_t start_chunk = offset_ / block_size_;
     uint64_t end_chunk = (offset_ + count - 1) / block_size_;
@@ -261,6 +405,7 @@ uint64_t CompressedSnapshotReader::BlockDevSize() {
 }
 
 bool CompressedSnapshotReader::Close() {
+    StopReadAhead();
     cow_ = nullptr;
     source_fd_ = {};
     return true;
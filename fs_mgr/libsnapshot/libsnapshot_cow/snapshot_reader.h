@@ -16,7 +16,12 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
@@ -31,6 +36,14 @@ class CompressedSnapshotReader : public chromeos_update_engine::FileDescriptor {
     CompressedSnapshotReader(std::unique_ptr<ICowReader>&& cow,
                              const std::optional<std::string>& source_device,
                              std::optional<uint64_t> block_dev_size);
+    ~CompressedSnapshotReader() override;
+
+    // Decode windows of |window_blocks| blocks ahead of the read position
+    // on |num_threads| threads, keeping up to two windows per thread in
+    // memory. Read() returns the same data as without read-ahead; windows
+    // are discarded when a Seek() leaves them. Must be called before the
+    // first Read().
+    void EnableReadAhead(size_t num_threads, size_t window_blocks = kReadAheadWindowBlocks);
 
     bool Open(const char* path, int flags, mode_t mode) override;
     bool Open(const char* path, int flags) override;
@@ -44,8 +57,24 @@ class CompressedSnapshotReader : public chromeos_update_engine::FileDescriptor {
     bool IsOpen() override;
     bool Flush() override;
 
+    static constexpr size_t kReadAheadWindowBlocks = 64;
+
   private:
+    // A run of blocks decoded by a read-ahead thread.
+    struct ReadAheadWindow {
+        uint64_t start_chunk;
+        size_t num_blocks;
+        std::vector<uint8_t> data;
+        bool done = false;
+        // errno of the failed block, if any.
+        int error = 0;
+    };
+
     ssize_t ReadBlock(uint64_t chunk, size_t start_offset, void* buffer, size_t size);
+    ssize_t ReadAhead(void* buf, size_t count);
+    std::shared_ptr<ReadAheadWindow> GetReadAheadWindow(uint64_t chunk);
+    void ReadAheadThread();
+    void StopReadAhead();
     android::base::borrowed_fd GetSourceFd();
 
     std::unique_ptr<ICowReader> cow_;
@@ -53,11 +82,26 @@ class CompressedSnapshotReader : public chromeos_update_engine::FileDescriptor {
     uint32_t block_size_ = 0;
 
     std::optional<std::string> source_device_;
+    std::mutex source_fd_lock_;
     android::base::unique_fd source_fd_;
     uint64_t block_device_size_ = 0;
     off64_t offset_ = 0;
 
     std::vector<const CowOperation*> ops_;
+
+    // Read-ahead state. |ra_windows_| holds the windows from the read
+    // position onwards, in order; |ra_queue_| those not picked up by a
+    // thread yet.
+    std::mutex ra_lock_;
+    std::condition_variable ra_queue_cv_;
+    std::condition_variable ra_done_cv_;
+    std::vector<std::thread> ra_threads_;
+    std::deque<std::shared_ptr<ReadAheadWindow>> ra_windows_;
+    std::deque<std::shared_ptr<ReadAheadWindow>> ra_queue_;
+    size_t ra_window_blocks_ = 0;
+    size_t ra_max_windows_ = 0;
+    uint64_t ra_next_chunk_ = 0;
+    bool ra_stop_ = false;
 };
 
 }  // namespace snapshot
@@ -189,5 +189,43 @@ TEST_F(OfflineSnapshotTest, CompressedSnapshot) {
     ASSERT_NO_FATAL_FAILURE(TestReads(writer.get()));
 }
 
+TEST_F(OfflineSnapshotTest, CompressedSnapshotReadAhead) {
+    CowOptions options;
+    options.compression = "gz";
+    options.max_blocks = {kBlockCount};
+    options.scratch_space = false;
+    options.num_read_ahead_threads = 4;
+
+    unique_fd cow_fd(dup(cow_->fd));
+    ASSERT_GE(cow_fd, 0);
+
+    auto writer = CreateCowWriter(2, options, std::move(cow_fd));
+    ASSERT_NO_FATAL_FAILURE(WriteCow(writer.get()));
+    ASSERT_NO_FATAL_FAILURE(TestReads(writer.get()));
+
+    // A sequential scan must match blocks read back-to-front, which restarts
+    // read-ahead on every seek.
+    auto seeker = writer->OpenFileDescriptor(base_->path);
+    ASSERT_NE(seeker, nullptr);
+    auto reader = writer->OpenFileDescriptor(base_->path);
+    ASSERT_NE(reader, nullptr);
+
+    std::string expected(kBlockSize * kBlockCount, 0);
+    for (size_t i = kBlockCount; i > 0; i--) {
+        off64_t offset = (i - 1) * kBlockSize;
+        ASSERT_EQ(seeker->Seek(offset, SEEK_SET), offset);
+        ASSERT_EQ(seeker->Read(expected.data() + offset, kBlockSize), kBlockSize);
+    }
+
+    std::string actual;
+    std::string chunk(kBlockSize / 2, 0);
+    while (actual.size() < expected.size()) {
+        auto rv = reader->Read(chunk.data(), chunk.size());
+        ASSERT_GT(rv, 0);
+        actual.append(chunk.data(), rv);
+    }
+    ASSERT_EQ(actual, expected);
+}
+
 }  // namespace snapshot
 }  // namespace android
@@ -486,6 +486,41 @@ TEST_F(CowTestV3, AllOpsWithCompression) {
     ASSERT_EQ(sink, data);
 }
 
+TEST_F(CowTestV3, ReadDataParallel) {
+    CowOptions options;
+    options.compression = "lz4";
+    options.op_count_max = 100;
+    auto writer = CreateCowWriter(3, options, GetCowFd());
+
+    std::string data;
+    data.resize(options.block_size * 32);
+    for (int i = 0; i < data.size(); i++) {
+        data[i] = char(rand() % 4);
+    }
+
+    ASSERT_TRUE(writer->AddRawBlocks(10, data.data(), data.size()));
+    ASSERT_TRUE(writer->Finalize());
+
+    CowReader reader;
+    ASSERT_TRUE(reader.Parse(cow_->fd));
+
+    std::string sink(data.size(), '\0');
+    std::vector<CowReadRequest> requests;
+    for (auto iter = reader.GetOpIter(); !iter->AtEnd(); iter->Next()) {
+        auto op = iter->Get();
+        ASSERT_EQ(op->type(), kCowReplaceOp);
+        void* buffer = sink.data() + (op->new_block - 10) * options.block_size;
+        requests.push_back({op, buffer, options.block_size});
+    }
+    ASSERT_EQ(requests.size(), 32);
+
+    ASSERT_TRUE(reader.ReadDataParallel(&requests, 4));
+    for (const auto& request : requests) {
+        ASSERT_EQ(request.result, options.block_size);
+    }
+    ASSERT_EQ(sink, data);
+}
+
 TEST_F(CowTestV3, GzCompression) {
     CowOptions options;
     options.op_count_max = 100;
@@ -523,6 +558,112 @@ TEST_F(CowTestV3, GzCompression) {
     ASSERT_TRUE(iter->AtEnd());
 }
 
+TEST_F(CowTestV3, ZstdDictionary) {
+    CowOptions options;
+    options.op_count_max = 100;
+    options.compression = "zstd";
+
+    // Incompressible on its own, but the first half is covered by the
+    // dictionary.
+    std::string data(options.block_size, '\0');
+    uint32_t seed = 1;
+    for (auto& c : data) {
+        seed = seed * 1103515245 + 12345;
+        c = static_cast<char>(seed >> 16);
+    }
+    options.compression_dictionary = data.substr(0, data.size() / 2);
+
+    auto writer = CreateCowWriter(3, options, GetCowFd());
+    ASSERT_NE(writer, nullptr);
+    ASSERT_TRUE(writer->AddRawBlocks(50, data.data(), data.size()));
+    ASSERT_TRUE(writer->Finalize());
+
+    CowReader reader;
+    ASSERT_TRUE(reader.Parse(cow_->fd));
+
+    const auto& header = reader.header_v3();
+    ASSERT_EQ(header.prefix.header_size, sizeof(CowHeaderV3));
+    ASSERT_EQ(header.dictionary_size, options.compression_dictionary.size());
+
+    auto iter = reader.GetOpIter();
+    ASSERT_NE(iter, nullptr);
+    ASSERT_FALSE(iter->AtEnd());
+    auto op = iter->Get();
+    ASSERT_EQ(op->type(), kCowReplaceOp);
+    ASSERT_LT(op->data_length, options.block_size);
+
+    std::string sink(data.size(), '\0');
+    ASSERT_TRUE(ReadData(reader, op, sink.data(), sink.size()));
+    ASSERT_EQ(sink, data);
+}
+
+TEST_F(CowTestV3, DictionaryRequiresZstd) {
+    CowOptions options;
+    options.op_count_max = 100;
+    options.compression = "gz";
+    options.compression_dictionary = "dictionary";
+
+    CowWriterV3 writer(options, GetCowFd());
+    ASSERT_FALSE(writer.Initialize());
+}
+
+TEST_F(CowTestV3, NoDictionaryHeaderSize) {
+    CowOptions options;
+    options.op_count_max = 100;
+    auto writer = CreateCowWriter(3, options, GetCowFd());
+    ASSERT_TRUE(writer->Finalize());
+
+    CowReader reader;
+    ASSERT_TRUE(reader.Parse(cow_->fd));
+    ASSERT_EQ(reader.header_v3().prefix.header_size, kCowHeaderV3BaseSize);
+    ASSERT_EQ(reader.header_v3().dictionary_size, 0);
+}
+
+TEST_F(CowTestV3, DedupReplaceBlocks) {
+    CowOptions options;
+    options.op_count_max = 100;
+    options.dedup_blocks = true;
+    auto writer = CreateCowWriter(3, options, GetCowFd());
+
+    std::string a(options.block_size, 'a');
+    std::string b(options.block_size, 'b');
+
+    ASSERT_TRUE(writer->AddRawBlocks(0, a.data(), a.size()));
+    ASSERT_TRUE(writer->AddRawBlocks(1, b.data(), b.size()));
+    // Matched against data that is still cached.
+    ASSERT_TRUE(writer->AddRawBlocks(2, a.data(), a.size()));
+    // The label flushes, so this is matched against data already on disk.
+    ASSERT_TRUE(writer->AddLabel(1));
+    ASSERT_TRUE(writer->AddRawBlocks(3, b.data(), b.size()));
+    ASSERT_TRUE(writer->Finalize());
+
+    CowReader reader;
+    ASSERT_TRUE(reader.Parse(cow_->fd));
+    ASSERT_EQ(reader.header_v3().op_count, 4);
+
+    std::vector<CowOperation> ops;
+    for (auto iter = reader.GetOpIter(); !iter->AtEnd(); iter->Next()) {
+        ops.emplace_back(*iter->Get());
+    }
+    ASSERT_EQ(ops.size(), 4);
+    ASSERT_FALSE(ops[0].shared_data());
+    ASSERT_FALSE(ops[1].shared_data());
+    ASSERT_TRUE(ops[2].shared_data());
+    ASSERT_TRUE(ops[3].shared_data());
+    ASSERT_EQ(ops[2].source(), ops[0].source());
+    ASSERT_EQ(ops[3].source(), ops[1].source());
+
+    std::string sink(options.block_size, '\0');
+    for (size_t i = 0; i < ops.size(); i++) {
+        ASSERT_TRUE(ReadData(reader, &ops[i], sink.data(), sink.size()));
+        ASSERT_EQ(sink, (i % 2) ? b : a);
+    }
+
+    // Only two blocks of data were stored.
+    ASSERT_EQ(writer->GetCowSizeInfo().cow_size,
+              GetDataOffset(reader.header_v3()) + 2 * options.block_size);
+}
+
 TEST_F(CowTestV3, ResumePointTest) {
     CowOptions options;
     options.op_count_max = 100;
@@ -548,6 +689,52 @@ TEST_F(CowTestV3, ResumePointTest) {
     ASSERT_EQ(header.op_count, 15);
 }
 
+TEST_F(CowTestV3, ResumeManyOps) {
+    CowOptions options;
+    options.op_count_max = 10000;
+    auto writer = CreateCowWriter(3, options, GetCowFd());
+
+    // Enough ops before the label that resuming has to scan the op section
+    // in more than one chunk.
+    constexpr size_t kNumBlocks = 5000;
+    std::string data(options.block_size, '\0');
+    for (size_t i = 0; i < kNumBlocks; i++) {
+        data[0] = static_cast<char>(i);
+        if (i % 2) {
+            ASSERT_TRUE(writer->AddZeroBlocks(i, 1));
+        } else {
+            ASSERT_TRUE(writer->AddRawBlocks(i, data.data(), data.size()));
+        }
+    }
+    ASSERT_TRUE(writer->AddLabel(1));
+    ASSERT_TRUE(writer->AddRawBlocks(kNumBlocks, data.data(), data.size()));
+    ASSERT_TRUE(writer->Finalize());
+
+    CowWriterV3 second_writer(options, GetCowFd());
+    ASSERT_TRUE(second_writer.Initialize(1));
+    data.assign(options.block_size, 'x');
+    ASSERT_TRUE(second_writer.AddRawBlocks(kNumBlocks + 1, data.data(), data.size()));
+    ASSERT_TRUE(second_writer.Finalize());
+
+    CowReader reader;
+    ASSERT_TRUE(reader.Parse(cow_->fd));
+    ASSERT_EQ(reader.header_v3().op_count, kNumBlocks + 1);
+
+    auto iter = reader.GetOpIter();
+    ASSERT_NE(iter, nullptr);
+    const CowOperation* op = nullptr;
+    for (; !iter->AtEnd(); iter->Next()) {
+        op = iter->Get();
+    }
+    ASSERT_NE(op, nullptr);
+    ASSERT_EQ(op->type(), kCowReplaceOp);
+    ASSERT_EQ(op->new_block, kNumBlocks + 1);
+
+    std::string sink(data.size(), '\0');
+    ASSERT_TRUE(ReadData(reader, op, sink.data(), sink.size()));
+    ASSERT_EQ(sink, data);
+}
+
 TEST_F(CowTestV3, BufferMetadataSyncTest) {
     CowOptions options;
     options.op_count_max = 100;
@@ -779,6 +966,152 @@ TEST_F(CowTestV3, CheckOpCount) {
     ASSERT_FALSE(writer->AddZeroBlocks(0, 19));
 }
 
+TEST_F(CowTestV3, PipelinedBatchWrites) {
+    CowOptions options;
+    options.op_count_max = 1000;
+    options.batch_write = true;
+    options.cluster_ops = 4;
+    options.compression = "gz";
+    auto writer = CreateCowWriter(3, options, GetCowFd());
+
+    // Small batches so that many flushes are queued behind the flush thread.
+    constexpr size_t kNumBlocks = 300;
+    std::string data(options.block_size, '\0');
+    for (size_t i = 0; i < kNumBlocks; i++) {
+        data.assign(options.block_size, static_cast<char>('A' + i % 26));
+        ASSERT_TRUE(writer->AddRawBlocks(i, data.data(), data.size()));
+        if (i == kNumBlocks / 2) {
+            ASSERT_TRUE(writer->AddLabel(1));
+        }
+    }
+    ASSERT_TRUE(writer->Finalize());
+
+    CowReader reader;
+    ASSERT_TRUE(reader.Parse(cow_->fd));
+    ASSERT_EQ(reader.header_v3().op_count, kNumBlocks);
+
+    auto iter = reader.GetOpIter();
+    ASSERT_NE(iter, nullptr);
+    std::string sink(options.block_size, '\0');
+    for (size_t i = 0; i < kNumBlocks; i++, iter->Next()) {
+        ASSERT_FALSE(iter->AtEnd());
+        auto op = iter->Get();
+        ASSERT_EQ(op->type(), kCowReplaceOp);
+        ASSERT_EQ(op->new_block, i);
+        ASSERT_TRUE(ReadData(reader, op, sink.data(), sink.size()));
+        ASSERT_EQ(sink, std::string(options.block_size, static_cast<char>('A' + i % 26)));
+    }
+    ASSERT_TRUE(iter->AtEnd());
+}
+
+TEST_F(CowTestV3, MergeReaderOps) {
+    CowOptions options;
+    options.op_count_max = 100;
+    auto writer = CreateCowWriter(3, options, GetCowFd());
+
+    uint32_t sequence[] = {20, 21};
+    ASSERT_TRUE(writer->AddSequenceData(2, sequence));
+    ASSERT_TRUE(writer->AddCopy(20, 10));
+    ASSERT_TRUE(writer->AddCopy(21, 11));
+    ASSERT_TRUE(writer->AddLabel(1));
+    std::string data(options.block_size, 'x');
+    ASSERT_TRUE(writer->AddRawBlocks(5, data.data(), data.size()));
+    ASSERT_TRUE(writer->AddZeroBlocks(3, 1));
+    ASSERT_TRUE(writer->Finalize());
+
+    CowReader reader(CowReader::ReaderFlags::USERSPACE_MERGE);
+    ASSERT_TRUE(reader.Parse(cow_->fd));
+    std::vector<uint32_t> expected;
+    for (auto iter = reader.GetMergeOpIter(); !iter->AtEnd(); iter->Next()) {
+        expected.emplace_back(iter->Get()->new_block);
+    }
+    ASSERT_EQ(expected, (std::vector<uint32_t>{20, 21, 3, 5}));
+
+    // A merge reader presents only data ops, in merge order, and shares them
+    // with its clones.
+    CowReader merge_reader(CowReader::ReaderFlags::USERSPACE_MERGE, true);
+    ASSERT_TRUE(merge_reader.Parse(cow_->fd));
+    auto clone = merge_reader.CloneCowReader();
+    for (CowReader* r : {&merge_reader, clone.get()}) {
+        std::vector<uint32_t> blocks;
+        for (auto iter = r->GetOpIter(true); !iter->AtEnd(); iter->Next()) {
+            ASSERT_FALSE(IsMetadataOp(*iter->Get()));
+            blocks.emplace_back(iter->Get()->new_block);
+        }
+        ASSERT_EQ(blocks, expected);
+    }
+
+    auto iter = clone->GetOpIter(true);
+    iter->Next();
+    auto op = iter->Get();
+    ASSERT_EQ(op->type(), kCowCopyOp);
+    ASSERT_EQ(op->source(), 11u);
+    iter->Prev();
+    ASSERT_TRUE(iter->AtBegin());
+}
+
+TEST_F(CowTestV3, RewriteInMergeOrder) {
+    CowOptions options;
+    options.op_count_max = 100;
+    auto writer = CreateCowWriter(3, options, GetCowFd());
+
+    uint32_t sequence[] = {30, 31, 32};
+    ASSERT_TRUE(writer->AddSequenceData(3, sequence));
+    ASSERT_TRUE(writer->AddCopy(30, 10, 2));
+    std::string xor_data(options.block_size, 'x');
+    ASSERT_TRUE(writer->AddXorBlocks(32, xor_data.data(), xor_data.size(), 15, 100));
+    std::string data;
+    for (char c : {'c', 'a', 'b'}) {
+        data.append(options.block_size, c);
+    }
+    ASSERT_TRUE(writer->AddRawBlocks(7, data.data(), options.block_size));
+    ASSERT_TRUE(writer->AddZeroBlocks(8, 1));
+    ASSERT_TRUE(writer->AddRawBlocks(5, data.data() + options.block_size, options.block_size * 2));
+    ASSERT_TRUE(writer->AddZeroBlocks(2, 2));
+    ASSERT_TRUE(writer->Finalize());
+
+    TemporaryFile rewritten;
+    ASSERT_GE(rewritten.fd, 0);
+    ASSERT_TRUE(RewriteCowInMergeOrder(cow_->fd, options, unique_fd{dup(rewritten.fd)}));
+
+    CowReader reader(CowReader::ReaderFlags::USERSPACE_MERGE);
+    ASSERT_TRUE(reader.Parse(rewritten.fd));
+    ASSERT_TRUE(reader.VerifyMergeOps());
+
+    // The COW itself is laid out in merge order, and the replace data follows it.
+    std::vector<uint64_t> blocks;
+    uint64_t last_data = 0;
+    std::string block(options.block_size, '\0');
+    for (auto iter = reader.GetOpIter(); !iter->AtEnd(); iter->Next()) {
+        const auto op = iter->Get();
+        if (IsMetadataOp(*op)) {
+            continue;
+        }
+        blocks.emplace_back(op->new_block);
+        if (op->type() == kCowReplaceOp) {
+            ASSERT_GT(op->source(), last_data);
+            last_data = op->source();
+            ASSERT_TRUE(ReadData(reader, op, block.data(), block.size()));
+            ASSERT_EQ(block, std::string(options.block_size, "abc"[op->new_block - 5]));
+        } else if (op->type() == kCowXorOp) {
+            uint64_t offset;
+            ASSERT_TRUE(reader.GetSourceOffset(op, &offset));
+            ASSERT_EQ(offset, 15 * options.block_size + 100);
+            ASSERT_TRUE(ReadData(reader, op, block.data(), block.size()));
+            ASSERT_EQ(block, xor_data);
+        } else if (op->type() == kCowCopyOp) {
+            ASSERT_EQ(op->source(), op->new_block - 20);
+        }
+    }
+    ASSERT_EQ(blocks, (std::vector<uint64_t>{30, 31, 32, 2, 3, 5, 6, 7, 8}));
+
+    std::vector<uint64_t> merge_blocks;
+    for (auto iter = reader.GetMergeOpIter(); !iter->AtEnd(); iter->Next()) {
+        merge_blocks.emplace_back(iter->Get()->new_block);
+    }
+    ASSERT_EQ(merge_blocks, blocks);
+}
+
 struct TestParam {
     std::string compression;
     int block_size;
@@ -187,8 +187,10 @@ std::unique_ptr<chromeos_update_engine::FileDescriptor> CowWriterBase::OpenFileD
         block_dev_size = {*options_.max_blocks * options_.block_size};
     }
 
-    return std::make_unique<CompressedSnapshotReader>(std::move(reader), source_device,
-                                                      block_dev_size);
+    auto fd = std::make_unique<CompressedSnapshotReader>(std::move(reader), source_device,
+                                                         block_dev_size);
+    fd->EnableReadAhead(options_.num_read_ahead_threads);
+    return fd;
 }
 
 bool CowWriterBase::Sync() {
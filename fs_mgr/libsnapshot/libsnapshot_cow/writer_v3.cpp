@@ -92,7 +92,7 @@ void CowWriterV3::SetupHeaders() {
     header_.prefix.magic = kCowMagicNumber;
     header_.prefix.major_version = 3;
     header_.prefix.minor_version = 0;
-    header_.prefix.header_size = sizeof(CowHeaderV3);
+    header_.prefix.header_size = kCowHeaderV3BaseSize;
     header_.footer_size = 0;
     header_.op_size = sizeof(CowOperationV3);
     header_.block_size = options_.block_size;
@@ -113,6 +113,10 @@ void CowWriterV3::SetupHeaders() {
     header_.op_count_max = 0;
     header_.compression_algorithm = kCowCompressNone;
     header_.max_compression_size = options_.compression_factor;
+    if (!options_.compression_dictionary.empty()) {
+        header_.prefix.header_size = sizeof(CowHeaderV3);
+        header_.dictionary_size = options_.compression_dictionary.size();
+    }
 }
 
 bool CowWriterV3::ParseOptions() {
@@ -159,6 +163,12 @@ bool CowWriterV3::ParseOptions() {
     }
 
     compression_.algorithm = *algorithm;
+    compression_.dictionary = options_.compression_dictionary;
+    if (!compression_.dictionary.empty() && compression_.algorithm != kCowCompressZstd) {
+        LOG(ERROR) << "Compression dictionaries are only supported with zstd, not "
+                   << options_.compression;
+        return false;
+    }
     if (compression_.algorithm != kCowCompressNone) {
         compressor_ = ICompressor::Create(compression_, header_.max_compression_size);
         if (compressor_ == nullptr) {
@@ -174,6 +184,12 @@ bool CowWriterV3::ParseOptions() {
         data_vec_.reserve(batch_size_);
         cached_data_.reserve(batch_size_);
         cached_ops_.reserve(batch_size_ * kNonDataOpBufferSize);
+
+        // With batch writes, flushes go through a dedicated thread so that the
+        // next batch can be compressed while the previous one is written.
+        if (!IsEstimating() && !flush_thread_.joinable()) {
+            flush_thread_ = std::thread([this]() { FlushThread(); });
+        }
     }
 
     if (batch_size_ > 1) {
@@ -191,6 +207,14 @@ bool CowWriterV3::ParseOptions() {
 }
 
 CowWriterV3::~CowWriterV3() {
+    if (flush_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(flush_lock_);
+            stop_flush_thread_ = true;
+        }
+        flush_cv_.notify_all();
+        flush_thread_.join();
+    }
     for (const auto& t : compress_threads_) {
         t->Finalize();
     }
@@ -232,7 +256,7 @@ bool CowWriterV3::OpenForWrite() {
 
     // Headers are not complete, but this ensures the file is at the right
     // position.
-    if (!android::base::WriteFully(fd_, &header_, sizeof(header_))) {
+    if (!android::base::WriteFully(fd_, &header_, header_.prefix.header_size)) {
         PLOG(ERROR) << "write failed";
         return false;
     }
@@ -246,6 +270,13 @@ bool CowWriterV3::OpenForWrite() {
         }
     }
 
+    if (header_.dictionary_size &&
+        !android::base::WriteFullyAtOffset(fd_, options_.compression_dictionary.data(),
+                                           header_.dictionary_size, GetDictionaryOffset(header_))) {
+        PLOG(ERROR) << "writing compression dictionary failed";
+        return false;
+    }
+
     resume_points_ = std::make_shared<std::vector<ResumePoint>>();
 
     if (!Sync()) {
@@ -253,6 +284,7 @@ bool CowWriterV3::OpenForWrite() {
         return false;
     }
     next_data_pos_ = GetDataOffset(header_);
+    written_data_end_ = next_data_pos_;
     return true;
 }
 
@@ -265,24 +297,34 @@ bool CowWriterV3::OpenForAppend(uint64_t label) {
 
     header_ = header_v3;
 
+    // Appended blocks are compressed with the dictionary from |options_|, so it
+    // has to be the one already stored in the COW.
+    std::string dictionary(header_.dictionary_size, '\0');
+    if (!dictionary.empty() &&
+        !android::base::ReadFullyAtOffset(fd_, dictionary.data(), dictionary.size(),
+                                          GetDictionaryOffset(header_))) {
+        PLOG(ERROR) << "reading compression dictionary failed";
+        return false;
+    }
+    if (dictionary != options_.compression_dictionary) {
+        LOG(ERROR) << "Compression dictionary does not match the one in the COW ("
+                   << options_.compression_dictionary.size() << " vs " << dictionary.size()
+                   << " bytes)";
+        return false;
+    }
+
     CHECK(label >= 0);
     CowParserV3 parser;
-    if (!parser.Parse(fd_, header_, label)) {
+    if (!parser.ParseForAppend(fd_, header_, label)) {
         PLOG(ERROR) << "unable to parse with given label: " << label;
         return false;
     }
 
     resume_points_ = parser.resume_points();
     options_.block_size = header_.block_size;
-    next_data_pos_ = GetDataOffset(header_);
-
-    TranslatedCowOps ops;
-    parser.Translate(&ops);
-    header_.op_count = ops.ops->size();
-
-    for (const auto& op : *ops.ops) {
-        next_data_pos_ += op.data_length;
-    }
+    header_.op_count = parser.op_count();
+    next_data_pos_ = parser.data_end();
+    written_data_end_ = next_data_pos_;
 
     return true;
 }
@@ -301,14 +343,6 @@ bool CowWriterV3::CheckOpCount(size_t op_count) {
     return true;
 }
 
-size_t CowWriterV3::CachedDataSize() const {
-    size_t size = 0;
-    for (const auto& i : cached_data_) {
-        size += i.size();
-    }
-    return size;
-}
-
 bool CowWriterV3::EmitCopy(uint64_t new_block, uint64_t old_block, uint64_t num_blocks) {
     if (!CheckOpCount(num_blocks)) {
         return false;
@@ -341,14 +375,13 @@ bool CowWriterV3::NeedsFlush() const {
     // Allow bigger batch sizes for ops without data. A single CowOperationV3
     // struct uses 14 bytes of memory, even if we cache 200 * 16 ops in memory,
     // it's only ~44K.
-    return CachedDataSize() >= batch_size_ * header_.block_size ||
+    return cached_data_size_ >= batch_size_ * header_.block_size ||
            cached_ops_.size() >= batch_size_ * kNonDataOpBufferSize;
 }
 
 bool CowWriterV3::ConstructCowOpCompressedBuffers(uint64_t new_block_start, const void* data,
                                                   uint64_t old_block, uint16_t offset,
                                                   CowOperationType type, size_t blocks_to_write) {
-    size_t compressed_bytes = 0;
     auto&& blocks = CompressBlocks(blocks_to_write, data, type);
     if (blocks.empty()) {
         LOG(ERROR) << "Failed to compress blocks " << new_block_start << ", " << blocks_to_write
@@ -361,24 +394,30 @@ bool CowWriterV3::ConstructCowOpCompressedBuffers(uint64_t new_block_start, cons
     size_t blocks_written = 0;
     for (size_t blk_index = 0; blk_index < blocks.size(); blk_index++) {
         CowOperation& op = cached_ops_.emplace_back();
-        auto& vec = data_vec_.emplace_back();
         CompressedBuffer buffer = std::move(blocks[blk_index]);
-        auto& compressed_data = cached_data_.emplace_back(std::move(buffer.compressed_data));
         op.new_block = new_block_start + blocks_written;
 
         op.set_type(type);
         op.set_compression_bits(std::log2(buffer.compression_factor / header_.block_size));
+        op.data_length = buffer.compressed_data.size();
 
+        const uint64_t data_pos = next_data_pos_ + cached_data_size_;
         if (type == kCowXorOp) {
             op.set_source((old_block + blocks_written) * header_.block_size + offset);
         } else {
-            op.set_source(next_data_pos_ + compressed_bytes);
+            op.set_source(data_pos);
         }
-
-        vec = {.iov_base = compressed_data.data(), .iov_len = compressed_data.size()};
-        op.data_length = vec.iov_len;
-        compressed_bytes += op.data_length;
         blocks_written += (buffer.compression_factor / header_.block_size);
+
+        if (type == kCowReplaceOp && options_.dedup_blocks && !IsEstimating() &&
+            ShareData(buffer.compressed_data, &op)) {
+            continue;
+        }
+
+        auto& compressed_data = cached_data_.emplace_back(std::move(buffer.compressed_data));
+        cached_data_offsets_.emplace_back(data_pos);
+        cached_data_size_ += compressed_data.size();
+        data_vec_.push_back({.iov_base = compressed_data.data(), .iov_len = compressed_data.size()});
     }
     if (blocks_written != blocks_to_write) {
         LOG(ERROR) << "Total compressed blocks: " << blocks_written
@@ -388,6 +427,52 @@ bool CowWriterV3::ConstructCowOpCompressedBuffers(uint64_t new_block_start, cons
     return true;
 }
 
+bool CowWriterV3::ShareData(const std::vector<uint8_t>& data, CowOperationV3* op) {
+    const uint64_t hash = std::hash<std::string_view>{}(
+            std::string_view(reinterpret_cast<const char*>(data.data()), data.size()));
+    const DedupEntry entry = {
+            .source = op->source(),
+            .data_length = op->data_length,
+            .compression_bits = op->compression_bits(),
+    };
+    auto [iter, inserted] = dedup_index_.try_emplace(hash, entry);
+    if (inserted) {
+        return false;
+    }
+    const DedupEntry& stored = iter->second;
+    if (stored.data_length != entry.data_length ||
+        stored.compression_bits != entry.compression_bits || !DataMatches(stored, data)) {
+        return false;
+    }
+    op->set_source(stored.source);
+    op->set_shared_data(true);
+    return true;
+}
+
+// The hash only finds candidates; the bytes are always compared before data is
+// shared. Data in a batch that is in flight on |flush_thread_| cannot be
+// compared yet, so it counts as a miss.
+bool CowWriterV3::DataMatches(const DedupEntry& entry, const std::vector<uint8_t>& data) {
+    if (entry.source >= next_data_pos_) {
+        auto iter = std::lower_bound(cached_data_offsets_.begin(), cached_data_offsets_.end(),
+                                     entry.source);
+        if (iter == cached_data_offsets_.end() || *iter != entry.source) {
+            return false;
+        }
+        return cached_data_[iter - cached_data_offsets_.begin()] == data;
+    }
+    if (entry.source + entry.data_length > written_data_end_) {
+        return false;
+    }
+    std::vector<uint8_t> stored(entry.data_length);
+    if (!android::base::ReadFullyAtOffset(fd_, stored.data(), stored.size(), entry.source)) {
+        PLOG(WARNING) << "Failed to read back " << entry.data_length << " bytes at "
+                      << entry.source << " for deduplication";
+        return false;
+    }
+    return stored == data;
+}
+
 bool CowWriterV3::EmitBlocks(uint64_t new_block_start, const void* data, size_t size,
                              uint64_t old_block, uint16_t offset, CowOperationType type) {
     if (compression_.algorithm != kCowCompressNone && compressor_ == nullptr) {
@@ -439,7 +524,8 @@ bool CowWriterV3::EmitLabel(uint64_t label) {
     // remove all labels greater than this current one. we want to avoid the situation of adding
     // in
     // duplicate labels with differing op values
-    if (!FlushCacheOps()) {
+    // The resume point must not reference ops that are still in flight.
+    if (!FlushCacheOps() || !WaitForFlushes()) {
         LOG(ERROR) << "Failed to flush cached ops before emitting label " << label;
         return false;
     }
@@ -506,17 +592,25 @@ bool CowWriterV3::FlushCacheOps() {
     size_t bytes_written = 0;
 
     for (auto& op : cached_ops_) {
+        if (op.shared_data()) {
+            continue;
+        }
         if (op.type() == kCowReplaceOp) {
             op.set_source(next_data_pos_ + bytes_written);
         }
         bytes_written += op.data_length;
     }
+    if (flush_thread_.joinable()) {
+        return QueueFlush(bytes_written);
+    }
     if (!WriteOperation(cached_ops_, data_vec_)) {
         LOG(ERROR) << "Failed to flush " << cached_ops_.size() << " ops to disk";
         return false;
     }
     cached_ops_.clear();
     cached_data_.clear();
+    cached_data_size_ = 0;
+    cached_data_offsets_.clear();
     data_vec_.clear();
     return true;
 }
@@ -710,21 +804,38 @@ bool CowWriterV3::WriteOperation(std::span<const CowOperationV3> ops,
                    << ops.size() << " ops will exceed the max of " << header_.op_count_max;
         return false;
     }
-    const off_t offset = GetOpOffset(header_.op_count, header_);
-    if (!android::base::WriteFullyAtOffset(fd_, ops.data(), ops.size() * sizeof(ops[0]), offset)) {
-        PLOG(ERROR) << "Write failed for " << ops.size() << " ops at " << offset;
+    if (!WriteBatch(ops, data, GetOpOffset(header_.op_count, header_), next_data_pos_)) {
+        return false;
+    }
+
+    header_.op_count += ops.size();
+    next_data_pos_ += total_data_size;
+    written_data_end_ = next_data_pos_;
+
+    return true;
+}
+
+bool CowWriterV3::WriteBatch(std::span<const CowOperationV3> ops,
+                             std::span<const struct iovec> data, off_t op_offset,
+                             uint64_t data_offset) {
+    if (!android::base::WriteFullyAtOffset(fd_, ops.data(), ops.size() * sizeof(ops[0]),
+                                           op_offset)) {
+        PLOG(ERROR) << "Write failed for " << ops.size() << " ops at " << op_offset;
         return false;
     }
     if (!data.empty()) {
+        const auto total_data_size =
+                std::transform_reduce(data.begin(), data.end(), 0, std::plus<size_t>{},
+                                      [](const struct iovec& a) { return a.iov_len; });
         int total_written = 0;
         int i = 0;
         while (i < data.size()) {
             int chunk = std::min(static_cast<int>(data.size() - i), IOV_MAX);
 
-            const auto ret = pwritev(fd_, data.data() + i, chunk, next_data_pos_ + total_written);
+            const auto ret = pwritev(fd_, data.data() + i, chunk, data_offset + total_written);
             if (ret < 0) {
                 PLOG(ERROR) << "write failed chunk size of: " << chunk
-                            << " at offset: " << next_data_pos_ + total_written << " " << errno;
+                            << " at offset: " << data_offset + total_written << " " << errno;
                 return false;
             }
             total_written += ret;
@@ -733,22 +844,100 @@ bool CowWriterV3::WriteOperation(std::span<const CowOperationV3> ops,
         if (total_written != total_data_size) {
             PLOG(ERROR) << "write failed for data vector of size: " << data.size()
                         << " and total data length: " << total_data_size
-                        << " at offset: " << next_data_pos_ << " " << errno
+                        << " at offset: " << data_offset << " " << errno
                         << ", only wrote: " << total_written;
             return false;
         }
     }
+    return true;
+}
 
-    header_.op_count += ops.size();
-    next_data_pos_ += total_data_size;
+bool CowWriterV3::QueueFlush(size_t data_size) {
+    if (header_.op_count + cached_ops_.size() > header_.op_count_max) {
+        LOG(ERROR) << "Current op count " << header_.op_count << ", attempting to write "
+                   << cached_ops_.size() << " ops will exceed the max of "
+                   << header_.op_count_max;
+        return false;
+    }
+
+    // Offsets are assigned here rather than on the flush thread, so the next
+    // batch can be built against the final layout while this one is written.
+    PendingFlush flush;
+    flush.op_offset = GetOpOffset(header_.op_count, header_);
+    flush.data_offset = next_data_pos_;
+    flush.data_size = data_size;
+    flush.ops = std::move(cached_ops_);
+    flush.data = std::move(cached_data_);
+    flush.data_vec = std::move(data_vec_);
+
+    header_.op_count += flush.ops.size();
+    next_data_pos_ += data_size;
+
+    {
+        std::unique_lock<std::mutex> lock(flush_lock_);
+        flush_cv_.wait(lock, [this]() -> bool {
+            return pending_flushes_.size() < kMaxPendingFlushes || flush_failed_;
+        });
+        if (flush_failed_) {
+            LOG(ERROR) << "A previous batch failed to write, dropping " << flush.ops.size()
+                       << " ops";
+            return false;
+        }
+        pending_flushes_.emplace_back(std::move(flush));
+    }
+    flush_cv_.notify_all();
 
+    cached_ops_.clear();
+    cached_data_.clear();
+    cached_data_size_ = 0;
+    cached_data_offsets_.clear();
+    data_vec_.clear();
+    cached_ops_.reserve(batch_size_ * kNonDataOpBufferSize);
+    cached_data_.reserve(batch_size_);
+    data_vec_.reserve(batch_size_);
     return true;
 }
 
+void CowWriterV3::FlushThread() {
+    std::unique_lock<std::mutex> lock(flush_lock_);
+    while (true) {
+        flush_cv_.wait(lock, [this]() -> bool {
+            return !pending_flushes_.empty() || stop_flush_thread_;
+        });
+        if (pending_flushes_.empty()) {
+            return;
+        }
+        // The batch stays queued while it is written, so it still counts
+        // against kMaxPendingFlushes. References into the deque are stable
+        // across emplace_back.
+        const PendingFlush& flush = pending_flushes_.front();
+        lock.unlock();
+        bool ok = WriteBatch(flush.ops, flush.data_vec, flush.op_offset, flush.data_offset);
+        lock.lock();
+        if (ok) {
+            written_data_end_ = flush.data_offset + flush.data_size;
+        } else {
+            LOG(ERROR) << "Failed to flush " << flush.ops.size() << " ops to disk";
+            flush_failed_ = true;
+        }
+        pending_flushes_.pop_front();
+        flush_cv_.notify_all();
+    }
+}
+
+bool CowWriterV3::WaitForFlushes() {
+    if (!flush_thread_.joinable()) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(flush_lock_);
+    flush_cv_.wait(lock, [this]() -> bool { return pending_flushes_.empty(); });
+    return !flush_failed_;
+}
+
 bool CowWriterV3::Finalize() {
-    CHECK_GE(header_.prefix.header_size, sizeof(CowHeaderV3));
+    CHECK_GE(header_.prefix.header_size, kCowHeaderV3BaseSize);
     CHECK_LE(header_.prefix.header_size, sizeof(header_));
-    if (!FlushCacheOps()) {
+    if (!FlushCacheOps() || !WaitForFlushes()) {
         return false;
     }
     if (!android::base::WriteFullyAtOffset(fd_, &header_, header_.prefix.header_size, 0)) {
@@ -14,10 +14,17 @@
 
 #pragma once
 
+#include <sys/uio.h>
+
 #include <android-base/logging.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <span>
 #include <string_view>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <libsnapshot/cow_format.h>
@@ -31,6 +38,9 @@ using namespace android::storage_literals;
 // This is a multiple on top of the number of data ops that can be stored in our cache at once. This
 // is added so that we can cache more non-data ops as it takes up less space.
 static constexpr uint32_t kNonDataOpBufferSize = 16;
+// Number of flushed batches that may be queued for writing at once, including
+// the one being written. Bounds the memory used by pipelined writes.
+static constexpr size_t kMaxPendingFlushes = 2;
 
 class CowWriterV3 : public CowWriterBase {
   public:
@@ -55,18 +65,38 @@ class CowWriterV3 : public CowWriterBase {
         size_t compression_factor;
         std::vector<uint8_t> compressed_data;
     };
+    // A batch of ops and data handed off to |flush_thread_|, along with the
+    // offsets it was assigned when it was queued.
+    struct PendingFlush {
+        std::vector<CowOperationV3> ops;
+        std::vector<std::vector<uint8_t>> data;
+        std::vector<struct iovec> data_vec;
+        off_t op_offset;
+        uint64_t data_offset;
+        size_t data_size;
+    };
+    // Data already stored for a replace op, indexed by a hash of its contents.
+    struct DedupEntry {
+        uint64_t source;
+        uint32_t data_length;
+        uint8_t compression_bits;
+    };
     void SetupHeaders();
     bool NeedsFlush() const;
     bool ParseOptions();
     bool OpenForWrite();
     bool OpenForAppend(uint64_t label);
     bool WriteOperation(std::span<const CowOperationV3> op, std::span<const struct iovec> data);
+    bool WriteBatch(std::span<const CowOperationV3> ops, std::span<const struct iovec> data,
+                    off_t op_offset, uint64_t data_offset);
     bool EmitBlocks(uint64_t new_block_start, const void* data, size_t size, uint64_t old_block,
                     uint16_t offset, CowOperationType type);
     bool ConstructCowOpCompressedBuffers(uint64_t new_block_start, const void* data,
                                          uint64_t old_block, uint16_t offset, CowOperationType type,
                                          size_t blocks_to_write);
     bool CheckOpCount(size_t op_count);
+    bool ShareData(const std::vector<uint8_t>& data, CowOperationV3* op);
+    bool DataMatches(const DedupEntry& entry, const std::vector<uint8_t>& data);
 
   private:
     std::vector<CompressedBuffer> ProcessBlocksWithNoCompression(const size_t num_blocks,
@@ -94,9 +124,11 @@ class CowWriterV3 : public CowWriterBase {
         }
         return false;
     }
-    size_t CachedDataSize() const;
     bool ReadBackVerification();
     bool FlushCacheOps();
+    bool QueueFlush(size_t data_size);
+    void FlushThread();
+    bool WaitForFlushes();
     void InitWorkers();
     CowHeaderV3 header_{};
     CowCompression compression_;
@@ -115,9 +147,25 @@ class CowWriterV3 : public CowWriterBase {
     size_t batch_size_ = 1;
     std::vector<CowOperationV3> cached_ops_;
     std::vector<std::vector<uint8_t>> cached_data_;
+    // Sum of the sizes in |cached_data_|, so NeedsFlush() stays O(1).
+    size_t cached_data_size_ = 0;
+    // Data section offset of each entry in |cached_data_|.
+    std::vector<uint64_t> cached_data_offsets_;
     std::vector<struct iovec> data_vec_;
 
+    std::unordered_map<uint64_t, DedupEntry> dedup_index_;
+    // Data before this offset is known to be on disk. Batches queued on
+    // |flush_thread_| lie between this and |next_data_pos_|.
+    std::atomic<uint64_t> written_data_end_ = 0;
+
     std::vector<std::thread> threads_;
+
+    std::thread flush_thread_;
+    std::mutex flush_lock_;
+    std::condition_variable flush_cv_;
+    std::deque<PendingFlush> pending_flushes_;
+    bool flush_failed_ = false;
+    bool stop_flush_thread_ = false;
 };
 
 }  // namespace snapshot
@@ -155,7 +155,7 @@ bool WriteExtent(DmSnapCowSizeCalculator* sc, const chromeos_update_engine::Exte
     return true;
 }
 
-std::optional<uint64_t> PartitionCowCreator::GetCowSize() {
+std::optional<uint64_t> PartitionCowCreator::GetCowSize() const {
     if (using_snapuserd) {
         if (update == nullptr || !update->has_estimate_cow_size()) {
             LOG(ERROR) << "Update manifest does not include a COW size";
@@ -251,7 +251,7 @@ std::optional<PartitionCowCreator::Return> PartitionCowCreator::Run() {
     free_region_length *= kSectorSize;
 
     LOG(INFO) << "Remaining free space for COW: " << free_region_length << " bytes";
-    auto cow_size = GetCowSize();
+    auto cow_size = this->cow_size ? this->cow_size : GetCowSize();
     if (!cow_size) {
         return {};
     }
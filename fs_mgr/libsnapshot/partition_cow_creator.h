@@ -71,6 +71,10 @@ struct PartitionCowCreator {
     // True if COW writes should be batched in memory
     bool batched_writes;
 
+    // COW size for |target_partition|, if it was computed ahead of Run() with
+    // GetCowSize(). Otherwise Run() computes it.
+    std::optional<uint64_t> cow_size;
+
     struct Return {
         SnapshotStatus snapshot_status;
         std::vector<Interval> cow_partition_usable_regions;
@@ -78,9 +82,12 @@ struct PartitionCowCreator {
 
     std::optional<Return> Run();
 
+    // Compute the COW size for |target_partition|. This only reads the
+    // metadata, so creators for different partitions may call it concurrently.
+    std::optional<uint64_t> GetCowSize() const;
+
   private:
     bool HasExtent(Partition* p, Extent* e);
-    std::optional<uint64_t> GetCowSize();
 };
 
 }  // namespace snapshot
@@ -21,14 +21,17 @@
 #include <sys/types.h>
 #include <sys/unistd.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <optional>
 #include <thread>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
 #include <android-base/properties.h>
+#include <android-base/scopeguard.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
@@ -103,6 +106,11 @@ static constexpr auto kUpdateStateCheckInterval = 2s;
  */
 static constexpr auto kReadAheadSizeKb = 32;
 
+// Upper bound on the threads used by CreateUpdateSnapshots when parallel
+// snapshot creation is enabled. Image creation is bound by /data and
+// /metadata I/O, so more threads than this do not help.
+static constexpr size_t kMaxSnapshotCreationThreads = 4;
+
 // Note: IImageManager is an incomplete type in the header, so the default
 // destructor doesn't work.
 SnapshotManager::~SnapshotManager() {}
@@ -324,6 +332,18 @@ bool SnapshotManager::RemoveAllUpdateState(LockedFile* lock, const std::function
         RemoveFileIfExists(file);
     }
 
+    // Partition verification progress and boot profiles recorded by
+    // snapuserd for this update.
+    std::error_code ec;
+    std::filesystem::remove_all(metadata_dir_ + "/" + kVerifyCheckpointDir, ec);
+    if (ec) {
+        LOG(WARNING) << "Failed to remove verification checkpoints: " << ec.message();
+    }
+    std::filesystem::remove_all(metadata_dir_ + "/" + kBootProfileDir, ec);
+    if (ec) {
+        LOG(WARNING) << "Failed to remove snapuserd boot profiles: " << ec.message();
+    }
+
     // If this fails, we'll keep trying to remove the update state (as the
     // device reboots or starts a new update) until it finally succeeds.
     return WriteUpdateState(lock, UpdateState::None);
@@ -567,6 +587,16 @@ bool SnapshotManager::MapDmUserCow(LockedFile* lock, const std::string& name,
     }
 
     if (UpdateUsesUserSnapshots(lock)) {
+        // While all partitions are being mapped, let the daemon initialize
+        // the handler in the background; StartPreparedDmUsers() waits for it
+        // and attaches it once every partition is mapped.
+        if (prepared_dm_users_ &&
+            snapuserd_client_->PrepareDmUserCow(misc_name, cow_file, base_device,
+                                                base_path_merge)) {
+            prepared_dm_users_->push_back({misc_name, cow_file, base_device, base_path_merge});
+            return true;
+        }
+
         // Now that the dm-user device is created, initialize the daemon and
         // spin up the worker threads.
         if (!snapuserd_client_->InitDmUserCow(misc_name, cow_file, base_device, base_path_merge)) {
@@ -678,6 +708,15 @@ std::optional<std::string> SnapshotManager::MapCowImage(
     if (!EnsureImageManager()) return std::nullopt;
     auto cow_image_name = GetCowImageDeviceName(name);
 
+    // Reuse the device if MapAllPartitions already mapped it in a batch.
+    if (auto iter = premapped_cow_images_.find(cow_image_name);
+        iter != premapped_cow_images_.end()) {
+        auto cow_dev = std::move(iter->second);
+        premapped_cow_images_.erase(iter);
+        LOG(INFO) << "Using batch-mapped " << cow_image_name << " at " << cow_dev;
+        return cow_dev;
+    }
+
     bool ok;
     std::string cow_dev;
     if (device_->IsRecovery() || device_->IsFirstStageInit()) {
@@ -1097,7 +1136,9 @@ bool SnapshotManager::QuerySnapshotStatus(const std::string& dm_name, std::strin
 // merge each time the device boots. There is no harm in doing so, and if
 // the problem was transient, we might manage to get a new outcome.
 UpdateState SnapshotManager::ProcessUpdateState(const std::function<bool()>& callback,
-                                                const std::function<bool()>& before_cancel) {
+                                                const std::function<bool()>& before_cancel,
+                                                const std::function<void(double)>& progress) {
+    double percentage = 0.0;
     while (true) {
         auto result = CheckMergeState(before_cancel);
         LOG(INFO) << "ProcessUpdateState handling state: " << UpdateStateToStr(result.state);
@@ -1115,10 +1156,27 @@ UpdateState SnapshotManager::ProcessUpdateState(const std::function<bool()>& cal
             return result.state;
         }
 
-        // This wait is not super time sensitive, so we have a relatively
-        // low polling frequency.
-        std::this_thread::sleep_for(kUpdateStateCheckInterval);
+        // snapuserd wakes us up as the merge advances. dm-snapshot merges,
+        // and daemons that cannot report progress, are polled instead; this
+        // wait is not super time sensitive, so we have a relatively low
+        // polling frequency.
+        if (!WaitForMergeProgress(&percentage)) {
+            std::this_thread::sleep_for(kUpdateStateCheckInterval);
+            if (progress) {
+                GetUpdateState(&percentage);
+            }
+        }
+        if (progress) {
+            progress(percentage);
+        }
+    }
+}
+
+bool SnapshotManager::WaitForMergeProgress(double* percentage) {
+    if (!UpdateUsesUserSnapshots() || !EnsureSnapuserdConnected()) {
+        return false;
     }
+    return snapuserd_client_->WaitForMergeProgress(percentage);
 }
 
 auto SnapshotManager::CheckMergeState(const std::function<bool()>& before_cancel) -> MergeResult {
@@ -1310,6 +1368,7 @@ auto SnapshotManager::CheckTargetMergeState(LockedFile* lock, const std::string&
         // Query the snapshot status from the daemon
         const auto merge_status = snapuserd_client_->QuerySnapshotStatus(name);
         if (merge_status == "snapshot-merge-failed") {
+            RecordPartitionMergeStats(name);
             return MergeResult(UpdateState::MergeFailed, MergeFailureCode::UnknownTargetType);
         }
 
@@ -1346,6 +1405,7 @@ auto SnapshotManager::CheckTargetMergeState(LockedFile* lock, const std::string&
             LOG(ERROR) << "Snapshot " << name << " has incorrect status: " << merge_status;
             return MergeResult(UpdateState::MergeFailed, MergeFailureCode::ExpectedMergeTarget);
         }
+        RecordPartitionMergeStats(name);
     } else {
         // dm-snapshot in the kernel
         std::string target_type;
@@ -1899,7 +1959,7 @@ bool SnapshotManager::GetSnapshotFlashingStatus(LockedFile* lock,
     // remove the UPDATED flag on the target slot as well.
     const auto& opener = device_->GetPartitionOpener();
     auto super_device = device_->GetSuperDevice(target_slot);
-    auto metadata = android::fs_mgr::ReadMetadata(opener, super_device, target_slot);
+    auto metadata = android::fs_mgr::ReadMetadataView(opener, super_device, target_slot);
     if (!metadata) {
         return false;
     }
@@ -2313,7 +2373,7 @@ bool SnapshotManager::CreateLogicalAndSnapshotPartitions(
 bool SnapshotManager::MapAllPartitions(LockedFile* lock, const std::string& super_device,
                                        uint32_t slot, const std::chrono::milliseconds& timeout_ms) {
     const auto& opener = device_->GetPartitionOpener();
-    auto metadata = android::fs_mgr::ReadMetadata(opener, super_device, slot);
+    auto metadata = android::fs_mgr::ReadMetadataView(opener, super_device, slot);
     if (!metadata) {
         LOG(ERROR) << "Could not read dynamic partition metadata for device: " << super_device;
         return false;
@@ -2323,6 +2383,28 @@ bool SnapshotManager::MapAllPartitions(LockedFile* lock, const std::string& supe
         return false;
     }
 
+    // In first-stage init and recovery, map every COW image this boot needs
+    // up front, so the image metadata is read once instead of per partition.
+    // Any image left unclaimed by MapCowImage is unmapped again on the way out.
+    if (device_->IsRecovery() || device_->IsFirstStageInit()) {
+        PremapCowImages(lock, *metadata.get());
+    }
+    auto release_premapped = android::base::make_scope_guard([this]() -> void {
+        for (const auto& [name, dev] : premapped_cow_images_) {
+            images_->UnmapImageIfExists(name);
+        }
+        premapped_cow_images_.clear();
+    });
+
+    // Reading the COWs dominates mapping the partitions in first-stage init,
+    // so initialize the snapuserd handlers of all partitions concurrently.
+    std::vector<PreparedDmUser> prepared_dm_users;
+    if (device_->IsFirstStageInit()) {
+        prepared_dm_users_ = &prepared_dm_users;
+    }
+    auto release_prepared = android::base::make_scope_guard(
+            [this]() -> void { prepared_dm_users_ = nullptr; });
+
     for (const auto& partition : metadata->partitions) {
         if (GetPartitionGroupName(metadata->groups[partition.group_index]) == kCowGroupName) {
             LOG(INFO) << "Skip mapping partition " << GetPartitionName(partition) << " in group "
@@ -2342,10 +2424,74 @@ bool SnapshotManager::MapAllPartitions(LockedFile* lock, const std::string& supe
         }
     }
 
+    if (!StartPreparedDmUsers()) {
+        return false;
+    }
+
     LOG(INFO) << "Created logical partitions with snapshot.";
     return true;
 }
 
+bool SnapshotManager::StartPreparedDmUsers() {
+    if (!prepared_dm_users_ || prepared_dm_users_->empty()) {
+        return true;
+    }
+
+    android::base::Timer timer;
+    for (const auto& dm_user : *prepared_dm_users_) {
+        // Returns as soon as this partition's handler is ready, even if
+        // others are still being initialized.
+        if (!snapuserd_client_->InitDmUserCow(dm_user.misc_name, dm_user.cow_file,
+                                              dm_user.base_device, dm_user.base_path_merge)) {
+            LOG(ERROR) << "InitDmUserCow failed for " << dm_user.misc_name;
+            return false;
+        }
+        if (!snapuserd_client_->AttachDmUser(dm_user.misc_name)) {
+            return false;
+        }
+        LOG(INFO) << "Attached " << dm_user.misc_name << " after " << timer;
+    }
+    prepared_dm_users_->clear();
+    return true;
+}
+
+void SnapshotManager::PremapCowImages(LockedFile* lock, const LpMetadata& metadata) {
+    std::vector<std::string> cow_images;
+    for (const auto& partition : metadata.partitions) {
+        if (GetPartitionGroupName(metadata.groups[partition.group_index]) == kCowGroupName) {
+            continue;
+        }
+        // Mirror the live snapshot checks in MapPartitionWithSnapshot. A
+        // mismatch is harmless: MapCowImage falls back to mapping on demand,
+        // and unused images are unmapped by the caller.
+        if (!partition.num_extents) continue;
+        if (!IsSnapshotWithoutSlotSwitch() && !(partition.attributes & LP_PARTITION_ATTR_UPDATED)) {
+            continue;
+        }
+        auto name = GetPartitionName(partition);
+        if (access(GetSnapshotStatusFilePath(name).c_str(), F_OK) != 0) continue;
+
+        SnapshotStatus status;
+        if (!ReadSnapshotStatus(lock, name, &status)) continue;
+        if (status.state() == SnapshotState::NONE ||
+            status.state() == SnapshotState::MERGE_COMPLETED || status.cow_file_size() == 0) {
+            continue;
+        }
+        cow_images.emplace_back(GetCowImageDeviceName(name));
+    }
+
+    // A single image gains nothing from batching.
+    if (cow_images.size() < 2) return;
+
+    std::map<std::string, std::string> devs;
+    if (!images_->MapImagesWithDeviceMapper(device_->GetPartitionOpener(), cow_images, &devs)) {
+        LOG(WARNING) << "Could not map COW images in a batch, mapping them individually";
+        return;
+    }
+    LOG(INFO) << "Mapped " << devs.size() << " COW images in a batch";
+    premapped_cow_images_ = std::move(devs);
+}
+
 static std::chrono::milliseconds GetRemainingTime(
         const std::chrono::milliseconds& timeout,
         const std::chrono::time_point<std::chrono::steady_clock>& begin) {
@@ -2796,7 +2942,7 @@ bool SnapshotManager::MapAllSnapshots(const std::chrono::milliseconds& timeout_m
     auto slot_suffix = device_->GetOtherSlotSuffix();
     auto slot_number = SlotNumberForSlotSuffix(slot_suffix);
     auto super_device = device_->GetSuperDevice(slot_number);
-    auto metadata = android::fs_mgr::ReadMetadata(opener, super_device, slot_number);
+    auto metadata = android::fs_mgr::ReadMetadataView(opener, super_device, slot_number);
     if (!metadata) {
         LOG(ERROR) << "MapAllSnapshots could not read dynamic partition metadata for device: "
                    << super_device;
@@ -3473,9 +3619,60 @@ Return SnapshotManager::CreateUpdateSnapshotsInternal(
         }
     }
 
+    size_t max_threads = 1;
+    if (GetParallelSnapshotCreationProperty()) {
+        max_threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1,
+                                         kMaxSnapshotCreationThreads);
+        LOG(INFO) << "Creating snapshots with up to " << max_threads << " threads";
+    }
+
+    // COW size estimation only reads metadata, so it is done for every
+    // partition up front. Allocating COW partitions in super below cannot be
+    // parallelized, because each one changes the free regions of the next.
+    std::map<std::string, uint64_t> cow_sizes;
+    if (max_threads > 1) {
+        std::vector<PartitionCowCreator> creators;
+        for (auto* target_partition : ListPartitionsWithSuffix(target_metadata, target_suffix)) {
+            auto iter = partition_map.find(target_partition->name());
+            if (iter == partition_map.end() || target_partition->size() == 0) {
+                continue;
+            }
+            auto& creator = creators.emplace_back(*cow_creator);
+            creator.target_partition = target_partition;
+            creator.update = iter->second;
+            creator.extra_extents.clear();
+            auto extra_extents_it = extra_extents_map.find(target_partition->name());
+            if (extra_extents_it != extra_extents_map.end()) {
+                creator.extra_extents = extra_extents_it->second;
+            }
+        }
+
+        std::vector<std::optional<uint64_t>> sizes(creators.size());
+        auto estimate = [&](size_t i) -> bool {
+            sizes[i] = creators[i].GetCowSize();
+            if (!sizes[i]) {
+                LOG(ERROR) << "Cannot compute COW size for "
+                           << creators[i].target_partition->name();
+                return false;
+            }
+            return true;
+        };
+        if (!RunInParallel(creators.size(), max_threads, estimate)) {
+            return Return::Error();
+        }
+        for (size_t i = 0; i < creators.size(); i++) {
+            cow_sizes.emplace(creators[i].target_partition->name(), *sizes[i]);
+        }
+    }
+
     for (auto* target_partition : ListPartitionsWithSuffix(target_metadata, target_suffix)) {
         cow_creator->target_partition = target_partition;
         cow_creator->update = nullptr;
+        cow_creator->cow_size = std::nullopt;
+        if (auto cow_size_it = cow_sizes.find(target_partition->name());
+            cow_size_it != cow_sizes.end()) {
+            cow_creator->cow_size = cow_size_it->second;
+        }
         auto iter = partition_map.find(target_partition->name());
         if (iter != partition_map.end()) {
             cow_creator->update = iter->second;
@@ -3572,17 +3769,37 @@ Return SnapshotManager::CreateUpdateSnapshotsInternal(
 
     LOG(INFO) << "Allocating CoW images.";
 
-    for (auto&& [name, snapshot_status] : *all_snapshot_status) {
+    // CreateCowImage opens the image manager lazily, which must not race.
+    cow_creator->cow_size = std::nullopt;
+    if (max_threads > 1 && !EnsureImageManager()) return Return::Error();
+
+    std::vector<const std::string*> names;
+    for (const auto& [name, snapshot_status] : *all_snapshot_status) {
+        names.emplace_back(&name);
+    }
+    std::vector<Return> results(names.size(), Return::Ok());
+    auto create_image = [&](size_t i) -> bool {
+        const auto& name = *names[i];
         // Create the backing COW image if necessary.
-        if (snapshot_status.cow_file_size() > 0) {
-            auto ret = CreateCowImage(lock, name);
-            if (!ret.is_ok()) {
-                LOG(ERROR) << "CreateCowImage failed: " << ret.string();
-                return AddRequiredSpace(ret, *all_snapshot_status);
+        if (all_snapshot_status->at(name).cow_file_size() > 0) {
+            results[i] = CreateCowImage(lock, name);
+            if (!results[i].is_ok()) {
+                LOG(ERROR) << "CreateCowImage failed: " << results[i].string();
+                return false;
             }
         }
 
         LOG(INFO) << "Successfully created snapshot for " << name;
+        return true;
+    };
+    if (!RunInParallel(names.size(), max_threads, create_image)) {
+        // Images that were created are deleted along with their snapshots by
+        // |created_devices|.
+        for (const auto& ret : results) {
+            if (!ret.is_ok()) {
+                return AddRequiredSpace(ret, *all_snapshot_status);
+            }
+        }
     }
 
     return Return::Ok();
@@ -3756,6 +3973,7 @@ std::unique_ptr<ICowWriter> SnapshotManager::OpenCompressedSnapshotWriter(
     cow_options.max_blocks = {status.device_size() / cow_options.block_size};
     cow_options.batch_write = status.batched_writes();
     cow_options.num_compress_threads = status.enable_threading() ? 2 : 1;
+    cow_options.num_read_ahead_threads = status.enable_threading() ? 2 : 0;
     cow_options.op_count_max = status.estimated_ops_buffer_size();
     cow_options.compression_factor = status.compression_factor();
     // Disable scratch space for vts tests
@@ -3802,7 +4020,7 @@ bool SnapshotManager::UnmapAllPartitionsInRecovery() {
     const auto& opener = device_->GetPartitionOpener();
     uint32_t slot = SlotNumberForSlotSuffix(device_->GetSlotSuffix());
     auto super_device = device_->GetSuperDevice(slot);
-    auto metadata = android::fs_mgr::ReadMetadata(opener, super_device, slot);
+    auto metadata = android::fs_mgr::ReadMetadataView(opener, super_device, slot);
     if (!metadata) {
         LOG(ERROR) << "Could not read dynamic partition metadata for device: " << super_device;
         return false;
@@ -4362,6 +4580,68 @@ void SnapshotManager::UpdateCowStats(ISnapshotMergeStats* stats) {
     stats->report()->set_estimated_cow_size_bytes(estimated_cow_size);
 }
 
+void SnapshotManager::RecordPartitionMergeStats(const std::string& name) {
+    // See SnapuserdClient::QueryMergeStats() for the format. The counters
+    // are followed by the time spent in each merge state, of which only
+    // the non-terminal ones are worth reporting.
+    enum Field {
+        kMergedOps,
+        kThrottleMs,
+        kRaHits,
+        kRaMisses,
+        kCopyOps,
+        kXorOps,
+        kReplaceOps,
+        kZeroOps,
+        kMergeStartMs,
+        kMergeReadyMs,
+        kMergeBeginMs,
+        kNumFields,
+    };
+
+    auto response = snapuserd_client_->QueryMergeStats(name);
+    auto parts = android::base::Split(response, ",");
+    if (parts.size() < kNumFields) {
+        LOG(ERROR) << "Could not query merge stats of " << name << ": " << response;
+        return;
+    }
+    std::vector<uint64_t> values(kNumFields);
+    for (size_t i = 0; i < values.size(); i++) {
+        if (!android::base::ParseUint(parts[i], &values[i])) {
+            LOG(ERROR) << "Invalid merge stats of " << name << ": " << response;
+            return;
+        }
+    }
+
+    auto report = GetSnapshotMergeStatsInstance()->report();
+    PartitionMergeStats* stats = nullptr;
+    for (auto& existing : *report->mutable_partition_merge_stats()) {
+        if (existing.name() == name) {
+            stats = &existing;
+            break;
+        }
+    }
+    if (!stats) {
+        stats = report->add_partition_merge_stats();
+        stats->set_name(name);
+    }
+
+    uint64_t merge_time_ms = values[kMergeStartMs] + values[kMergeReadyMs] + values[kMergeBeginMs];
+    stats->set_blocks_merged(values[kMergedOps]);
+    stats->set_blocks_per_second(merge_time_ms ? values[kMergedOps] * 1000 / merge_time_ms : 0);
+    stats->set_merge_time_ms(merge_time_ms);
+    stats->set_throttled_time_ms(values[kThrottleMs]);
+    stats->set_merge_start_time_ms(values[kMergeStartMs]);
+    stats->set_merge_begin_time_ms(values[kMergeBeginMs]);
+    stats->set_merge_ready_time_ms(values[kMergeReadyMs]);
+    stats->set_read_ahead_hits(values[kRaHits]);
+    stats->set_read_ahead_misses(values[kRaMisses]);
+    stats->set_copy_ops(values[kCopyOps]);
+    stats->set_xor_ops(values[kXorOps]);
+    stats->set_replace_ops(values[kReplaceOps]);
+    stats->set_zero_ops(values[kZeroOps]);
+}
+
 void SnapshotManager::SetMergeStatsFeatures(ISnapshotMergeStats* stats) {
     auto lock = LockExclusive();
     if (!lock) return;
@@ -49,7 +49,8 @@ bool SnapshotManagerStub::InitiateMerge() {
 }
 
 UpdateState SnapshotManagerStub::ProcessUpdateState(const std::function<bool()>&,
-                                                    const std::function<bool()>&) {
+                                                    const std::function<bool()>&,
+                                                    const std::function<void(double)>&) {
     LOG(ERROR) << __FUNCTION__ << " should never be called.";
     return UpdateState::None;
 }
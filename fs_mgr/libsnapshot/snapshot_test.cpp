@@ -135,8 +135,7 @@ class SnapshotTest : public ::testing::Test {
         ASSERT_TRUE(sm->BeginUpdate());
     }
 
-    void SetupProperties() {
-        std::unordered_map<std::string, std::string> properties;
+    void SetupProperties(std::unordered_map<std::string, std::string> properties = {}) {
 
         ASSERT_TRUE(android::base::SetProperty("snapuserd.test.io_uring.force_disable", "0"))
                 << "Failed to set property: snapuserd.test.io_uring.disabled";
@@ -1427,6 +1426,39 @@ TEST_F(SnapshotUpdateTest, FullUpdateFlow) {
     }
 }
 
+// Test that snapshots created on a thread pool match the serial flow.
+TEST_F(SnapshotUpdateTest, ParallelSnapshotCreation) {
+    ASSERT_NO_FATAL_FAILURE(
+            SetupProperties({{"ro.virtual_ab.parallel_snapshot_creation.enabled", "true"}}));
+
+    // Same layout as FullUpdateFlow: |sys| and |vnd| get COW partitions in
+    // super, |prd| needs a COW image.
+    constexpr uint64_t partition_size = 3788_KiB;
+    SetSize(sys_, partition_size);
+    SetSize(vnd_, partition_size);
+    SetSize(prd_, 18_MiB);
+    vnd_->set_estimate_cow_size(30_MiB);
+    prd_->set_estimate_cow_size(30_MiB);
+
+    AddOperationForPartitions();
+
+    ASSERT_TRUE(sm->BeginUpdate());
+    ASSERT_TRUE(sm->CreateUpdateSnapshots(manifest_));
+
+    auto tgt = MetadataBuilder::New(*opener_, "super", 1);
+    ASSERT_NE(tgt, nullptr);
+    ASSERT_NE(nullptr, tgt->FindPartition("sys_b-cow"));
+    ASSERT_NE(nullptr, tgt->FindPartition("vnd_b-cow"));
+    ASSERT_EQ(nullptr, tgt->FindPartition("prd_b-cow"));
+    ASSERT_TRUE(image_manager_->BackingImageExists("prd_b-cow-img"));
+
+    ASSERT_TRUE(WriteSnapshots());
+    for (const auto& name : {"sys_a", "vnd_a", "prd_a"}) {
+        ASSERT_TRUE(IsPartitionUnchanged(name));
+    }
+    ASSERT_TRUE(sm->FinishedSnapshotWrites(false));
+}
+
 TEST_F(SnapshotUpdateTest, DuplicateOps) {
     if (!snapuserd_required_) {
         GTEST_SKIP() << "snapuserd-only test";
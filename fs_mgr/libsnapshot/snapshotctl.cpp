@@ -72,6 +72,11 @@ int Usage() {
                  "    Print snapshot states.\n"
                  "  merge\n"
                  "    Deprecated.\n"
+                 "  merge-throttle\n"
+                 "    Print the merge pacing state of snapuserd: batch size in ops,\n"
+                 "    inter-batch delay, I/O pressure and dm-user request latency.\n"
+                 "  io-latency\n"
+                 "    Print the cumulative latency histograms of the snapuserd I/O stages.\n"
                  "  map\n"
                  "    Map all partitions at /dev/block/mapper\n"
                  "  map-snapshots <directory where snapshot patches are present>\n"
@@ -505,6 +510,76 @@ bool MergeCmdHandler(int /*argc*/, char** argv) {
     return false;
 }
 
+bool MergeThrottleCmdHandler(int /*argc*/, char** argv) {
+    android::base::InitLogging(argv, &StderrLogger);
+
+    auto client = SnapuserdClient::TryConnect(kSnapuserdSocket, 5s);
+    if (!client) {
+        std::cerr << "Could not connect to snapuserd.\n";
+        return false;
+    }
+
+    std::string stats = client->QueryMergeThrottle();
+    std::vector<std::string> parts = android::base::Split(stats, ",");
+    if (parts.size() != 4) {
+        std::cerr << "Unexpected response from snapuserd: " << stats << "\n";
+        return false;
+    }
+
+    std::cout << "Batch size: " << parts[0] << " ops\n"
+              << "Inter-batch delay: " << parts[1] << " ms\n"
+              << "I/O pressure (avg10): " << parts[2] << "%\n"
+              << "dm-user latency: " << parts[3] << " us\n";
+    return true;
+}
+
+bool IoLatencyCmdHandler(int /*argc*/, char** argv) {
+    android::base::InitLogging(argv, &StderrLogger);
+
+    auto client = SnapuserdClient::TryConnect(kSnapuserdSocket, 5s);
+    if (!client) {
+        std::cerr << "Could not connect to snapuserd.\n";
+        return false;
+    }
+
+    auto stages = client->QueryLatencyStages();
+    if (stages.empty()) {
+        std::cerr << "Could not query the I/O stages of snapuserd.\n";
+        return false;
+    }
+
+    for (const auto& stage : stages) {
+        std::string stats = client->QueryLatencyStats(stage);
+        std::vector<std::string> parts = android::base::Split(stats, ",");
+        uint64_t count, total_us;
+        if (parts.size() < 2 || !android::base::ParseUint(parts[0], &count) ||
+            !android::base::ParseUint(parts[1], &total_us)) {
+            std::cerr << "Unexpected response for stage " << stage << ": " << stats << "\n";
+            return false;
+        }
+
+        std::cout << stage << ": count " << count;
+        if (count) {
+            std::cout << ", avg " << (total_us / count) << " us";
+        }
+        std::cout << "\n";
+
+        // Bucket 0 is < 1us; bucket i covers [2^(i-1), 2^i) us.
+        for (size_t i = 2; i < parts.size(); i++) {
+            if (parts[i] == "0") {
+                continue;
+            }
+            size_t bucket = i - 2;
+            if (i == parts.size() - 1) {
+                std::cout << "    >= " << (1ULL << (bucket - 1)) << " us: " << parts[i] << "\n";
+            } else {
+                std::cout << "    < " << (1ULL << bucket) << " us: " << parts[i] << "\n";
+            }
+        }
+    }
+    return true;
+}
+
 #ifdef SNAPSHOTCTL_USERDEBUG_OR_ENG
 bool GetVerityPartitions(std::vector<std::string>& partitions) {
     auto& dm = android::dm::DeviceMapper::Instance();
@@ -778,6 +853,8 @@ static std::map<std::string, std::function<bool(int, char**)>> kCmdMap = {
         // clang-format off
         {"dump", DumpCmdHandler},
         {"merge", MergeCmdHandler},
+        {"merge-throttle", MergeThrottleCmdHandler},
+        {"io-latency", IoLatencyCmdHandler},
         {"map", MapCmdHandler},
 #ifdef SNAPSHOTCTL_USERDEBUG_OR_ENG
         {"test-blank-ota", TestOtaHandler},
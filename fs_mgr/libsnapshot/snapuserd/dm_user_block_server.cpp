@@ -17,6 +17,7 @@
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <snapuserd/snapuserd_kernel.h>
+#include <snapuserd/snapuserd_stats.h>
 #include "snapuserd_logging.h"
 
 namespace android {
@@ -32,13 +33,17 @@ DmUserBlockServer::DmUserBlockServer(const std::string& misc_name, unique_fd&& c
 
 bool DmUserBlockServer::ProcessRequests() {
     struct dm_user_header* header = buffer_.GetHeaderPtr();
-    if (!android::base::ReadFully(ctrl_fd_, header, sizeof(*header))) {
-        if (errno != ENOTBLK) {
-            SNAP_PLOG(ERROR) << "Control-read failed";
+    {
+        // Includes the time spent idle, waiting for dm-user to queue a request.
+        ScopedStageTimer timer(IoStage::kDmUserReceive);
+        if (!android::base::ReadFully(ctrl_fd_, header, sizeof(*header))) {
+            if (errno != ENOTBLK) {
+                SNAP_PLOG(ERROR) << "Control-read failed";
+            }
+
+            SNAP_PLOG(DEBUG) << "ReadDmUserHeader failed....";
+            return false;
         }
-
-        SNAP_PLOG(DEBUG) << "ReadDmUserHeader failed....";
-        return false;
     }
 
     SNAP_LOG(DEBUG) << "Daemon: msg->seq: " << std::dec << header->seq;
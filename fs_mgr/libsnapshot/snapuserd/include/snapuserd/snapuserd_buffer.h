@@ -19,16 +19,23 @@
 #include <stdlib.h>
 
 #include <iostream>
+#include <memory>
 
 #include <libsnapshot/cow_reader.h>
 
 namespace android {
 namespace snapshot {
 
+// The payload region handed out by BufferSink is page aligned, with the
+// dm-user header placed immediately before it. This lets callers use the
+// payload as an O_DIRECT target while the header and payload can still be
+// sent to dm-user in a single contiguous write.
 class BufferSink final {
   public:
+    BufferSink() : buffer_(nullptr, &::free) {}
+
     void Initialize(size_t size);
-    void* GetBufPtr() { return buffer_.get(); }
+    void* GetBufPtr() { return reinterpret_cast<uint8_t*>(buffer_.get()) + header_offset_; }
     void Clear() { memset(GetBufPtr(), 0, buffer_size_); }
     void* GetPayloadBuffer(size_t size);
     void* GetBuffer(size_t requested, size_t* actual);
@@ -53,9 +60,10 @@ class BufferSink final {
     void* AcquireBuffer(size_t size, size_t to_write);
 
   private:
-    std::unique_ptr<uint8_t[]> buffer_;
+    std::unique_ptr<void, decltype(&::free)> buffer_;
     loff_t buffer_offset_;
     size_t buffer_size_;
+    size_t header_offset_ = 0;
 };
 
 }  // namespace snapshot
@@ -17,7 +17,9 @@
 #include <unistd.h>
 
 #include <chrono>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 
@@ -29,6 +31,12 @@ static constexpr uint32_t PACKET_SIZE = 512;
 static constexpr char kSnapuserdSocket[] = "snapuserd";
 static constexpr char kSnapuserdSocketProxy[] = "snapuserd_proxy";
 static constexpr char kDaemonAliveIndicator[] = "daemon-alive-indicator";
+// Directory under /metadata/ota where snapuserd records how far partition
+// verification got, so that it can resume after an interrupted boot.
+static constexpr char kVerifyCheckpointDir[] = "snapuserd-verify";
+// Directory under /metadata/ota where snapuserd keeps the boot read profile
+// of each partition, used to prefetch COW blocks on the next boots.
+static constexpr char kBootProfileDir[] = "snapuserd-profile";
 
 // Ensure that the second-stage daemon for snapuserd is running.
 bool EnsureSnapuserdStarted();
@@ -36,6 +44,9 @@ bool EnsureSnapuserdStarted();
 class SnapuserdClient {
   private:
     android::base::unique_fd sockfd_;
+    std::optional<bool> supports_merge_progress_events_;
+    std::optional<bool> supports_prepare_;
+    uint64_t merge_state_changes_ = 0;
 
     bool Sendmsg(const std::string& msg);
     std::string Receivemsg();
@@ -73,6 +84,15 @@ class SnapuserdClient {
                            const std::string& base_path_merge = "");
     bool AttachDmUser(const std::string& misc_name);
 
+    // Start initializing the handler of step 1 in the background, so that the
+    // handlers of several partitions are initialized concurrently; the
+    // InitDmUserCow() call for |misc_name| then waits for it to finish. This
+    // requires the dm-user control device to exist. Returns false if the
+    // daemon does not support it, in which case InitDmUserCow() does all of
+    // the work.
+    bool PrepareDmUserCow(const std::string& misc_name, const std::string& cow_device,
+                          const std::string& backing_device, const std::string& base_path_merge);
+
     // Wait for snapuserd to disassociate with a dm-user control device. This
     // must ONLY be called if the control device has already been deleted.
     bool WaitForDeviceDelete(const std::string& control_device);
@@ -91,9 +111,39 @@ class SnapuserdClient {
     // Returns Merge completion percentage
     double GetMergePercent();
 
+    // Block until the merge has moved on since the previous call: at least
+    // one more percent was merged, or a merge was queued, completed or
+    // failed. |*percentage| is set to the new completion percentage.
+    // Returns false right away if no merge is running or the daemon cannot
+    // report merge progress events; callers should poll instead.
+    bool WaitForMergeProgress(double* percentage);
+
     // Return the status of the snapshot
     std::string QuerySnapshotStatus(const std::string& misc_name);
 
+    // Return the decompressed-block cache counters of the snapshot as
+    // "<hits>,<misses>,<cached-blocks>", or "fail".
+    std::string QueryCacheStats(const std::string& misc_name);
+
+    // Return the merge counters of the snapshot as "<merged-ops>,<throttle-ms>,
+    // <ra-hits>,<ra-misses>,<copy-ops>,<xor-ops>,<replace-ops>,<zero-ops>",
+    // followed by the milliseconds the merge spent in each of its states, or
+    // "fail".
+    std::string QueryMergeStats(const std::string& misc_name);
+
+    // Return the merge pacing state of the daemon as
+    // "<batch-ops>,<delay-ms>,<psi-avg10>,<io-latency-us>", or "fail".
+    std::string QueryMergeThrottle();
+
+    // Return the names of the I/O stages for which snapuserd keeps latency
+    // histograms.
+    std::vector<std::string> QueryLatencyStages();
+
+    // Return the latency histogram of |stage| as
+    // "<count>,<total-us>,<bucket-0>,...,<bucket-N>", or "fail". Bucket 0
+    // counts requests under 1us and bucket i those in [2^(i-1), 2^i) us.
+    std::string QueryLatencyStats(const std::string& stage);
+
     // Check the update verification status - invoked by update_verifier during
     // boot
     bool QueryUpdateVerification();
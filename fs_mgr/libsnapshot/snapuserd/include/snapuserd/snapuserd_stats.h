@@ -0,0 +1,100 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace android {
+namespace snapshot {
+
+// Stages of the snapuserd I/O path that are traced and timed.
+enum class IoStage {
+    // ReadWorker / block server
+    kDmUserReceive,
+    kCowLookup,
+    kSourceRead,
+    kDecompress,
+    kXor,
+    kDmUserReply,
+    // MergeWorker
+    kMergeRead,
+    kMergeWrite,
+    kMergeSync,
+    // ReadAhead
+    kReadAheadRead,
+    kReadAheadXor,
+    kNumStages,
+};
+
+const char* IoStageName(IoStage stage);
+
+// Cumulative latency histogram with power-of-two microsecond buckets.
+// Bucket 0 counts samples below 1us, bucket i counts samples in
+// [2^(i-1), 2^i) us, and the last bucket counts everything above.
+// Recording is lock-free so it can be used from all worker threads.
+class LatencyHistogram {
+  public:
+    static constexpr size_t kNumBuckets = 20;
+
+    void Record(std::chrono::nanoseconds latency);
+
+    // "<count>,<total-us>,<bucket-0>,...,<bucket-N>"
+    std::string ToString() const;
+
+  private:
+    std::atomic<uint64_t> count_ = 0;
+    std::atomic<uint64_t> total_us_ = 0;
+    std::array<std::atomic<uint64_t>, kNumBuckets> buckets_ = {};
+};
+
+// Process-wide latency histograms, one per IoStage.
+class SnapuserdStats {
+  public:
+    static SnapuserdStats& Get();
+
+    LatencyHistogram& histogram(IoStage stage) {
+        return histograms_[static_cast<size_t>(stage)];
+    }
+
+    // Returns nullptr if |name| is not an IoStage name.
+    LatencyHistogram* FindHistogram(const std::string& name);
+
+  private:
+    std::array<LatencyHistogram, static_cast<size_t>(IoStage::kNumStages)> histograms_;
+};
+
+// Emits a trace span for |stage| and records its duration in the stage's
+// histogram when it goes out of scope.
+class ScopedStageTimer {
+  public:
+    explicit ScopedStageTimer(IoStage stage);
+    ~ScopedStageTimer();
+
+  private:
+    IoStage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Emit a trace counter.
+void TraceCounter(const char* name, int64_t value);
+
+}  // namespace snapshot
+}  // namespace android
@@ -16,6 +16,8 @@
 
 #include <snapuserd/snapuserd_buffer.h>
 
+#include <unistd.h>
+
 #include <android-base/logging.h>
 #include <snapuserd/snapuserd_kernel.h>
 
@@ -23,9 +25,20 @@ namespace android {
 namespace snapshot {
 
 void BufferSink::Initialize(size_t size) {
+    size_t page_size = getpagesize();
+
     buffer_size_ = size + sizeof(struct dm_user_header);
     buffer_offset_ = 0;
-    buffer_ = std::make_unique<uint8_t[]>(buffer_size_);
+
+    // Reserve one page in front of the payload and place the header at the
+    // tail of it, so that the payload starts on a page boundary.
+    header_offset_ = page_size - sizeof(struct dm_user_header);
+
+    void* addr;
+    int ret = posix_memalign(&addr, page_size, page_size + size);
+    CHECK(ret == 0) << "posix_memalign failed: " << ret << " size: " << size;
+    memset(addr, 0, page_size + size);
+    buffer_.reset(addr);
 }
 
 void* BufferSink::AcquireBuffer(size_t size, size_t to_write) {
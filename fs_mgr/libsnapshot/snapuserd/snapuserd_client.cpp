@@ -31,6 +31,7 @@
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parsedouble.h>
 #include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
@@ -282,6 +283,33 @@ uint64_t SnapuserdClient::InitDmUserCow(const std::string& misc_name, const std:
     return num_sectors;
 }
 
+bool SnapuserdClient::PrepareDmUserCow(const std::string& misc_name,
+                                       const std::string& cow_device,
+                                       const std::string& backing_device,
+                                       const std::string& base_path_merge) {
+    if (!supports_prepare_) {
+        std::string msg = "supports,prepare";
+        if (!Sendmsg(msg)) {
+            LOG(ERROR) << "Failed to send message " << msg << " to snapuserd";
+            return false;
+        }
+        supports_prepare_ = (Receivemsg() == "success");
+    }
+    if (!*supports_prepare_) {
+        return false;
+    }
+
+    std::string msg =
+            android::base::Join(std::vector<std::string>{"prepare", misc_name, cow_device,
+                                                         backing_device, base_path_merge},
+                                ",");
+    if (!Sendmsg(msg)) {
+        LOG(ERROR) << "Failed to send message " << msg << " to snapuserd daemon";
+        return false;
+    }
+    return Receivemsg() == "success";
+}
+
 bool SnapuserdClient::DetachSnapuserd() {
     if (!Sendmsg("detach")) {
         LOG(ERROR) << "Failed to detach snapuserd.";
@@ -313,6 +341,39 @@ double SnapuserdClient::GetMergePercent() {
     return std::stod(response);
 }
 
+bool SnapuserdClient::WaitForMergeProgress(double* percentage) {
+    if (!supports_merge_progress_events_) {
+        std::string msg = "supports,merge_progress_events";
+        if (!Sendmsg(msg)) {
+            LOG(ERROR) << "Failed to send message " << msg << " to snapuserd";
+            return false;
+        }
+        supports_merge_progress_events_ = (Receivemsg() == "success");
+    }
+    if (!*supports_merge_progress_events_) {
+        return false;
+    }
+
+    std::string msg = "wait_merge_progress," + std::to_string(*percentage) + "," +
+                      std::to_string(merge_state_changes_);
+    if (!Sendmsg(msg)) {
+        LOG(ERROR) << "Failed to send message " << msg << " to snapuserd";
+        return false;
+    }
+    std::string response = Receivemsg();
+    if (response == "idle") {
+        return false;
+    }
+
+    auto parts = android::base::Split(response, ",");
+    if (parts.size() != 2 || !android::base::ParseDouble(parts[0], percentage) ||
+        !android::base::ParseUint(parts[1], &merge_state_changes_)) {
+        LOG(ERROR) << "Failed waiting for merge progress: " << response;
+        return false;
+    }
+    return true;
+}
+
 std::string SnapuserdClient::QuerySnapshotStatus(const std::string& misc_name) {
     std::string msg = "getstatus," + misc_name;
     if (!Sendmsg(msg)) {
@@ -322,6 +383,55 @@ std::string SnapuserdClient::QuerySnapshotStatus(const std::string& misc_name) {
     return Receivemsg();
 }
 
+std::string SnapuserdClient::QueryCacheStats(const std::string& misc_name) {
+    std::string msg = "cache_stats," + misc_name;
+    if (!Sendmsg(msg)) {
+        LOG(ERROR) << "Failed to send message " << msg << " to snapuserd";
+        return "fail";
+    }
+    return Receivemsg();
+}
+
+std::string SnapuserdClient::QueryMergeStats(const std::string& misc_name) {
+    std::string msg = "merge_stats," + misc_name;
+    if (!Sendmsg(msg)) {
+        LOG(ERROR) << "Failed to send message " << msg << " to snapuserd";
+        return "fail";
+    }
+    return Receivemsg();
+}
+
+std::string SnapuserdClient::QueryMergeThrottle() {
+    std::string msg = "merge_throttle";
+    if (!Sendmsg(msg)) {
+        LOG(ERROR) << "Failed to send message " << msg << " to snapuserd";
+        return "fail";
+    }
+    return Receivemsg();
+}
+
+std::vector<std::string> SnapuserdClient::QueryLatencyStages() {
+    std::string msg = "latency_stages";
+    if (!Sendmsg(msg)) {
+        LOG(ERROR) << "Failed to send message " << msg << " to snapuserd";
+        return {};
+    }
+    std::string response = Receivemsg();
+    if (response.empty() || response == "fail") {
+        return {};
+    }
+    return android::base::Split(response, ",");
+}
+
+std::string SnapuserdClient::QueryLatencyStats(const std::string& stage) {
+    std::string msg = "latency_stats," + stage;
+    if (!Sendmsg(msg)) {
+        LOG(ERROR) << "Failed to send message " << msg << " to snapuserd";
+        return "fail";
+    }
+    return Receivemsg();
+}
+
 bool SnapuserdClient::QueryUpdateVerification() {
     std::string msg = "update-verify";
     if (!Sendmsg(msg)) {
@@ -14,6 +14,11 @@
  * limitations under the License.
  */
 
+#include <future>
+#include <string>
+#include <vector>
+
+#include <android-base/chrono_utils.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
@@ -107,6 +112,7 @@ bool Daemon::StartServerForUserspaceSnapshots(int arg_start, int argc, char** ar
         return user_server_.Run();
     }
 
+    std::vector<std::vector<std::string>> handler_args;
     for (int i = arg_start; i < argc; i++) {
         auto parts = android::base::Split(argv[i], ",");
 
@@ -114,12 +120,35 @@ bool Daemon::StartServerForUserspaceSnapshots(int arg_start, int argc, char** ar
             LOG(ERROR) << "Malformed message, expected at least four sub-arguments.";
             return false;
         }
-        auto handler =
-                user_server_.AddHandler(parts[0], parts[1], parts[2], parts[3], FLAGS_o_direct);
-        if (!handler || !user_server_.StartHandler(parts[0])) {
+        handler_args.emplace_back(std::move(parts));
+    }
+
+    // I/O to every partition is stalled until its handler is started, and reading each COW
+    // takes a while, so initialize all the handlers in parallel. They are only started once
+    // all of them are ready, so the dm-user control devices are taken over in one step.
+    android::base::Timer timer;
+    std::vector<std::future<bool>> added;
+    for (const auto& parts : handler_args) {
+        added.emplace_back(std::async(std::launch::async, [this, &parts]() -> bool {
+            return user_server_.AddHandler(parts[0], parts[1], parts[2], parts[3],
+                                           FLAGS_o_direct) != nullptr;
+        }));
+    }
+    bool ok = true;
+    for (auto& future : added) {
+        ok &= future.get();
+    }
+    if (!ok) {
+        return false;
+    }
+    auto init_time = timer.duration();
+    for (const auto& parts : handler_args) {
+        if (!user_server_.StartHandler(parts[0])) {
             return false;
         }
     }
+    LOG(INFO) << "Initialized " << handler_args.size() << " handlers in " << init_time.count()
+              << "ms, started them in " << (timer.duration() - init_time).count() << "ms";
 
     // We reach this point only during selinux transition during device boot.
     // At this point, all threads are spin up and are ready to serve the I/O
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_ALWAYS
+
+#include <snapuserd/snapuserd_stats.h>
+
+#include <cutils/trace.h>
+
+namespace android {
+namespace snapshot {
+
+static constexpr const char* kIoStageNames[] = {
+        "dmuser_receive",
+        "cow_lookup",
+        "source_read",
+        "decompress",
+        "xor",
+        "dmuser_reply",
+        "merge_read",
+        "merge_write",
+        "merge_sync",
+        "ra_read",
+        "ra_xor",
+};
+static_assert(sizeof(kIoStageNames) / sizeof(kIoStageNames[0]) ==
+              static_cast<size_t>(IoStage::kNumStages));
+
+const char* IoStageName(IoStage stage) {
+    return kIoStageNames[static_cast<size_t>(stage)];
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency) {
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    size_t bucket = 0;
+    if (us) {
+        bucket = 64 - __builtin_clzll(us);
+        if (bucket >= kNumBuckets) {
+            bucket = kNumBuckets - 1;
+        }
+    }
+
+    count_.fetch_add(1, std::memory_order_relaxed);
+    total_us_.fetch_add(us, std::memory_order_relaxed);
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string LatencyHistogram::ToString() const {
+    std::string out = std::to_string(count_.load()) + "," + std::to_string(total_us_.load());
+    for (const auto& bucket : buckets_) {
+        out += "," + std::to_string(bucket.load());
+    }
+    return out;
+}
+
+SnapuserdStats& SnapuserdStats::Get() {
+    static SnapuserdStats stats;
+    return stats;
+}
+
+LatencyHistogram* SnapuserdStats::FindHistogram(const std::string& name) {
+    for (size_t i = 0; i < histograms_.size(); i++) {
+        if (name == kIoStageNames[i]) {
+            return &histograms_[i];
+        }
+    }
+    return nullptr;
+}
+
+ScopedStageTimer::ScopedStageTimer(IoStage stage)
+    : stage_(stage), start_(std::chrono::steady_clock::now()) {
+    ATRACE_BEGIN(IoStageName(stage));
+}
+
+ScopedStageTimer::~ScopedStageTimer() {
+    ATRACE_END();
+    SnapuserdStats::Get().histogram(stage_).Record(std::chrono::steady_clock::now() - start_);
+}
+
+void TraceCounter(const char* name, int64_t value) {
+    ATRACE_INT64(name, value);
+}
+
+}  // namespace snapshot
+}  // namespace android
@@ -0,0 +1,96 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "block_cache.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <snapuserd/snapuserd_kernel.h>
+
+namespace android {
+namespace snapshot {
+
+BlockCache::BlockCache(size_t capacity, size_t num_shards)
+    : shard_capacity_(std::max<size_t>(1, capacity / std::max<size_t>(1, num_shards))),
+      shards_(std::max<size_t>(1, num_shards)) {}
+
+bool BlockCache::Get(uint64_t new_block, void* buffer) {
+    Shard& shard = GetShard(new_block);
+    std::lock_guard<std::mutex> lock(shard.lock);
+
+    auto it = shard.map.find(new_block);
+    if (it == shard.map.end()) {
+        misses_++;
+        return false;
+    }
+
+    // Move to the front of the LRU list.
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    memcpy(buffer, it->second->data.get(), BLOCK_SZ);
+    hits_++;
+    return true;
+}
+
+void BlockCache::Put(uint64_t new_block, const void* buffer) {
+    Shard& shard = GetShard(new_block);
+    std::lock_guard<std::mutex> lock(shard.lock);
+
+    auto it = shard.map.find(new_block);
+    if (it != shard.map.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        memcpy(it->second->data.get(), buffer, BLOCK_SZ);
+        return;
+    }
+
+    std::unique_ptr<uint8_t[]> data;
+    if (shard.lru.size() >= shard_capacity_) {
+        // Re-use the buffer of the least recently used entry.
+        Entry& victim = shard.lru.back();
+        shard.map.erase(victim.new_block);
+        data = std::move(victim.data);
+        shard.lru.pop_back();
+    } else {
+        data = std::make_unique<uint8_t[]>(BLOCK_SZ);
+    }
+
+    memcpy(data.get(), buffer, BLOCK_SZ);
+    shard.lru.push_front({new_block, std::move(data)});
+    shard.map[new_block] = shard.lru.begin();
+}
+
+void BlockCache::Invalidate(uint64_t new_block) {
+    Shard& shard = GetShard(new_block);
+    std::lock_guard<std::mutex> lock(shard.lock);
+
+    auto it = shard.map.find(new_block);
+    if (it == shard.map.end()) {
+        return;
+    }
+    shard.lru.erase(it->second);
+    shard.map.erase(it);
+}
+
+size_t BlockCache::size() {
+    size_t total = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        total += shard.lru.size();
+    }
+    return total;
+}
+
+}  // namespace snapshot
+}  // namespace android
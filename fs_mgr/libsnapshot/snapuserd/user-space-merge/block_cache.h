@@ -0,0 +1,79 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace snapshot {
+
+// Bounded cache of decompressed 4k COW blocks, keyed by new-block number.
+//
+// A single instance is owned by SnapshotHandler and shared by all the
+// ReadWorker threads of that handler, so a hot block (shared libraries,
+// dex files) read repeatedly during boot is decompressed only once. The
+// cache is split into shards, each with its own lock and LRU list, so that
+// worker threads rarely contend with each other.
+class BlockCache {
+  public:
+    // |capacity| is the total number of 4k blocks held across all shards.
+    explicit BlockCache(size_t capacity, size_t num_shards = kDefaultShards);
+
+    // Copy the cached block into |buffer|. Returns false on a miss.
+    bool Get(uint64_t new_block, void* buffer);
+
+    // Insert or refresh |new_block| with the contents of |buffer|.
+    void Put(uint64_t new_block, const void* buffer);
+
+    // Drop |new_block| from the cache, if present.
+    void Invalidate(uint64_t new_block);
+
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    size_t size();
+
+  private:
+    static constexpr size_t kDefaultShards = 8;
+
+    struct Entry {
+        uint64_t new_block;
+        std::unique_ptr<uint8_t[]> data;
+    };
+
+    struct Shard {
+        std::mutex lock;
+        // Most recently used entry is at the front.
+        std::list<Entry> lru;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> map;
+    };
+
+    Shard& GetShard(uint64_t new_block) { return shards_[new_block % shards_.size()]; }
+
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+};
+
+}  // namespace snapshot
+}  // namespace android
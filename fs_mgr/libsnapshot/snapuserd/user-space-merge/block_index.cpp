@@ -0,0 +1,84 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "block_index.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <android-base/logging.h>
+
+namespace android {
+namespace snapshot {
+
+// Number of blocks a COW op writes. Only replace ops can span more than
+// one block.
+static uint64_t OpNumBlocks(const CowOperation* op) {
+    if (op->type() != kCowReplaceOp) {
+        return 1;
+    }
+    return CowOpCompressionSize(op, BLOCK_SZ) / BLOCK_SZ;
+}
+
+void BlockIndex::Build(const ChunkVec& chunks) {
+    CHECK(chunks.size() < std::numeric_limits<uint32_t>::max());
+
+    size_ = chunks.size();
+    keys_.assign(size_ + 1, 0);
+    ranks_.assign(size_ + 1, 0);
+    size_t pos = 0;
+    BuildEytzinger(chunks, &pos, 1);
+    CHECK(pos == size_);
+
+    num_blocks_ = 0;
+    for (const auto& [sector, op] : chunks) {
+        num_blocks_ = std::max<uint64_t>(num_blocks_, op->new_block + OpNumBlocks(op));
+    }
+    bitmap_.assign((num_blocks_ + 63) / 64, 0);
+    for (const auto& [sector, op] : chunks) {
+        uint64_t end = op->new_block + OpNumBlocks(op);
+        for (uint64_t block = op->new_block; block < end; block++) {
+            bitmap_[block / 64] |= (1ULL << (block % 64));
+        }
+    }
+}
+
+void BlockIndex::BuildEytzinger(const ChunkVec& chunks, size_t* pos, size_t k) {
+    if (k > size_) {
+        return;
+    }
+    BuildEytzinger(chunks, pos, 2 * k);
+    keys_[k] = chunks[*pos].first;
+    ranks_[k] = *pos;
+    *pos += 1;
+    BuildEytzinger(chunks, pos, 2 * k + 1);
+}
+
+size_t BlockIndex::LowerBound(sector_t sector) const {
+    const sector_t* keys = keys_.data();
+    size_t k = 1;
+    while (k <= size_) {
+        // Eight keys share a cache line; fetch the line holding the
+        // descendants four levels down.
+        __builtin_prefetch(keys + std::min(16 * k, size_));
+        k = 2 * k + (keys[k] < sector);
+    }
+    // Undo the trailing right turns to get back to the last node at which
+    // the search went left; that node holds the lower bound.
+    k >>= __builtin_ffsll(~static_cast<unsigned long long>(k));
+    return k ? ranks_[k] : size_;
+}
+
+}  // namespace snapshot
+}  // namespace android
@@ -0,0 +1,74 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include <libsnapshot/cow_format.h>
+#include <snapuserd/snapuserd_kernel.h>
+
+namespace android {
+namespace snapshot {
+
+// Read-only lookup index over the sorted chunk vector of a SnapshotHandler.
+//
+// The sectors are stored in Eytzinger (breadth-first) order, so a search
+// walks a contiguous prefix of the array and the next levels can be
+// prefetched, instead of jumping across millions of 16-byte pairs as a
+// std::lower_bound on the chunk vector does. A bitmap of all blocks
+// written by a COW op lets reads of unchanged blocks skip the search
+// altogether and go straight to the base device.
+class BlockIndex {
+  public:
+    using ChunkVec = std::vector<std::pair<sector_t, const CowOperation*>>;
+
+    // |chunks| must be sorted by sector. The index refers to positions in
+    // |chunks|, which must not change afterwards.
+    void Build(const ChunkVec& chunks);
+
+    // Returns the position of the first chunk whose sector is not less than
+    // |sector|, or the number of chunks if there is none; the same result
+    // as std::lower_bound on the chunk vector.
+    size_t LowerBound(sector_t sector) const;
+
+    // Returns false if no COW op writes |block|; the caller can then read it
+    // from the base device without a lookup. A true result is exact for the
+    // blocks covered by the index.
+    bool ContainsBlock(uint64_t block) const {
+        if (block >= num_blocks_) {
+            return false;
+        }
+        return (bitmap_[block / 64] >> (block % 64)) & 1;
+    }
+
+  private:
+    void BuildEytzinger(const ChunkVec& chunks, size_t* pos, size_t k);
+
+    // 1-based Eytzinger layout; slot 0 is unused.
+    std::vector<sector_t> keys_;
+    // Position in the chunk vector of each slot of |keys_|.
+    std::vector<uint32_t> ranks_;
+    size_t size_ = 0;
+
+    std::vector<uint64_t> bitmap_;
+    uint64_t num_blocks_ = 0;
+};
+
+}  // namespace snapshot
+}  // namespace android
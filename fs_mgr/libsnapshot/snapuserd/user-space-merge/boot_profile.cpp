@@ -0,0 +1,224 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "boot_profile.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <snapuserd/snapuserd_client.h>
+
+namespace android {
+namespace snapshot {
+
+using namespace std::chrono_literals;
+
+// File layout, all integers little endian:
+//
+//     u32 magic, u32 version, u64 fingerprint, u32 count
+//     count x varint(zigzag(block - previous block))
+//
+// Boot reads are mostly sequential runs, so most deltas fit in one byte.
+static constexpr uint32_t kBootProfileMagic = 0x50425553;  // "SUBP"
+static constexpr uint32_t kBootProfileVersion = 1;
+static constexpr size_t kBootProfileHeaderSize = 20;
+
+template <typename T>
+static void PutLe(std::string* out, T value) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+        out->push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+template <typename T>
+static T GetLe(const char* in) {
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value |= static_cast<T>(static_cast<uint8_t>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+BootProfile::BootProfile(std::string path, uint64_t fingerprint, size_t window)
+    : path_(std::move(path)), fingerprint_(fingerprint), window_(window) {}
+
+std::string BootProfile::Encode(uint64_t fingerprint, const std::vector<uint64_t>& blocks) {
+    std::string out;
+    out.reserve(kBootProfileHeaderSize + blocks.size() * 2);
+    PutLe<uint32_t>(&out, kBootProfileMagic);
+    PutLe<uint32_t>(&out, kBootProfileVersion);
+    PutLe<uint64_t>(&out, fingerprint);
+    PutLe<uint32_t>(&out, blocks.size());
+
+    uint64_t prev = 0;
+    for (uint64_t block : blocks) {
+        int64_t delta = static_cast<int64_t>(block - prev);
+        uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+        while (zigzag >= 0x80) {
+            out.push_back(static_cast<char>(zigzag | 0x80));
+            zigzag >>= 7;
+        }
+        out.push_back(static_cast<char>(zigzag));
+        prev = block;
+    }
+    return out;
+}
+
+bool BootProfile::Decode(std::string_view data, uint64_t fingerprint,
+                         std::vector<uint64_t>* blocks) {
+    if (data.size() < kBootProfileHeaderSize ||
+        GetLe<uint32_t>(data.data()) != kBootProfileMagic ||
+        GetLe<uint32_t>(data.data() + 4) != kBootProfileVersion ||
+        GetLe<uint64_t>(data.data() + 8) != fingerprint) {
+        return false;
+    }
+    uint32_t count = GetLe<uint32_t>(data.data() + 16);
+    if (count > kMaxBlocks) {
+        return false;
+    }
+
+    blocks->clear();
+    blocks->reserve(count);
+    size_t pos = kBootProfileHeaderSize;
+    uint64_t prev = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t zigzag = 0;
+        for (int shift = 0;; shift += 7) {
+            if (pos == data.size() || shift > 63) {
+                return false;
+            }
+            uint8_t byte = data[pos++];
+            zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        int64_t delta = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+        prev += static_cast<uint64_t>(delta);
+        blocks->push_back(prev);
+    }
+    return pos == data.size();
+}
+
+std::string BootProfile::GetPath(const std::string& misc_name) {
+    // "system_b-init" in first stage, "system_b" after the transition.
+    auto partition_name = android::base::Split(misc_name, "-")[0];
+    return std::string("/metadata/ota/") + kBootProfileDir + "/" + partition_name;
+}
+
+bool BootProfile::Load() {
+    std::string data;
+    if (!android::base::ReadFileToString(path_, &data)) {
+        return false;
+    }
+    if (!Decode(data, fingerprint_, &blocks_)) {
+        LOG(WARNING) << "Ignoring boot profile " << path_;
+        blocks_.clear();
+        return false;
+    }
+
+    positions_.reserve(blocks_.size());
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        positions_.emplace(blocks_[i], i);
+    }
+    replaying_ = !blocks_.empty();
+    return replaying_;
+}
+
+void BootProfile::OnBlockRead(uint64_t new_block) {
+    if (replaying_) {
+        auto it = positions_.find(new_block);
+        if (it == positions_.end()) {
+            return;
+        }
+        size_t next = it->second + 1;
+        size_t cursor = cursor_.load(std::memory_order_relaxed);
+        while (next > cursor && !cursor_.compare_exchange_weak(cursor, next)) {
+        }
+        if (next > cursor) {
+            cv_.notify_one();
+        }
+        return;
+    }
+
+    if (!recording_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!recording_ || blocks_.size() >= kMaxBlocks) {
+        return;
+    }
+    if (seen_.insert(new_block).second) {
+        blocks_.push_back(new_block);
+    }
+}
+
+bool BootProfile::WaitForTurn(size_t index) {
+    std::unique_lock<std::mutex> lock(lock_);
+    // OnBlockRead() notifies without taking the lock, so a wakeup can be
+    // missed; re-check periodically rather than relying on it.
+    while (!stopped_ && index >= cursor_ + window_) {
+        cv_.wait_for(lock, 100ms);
+    }
+    return !stopped_;
+}
+
+void BootProfile::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        stopped_ = true;
+    }
+    cv_.notify_all();
+}
+
+void BootProfile::Finish() {
+    Stop();
+
+    std::vector<uint64_t> blocks;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!recording_) {
+            return;
+        }
+        recording_ = false;
+        blocks = std::move(blocks_);
+        seen_.clear();
+    }
+    if (blocks.empty()) {
+        return;
+    }
+
+    auto dir = android::base::Dirname(path_);
+    if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+        PLOG(WARNING) << "mkdir failed: " << dir;
+        return;
+    }
+    std::string tmp_path = path_ + ".tmp";
+    if (!android::base::WriteStringToFile(Encode(fingerprint_, blocks), tmp_path) ||
+        rename(tmp_path.c_str(), path_.c_str()) < 0) {
+        PLOG(WARNING) << "Failed to write boot profile: " << path_;
+        unlink(tmp_path.c_str());
+        return;
+    }
+    LOG(INFO) << "Recorded boot profile of " << blocks.size() << " blocks: " << path_;
+}
+
+}  // namespace snapshot
+}  // namespace android
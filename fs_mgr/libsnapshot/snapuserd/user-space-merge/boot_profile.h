@@ -0,0 +1,105 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace snapshot {
+
+// Order in which the COW blocks of a partition were first read during boot.
+//
+// Until the merge finishes, every boot after an OTA reads through snapuserd,
+// and the blocks read in early boot barely change from one boot to the
+// next. On the first boot the read workers record every COW block they
+// decompress; the profile is written to /metadata once the merge is
+// initiated, ie. after boot completed. On the following boots the handler
+// replays it: a prefetch thread decompresses the blocks into the block cache
+// in profile order, staying a bounded window ahead of the blocks the workers
+// have actually asked for, so that it neither runs so far ahead that the
+// cache evicts its work nor competes with reads the boot no longer does.
+class BootProfile {
+  public:
+    // |fingerprint| identifies the COW device; a profile recorded for a
+    // different one is ignored. |window| bounds how far the prefetcher may
+    // run ahead of the workers, in profile entries.
+    BootProfile(std::string path, uint64_t fingerprint, size_t window);
+
+    // Loads the profile at |path|. Returns true if it can be replayed.
+    bool Load();
+
+    // Record the blocks read from now on, until Finish() is called.
+    void StartRecording() { recording_ = true; }
+
+    bool replaying() const { return replaying_; }
+    const std::vector<uint64_t>& blocks() const { return blocks_; }
+
+    // Invoked by the read workers for every COW block read on behalf of
+    // dm-user.
+    void OnBlockRead(uint64_t new_block);
+
+    // Blocks until the prefetcher may fetch profile entry |index|. Returns
+    // false once the profile is stopped.
+    bool WaitForTurn(size_t index);
+
+    // Ends recording and replay. If a profile was being recorded, it is
+    // written out; this is best effort.
+    void Finish();
+
+    static std::string Encode(uint64_t fingerprint, const std::vector<uint64_t>& blocks);
+    static bool Decode(std::string_view data, uint64_t fingerprint, std::vector<uint64_t>* blocks);
+
+    // Profile for the COW device of |misc_name|, under /metadata/ota. The
+    // first-stage and second-stage handlers of a partition share a profile.
+    static std::string GetPath(const std::string& misc_name);
+
+  private:
+    void Stop();
+
+    // Recording stops after this many blocks (1GiB of data); anything past
+    // that is unlikely to be early boot.
+    static constexpr size_t kMaxBlocks = 262144;
+
+    std::string path_;
+    uint64_t fingerprint_;
+    size_t window_;
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::atomic<bool> recording_ = false;
+    std::atomic<bool> stopped_ = false;
+    bool replaying_ = false;
+
+    std::vector<uint64_t> blocks_;
+    // Recording: blocks already in |blocks_|.
+    std::unordered_set<uint64_t> seen_;
+    // Replay: position of each block in |blocks_|. Immutable after Load().
+    std::unordered_map<uint64_t, size_t> positions_;
+    // Replay: one past the furthest profile entry the workers have read.
+    std::atomic<size_t> cursor_ = 0;
+};
+
+}  // namespace snapshot
+}  // namespace android
@@ -17,6 +17,7 @@
 #include <pthread.h>
 #include <sys/eventfd.h>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/logging.h>
 
 #include "android-base/properties.h"
@@ -47,6 +48,11 @@ SnapshotHandlerManager::SnapshotHandlerManager() {
     if (monitor_merge_event_fd_ == -1) {
         PLOG(FATAL) << "monitor_merge_event_fd_: failed to create eventfd";
     }
+    merge_throttle_ = std::make_shared<MergeThrottle>(PAYLOAD_BUFFER_SZ / BLOCK_SZ);
+    merge_event_fd_.reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (merge_event_fd_ == -1) {
+        PLOG(FATAL) << "merge_event_fd_: failed to create eventfd";
+    }
 }
 
 std::shared_ptr<HandlerThread> SnapshotHandlerManager::AddHandler(
@@ -54,9 +60,13 @@ std::shared_ptr<HandlerThread> SnapshotHandlerManager::AddHandler(
         const std::string& backing_device, const std::string& base_path_merge,
         std::shared_ptr<IBlockServerOpener> opener, int num_worker_threads, bool use_iouring,
         bool o_direct) {
+    android::base::Timer timer;
     auto snapuserd = std::make_shared<SnapshotHandler>(
             misc_name, cow_device_path, backing_device, base_path_merge, opener, num_worker_threads,
             use_iouring, perform_verification_, o_direct);
+    snapuserd->SetMergeThrottle(merge_throttle_);
+    snapuserd->SetMergeProgressCallback(
+            [this](bool state_changed) -> void { NotifyMergeProgress(state_changed); });
     if (!snapuserd->InitCowDevice()) {
         LOG(ERROR) << "Failed to initialize Snapuserd";
         return nullptr;
@@ -76,6 +86,7 @@ std::shared_ptr<HandlerThread> SnapshotHandlerManager::AddHandler(
         }
         dm_users_.push_back(handler);
     }
+    LOG(INFO) << "Initialized handler for " << misc_name << " in " << timer;
     return handler;
 }
 
@@ -153,6 +164,7 @@ void SnapshotHandlerManager::RunThread(std::shared_ptr<HandlerThread> handler) {
             num_partitions_merge_complete_ += 1;
             active_merge_threads_ -= 1;
             WakeupMonitorMergeThread();
+            NotifyMergeProgress(true);
         }
         handler->SetThreadTerminated();
         auto iter = FindHandler(&lock, handler->misc_name());
@@ -211,6 +223,7 @@ bool SnapshotHandlerManager::StartMerge(std::lock_guard<std::mutex>* proof_of_lo
 
     merge_handlers_.push(handler);
     WakeupMonitorMergeThread();
+    NotifyMergeProgress(true);
     return true;
 }
 
@@ -222,6 +235,20 @@ void SnapshotHandlerManager::WakeupMonitorMergeThread() {
     }
 }
 
+void SnapshotHandlerManager::NotifyMergeProgress(bool state_changed) {
+    if (state_changed) {
+        merge_state_changes_ += 1;
+    }
+
+    // The eventfd is non-blocking: if the counter is about to overflow,
+    // a wakeup is already pending and this one can be dropped.
+    uint64_t notify = 1;
+    ssize_t rc = TEMP_FAILURE_RETRY(write(merge_event_fd_.get(), &notify, sizeof(notify)));
+    if (rc < 0 && errno != EAGAIN) {
+        PLOG(ERROR) << "failed to notify merge progress";
+    }
+}
+
 void SnapshotHandlerManager::MonitorMerge() {
     pthread_setname_np(pthread_self(), "Merge Monitor");
     while (!stop_monitor_merge_thread_) {
@@ -270,6 +297,46 @@ std::string SnapshotHandlerManager::GetMergeStatus(const std::string& misc_name)
     return (*iter)->snapuserd()->GetMergeStatus();
 }
 
+std::string SnapshotHandlerManager::GetCacheStats(const std::string& misc_name) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto iter = FindHandler(&lock, misc_name);
+    if (iter == dm_users_.end()) {
+        LOG(ERROR) << "Could not find handler: " << misc_name;
+        return {};
+    }
+
+    return (*iter)->snapuserd()->GetCacheStats();
+}
+
+std::string SnapshotHandlerManager::GetMergeStats(const std::string& misc_name) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto iter = FindHandler(&lock, misc_name);
+    if (iter == dm_users_.end()) {
+        LOG(ERROR) << "Could not find handler: " << misc_name;
+        return {};
+    }
+
+    return (*iter)->snapuserd()->GetMergeStats();
+}
+
+std::string SnapshotHandlerManager::GetMergeThrottleStats() {
+    return merge_throttle_->GetStats();
+}
+
+bool SnapshotHandlerManager::IsMergeInProgress() {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if (!merge_handlers_.empty()) {
+        return true;
+    }
+    for (const auto& handler : dm_users_) {
+        if (handler->snapuserd() && handler->snapuserd()->GetMergeStatus() == "snapshot-merge") {
+            return true;
+        }
+    }
+    return false;
+}
+
 double SnapshotHandlerManager::GetMergePercentage() {
     std::lock_guard<std::mutex> lock(lock_);
 
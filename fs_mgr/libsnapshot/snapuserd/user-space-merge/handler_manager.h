@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <queue>
 #include <string>
@@ -26,6 +27,7 @@
 namespace android {
 namespace snapshot {
 
+class MergeThrottle;
 class SnapshotHandler;
 
 class HandlerThread {
@@ -73,6 +75,18 @@ class ISnapshotHandlerManager {
     // on the handler. Returns empty on error.
     virtual std::string GetMergeStatus(const std::string& misc_name) = 0;
 
+    // Return the decompressed-block cache counters of the handler as
+    // "<hits>,<misses>,<cached-blocks>". Returns empty on error.
+    virtual std::string GetCacheStats(const std::string& misc_name) = 0;
+
+    // Return the merge counters of the handler, in the format documented by
+    // SnapshotHandler::GetMergeStats(). Returns empty on error.
+    virtual std::string GetMergeStats(const std::string& misc_name) = 0;
+
+    // Return the merge pacing state shared by all handlers as
+    // "<batch-ops>,<delay-ms>,<psi-avg10>,<io-latency-us>".
+    virtual std::string GetMergeThrottleStats() = 0;
+
     // Wait until all handlers have terminated.
     virtual void JoinAllThreads() = 0;
 
@@ -87,6 +101,17 @@ class ISnapshotHandlerManager {
 
     // Disable partition verification
     virtual void DisableVerification() = 0;
+
+    // Returns an eventfd that is signalled whenever a handler commits merge
+    // progress, or a merge is queued, completes or fails.
+    virtual android::base::borrowed_fd GetMergeEventFd() = 0;
+
+    // Returns how many merges have been queued, completed or failed, so that
+    // callers can tell these events apart from plain progress.
+    virtual uint64_t GetMergeStateChanges() = 0;
+
+    // Returns whether any handler has a merge queued or running.
+    virtual bool IsMergeInProgress() = 0;
 };
 
 class SnapshotHandlerManager final : public ISnapshotHandlerManager {
@@ -103,11 +128,17 @@ class SnapshotHandlerManager final : public ISnapshotHandlerManager {
     bool DeleteHandler(const std::string& misc_name) override;
     bool InitiateMerge(const std::string& misc_name) override;
     std::string GetMergeStatus(const std::string& misc_name) override;
+    std::string GetCacheStats(const std::string& misc_name) override;
+    std::string GetMergeStats(const std::string& misc_name) override;
+    std::string GetMergeThrottleStats() override;
     void JoinAllThreads() override;
     void TerminateMergeThreads() override;
     double GetMergePercentage() override;
     bool GetVerificationStatus() override;
     void DisableVerification() override { perform_verification_ = false; }
+    android::base::borrowed_fd GetMergeEventFd() override { return merge_event_fd_; }
+    uint64_t GetMergeStateChanges() override { return merge_state_changes_; }
+    bool IsMergeInProgress() override;
 
   private:
     bool StartHandler(const std::shared_ptr<HandlerThread>& handler);
@@ -116,6 +147,7 @@ class SnapshotHandlerManager final : public ISnapshotHandlerManager {
                     const std::shared_ptr<HandlerThread>& handler);
     void MonitorMerge();
     void WakeupMonitorMergeThread();
+    void NotifyMergeProgress(bool state_changed);
     bool RemoveAndJoinHandler(const std::string& misc_name);
 
     // Find a HandlerThread within a lock.
@@ -132,7 +164,11 @@ class SnapshotHandlerManager final : public ISnapshotHandlerManager {
     int num_partitions_merge_complete_ = 0;
     std::queue<std::shared_ptr<HandlerThread>> merge_handlers_;
     android::base::unique_fd monitor_merge_event_fd_;
-    bool perform_verification_ = true;
+    // Handlers may be added from several threads at once.
+    std::atomic<bool> perform_verification_ = true;
+    std::shared_ptr<MergeThrottle> merge_throttle_;
+    android::base::unique_fd merge_event_fd_;
+    std::atomic<uint64_t> merge_state_changes_ = 0;
 };
 
 }  // namespace snapshot
@@ -0,0 +1,124 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "merge_throttle.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <snapuserd/snapuserd_stats.h>
+
+namespace android {
+namespace snapshot {
+
+using namespace std::chrono_literals;
+
+MergeThrottle::MergeThrottle(size_t max_batch_ops, const std::string& psi_path)
+    : psi_path_(psi_path), max_batch_ops_(max_batch_ops), batch_ops_(max_batch_ops) {}
+
+void MergeThrottle::RecordIoLatency(std::chrono::microseconds latency) {
+    // EWMA with a weight of 1/8 for the new sample. A lost update under
+    // contention only skips a sample, which is fine for a pacing signal.
+    uint64_t old_avg = io_latency_us_.load(std::memory_order_relaxed);
+    uint64_t sample = latency.count();
+    uint64_t new_avg = old_avg ? (old_avg * 7 + sample) / 8 : sample;
+    io_latency_us_.store(new_avg, std::memory_order_relaxed);
+}
+
+bool MergeThrottle::ParsePsiAvg10(const std::string& contents, double* avg10) {
+    // some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    // full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    if (contents.compare(0, 5, "some ") != 0) {
+        return false;
+    }
+    auto pos = contents.find("avg10=");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    const char* start = contents.c_str() + pos + strlen("avg10=");
+    char* end;
+    double value = strtod(start, &end);
+    if (end == start) {
+        return false;
+    }
+    *avg10 = value;
+    return true;
+}
+
+bool MergeThrottle::ReadPsi(double* avg10) {
+    if (!psi_available_) {
+        return false;
+    }
+    std::string contents;
+    if (!android::base::ReadFileToString(psi_path_, &contents) ||
+        !ParsePsiAvg10(contents, avg10)) {
+        // Kernels without CONFIG_PSI; pace on dm-user latency alone.
+        LOG(INFO) << "I/O pressure not available at " << psi_path_;
+        psi_available_ = false;
+        return false;
+    }
+    return true;
+}
+
+void MergeThrottle::Update(std::chrono::steady_clock::time_point now) {
+    if (now - last_sample_ < kSampleInterval) {
+        return;
+    }
+    last_sample_ = now;
+
+    double avg10 = 0.0;
+    if (ReadPsi(&avg10)) {
+        psi_avg10_ = avg10;
+    }
+    std::chrono::microseconds latency(io_latency_us_.load(std::memory_order_relaxed));
+
+    bool congested = psi_avg10_ > kPsiHighWatermark || latency > kTargetIoLatency;
+    bool idle = psi_avg10_ < kPsiLowWatermark && latency < kTargetIoLatency / 2;
+
+    if (congested) {
+        batch_ops_ = std::max(batch_ops_ / 2, kMinBatchOps);
+        delay_ = std::min(delay_ == 0ms ? kMinDelay : delay_ * 2, kMaxDelay);
+    } else if (idle) {
+        batch_ops_ = std::min(batch_ops_ + kMinBatchOps, max_batch_ops_);
+        delay_ = delay_ / 2;
+        if (delay_ < kMinDelay) {
+            delay_ = 0ms;
+        }
+    }
+
+    TraceCounter("snapuserd_merge_batch_ops", batch_ops_);
+    TraceCounter("snapuserd_merge_delay_ms", delay_.count());
+}
+
+size_t MergeThrottle::NextBatch(std::chrono::milliseconds* delay) {
+    std::lock_guard<std::mutex> lock(lock_);
+    Update(std::chrono::steady_clock::now());
+    *delay = delay_;
+    return batch_ops_;
+}
+
+std::string MergeThrottle::GetStats() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return android::base::StringPrintf("%zu,%lld,%.2f,%llu", batch_ops_,
+                                       static_cast<long long>(delay_.count()), psi_avg10_,
+                                       static_cast<unsigned long long>(io_latency_us_.load()));
+}
+
+}  // namespace snapshot
+}  // namespace android
@@ -0,0 +1,87 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace android {
+namespace snapshot {
+
+// Paces the merge of replace/zero ops against foreground I/O.
+//
+// The merge thread asks for a batch size before each batch and sleeps for
+// the returned delay. The controller periodically samples the system-wide
+// I/O pressure (PSI "some avg10") and the latency of dm-user requests served
+// by the ReadWorkers. Under pressure the batch size is halved and the
+// inter-batch delay doubled; once pressure subsides the batch grows back
+// additively and the delay shrinks, so an idle device merges at full speed.
+class MergeThrottle {
+  public:
+    explicit MergeThrottle(size_t max_batch_ops, const std::string& psi_path = kPsiIoPath);
+
+    // Called by ReadWorkers after each dm-user request.
+    void RecordIoLatency(std::chrono::microseconds latency);
+
+    // Called by the merge thread before each batch. Returns the number of
+    // ops the batch may merge and sets |delay| to the time the caller should
+    // wait before issuing it.
+    size_t NextBatch(std::chrono::milliseconds* delay);
+
+    // Current state as "<batch-ops>,<delay-ms>,<psi-avg10>,<io-latency-us>".
+    std::string GetStats();
+
+    // Exposed for testing.
+    static bool ParsePsiAvg10(const std::string& contents, double* avg10);
+
+    static constexpr char kPsiIoPath[] = "/proc/pressure/io";
+
+  private:
+    void Update(std::chrono::steady_clock::time_point now);
+    bool ReadPsi(double* avg10);
+
+    // PSI "some avg10" percentage above which the merge backs off, and
+    // below which it is allowed to speed up again.
+    static constexpr double kPsiHighWatermark = 10.0;
+    static constexpr double kPsiLowWatermark = 2.0;
+    // Target latency of a dm-user request while the merge is running.
+    static constexpr std::chrono::microseconds kTargetIoLatency{4000};
+    static constexpr std::chrono::milliseconds kMinDelay{5};
+    static constexpr std::chrono::milliseconds kMaxDelay{500};
+    static constexpr std::chrono::milliseconds kSampleInterval{100};
+    static constexpr size_t kMinBatchOps = 8;
+
+    std::string psi_path_;
+    bool psi_available_ = true;
+    const size_t max_batch_ops_;
+
+    std::mutex lock_;
+    size_t batch_ops_;
+    std::chrono::milliseconds delay_{0};
+    double psi_avg10_ = 0.0;
+    std::chrono::steady_clock::time_point last_sample_;
+
+    // Exponentially weighted average of dm-user request latency, in
+    // microseconds, updated lock-free from the ReadWorkers.
+    std::atomic<uint64_t> io_latency_us_ = 0;
+};
+
+}  // namespace snapshot
+}  // namespace android
@@ -17,6 +17,9 @@
 #include <libsnapshot/cow_format.h>
 #include <pthread.h>
 
+#include <chrono>
+#include <thread>
+
 #include "merge_worker.h"
 #include "snapuserd_core.h"
 #include "utility.h"
@@ -94,6 +97,18 @@ int MergeWorker::PrepareMerge(uint64_t* source_offset, int* pending_ops,
     return nr_consecutive;
 }
 
+void MergeWorker::ThrottleMerge() {
+    // Ordered ops are merged one read-ahead window at a time, so only the
+    // inter-window delay applies here; the window size is fixed by the RA
+    // thread.
+    std::chrono::milliseconds delay;
+    snapuserd_->GetMergeThrottle()->NextBatch(&delay);
+    if (delay.count()) {
+        snapuserd_->AddMergeThrottleTime(delay);
+        std::this_thread::sleep_for(delay);
+    }
+}
+
 bool MergeWorker::MergeReplaceZeroOps() {
     // Flush after merging 1MB. Since all ops are independent and there is no
     // dependency between COW ops, we will flush the data and the number
@@ -110,7 +125,12 @@ bool MergeWorker::MergeReplaceZeroOps() {
     SNAP_LOG(INFO) << "MergeReplaceZeroOps started....";
 
     while (!cowop_iter_->AtEnd()) {
-        int num_ops = PAYLOAD_BUFFER_SZ / BLOCK_SZ;
+        std::chrono::milliseconds delay;
+        int num_ops = snapuserd_->GetMergeThrottle()->NextBatch(&delay);
+        if (delay.count()) {
+            snapuserd_->AddMergeThrottleTime(delay);
+            std::this_thread::sleep_for(delay);
+        }
         std::vector<const CowOperation*> replace_zero_vec;
         uint64_t source_offset;
 
@@ -131,6 +151,7 @@ bool MergeWorker::MergeReplaceZeroOps() {
                     return false;
                 }
                 // Read the entire compressed buffer spanning multiple blocks
+                ScopedStageTimer timer(IoStage::kMergeRead);
                 if (!reader_->ReadData(cow_op, buffer, buffer_size)) {
                     SNAP_LOG(ERROR) << "Failed to read COW in merge";
                     return false;
@@ -149,8 +170,12 @@ bool MergeWorker::MergeReplaceZeroOps() {
         size_t io_size = linear_blocks * BLOCK_SZ;
 
         // Merge - Write the contents back to base device
-        int ret = TEMP_FAILURE_RETRY(pwrite(base_path_merge_fd_.get(), bufsink_.GetPayloadBufPtr(),
-                                            io_size, source_offset));
+        int ret;
+        {
+            ScopedStageTimer timer(IoStage::kMergeWrite);
+            ret = TEMP_FAILURE_RETRY(pwrite(base_path_merge_fd_.get(),
+                                            bufsink_.GetPayloadBufPtr(), io_size, source_offset));
+        }
         if (ret < 0 || ret != io_size) {
             SNAP_LOG(ERROR)
                     << "Merge: ReplaceZeroOps: Failed to write to backing device while merging "
@@ -162,6 +187,7 @@ bool MergeWorker::MergeReplaceZeroOps() {
 
         if (num_ops_merged >= total_ops_merged_per_commit) {
             // Flush the data
+            ScopedStageTimer timer(IoStage::kMergeSync);
             if (fsync(base_path_merge_fd_.get()) < 0) {
                 SNAP_LOG(ERROR) << "Merge: ReplaceZeroOps: Failed to fsync merged data";
                 return false;
@@ -188,6 +214,7 @@ bool MergeWorker::MergeReplaceZeroOps() {
     // Any left over ops not flushed yet.
     if (num_ops_merged) {
         // Flush the data
+        ScopedStageTimer timer(IoStage::kMergeSync);
         if (fsync(base_path_merge_fd_.get()) < 0) {
             SNAP_LOG(ERROR) << "Merge: ReplaceZeroOps: Failed to fsync merged data";
             return false;
@@ -225,6 +252,7 @@ bool MergeWorker::MergeOrderedOpsAsync() {
             return false;
         }
 
+        ThrottleMerge();
         snapuserd_->SetMergeInProgress(ra_block_index_);
 
         loff_t offset = 0;
@@ -303,6 +331,7 @@ bool MergeWorker::MergeOrderedOpsAsync() {
                 }
 
                 // Submit the IO for all the COW ops in a single syscall
+                ScopedStageTimer timer(IoStage::kMergeWrite);
                 int ret = io_uring_submit(ring_.get());
                 if (ret != pending_ios_to_submit) {
                     SNAP_PLOG(ERROR)
@@ -358,9 +387,12 @@ bool MergeWorker::MergeOrderedOpsAsync() {
         CHECK(num_ops == 0);
 
         // Flush the data
-        if (flush_required && (fsync(base_path_merge_fd_.get()) < 0)) {
-            SNAP_LOG(ERROR) << " Failed to fsync merged data";
-            return false;
+        if (flush_required) {
+            ScopedStageTimer timer(IoStage::kMergeSync);
+            if (fsync(base_path_merge_fd_.get()) < 0) {
+                SNAP_LOG(ERROR) << " Failed to fsync merged data";
+                return false;
+            }
         }
 
         // Merge is done and data is on disk. Update the COW Header about
@@ -407,6 +439,7 @@ bool MergeWorker::MergeOrderedOps() {
             return false;
         }
 
+        ThrottleMerge();
         snapuserd_->SetMergeInProgress(ra_block_index_);
 
         loff_t offset = 0;
@@ -424,9 +457,13 @@ bool MergeWorker::MergeOrderedOps() {
             // Write to the base device. Data is already in the RA buffer. Note
             // that XOR ops is already handled by the RA thread. We just write
             // the contents out.
-            int ret = TEMP_FAILURE_RETRY(pwrite(base_path_merge_fd_.get(),
+            int ret;
+            {
+                ScopedStageTimer timer(IoStage::kMergeWrite);
+                ret = TEMP_FAILURE_RETRY(pwrite(base_path_merge_fd_.get(),
                                                 (char*)read_ahead_buffer + offset, io_size,
                                                 source_offset));
+            }
             if (ret < 0 || ret != io_size) {
                 SNAP_LOG(ERROR) << "Failed to write to backing device while merging "
                                 << " at offset: " << source_offset << " io_size: " << io_size;
@@ -442,10 +479,13 @@ bool MergeWorker::MergeOrderedOps() {
         CHECK(num_ops == 0);
 
         // Flush the data
-        if (fsync(base_path_merge_fd_.get()) < 0) {
-            SNAP_LOG(ERROR) << " Failed to fsync merged data";
-            snapuserd_->SetMergeFailed(ra_block_index_);
-            return false;
+        {
+            ScopedStageTimer timer(IoStage::kMergeSync);
+            if (fsync(base_path_merge_fd_.get()) < 0) {
+                SNAP_LOG(ERROR) << " Failed to fsync merged data";
+                snapuserd_->SetMergeFailed(ra_block_index_);
+                return false;
+            }
         }
 
         // Merge is done and data is on disk. Update the COW Header about
@@ -29,6 +29,7 @@ class MergeWorker : public Worker {
   private:
     int PrepareMerge(uint64_t* source_offset, int* pending_ops,
                      std::vector<const CowOperation*>* replace_zero_vec = nullptr);
+    void ThrottleMerge();
     bool MergeReplaceZeroOps();
     bool MergeOrderedOps();
     bool MergeOrderedOpsAsync();
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <android-base/scopeguard.h>
 #include <libsnapshot/cow_format.h>
 #include <pthread.h>
 
@@ -49,6 +50,7 @@ ReadWorker::ReadWorker(const std::string& cow_device, const std::string& backing
 // internal COW format and if the block is compressed,
 // it will be de-compressed.
 bool ReadWorker::ProcessReplaceOp(const CowOperation* cow_op, void* buffer, size_t buffer_size) {
+    ScopedStageTimer timer(IoStage::kDecompress);
     if (!reader_->ReadData(cow_op, buffer, buffer_size)) {
         SNAP_LOG(ERROR) << "ProcessReplaceOp failed for block " << cow_op->new_block
                         << " buffer_size: " << buffer_size;
@@ -57,6 +59,33 @@ bool ReadWorker::ProcessReplaceOp(const CowOperation* cow_op, void* buffer, size
     return true;
 }
 
+// Read the 4k block of COW data for |cow_op|, going through the
+// decompressed-block cache shared by all the worker threads.
+bool ReadWorker::ReadCachedData(const CowOperation* cow_op, void* buffer) {
+    if (BootProfile* profile = snapuserd_->GetBootProfile()) {
+        profile->OnBlockRead(cow_op->new_block);
+    }
+
+    BlockCache* cache = snapuserd_->GetBlockCache();
+    if (cache->Get(cow_op->new_block, buffer)) {
+        return true;
+    }
+
+    ssize_t size;
+    {
+        ScopedStageTimer timer(IoStage::kDecompress);
+        size = reader_->ReadData(cow_op, buffer, BLOCK_SZ);
+    }
+    if (size != BLOCK_SZ) {
+        SNAP_LOG(ERROR) << "ReadCachedData failed for block " << cow_op->new_block
+                        << ", return value: " << size;
+        return false;
+    }
+
+    cache->Put(cow_op->new_block, buffer);
+    return true;
+}
+
 bool ReadWorker::ReadFromSourceDevice(const CowOperation* cow_op, void* buffer) {
     uint64_t offset;
     if (!reader_->GetSourceOffset(cow_op, &offset)) {
@@ -66,6 +95,19 @@ bool ReadWorker::ReadFromSourceDevice(const CowOperation* cow_op, void* buffer)
     SNAP_LOG(DEBUG) << " ReadFromBaseDevice...: new-block: " << cow_op->new_block
                     << " Op: " << *cow_op;
 
+    ScopedStageTimer timer(IoStage::kSourceRead);
+
+    if (CanReadDirect(offset, buffer)) {
+        // The response buffer is suitably aligned; read straight into it and
+        // skip the bounce through aligned_buffer_.
+        if (!android::base::ReadFullyAtOffset(backing_store_direct_fd_, buffer, BLOCK_SZ,
+                                              offset)) {
+            SNAP_PLOG(ERROR) << "O_DIRECT Read failed at offset: " << offset;
+            return false;
+        }
+        return true;
+    }
+
     if (direct_read_ && IsBlockAligned(offset)) {
         if (!android::base::ReadFullyAtOffset(backing_store_direct_fd_, aligned_buffer_.get(),
                                               BLOCK_SZ, offset)) {
@@ -110,13 +152,12 @@ bool ReadWorker::ProcessXorOp(const CowOperation* cow_op, void* buffer) {
     }
     CHECK(xor_buffer_.size() == BLOCK_SZ);
 
-    ssize_t size = reader_->ReadData(cow_op, xor_buffer_.data(), xor_buffer_.size());
-    if (size != BLOCK_SZ) {
-        SNAP_LOG(ERROR) << "ProcessXorOp failed for block " << cow_op->new_block
-                        << ", return value: " << size;
+    if (!ReadCachedData(cow_op, xor_buffer_.data())) {
+        SNAP_LOG(ERROR) << "ProcessXorOp failed for block " << cow_op->new_block;
         return false;
     }
 
+    ScopedStageTimer timer(IoStage::kXor);
     auto xor_out = reinterpret_cast<uint8_t*>(buffer);
     for (size_t i = 0; i < BLOCK_SZ; i++) {
         xor_out[i] ^= xor_buffer_[i];
@@ -185,6 +226,9 @@ bool ReadWorker::ProcessCowOp(const CowOperation* cow_op, void* buffer) {
     switch (cow_op->type()) {
         case kCowReplaceOp: {
             size_t buffer_size = CowOpCompressionSize(cow_op, BLOCK_SZ);
+            if (buffer_size == BLOCK_SZ) {
+                return ReadCachedData(cow_op, buffer);
+            }
             uint8_t chunk[buffer_size];
             if (!ProcessReplaceOp(cow_op, chunk, buffer_size)) {
                 return false;
@@ -211,6 +255,265 @@ bool ReadWorker::ProcessCowOp(const CowOperation* cow_op, void* buffer) {
     return false;
 }
 
+/*
+ * Async variant of ProcessCowOp used for block-aligned requests.
+ *
+ * Copy and XOR ops, along with blocks whose merge is already complete, only
+ * need a read from the source or base device. Those reads are queued on the
+ * ring instead of being issued one at a time, so a single dm-user request
+ * covering N blocks turns into a single io_uring_submit() rather than N
+ * preads. Replace and zero ops are CPU bound; before decompressing, any
+ * queued reads are submitted so that the device works on them in parallel.
+ *
+ * All the queued reads target response buffers which stay valid until
+ * SendBufferedIo(), which reaps the ring before handing the payload back.
+ */
+bool ReadWorker::ProcessCowOpAsync(const CowOperation* cow_op, void* buffer) {
+    if (cow_op == nullptr) {
+        SNAP_LOG(ERROR) << "ProcessCowOpAsync: Invalid cow_op";
+        return false;
+    }
+
+    switch (cow_op->type()) {
+        case kCowCopyOp:
+            [[fallthrough]];
+        case kCowXorOp: {
+            return ProcessOrderedOpAsync(cow_op, buffer);
+        }
+
+        default: {
+            if (!SubmitPendingIo()) {
+                return false;
+            }
+            return ProcessCowOp(cow_op, buffer);
+        }
+    }
+}
+
+bool ReadWorker::ProcessOrderedOpAsync(const CowOperation* cow_op, void* buffer) {
+    MERGE_GROUP_STATE state = snapuserd_->ProcessMergingBlock(cow_op->new_block, buffer);
+
+    switch (state) {
+        case MERGE_GROUP_STATE::GROUP_MERGE_COMPLETED: {
+            return ReadDataFromBaseDeviceAsync(ChunkToSector(cow_op->new_block), buffer, BLOCK_SZ);
+        }
+        case MERGE_GROUP_STATE::GROUP_MERGE_PENDING: {
+            uint64_t offset;
+            if (!reader_->GetSourceOffset(cow_op, &offset)) {
+                SNAP_LOG(ERROR) << "ProcessOrderedOpAsync: Failed to get source offset";
+                snapuserd_->NotifyIOCompletion(cow_op->new_block);
+                return false;
+            }
+
+            int fd = CanReadDirect(offset, buffer) ? backing_store_direct_fd_.get()
+                                                    : backing_store_fd_.get();
+            bool ret = QueueRead(fd, buffer, BLOCK_SZ, offset);
+
+            // The I/O refcount taken by ProcessMergingBlock is dropped in
+            // ReapPendingIo once the read has landed, irrespective of the
+            // return status.
+            pending_merge_blocks_.push_back(cow_op->new_block);
+            if (ret && cow_op->type() == kCowXorOp) {
+                pending_xor_ops_.emplace_back(cow_op, buffer);
+            }
+            return ret;
+        }
+        case MERGE_GROUP_STATE::GROUP_MERGE_RA_READY: {
+            [[fallthrough]];
+        }
+        case MERGE_GROUP_STATE::GROUP_MERGE_IN_PROGRESS: {
+            return true;
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+bool ReadWorker::ReadDataFromBaseDeviceAsync(sector_t sector, void* buffer, size_t read_size) {
+    CHECK(read_size <= BLOCK_SZ);
+
+    return QueueRead(base_path_merge_fd_.get(), buffer, read_size, sector << SECTOR_SHIFT);
+}
+
+bool ReadWorker::QueueRead(int fd, void* buffer, size_t size, loff_t offset) {
+    // Ring is full - drain it before queuing more.
+    if (pending_reads_.size() == static_cast<size_t>(queue_depth_)) {
+        if (!ReapPendingIo()) {
+            return false;
+        }
+    }
+
+    // Draining the ring may have fallen back to synchronous I/O.
+    if (!read_async_) {
+        if (!android::base::ReadFullyAtOffset(fd, buffer, size, offset)) {
+            SNAP_PLOG(ERROR) << "Read failed at offset: " << offset << " size: " << size;
+            return false;
+        }
+        return true;
+    }
+
+    struct io_uring_sqe* sqe = io_uring_get_sqe(ring_.get());
+    if (!sqe) {
+        SNAP_LOG(ERROR) << "io_uring_get_sqe failed during read";
+        return false;
+    }
+
+    io_uring_prep_read(sqe, fd, buffer, size, offset);
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(pending_reads_.size()));
+    sqe->flags |= IOSQE_ASYNC;
+
+    pending_reads_.push_back({fd, buffer, size, offset});
+    pending_ios_to_submit_ += 1;
+    return true;
+}
+
+// Submit all queued SQEs without waiting for them to complete.
+bool ReadWorker::SubmitPendingIo() {
+    if (!read_async_ || !pending_ios_to_submit_) {
+        return true;
+    }
+
+    int ret = io_uring_submit(ring_.get());
+    if (ret < 0) {
+        SNAP_LOG(ERROR) << "io_uring_submit failed: " << strerror(-ret);
+        return false;
+    }
+
+    pending_ios_to_complete_ += ret;
+    if (ret != pending_ios_to_submit_) {
+        SNAP_LOG(ERROR) << "io_uring_submit failed. io submit: " << ret
+                        << " expected: " << pending_ios_to_submit_;
+        pending_ios_to_submit_ -= ret;
+        return false;
+    }
+    pending_ios_to_submit_ = 0;
+    return true;
+}
+
+bool ReadWorker::ReapIoCompletions() {
+    ScopedStageTimer timer(IoStage::kSourceRead);
+    bool status = true;
+
+    // Every submitted request is reaped, even after a failed one, so that no
+    // read is still in flight when the buffers are re-used.
+    while (pending_ios_to_complete_) {
+        struct io_uring_cqe* cqe;
+
+        int ret = io_uring_wait_cqe(ring_.get(), &cqe);
+        if (ret == -EINTR || ret == -EAGAIN) {
+            continue;
+        }
+        if (ret) {
+            SNAP_LOG(ERROR) << "io_uring_wait_cqe failed: " << strerror(-ret);
+            return false;
+        }
+
+        size_t index = reinterpret_cast<size_t>(io_uring_cqe_get_data(cqe));
+        CHECK(index < pending_reads_.size());
+        if (cqe->res != static_cast<int>(pending_reads_[index].size)) {
+            SNAP_LOG(ERROR) << "io_uring read failed with res: " << cqe->res
+                            << " offset: " << pending_reads_[index].offset
+                            << " size: " << pending_reads_[index].size;
+            status = false;
+        }
+
+        io_uring_cqe_seen(ring_.get(), cqe);
+        pending_ios_to_complete_ -= 1;
+    }
+
+    return status;
+}
+
+bool ReadWorker::ReapPendingIo() {
+    if (pending_reads_.empty() && pending_merge_blocks_.empty()) {
+        return true;
+    }
+
+    bool status = true;
+    bool io_status = SubmitPendingIo();
+
+    // Fetch the XOR data from the COW device while the source reads are in
+    // flight.
+    for (size_t i = 0; i < pending_xor_ops_.size(); i++) {
+        const CowOperation* cow_op = pending_xor_ops_[i].first;
+        if (!ReadCachedData(cow_op, async_xor_buffer_.data() + i * BLOCK_SZ)) {
+            SNAP_LOG(ERROR) << "ReapPendingIo: XOR read failed for block " << cow_op->new_block;
+            status = false;
+            break;
+        }
+    }
+
+    if (io_status) {
+        io_status = ReapIoCompletions();
+    }
+
+    if (!io_status) {
+        SNAP_LOG(ERROR) << "Async read failed - Falling back to synchronous I/O";
+        FinalizeIouring();
+        for (const auto& read : pending_reads_) {
+            if (!android::base::ReadFullyAtOffset(read.fd, read.buffer, read.size, read.offset)) {
+                SNAP_PLOG(ERROR) << "Read failed at offset: " << read.offset
+                                 << " size: " << read.size;
+                status = false;
+                break;
+            }
+        }
+    }
+
+    if (status) {
+        ScopedStageTimer timer(IoStage::kXor);
+        for (size_t i = 0; i < pending_xor_ops_.size(); i++) {
+            auto xor_out = reinterpret_cast<uint8_t*>(pending_xor_ops_[i].second);
+            const uint8_t* xor_in = async_xor_buffer_.data() + i * BLOCK_SZ;
+            for (size_t j = 0; j < BLOCK_SZ; j++) {
+                xor_out[j] ^= xor_in[j];
+            }
+        }
+    }
+
+    // I/O is complete - decrement the refcount irrespective of the return
+    // status
+    for (uint64_t new_block : pending_merge_blocks_) {
+        snapuserd_->NotifyIOCompletion(new_block);
+    }
+
+    pending_reads_.clear();
+    pending_xor_ops_.clear();
+    pending_merge_blocks_.clear();
+    return status;
+}
+
+bool ReadWorker::InitializeIouring() {
+    if (!snapuserd_->IsIouringSupported()) {
+        return false;
+    }
+
+    ring_ = std::make_unique<struct io_uring>();
+
+    int ret = io_uring_queue_init(queue_depth_, ring_.get(), 0);
+    if (ret) {
+        SNAP_LOG(ERROR) << "ReadWorker: io_uring_queue_init failed with ret: " << ret;
+        return false;
+    }
+
+    pending_reads_.reserve(queue_depth_);
+    async_xor_buffer_.resize(queue_depth_ * BLOCK_SZ);
+    read_async_ = true;
+
+    SNAP_LOG(INFO) << "ReadWorker: io_uring initialized with queue depth: " << queue_depth_;
+    return true;
+}
+
+void ReadWorker::FinalizeIouring() {
+    if (read_async_) {
+        io_uring_queue_exit(ring_.get());
+        read_async_ = false;
+        pending_ios_to_submit_ = 0;
+        pending_ios_to_complete_ = 0;
+    }
+}
+
 bool ReadWorker::Init() {
     if (!Worker::Init()) {
         return false;
@@ -259,11 +562,18 @@ bool ReadWorker::Run() {
     SNAP_LOG(INFO) << "Processing snapshot I/O requests....";
 
     pthread_setname_np(pthread_self(), "ReadWorker");
+    tid_ = gettid();
 
     if (!SetThreadPriority(ANDROID_PRIORITY_NORMAL)) {
         SNAP_PLOG(ERROR) << "Failed to set thread priority";
     }
 
+    if (snapuserd_->ShouldPinReadWorkers() && !SetProfiles({"ProcessCapacityHigh"})) {
+        SNAP_PLOG(ERROR) << "Failed to pin worker thread to big cores";
+    }
+
+    InitializeIouring();
+
     // Start serving IO
     while (true) {
         if (!block_server_->ProcessRequests()) {
@@ -271,12 +581,18 @@ bool ReadWorker::Run() {
         }
     }
 
+    FinalizeIouring();
     CloseFds();
     reader_->CloseCowFd();
 
     return true;
 }
 
+bool ReadWorker::CanReadDirect(uint64_t offset, const void* buffer) {
+    return direct_read_ && IsBlockAligned(offset) &&
+           IsBlockAligned(reinterpret_cast<uintptr_t>(buffer));
+}
+
 bool ReadWorker::ReadDataFromBaseDevice(sector_t sector, void* buffer, size_t read_size) {
     CHECK(read_size <= BLOCK_SZ);
 
@@ -307,6 +623,7 @@ bool ReadWorker::GetCowOpBlockOffset(const CowOperation* cow_op, uint64_t io_blo
 bool ReadWorker::ReadAlignedSector(sector_t sector, size_t sz) {
     size_t remaining_size = sz;
     std::vector<std::pair<sector_t, const CowOperation*>>& chunk_vec = snapuserd_->GetChunkVec();
+    const BlockIndex& block_index = snapuserd_->GetBlockIndex();
     int ret = 0;
 
     do {
@@ -320,8 +637,14 @@ bool ReadWorker::ReadAlignedSector(sector_t sector, size_t sz) {
             // present in the mapping.
             size_t size = std::min(BLOCK_SZ, read_size);
 
-            auto it = std::lower_bound(chunk_vec.begin(), chunk_vec.end(),
-                                       std::make_pair(sector, nullptr), SnapshotHandler::compare);
+            // Blocks which no COW op writes are passed through to the base
+            // device without searching the chunk vector.
+            auto it = chunk_vec.end();
+            const bool block_in_cow = block_index.ContainsBlock(SectorToChunk(sector));
+            if (block_in_cow) {
+                ScopedStageTimer timer(IoStage::kCowLookup);
+                it = chunk_vec.begin() + block_index.LowerBound(sector);
+            }
             const bool sector_not_found = (it == chunk_vec.end() || it->first != sector);
 
             void* buffer = block_server_->GetResponseBuffer(BLOCK_SZ, size);
@@ -333,20 +656,21 @@ bool ReadWorker::ReadAlignedSector(sector_t sector, size_t sz) {
             if (sector_not_found) {
                 // Find the 4k block
                 uint64_t io_block = SectorToChunk(sector);
-                // Get the previous iterator. Since the vector is sorted, the
-                // lookup of this sector can fall in a range of blocks if
-                // CowOperation has compressed multiple blocks.
-                if (it != chunk_vec.begin()) {
-                    std::advance(it, -1);
-                }
-
-                bool is_mapping_present = true;
+                bool is_mapping_present = block_in_cow;
+                if (is_mapping_present) {
+                    // Get the previous iterator. Since the vector is sorted, the
+                    // lookup of this sector can fall in a range of blocks if
+                    // CowOperation has compressed multiple blocks.
+                    if (it != chunk_vec.begin()) {
+                        std::advance(it, -1);
+                    }
 
-                // Vector itself is empty. This can happen if the block was not
-                // changed per the OTA or if the merge was already complete but
-                // snapshot table was not yet collapsed.
-                if (it == chunk_vec.end()) {
-                    is_mapping_present = false;
+                    // Vector itself is empty. This can happen if the block was not
+                    // changed per the OTA or if the merge was already complete but
+                    // snapshot table was not yet collapsed.
+                    if (it == chunk_vec.end()) {
+                        is_mapping_present = false;
+                    }
                 }
 
                 const CowOperation* cow_op = nullptr;
@@ -388,7 +712,11 @@ bool ReadWorker::ReadAlignedSector(sector_t sector, size_t sz) {
                         std::memcpy(buffer, (char*)decompressed_buffer_.get() + block_offset, size);
                     } else {
                         // Get the data from the disk based on the compression
-                        // size
+                        // size. Kick off any queued reads first so that
+                        // they overlap with the decompression.
+                        if (!SubmitPendingIo()) {
+                            return false;
+                        }
                         if (!ProcessReplaceOp(cow_op, decompressed_buffer_.get(),
                                               compression_size)) {
                             return false;
@@ -407,7 +735,9 @@ bool ReadWorker::ReadAlignedSector(sector_t sector, size_t sz) {
                     // Block not found in map - which means this block was not
                     // changed as per the OTA. Just route the I/O to the base
                     // device.
-                    if (!ReadDataFromBaseDevice(sector, buffer, size)) {
+                    bool ok = read_async_ ? ReadDataFromBaseDeviceAsync(sector, buffer, size)
+                                          : ReadDataFromBaseDevice(sector, buffer, size);
+                    if (!ok) {
                         SNAP_LOG(ERROR) << "ReadDataFromBaseDevice failed";
                         return false;
                     }
@@ -416,7 +746,9 @@ bool ReadWorker::ReadAlignedSector(sector_t sector, size_t sz) {
             } else {
                 // We found the sector in mapping. Check the type of COW OP and
                 // process it.
-                if (!ProcessCowOp(it->second, buffer)) {
+                bool ok = read_async_ ? ProcessCowOpAsync(it->second, buffer)
+                                      : ProcessCowOp(it->second, buffer);
+                if (!ok) {
                     SNAP_LOG(ERROR)
                             << "ProcessCowOp failed, sector = " << sector << ", size = " << sz;
                     return false;
@@ -516,8 +848,11 @@ int ReadWorker::ReadUnalignedSector(
 bool ReadWorker::ReadUnalignedSector(sector_t sector, size_t size) {
     std::vector<std::pair<sector_t, const CowOperation*>>& chunk_vec = snapuserd_->GetChunkVec();
 
-    auto it = std::lower_bound(chunk_vec.begin(), chunk_vec.end(), std::make_pair(sector, nullptr),
-                               SnapshotHandler::compare);
+    std::vector<std::pair<sector_t, const CowOperation*>>::iterator it;
+    {
+        ScopedStageTimer timer(IoStage::kCowLookup);
+        it = chunk_vec.begin() + snapuserd_->GetBlockIndex().LowerBound(sector);
+    }
 
     // |-------|-------|-------|
     // 0       1       2       3
@@ -648,15 +983,39 @@ bool ReadWorker::ReadUnalignedSector(sector_t sector, size_t size) {
 }
 
 bool ReadWorker::RequestSectors(uint64_t sector, uint64_t len) {
+    snapuserd_->ReadWorkerBusy();
+    auto start = std::chrono::steady_clock::now();
+    auto idle = android::base::make_scope_guard([this, start]() {
+        snapuserd_->GetMergeThrottle()->RecordIoLatency(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start));
+        snapuserd_->ReadWorkerIdle();
+    });
+
+    bool ret;
+
     // Unaligned I/O request
     if (!IsBlockAligned(sector << SECTOR_SHIFT)) {
-        return ReadUnalignedSector(sector, len);
+        ret = ReadUnalignedSector(sector, len);
+    } else {
+        ret = ReadAlignedSector(sector, len);
     }
 
-    return ReadAlignedSector(sector, len);
+    // If the request failed midway, drain whatever is still queued so that
+    // the merge refcounts taken for it are released.
+    if (!ret) {
+        ReapPendingIo();
+    }
+    return ret;
 }
 
 bool ReadWorker::SendBufferedIo() {
+    // All the queued reads target the payload buffer which is about to be
+    // sent; they must be complete first.
+    if (!ReapPendingIo()) {
+        return false;
+    }
+    ScopedStageTimer timer(IoStage::kDmUserReply);
     return block_server_->SendBufferedIo();
 }
 
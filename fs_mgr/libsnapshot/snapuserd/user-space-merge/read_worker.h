@@ -14,9 +14,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <utility>
 #include <vector>
 
+#include <liburing.h>
 #include <snapuserd/block_server.h>
 #include "worker.h"
 
@@ -36,6 +38,7 @@ class ReadWorker : public Worker, public IBlockServer::Delegate {
     bool RequestSectors(uint64_t sector, uint64_t size) override;
 
     IBlockServer* block_server() const { return block_server_.get(); }
+    pid_t tid() const { return tid_; }
 
   private:
     bool SendBufferedIo();
@@ -46,6 +49,7 @@ class ReadWorker : public Worker, public IBlockServer::Delegate {
     bool ProcessCopyOp(const CowOperation* cow_op, void* buffer);
     bool ProcessReplaceOp(const CowOperation* cow_op, void* buffer, size_t buffer_size);
     bool ProcessZeroOp(void* buffer);
+    bool ReadCachedData(const CowOperation* cow_op, void* buffer);
 
     bool IsMappingPresent(const CowOperation* cow_op, loff_t requested_offset,
                           loff_t cow_op_offset);
@@ -55,8 +59,24 @@ class ReadWorker : public Worker, public IBlockServer::Delegate {
     int ReadUnalignedSector(sector_t sector, size_t size,
                             std::vector<std::pair<sector_t, const CowOperation*>>::iterator& it);
     bool ReadFromSourceDevice(const CowOperation* cow_op, void* buffer);
+    // O_DIRECT reads can target |buffer| without a bounce buffer only if
+    // both the device offset and the memory address are block aligned.
+    bool CanReadDirect(uint64_t offset, const void* buffer);
     bool ReadDataFromBaseDevice(sector_t sector, void* buffer, size_t read_size);
 
+    // Async I/O path. Reads to the source and base devices for block-aligned
+    // requests are queued on the ring and reaped before the payload is sent
+    // back to dm-user.
+    bool InitializeIouring();
+    void FinalizeIouring();
+    bool ProcessCowOpAsync(const CowOperation* cow_op, void* buffer);
+    bool ProcessOrderedOpAsync(const CowOperation* cow_op, void* buffer);
+    bool ReadDataFromBaseDeviceAsync(sector_t sector, void* buffer, size_t read_size);
+    bool QueueRead(int fd, void* buffer, size_t size, loff_t offset);
+    bool SubmitPendingIo();
+    bool ReapIoCompletions();
+    bool ReapPendingIo();
+
     constexpr bool IsBlockAligned(size_t size) { return ((size & (BLOCK_SZ - 1)) == 0); }
     constexpr sector_t ChunkToSector(chunk_t chunk) { return chunk << CHUNK_SHIFT; }
     constexpr chunk_t SectorToChunk(sector_t sector) { return sector >> CHUNK_SHIFT; }
@@ -65,6 +85,7 @@ class ReadWorker : public Worker, public IBlockServer::Delegate {
     unique_fd backing_store_fd_;
     unique_fd backing_store_direct_fd_;
     bool direct_read_ = false;
+    std::atomic<pid_t> tid_ = 0;
 
     std::shared_ptr<IBlockServerOpener> block_server_opener_;
     std::unique_ptr<IBlockServer> block_server_;
@@ -72,6 +93,30 @@ class ReadWorker : public Worker, public IBlockServer::Delegate {
     std::vector<uint8_t> xor_buffer_;
     std::unique_ptr<void, decltype(&::free)> aligned_buffer_;
     std::unique_ptr<uint8_t[]> decompressed_buffer_;
+
+    struct AsyncRead {
+        int fd;
+        void* buffer;
+        size_t size;
+        loff_t offset;
+    };
+
+    bool read_async_ = false;
+    std::unique_ptr<struct io_uring> ring_;
+    // Reads queued on the ring for the current payload. A request is never
+    // larger than the ring, so this never grows past queue_depth_.
+    std::vector<AsyncRead> pending_reads_;
+    // XOR ops whose source block is in flight; the COW data is fetched into
+    // async_xor_buffer_ while the source read completes.
+    std::vector<std::pair<const CowOperation*, void*>> pending_xor_ops_;
+    std::vector<uint8_t> async_xor_buffer_;
+    // Blocks in a GROUP_MERGE_PENDING group whose I/O refcount must be
+    // dropped once the queued read completes.
+    std::vector<uint64_t> pending_merge_blocks_;
+    int pending_ios_to_submit_ = 0;
+    int pending_ios_to_complete_ = 0;
+    // Same queue depth as the read-ahead and merge threads.
+    int queue_depth_ = 8;
 };
 
 }  // namespace snapshot
@@ -46,6 +46,8 @@ SnapshotHandler::SnapshotHandler(std::string misc_name, std::string cow_device,
     is_io_uring_enabled_ = use_iouring;
     perform_verification_ = perform_verification;
     o_direct_ = o_direct;
+    block_cache_ = std::make_unique<BlockCache>(kBlockCacheBlocks);
+    merge_throttle_ = std::make_shared<MergeThrottle>(PAYLOAD_BUFFER_SZ / BLOCK_SZ);
 }
 
 bool SnapshotHandler::InitializeWorkers() {
@@ -61,6 +63,21 @@ bool SnapshotHandler::InitializeWorkers() {
         worker_threads_.push_back(std::move(wt));
     }
 
+    // A single worker is used outside of boot (eg: during OTA install); keep
+    // it that way. During boot, let the pool grow with the queue depth.
+    max_worker_threads_ = (num_worker_threads_ > 1) ? kMaxWorkerThreads : num_worker_threads_;
+
+    // Optional CPU placement of the worker threads:
+    //
+    // "big": workers run on the big cores, away from the merge and
+    // read-ahead threads which are confined to the little cores.
+    //
+    // "big_then_little": same as above, but the workers are parked on the
+    // little cores once the merge is initiated, which happens only after
+    // boot is complete.
+    worker_cpu_policy_ =
+            android::base::GetProperty("ro.virtual_ab.snapuserd.worker_cpu_policy", "");
+
     merge_thread_ = std::make_unique<MergeWorker>(cow_device_, misc_name_, base_path_merge_,
                                                   GetSharedPtr());
 
@@ -69,6 +86,97 @@ bool SnapshotHandler::InitializeWorkers() {
 
     update_verify_ = std::make_unique<UpdateVerify>(misc_name_);
 
+    // Boot profiles only help while the device boots from the snapshot.
+    if (num_worker_threads_ > 1 &&
+        android::base::GetBoolProperty("ro.virtual_ab.snapuserd.boot_profile", true)) {
+        InitBootProfile();
+    }
+
+    return true;
+}
+
+void SnapshotHandler::InitBootProfile() {
+    std::string path = BootProfile::GetPath(misc_name_);
+    // /metadata/ota only exists on devices taking an OTA; leave host tests alone.
+    if (access(android::base::Dirname(android::base::Dirname(path)).c_str(), F_OK) < 0) {
+        return;
+    }
+
+    // A profile recorded against another COW device would only prefetch the
+    // wrong blocks; identify this one by its size and number of data ops.
+    off_t cow_size = lseek(cow_fd_.get(), 0, SEEK_END);
+    uint64_t fingerprint =
+            (static_cast<uint64_t>(cow_size) << 20) ^ reader_->get_num_total_data_ops();
+
+    boot_profile_ = std::make_unique<BootProfile>(path, fingerprint, kBootProfileWindow);
+    if (boot_profile_->Load()) {
+        SNAP_LOG(INFO) << "Replaying boot profile of " << boot_profile_->blocks().size()
+                       << " blocks";
+        return;
+    }
+    // The first-stage handler is torn down before boot completes; let the
+    // second-stage handler, which lives until the merge is initiated, record.
+    if (android::base::EndsWith(misc_name_, "-init")) {
+        boot_profile_ = nullptr;
+        return;
+    }
+    boot_profile_->StartRecording();
+}
+
+// Decompress the blocks of the boot profile into the block cache, just
+// ahead of the read workers.
+bool SnapshotHandler::PrefetchBootProfile() {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(cow_device_.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd < 0) {
+        SNAP_PLOG(ERROR) << "Prefetch: open failed: " << cow_device_;
+        return false;
+    }
+    std::unique_ptr<CowReader> reader = CloneReaderForWorker();
+    if (!reader->InitForMerge(std::move(fd))) {
+        SNAP_LOG(ERROR) << "Prefetch: failed to initialize reader";
+        return false;
+    }
+
+    // Prefetching must never compete with the reads it is meant to help.
+    if (!SetThreadPriority(ANDROID_PRIORITY_BACKGROUND)) {
+        SNAP_PLOG(WARNING) << "Prefetch: failed to set thread priority";
+    }
+
+    std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(BLOCK_SZ);
+    const auto& blocks = boot_profile_->blocks();
+    size_t prefetched = 0;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (!boot_profile_->WaitForTurn(i)) {
+            break;
+        }
+        uint64_t new_block = blocks[i];
+        if (!block_index_.ContainsBlock(new_block)) {
+            continue;
+        }
+        sector_t sector = ChunkToSector(new_block);
+        auto it = chunk_vec_.begin() + block_index_.LowerBound(sector);
+        if (it == chunk_vec_.end() || it->first != sector) {
+            continue;
+        }
+
+        // Only the ops ReadWorker::ReadCachedData() serves from the cache.
+        const CowOperation* cow_op = it->second;
+        bool cached_op = cow_op->type() == kCowXorOp ||
+                         (cow_op->type() == kCowReplaceOp &&
+                          CowOpCompressionSize(cow_op, BLOCK_SZ) == BLOCK_SZ);
+        if (!cached_op) {
+            continue;
+        }
+        if (reader->ReadData(cow_op, buffer.get(), BLOCK_SZ) != BLOCK_SZ) {
+            SNAP_LOG(ERROR) << "Prefetch: failed to read block " << new_block;
+            return false;
+        }
+        block_cache_->Put(new_block, buffer.get());
+        prefetched++;
+    }
+
+    SNAP_LOG(INFO) << "Prefetched " << prefetched << " of " << blocks.size()
+                   << " boot profile blocks";
     return true;
 }
 
@@ -89,9 +197,16 @@ void SnapshotHandler::UpdateMergeCompletionPercentage() {
     }
 }
 
+void SnapshotHandler::NotifyMergeProgress(bool state_changed) {
+    if (merge_progress_callback_) {
+        merge_progress_callback_(state_changed);
+    }
+}
+
 bool SnapshotHandler::CommitMerge(int num_merge_ops) {
     struct CowHeader* ch = reinterpret_cast<struct CowHeader*>(mapped_addr_);
     ch->num_merge_ops += num_merge_ops;
+    merged_ops_ += num_merge_ops;
 
     if (scratch_space_) {
         if (ra_thread_) {
@@ -129,6 +244,7 @@ bool SnapshotHandler::CommitMerge(int num_merge_ops) {
     // even if there is a miss on reading a latest updated value.
     // Subsequent polling will eventually converge to completion.
     UpdateMergeCompletionPercentage();
+    NotifyMergeProgress(false);
 
     return true;
 }
@@ -223,6 +339,7 @@ bool SnapshotHandler::ReadMetadata() {
 
                 merge_blk_state_.push_back(std::move(blk_state));
             }
+            merge_blk_state_[ra_index]->blocks.push_back(cow_op->new_block);
 
             // Move to next RA block
             if (num_ra_ops_per_iter == 0) {
@@ -234,9 +351,14 @@ bool SnapshotHandler::ReadMetadata() {
     }
 
     chunk_vec_.shrink_to_fit();
+    copy_ops_ = copy_ops;
+    xor_ops_ = xor_ops;
+    replace_ops_ = replace_ops;
+    zero_ops_ = zero_ops;
 
     // Sort the vector based on sectors as we need this during un-aligned access
     std::sort(chunk_vec_.begin(), chunk_vec_.end(), compare);
+    block_index_.Build(chunk_vec_);
 
     PrepareReadAhead();
 
@@ -297,7 +419,6 @@ bool SnapshotHandler::InitCowDevice() {
  * Entry point to launch threads
  */
 bool SnapshotHandler::Start() {
-    std::vector<std::future<bool>> threads;
     std::future<bool> ra_thread_status;
 
     if (ra_thread_) {
@@ -311,14 +432,23 @@ bool SnapshotHandler::Start() {
     }
 
     // Launch worker threads
-    for (int i = 0; i < worker_threads_.size(); i++) {
-        threads.emplace_back(
-                std::async(std::launch::async, &ReadWorker::Run, worker_threads_[i].get()));
+    {
+        std::lock_guard<std::mutex> lock(worker_lock_);
+        for (int i = 0; i < worker_threads_.size(); i++) {
+            worker_futures_.emplace_back(
+                    std::async(std::launch::async, &ReadWorker::Run, worker_threads_[i].get()));
+        }
     }
 
     std::future<bool> merge_thread =
             std::async(std::launch::async, &MergeWorker::Run, merge_thread_.get());
 
+    std::future<bool> prefetch_thread;
+    if (boot_profile_ && boot_profile_->replaying()) {
+        prefetch_thread =
+                std::async(std::launch::async, &SnapshotHandler::PrefetchBootProfile, this);
+    }
+
     // Now that the worker threads are up, scan the partitions.
     // If the snapshot-merge is being resumed, there is no need to scan as the
     // current slot is already marked as boot complete.
@@ -326,9 +456,20 @@ bool SnapshotHandler::Start() {
         update_verify_->VerifyUpdatePartition();
     }
 
+    // Workers may be added while we wait; keep joining until none are left.
     bool ret = true;
-    for (auto& t : threads) {
-        ret = t.get() && ret;
+    while (true) {
+        std::future<bool> worker;
+        {
+            std::lock_guard<std::mutex> lock(worker_lock_);
+            if (worker_futures_.empty()) {
+                workers_terminated_ = true;
+                break;
+            }
+            worker = std::move(worker_futures_.back());
+            worker_futures_.pop_back();
+        }
+        ret = worker.get() && ret;
     }
 
     // Worker threads are terminated by this point - this can only happen:
@@ -347,6 +488,13 @@ bool SnapshotHandler::Start() {
 
     NotifyIOTerminated();
 
+    if (boot_profile_) {
+        boot_profile_->Finish();
+        if (prefetch_thread.valid()) {
+            prefetch_thread.get();
+        }
+    }
+
     bool read_ahead_retval = false;
 
     SNAP_LOG(INFO) << "Snapshot I/O terminated. Waiting for merge thread....";
@@ -436,10 +584,87 @@ bool SnapshotHandler::IsIouringSupported() {
     return android::base::GetBoolProperty("ro.virtual_ab.io_uring.enabled", false);
 }
 
+void SnapshotHandler::ReadWorkerBusy() {
+    size_t busy = (busy_workers_ += 1);
+
+    std::lock_guard<std::mutex> lock(worker_lock_);
+    if (busy < worker_threads_.size() || worker_threads_.size() >= max_worker_threads_ ||
+        workers_terminated_) {
+        return;
+    }
+
+    SNAP_LOG(INFO) << "All " << worker_threads_.size()
+                   << " workers are busy, adding a worker thread";
+    if (!LaunchReadWorker(&lock)) {
+        // Don't retry on every request if the control device can't be
+        // opened again.
+        max_worker_threads_ = worker_threads_.size();
+    }
+}
+
+bool SnapshotHandler::LaunchReadWorker(std::lock_guard<std::mutex>*) {
+    auto wt = std::make_unique<ReadWorker>(cow_device_, backing_store_device_, misc_name_,
+                                           base_path_merge_, GetSharedPtr(), block_server_opener_,
+                                           o_direct_);
+    if (!wt->Init()) {
+        SNAP_LOG(ERROR) << "Thread initialization failed";
+        return false;
+    }
+
+    worker_futures_.emplace_back(std::async(std::launch::async, &ReadWorker::Run, wt.get()));
+    worker_threads_.push_back(std::move(wt));
+    return true;
+}
+
+// Move worker threads to the little cores once boot is complete, so that
+// they do not compete with the foreground for the big cores while the merge
+// is in progress.
+void SnapshotHandler::ParkReadWorkers() {
+    if (worker_cpu_policy_ != "big_then_little") {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(worker_lock_);
+    for (const auto& worker : worker_threads_) {
+        pid_t tid = worker->tid();
+        if (tid && !SetThreadProfiles(tid, {"ProcessCapacityLow"})) {
+            SNAP_PLOG(ERROR) << "Failed to park worker thread: " << tid;
+        }
+    }
+    SNAP_LOG(INFO) << "Parked " << worker_threads_.size() << " worker threads on little cores";
+}
+
 bool SnapshotHandler::CheckPartitionVerification() {
     return update_verify_->CheckPartitionVerification();
 }
 
+// Returns "<hits>,<misses>,<cached-blocks>"
+std::string SnapshotHandler::GetCacheStats() {
+    return std::to_string(block_cache_->hits()) + "," + std::to_string(block_cache_->misses()) +
+           "," + std::to_string(block_cache_->size());
+}
+
+// Returns "<merged-ops>,<throttle-ms>,<ra-hits>,<ra-misses>,<copy-ops>,
+// <xor-ops>,<replace-ops>,<zero-ops>", followed by the milliseconds spent
+// in each MERGE_IO_TRANSITION state, in enum order, since the merge was
+// initiated. Merged ops and the state times only cover the current boot.
+std::string SnapshotHandler::GetMergeStats() {
+    std::vector<uint64_t> values = {merged_ops_, merge_throttle_ms_, ra_hits_,     ra_misses_,
+                                    copy_ops_,   xor_ops_,           replace_ops_, zero_ops_};
+
+    std::lock_guard<std::mutex> lock(lock_);
+    auto io_state_time = io_state_time_;
+    if (merge_initiated_) {
+        io_state_time[static_cast<size_t>(io_state_)] +=
+                std::chrono::steady_clock::now() - io_state_since_;
+    }
+    for (const auto& time : io_state_time) {
+        values.emplace_back(
+                std::chrono::duration_cast<std::chrono::milliseconds>(time).count());
+    }
+    return android::base::Join(values, ",");
+}
+
 void SnapshotHandler::FreeResources() {
     worker_threads_.clear();
     read_ahead_thread_ = nullptr;
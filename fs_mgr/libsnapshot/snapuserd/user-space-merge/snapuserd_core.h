@@ -22,8 +22,12 @@
 #include <sys/time.h>
 #include <unistd.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstring>
+#include <functional>
 #include <future>
 #include <iostream>
 #include <limits>
@@ -46,8 +50,13 @@
 #include <snapuserd/block_server.h>
 #include <snapuserd/snapuserd_buffer.h>
 #include <snapuserd/snapuserd_kernel.h>
+#include <snapuserd/snapuserd_stats.h>
 #include <storage_literals/storage_literals.h>
 #include <system/thread_defs.h>
+#include "block_cache.h"
+#include "block_index.h"
+#include "boot_profile.h"
+#include "merge_throttle.h"
 #include "snapuserd_readahead.h"
 #include "snapuserd_verify.h"
 
@@ -63,6 +72,16 @@ static_assert(PAYLOAD_BUFFER_SZ >= BLOCK_SZ);
 
 static constexpr int kNumWorkerThreads = 4;
 
+// Upper bound for the worker pool when it grows with the dm-user queue depth.
+static constexpr int kMaxWorkerThreads = 8;
+
+// Number of decompressed 4k blocks cached per handler - 2MB.
+static constexpr size_t kBlockCacheBlocks = 512;
+
+// How far boot profile prefetching may run ahead of the read workers. Half
+// the block cache, so the prefetched blocks are not evicted before use.
+static constexpr size_t kBootProfileWindow = kBlockCacheBlocks / 2;
+
 #define SNAP_LOG(level) LOG(level) << misc_name_ << ": "
 #define SNAP_PLOG(level) PLOG(level) << misc_name_ << ": "
 
@@ -76,6 +95,9 @@ enum class MERGE_IO_TRANSITION {
     READ_AHEAD_FAILURE
 };
 
+static constexpr size_t kNumMergeIoTransitions =
+        static_cast<size_t>(MERGE_IO_TRANSITION::READ_AHEAD_FAILURE) + 1;
+
 class MergeWorker;
 class ReadWorker;
 
@@ -95,6 +117,8 @@ struct MergeGroupState {
     size_t num_ios_in_progress;
     std::mutex m_lock;
     std::condition_variable m_cv;
+    // Blocks which belong to this group
+    std::vector<uint64_t> blocks;
 
     MergeGroupState(MERGE_GROUP_STATE state, size_t n_ios)
         : merge_state_(state), num_ios_in_progress(n_ios) {}
@@ -125,6 +149,8 @@ class SnapshotHandler : public std::enable_shared_from_this<SnapshotHandler> {
     std::shared_ptr<SnapshotHandler> GetSharedPtr() { return shared_from_this(); }
 
     std::vector<std::pair<sector_t, const CowOperation*>>& GetChunkVec() { return chunk_vec_; }
+    // Lookup index over chunk_vec_, built once the metadata is read.
+    const BlockIndex& GetBlockIndex() const { return block_index_; }
 
     static bool compare(std::pair<sector_t, const CowOperation*> p1,
                         std::pair<sector_t, const CowOperation*> p2) {
@@ -186,6 +212,38 @@ class SnapshotHandler : public std::enable_shared_from_this<SnapshotHandler> {
     bool IsIouringSupported();
     bool CheckPartitionVerification();
 
+    // Invoked by worker threads around each dm-user request. When every
+    // worker is busy, the pool grows by one, up to kMaxWorkerThreads.
+    void ReadWorkerBusy();
+    void ReadWorkerIdle() { busy_workers_ -= 1; }
+    bool ShouldPinReadWorkers() const { return !worker_cpu_policy_.empty(); }
+
+    // Decompressed-block cache shared by all worker threads
+    BlockCache* GetBlockCache() { return block_cache_.get(); }
+    // Boot read profile being recorded or replayed, if any
+    BootProfile* GetBootProfile() { return boot_profile_.get(); }
+    std::string GetCacheStats();
+
+    // Merge counters of this handler, see GetMergeStats() for the format.
+    std::string GetMergeStats();
+    void AddMergeThrottleTime(std::chrono::milliseconds delay) {
+        merge_throttle_ms_ += delay.count();
+    }
+
+    // Paces the merge thread against foreground dm-user I/O. The handler
+    // manager shares a single throttle across all handlers, since their
+    // merges compete for the same storage.
+    MergeThrottle* GetMergeThrottle() { return merge_throttle_.get(); }
+    void SetMergeThrottle(std::shared_ptr<MergeThrottle> throttle) {
+        merge_throttle_ = std::move(throttle);
+    }
+
+    // Invoked from the merge thread each time merge progress is committed,
+    // with |state_changed| set once the merge completes or fails.
+    void SetMergeProgressCallback(std::function<void(bool state_changed)> callback) {
+        merge_progress_callback_ = std::move(callback);
+    }
+
   private:
     bool ReadMetadata();
     sector_t ChunkToSector(chunk_t chunk) { return chunk << CHUNK_SHIFT; }
@@ -193,6 +251,12 @@ class SnapshotHandler : public std::enable_shared_from_this<SnapshotHandler> {
     bool IsBlockAligned(uint64_t read_size) { return ((read_size & (BLOCK_SZ - 1)) == 0); }
     struct BufferState* GetBufferState();
     void UpdateMergeCompletionPercentage();
+    void NotifyMergeProgress(bool state_changed);
+    void SetIoState(MERGE_IO_TRANSITION state);
+    bool LaunchReadWorker(std::lock_guard<std::mutex>* proof_of_lock);
+    void ParkReadWorkers();
+    void InitBootProfile();
+    bool PrefetchBootProfile();
 
     // COW device
     std::string cow_device_;
@@ -211,6 +275,7 @@ class SnapshotHandler : public std::enable_shared_from_this<SnapshotHandler> {
     // chunk_vec stores the pseudo mapping of sector
     // to COW operations.
     std::vector<std::pair<sector_t, const CowOperation*>> chunk_vec_;
+    BlockIndex block_index_;
 
     std::mutex lock_;
     std::condition_variable cv;
@@ -218,7 +283,15 @@ class SnapshotHandler : public std::enable_shared_from_this<SnapshotHandler> {
     void* mapped_addr_;
     size_t total_mapped_addr_length_;
 
+    // Protects worker_threads_ and worker_futures_ which can grow while the
+    // handler is running.
+    std::mutex worker_lock_;
     std::vector<std::unique_ptr<ReadWorker>> worker_threads_;
+    std::vector<std::future<bool>> worker_futures_;
+    std::atomic<int> busy_workers_ = 0;
+    size_t max_worker_threads_ = kNumWorkerThreads;
+    bool workers_terminated_ = false;
+    std::string worker_cpu_policy_;
     // Read-ahead related
     bool populate_data_from_cow_ = false;
     bool ra_thread_ = false;
@@ -250,6 +323,23 @@ class SnapshotHandler : public std::enable_shared_from_this<SnapshotHandler> {
 
     std::unique_ptr<UpdateVerify> update_verify_;
     std::shared_ptr<IBlockServerOpener> block_server_opener_;
+    std::unique_ptr<BlockCache> block_cache_;
+    std::unique_ptr<BootProfile> boot_profile_;
+    std::shared_ptr<MergeThrottle> merge_throttle_;
+    std::function<void(bool)> merge_progress_callback_;
+
+    // Merge statistics. The time spent in each io_state_ is only accounted
+    // once the merge is initiated, and is protected by lock_.
+    std::chrono::steady_clock::time_point io_state_since_;
+    std::array<std::chrono::steady_clock::duration, kNumMergeIoTransitions> io_state_time_ = {};
+    std::atomic<uint64_t> merged_ops_ = 0;
+    std::atomic<uint64_t> merge_throttle_ms_ = 0;
+    std::atomic<uint64_t> ra_hits_ = 0;
+    std::atomic<uint64_t> ra_misses_ = 0;
+    size_t copy_ops_ = 0;
+    size_t xor_ops_ = 0;
+    size_t replace_ops_ = 0;
+    size_t zero_ops_ = 0;
 };
 
 std::ostream& operator<<(std::ostream& os, MERGE_IO_TRANSITION value);
@@ -418,6 +418,7 @@ void ReadAhead::UpdateScratchMetadata() {
 }
 
 bool ReadAhead::ReapIoCompletions(int pending_ios_to_complete) {
+    ScopedStageTimer timer(IoStage::kReadAheadRead);
     bool status = true;
 
     // Reap I/O completions
@@ -452,6 +453,7 @@ bool ReadAhead::ReapIoCompletions(int pending_ios_to_complete) {
 void ReadAhead::ProcessXorData(size_t& block_xor_index, size_t& xor_index,
                                std::vector<const CowOperation*>& xor_op_vec, void* buffer,
                                loff_t& buffer_offset) {
+    ScopedStageTimer timer(IoStage::kReadAheadXor);
     loff_t xor_buf_offset = 0;
 
     while (block_xor_index < blocks_.size()) {
@@ -490,6 +492,7 @@ bool ReadAhead::ReadXorData(size_t block_index, size_t xor_op_index,
                             std::vector<const CowOperation*>& xor_op_vec) {
     // Process the XOR ops in parallel - We will be reading data
     // from COW file for XOR ops processing.
+    std::vector<CowReadRequest> requests;
     while (block_index < blocks_.size()) {
         uint64_t new_block = blocks_[block_index];
 
@@ -502,18 +505,26 @@ bool ReadAhead::ReadXorData(size_t block_index, size_t xor_op_index,
                                     << xor_op->new_block;
                     return false;
                 }
-                if (ssize_t rv = reader_->ReadData(xor_op, buffer, BLOCK_SZ); rv != BLOCK_SZ) {
-                    SNAP_LOG(ERROR)
-                            << " ReadAhead - XorOp Read failed for block: " << xor_op->new_block
-                            << ", return value: " << rv;
-                    return false;
-                }
+                requests.push_back({xor_op, buffer, BLOCK_SZ});
 
                 xor_op_index += 1;
             }
         }
         block_index += 1;
     }
+
+    // Decompress straight into the buffer sink, spread across a few threads.
+    ScopedStageTimer timer(IoStage::kReadAheadXor);
+    if (!reader_->ReadDataParallel(&requests, kNumXorDecompressThreads)) {
+        for (const auto& request : requests) {
+            if (request.result != BLOCK_SZ) {
+                SNAP_LOG(ERROR) << " ReadAhead - XorOp Read failed for block: "
+                                << request.op->new_block << ", return value: " << request.result;
+                break;
+            }
+        }
+        return false;
+    }
     return true;
 }
 
@@ -547,6 +558,7 @@ bool ReadAhead::ReadAheadSyncIO() {
         size_t io_size = (linear_blocks * BLOCK_SZ);
 
         // Read from the base device consecutive set of blocks in one shot
+        ScopedStageTimer timer(IoStage::kReadAheadRead);
         if (!android::base::ReadFullyAtOffset(backing_store_fd_,
                                               (char*)ra_temp_buffer_.get() + buffer_offset, io_size,
                                               source_offset)) {
@@ -596,6 +608,7 @@ bool ReadAhead::ReadAheadSyncIO() {
             // Check if this block is an XOR op
             if (xor_op->new_block == new_block) {
                 // Read the xor'ed data from COW
+                ScopedStageTimer timer(IoStage::kReadAheadXor);
                 void* buffer = bufsink.GetPayloadBuffer(BLOCK_SZ);
                 if (!buffer) {
                     SNAP_LOG(ERROR) << "ReadAhead - failed to allocate buffer";
@@ -106,6 +106,9 @@ class ReadAhead {
     // syscalls and fallback to synchronous I/O, we
     // don't want huge queue depth
     int queue_depth_ = 8;
+    // Threads used to decompress the XOR data of a read-ahead window while
+    // the source reads are in flight.
+    static constexpr size_t kNumXorDecompressThreads = 2;
     std::unique_ptr<struct io_uring> ring_;
 };
 
@@ -27,6 +27,8 @@
 
 #include <android-base/cmsg.h>
 #include <android-base/logging.h>
+#include <android-base/parsedouble.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/scopeguard.h>
 #include <android-base/strings.h>
@@ -54,7 +56,7 @@ UserSnapshotServer::UserSnapshotServer() {
 
 UserSnapshotServer::~UserSnapshotServer() {
     // Close any client sockets that were added via AcceptClient().
-    for (size_t i = 1; i < watched_fds_.size(); i++) {
+    for (size_t i = kFirstClientIndex; i < watched_fds_.size(); i++) {
         close(watched_fds_[i].fd);
     }
 }
@@ -127,7 +129,7 @@ bool UserSnapshotServer::Receivemsg(android::base::borrowed_fd fd, const std::st
             return Sendmsg(fd, "fail");
         }
 
-        auto handler = AddHandler(out[1], out[2], out[3], out[4]);
+        auto handler = InitHandler(out);
         if (!handler) {
             return Sendmsg(fd, "fail");
         }
@@ -139,6 +141,20 @@ bool UserSnapshotServer::Receivemsg(android::base::borrowed_fd fd, const std::st
 
         auto retval = "success," + std::to_string(num_sectors);
         return Sendmsg(fd, retval);
+    } else if (cmd == "prepare") {
+        // Message format:
+        // prepare,<misc_name>,<cow_device_path>,<backing_device>,<base_path_merge>
+        //
+        // Same as init, but the handler is set up in the background while the
+        // client maps other partitions. The init that follows collects it.
+        if (out.size() != 5) {
+            LOG(ERROR) << "Malformed prepare message, " << out.size() << " parts";
+            return Sendmsg(fd, "fail");
+        }
+        if (!PrepareHandler(out)) {
+            return Sendmsg(fd, "fail");
+        }
+        return Sendmsg(fd, "success");
     } else if (cmd == "start") {
         // Message format:
         // start,<misc_name>
@@ -192,7 +208,8 @@ bool UserSnapshotServer::Receivemsg(android::base::borrowed_fd fd, const std::st
             LOG(ERROR) << "Malformed supports message, " << out.size() << " parts";
             return Sendmsg(fd, "fail");
         }
-        if (out[1] == "second_stage_socket_handoff") {
+        if (out[1] == "second_stage_socket_handoff" || out[1] == "merge_progress_events" ||
+            out[1] == "prepare") {
             return Sendmsg(fd, "success");
         }
         return Sendmsg(fd, "fail");
@@ -211,6 +228,8 @@ bool UserSnapshotServer::Receivemsg(android::base::borrowed_fd fd, const std::st
     } else if (cmd == "merge_percent") {
         double percentage = handlers_->GetMergePercentage();
         return Sendmsg(fd, std::to_string(percentage));
+    } else if (cmd == "wait_merge_progress") {
+        return WaitForMergeProgress(fd, out);
     } else if (cmd == "getstatus") {
         // Message format:
         // getstatus,<misc_name>
@@ -223,6 +242,50 @@ bool UserSnapshotServer::Receivemsg(android::base::borrowed_fd fd, const std::st
             return Sendmsg(fd, "snapshot-merge-failed");
         }
         return Sendmsg(fd, status);
+    } else if (cmd == "cache_stats") {
+        // Message format:
+        // cache_stats,<misc_name>
+        if (out.size() != 2) {
+            LOG(ERROR) << "Malformed cache_stats message, " << out.size() << " parts";
+            return Sendmsg(fd, "fail");
+        }
+        auto stats = handlers_->GetCacheStats(out[1]);
+        if (stats.empty()) {
+            return Sendmsg(fd, "fail");
+        }
+        return Sendmsg(fd, stats);
+    } else if (cmd == "merge_stats") {
+        // Message format:
+        // merge_stats,<misc_name>
+        if (out.size() != 2) {
+            LOG(ERROR) << "Malformed merge_stats message, " << out.size() << " parts";
+            return Sendmsg(fd, "fail");
+        }
+        auto stats = handlers_->GetMergeStats(out[1]);
+        if (stats.empty()) {
+            return Sendmsg(fd, "fail");
+        }
+        return Sendmsg(fd, stats);
+    } else if (cmd == "merge_throttle") {
+        return Sendmsg(fd, handlers_->GetMergeThrottleStats());
+    } else if (cmd == "latency_stages") {
+        std::vector<std::string> stages;
+        for (size_t i = 0; i < static_cast<size_t>(IoStage::kNumStages); i++) {
+            stages.emplace_back(IoStageName(static_cast<IoStage>(i)));
+        }
+        return Sendmsg(fd, android::base::Join(stages, ","));
+    } else if (cmd == "latency_stats") {
+        // Message format:
+        // latency_stats,<stage>
+        if (out.size() != 2) {
+            LOG(ERROR) << "Malformed latency_stats message, " << out.size() << " parts";
+            return Sendmsg(fd, "fail");
+        }
+        auto histogram = SnapuserdStats::Get().FindHistogram(out[1]);
+        if (!histogram) {
+            return Sendmsg(fd, "fail");
+        }
+        return Sendmsg(fd, histogram->ToString());
     } else if (cmd == "update-verify") {
         if (!handlers_->GetVerificationStatus()) {
             return Sendmsg(fd, "fail");
@@ -235,6 +298,82 @@ bool UserSnapshotServer::Receivemsg(android::base::borrowed_fd fd, const std::st
     }
 }
 
+bool UserSnapshotServer::WaitForMergeProgress(android::base::borrowed_fd fd,
+                                              const std::vector<std::string>& out) {
+    // Message format:
+    // wait_merge_progress,<percentage>,<state-changes>
+    //
+    // The arguments are the values from the client's previous reply (or
+    // zero). The reply, "<percentage>,<state-changes>", is deferred until
+    // the merge has moved on from them. If no merge is running, "idle" is
+    // returned right away.
+    MergeProgressWaiter waiter = {.fd = fd.get()};
+    if (out.size() != 3 || !android::base::ParseDouble(out[1], &waiter.percentage) ||
+        !android::base::ParseUint(out[2], &waiter.state_changes)) {
+        LOG(ERROR) << "Malformed wait_merge_progress message, " << out.size() << " parts";
+        return Sendmsg(fd, "fail");
+    }
+
+    bool replied;
+    if (!MaybeReplyMergeProgress(waiter, &replied)) {
+        return false;
+    }
+    if (!replied) {
+        merge_waiters_.emplace_back(waiter);
+    }
+    return true;
+}
+
+bool UserSnapshotServer::MaybeReplyMergeProgress(const MergeProgressWaiter& waiter,
+                                                 bool* replied) {
+    *replied = true;
+
+    // Read the state first, so that a change racing with the percentage is
+    // reported by the next event rather than lost.
+    uint64_t state_changes = handlers_->GetMergeStateChanges();
+    double percentage = handlers_->GetMergePercentage();
+    if (state_changes == waiter.state_changes) {
+        if (!handlers_->IsMergeInProgress()) {
+            return Sendmsg(waiter.fd, "idle");
+        }
+        if (std::abs(percentage - waiter.percentage) < kMergeProgressStep) {
+            *replied = false;
+            return true;
+        }
+    }
+    return Sendmsg(waiter.fd, std::to_string(percentage) + "," + std::to_string(state_changes));
+}
+
+void UserSnapshotServer::HandleMergeEvent() {
+    uint64_t events;
+    ssize_t rv = TEMP_FAILURE_RETRY(
+            read(handlers_->GetMergeEventFd().get(), &events, sizeof(events)));
+    if (rv < 0 && errno != EAGAIN) {
+        PLOG(ERROR) << "Failed to read merge event fd";
+    }
+
+    auto iter = merge_waiters_.begin();
+    while (iter != merge_waiters_.end()) {
+        bool replied;
+        if (!MaybeReplyMergeProgress(*iter, &replied)) {
+            // Let poll() report the hangup so that Run() drops the client.
+            shutdown(iter->fd, SHUT_RDWR);
+            replied = true;
+        }
+        if (replied) {
+            iter = merge_waiters_.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+}
+
+void UserSnapshotServer::RemoveMergeWaiter(int fd) {
+    merge_waiters_.erase(std::remove_if(merge_waiters_.begin(), merge_waiters_.end(),
+                                        [fd](const auto& waiter) { return waiter.fd == fd; }),
+                         merge_waiters_.end());
+}
+
 bool UserSnapshotServer::Start(const std::string& socketname) {
     bool start_listening = true;
 
@@ -258,6 +397,7 @@ bool UserSnapshotServer::StartWithSocket(bool start_listening) {
     }
 
     AddWatchedFd(sockfd_, POLLIN);
+    AddWatchedFd(handlers_->GetMergeEventFd(), POLLIN);
     is_socket_present_ = true;
 
     // If started in first-stage init, the property service won't be online.
@@ -288,10 +428,14 @@ bool UserSnapshotServer::Run() {
         if (watched_fds_[0].revents) {
             AcceptClient();
         }
+        if (watched_fds_[1].revents) {
+            HandleMergeEvent();
+        }
 
-        auto iter = watched_fds_.begin() + 1;
+        auto iter = watched_fds_.begin() + kFirstClientIndex;
         while (iter != watched_fds_.end()) {
             if (iter->revents && !HandleClient(iter->fd, iter->revents)) {
+                RemoveMergeWaiter(iter->fd);
                 close(iter->fd);
                 iter = watched_fds_.erase(iter);
             } else {
@@ -372,6 +516,56 @@ std::shared_ptr<HandlerThread> UserSnapshotServer::AddHandler(const std::string&
                                  opener, num_worker_threads, io_uring_enabled_, o_direct);
 }
 
+bool UserSnapshotServer::PrepareHandler(const std::vector<std::string>& out) {
+    const auto& misc_name = out[1];
+    if (prepared_handlers_.count(misc_name)) {
+        LOG(ERROR) << "Handler is already being prepared: " << misc_name;
+        return false;
+    }
+
+    auto task = [this, out]() -> std::shared_ptr<HandlerThread> {
+        {
+            std::unique_lock<std::mutex> lock(init_lock_);
+            init_cv_.wait(lock, [this]() -> bool {
+                return active_inits_ < kMaxConcurrentHandlerInits;
+            });
+            active_inits_++;
+        }
+        auto handler = AddHandler(out[1], out[2], out[3], out[4]);
+        {
+            std::lock_guard<std::mutex> lock(init_lock_);
+            active_inits_--;
+        }
+        init_cv_.notify_one();
+        return handler;
+    };
+    prepared_handlers_[misc_name] = {
+            .args = out,
+            .handler = std::async(std::launch::async, std::move(task)).share(),
+    };
+    return true;
+}
+
+std::shared_ptr<HandlerThread> UserSnapshotServer::InitHandler(
+        const std::vector<std::string>& out) {
+    auto iter = prepared_handlers_.find(out[1]);
+    if (iter == prepared_handlers_.end()) {
+        return AddHandler(out[1], out[2], out[3], out[4]);
+    }
+
+    auto prepared = std::move(iter->second);
+    prepared_handlers_.erase(iter);
+
+    // Wait for this partition only; the others keep initializing.
+    auto handler = prepared.handler.get();
+    if (!std::equal(out.begin() + 1, out.end(), prepared.args.begin() + 1,
+                    prepared.args.end())) {
+        LOG(ERROR) << "init does not match the prepared handler: " << out[1];
+        return nullptr;
+    }
+    return handler;
+}
+
 bool UserSnapshotServer::WaitForSocket() {
     auto scope_guard =
             android::base::make_scope_guard([this]() -> void { handlers_->JoinAllThreads(); });
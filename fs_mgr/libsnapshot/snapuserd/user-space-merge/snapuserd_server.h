@@ -17,6 +17,9 @@
 #include <poll.h>
 #include <sys/eventfd.h>
 
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <functional>
@@ -28,6 +31,7 @@
 #include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/unique_fd.h>
@@ -40,15 +44,42 @@ namespace snapshot {
 
 static constexpr uint32_t kMaxPacketSize = 512;
 
+// A client waiting on "wait_merge_progress" is answered once the merge
+// percentage moves by at least this much, or the merge state changes.
+static constexpr double kMergeProgressStep = 1.0;
+
+// Number of handlers that "prepare" initializes at the same time.
+static constexpr size_t kMaxConcurrentHandlerInits = 4;
+
 static constexpr char kBootSnapshotsWithoutSlotSwitch[] =
         "/metadata/ota/snapshot-boot-without-slot-switch";
 
 class UserSnapshotServer {
   private:
+    // A client whose "wait_merge_progress" request is parked until there is
+    // merge progress to report.
+    struct MergeProgressWaiter {
+        int fd;
+        double percentage;
+        uint64_t state_changes;
+    };
+
+    // A handler being initialized in the background on behalf of "prepare",
+    // until the matching "init" collects it.
+    struct PreparedHandler {
+        std::vector<std::string> args;
+        std::shared_future<std::shared_ptr<HandlerThread>> handler;
+    };
+
+    // watched_fds_[0] is the listening socket and watched_fds_[1] the merge
+    // event fd; clients follow.
+    static constexpr size_t kFirstClientIndex = 2;
+
     android::base::unique_fd sockfd_;
     bool terminating_;
     volatile bool received_socket_signal_ = false;
     std::vector<struct pollfd> watched_fds_;
+    std::vector<MergeProgressWaiter> merge_waiters_;
     bool is_socket_present_ = false;
     bool is_server_running_ = false;
     bool io_uring_enabled_ = false;
@@ -57,12 +88,24 @@ class UserSnapshotServer {
 
     std::mutex lock_;
 
+    std::mutex init_lock_;
+    std::condition_variable init_cv_;
+    size_t active_inits_ = 0;
+    // Declared last: destroying it waits for the initializations in flight.
+    std::unordered_map<std::string, PreparedHandler> prepared_handlers_;
+
     void AddWatchedFd(android::base::borrowed_fd fd, int events);
     void AcceptClient();
     bool HandleClient(android::base::borrowed_fd fd, int revents);
     bool Recv(android::base::borrowed_fd fd, std::string* data);
     bool Sendmsg(android::base::borrowed_fd fd, const std::string& msg);
     bool Receivemsg(android::base::borrowed_fd fd, const std::string& str);
+    bool WaitForMergeProgress(android::base::borrowed_fd fd, const std::vector<std::string>& out);
+    bool MaybeReplyMergeProgress(const MergeProgressWaiter& waiter, bool* replied);
+    void HandleMergeEvent();
+    bool PrepareHandler(const std::vector<std::string>& out);
+    std::shared_ptr<HandlerThread> InitHandler(const std::vector<std::string>& out);
+    void RemoveMergeWaiter(int fd);
 
     void ShutdownThreads();
     std::string GetDaemonStatus();
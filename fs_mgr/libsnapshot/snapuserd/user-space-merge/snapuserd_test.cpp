@@ -12,21 +12,26 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <android-base/parseint.h>
 #include <android-base/strings.h>
 #include <gflags/gflags.h>
 
 #include <fcntl.h>
 #include <linux/fs.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <set>
 #include <string_view>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/properties.h>
@@ -736,13 +741,12 @@ void SnapuserdTest::InitDaemon() {
 }
 
 void SnapuserdTest::CheckMergeCompletion() {
-    while (true) {
-        double percentage = handlers_->GetMergePercentage();
-        if ((int)percentage == 100) {
-            break;
-        }
-
-        std::this_thread::sleep_for(1s);
+    struct pollfd pfd = {.fd = handlers_->GetMergeEventFd().get(), .events = POLLIN};
+    while ((int)handlers_->GetMergePercentage() != 100) {
+        // Each committed merge batch signals the event fd.
+        ASSERT_GE(TEMP_FAILURE_RETRY(poll(&pfd, 1, -1)), 0);
+        uint64_t events;
+        (void)TEMP_FAILURE_RETRY(read(pfd.fd, &events, sizeof(events)));
     }
 }
 
@@ -931,6 +935,20 @@ TEST_P(SnapuserdTest, Snapshot_COPY_Overlap_TEST_2) {
     ValidateMerge();
 }
 
+TEST_P(SnapuserdTest, Snapshot_Merge_Stats) {
+    ASSERT_NO_FATAL_FAILURE(SetupCopyOverlap_1());
+    ASSERT_TRUE(Merge());
+    ValidateMerge();
+
+    auto parts = android::base::Split(handlers_->GetMergeStats(system_device_ctrl_name_), ",");
+    ASSERT_EQ(parts.size(), 8 + kNumMergeIoTransitions);
+    uint64_t merged_ops, copy_ops;
+    ASSERT_TRUE(android::base::ParseUint(parts[0], &merged_ops));
+    ASSERT_TRUE(android::base::ParseUint(parts[4], &copy_ops));
+    ASSERT_GT(merged_ops, 0);
+    ASSERT_GT(copy_ops, 0);
+}
+
 TEST_P(SnapuserdTest, Snapshot_COPY_Overlap_Merge_Resume_TEST) {
     ASSERT_NO_FATAL_FAILURE(SetupCopyOverlap_1());
     ASSERT_NO_FATAL_FAILURE(MergeInterrupt());
@@ -1458,6 +1476,204 @@ TEST_P(HandlerTestV3, Read) {
               0);
 }
 
+TEST(BlockCacheTest, LruEviction) {
+    // Single shard so that eviction order is deterministic.
+    BlockCache cache(2, 1);
+    std::string block1(BLOCK_SZ, 'a');
+    std::string block2(BLOCK_SZ, 'b');
+    std::string block3(BLOCK_SZ, 'c');
+    std::string out(BLOCK_SZ, 0);
+
+    cache.Put(1, block1.data());
+    cache.Put(2, block2.data());
+    ASSERT_TRUE(cache.Get(1, out.data()));
+    ASSERT_EQ(out, block1);
+
+    // Block 2 is the least recently used entry.
+    cache.Put(3, block3.data());
+    ASSERT_FALSE(cache.Get(2, out.data()));
+    ASSERT_TRUE(cache.Get(3, out.data()));
+    ASSERT_EQ(out, block3);
+    ASSERT_EQ(cache.size(), 2);
+
+    cache.Invalidate(1);
+    ASSERT_FALSE(cache.Get(1, out.data()));
+    ASSERT_EQ(cache.size(), 1);
+
+    ASSERT_EQ(cache.hits(), 2);
+    ASSERT_EQ(cache.misses(), 2);
+}
+
+TEST(BootProfileTest, EncodeDecode) {
+    std::vector<uint64_t> blocks = {100, 101, 102, 7, 1ULL << 40, 0, 103};
+    std::string data = BootProfile::Encode(42, blocks);
+
+    std::vector<uint64_t> decoded;
+    ASSERT_TRUE(BootProfile::Decode(data, 42, &decoded));
+    ASSERT_EQ(decoded, blocks);
+
+    // Sequential runs take one byte per block.
+    std::string sequential = BootProfile::Encode(42, {1, 2, 3, 4});
+    ASSERT_EQ(sequential.size(), 20 + 4);
+
+    // Stale or damaged profiles are rejected.
+    ASSERT_FALSE(BootProfile::Decode(data, 43, &decoded));
+    ASSERT_FALSE(BootProfile::Decode(data.substr(0, data.size() - 1), 42, &decoded));
+    ASSERT_FALSE(BootProfile::Decode(data + "x", 42, &decoded));
+    ASSERT_FALSE(BootProfile::Decode("", 42, &decoded));
+}
+
+TEST(BootProfileTest, RecordAndReplay) {
+    TemporaryDir dir;
+    std::string path = std::string(dir.path) + "/profile/system_b";
+
+    BootProfile recorder(path, 7, 2);
+    ASSERT_FALSE(recorder.Load());
+    recorder.StartRecording();
+    for (uint64_t block : {5, 6, 5, 9, 6, 1}) {
+        recorder.OnBlockRead(block);
+    }
+    recorder.Finish();
+    // Reads after the profile is finished are not recorded.
+    recorder.OnBlockRead(10);
+
+    BootProfile stale(path, 8, 2);
+    ASSERT_FALSE(stale.Load());
+
+    BootProfile replay(path, 7, 2);
+    ASSERT_TRUE(replay.Load());
+    ASSERT_TRUE(replay.replaying());
+    ASSERT_EQ(replay.blocks(), std::vector<uint64_t>({5, 6, 9, 1}));
+
+    // The prefetcher may run |window| entries ahead of the reads.
+    ASSERT_TRUE(replay.WaitForTurn(0));
+    ASSERT_TRUE(replay.WaitForTurn(1));
+    std::atomic<bool> done = false;
+    std::thread prefetcher([&] {
+        ASSERT_TRUE(replay.WaitForTurn(3));
+        done = true;
+    });
+    std::this_thread::sleep_for(50ms);
+    ASSERT_FALSE(done);
+    replay.OnBlockRead(6);
+    prefetcher.join();
+    ASSERT_TRUE(done);
+
+    replay.Finish();
+    ASSERT_FALSE(replay.WaitForTurn(3));
+}
+
+TEST(BootProfileTest, GetPath) {
+    ASSERT_EQ(BootProfile::GetPath("system_b-init"), BootProfile::GetPath("system_b"));
+    ASSERT_NE(BootProfile::GetPath("system_b"), BootProfile::GetPath("vendor_b"));
+}
+
+TEST(BufferSinkTest, PayloadAlignment) {
+    BufferSink sink;
+    sink.Initialize(BLOCK_SZ * 4);
+
+    auto header = reinterpret_cast<uintptr_t>(sink.GetHeaderPtr());
+    auto payload = reinterpret_cast<uintptr_t>(sink.GetPayloadBufPtr());
+    ASSERT_EQ(payload % getpagesize(), 0);
+    ASSERT_EQ(header + sizeof(struct dm_user_header), payload);
+
+    // Every block handed out for the response stays block aligned.
+    for (int i = 0; i < 4; i++) {
+        auto block = reinterpret_cast<uintptr_t>(sink.AcquireBuffer(BLOCK_SZ));
+        ASSERT_NE(block, 0);
+        ASSERT_EQ(block % BLOCK_SZ, 0);
+    }
+    ASSERT_EQ(sink.AcquireBuffer(BLOCK_SZ), nullptr);
+}
+
+TEST(MergeThrottleTest, ParsePsi) {
+    double avg10;
+    ASSERT_TRUE(MergeThrottle::ParsePsiAvg10(
+            "some avg10=12.50 avg60=3.00 avg300=1.00 total=1234\n"
+            "full avg10=1.00 avg60=0.00 avg300=0.00 total=12\n",
+            &avg10));
+    ASSERT_EQ(avg10, 12.5);
+    ASSERT_FALSE(MergeThrottle::ParsePsiAvg10("", &avg10));
+    ASSERT_FALSE(MergeThrottle::ParsePsiAvg10("full avg10=1.00", &avg10));
+}
+
+TEST(MergeThrottleTest, BackOffUnderPressure) {
+    TemporaryFile psi;
+    ASSERT_TRUE(android::base::WriteStringToFile(
+            "some avg10=50.00 avg60=0.00 avg300=0.00 total=0\n", psi.path));
+
+    MergeThrottle throttle(256, psi.path);
+    std::chrono::milliseconds delay;
+    ASSERT_EQ(throttle.NextBatch(&delay), 128);
+    ASSERT_GT(delay.count(), 0);
+
+    // Pressure is gone; the next sample lets the merge speed up again.
+    ASSERT_TRUE(android::base::WriteStringToFile(
+            "some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n", psi.path));
+    std::this_thread::sleep_for(150ms);
+    ASSERT_GT(throttle.NextBatch(&delay), 128);
+    ASSERT_EQ(delay.count(), 0);
+}
+
+TEST(SnapuserdStatsTest, LatencyHistogram) {
+    LatencyHistogram histogram;
+    histogram.Record(500ns);
+    histogram.Record(1us);
+    histogram.Record(3us);
+    histogram.Record(10s);
+
+    auto parts = android::base::Split(histogram.ToString(), ",");
+    ASSERT_EQ(parts.size(), 2 + LatencyHistogram::kNumBuckets);
+    ASSERT_EQ(parts[0], "4");
+    ASSERT_EQ(parts[1], "10000004");
+    ASSERT_EQ(parts[2], "1");
+    ASSERT_EQ(parts[3], "1");
+    ASSERT_EQ(parts[4], "1");
+    // Anything beyond the range lands in the last bucket.
+    ASSERT_EQ(parts.back(), "1");
+
+    ASSERT_NE(SnapuserdStats::Get().FindHistogram("decompress"), nullptr);
+    ASSERT_EQ(SnapuserdStats::Get().FindHistogram("bogus"), nullptr);
+}
+
+TEST(BlockIndexTest, MatchesLowerBound) {
+    // Blocks 2, 5, 6 and 9, where block 5 is a replace op compressed over
+    // two blocks (5 and 6) and therefore has a single chunk.
+    std::vector<CowOperation> ops(3);
+    memset(ops.data(), 0, ops.size() * sizeof(CowOperation));
+    ops[0].new_block = 2;
+    ops[0].set_type(kCowCopyOp);
+    ops[1].new_block = 5;
+    ops[1].set_type(kCowReplaceOp);
+    ops[1].set_compression_bits(1);
+    ops[2].new_block = 9;
+    ops[2].set_type(kCowZeroOp);
+
+    BlockIndex::ChunkVec chunks;
+    for (const auto& op : ops) {
+        chunks.emplace_back(op.new_block << CHUNK_SHIFT, &op);
+    }
+    BlockIndex index;
+    index.Build(chunks);
+
+    for (sector_t sector = 0; sector < (12 << CHUNK_SHIFT); sector++) {
+        auto it = std::lower_bound(chunks.begin(), chunks.end(), std::make_pair(sector, nullptr),
+                                   SnapshotHandler::compare);
+        ASSERT_EQ(index.LowerBound(sector), static_cast<size_t>(it - chunks.begin()))
+                << "sector " << sector;
+    }
+
+    std::set<uint64_t> mapped = {2, 5, 6, 9};
+    for (uint64_t block = 0; block < 12; block++) {
+        ASSERT_EQ(index.ContainsBlock(block), mapped.count(block) != 0) << "block " << block;
+    }
+
+    BlockIndex empty;
+    empty.Build({});
+    ASSERT_EQ(empty.LowerBound(0), 0u);
+    ASSERT_FALSE(empty.ContainsBlock(0));
+}
+
 std::vector<bool> GetIoUringConfigs() {
 #if __ANDROID__
     if (!android::base::GetBoolProperty("ro.virtual_ab.io_uring.enabled", false)) {
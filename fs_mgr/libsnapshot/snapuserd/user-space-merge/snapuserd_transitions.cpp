@@ -178,15 +178,33 @@ void SnapshotHandler::InitiateMerge() {
     {
         std::lock_guard<std::mutex> lock(lock_);
         merge_initiated_ = true;
+        io_state_since_ = std::chrono::steady_clock::now();
 
         // If there are only REPLACE ops to be merged, then we need
         // to explicitly set the state to MERGE_BEGIN as there
         // is no read-ahead thread
         if (!ra_thread_) {
-            io_state_ = MERGE_IO_TRANSITION::MERGE_BEGIN;
+            SetIoState(MERGE_IO_TRANSITION::MERGE_BEGIN);
         }
     }
     cv.notify_all();
+
+    // Boot is complete: the profile recorded so far covers it.
+    if (boot_profile_) {
+        boot_profile_->Finish();
+    }
+
+    ParkReadWorkers();
+}
+
+// Must be called with lock_ held.
+void SnapshotHandler::SetIoState(MERGE_IO_TRANSITION state) {
+    if (merge_initiated_) {
+        auto now = std::chrono::steady_clock::now();
+        io_state_time_[static_cast<size_t>(io_state_)] += now - io_state_since_;
+        io_state_since_ = now;
+    }
+    io_state_ = state;
 }
 
 static inline bool IsMergeBeginError(MERGE_IO_TRANSITION io_state) {
@@ -249,7 +267,7 @@ bool SnapshotHandler::ReadAheadIOCompleted(bool sync) {
         std::lock_guard<std::mutex> lock(lock_);
         if (io_state_ != MERGE_IO_TRANSITION::IO_TERMINATED &&
             io_state_ != MERGE_IO_TRANSITION::MERGE_FAILED) {
-            io_state_ = MERGE_IO_TRANSITION::MERGE_BEGIN;
+            SetIoState(MERGE_IO_TRANSITION::MERGE_BEGIN);
         }
     }
 
@@ -290,7 +308,7 @@ void SnapshotHandler::NotifyRAForMergeReady() {
         std::lock_guard<std::mutex> lock(lock_);
         if (io_state_ != MERGE_IO_TRANSITION::IO_TERMINATED &&
             io_state_ != MERGE_IO_TRANSITION::READ_AHEAD_FAILURE) {
-            io_state_ = MERGE_IO_TRANSITION::MERGE_READY;
+            SetIoState(MERGE_IO_TRANSITION::MERGE_READY);
         }
     }
 
@@ -301,19 +319,21 @@ void SnapshotHandler::NotifyRAForMergeReady() {
 void SnapshotHandler::MergeFailed() {
     {
         std::lock_guard<std::mutex> lock(lock_);
-        io_state_ = MERGE_IO_TRANSITION::MERGE_FAILED;
+        SetIoState(MERGE_IO_TRANSITION::MERGE_FAILED);
     }
 
     cv.notify_all();
+    NotifyMergeProgress(true);
 }
 
 void SnapshotHandler::MergeCompleted() {
     {
         std::lock_guard<std::mutex> lock(lock_);
-        io_state_ = MERGE_IO_TRANSITION::MERGE_COMPLETE;
+        SetIoState(MERGE_IO_TRANSITION::MERGE_COMPLETE);
     }
 
     cv.notify_all();
+    NotifyMergeProgress(true);
 }
 
 // This is invoked by worker threads.
@@ -336,7 +356,7 @@ void SnapshotHandler::MergeCompleted() {
 void SnapshotHandler::NotifyIOTerminated() {
     {
         std::lock_guard<std::mutex> lock(lock_);
-        io_state_ = MERGE_IO_TRANSITION::IO_TERMINATED;
+        SetIoState(MERGE_IO_TRANSITION::IO_TERMINATED);
     }
 
     cv.notify_all();
@@ -351,7 +371,7 @@ bool SnapshotHandler::IsIOTerminated() {
 void SnapshotHandler::ReadAheadIOFailed() {
     {
         std::lock_guard<std::mutex> lock(lock_);
-        io_state_ = MERGE_IO_TRANSITION::READ_AHEAD_FAILURE;
+        SetIoState(MERGE_IO_TRANSITION::READ_AHEAD_FAILURE);
     }
 
     cv.notify_all();
@@ -564,6 +584,11 @@ void SnapshotHandler::SetMergeCompleted(size_t ra_index) {
         // from base device
         blk_state->merge_state_ = MERGE_GROUP_STATE::GROUP_MERGE_COMPLETED;
     }
+
+    // Cached COW data of this group is no longer needed.
+    for (uint64_t new_block : blk_state->blocks) {
+        block_cache_->Invalidate(new_block);
+    }
 }
 
 // Invoked by Merge thread. This is called just before the beginning
@@ -670,8 +695,10 @@ MERGE_GROUP_STATE SnapshotHandler::ProcessMergingBlock(uint64_t new_block, void*
                 // higher precedence than from source device for overlapping
                 // blocks.
                 if (resume_merge_ && GetRABuffer(&lock, new_block, buffer)) {
+                    ra_hits_ += 1;
                     return (MERGE_GROUP_STATE::GROUP_MERGE_IN_PROGRESS);
                 }
+                ra_misses_ += 1;
                 blk_state->num_ios_in_progress += 1;  // ref count
                 [[fallthrough]];
             }
@@ -689,6 +716,7 @@ MERGE_GROUP_STATE SnapshotHandler::ProcessMergingBlock(uint64_t new_block, void*
                 if (!GetRABuffer(&lock, new_block, buffer)) {
                     return MERGE_GROUP_STATE::GROUP_INVALID;
                 }
+                ra_hits_ += 1;
                 return state;
             }
             default: {
@@ -16,12 +16,20 @@
 
 #include "snapuserd_verify.h"
 
+#include <sys/stat.h>
+
+#include <thread>
+
 #include <android-base/chrono_utils.h>
+#include <android-base/file.h>
+#include <android-base/parseint.h>
 #include <android-base/scopeguard.h>
 #include <android-base/strings.h>
+#include <snapuserd/snapuserd_client.h>
 
 #include "android-base/properties.h"
 #include "snapuserd_core.h"
+#include "utility.h"
 
 namespace android {
 namespace snapshot {
@@ -95,16 +103,86 @@ void UpdateVerify::VerifyUpdatePartition() {
     succeeded = true;
 }
 
-bool UpdateVerify::VerifyBlocks(const std::string& partition_name,
-                                const std::string& dm_block_device, off_t offset, int skip_blocks,
-                                uint64_t dev_sz) {
+std::string UpdateVerify::GetCheckpointPath(const std::string& partition_name) {
+    return std::string("/metadata/ota/") + kVerifyCheckpointDir + "/" + partition_name;
+}
+
+uint64_t UpdateVerify::ReadCheckpoint(const std::string& partition_name, uint64_t dev_sz) {
+    std::string content;
+    if (!android::base::ReadFileToString(GetCheckpointPath(partition_name), &content)) {
+        return 0;
+    }
+
+    // The checkpoint is "<device size> <verified bytes>". A size mismatch means
+    // it was left behind by a different update.
+    auto fields = android::base::Split(android::base::Trim(content), " ");
+    uint64_t size, verified;
+    if (fields.size() != 2 || !android::base::ParseUint(fields[0], &size) ||
+        !android::base::ParseUint(fields[1], &verified) || size != dev_sz || verified > dev_sz ||
+        !IsBlockAligned(verified)) {
+        SNAP_LOG(WARNING) << "Ignoring verification checkpoint for " << partition_name << ": "
+                          << content;
+        return 0;
+    }
+    return verified;
+}
+
+void UpdateVerify::WriteCheckpoint(const std::string& partition_name, uint64_t dev_sz,
+                                   uint64_t verified) {
+    // Checkpoints are best effort: losing one only means that the next boot
+    // reads some blocks again.
+    std::string dir = std::string("/metadata/ota/") + kVerifyCheckpointDir;
+    if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+        SNAP_PLOG(WARNING) << "mkdir failed: " << dir;
+        return;
+    }
+
+    std::string path = GetCheckpointPath(partition_name);
+    std::string tmp_path = path + ".tmp";
+    std::string content = std::to_string(dev_sz) + " " + std::to_string(verified) + "\n";
+    if (!android::base::WriteStringToFile(content, tmp_path) ||
+        rename(tmp_path.c_str(), path.c_str()) < 0) {
+        SNAP_PLOG(WARNING) << "Failed to write verification checkpoint: " << path;
+        unlink(tmp_path.c_str());
+    }
+}
+
+void UpdateVerify::CompleteChunk(VerifyProgress* progress, uint64_t chunk) {
+    std::lock_guard<std::mutex> lock(progress->lock);
+    progress->done[chunk] = true;
+    if (chunk != progress->first_pending) {
+        return;
+    }
+    while (progress->first_pending < progress->num_chunks &&
+           progress->done[progress->first_pending]) {
+        progress->first_pending++;
+    }
+    progress->verified = std::min(progress->start + progress->first_pending * kCheckpointSize,
+                                  progress->dev_sz);
+
+    // Written with the lock held so that checkpoints never move backwards.
+    WriteCheckpoint(progress->partition_name, progress->dev_sz, progress->verified);
+}
+
+bool UpdateVerify::VerifyChunks(VerifyProgress* progress) {
+    const auto& partition_name = progress->partition_name;
+    const auto& dm_block_device = progress->dm_block_device;
+    const uint64_t dev_sz = progress->dev_sz;
+
+    // Verification runs while the device boots; keep it from competing with
+    // boot I/O if requested.
+    if (android::base::GetBoolProperty("ro.virtual_ab.verify_idle_io.enabled", false) &&
+        !SetThreadIdleIoPriority()) {
+        SNAP_PLOG(WARNING) << "Failed to set idle I/O priority for verification";
+    }
+
     unique_fd fd(TEMP_FAILURE_RETRY(open(dm_block_device.c_str(), O_RDONLY | O_DIRECT)));
     if (fd < 0) {
         SNAP_LOG(ERROR) << "open failed: " << dm_block_device;
+        progress->failed = true;
         return false;
     }
 
-    loff_t file_offset = offset;
     auto verify_block_size = android::base::GetUintProperty<uint>("ro.virtual_ab.verify_block_size",
                                                                   kBlockSizeVerify);
     const uint64_t read_sz = verify_block_size;
@@ -114,29 +192,53 @@ bool UpdateVerify::VerifyBlocks(const std::string& partition_name,
     if (posix_memalign(&addr, page_size, read_sz) < 0) {
         SNAP_PLOG(ERROR) << "posix_memalign failed "
                          << " page_size: " << page_size << " read_sz: " << read_sz;
+        progress->failed = true;
         return false;
     }
 
     std::unique_ptr<void, decltype(&::free)> buffer(addr, ::free);
 
-    uint64_t bytes_read = 0;
+    // Optional cap on the read bandwidth of the whole partition, in MiB/s,
+    // shared evenly between the threads.
+    const uint64_t max_bandwidth =
+            android::base::GetUintProperty<uint64_t>("ro.virtual_ab.verify_max_bandwidth_mbps", 0);
+    const uint64_t bytes_per_sec = max_bandwidth * 1_MiB / progress->num_threads;
 
-    while (true) {
-        size_t to_read = std::min((dev_sz - file_offset), read_sz);
+    android::base::Timer timer;
+    uint64_t bytes_read = 0;
 
-        if (!android::base::ReadFullyAtOffset(fd.get(), buffer.get(), to_read, file_offset)) {
-            SNAP_PLOG(ERROR) << "Failed to read block from block device: " << dm_block_device
-                             << " partition-name: " << partition_name
-                             << " at offset: " << file_offset << " read-size: " << to_read
-                             << " block-size: " << dev_sz;
-            return false;
+    while (!progress->failed) {
+        uint64_t chunk = progress->next_chunk++;
+        if (chunk >= progress->num_chunks) {
+            break;
         }
 
-        bytes_read += to_read;
-        file_offset += (skip_blocks * verify_block_size);
-        if (file_offset >= dev_sz) {
-            break;
+        uint64_t file_offset = progress->start + chunk * kCheckpointSize;
+        const uint64_t chunk_end = std::min(file_offset + kCheckpointSize, dev_sz);
+        while (file_offset < chunk_end) {
+            size_t to_read = std::min((chunk_end - file_offset), read_sz);
+
+            if (!android::base::ReadFullyAtOffset(fd.get(), buffer.get(), to_read, file_offset)) {
+                SNAP_PLOG(ERROR) << "Failed to read block from block device: " << dm_block_device
+                                 << " partition-name: " << partition_name
+                                 << " at offset: " << file_offset << " read-size: " << to_read
+                                 << " block-size: " << dev_sz;
+                progress->failed = true;
+                return false;
+            }
+
+            bytes_read += to_read;
+            file_offset += to_read;
+
+            if (bytes_per_sec) {
+                auto expected = std::chrono::milliseconds(bytes_read * 1000 / bytes_per_sec);
+                auto elapsed = timer.duration();
+                if (expected > elapsed) {
+                    std::this_thread::sleep_for(expected - elapsed);
+                }
+            }
         }
+        CompleteChunk(progress, chunk);
     }
 
     SNAP_LOG(DEBUG) << "Verification success with bytes-read: " << bytes_read
@@ -193,21 +295,30 @@ bool UpdateVerify::VerifyPartition(const std::string& partition_name,
         num_threads = kMaxThreadsToVerify;
     }
 
+    VerifyProgress progress;
+    progress.partition_name = partition_name;
+    progress.dm_block_device = dm_block_device;
+    progress.dev_sz = dev_sz;
+    progress.start = ReadCheckpoint(partition_name, dev_sz);
+    if (progress.start >= dev_sz) {
+        succeeded = true;
+        UpdatePartitionVerificationState(UpdateVerifyState::VERIFY_SUCCESS);
+        SNAP_LOG(INFO) << "Partition: " << partition_name
+                       << " was already verified by a previous boot";
+        return true;
+    }
+    if (progress.start) {
+        SNAP_LOG(INFO) << "Resuming verification of " << partition_name
+                       << " at offset: " << progress.start;
+    }
+    progress.num_chunks = (dev_sz - progress.start + kCheckpointSize - 1) / kCheckpointSize;
+    progress.done.resize(progress.num_chunks);
+    progress.num_threads = std::min<uint64_t>(num_threads, progress.num_chunks);
+
     std::vector<std::future<bool>> threads;
-    off_t start_offset = 0;
-    const int skip_blocks = num_threads;
-
-    auto verify_block_size =
-            android::base::GetUintProperty("ro.virtual_ab.verify_block_size", kBlockSizeVerify);
-    while (num_threads) {
-        threads.emplace_back(std::async(std::launch::async, &UpdateVerify::VerifyBlocks, this,
-                                        partition_name, dm_block_device, start_offset, skip_blocks,
-                                        dev_sz));
-        start_offset += verify_block_size;
-        num_threads -= 1;
-        if (start_offset >= dev_sz) {
-            break;
-        }
+    for (uint32_t i = 0; i < progress.num_threads; i++) {
+        threads.emplace_back(
+                std::async(std::launch::async, &UpdateVerify::VerifyChunks, this, &progress));
     }
 
     bool ret = true;
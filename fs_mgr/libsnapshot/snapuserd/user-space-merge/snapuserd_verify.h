@@ -18,9 +18,11 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include <snapuserd/snapuserd_kernel.h>
 #include <storage_literals/storage_literals.h>
@@ -43,6 +45,25 @@ class UpdateVerify {
         VERIFY_SUCCESS,
     };
 
+    // Verification of one partition. The device is split into checkpoint
+    // sized chunks which the threads pick up in order; |verified| is the
+    // length of the prefix of the device whose chunks have all been read.
+    struct VerifyProgress {
+        std::string partition_name;
+        std::string dm_block_device;
+        uint64_t dev_sz = 0;
+        uint64_t start = 0;
+        uint64_t num_chunks = 0;
+        uint32_t num_threads = 0;
+        std::atomic<uint64_t> next_chunk = 0;
+        std::atomic<bool> failed = false;
+
+        std::mutex lock;
+        std::vector<bool> done;
+        uint64_t first_pending = 0;
+        uint64_t verified = 0;
+    };
+
     std::string misc_name_;
     UpdateVerifyState state_;
     std::mutex m_lock_;
@@ -70,11 +91,23 @@ class UpdateVerify {
     uint64_t kThresholdSize = 750_MiB;
     uint64_t kBlockSizeVerify = 2_MiB;
 
+    /*
+     * Progress is written to /metadata/ota/snapuserd-verify every time another
+     * kCheckpointSize bytes from the start of the partition have been read.
+     * If the boot is interrupted, the next boot resumes from there rather than
+     * reading the partition again from the start.
+     */
+    uint64_t kCheckpointSize = 64_MiB;
+
     bool IsBlockAligned(uint64_t read_size) { return ((read_size & (BLOCK_SZ - 1)) == 0); }
     void UpdatePartitionVerificationState(UpdateVerifyState state);
     bool VerifyPartition(const std::string& partition_name, const std::string& dm_block_device);
-    bool VerifyBlocks(const std::string& partition_name, const std::string& dm_block_device,
-                      off_t offset, int skip_blocks, uint64_t dev_sz);
+    bool VerifyChunks(VerifyProgress* progress);
+    bool CompleteChunk(VerifyProgress* progress, uint64_t chunk);
+
+    std::string GetCheckpointPath(const std::string& partition_name);
+    uint64_t ReadCheckpoint(const std::string& partition_name, uint64_t dev_sz);
+    void WriteCheckpoint(const std::string& partition_name, uint64_t dev_sz, uint64_t verified);
 };
 
 }  // namespace snapshot
@@ -15,6 +15,7 @@
 #include "utility.h"
 
 #include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 
@@ -36,6 +37,19 @@ bool SetThreadPriority([[maybe_unused]] int priority) {
 #endif
 }
 
+bool SetThreadIdleIoPriority() {
+#ifdef __ANDROID__
+    // From linux/ioprio.h, which is not available in all uapi headers.
+    constexpr int kIoprioWhoProcess = 1;
+    constexpr int kIoprioClassIdle = 3;
+    constexpr int kIoprioClassShift = 13;
+    return syscall(SYS_ioprio_set, kIoprioWhoProcess, gettid(),
+                   kIoprioClassIdle << kIoprioClassShift) != -1;
+#else
+    return true;
+#endif
+}
+
 bool SetProfiles([[maybe_unused]] std::initializer_list<std::string_view> profiles) {
 #ifdef __ANDROID__
     if (setgid(AID_SYSTEM)) {
@@ -47,6 +61,16 @@ bool SetProfiles([[maybe_unused]] std::initializer_list<std::string_view> profil
 #endif
 }
 
+// Same as SetProfiles, but applies to another thread of this process.
+bool SetThreadProfiles([[maybe_unused]] pid_t tid,
+                       [[maybe_unused]] const std::vector<std::string>& profiles) {
+#ifdef __ANDROID__
+    return SetTaskProfiles(tid, profiles);
+#else
+    return true;
+#endif
+}
+
 bool KernelSupportsIoUring() {
     struct utsname uts {};
     unsigned int major, minor;
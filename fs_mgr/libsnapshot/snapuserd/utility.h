@@ -14,14 +14,22 @@
 
 #pragma once
 
+#include <sys/types.h>
+
 #include <initializer_list>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace android {
 namespace snapshot {
 
 bool SetThreadPriority(int priority);
+// Move the calling thread to the idle I/O scheduling class, so that its
+// reads are only served when the disk is otherwise idle.
+bool SetThreadIdleIoPriority();
 bool SetProfiles(std::initializer_list<std::string_view> profiles);
+bool SetThreadProfiles(pid_t tid, const std::vector<std::string>& profiles);
 bool KernelSupportsIoUring();
 
 }  // namespace snapshot
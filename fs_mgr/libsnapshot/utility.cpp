@@ -17,9 +17,13 @@
 #include <errno.h>
 #include <time.h>
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <future>
 #include <iomanip>
 #include <sstream>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -277,6 +281,39 @@ bool GetODirectEnabledProperty() {
     return fetcher->GetBoolProperty("ro.virtual_ab.o_direct.enabled", false);
 }
 
+bool GetParallelSnapshotCreationProperty() {
+    auto fetcher = IPropertyFetcher::GetInstance();
+    return fetcher->GetBoolProperty("ro.virtual_ab.parallel_snapshot_creation.enabled", false);
+}
+
+bool RunInParallel(size_t count, size_t max_threads, const std::function<bool(size_t)>& fn) {
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> failed = false;
+    auto worker = [&]() -> void {
+        while (!failed) {
+            size_t index = next++;
+            if (index >= count) {
+                return;
+            }
+            if (!fn(index)) {
+                failed = true;
+            }
+        }
+    };
+
+    // The calling thread is one of the workers.
+    size_t num_threads = std::clamp<size_t>(max_threads, 1, std::max<size_t>(count, 1));
+    std::vector<std::future<void>> threads;
+    for (size_t i = 1; i < num_threads; i++) {
+        threads.emplace_back(std::async(std::launch::async, worker));
+    }
+    worker();
+    for (auto& t : threads) {
+        t.get();
+    }
+    return !failed;
+}
+
 std::string GetOtherPartitionName(const std::string& name) {
     auto suffix = android::fs_mgr::GetPartitionSlotSuffix(name);
     CHECK(suffix == "_a" || suffix == "_b");
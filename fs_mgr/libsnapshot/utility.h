@@ -134,11 +134,18 @@ bool GetUserspaceSnapshotsEnabledProperty();
 bool GetIouringEnabledProperty();
 bool GetXorCompressionEnabledProperty();
 bool GetODirectEnabledProperty();
+bool GetParallelSnapshotCreationProperty();
 
 bool CanUseUserspaceSnapshots();
 bool IsDmSnapshotTestingEnabled();
 bool IsVendorFromAndroid12();
 
+// Call |fn| with every index in [0, count) from a pool of at most
+// |max_threads| threads. Once a call returns false, no further indices are
+// handed out; calls already running are allowed to finish. Returns true if
+// every call returned true.
+bool RunInParallel(size_t count, size_t max_threads, const std::function<bool(size_t)>& fn);
+
 // Swap the suffix of a partition name.
 std::string GetOtherPartitionName(const std::string& name);
 
@@ -73,12 +73,12 @@ Result<std::string> SuperVBMetaBuilder::ReadVBMetaImageFromFile(const std::strin
         return Error() << "vbmeta image file size " << file_size.value() << " is too large";
     }
 
-    std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(VBMETA_IMAGE_MAX_SIZE);
-    if (!android::base::ReadFully(source_fd, buffer.get(), file_size.value())) {
+    // Read straight into the zero-padded image rather than through a bounce buffer.
+    std::string content(VBMETA_IMAGE_MAX_SIZE, '\0');
+    if (!android::base::ReadFully(source_fd, content.data(), file_size.value())) {
         return ErrnoError() << "Couldn't read vbmeta image file " << file;
     }
-
-    return std::string(reinterpret_cast<const char*>(buffer.get()), VBMETA_IMAGE_MAX_SIZE);
+    return content;
 }
 
 Result<uint8_t> SuperVBMetaBuilder::GetEmptySlot() {
@@ -89,13 +89,9 @@ Result<uint8_t> SuperVBMetaBuilder::GetEmptySlot() {
 }
 
 Result<uint8_t> SuperVBMetaBuilder::AddVBMetaImage(const std::string& vbmeta_name) {
-    auto desc = std::find_if(
-            table_.descriptors.begin(), table_.descriptors.end(),
-            [&vbmeta_name](const auto& entry) { return entry.vbmeta_name == vbmeta_name; });
-
     uint8_t slot_number = 0;
-    if (desc != table_.descriptors.end()) {
-        slot_number = desc->vbmeta_index;
+    if (auto iter = slots_.find(vbmeta_name); iter != slots_.end()) {
+        slot_number = iter->second;
     } else {
         Result<uint8_t> new_slot = GetEmptySlot();
         if (!new_slot.ok()) {
@@ -113,21 +109,29 @@ Result<uint8_t> SuperVBMetaBuilder::AddVBMetaImage(const std::string& vbmeta_nam
 
         // mark slot as in use
         table_.header.in_use |= (1 << slot_number);
+        slots_.emplace(vbmeta_name, slot_number);
     }
 
     return slot_number;
 }
 
 void SuperVBMetaBuilder::DeleteVBMetaImage(const std::string& vbmeta_name) {
+    auto iter = slots_.find(vbmeta_name);
+    if (iter == slots_.end()) {
+        return;
+    }
+    const uint8_t slot_number = iter->second;
+    slots_.erase(iter);
+
+    // mark slot as not in use
+    table_.header.in_use &= ~(1 << slot_number);
+
+    // erase descriptor in table; slots are unique, so match on the index
+    // rather than comparing names.
     auto desc = std::find_if(
             table_.descriptors.begin(), table_.descriptors.end(),
-            [&vbmeta_name](const auto& entry) { return entry.vbmeta_name == vbmeta_name; });
-
+            [slot_number](const auto& entry) { return entry.vbmeta_index == slot_number; });
     if (desc != table_.descriptors.end()) {
-        // mark slot as not in use
-        table_.header.in_use &= ~(1 << desc->vbmeta_index);
-
-        // erase descriptor in table
         table_.descriptors.erase(desc);
     }
 }
@@ -49,6 +49,8 @@ class SuperVBMetaBuilder {
     VBMetaTable table_;
     // Maps vbmeta image name to vbmeta image file path.
     std::map<std::string, std::string> images_path_;
+    // Maps vbmeta image name to its slot in |table_|.
+    std::map<std::string, uint8_t> slots_;
 };
 
 }  // namespace fs_mgr
@@ -18,6 +18,8 @@
 
 #include <android-base/file.h>
 
+#include "utility.h"
+
 using android::base::ErrnoError;
 using android::base::Error;
 using android::base::Result;
@@ -41,45 +43,53 @@ Result<void> LoadAndVerifySuperVBMetaHeader(const void* buffer, SuperVBMetaHeade
     return {};
 }
 
-void LoadVBMetaDescriptors(const void* buffer, uint32_t size,
-                           std::vector<InternalVBMetaDescriptor>* descriptors) {
-    for (int p = 0; p < size;) {
+Result<void> LoadVBMetaDescriptors(const void* buffer, uint32_t size,
+                                   std::vector<InternalVBMetaDescriptor>* descriptors) {
+    const char* p = reinterpret_cast<const char*>(buffer);
+    const char* end = p + size;
+    while (p < end) {
+        if (static_cast<size_t>(end - p) < SUPER_VBMETA_DESCRIPTOR_SIZE) {
+            return Error() << "Super VBMeta descriptor is truncated";
+        }
         InternalVBMetaDescriptor descriptor;
-        memcpy(&descriptor, (char*)buffer + p, SUPER_VBMETA_DESCRIPTOR_SIZE);
+        memcpy(&descriptor, p, SUPER_VBMETA_DESCRIPTOR_SIZE);
         p += SUPER_VBMETA_DESCRIPTOR_SIZE;
 
-        descriptor.vbmeta_name = std::string((char*)buffer + p, descriptor.vbmeta_name_length);
+        if (static_cast<size_t>(end - p) < descriptor.vbmeta_name_length) {
+            return Error() << "Super VBMeta descriptor name is truncated";
+        }
+        descriptor.vbmeta_name.assign(p, descriptor.vbmeta_name_length);
         p += descriptor.vbmeta_name_length;
 
         descriptors->emplace_back(std::move(descriptor));
     }
+    return {};
 }
 
 Result<void> ReadVBMetaTable(int fd, uint64_t offset, VBMetaTable* table) {
-    std::unique_ptr<uint8_t[]> header_buffer =
-            std::make_unique<uint8_t[]>(SUPER_VBMETA_HEADER_SIZE);
-    if (!android::base::ReadFullyAtOffset(fd, header_buffer.get(), SUPER_VBMETA_HEADER_SIZE,
-                                          offset)) {
-        return ErrnoError() << "Couldn't read super vbmeta header at offset " << offset;
+    // The table occupies a fixed-size block, so read the header and the
+    // descriptors with a single pread instead of one for each.
+    std::string buffer(SUPER_VBMETA_TABLE_MAX_SIZE, '\0');
+    if (!android::base::ReadFullyAtOffset(fd, buffer.data(), buffer.size(), offset)) {
+        return ErrnoError() << "Couldn't read super vbmeta table at offset " << offset;
     }
 
-    Result<void> rv_header = LoadAndVerifySuperVBMetaHeader(header_buffer.get(), &table->header);
+    Result<void> rv_header = LoadAndVerifySuperVBMetaHeader(buffer.data(), &table->header);
     if (!rv_header.ok()) {
         return rv_header;
     }
 
-    const uint64_t descriptors_offset = offset + table->header.header_size;
-    std::unique_ptr<uint8_t[]> descriptors_buffer =
-            std::make_unique<uint8_t[]>(table->header.descriptors_size);
-    if (!android::base::ReadFullyAtOffset(fd, descriptors_buffer.get(),
-                                          table->header.descriptors_size, descriptors_offset)) {
-        return ErrnoError() << "Couldn't read super vbmeta descriptors at offset "
-                            << descriptors_offset;
+    const uint64_t descriptors_end =
+            uint64_t(table->header.header_size) + table->header.descriptors_size;
+    if (table->header.header_size < SUPER_VBMETA_HEADER_SIZE ||
+        descriptors_end > SUPER_VBMETA_TABLE_MAX_SIZE) {
+        return Error() << "Super VBMeta descriptors exceed the table size";
     }
 
-    LoadVBMetaDescriptors(descriptors_buffer.get(), table->header.descriptors_size,
-                          &table->descriptors);
-    return {};
+    table->descriptors.clear();
+    table->descriptors.reserve(table->header.descriptors_size / SUPER_VBMETA_DESCRIPTOR_SIZE);
+    return LoadVBMetaDescriptors(buffer.data() + table->header.header_size,
+                                 table->header.descriptors_size, &table->descriptors);
 }
 
 Result<void> ReadPrimaryVBMetaTable(int fd, VBMetaTable* table) {
@@ -93,12 +103,12 @@ Result<void> ReadBackupVBMetaTable(int fd, VBMetaTable* table) {
 }
 
 Result<std::string> ReadVBMetaImage(int fd, int slot) {
-    const uint64_t offset = 2 * SUPER_VBMETA_TABLE_MAX_SIZE + slot * VBMETA_IMAGE_MAX_SIZE;
-    std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(VBMETA_IMAGE_MAX_SIZE);
-    if (!android::base::ReadFullyAtOffset(fd, buffer.get(), VBMETA_IMAGE_MAX_SIZE, offset)) {
+    const uint64_t offset = IndexOffset(slot);
+    std::string content(VBMETA_IMAGE_MAX_SIZE, '\0');
+    if (!android::base::ReadFullyAtOffset(fd, content.data(), content.size(), offset)) {
         return ErrnoError() << "Couldn't read vbmeta image at offset " << offset;
     }
-    return std::string(reinterpret_cast<char*>(buffer.get()), VBMETA_IMAGE_MAX_SIZE);
+    return content;
 }
 
 Result<void> ValidateVBMetaImage(int super_vbmeta_fd, int vbmeta_index,
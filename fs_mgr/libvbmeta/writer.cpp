@@ -28,6 +28,7 @@ namespace fs_mgr {
 
 std::string SerializeVBMetaTable(const VBMetaTable& input) {
     std::string table;
+    table.reserve(SUPER_VBMETA_TABLE_MAX_SIZE);
     table.append(reinterpret_cast<const char*>(&input.header), SUPER_VBMETA_HEADER_SIZE);
 
     for (const auto& desc : input.descriptors) {
@@ -15,6 +15,7 @@
 #include <chrono>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/unique_fd.h>
@@ -25,6 +26,7 @@ using namespace std::literals;
 using android::base::unique_fd;
 using android::fs_mgr::WaitForFile;
 using android::fs_mgr::WaitForFileDeleted;
+using android::fs_mgr::WaitForFiles;
 
 class FileWaitTest : public ::testing::Test {
   protected:
@@ -89,3 +91,32 @@ TEST_F(FileWaitTest, BadPath) {
     ASSERT_FALSE(WaitForFile("/this/path/does/not/exist", 5ms));
     EXPECT_EQ(errno, ENOENT);
 }
+
+TEST_F(FileWaitTest, CreateManyAsync) {
+    std::vector<std::string> paths;
+    for (int i = 0; i < 4; i++) {
+        paths.emplace_back(test_file_ + "." + std::to_string(i));
+    }
+    std::thread thread([&paths] {
+        for (const auto& path : paths) {
+            std::this_thread::sleep_for(250ms);
+            unique_fd fd(open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0700));
+        }
+    });
+    EXPECT_TRUE(WaitForFiles(paths, 3s));
+    thread.join();
+
+    for (const auto& path : paths) {
+        unlink(path.c_str());
+    }
+}
+
+TEST_F(FileWaitTest, CreateSomeAsync) {
+    std::vector<std::string> paths = {test_file_, test_file_ + ".wontexist"};
+    std::thread thread([this] {
+        std::this_thread::sleep_for(250ms);
+        unique_fd fd(open(test_file_.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0700));
+    });
+    EXPECT_FALSE(WaitForFiles(paths, 1s));
+    thread.join();
+}
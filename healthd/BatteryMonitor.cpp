@@ -29,12 +29,17 @@
 
 #include <algorithm>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <unordered_map>
 
 #include <aidl/android/hardware/health/HealthInfo.h>
 #include <android-base/file.h>
 #include <android-base/parseint.h>
 #include <android-base/strings.h>
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
 #include <android/hardware/health/2.1/types.h>
 #include <android/hardware/health/translate-ndk.h>
 #include <batteryservice/BatteryService.h>
@@ -287,10 +292,38 @@ BatteryChargingState getBatteryChargingState(const char* chargingState) {
     return *ret;
 }
 
+// Sysfs attributes are kept open across updates; a pread from offset zero makes
+// sysfs regenerate the value, saving an open and close per attribute per update.
+// An fd that fails to read (e.g. the supply went away) is dropped and reopened.
+static std::mutex gSysfsFdsLock;
+static std::unordered_map<std::string, android::base::unique_fd> gSysfsFds
+        GUARDED_BY(gSysfsFdsLock);
+
+static ssize_t preadSysfsFile(const char* path, char* data, size_t size) {
+    std::lock_guard<std::mutex> lock(gSysfsFdsLock);
+    auto it = gSysfsFds.find(path);
+    if (it == gSysfsFds.end()) {
+        android::base::unique_fd fd(open(path, O_RDONLY | O_CLOEXEC));
+        if (fd == -1) return -1;
+        it = gSysfsFds.emplace(path, std::move(fd)).first;
+    }
+    ssize_t n = TEMP_FAILURE_RETRY(pread(it->second.get(), data, size - 1, 0));
+    if (n < 0) {
+        gSysfsFds.erase(it);
+        return -1;
+    }
+    data[n] = '\0';
+    return n;
+}
+
 static int readFromFile(const String8& path, std::string* buf) {
-    buf->clear();
-    if (android::base::ReadFileToString(path.c_str(), buf)) {
-        *buf = android::base::Trim(*buf);
+    // A sysfs attribute never holds more than a page, so one pread into the stack is enough.
+    char data[4096];
+    ssize_t n = preadSysfsFile(path.c_str(), data, sizeof(data));
+    if (n < 0) {
+        buf->clear();
+    } else {
+        *buf = android::base::Trim(std::string_view(data, n));
     }
     return buf->length();
 }
@@ -448,6 +481,9 @@ void BatteryMonitor::updateValues(void) {
         mHealthInfo->chargingState = getBatteryChargingState(buf.c_str());
 
     double MaxPower = 0;
+    // Sampled once for all online chargers, a missing attribute reads as the default.
+    std::optional<int> chargingCurrent;
+    std::optional<int> chargingVoltage;
 
     // Rescan for the available charger types
     std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(POWER_SUPPLY_SYSFS_PATH), closedir);
@@ -524,12 +560,16 @@ void BatteryMonitor::updateValues(void) {
                     KLOG_WARNING(LOG_TAG, "%s: Unknown power supply type\n",
                                  mChargerNames[i].c_str());
             }
-            int ChargingCurrent =
-                  (access(SYSFS_BATTERY_CURRENT, R_OK) == 0) ? abs(getIntField(String8(SYSFS_BATTERY_CURRENT))) : 0;
-
-            int ChargingVoltage =
-                  (access(SYSFS_BATTERY_VOLTAGE, R_OK) == 0) ? getIntField(String8(SYSFS_BATTERY_VOLTAGE)) :
-                   DEFAULT_VBUS_VOLTAGE;
+            if (!chargingCurrent) {
+                chargingCurrent = (access(SYSFS_BATTERY_CURRENT, R_OK) == 0)
+                                          ? abs(getIntField(String8(SYSFS_BATTERY_CURRENT)))
+                                          : 0;
+                chargingVoltage = (access(SYSFS_BATTERY_VOLTAGE, R_OK) == 0)
+                                          ? getIntField(String8(SYSFS_BATTERY_VOLTAGE))
+                                          : DEFAULT_VBUS_VOLTAGE;
+            }
+            int ChargingCurrent = *chargingCurrent;
+            int ChargingVoltage = *chargingVoltage;
 
             double power = ((double)ChargingCurrent / MILLION) *
                            ((double)ChargingVoltage / MILLION);
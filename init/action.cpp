@@ -143,24 +143,61 @@ size_t Action::CheckAllCommands() const {
     return failures;
 }
 
-void Action::ExecuteOneCommand(std::size_t command) const {
+std::size_t Action::ExecuteCommands(std::size_t command) const {
+    std::size_t end = command + 1;
+    if (subcontext_ && commands_[command].execute_in_subcontext()) {
+        while (end < commands_.size() && commands_[end].execute_in_subcontext()) {
+            ++end;
+        }
+    }
+    if (end - command > 1) {
+        return ExecuteSubcontextCommands(command, end);
+    }
+
     // We need a copy here since some Command execution may result in
     // changing commands_ vector by importing .rc files through parser
     Command cmd = commands_[command];
     ExecuteCommand(cmd);
+    return 1;
 }
 
 void Action::ExecuteAllCommands() const {
-    for (const auto& c : commands_) {
-        ExecuteCommand(c);
+    for (std::size_t i = 0; i < commands_.size();) {
+        i += ExecuteCommands(i);
     }
 }
 
 void Action::ExecuteCommand(const Command& command) const {
     android::base::Timer t;
     auto result = command.InvokeFunc(subcontext_);
-    auto duration = t.duration();
+    LogCommandResult(command, result, t.duration());
+}
+
+std::size_t Action::ExecuteSubcontextCommands(std::size_t begin, std::size_t end) const {
+    std::vector<std::vector<std::string>> batch;
+    for (std::size_t i = begin; i < end; ++i) {
+        batch.emplace_back(commands_[i].args());
+    }
+
+    android::base::Timer t;
+    auto results = subcontext_->ExecuteBatch(batch);
+    if (!results.ok()) {
+        // It is not known which of the commands ran, so don't retry any of them.
+        for (std::size_t i = begin; i < end; ++i) {
+            LogCommandResult(commands_[i], results.error(), t.duration());
+        }
+        return end - begin;
+    }
+
+    for (std::size_t i = 0; i < results->size(); ++i) {
+        const auto& [result, duration] = (*results)[i];
+        LogCommandResult(commands_[begin + i], result, duration);
+    }
+    return results->size();
+}
 
+void Action::LogCommandResult(const Command& command, const Result<void>& result,
+                              std::chrono::milliseconds duration) const {
     // Any action longer than 50ms will be warned to user as slow operation
     if (!result.has_value() || duration > 50ms ||
         android::base::GetMinimumLogSeverity() <= android::base::DEBUG) {
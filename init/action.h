@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <map>
 #include <queue>
 #include <string>
@@ -44,6 +45,8 @@ class Command {
     std::string BuildCommandString() const;
     Result<void> CheckCommand() const;
 
+    const std::vector<std::string>& args() const { return args_; }
+    bool execute_in_subcontext() const { return execute_in_subcontext_; }
     int line() const { return line_; }
 
   private:
@@ -66,7 +69,9 @@ class Action {
     Result<void> AddCommand(std::vector<std::string>&& args, int line);
     void AddCommand(BuiltinFunction f, std::vector<std::string>&& args, int line);
     size_t NumCommands() const;
-    void ExecuteOneCommand(std::size_t command) const;
+    // Executes the command at |command|. A run of commands that execute in the subcontext is sent
+    // to it in batches, to save a round trip per command. Returns the number of commands that ran.
+    std::size_t ExecuteCommands(std::size_t command) const;
     void ExecuteAllCommands() const;
     bool CheckEvent(const EventTrigger& event_trigger) const;
     bool CheckEvent(const PropertyChange& property_change) const;
@@ -76,6 +81,10 @@ class Action {
     size_t CheckAllCommands() const;
 
     bool oneshot() const { return oneshot_; }
+    const std::string& event_trigger() const { return event_trigger_; }
+    const std::map<std::string, std::string>& property_triggers() const {
+        return property_triggers_;
+    }
     const std::string& filename() const { return filename_; }
     int line() const { return line_; }
     static void set_function_map(const BuiltinFunctionMap* function_map) {
@@ -85,6 +94,9 @@ class Action {
 
   private:
     void ExecuteCommand(const Command& command) const;
+    std::size_t ExecuteSubcontextCommands(std::size_t begin, std::size_t end) const;
+    void LogCommandResult(const Command& command, const Result<void>& result,
+                          std::chrono::milliseconds duration) const;
     bool CheckPropertyTriggers(const std::string& name = "",
                                const std::string& value = "") const;
 
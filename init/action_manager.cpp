@@ -37,9 +37,64 @@ ActionManager& ActionManager::GetInstance() {
 }
 
 void ActionManager::AddAction(std::unique_ptr<Action> action) {
+    IndexPropertyTriggers(action.get());
     actions_.emplace_back(std::move(action));
 }
 
+void ActionManager::IndexPropertyTriggers(const Action* action) {
+    // Actions with an event trigger only run on that event, never on a property change.
+    if (!action->event_trigger().empty()) {
+        return;
+    }
+    for (const auto& [name, value] : action->property_triggers()) {
+        property_trigger_index_[name].emplace_back(PropertyTrigger{
+                .action = action,
+                .wildcard = value == "*",
+                .value = value,
+        });
+    }
+}
+
+void ActionManager::UnindexPropertyTriggers(const Action* action) {
+    for (const auto& [name, value] : action->property_triggers()) {
+        auto it = property_trigger_index_.find(name);
+        if (it == property_trigger_index_.end()) {
+            continue;
+        }
+        auto& triggers = it->second;
+        triggers.erase(std::remove_if(triggers.begin(), triggers.end(),
+                                      [action](const auto& trigger) {
+                                          return trigger.action == action;
+                                      }),
+                       triggers.end());
+    }
+}
+
+void ActionManager::RebuildPropertyTriggerIndex() {
+    property_trigger_index_.clear();
+    for (const auto& action : actions_) {
+        IndexPropertyTriggers(action.get());
+    }
+}
+
+void ActionManager::QueuePropertyChangeActions(const PropertyChange& property_change) {
+    const auto& [name, value] = property_change;
+    auto it = property_trigger_index_.find(name);
+    if (it == property_trigger_index_.end()) {
+        return;
+    }
+    for (const auto& trigger : it->second) {
+        // Reject on the changed property's value first, the full check also reads the current
+        // values of the action's other property triggers.
+        if (!trigger.wildcard && trigger.value != value) {
+            continue;
+        }
+        if (trigger.action->CheckEvent(property_change)) {
+            current_executing_actions_.emplace(trigger.action);
+        }
+    }
+}
+
 void ActionManager::QueueEventTrigger(const std::string& trigger) {
     auto lock = std::lock_guard{event_queue_lock_};
     event_queue_.emplace(trigger);
@@ -69,10 +124,17 @@ void ActionManager::ExecuteOneCommand() {
         auto lock = std::lock_guard{event_queue_lock_};
         // Loop through the event queue until we have an action to execute
         while (current_executing_actions_.empty() && !event_queue_.empty()) {
-            for (const auto& action : actions_) {
-                if (std::visit([&action](const auto& event) { return action->CheckEvent(event); },
-                               event_queue_.front())) {
-                    current_executing_actions_.emplace(action.get());
+            const auto& event = event_queue_.front();
+            // An empty property name is QueueAllPropertyActions(), which needs the full scan.
+            if (auto property_change = std::get_if<PropertyChange>(&event);
+                property_change && !property_change->first.empty()) {
+                QueuePropertyChangeActions(*property_change);
+            } else {
+                for (const auto& action : actions_) {
+                    if (std::visit([&action](const auto& e) { return action->CheckEvent(e); },
+                                   event)) {
+                        current_executing_actions_.emplace(action.get());
+                    }
                 }
             }
             event_queue_.pop();
@@ -91,17 +153,18 @@ void ActionManager::ExecuteOneCommand() {
                   << ":" << action->line() << ")";
     }
 
-    action->ExecuteOneCommand(current_command_);
+    current_command_ += action->ExecuteCommands(current_command_);
 
     // If this was the last command in the current action, then remove
     // the action from the executing list.
     // If this action was oneshot, then also remove it from actions_.
-    ++current_command_;
     if (current_command_ == action->NumCommands()) {
         current_executing_actions_.pop();
         current_command_ = 0;
         if (action->oneshot()) {
             auto eraser = [&action](std::unique_ptr<Action>& a) { return a.get() == action; };
+            // Unindex first, since erasing the action from |actions_| frees it.
+            UnindexPropertyTriggers(action);
             actions_.erase(std::remove_if(actions_.begin(), actions_.end(), eraser),
                            actions_.end());
         }
@@ -18,6 +18,8 @@
 
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/thread_annotations.h>
@@ -40,6 +42,7 @@ class ActionManager {
     template <class UnaryPredicate>
     void RemoveActionIf(UnaryPredicate predicate) {
         actions_.erase(std::remove_if(actions_.begin(), actions_.end(), predicate), actions_.end());
+        RebuildPropertyTriggerIndex();
     }
     void QueueEventTrigger(const std::string& trigger);
     void QueuePropertyChange(const std::string& name, const std::string& value);
@@ -55,7 +58,22 @@ class ActionManager {
     ActionManager(ActionManager const&) = delete;
     void operator=(ActionManager const&) = delete;
 
+    // An action that is triggered by changes to a property, along with the value it waits for.
+    struct PropertyTrigger {
+        const Action* action;
+        bool wildcard;
+        std::string_view value;
+    };
+
+    void IndexPropertyTriggers(const Action* action);
+    void UnindexPropertyTriggers(const Action* action);
+    void RebuildPropertyTriggerIndex();
+    void QueuePropertyChangeActions(const PropertyChange& property_change);
+
     std::vector<std::unique_ptr<Action>> actions_;
+    // Maps property names to the actions with a property trigger on them, in the same order as
+    // |actions_|, so that a property change only looks at the actions that could match it.
+    std::unordered_map<std::string, std::vector<PropertyTrigger>> property_trigger_index_;
     std::queue<std::variant<EventTrigger, PropertyChange, BuiltinAction>> event_queue_
             GUARDED_BY(event_queue_lock_);
     mutable std::mutex event_queue_lock_;
@@ -19,7 +19,11 @@
 #include <dirent.h>
 #include <glob.h>
 
+#include <algorithm>
+#include <atomic>
+#include <optional>
 #include <set>
+#include <thread>
 #include <vector>
 
 #include <android-base/logging.h>
@@ -101,6 +105,31 @@ std::set<std::string> GetApexListFrom(const std::string& apex_dir) {
     return apex_list;
 }
 
+// Reading and tokenizing rc files doesn't touch parser state, so spread it over a few threads.
+// The results stay indexed by file so the caller still parses them in their original order.
+static std::vector<std::optional<Result<ConfigLines>>> TokenizeRcScripts(
+        const std::vector<std::string>& files) {
+    constexpr size_t kMaxThreads = 4;
+    std::vector<std::optional<Result<ConfigLines>>> results(files.size());
+    std::atomic<size_t> next = 0;
+    auto worker = [&]() {
+        for (size_t i = next++; i < files.size(); i = next++) {
+            results[i] = Parser::TokenizeConfigFile(files[i]);
+        }
+    };
+
+    size_t num_threads = std::min(kMaxThreads, files.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return results;
+}
+
 static Result<void> ParseRcScripts(const std::vector<std::string>& files) {
     if (files.empty()) {
         return {};
@@ -116,13 +145,16 @@ static Result<void> ParseRcScripts(const std::vector<std::string>& files) {
 
     Parser parser =
             CreateApexConfigParser(ActionManager::GetInstance(), ServiceList::GetInstance());
+    auto tokenized = TokenizeRcScripts(filtered);
     std::vector<std::string> errors;
-    for (const auto& c : filtered) {
-        auto result = parser.ParseConfigFile(c);
+    for (size_t i = 0; i < filtered.size(); i++) {
+        auto& lines = *tokenized[i];
         // We should handle other config files even when there's an error.
-        if (!result.ok()) {
-            errors.push_back(result.error().message());
+        if (!lines.ok()) {
+            errors.push_back(lines.error().message());
+            continue;
         }
+        parser.ParseConfigLines(filtered[i], *lines);
     }
     if (!errors.empty()) {
         return Error() << "Unable to parse apex configs: " << base::Join(errors, "|");
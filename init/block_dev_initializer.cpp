@@ -135,6 +135,46 @@ bool BlockDevInitializer::InitDmDevice(const std::string& device) {
     return InitDevice(syspath, device_name);
 }
 
+bool BlockDevInitializer::InitDmDevices(std::set<std::string>* devices) {
+    std::set<std::string> device_names;
+    for (const auto& device : *devices) {
+        device_names.emplace(basename(device.c_str()));
+    }
+
+    auto uevent_callback = [&device_names, this](const Uevent& uevent) {
+        if (device_names.erase(uevent.device_name)) {
+            LOG(VERBOSE) << "Creating device : " << uevent.device_name;
+            device_handler_->HandleUevent(uevent);
+        }
+        return device_names.empty() ? ListenerAction::kStop : ListenerAction::kContinue;
+    };
+
+    for (const auto& device_name : std::set<std::string>(device_names)) {
+        uevent_listener_.RegenerateUeventsForPath("/sys/block/" + device_name, uevent_callback);
+    }
+    if (!device_names.empty()) {
+        LOG(INFO) << "device(s) not found in /sys, waiting for their uevent(s): "
+                  << android::base::Join(device_names, ", ");
+        Timer t;
+        uevent_listener_.Poll(uevent_callback, 10s);
+        LOG(INFO) << "wait for device(s) returned after " << t;
+    }
+
+    for (auto iter = devices->begin(); iter != devices->end();) {
+        if (device_names.count(basename(iter->c_str()))) {
+            iter++;
+        } else {
+            iter = devices->erase(iter);
+        }
+    }
+    if (!devices->empty()) {
+        LOG(ERROR) << "device(s) not found after polling timeout: "
+                   << android::base::Join(*devices, ", ");
+        return false;
+    }
+    return true;
+}
+
 bool BlockDevInitializer::InitPlatformDevice(const std::string& dev_name) {
     return InitDevice("/sys/devices/platform", dev_name);
 }
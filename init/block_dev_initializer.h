@@ -33,6 +33,9 @@ class BlockDevInitializer final {
     bool InitDmUser(const std::string& name);
     bool InitDevices(std::set<std::string> devices);
     bool InitDmDevice(const std::string& device);
+    // Like InitDmDevice(), but waits for the uevents of all |devices| at once. Devices that could
+    // not be created are left in |devices|.
+    bool InitDmDevices(std::set<std::string>* devices);
     bool InitPlatformDevice(const std::string& device);
 
   private:
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks of the parts of the boot path that don't need a running init, against a synthetic
+// set of .rc files. These build for the host as well as for the device.
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include "action.h"
+#include "action_manager.h"
+#include "action_parser.h"
+#include "builtin_arguments.h"
+#include "builtins.h"
+#include "parser.h"
+#include "rc_cache.h"
+#include "service_list.h"
+#include "service_parser.h"
+
+using android::base::StringPrintf;
+using android::base::WriteStringToFile;
+
+namespace android {
+namespace init {
+
+// Each synthetic .rc file has this many services, and as many actions with a property trigger.
+static constexpr int kEntriesPerFile = 16;
+
+static const BuiltinFunctionMap& BenchmarkFunctionMap() {
+    static const BuiltinFunctionMap function_map = {
+            {"noop", {0, 1, {false, [](const BuiltinArguments&) { return Result<void>{}; }}}},
+    };
+    return function_map;
+}
+
+static std::string ServiceName(int file, int entry) {
+    return StringPrintf("bench_%d_%d", file, entry);
+}
+
+static std::string InstanceName(int file, int entry) {
+    return StringPrintf("android.hardware.bench.IBench%d_%d", file, entry);
+}
+
+static std::string PropertyName(int file, int entry) {
+    return StringPrintf("bench.file%d.prop%d", file, entry);
+}
+
+static bool WriteSyntheticRcFiles(const std::string& dir, int files) {
+    for (int file = 0; file < files; ++file) {
+        std::string rc;
+        for (int entry = 0; entry < kEntriesPerFile; ++entry) {
+            const std::string name = ServiceName(file, entry);
+            rc += StringPrintf(
+                    "service %s /system/bin/%s --flag\n"
+                    "    class main\n"
+                    "    disabled\n"
+                    "    interface aidl %s\n"
+                    "    setenv BENCH_ENTRY %d\n"
+                    "    onrestart noop\n"
+                    "\n"
+                    "on property:%s=1\n"
+                    "    noop\n"
+                    "    noop %s\n"
+                    "\n",
+                    name.c_str(), name.c_str(), InstanceName(file, entry).c_str(), entry,
+                    PropertyName(file, entry).c_str(), name.c_str());
+        }
+        if (!WriteStringToFile(rc, StringPrintf("%s/bench_%d.rc", dir.c_str(), file))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ParseSyntheticRcFiles(const std::string& dir, ActionManager* action_manager,
+                                  ServiceList* service_list, RcCache* rc_cache = nullptr) {
+    Action::set_function_map(&BenchmarkFunctionMap());
+    Parser parser;
+    parser.AddSectionParser("service",
+                            std::make_unique<ServiceParser>(service_list, nullptr, std::nullopt));
+    parser.AddSectionParser("on", std::make_unique<ActionParser>(action_manager, nullptr));
+    parser.set_rc_cache(rc_cache);
+    return parser.ParseConfig(dir) && parser.parse_error_count() == 0;
+}
+
+static void BenchmarkParseRcFiles(benchmark::State& state) {
+    TemporaryDir dir;
+    if (!WriteSyntheticRcFiles(dir.path, state.range(0))) {
+        state.SkipWithError("Failed to write the .rc files");
+        return;
+    }
+
+    for (auto _ : state) {
+        ActionManager action_manager;
+        ServiceList service_list;
+        if (!ParseSyntheticRcFiles(dir.path, &action_manager, &service_list)) {
+            state.SkipWithError("Failed to parse the .rc files");
+            return;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BenchmarkParseRcFiles)->Arg(16)->Arg(128);
+
+// Later boots only tokenize the files that changed, but still run all the section parsers.
+static void BenchmarkParseRcFilesCached(benchmark::State& state) {
+    TemporaryDir dir;
+    TemporaryDir cache_dir;
+    if (!WriteSyntheticRcFiles(dir.path, state.range(0))) {
+        state.SkipWithError("Failed to write the .rc files");
+        return;
+    }
+    RcCache rc_cache(std::string(cache_dir.path) + "/rc_cache", "benchmark");
+    {
+        ActionManager action_manager;
+        ServiceList service_list;
+        ParseSyntheticRcFiles(dir.path, &action_manager, &service_list, &rc_cache);
+    }
+
+    for (auto _ : state) {
+        ActionManager action_manager;
+        ServiceList service_list;
+        if (!ParseSyntheticRcFiles(dir.path, &action_manager, &service_list, &rc_cache)) {
+            state.SkipWithError("Failed to parse the .rc files");
+            return;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BenchmarkParseRcFilesCached)->Arg(16)->Arg(128);
+
+// Queues a property change that triggers one action out of range(0) / kEntriesPerFile files
+// worth, and runs its commands.
+static void BenchmarkPropertyTriggerDispatch(benchmark::State& state) {
+    const int files = state.range(0) / kEntriesPerFile;
+    TemporaryDir dir;
+    ActionManager action_manager;
+    ServiceList service_list;
+    if (!WriteSyntheticRcFiles(dir.path, files) ||
+        !ParseSyntheticRcFiles(dir.path, &action_manager, &service_list)) {
+        state.SkipWithError("Failed to set up the .rc files");
+        return;
+    }
+    // Every action that runs is logged, which is not what is being measured here.
+    android::base::ScopedLogSeverity severity(android::base::WARNING);
+
+    int next = 0;
+    for (auto _ : state) {
+        action_manager.QueuePropertyChange(
+                PropertyName(next % files, (next / files) % kEntriesPerFile), "1");
+        while (action_manager.HasMoreCommands()) {
+            action_manager.ExecuteOneCommand();
+        }
+        ++next;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BenchmarkPropertyTriggerDispatch)->Arg(1024)->Arg(8192);
+
+// Setting a property that no action waits for is the common case.
+static void BenchmarkPropertyTriggerMiss(benchmark::State& state) {
+    TemporaryDir dir;
+    ActionManager action_manager;
+    ServiceList service_list;
+    if (!WriteSyntheticRcFiles(dir.path, state.range(0) / kEntriesPerFile) ||
+        !ParseSyntheticRcFiles(dir.path, &action_manager, &service_list)) {
+        state.SkipWithError("Failed to set up the .rc files");
+        return;
+    }
+
+    for (auto _ : state) {
+        action_manager.QueuePropertyChange("bench.untriggered", "1");
+        while (action_manager.HasMoreCommands()) {
+            action_manager.ExecuteOneCommand();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BenchmarkPropertyTriggerMiss)->Arg(1024)->Arg(8192);
+
+static void BenchmarkServiceListLookups(benchmark::State& state) {
+    const int files = state.range(0) / kEntriesPerFile;
+    TemporaryDir dir;
+    ActionManager action_manager;
+    ServiceList service_list;
+    if (!WriteSyntheticRcFiles(dir.path, files) ||
+        !ParseSyntheticRcFiles(dir.path, &action_manager, &service_list)) {
+        state.SkipWithError("Failed to set up the .rc files");
+        return;
+    }
+    std::vector<std::string> names;
+    std::vector<std::string> interfaces;
+    for (int file = 0; file < files; ++file) {
+        for (int entry = 0; entry < kEntriesPerFile; ++entry) {
+            names.emplace_back(ServiceName(file, entry));
+            interfaces.emplace_back("aidl/" + InstanceName(file, entry));
+        }
+    }
+
+    size_t next = 0;
+    for (auto _ : state) {
+        // A control message for a service that exists, and one for a service that doesn't.
+        benchmark::DoNotOptimize(service_list.FindService(names[next]));
+        benchmark::DoNotOptimize(service_list.FindService("bench_missing"));
+        benchmark::DoNotOptimize(service_list.FindInterface(interfaces[next]));
+        next = (next + 1) % names.size();
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+}
+
+BENCHMARK(BenchmarkServiceListLookups)->Arg(256)->Arg(4096);
+
+}  // namespace init
+}  // namespace android
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks of the parts of the boot path that only exist on the device: the property service of
+// the running init, ueventd's permission rules and reaping children.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include "devices.h"
+#include "sigchld_handler.h"
+
+using android::base::SetProperty;
+using android::base::StringPrintf;
+
+namespace android {
+namespace init {
+
+// Round trips through the property socket of the running init, including its checks and the
+// property triggers it looks up. Run with several threads to load the property service workers.
+static void BenchmarkPropertySet(benchmark::State& state) {
+    const std::string name = StringPrintf("debug.init_benchmark.%d", state.thread_index());
+    int value = 0;
+    for (auto _ : state) {
+        if (!SetProperty(name, std::to_string(value++))) {
+            state.SkipWithError("Setting the property failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BenchmarkPropertySet)->Threads(1)->Threads(4)->UseRealTime();
+
+// A ueventd.rc sized set of rules: mostly exact device names, some prefixes and a few wildcards.
+static std::vector<Permissions> BenchmarkPermissions(int rules) {
+    std::vector<Permissions> permissions;
+    for (int i = 0; i < rules; ++i) {
+        std::string name;
+        switch (i % 8) {
+            case 0:
+                name = StringPrintf("/dev/bench_prefix%d*", i);
+                break;
+            case 1:
+                name = StringPrintf("/dev/bus/bench%d/*/*", i);
+                break;
+            default:
+                name = StringPrintf("/dev/bench_device%d", i);
+                break;
+        }
+        permissions.emplace_back(name, 0660, 1000, 1000, false);
+    }
+    return permissions;
+}
+
+static std::vector<std::string> BenchmarkDevicePaths(int rules) {
+    std::vector<std::string> paths;
+    for (int i = 0; i < rules; ++i) {
+        paths.emplace_back(StringPrintf("/dev/bench_device%d", i));
+        paths.emplace_back(StringPrintf("/dev/bench_prefix%d_%d", i, i));
+        paths.emplace_back(StringPrintf("/dev/bus/bench%d/001/%03d", i, i % 128));
+        paths.emplace_back(StringPrintf("/dev/block/unmatched%d", i));
+    }
+    return paths;
+}
+
+// The lookup DeviceHandler does for every device node it creates.
+static void BenchmarkPermissionsMatcher(benchmark::State& state) {
+    const std::vector<Permissions> permissions = BenchmarkPermissions(state.range(0));
+    const std::vector<std::string> paths = BenchmarkDevicePaths(state.range(0));
+    const PermissionsMatcher matcher(permissions);
+    std::vector<size_t> matches;
+
+    size_t next = 0;
+    for (auto _ : state) {
+        matches.clear();
+        matcher.FindMatches(paths[next], &matches);
+        benchmark::DoNotOptimize(matches.data());
+        next = (next + 1) % paths.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BenchmarkPermissionsMatcher)->Arg(64)->Arg(1024);
+
+// What PermissionsMatcher replaces, for comparison.
+static void BenchmarkPermissionsScan(benchmark::State& state) {
+    const std::vector<Permissions> permissions = BenchmarkPermissions(state.range(0));
+    const std::vector<std::string> paths = BenchmarkDevicePaths(state.range(0));
+
+    size_t next = 0;
+    for (auto _ : state) {
+        for (const auto& permission : permissions) {
+            benchmark::DoNotOptimize(permission.Match(paths[next]));
+        }
+        next = (next + 1) % paths.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BenchmarkPermissionsScan)->Arg(64)->Arg(1024);
+
+// Reaps range(0) children that all exited at once, none of them services.
+static void BenchmarkReapChildStorm(benchmark::State& state) {
+    // Every reaped child is logged, which is not what is being measured here.
+    android::base::ScopedLogSeverity severity(android::base::WARNING);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<pid_t> pids;
+        for (int i = 0; i < state.range(0); ++i) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                _exit(0);
+            }
+            if (pid == -1) {
+                state.SkipWithError("fork() failed");
+                break;
+            }
+            pids.emplace_back(pid);
+        }
+        // Wait for all of them to be zombies, without reaping them.
+        for (pid_t pid : pids) {
+            siginfo_t info;
+            TEMP_FAILURE_RETRY(waitid(P_PID, pid, &info, WEXITED | WNOWAIT));
+        }
+        state.ResumeTiming();
+
+        if (ReapAnyOutstandingChildren().size() != pids.size()) {
+            state.SkipWithError("Not all children were reaped");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BenchmarkReapChildStorm)->Arg(64)->Arg(512)->Unit(benchmark::kMicrosecond);
+
+}  // namespace init
+}  // namespace android
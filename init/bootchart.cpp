@@ -21,22 +21,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/utsname.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
 
 using android::base::StringPrintf;
 using android::base::boot_clock;
@@ -50,6 +55,8 @@ static std::thread* g_bootcharting_thread;
 static std::mutex g_bootcharting_finished_mutex;
 static std::condition_variable g_bootcharting_finished_cv;
 static bool g_bootcharting_finished;
+// Lines for service_start.log, guarded by g_bootcharting_finished_mutex.
+static std::vector<std::string> g_service_starts;
 
 static long long get_uptime_jiffies() {
     constexpr int64_t kNanosecondsPerJiffy = 10000000;
@@ -64,6 +71,259 @@ static std::unique_ptr<FILE, decltype(&fclose)> fopen_unique(const char* filenam
   return result;
 }
 
+// Samples are appended to a ring buffer in a shared mapping of this file, so that the collector
+// only copies bytes, and the data survives a boot that never finishes. decode-bootchart.py turns
+// it back into the *.log files that pybootchartgui reads.
+//
+// The file starts with a RingHeader. Records follow it, each a RecordHeader and then its payload
+// padded to 8 bytes. The payload is exactly what follows the uptime line in the matching log file.
+// A record never wraps around the end of the buffer; a kPadding record, or a gap too small for a
+// RecordHeader, fills the space up to the end instead. |head| and |tail| are offsets that only
+// ever grow, and are reduced modulo |capacity| to find a position in the buffer.
+static constexpr char kRingPath[] = "/data/bootchart/bootchart.ring";
+static constexpr uint32_t kRingMagic = 0x42434852;  // "RHCB"
+static constexpr uint32_t kRingVersion = 1;
+static constexpr uint64_t kRingCapacity = 32 * 1024 * 1024;
+
+enum RecordType : uint32_t {
+  kPadding = 0,
+  kProcStat = 1,
+  kProcDiskstats = 2,
+  kProcPs = 3,
+  kServiceStart = 4,
+};
+
+struct RingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;
+  uint64_t head;
+  uint64_t tail;
+};
+
+struct RecordHeader {
+  uint32_t type;
+  uint32_t size;
+  int64_t uptime_jiffies;
+};
+
+static_assert(sizeof(RingHeader) % 8 == 0 && sizeof(RecordHeader) % 8 == 0);
+
+class BootchartRing {
+ public:
+  ~BootchartRing() {
+    if (header_) munmap(header_, sizeof(RingHeader) + kRingCapacity);
+  }
+
+  bool Open() {
+    android::base::unique_fd fd(open(kRingPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (fd == -1) {
+      PLOG(ERROR) << "bootchart: failed to open " << kRingPath;
+      return false;
+    }
+    size_t size = sizeof(RingHeader) + kRingCapacity;
+    if (ftruncate(fd.get(), size) == -1) {
+      PLOG(ERROR) << "bootchart: failed to resize " << kRingPath;
+      return false;
+    }
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (map == MAP_FAILED) {
+      PLOG(ERROR) << "bootchart: failed to map " << kRingPath;
+      return false;
+    }
+    header_ = static_cast<RingHeader*>(map);
+    data_ = reinterpret_cast<char*>(header_ + 1);
+    *header_ = {.magic = kRingMagic, .version = kRingVersion, .capacity = kRingCapacity};
+    return true;
+  }
+
+  void Append(RecordType type, int64_t uptime_jiffies, const std::string& payload) {
+    uint64_t size = sizeof(RecordHeader) + Align(payload.size());
+    if (size > kRingCapacity / 2) {
+      LOG(ERROR) << "bootchart: dropping a " << payload.size() << " byte record";
+      return;
+    }
+
+    uint64_t tail = header_->tail;
+    uint64_t space_to_end = kRingCapacity - tail % kRingCapacity;
+    if (space_to_end < size) {
+      MakeRoom(tail, space_to_end);
+      if (space_to_end >= sizeof(RecordHeader)) {
+        WriteHeader(tail, {.type = kPadding,
+                           .size = static_cast<uint32_t>(space_to_end - sizeof(RecordHeader))});
+      }
+      tail += space_to_end;
+    }
+    MakeRoom(tail, size);
+    WriteHeader(tail, {.type = type,
+                       .size = static_cast<uint32_t>(payload.size()),
+                       .uptime_jiffies = uptime_jiffies});
+    memcpy(data_ + tail % kRingCapacity + sizeof(RecordHeader), payload.data(), payload.size());
+    // Only publish the record once it is complete.
+    __atomic_store_n(&header_->tail, tail + size, __ATOMIC_RELEASE);
+  }
+
+ private:
+  static uint64_t Align(uint64_t size) { return (size + 7) & ~7; }
+
+  void WriteHeader(uint64_t offset, const RecordHeader& record) {
+    memcpy(data_ + offset % kRingCapacity, &record, sizeof(record));
+  }
+
+  // Drops the oldest records until [offset, offset + size) no longer overlaps any of them.
+  void MakeRoom(uint64_t offset, uint64_t size) {
+    uint64_t head = header_->head;
+    while (head < header_->tail && offset + size - head > kRingCapacity) {
+      uint64_t space_to_end = kRingCapacity - head % kRingCapacity;
+      if (space_to_end < sizeof(RecordHeader)) {
+        head += space_to_end;
+        continue;
+      }
+      RecordHeader record;
+      memcpy(&record, data_ + head % kRingCapacity, sizeof(record));
+      head += sizeof(RecordHeader) + Align(record.size);
+    }
+    __atomic_store_n(&header_->head, head, __ATOMIC_RELEASE);
+  }
+
+  RingHeader* header_ = nullptr;
+  char* data_ = nullptr;
+};
+
+// Reads /proc files relative to a cached /proc fd, into a buffer that is reused between samples.
+class ProcReader {
+ public:
+  ~ProcReader() {
+    if (proc_dir_) closedir(proc_dir_);
+  }
+
+  bool Open() {
+    proc_dir_ = opendir("/proc");
+    if (!proc_dir_) {
+      PLOG(ERROR) << "bootchart: failed to open /proc";
+      return false;
+    }
+    return true;
+  }
+
+  // Returns the contents of |path|, relative to /proc, or nullptr if it can't be read.
+  const std::string* Read(const char* path) {
+    android::base::unique_fd fd(openat(dirfd(proc_dir_), path, O_RDONLY | O_CLOEXEC));
+    if (fd == -1) return nullptr;
+
+    size_t size = 0;
+    while (true) {
+      if (buffer_.size() - size < 4096) buffer_.resize(std::max<size_t>(buffer_.size() * 2, 8192));
+      ssize_t n = TEMP_FAILURE_RETRY(read(fd.get(), buffer_.data() + size, buffer_.size() - size));
+      if (n == -1) return nullptr;
+      if (n == 0) break;
+      size += n;
+    }
+    content_.assign(buffer_.data(), size);
+    return &content_;
+  }
+
+  DIR* proc_dir() { return proc_dir_; }
+
+ private:
+  DIR* proc_dir_ = nullptr;
+  std::vector<char> buffer_;
+  std::string content_;
+};
+
+class BootchartCollector {
+ public:
+  bool Open() { return ring_.Open() && proc_.Open(); }
+
+  void Sample() {
+    int64_t uptime = get_uptime_jiffies();
+    LogFile(kProcStat, uptime, "stat");
+    LogFile(kProcDiskstats, uptime, "diskstats");
+    LogProcesses(uptime);
+    LogServiceStarts(uptime);
+  }
+
+ private:
+  void LogFile(RecordType type, int64_t uptime, const char* path) {
+    payload_.clear();
+    if (auto content = proc_.Read(path)) {
+      payload_.append(*content);
+      payload_.push_back('\n');
+    }
+    ring_.Append(type, uptime, payload_);
+  }
+
+  void LogProcesses(int64_t uptime) {
+    payload_.clear();
+    std::unordered_map<pid_t, CachedName> names;
+
+    DIR* dir = proc_.proc_dir();
+    rewinddir(dir);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+      // Only match numeric values.
+      int pid = atoi(entry->d_name);
+      if (pid == 0) continue;
+
+      auto stat_path = StringPrintf("%d/stat", pid);
+      auto stat_content = proc_.Read(stat_path.c_str());
+      if (!stat_content) continue;
+      std::string stat = *stat_content;
+
+      size_t open = stat.find('(');
+      size_t close = stat.find_last_of(')');
+      if (open != std::string::npos && close != std::string::npos) {
+        // /proc/<pid>/stat only has truncated task names, so get the full name from
+        // /proc/<pid>/cmdline. That only changes along with the task name, so it is cached.
+        std::string comm = stat.substr(open + 1, close - open - 1);
+        auto it = names_.find(pid);
+        if (it == names_.end() || it->second.comm != comm) {
+          auto cmdline = proc_.Read(StringPrintf("%d/cmdline", pid).c_str());
+          // So we stop at the first NUL.
+          std::string full_name = cmdline ? cmdline->c_str() : "";
+          it = names_.insert_or_assign(pid, CachedName{comm, full_name}).first;
+        }
+        if (!it->second.full_name.empty()) {
+          stat.replace(open + 1, close - open - 1, it->second.full_name);
+        }
+        names.insert(*it);
+      }
+      payload_.append(stat);
+    }
+    // Forget processes that exited.
+    names_.swap(names);
+
+    payload_.push_back('\n');
+    ring_.Append(kProcPs, uptime, payload_);
+  }
+
+  void LogServiceStarts(int64_t uptime) {
+    std::vector<std::string> service_starts;
+    {
+      std::lock_guard<std::mutex> lock(g_bootcharting_finished_mutex);
+      service_starts.swap(g_service_starts);
+    }
+    if (service_starts.empty()) return;
+
+    payload_.clear();
+    for (const auto& line : service_starts) {
+      payload_.append(line);
+    }
+    payload_.push_back('\n');
+    ring_.Append(kServiceStart, uptime, payload_);
+  }
+
+  struct CachedName {
+    std::string comm;
+    std::string full_name;
+  };
+
+  BootchartRing ring_;
+  ProcReader proc_;
+  std::unordered_map<pid_t, CachedName> names_;
+  std::string payload_;
+};
+
 static void log_header() {
   char date[32];
   time_t now_t = time(NULL);
@@ -90,53 +350,6 @@ static void log_header() {
   fprintf(&*fp, "system.kernel.options = %s\n", kernel_cmdline.c_str());
 }
 
-static void log_uptime(FILE* log) {
-  fprintf(log, "%lld\n", get_uptime_jiffies());
-}
-
-static void log_file(FILE* log, const char* procfile) {
-  log_uptime(log);
-
-  std::string content;
-  if (android::base::ReadFileToString(procfile, &content)) {
-    fprintf(log, "%s\n", content.c_str());
-  }
-}
-
-static void log_processes(FILE* log) {
-  log_uptime(log);
-
-  std::unique_ptr<DIR, int(*)(DIR*)> dir(opendir("/proc"), closedir);
-  struct dirent* entry;
-  while ((entry = readdir(dir.get())) != NULL) {
-    // Only match numeric values.
-    int pid = atoi(entry->d_name);
-    if (pid == 0) continue;
-
-    // /proc/<pid>/stat only has truncated task names, so get the full
-    // name from /proc/<pid>/cmdline.
-    std::string cmdline;
-    android::base::ReadFileToString(StringPrintf("/proc/%d/cmdline", pid), &cmdline);
-    const char* full_name = cmdline.c_str(); // So we stop at the first NUL.
-
-    // Read process stat line.
-    std::string stat;
-    if (android::base::ReadFileToString(StringPrintf("/proc/%d/stat", pid), &stat)) {
-      if (!cmdline.empty()) {
-        // Substitute the process name with its real name.
-        size_t open = stat.find('(');
-        size_t close = stat.find_last_of(')');
-        if (open != std::string::npos && close != std::string::npos) {
-          stat.replace(open + 1, close - open - 1, full_name);
-        }
-      }
-      fputs(stat.c_str(), log);
-    }
-  }
-
-  fputc('\n', log);
-}
-
 static void bootchart_thread_main() {
   LOG(INFO) << "Bootcharting started";
 
@@ -154,13 +367,8 @@ static void bootchart_thread_main() {
       PLOG(ERROR) << "Cannot create mount namespace";
       return;
   }
-  // Open log files.
-  auto stat_log = fopen_unique("/data/bootchart/proc_stat.log", "we");
-  if (!stat_log) return;
-  auto proc_log = fopen_unique("/data/bootchart/proc_ps.log", "we");
-  if (!proc_log) return;
-  auto disk_log = fopen_unique("/data/bootchart/proc_diskstats.log", "we");
-  if (!disk_log) return;
+  BootchartCollector collector;
+  if (!collector.Open()) return;
 
   log_header();
 
@@ -171,9 +379,7 @@ static void bootchart_thread_main() {
       if (g_bootcharting_finished) break;
     }
 
-    log_file(&*stat_log, "/proc/stat");
-    log_file(&*disk_log, "/proc/diskstats");
-    log_processes(&*proc_log);
+    collector.Sample();
   }
 
   LOG(INFO) << "Bootcharting finished";
@@ -207,6 +413,17 @@ static Result<void> do_bootchart_stop() {
     return {};
 }
 
+void BootchartLogServiceStart(const std::string& name, pid_t pid,
+                              std::chrono::nanoseconds duration) {
+  if (!g_bootcharting_thread) return;
+
+  // One line per service: its name, pid and how long init took to start it in microseconds.
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  std::lock_guard<std::mutex> lock(g_bootcharting_finished_mutex);
+  g_service_starts.emplace_back(StringPrintf("%s %d %lld\n", name.c_str(), pid,
+                                             static_cast<long long>(us)));
+}
+
 Result<void> do_bootchart(const BuiltinArguments& args) {
     if (args[1] == "start") return do_bootchart_start();
     return do_bootchart_stop();
@@ -17,6 +17,9 @@
 #ifndef _BOOTCHART_H
 #define _BOOTCHART_H
 
+#include <sys/types.h>
+
+#include <chrono>
 #include <string>
 #include <vector>
 
@@ -28,6 +31,10 @@ namespace init {
 
 Result<void> do_bootchart(const BuiltinArguments& args);
 
+// Records how long init took to start a service, if bootcharting is running.
+void BootchartLogServiceStart(const std::string& name, pid_t pid,
+                              std::chrono::nanoseconds duration);
+
 }  // namespace init
 }  // namespace android
 
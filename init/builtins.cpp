@@ -43,8 +43,10 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
+#include <thread>
 
 #include <InitProperties.sysprop.h>
 #include <android-base/chrono_utils.h>
@@ -169,14 +171,25 @@ static Result<void> do_class_start(const BuiltinArguments& args) {
         return {};
     // Starting a class does not start services which are explicitly disabled.
     // They must  be started individually.
+    // Fork every service in the class before finishing the start of any of them, so that the
+    // children's own setup runs in parallel instead of one service at a time.
+    std::vector<Service*> pending;
     for (const auto& service : ServiceList::GetInstance()) {
         if (service->classnames().count(args[1])) {
-            if (auto result = service->StartIfNotDisabled(); !result.ok()) {
+            if (auto result = service->BeginStartIfNotDisabled(); !result.ok()) {
                 LOG(ERROR) << "Could not start service '" << service->name()
                            << "' as part of class '" << args[1] << "': " << result.error();
+            } else if (service->start_pending()) {
+                pending.emplace_back(service.get());
             }
         }
     }
+    for (const auto& service : pending) {
+        if (auto result = service->FinishStart(); !result.ok()) {
+            LOG(ERROR) << "Could not start service '" << service->name()
+                       << "' as part of class '" << args[1] << "': " << result.error();
+        }
+    }
     return {};
 }
 
@@ -1035,22 +1048,85 @@ static Result<void> do_chmod(const BuiltinArguments& args) {
     return {};
 }
 
+// Relabels |path| recursively, handing each of its subdirectories to one of |jobs| threads.
+// libselinux keeps its per-directory digests (security.sehash) while walking each subtree, so
+// unchanged subtrees are still skipped. Returns 0 or the errno of a failed relabel.
+static int RestoreconRecursiveParallel(const std::string& path, int flags, size_t jobs) {
+    struct stat root_st;
+    if (lstat(path.c_str(), &root_st) == -1) return errno;
+    if (!S_ISDIR(root_st.st_mode)) {
+        return selinux_android_restorecon(path.c_str(), flags) < 0 ? errno : 0;
+    }
+
+    std::atomic<int> ret = 0;
+    if (selinux_android_restorecon(path.c_str(), flags & ~SELINUX_ANDROID_RESTORECON_RECURSE) <
+        0) {
+        ret = errno;
+    }
+
+    std::vector<std::string> subdirs;
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(path.c_str()), closedir);
+    if (!dir) return errno;
+    while (dirent* entry = readdir(dir.get())) {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+        std::string child = path + "/" + entry->d_name;
+        struct stat st;
+        if (lstat(child.c_str(), &st) == -1) continue;
+        if (S_ISDIR(st.st_mode)) {
+            // Like the single-threaded walk, stay on one filesystem unless told otherwise.
+            if (st.st_dev != root_st.st_dev &&
+                !(flags & SELINUX_ANDROID_RESTORECON_CROSS_FILESYSTEMS)) {
+                continue;
+            }
+            subdirs.emplace_back(std::move(child));
+        } else if (selinux_android_restorecon(child.c_str(), flags) < 0) {
+            ret = errno;
+        }
+    }
+    dir.reset();
+
+    std::atomic<size_t> next = 0;
+    auto worker = [&]() {
+        for (size_t i = next++; i < subdirs.size(); i = next++) {
+            if (selinux_android_restorecon(subdirs[i].c_str(), flags) < 0) {
+                ret = errno;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(jobs, subdirs.size()); i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return ret;
+}
+
 static Result<void> do_restorecon(const BuiltinArguments& args) {
     auto restorecon_info = ParseRestorecon(args.args);
     if (!restorecon_info.ok()) {
         return restorecon_info.error();
     }
 
-    const auto& [flag, paths] = *restorecon_info;
+    const auto& [flag, paths, jobs] = *restorecon_info;
 
     int ret = 0;
     for (const auto& path : paths) {
-        if (selinux_android_restorecon(path.c_str(), flag) < 0) {
+        if (jobs > 1 && (flag & SELINUX_ANDROID_RESTORECON_RECURSE)) {
+            if (int err = RestoreconRecursiveParallel(path, flag, jobs); err != 0) {
+                ret = err;
+            }
+        } else if (selinux_android_restorecon(path.c_str(), flag) < 0) {
             ret = errno;
         }
     }
 
-    if (ret) return ErrnoErrorIgnoreEnoent() << "selinux_android_restorecon() failed";
+    if (ret) {
+        errno = ret;
+        return ErrnoErrorIgnoreEnoent() << "selinux_android_restorecon() failed";
+    }
     return {};
 }
 
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2024 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Decode the bootchart ring buffer written by init into bootchart log files.
+
+Usage: decode-bootchart.py bootchart.ring output-dir
+
+This writes proc_stat.log, proc_diskstats.log, proc_ps.log and
+service_start.log to output-dir, in the format pybootchartgui reads. See
+BootchartRing in bootchart.cpp for the layout of the ring buffer.
+"""
+
+import os
+import struct
+import sys
+
+RING_MAGIC = 0x42434852
+RING_VERSION = 1
+RING_HEADER = struct.Struct('<IIQQQ')
+RECORD_HEADER = struct.Struct('<IIq')
+
+LOG_FILES = {
+    1: 'proc_stat.log',
+    2: 'proc_diskstats.log',
+    3: 'proc_ps.log',
+    4: 'service_start.log',
+}
+
+
+def read_records(data):
+    magic, version, capacity, head, tail = RING_HEADER.unpack_from(data)
+    if magic != RING_MAGIC:
+        raise ValueError('not a bootchart ring buffer')
+    if version != RING_VERSION:
+        raise ValueError('unsupported bootchart ring buffer version %d' % version)
+    ring = data[RING_HEADER.size:RING_HEADER.size + capacity]
+
+    offset = head
+    while offset < tail:
+        position = offset % capacity
+        if capacity - position < RECORD_HEADER.size:
+            offset += capacity - position
+            continue
+        record_type, size, uptime = RECORD_HEADER.unpack_from(ring, position)
+        payload_start = position + RECORD_HEADER.size
+        yield record_type, uptime, ring[payload_start:payload_start + size]
+        offset += RECORD_HEADER.size + (size + 7) // 8 * 8
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+
+    logs = {}
+    for name in LOG_FILES.values():
+        logs[name] = open(os.path.join(sys.argv[2], name), 'wb')
+    for record_type, uptime, payload in read_records(data):
+        log = logs.get(LOG_FILES.get(record_type))
+        if log:
+            log.write(b'%d\n' % uptime)
+            log.write(payload)
+    for log in logs.values():
+        log.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -172,6 +172,41 @@ bool SysfsPermissions::MatchWithSubsystem(const std::string& path,
     return Match(path);
 }
 
+void PermissionsMatcher::Add(size_t index, const Permissions& permissions) {
+    const std::string& name = permissions.name_;
+    if (permissions.prefix_) {
+        prefixes_[name].emplace_back(index);
+        prefix_lengths_.emplace(name.size());
+    } else if (permissions.wildcard_) {
+        wildcards_.emplace_back(Wildcard{
+                .index = index,
+                .pattern = name,
+                .literal_prefix = name.substr(0, name.find_first_of("*?[\\")),
+                .fnmatch_flags = permissions.no_fnm_pathname_ ? 0 : FNM_PATHNAME,
+        });
+    } else {
+        exact_[name].emplace_back(index);
+    }
+}
+
+void PermissionsMatcher::FindMatches(const std::string& path, std::vector<size_t>* matches) const {
+    if (auto it = exact_.find(path); it != exact_.end()) {
+        matches->insert(matches->end(), it->second.begin(), it->second.end());
+    }
+    for (size_t length : prefix_lengths_) {
+        if (length > path.size()) break;
+        if (auto it = prefixes_.find(path.substr(0, length)); it != prefixes_.end()) {
+            matches->insert(matches->end(), it->second.begin(), it->second.end());
+        }
+    }
+    for (const auto& wildcard : wildcards_) {
+        if (StartsWith(path, wildcard.literal_prefix) &&
+            fnmatch(wildcard.pattern.c_str(), path.c_str(), wildcard.fnmatch_flags) == 0) {
+            matches->emplace_back(wildcard.index);
+        }
+    }
+}
+
 void SysfsPermissions::SetPermissions(const std::string& path) const {
     std::string attribute_file = path + "/" + attribute_;
     LOG(VERBOSE) << "fixup " << attribute_file << " " << uid() << " " << gid() << " " << std::oct
@@ -256,7 +291,20 @@ void DeviceHandler::FixupSysPermissions(const std::string& upath,
     // contain, so we prepend it...
     std::string path = "/sys" + upath;
 
-    for (const auto& s : sysfs_permissions_) {
+    // Only the rules that can match one of the paths MatchWithSubsystem() tries are checked, and
+    // the matching ones are applied in order, as if all of the rules had been checked.
+    std::vector<size_t> candidates;
+    std::string path_basename = Basename(path);
+    sysfs_permissions_matcher_.FindMatches(path, &candidates);
+    sysfs_permissions_matcher_.FindMatches("/sys/class/" + subsystem + "/" + path_basename,
+                                           &candidates);
+    sysfs_permissions_matcher_.FindMatches("/sys/bus/" + subsystem + "/devices/" + path_basename,
+                                           &candidates);
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (size_t i : candidates) {
+        const auto& s = sysfs_permissions_[i];
         if (s.MatchWithSubsystem(path, subsystem)) s.SetPermissions(path);
     }
 
@@ -270,12 +318,15 @@ void DeviceHandler::FixupSysPermissions(const std::string& upath,
 
 std::tuple<mode_t, uid_t, gid_t> DeviceHandler::GetDevicePermissions(
     const std::string& path, const std::vector<std::string>& links) const {
-    // Search the perms list in reverse so that ueventd.$hardware can override ueventd.rc.
-    for (auto it = dev_permissions_.crbegin(); it != dev_permissions_.crend(); ++it) {
-        if (it->Match(path) || std::any_of(links.cbegin(), links.cend(),
-                                           [it](const auto& link) { return it->Match(link); })) {
-            return {it->perm(), it->uid(), it->gid()};
-        }
+    std::vector<size_t> matches;
+    dev_permissions_matcher_.FindMatches(path, &matches);
+    for (const auto& link : links) {
+        dev_permissions_matcher_.FindMatches(link, &matches);
+    }
+    // The last matching rule wins, so that ueventd.$hardware can override ueventd.rc.
+    if (!matches.empty()) {
+        const auto& p = dev_permissions_[*std::max_element(matches.begin(), matches.end())];
+        return {p.perm(), p.uid(), p.gid()};
     }
     /* Default if nothing found. */
     return {0600, 0, 0};
@@ -606,6 +657,8 @@ DeviceHandler::DeviceHandler(std::vector<Permissions> dev_permissions,
                              bool skip_restorecon)
     : dev_permissions_(std::move(dev_permissions)),
       sysfs_permissions_(std::move(sysfs_permissions)),
+      dev_permissions_matcher_(dev_permissions_),
+      sysfs_permissions_matcher_(sysfs_permissions_),
       subsystems_(std::move(subsystems)),
       boot_devices_(std::move(boot_devices)),
       skip_restorecon_(skip_restorecon),
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/file.h>
@@ -37,6 +38,7 @@ namespace init {
 class Permissions {
   public:
     friend void TestPermissions(const Permissions& expected, const Permissions& test);
+    friend class PermissionsMatcher;
 
     Permissions(const std::string& name, mode_t perm, uid_t uid, gid_t gid, bool no_fnm_pathname);
 
@@ -74,6 +76,39 @@ class SysfsPermissions : public Permissions {
     const std::string attribute_;
 };
 
+// Finds the rules in a list of Permissions that match a path without trying each of them in turn.
+// Rules without a '*' are looked up by the whole path, and rules whose only '*' is the last
+// character by each prefix length that any of them has. Only the remaining rules go through
+// fnmatch(), and only if the path starts with the part of the pattern before its first wildcard.
+class PermissionsMatcher {
+  public:
+    PermissionsMatcher() = default;
+    template <typename T>
+    explicit PermissionsMatcher(const std::vector<T>& permissions) {
+        for (size_t i = 0; i < permissions.size(); ++i) {
+            Add(i, permissions[i]);
+        }
+    }
+
+    // Appends the index of every rule that matches |path| to |matches|, in no particular order.
+    void FindMatches(const std::string& path, std::vector<size_t>* matches) const;
+
+  private:
+    struct Wildcard {
+        size_t index;
+        std::string pattern;
+        std::string literal_prefix;
+        int fnmatch_flags;
+    };
+
+    void Add(size_t index, const Permissions& permissions);
+
+    std::unordered_map<std::string, std::vector<size_t>> exact_;
+    std::unordered_map<std::string, std::vector<size_t>> prefixes_;
+    std::set<size_t> prefix_lengths_;
+    std::vector<Wildcard> wildcards_;
+};
+
 class Subsystem {
   public:
     friend class SubsystemParser;
@@ -149,6 +184,8 @@ class DeviceHandler : public UeventHandler {
 
     std::vector<Permissions> dev_permissions_;
     std::vector<SysfsPermissions> sysfs_permissions_;
+    PermissionsMatcher dev_permissions_matcher_;
+    PermissionsMatcher sysfs_permissions_matcher_;
     std::vector<Subsystem> subsystems_;
     std::set<std::string> boot_devices_;
     bool skip_restorecon_;
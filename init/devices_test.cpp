@@ -328,5 +328,32 @@ TEST(device_handler, SysfsPermissionsMatchWithSubsystemBus) {
     EXPECT_EQ(1001U, permissions.gid());
 }
 
+TEST(device_handler, PermissionsMatcherMatchesLikeMatch) {
+    std::vector<Permissions> permissions = {
+            {"/dev/null", 0666, 0, 0, false},
+            {"/dev/dri/*", 0666, 0, 1000, false},
+            {"/dev/*", 0600, 0, 0, false},
+            {"/dev/device*name", 0666, 0, 1000, false},
+            {"/dev/device*name*", 0666, 0, 1000, true},
+            {"/dev/null", 0600, 0, 0, false},
+            {"*", 0600, 0, 0, false},
+            {"/dev/tty[0-9]*", 0620, 0, 0, false},
+    };
+    PermissionsMatcher matcher(permissions);
+
+    for (const std::string path :
+         {"/dev/null", "/dev/nul", "/dev/dri/card0", "/dev/dri/", "/dev/devicename",
+          "/dev/device123name/subdevice", "/dev/ttyS0", "/dev/tty1", "/sys/foo", ""}) {
+        std::vector<size_t> expected;
+        for (size_t i = 0; i < permissions.size(); ++i) {
+            if (permissions[i].Match(path)) expected.emplace_back(i);
+        }
+        std::vector<size_t> matches;
+        matcher.FindMatches(path, &matches);
+        std::sort(matches.begin(), matches.end());
+        EXPECT_EQ(expected, matches) << path;
+    }
+}
+
 }  // namespace init
 }  // namespace android
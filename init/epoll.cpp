@@ -18,13 +18,19 @@
 
 #include <stdint.h>
 #include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <map>
 
 #include <android-base/logging.h>
 
+using android::base::boot_clock;
+
 namespace android {
 namespace init {
 
@@ -44,13 +50,15 @@ Result<void> Epoll::RegisterHandler(int fd, Handler handler, uint32_t events) {
     if (!events) {
         return Error() << "Must specify events";
     }
+    if (fd < 0) {
+        return Error() << "Invalid FD " << fd;
+    }
 
-    auto [it, inserted] = epoll_handlers_.emplace(
-            fd, Info{
-                        .events = events,
-                        .handler = std::move(handler),
-                });
-    if (!inserted) {
+    if (static_cast<size_t>(fd) >= epoll_handlers_.size()) {
+        epoll_handlers_.resize(fd + 1);
+    }
+    Info& info = epoll_handlers_[fd];
+    if (info.handler) {
         return Error() << "Cannot specify two epoll handlers for a given FD";
     }
     epoll_event ev = {
@@ -58,10 +66,13 @@ Result<void> Epoll::RegisterHandler(int fd, Handler handler, uint32_t events) {
             .data.fd = fd,
     };
     if (epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, fd, &ev) == -1) {
-        Result<void> result = ErrnoError() << "epoll_ctl failed to add fd";
-        epoll_handlers_.erase(fd);
-        return result;
+        return ErrnoError() << "epoll_ctl failed to add fd";
     }
+    info = Info{
+            .handler = std::move(handler),
+            .events = events,
+    };
+    num_handlers_++;
     return {};
 }
 
@@ -69,11 +80,14 @@ Result<void> Epoll::UnregisterHandler(int fd) {
     if (epoll_ctl(epoll_fd_.get(), EPOLL_CTL_DEL, fd, nullptr) == -1) {
         return ErrnoError() << "epoll_ctl failed to remove fd";
     }
-    auto it = epoll_handlers_.find(fd);
-    if (it == epoll_handlers_.end()) {
+    if (fd < 0 || static_cast<size_t>(fd) >= epoll_handlers_.size() ||
+        !epoll_handlers_[fd].handler) {
         return Error() << "Attempting to remove epoll handler for FD without an existing handler";
     }
-    to_remove_.insert(it->first);
+    // The handler may be the one running right now, so it is only destroyed once it returns.
+    if (std::find(to_remove_.begin(), to_remove_.end(), fd) == to_remove_.end()) {
+        to_remove_.emplace_back(fd);
+    }
     return {};
 }
 
@@ -86,9 +100,10 @@ Result<int> Epoll::Wait(std::optional<std::chrono::milliseconds> timeout) {
     if (timeout && timeout->count() < INT_MAX) {
         timeout_ms = timeout->count();
     }
-    const auto max_events = epoll_handlers_.size();
-    epoll_event ev[max_events];
-    auto num_events = TEMP_FAILURE_RETRY(epoll_wait(epoll_fd_.get(), ev, max_events, timeout_ms));
+    // Handle every ready FD, up to all of them, on each wakeup.
+    events_.resize(std::max<size_t>(num_handlers_, 1));
+    auto num_events = TEMP_FAILURE_RETRY(
+            epoll_wait(epoll_fd_.get(), events_.data(), events_.size(), timeout_ms));
     if (num_events == -1) {
         return ErrnoError() << "epoll_wait failed";
     }
@@ -96,25 +111,93 @@ Result<int> Epoll::Wait(std::optional<std::chrono::milliseconds> timeout) {
         first_callback_();
     }
     for (int i = 0; i < num_events; ++i) {
-        const auto it = epoll_handlers_.find(ev[i].data.fd);
-        if (it == epoll_handlers_.end()) {
+        const int fd = events_[i].data.fd;
+        if (static_cast<size_t>(fd) >= epoll_handlers_.size() || !epoll_handlers_[fd].handler) {
             continue;
         }
-        const Info& info = it->second;
+        const Info& info = epoll_handlers_[fd];
         if ((info.events & (EPOLLIN | EPOLLPRI)) == (EPOLLIN | EPOLLPRI) &&
-            (ev[i].events & EPOLLIN) != ev[i].events) {
+            (events_[i].events & EPOLLIN) != events_[i].events) {
             // This handler wants to know about exception events, and just got one.
             // Log something informational.
-            LOG(ERROR) << "Received unexpected epoll event set: " << ev[i].events;
+            LOG(ERROR) << "Received unexpected epoll event set: " << events_[i].events;
         }
         info.handler();
         for (auto fd : to_remove_) {
-            epoll_handlers_.erase(fd);
+            epoll_handlers_[fd] = {};
+            num_handlers_--;
         }
         to_remove_.clear();
     }
     return num_events;
 }
 
+Result<Epoll::TimerId> Epoll::AddTimer(boot_clock::time_point deadline, Handler handler) {
+    if (timer_fd_ == -1) {
+        timer_fd_.reset(timerfd_create(CLOCK_BOOTTIME, TFD_CLOEXEC | TFD_NONBLOCK));
+        if (timer_fd_ == -1) {
+            return ErrnoError() << "timerfd_create failed";
+        }
+        if (auto result = RegisterHandler(timer_fd_.get(), [this] { HandleTimers(); });
+            !result.ok()) {
+            timer_fd_.reset();
+            return result.error();
+        }
+    }
+
+    TimerId id = next_timer_id_++;
+    timers_.emplace(std::make_pair(deadline, id), std::move(handler));
+    timer_deadlines_.emplace(id, deadline);
+    if (timers_.begin()->first.second == id) {
+        if (auto result = ArmTimerFd(); !result.ok()) {
+            CancelTimer(id);
+            return result.error();
+        }
+    }
+    return id;
+}
+
+void Epoll::CancelTimer(TimerId id) {
+    auto it = timer_deadlines_.find(id);
+    if (it == timer_deadlines_.end()) return;
+    timers_.erase(std::make_pair(it->second, id));
+    timer_deadlines_.erase(it);
+    // If the earliest timer was cancelled, the timerfd may fire early, which HandleTimers()
+    // tolerates, so it isn't rearmed here.
+}
+
+Result<void> Epoll::ArmTimerFd() {
+    itimerspec spec = {};
+    if (!timers_.empty()) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          timers_.begin()->first.first.time_since_epoch())
+                          .count();
+        // An all-zero it_value disarms the timer, so never ask for time 0.
+        ns = std::max<int64_t>(ns, 1);
+        spec.it_value.tv_sec = ns / 1000000000;
+        spec.it_value.tv_nsec = ns % 1000000000;
+    }
+    if (timerfd_settime(timer_fd_.get(), TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        return ErrnoError() << "timerfd_settime failed";
+    }
+    return {};
+}
+
+void Epoll::HandleTimers() {
+    uint64_t expirations;
+    TEMP_FAILURE_RETRY(read(timer_fd_.get(), &expirations, sizeof(expirations)));
+
+    auto now = boot_clock::now();
+    while (!timers_.empty() && timers_.begin()->first.first <= now) {
+        // Remove the timer before calling it, so that it can add or cancel timers itself.
+        auto node = timers_.extract(timers_.begin());
+        timer_deadlines_.erase(node.key().second);
+        node.mapped()();
+    }
+    if (auto result = ArmTimerFd(); !result.ok()) {
+        LOG(ERROR) << result.error();
+    }
+}
+
 }  // namespace init
 }  // namespace android
@@ -24,9 +24,10 @@
 #include <map>
 #include <memory>
 #include <optional>
-#include <unordered_set>
+#include <unordered_map>
 #include <vector>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/unique_fd.h>
 
 #include "result.h"
@@ -39,6 +40,7 @@ class Epoll {
     Epoll();
 
     typedef std::function<void()> Handler;
+    typedef uint64_t TimerId;
 
     Result<void> Open();
     Result<void> RegisterHandler(int fd, Handler handler, uint32_t events = EPOLLIN);
@@ -46,16 +48,32 @@ class Epoll {
     void SetFirstCallback(std::function<void()> first_callback);
     Result<int> Wait(std::optional<std::chrono::milliseconds> timeout);
 
+    // Calls |handler| from Wait() once boot_clock reaches |deadline|. All timers share a single
+    // timerfd, which is armed for the earliest of them.
+    Result<TimerId> AddTimer(android::base::boot_clock::time_point deadline, Handler handler);
+    void CancelTimer(TimerId id);
+
   private:
     struct Info {
         Handler handler;
         uint32_t events;
     };
 
+    Result<void> ArmTimerFd();
+    void HandleTimers();
+
     android::base::unique_fd epoll_fd_;
-    std::map<int, Info> epoll_handlers_;
+    // Indexed by fd. A slot without a handler is unused.
+    std::vector<Info> epoll_handlers_;
+    size_t num_handlers_ = 0;
+    std::vector<epoll_event> events_;
     std::function<void()> first_callback_;
-    std::unordered_set<int> to_remove_;
+    std::vector<int> to_remove_;
+
+    android::base::unique_fd timer_fd_;
+    TimerId next_timer_id_ = 1;
+    std::map<std::pair<android::base::boot_clock::time_point, TimerId>, Handler> timers_;
+    std::unordered_map<TimerId, android::base::boot_clock::time_point> timer_deadlines_;
 };
 
 }  // namespace init
@@ -18,12 +18,16 @@
 
 #include <sys/unistd.h>
 
+#include <chrono>
 #include <unordered_set>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <gtest/gtest.h>
 
+using namespace std::chrono_literals;
+
 namespace android {
 namespace init {
 
@@ -66,5 +70,25 @@ TEST(epoll, UnregisterHandler) {
     ASSERT_TRUE(handler_invoked);
 }
 
+TEST(epoll, Timers) {
+    Epoll epoll;
+    ASSERT_RESULT_OK(epoll.Open());
+
+    auto now = android::base::boot_clock::now();
+    std::vector<int> fired;
+    ASSERT_RESULT_OK(epoll.AddTimer(now + 20ms, [&] { fired.emplace_back(2); }));
+    ASSERT_RESULT_OK(epoll.AddTimer(now + 10ms, [&] { fired.emplace_back(1); }));
+    auto cancelled = epoll.AddTimer(now + 5ms, [&] { fired.emplace_back(0); });
+    ASSERT_RESULT_OK(cancelled);
+    epoll.CancelTimer(*cancelled);
+
+    while (fired.size() < 2) {
+        ASSERT_RESULT_OK(epoll.Wait(1s));
+        ASSERT_LT(android::base::boot_clock::now(), now + 1s);
+    }
+    EXPECT_EQ((std::vector<int>{1, 2}), fired);
+    EXPECT_GE(android::base::boot_clock::now(), now + 20ms);
+}
+
 }  // namespace init
 }  // namespace android
@@ -28,6 +28,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <thread>
 
 #include <android-base/chrono_utils.h>
@@ -64,19 +65,57 @@ bool EqualMatch(const std::string& pattern, const std::string& path) {
 }
 }  // namespace
 
+static bool CopyFirmwareWithReadWrite(int fw_fd, int data_fd, size_t remaining) {
+    char buf[64 * 1024];
+    while (remaining > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(read(fw_fd, buf, std::min(remaining, sizeof(buf))));
+        if (n <= 0) {
+            if (n == 0) errno = EIO;
+            return false;
+        }
+        if (!WriteFully(data_fd, buf, n)) return false;
+        remaining -= n;
+    }
+    return true;
+}
+
+static bool CopyFirmware(int fw_fd, int data_fd, size_t fw_size) {
+    // sendfile() may transfer less than requested (it's capped at about 2GiB per call, and
+    // the sysfs side may accept less), so keep going until the whole image is in the kernel's
+    // buffer rather than committing a truncated firmware image.
+    size_t remaining = fw_size;
+    while (remaining > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(sendfile(data_fd, fw_fd, nullptr, remaining));
+        if (n == -1) {
+            // Some firmware files live on filesystems that don't support sendfile().
+            if (remaining == fw_size && (errno == EINVAL || errno == ENOSYS)) {
+                return CopyFirmwareWithReadWrite(fw_fd, data_fd, remaining);
+            }
+            return false;
+        }
+        if (n == 0) {
+            // The file shrank after we stat()ed it.
+            errno = EIO;
+            return false;
+        }
+        remaining -= n;
+    }
+    return true;
+}
+
 static void LoadFirmware(const std::string& firmware, const std::string& root, int fw_fd,
                          size_t fw_size, int loading_fd, int data_fd) {
     // Start transfer.
     WriteFully(loading_fd, "1", 1);
 
     // Copy the firmware.
-    int rc = sendfile(data_fd, fw_fd, nullptr, fw_size);
-    if (rc == -1) {
-        PLOG(ERROR) << "firmware: sendfile failed { '" << root << "', '" << firmware << "' }";
+    bool copied = CopyFirmware(fw_fd, data_fd, fw_size);
+    if (!copied) {
+        PLOG(ERROR) << "firmware: copy failed { '" << root << "', '" << firmware << "' }";
     }
 
     // Tell the firmware whether to abort or commit.
-    const char* response = (rc != -1) ? "0" : "-1";
+    const char* response = copied ? "0" : "-1";
     WriteFully(loading_fd, response, strlen(response));
 }
 
@@ -36,6 +36,7 @@
 #include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/stringprintf.h>
 #include <android/avf_cc_flags.h>
 #include <modprobe/modprobe.h>
@@ -209,9 +210,26 @@ std::string GetModuleLoadList(BootMode boot_mode, const std::string& dir_path) {
     return module_load_file;
 }
 
+// The number of threads used to load kernel modules in parallel, from
+// androidboot.load_modules_parallel_threads, or the number of CPUs if that isn't set.
+static int GetModuleLoadThreads(const std::string& bootconfig) {
+    static constexpr char kKey[] = "androidboot.load_modules_parallel_threads = \"";
+    int threads = std::thread::hardware_concurrency();
+    if (auto start = bootconfig.find(kKey); start != std::string::npos) {
+        start += sizeof(kKey) - 1;
+        auto value = bootconfig.substr(start, bootconfig.find('"', start) - start);
+        if (!android::base::ParseInt(value, &threads, 1)) {
+            LOG(WARNING) << "Ignoring invalid androidboot.load_modules_parallel_threads '"
+                         << value << "'";
+            threads = std::thread::hardware_concurrency();
+        }
+    }
+    return threads;
+}
+
 #define MODULE_BASE_DIR "/lib/modules"
-bool LoadKernelModules(BootMode boot_mode, bool want_console, bool want_parallel, bool disable_usb_port,
-                       int& modules_loaded) {
+bool LoadKernelModules(BootMode boot_mode, bool want_console, bool want_parallel, int num_threads,
+                       bool disable_usb_port, int& modules_loaded) {
     struct utsname uts{};
     if (uname(&uts)) {
         LOG(FATAL) << "Failed to get kernel version.";
@@ -285,7 +303,7 @@ bool LoadKernelModules(BootMode boot_mode, bool want_console, bool want_parallel
         }
     }
     Modprobe m({MODULE_BASE_DIR}, GetModuleLoadList(boot_mode, MODULE_BASE_DIR), true, disable_usb_port);
-    bool retval = (want_parallel) ? m.LoadModulesParallel(std::thread::hardware_concurrency())
+    bool retval = (want_parallel) ? m.LoadModulesParallel(num_threads)
                                   : m.LoadListedModules(!want_console);
     modules_loaded = m.GetModuleCount();
     if (modules_loaded > 0) {
@@ -434,8 +452,8 @@ int FirstStageMain(int argc, char** argv) {
     int module_count = 0;
     BootMode boot_mode = GetBootMode(cmdline, bootconfig);
     bool disable_usb_port = boot_mode == BootMode::NORMAL_MODE;
-    if (!LoadKernelModules(boot_mode, want_console,
-                           want_parallel, disable_usb_port, module_count)) {
+    if (!LoadKernelModules(boot_mode, want_console, want_parallel, GetModuleLoadThreads(bootconfig),
+                           disable_usb_port, module_count)) {
         if (want_console != FirstStageConsoleParam::DISABLED) {
             LOG(ERROR) << "Failed to load kernel modules, starting console";
         } else {
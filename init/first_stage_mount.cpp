@@ -21,12 +21,14 @@
 #include <sys/mount.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/chrono_utils.h>
@@ -95,6 +97,7 @@ class FirstStageMountVBootV2 : public FirstStageMount {
     bool CreateSnapshotPartitions(SnapshotManager* sm);
     bool MountPartition(const Fstab::iterator& begin, bool erase_same_mounts,
                         Fstab::iterator* end = nullptr);
+    bool MountFirstOf(const Fstab::iterator& begin, const Fstab::iterator& end);
 
     bool MountPartitions();
     bool TrySwitchSystemAsRoot();
@@ -109,7 +112,7 @@ class FirstStageMountVBootV2 : public FirstStageMount {
     void CopyDsuAvbKeys();
 
     bool GetDmVerityDevices(std::set<std::string>* devices);
-    bool SetUpDmVerity(FstabEntry* fstab_entry);
+    bool SetUpDmVerity(FstabEntry* fstab_entry, std::set<std::string>* dm_devices = nullptr);
 
     bool InitAvbHandle();
 
@@ -451,18 +454,11 @@ bool FirstStageMountVBootV2::MountPartition(const Fstab::iterator& begin, bool e
         LOG(INFO) << "AVB is not enabled, skip verity setup for '" << begin->mount_point << "'";
     }
 
-    bool mounted = (fs_mgr_do_mount_one(*begin) == 0);
-
-    // Try other mounts with the same mount point.
     Fstab::iterator current = begin + 1;
-    for (; current != fstab_.end() && current->mount_point == begin->mount_point; current++) {
-        if (!mounted) {
-            // blk_device is already updated to /dev/dm-<N> by SetUpDmVerity() above.
-            // Copy it from the begin iterator.
-            current->blk_device = begin->blk_device;
-            mounted = (fs_mgr_do_mount_one(*current) == 0);
-        }
+    while (current != fstab_.end() && current->mount_point == begin->mount_point) {
+        current++;
     }
+    bool mounted = MountFirstOf(begin, current);
     if (erase_same_mounts) {
         current = fstab_.erase(begin, current);
     }
@@ -581,6 +577,30 @@ static bool MaybeDeriveMicrodroidVendorDiceNode(Fstab* fstab) {
     return true;
 }
 
+// Mounts the first of the entries in [begin, end), which share a mount point, that can be mounted.
+bool FirstStageMountVBootV2::MountFirstOf(const Fstab::iterator& begin,
+                                          const Fstab::iterator& end) {
+    if (fs_mgr_do_mount_one(*begin) == 0) {
+        return true;
+    }
+    // Try other mounts with the same mount point.
+    for (auto current = begin + 1; current != end; current++) {
+        // blk_device is already updated to /dev/dm-<N> by SetUpDmVerity().
+        // Copy it from the begin iterator.
+        current->blk_device = begin->blk_device;
+        if (fs_mgr_do_mount_one(*current) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool IsNestedMountPoint(const std::string& path, const std::string& other) {
+    if (path.size() < other.size()) return IsNestedMountPoint(other, path);
+    return path == other || other == "/" ||
+           (android::base::StartsWith(path, other) && path[other.size()] == '/');
+}
+
 bool FirstStageMountVBootV2::MountPartitions() {
     if (!TrySwitchSystemAsRoot()) return false;
 
@@ -592,6 +612,13 @@ bool FirstStageMountVBootV2::MountPartitions() {
 
     if (!SkipMountingPartitions(&fstab_, true /* verbose */)) return false;
 
+    // Entries that share a mount point, the first of which that can be mounted is mounted.
+    struct MountGroup {
+        Fstab::iterator begin;
+        Fstab::iterator end;
+        bool ok = true;
+    };
+    std::vector<MountGroup> groups;
     for (auto current = fstab_.begin(); current != fstab_.end();) {
         // We've already mounted /system above.
         if (current->mount_point == "/system") {
@@ -613,20 +640,101 @@ bool FirstStageMountVBootV2::MountPartitions() {
             continue;
         }
 
-        Fstab::iterator end;
-        if (!MountPartition(current, false /* erase_same_mounts */, &end)) {
-            if (current->fs_mgr_flags.no_fail) {
-                LOG(INFO) << "Failed to mount " << current->mount_point
-                          << ", ignoring mount for no_fail partition";
-            } else if (current->fs_mgr_flags.formattable) {
-                LOG(INFO) << "Failed to mount " << current->mount_point
-                          << ", ignoring mount for formattable partition";
+        auto end = current + 1;
+        while (end != fstab_.end() && end->mount_point == current->mount_point) {
+            ++end;
+        }
+        groups.push_back({current, end});
+        current = end;
+    }
+
+    // Map the logical partitions, then set up dm-verity on top of them, and only wait for the
+    // uevents of each batch of dm devices together rather than one device at a time.
+    auto init_dm_devices = [&](std::set<std::string> dm_devices) {
+        if (block_dev_init_.InitDmDevices(&dm_devices)) return;
+        for (auto& group : groups) {
+            if (dm_devices.count(group.begin->blk_device)) group.ok = false;
+        }
+    };
+    std::set<std::string> dm_devices;
+    for (auto& group : groups) {
+        if (group.begin->fs_mgr_flags.logical) {
+            if (!fs_mgr_update_logical_partition(&(*group.begin))) {
+                group.ok = false;
+                continue;
+            }
+            dm_devices.emplace(group.begin->blk_device);
+        }
+    }
+    init_dm_devices(std::move(dm_devices));
+
+    dm_devices.clear();
+    for (auto& group : groups) {
+        if (!group.ok) continue;
+        if (group.begin->fs_mgr_flags.avb) {
+            if (!SetUpDmVerity(&(*group.begin), &dm_devices)) {
+                PLOG(ERROR) << "Failed to setup verity for '" << group.begin->mount_point << "'";
+                group.ok = false;
+            }
+        } else {
+            LOG(INFO) << "AVB is not enabled, skip verity setup for '"
+                      << group.begin->mount_point << "'";
+        }
+    }
+    init_dm_devices(std::move(dm_devices));
+
+    // Mount points nested in one another are mounted in fstab order by the same thread, while
+    // independent ones are mounted in parallel.
+    std::vector<std::vector<MountGroup*>> trees;
+    for (auto& group : groups) {
+        std::vector<MountGroup*> tree;
+        for (auto it = trees.begin(); it != trees.end();) {
+            bool nested = std::any_of(it->begin(), it->end(), [&](const auto* other) {
+                return IsNestedMountPoint(group.begin->mount_point, other->begin->mount_point);
+            });
+            if (nested) {
+                tree.insert(tree.end(), it->begin(), it->end());
+                it = trees.erase(it);
             } else {
-                PLOG(ERROR) << "Failed to mount " << current->mount_point;
-                return false;
+                ++it;
             }
         }
-        current = end;
+        // |groups| is in fstab order, so keep the merged trees in that order too.
+        std::sort(tree.begin(), tree.end());
+        tree.emplace_back(&group);
+        trees.emplace_back(std::move(tree));
+    }
+    auto mount_tree = [this](const std::vector<MountGroup*>& tree) {
+        for (auto group : tree) {
+            group->ok = group->ok &&
+                        fs_mgr_create_canonical_mount_point(group->begin->mount_point) &&
+                        MountFirstOf(group->begin, group->end);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < trees.size(); i++) {
+        threads.emplace_back(mount_tree, std::cref(trees[i]));
+    }
+    if (!trees.empty()) {
+        mount_tree(trees[0]);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (const auto& group : groups) {
+        if (group.ok) continue;
+        auto current = group.begin;
+        if (current->fs_mgr_flags.no_fail) {
+            LOG(INFO) << "Failed to mount " << current->mount_point
+                      << ", ignoring mount for no_fail partition";
+        } else if (current->fs_mgr_flags.formattable) {
+            LOG(INFO) << "Failed to mount " << current->mount_point
+                      << ", ignoring mount for formattable partition";
+        } else {
+            LOG(ERROR) << "Failed to mount " << current->mount_point;
+            return false;
+        }
     }
 
     for (const auto& entry : fstab_) {
@@ -801,7 +909,10 @@ bool IsHashtreeDisabled(const AvbHandle& vbmeta, const std::string& mount_point)
     return false;
 }
 
-bool FirstStageMountVBootV2::SetUpDmVerity(FstabEntry* fstab_entry) {
+// If |dm_devices| is given, the verity device is added to it rather than being created, so that the
+// caller can create several of them at once.
+bool FirstStageMountVBootV2::SetUpDmVerity(FstabEntry* fstab_entry,
+                                           std::set<std::string>* dm_devices) {
     AvbHashtreeResult hashtree_result;
 
     // It's possible for a fstab_entry to have both avb_keys and avb flag.
@@ -860,6 +971,10 @@ bool FirstStageMountVBootV2::SetUpDmVerity(FstabEntry* fstab_entry) {
             // The exact block device name (fstab_rec->blk_device) is changed to
             // "/dev/block/dm-XX". Needs to create it because ueventd isn't started in init
             // first stage.
+            if (dm_devices) {
+                dm_devices->emplace(fstab_entry->blk_device);
+                return true;
+            }
             return block_dev_init_.InitDmDevice(fstab_entry->blk_device);
         default:
             return false;
@@ -11,11 +11,12 @@ mkdir -p $TMPDIR
 LOGROOT=/data/bootchart
 TARBALL=bootchart.tgz
 
-FILES="header proc_stat.log proc_ps.log proc_diskstats.log"
+FILES="header proc_stat.log proc_ps.log proc_diskstats.log service_start.log"
 
-for f in $FILES; do
-    adb "${@}" pull $LOGROOT/$f $TMPDIR/$f 2>&1 > /dev/null
-done
+# init samples into a ring buffer, which is decoded into the log files here.
+adb "${@}" pull $LOGROOT/header $TMPDIR/header 2>&1 > /dev/null
+adb "${@}" pull $LOGROOT/bootchart.ring $TMPDIR/bootchart.ring 2>&1 > /dev/null
+"$(dirname "$0")"/decode-bootchart.py $TMPDIR/bootchart.ring $TMPDIR
 (cd $TMPDIR && tar -czf $TARBALL $FILES)
 pybootchartgui ${TMPDIR}/${TARBALL}
 xdg-open ${TARBALL%.tgz}.png
@@ -20,6 +20,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include <chrono>
 #include <optional>
 #include <string>
 
@@ -40,6 +41,9 @@
 namespace android {
 namespace init {
 
+// bootchart.h
+inline void BootchartLogServiceStart(const std::string&, pid_t, std::chrono::nanoseconds) {}
+
 // property_service.h
 inline bool CanReadProperty(const std::string&, const std::string&) {
     return true;
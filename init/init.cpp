@@ -26,6 +26,7 @@
 #include <sys/eventfd.h>
 #include <sys/mount.h>
 #include <sys/signalfd.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/utsname.h>
 #include <unistd.h>
@@ -78,6 +79,7 @@
 #include "mount_namespace.h"
 #include "property_service.h"
 #include "proto_utils.h"
+#include "rc_cache.h"
 #include "reboot.h"
 #include "reboot_utils.h"
 #include "second_stage_resources.h"
@@ -335,11 +337,34 @@ Parser CreateApexConfigParser(ActionManager& action_manager, ServiceList& servic
     return parser;
 }
 
+static constexpr char kRcCacheDir[] = "/metadata/init";
+
+// The builds of every partition that boot scripts are loaded from.
+static std::string GetRcCacheFingerprint() {
+    std::vector<std::string> fingerprints;
+    for (const auto& partition : {"", "system_ext.", "vendor.", "odm.", "product."}) {
+        fingerprints.emplace_back(GetProperty("ro."s + partition + "build.fingerprint", ""));
+    }
+    return android::base::Join(fingerprints, '|');
+}
+
 static void LoadBootScripts(ActionManager& action_manager, ServiceList& service_list) {
     Parser parser = CreateParser(action_manager, service_list);
 
     std::string bootscript = GetProperty("ro.boot.init_rc", "");
     if (bootscript.empty()) {
+        // Boot scripts are parsed before /data is mounted, so the cache has to live in /metadata.
+        std::unique_ptr<RcCache> rc_cache;
+        if (android::base::GetBoolProperty("ro.init.rc_cache", false)) {
+            if (mkdir(kRcCacheDir, 0700) < 0 && errno != EEXIST) {
+                PLOG(WARNING) << "Could not create " << kRcCacheDir;
+            }
+            rc_cache = std::make_unique<RcCache>(kRcCacheDir + "/rc_cache"s,
+                                                 GetRcCacheFingerprint());
+            rc_cache->Load();
+            parser.set_rc_cache(rc_cache.get());
+        }
+
         parser.ParseConfig("/system/etc/init/hw/init.rc");
         if (!parser.ParseConfig("/system/etc/init")) {
             late_import_paths.emplace_back("/system/etc/init");
@@ -356,6 +381,13 @@ static void LoadBootScripts(ActionManager& action_manager, ServiceList& service_
         if (!parser.ParseConfig("/product/etc/init")) {
             late_import_paths.emplace_back("/product/etc/init");
         }
+
+        if (rc_cache) {
+            parser.set_rc_cache(nullptr);
+            if (auto result = rc_cache->Save(); !result.ok()) {
+                LOG(WARNING) << "Could not save rc cache: " << result.error();
+            }
+        }
     } else {
         parser.ParseConfig(bootscript);
     }
@@ -383,6 +415,8 @@ void PropertyChanged(const std::string& name, const std::string& value) {
 static std::optional<boot_clock::time_point> HandleProcessActions() {
     std::optional<boot_clock::time_point> next_process_action_time;
     for (const auto& s : ServiceList::GetInstance()) {
+        s->MaybePublishStartTimes();
+
         if ((s->flags() & SVC_RUNNING) && s->timeout_period()) {
             auto timeout_time = s->time_started() + *s->timeout_period();
             if (boot_clock::now() > timeout_time) {
@@ -647,6 +681,10 @@ static Result<void> SetupCgroupsAction(const BuiltinArguments&) {
     if (!CgroupSetup()) {
         return ErrnoError() << "Failed to setup cgroups";
     }
+    // Processes fall back to parsing the json files if this fails.
+    if (!WriteTaskProfilesRcFile()) {
+        LOG(WARNING) << "Failed to write compiled task profiles";
+    }
 
     return {};
 }
@@ -725,7 +763,7 @@ static void HandleSignalFd(int signal) {
 
     switch (siginfo.ssi_signo) {
         case SIGCHLD:
-            ReapAnyOutstandingChildren();
+            // Children are reaped by ReapChildren(), which runs first on every epoll wakeup.
             break;
         case SIGTERM:
             HandleSigtermSignal(siginfo);
@@ -736,6 +774,19 @@ static void HandleSignalFd(int signal) {
     }
 }
 
+// How long each iteration of the main loop may spend reaping children, when many exit at once.
+static constexpr auto kReapTimeSlice = 50ms;
+// Set when ReapChildren() ran out of time, so some children that exited may not be reaped yet.
+static bool children_left_to_reap = false;
+
+static void ReapChildren() {
+    children_left_to_reap = !ReapAnyOutstandingChildren(kReapTimeSlice);
+    if (children_left_to_reap) {
+        // Come back to the rest after the main loop had a chance to run.
+        WakeMainInitThread();
+    }
+}
+
 static void UnblockSignals() {
     const struct sigaction act { .sa_handler = SIG_DFL };
     sigaction(SIGCHLD, &act, nullptr);
@@ -872,6 +923,23 @@ static void RecordStageBoottimes(const boot_clock::time_point& second_stage_star
     }
     unsetenv(kEnvSelinuxStartedAt);
 
+    if (auto stall_ms = getenv(kEnvSnapuserdTransitionStallMs); stall_ms) {
+        SetProperty("ro.boottime.init.snapuserd_transition_stall", stall_ms);
+        unsetenv(kEnvSnapuserdTransitionStallMs);
+    }
+
+    static constexpr std::pair<const char*, const char*> kSelinuxPhases[] = {
+            {kEnvSelinuxCompileMs, "ro.boottime.init.selinux.compile"},
+            {kEnvSelinuxReadMs, "ro.boottime.init.selinux.read"},
+            {kEnvSelinuxLoadMs, "ro.boottime.init.selinux.load"},
+    };
+    for (const auto& [env, property] : kSelinuxPhases) {
+        if (auto duration_ms = getenv(env); duration_ms) {
+            SetProperty(property, duration_ms);
+            unsetenv(env);
+        }
+    }
+
     if (selinux_start_time_ns == -1) return;
     if (first_stage_start_time_ns == -1) return;
 
@@ -1018,7 +1086,7 @@ int SecondStageMain(int argc, char** argv) {
     // We always reap children before responding to the other pending functions. This is to
     // prevent a race where other daemons see that a service has exited and ask init to
     // start it again via ctl.start before init has reaped it.
-    epoll.SetFirstCallback(ReapAnyOutstandingChildren);
+    epoll.SetFirstCallback(ReapChildren);
 
     InstallSignalFdHandler(&epoll);
     InstallInitNotifier(&epoll);
@@ -1106,6 +1174,7 @@ int SecondStageMain(int argc, char** argv) {
 
     // Restore prio before main loop
     setpriority(PRIO_PROCESS, 0, 0);
+    std::optional<Epoll::TimerId> next_action_timer;
     while (true) {
         // By default, sleep until something happens. Do not convert far_future into
         // std::chrono::milliseconds because that would trigger an overflow. The unit of boot_clock
@@ -1139,17 +1208,32 @@ int SecondStageMain(int argc, char** argv) {
             }
         }
 
+        // Wake up at next_action_time through an epoll timer, rather than an epoll_wait()
+        // timeout that is rounded up to milliseconds.
+        if (next_action_timer) {
+            epoll.CancelTimer(*next_action_timer);
+            next_action_timer.reset();
+        }
         std::optional<std::chrono::milliseconds> epoll_timeout;
         if (next_action_time != far_future) {
-            epoll_timeout = std::chrono::ceil<std::chrono::milliseconds>(
-                    std::max(next_action_time - boot_clock::now(), 0ns));
+            if (auto timer = epoll.AddTimer(next_action_time, [] {}); timer.ok()) {
+                next_action_timer = *timer;
+            } else {
+                LOG(ERROR) << timer.error();
+                epoll_timeout = std::chrono::ceil<std::chrono::milliseconds>(
+                        std::max(next_action_time - boot_clock::now(), 0ns));
+            }
         }
         auto epoll_result = epoll.Wait(epoll_timeout);
         if (!epoll_result.ok()) {
             LOG(ERROR) << epoll_result.error();
         }
         if (!IsShuttingDown()) {
-            HandleControlMessages();
+            // Control messages wait until every child that exited is reaped, for the same reason
+            // that ReapChildren() runs first.
+            if (!children_left_to_reap) {
+                HandleControlMessages();
+            }
             SetUsbController();
         }
     }
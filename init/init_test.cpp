@@ -176,6 +176,46 @@ execute_third
     EXPECT_EQ(3, num_executed);
 }
 
+TEST(init, PropertyTriggerOrder) {
+    std::string init_script =
+            R"init(
+on property:init.test.trigger=1
+execute_first
+
+on property:init.test.other=1
+execute_never
+
+on property:init.test.trigger=*
+execute_second
+)init";
+
+    std::vector<std::string> executed;
+    auto record = [&executed](const BuiltinArguments& args) {
+        executed.emplace_back(args[0]);
+        return Result<void>{};
+    };
+    BuiltinFunctionMap test_function_map = {
+            {"execute_first", {0, 0, {false, record}}},
+            {"execute_never", {0, 0, {false, record}}},
+            {"execute_second", {0, 0, {false, record}}},
+    };
+
+    ActionManagerCommand set_one = [](ActionManager& am) {
+        am.QueuePropertyChange("init.test.trigger", "1");
+    };
+    ActionManagerCommand set_two = [](ActionManager& am) {
+        am.QueuePropertyChange("init.test.trigger", "2");
+    };
+    std::vector<ActionManagerCommand> commands{set_one, set_two};
+
+    ActionManager action_manager;
+    ServiceList service_list;
+    TestInitText(init_script, test_function_map, commands, &action_manager, &service_list);
+
+    std::vector<std::string> expected{"execute_first", "execute_second", "execute_second"};
+    EXPECT_EQ(expected, executed);
+}
+
 TEST(init, OverrideService) {
     std::string init_script = R"init(
 service A something
@@ -201,6 +241,78 @@ service A something
     EXPECT_TRUE(service->is_override());
 }
 
+TEST(init, ParseConfigLinesKeepsCallerOrder) {
+    TemporaryFile first;
+    ASSERT_TRUE(android::base::WriteStringToFd(R"init(
+service A something
+    class first
+    user nobody
+)init",
+                                               first.fd));
+    TemporaryFile second;
+    ASSERT_TRUE(android::base::WriteStringToFd(R"init(
+service A something
+    class second
+    user nobody
+    override
+)init",
+                                               second.fd));
+
+    // Tokenize out of order, as concurrent callers may, but parse in file order.
+    auto second_lines = Parser::TokenizeConfigFile(second.path);
+    ASSERT_RESULT_OK(second_lines);
+    auto first_lines = Parser::TokenizeConfigFile(first.path);
+    ASSERT_RESULT_OK(first_lines);
+
+    ServiceList service_list;
+    Parser parser;
+    parser.AddSectionParser("service",
+                            std::make_unique<ServiceParser>(&service_list, nullptr, std::nullopt));
+    parser.ParseConfigLines(first.path, *first_lines);
+    parser.ParseConfigLines(second.path, *second_lines);
+    EXPECT_EQ(0U, parser.parse_error_count());
+
+    ASSERT_EQ(1, std::distance(service_list.begin(), service_list.end()));
+    EXPECT_EQ(std::set<std::string>({"second"}), service_list.begin()->get()->classnames());
+
+    EXPECT_FALSE(Parser::TokenizeConfigFile("/does/not/exist.rc").ok());
+}
+
+TEST(init, ServiceListIndexesServices) {
+    std::string init_script = R"init(
+service A something
+    interface aidl a_interface
+
+service B something
+    interface aidl b_interface
+
+service A something_else
+    interface aidl a_override_interface
+    override
+)init";
+
+    ActionManager action_manager;
+    ServiceList service_list;
+    TestInitText(init_script, BuiltinFunctionMap(), {}, &action_manager, &service_list);
+    ASSERT_EQ(2, std::distance(service_list.begin(), service_list.end()));
+
+    auto a = service_list.FindService("A");
+    ASSERT_NE(nullptr, a);
+    EXPECT_EQ(a, service_list.FindInterface("aidl/a_override_interface"));
+    EXPECT_EQ(nullptr, service_list.FindInterface("aidl/a_interface"));
+    auto b = service_list.FindService("B");
+    ASSERT_NE(nullptr, b);
+    EXPECT_EQ(b, service_list.FindInterface("aidl/b_interface"));
+    EXPECT_EQ(nullptr, service_list.FindService("C"));
+    EXPECT_EQ(nullptr, service_list.FindServiceByPid(1));
+
+    service_list.RemoveServiceIf(
+            [](const std::unique_ptr<Service>& s) { return s->name() == "B"; });
+    EXPECT_EQ(nullptr, service_list.FindService("B"));
+    EXPECT_EQ(nullptr, service_list.FindInterface("aidl/b_interface"));
+    EXPECT_EQ(a, service_list.FindService("A"));
+}
+
 TEST(init, StartConsole) {
     if (GetProperty("ro.build.type", "") == "user") {
         GTEST_SKIP() << "Must run on userdebug/eng builds. b/262090304";
@@ -25,8 +25,10 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <charconv>
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -49,27 +51,53 @@ namespace init {
 
 namespace {
 
-MountHandlerEntry ParseMount(const std::string& line) {
-    auto fields = android::base::Split(line, " ");
-    while (fields.size() < 3) fields.emplace_back("");
-    if (fields[0] == "/dev/root") {
+// Parses a line of /proc/self/mountinfo:
+//   36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+bool ParseMountInfo(std::string_view line, int* mount_id, std::string_view* source,
+                    std::string_view* mount_point, std::string_view* fs_type) {
+    auto next_field = [&line]() {
+        auto end = line.find(' ');
+        auto field = line.substr(0, end);
+        line.remove_prefix(end == std::string_view::npos ? line.size() : end + 1);
+        return field;
+    };
+    auto id = next_field();
+    if (std::from_chars(id.data(), id.data() + id.size(), *mount_id).ec != std::errc()) {
+        return false;
+    }
+    // Parent id, major:minor and root.
+    for (int i = 0; i < 3; i++) next_field();
+    *mount_point = next_field();
+    // Mount options and the optional fields, up to the separator.
+    for (auto field = next_field(); field != "-"; field = next_field()) {
+        if (line.empty()) return false;
+    }
+    *fs_type = next_field();
+    *source = next_field();
+    return !mount_point->empty() && !fs_type->empty();
+}
+
+MountHandlerEntry ResolveMount(std::string_view source, std::string_view mount_point,
+                               std::string_view fs_type) {
+    std::string blk_device(source);
+    if (blk_device == "/dev/root") {
         auto& dm = dm::DeviceMapper::Instance();
         std::string path;
         if (dm.GetDmDevicePathByName("system", &path) || dm.GetDmDevicePathByName("vroot", &path)) {
-            fields[0] = path;
+            blk_device = path;
         } else if (android::fs_mgr::Fstab fstab; android::fs_mgr::ReadDefaultFstab(&fstab)) {
             auto entry = GetEntryForMountPoint(&fstab, "/");
             if (entry || (entry = GetEntryForMountPoint(&fstab, "/system"))) {
-                fields[0] = entry->blk_device;
+                blk_device = entry->blk_device;
             }
         }
     }
-    if (android::base::StartsWith(fields[0], "/dev/")) {
-        if (std::string link; android::base::Readlink(fields[0], &link)) {
-            fields[0] = link;
+    if (android::base::StartsWith(blk_device, "/dev/")) {
+        if (std::string link; android::base::Readlink(blk_device, &link)) {
+            blk_device = link;
         }
     }
-    return MountHandlerEntry(fields[0], fields[1], fields[2]);
+    return MountHandlerEntry(blk_device, std::string(mount_point), std::string(fs_type));
 }
 
 // return sda25 for dm-4, sda25 for sda25, or mmcblk0p24 for mmcblk0p24
@@ -164,45 +192,85 @@ bool MountHandlerEntry::operator<(const MountHandlerEntry& r) const {
     return fs_type < r.fs_type;
 }
 
-MountHandler::MountHandler(Epoll* epoll) : epoll_(epoll), fp_(fopen("/proc/mounts", "re"), fclose) {
-    if (!fp_) PLOG(FATAL) << "Could not open /proc/mounts";
+// mountinfo is polled the same way as /proc/mounts, and has mount ids: only the mounts that
+// changed since the last read need to be resolved.
+MountHandler::MountHandler(Epoll* epoll)
+    : epoll_(epoll), fd_(open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC)) {
+    if (fd_ < 0) PLOG(FATAL) << "Could not open /proc/self/mountinfo";
     auto result = epoll->RegisterHandler(
-            fileno(fp_.get()), [this]() { this->MountHandlerFunction(); }, EPOLLERR | EPOLLPRI);
+            fd_.get(), [this]() { this->MountHandlerFunction(); }, EPOLLERR | EPOLLPRI);
     if (!result.ok()) LOG(FATAL) << result.error();
 }
 
 MountHandler::~MountHandler() {
-    if (fp_) epoll_->UnregisterHandler(fileno(fp_.get()));
+    if (fd_ >= 0) epoll_->UnregisterHandler(fd_.get());
+}
+
+bool MountHandler::ReadMountInfo() {
+    if (lseek(fd_.get(), 0, SEEK_SET) < 0) {
+        PLOG(ERROR) << "lseek failed on /proc/self/mountinfo";
+        return false;
+    }
+    // Shrinking a string keeps its capacity, so this usually reads without allocating.
+    buffer_.resize(buffer_.capacity());
+    size_t size = 0;
+    while (true) {
+        if (size == buffer_.size()) buffer_.resize(std::max<size_t>(4096, buffer_.size() * 2));
+        ssize_t n =
+                TEMP_FAILURE_RETRY(read(fd_.get(), buffer_.data() + size, buffer_.size() - size));
+        if (n < 0) {
+            PLOG(ERROR) << "read failed on /proc/self/mountinfo";
+            return false;
+        }
+        if (n == 0) break;
+        size += n;
+    }
+    buffer_.resize(size);
+    return true;
 }
 
 void MountHandler::MountHandlerFunction() {
-    rewind(fp_.get());
-    std::vector<MountHandlerEntry> touched;
-    auto untouched = mounts_;
-    char* buf = nullptr;
-    size_t len = 0;
-    while (getline(&buf, &len, fp_.get()) != -1) {
-        auto buf_string = std::string(buf);
-        if (buf_string.find("/emulated") != std::string::npos) {
+    if (!ReadMountInfo()) return;
+
+    std::unordered_map<int, Mount> current;
+    std::vector<EntryMap::iterator> added;
+    std::string_view data(buffer_);
+    while (!data.empty()) {
+        auto eol = data.find('\n');
+        auto line = data.substr(0, eol);
+        data.remove_prefix(eol == std::string_view::npos ? data.size() : eol + 1);
+        int mount_id;
+        std::string_view source, mount_point, fs_type;
+        if (!ParseMountInfo(line, &mount_id, &source, &mount_point, &fs_type)) continue;
+        if (source.find("/emulated") != std::string_view::npos ||
+            mount_point.find("/emulated") != std::string_view::npos) {
             continue;
         }
-        auto entry = ParseMount(buf_string);
-        auto match = untouched.find(entry);
-        if (match == untouched.end()) {
-            touched.emplace_back(std::move(entry));
-        } else {
-            untouched.erase(match);
+        if (auto it = mounts_by_id_.find(mount_id);
+            it != mounts_by_id_.end() && it->second.source == source &&
+            it->second.mount_point == mount_point && it->second.fs_type == fs_type) {
+            current.insert(mounts_by_id_.extract(it));
+            continue;
         }
+
+        auto [entry, inserted] = mounts_.emplace(ResolveMount(source, mount_point, fs_type), 0);
+        entry->second++;
+        if (inserted) added.emplace_back(entry);
+        current.emplace(mount_id, Mount{std::string(source), std::string(mount_point),
+                                        std::string(fs_type), entry});
     }
-    free(buf);
-    for (auto& entry : untouched) {
-        SetMountProperty(entry, false);
-        mounts_.erase(entry);
+
+    // Whatever is left was unmounted.
+    for (auto& [mount_id, mount] : mounts_by_id_) {
+        if (--mount.entry->second == 0) {
+            SetMountProperty(mount.entry->first, false);
+            mounts_.erase(mount.entry);
+        }
     }
-    for (auto& entry : touched) {
-        SetMountProperty(entry, true);
-        mounts_.emplace(std::move(entry));
+    for (auto& entry : added) {
+        SetMountProperty(entry->first, true);
     }
+    mounts_by_id_ = std::move(current);
 }
 
 }  // namespace init
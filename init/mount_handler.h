@@ -16,11 +16,13 @@
 
 #pragma once
 
-#include <stdio.h>
+#include <stddef.h>
 
-#include <memory>
-#include <set>
+#include <map>
 #include <string>
+#include <unordered_map>
+
+#include <android-base/unique_fd.h>
 
 #include "epoll.h"
 
@@ -48,11 +50,27 @@ class MountHandler {
     ~MountHandler();
 
   private:
+    // Distinct entries, with the number of mounts of each.
+    using EntryMap = std::map<MountHandlerEntry, size_t>;
+
+    struct Mount {
+        // The mountinfo fields the entry was made from, to tell a reused mount id apart.
+        std::string source;
+        std::string mount_point;
+        std::string fs_type;
+        EntryMap::iterator entry;
+    };
+
     void MountHandlerFunction();
+    bool ReadMountInfo();
 
     Epoll* epoll_;
-    std::unique_ptr<FILE, decltype(&fclose)> fp_;
-    std::set<MountHandlerEntry> mounts_;
+    android::base::unique_fd fd_;
+    // Contents of mountinfo, reused across reads.
+    std::string buffer_;
+    // Known mounts by mount id.
+    std::unordered_map<int, Mount> mounts_by_id_;
+    EntryMap mounts_;
 };
 
 }  // namespace init
@@ -26,6 +26,7 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
+#include "rc_cache.h"
 #include "tokenizer.h"
 #include "util.h"
 
@@ -42,7 +43,7 @@ void Parser::AddSingleLineParser(const std::string& prefix, LineCallback callbac
     line_callbacks_.emplace_back(prefix, std::move(callback));
 }
 
-void Parser::ParseData(const std::string& filename, std::string* data) {
+static ConfigLines TokenizeData(std::string* data) {
     data->push_back('\n');
     data->push_back('\0');
 
@@ -51,9 +52,33 @@ void Parser::ParseData(const std::string& filename, std::string* data) {
     state.ptr = data->data();
     state.nexttoken = 0;
 
+    ConfigLines lines;
+    std::vector<std::string> args;
+    for (;;) {
+        switch (next_token(&state)) {
+            case T_EOF:
+                return lines;
+            case T_NEWLINE:
+                state.line++;
+                if (!args.empty()) {
+                    lines.emplace_back(ConfigLine{.line = state.line, .args = std::move(args)});
+                    args.clear();
+                }
+                break;
+            case T_TEXT:
+                args.emplace_back(state.text);
+                break;
+        }
+    }
+}
+
+void Parser::ParseData(const std::string& filename, std::string* data) {
+    ParseLines(filename, TokenizeData(data));
+}
+
+void Parser::ParseLines(const std::string& filename, const ConfigLines& lines) {
     SectionParser* section_parser = nullptr;
     int section_start_line = -1;
-    std::vector<std::string> args;
 
     // If we encounter a bad section start, there is no valid parser object to parse the subsequent
     // sections, so we must suppress errors until the next valid section is found.
@@ -72,63 +97,49 @@ void Parser::ParseData(const std::string& filename, std::string* data) {
         section_start_line = -1;
     };
 
-    for (;;) {
-        switch (next_token(&state)) {
-            case T_EOF:
-                end_section();
-
-                for (const auto& [section_name, section_parser] : section_parsers_) {
-                    section_parser->EndFile();
-                }
-
-                return;
-            case T_NEWLINE: {
-                state.line++;
-                if (args.empty()) break;
-                // If we have a line matching a prefix we recognize, call its callback and unset any
-                // current section parsers.  This is meant for /sys/ and /dev/ line entries for
-                // uevent.
-                auto line_callback = std::find_if(
-                    line_callbacks_.begin(), line_callbacks_.end(),
-                    [&args](const auto& c) { return android::base::StartsWith(args[0], c.first); });
-                if (line_callback != line_callbacks_.end()) {
-                    end_section();
-
-                    if (auto result = line_callback->second(std::move(args)); !result.ok()) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                    }
-                } else if (section_parsers_.count(args[0])) {
-                    end_section();
-                    section_parser = section_parsers_[args[0]].get();
-                    section_start_line = state.line;
-                    if (auto result =
-                                section_parser->ParseSection(std::move(args), filename, state.line);
-                        !result.ok()) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                        section_parser = nullptr;
-                        bad_section_found = true;
-                    }
-                } else if (section_parser) {
-                    if (auto result = section_parser->ParseLineSection(std::move(args), state.line);
-                        !result.ok()) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                    }
-                } else if (!bad_section_found) {
-                    parse_error_count_++;
-                    LOG(ERROR) << filename << ": " << state.line
-                               << ": Invalid section keyword found";
-                }
-                args.clear();
-                break;
+    for (const auto& [line, line_args] : lines) {
+        std::vector<std::string> args = line_args;
+        // If we have a line matching a prefix we recognize, call its callback and unset any
+        // current section parsers.  This is meant for /sys/ and /dev/ line entries for
+        // uevent.
+        auto line_callback = std::find_if(
+            line_callbacks_.begin(), line_callbacks_.end(),
+            [&args](const auto& c) { return android::base::StartsWith(args[0], c.first); });
+        if (line_callback != line_callbacks_.end()) {
+            end_section();
+
+            if (auto result = line_callback->second(std::move(args)); !result.ok()) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
             }
-            case T_TEXT:
-                args.emplace_back(state.text);
-                break;
+        } else if (section_parsers_.count(args[0])) {
+            end_section();
+            section_parser = section_parsers_[args[0]].get();
+            section_start_line = line;
+            if (auto result = section_parser->ParseSection(std::move(args), filename, line);
+                !result.ok()) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
+                section_parser = nullptr;
+                bad_section_found = true;
+            }
+        } else if (section_parser) {
+            if (auto result = section_parser->ParseLineSection(std::move(args), line);
+                !result.ok()) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
+            }
+        } else if (!bad_section_found) {
+            parse_error_count_++;
+            LOG(ERROR) << filename << ": " << line << ": Invalid section keyword found";
         }
     }
+
+    end_section();
+
+    for (const auto& [section_name, section_parser] : section_parsers_) {
+        section_parser->EndFile();
+    }
 }
 
 bool Parser::ParseConfigFileInsecure(const std::string& path, bool follow_symlinks = false) {
@@ -144,16 +155,37 @@ bool Parser::ParseConfigFileInsecure(const std::string& path, bool follow_symlin
 Result<void> Parser::ParseConfigFile(const std::string& path) {
     LOG(INFO) << "Parsing file " << path << "...";
     android::base::Timer t;
+    RcCache::FileStamp stamp;
+    if (rc_cache_) {
+        if (auto lines = rc_cache_->Lookup(path, &stamp); lines) {
+            ParseLines(path, *lines);
+            LOG(VERBOSE) << "(Parsing " << path << " from cache took " << t << ".)";
+            return {};
+        }
+    }
+
+    auto lines = OR_RETURN(TokenizeConfigFile(path));
+    ParseLines(path, lines);
+    if (rc_cache_) {
+        rc_cache_->Store(path, stamp, std::move(lines));
+    }
+
+    LOG(VERBOSE) << "(Parsing " << path << " took " << t << ".)";
+    return {};
+}
+
+Result<ConfigLines> Parser::TokenizeConfigFile(const std::string& path) {
     auto config_contents = ReadFile(path);
     if (!config_contents.ok()) {
         return Error() << "Unable to read config file '" << path
                        << "': " << config_contents.error();
     }
+    return TokenizeData(&config_contents.value());
+}
 
-    ParseData(path, &config_contents.value());
-
-    LOG(VERBOSE) << "(Parsing " << path << " took " << t << ".)";
-    return {};
+void Parser::ParseConfigLines(const std::string& path, const ConfigLines& lines) {
+    LOG(INFO) << "Parsing file " << path << "...";
+    ParseLines(path, lines);
 }
 
 bool Parser::ParseConfigDir(const std::string& path) {
@@ -58,6 +58,15 @@ class SectionParser {
     virtual void EndFile(){};
 };
 
+// A non-empty line of a config file, split into its arguments.
+struct ConfigLine {
+    int line;
+    std::vector<std::string> args;
+};
+using ConfigLines = std::vector<ConfigLine>;
+
+class RcCache;
+
 class Parser {
   public:
     //  LineCallback is the type for callbacks that can parse a line starting with a given prefix.
@@ -73,21 +82,33 @@ class Parser {
 
     bool ParseConfig(const std::string& path);
     Result<void> ParseConfigFile(const std::string& path);
+
+    // Reads and tokenizes a config file without touching any parser state, so callers may do
+    // this for several files concurrently and then hand the results to ParseConfigLines() in
+    // the order the files should be parsed.
+    static Result<ConfigLines> TokenizeConfigFile(const std::string& path);
+    void ParseConfigLines(const std::string& path, const ConfigLines& lines);
     void AddSectionParser(const std::string& name, std::unique_ptr<SectionParser> parser);
     void AddSingleLineParser(const std::string& prefix, LineCallback callback);
 
     // Host init verifier check file permissions.
     bool ParseConfigFileInsecure(const std::string& path, bool follow_symlinks);
 
+    // Reuses the tokenized contents of config files that haven't changed from |rc_cache|, which
+    // must outlive the parser.
+    void set_rc_cache(RcCache* rc_cache) { rc_cache_ = rc_cache; }
+
     size_t parse_error_count() const { return parse_error_count_; }
 
   private:
     void ParseData(const std::string& filename, std::string* data);
+    void ParseLines(const std::string& filename, const ConfigLines& lines);
     bool ParseConfigDir(const std::string& path);
 
     std::map<std::string, std::unique_ptr<SectionParser>> section_parsers_;
     std::vector<std::pair<std::string, LineCallback>> line_callbacks_;
     size_t parse_error_count_ = 0;
+    RcCache* rc_cache_ = nullptr;
 };
 
 }  // namespace init
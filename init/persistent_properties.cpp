@@ -17,12 +17,16 @@
 #include "persistent_properties.h"
 
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/system_properties.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <memory>
+#include <random>
 #include <unordered_map>
 
 #include <android-base/file.h>
@@ -47,6 +51,48 @@ namespace {
 
 constexpr const char kLegacyPersistentPropertyDir[] = "/data/property";
 
+// Changes are appended to a journal next to the main file, and folded back into the main file
+// once the journal holds this many of them.
+constexpr size_t kMaxJournalEntries = 64;
+constexpr uint32_t kJournalMagic = 0x4a505250;  // "PRPJ"
+
+struct JournalHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t journal_id;
+};
+
+// Followed by |size| bytes of a serialized PersistentPropertyRecord.
+struct JournalEntryHeader {
+    uint32_t size;
+    uint32_t checksum;
+};
+
+struct JournalState {
+    // Number of changes replayed from the journal.
+    size_t entries = 0;
+    // False if the journal ends in a torn or corrupt entry. Anything appended after it would
+    // never be replayed, so the journal must be compacted instead.
+    bool intact = true;
+};
+
+std::string JournalFilename() {
+    return persistent_property_filename + ".journal";
+}
+
+// FNV-1a. This only has to catch entries left incomplete by a crash in the middle of an append.
+uint32_t JournalChecksum(const std::string& data) {
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : data) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+bool IsPersistentPropertyName(const std::string& name) {
+    return StartsWith(name, "persist.") || StartsWith(name, "next_boot.");
+}
+
 void AddPersistentProperty(const std::string& name, const std::string& value,
                            PersistentProperties* persistent_properties) {
     auto persistent_property_record = persistent_properties->add_properties();
@@ -54,6 +100,33 @@ void AddPersistentProperty(const std::string& name, const std::string& value,
     persistent_property_record->set_value(value);
 }
 
+// Returns false if |name| already had |value|.
+bool SetPersistentProperty(const std::string& name, const std::string& value,
+                           PersistentProperties* persistent_properties) {
+    auto it = std::find_if(persistent_properties->mutable_properties()->begin(),
+                           persistent_properties->mutable_properties()->end(),
+                           [&name](const auto& record) { return record.name() == name; });
+    if (it != persistent_properties->mutable_properties()->end()) {
+        if (it->value() == value) {
+            return false;
+        }
+        it->set_value(value);
+    } else {
+        AddPersistentProperty(name, value, persistent_properties);
+    }
+    return true;
+}
+
+Result<void> FsyncPersistentPropertyDir() {
+    auto dir = Dirname(persistent_property_filename);
+    auto dir_fd = unique_fd{open(dir.c_str(), O_DIRECTORY | O_RDONLY | O_CLOEXEC)};
+    if (dir_fd < 0) {
+        return ErrnoError() << "Unable to open persistent properties directory for fsync()";
+    }
+    fsync(dir_fd.get());
+    return {};
+}
+
 Result<PersistentProperties> LoadLegacyPersistentProperties() {
     std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(kLegacyPersistentPropertyDir), closedir);
     if (!dir) {
@@ -144,7 +217,7 @@ Result<PersistentProperties> ParsePersistentPropertyFile(const std::string& file
         return Error() << "Unable to parse persistent property file: Could not parse protobuf";
     }
     for (auto& prop : persistent_properties.properties()) {
-        if (!StartsWith(prop.name(), "persist.") && !StartsWith(prop.name(), "next_boot.")) {
+        if (!IsPersistentPropertyName(prop.name())) {
             return Error() << "Unable to load persistent property file: property '" << prop.name()
                            << "' doesn't start with 'persist.' or 'next_boot.'";
         }
@@ -152,21 +225,133 @@ Result<PersistentProperties> ParsePersistentPropertyFile(const std::string& file
     return persistent_properties;
 }
 
-}  // namespace
+// Applies the changes recorded in the journal to |persistent_properties|. A journal that was
+// started for a different main file is stale, and is skipped. Replay stops at the first entry
+// that is incomplete or fails its checksum.
+Result<JournalState> ReplayJournal(PersistentProperties* persistent_properties) {
+    JournalState state;
+    auto contents = ReadFile(JournalFilename());
+    if (!contents.ok()) {
+        if (contents.error().code() == ENOENT) {
+            return state;
+        }
+        return Error() << "Unable to read persistent property journal: " << contents.error();
+    }
 
-Result<PersistentProperties> LoadPersistentPropertyFile() {
+    JournalHeader header;
+    if (contents->size() < sizeof(header)) {
+        return state;
+    }
+    memcpy(&header, contents->data(), sizeof(header));
+    if (header.magic != kJournalMagic || header.journal_id != persistent_properties->journal_id()) {
+        return state;
+    }
+
+    size_t offset = sizeof(header);
+    while (offset < contents->size()) {
+        JournalEntryHeader entry;
+        if (contents->size() - offset < sizeof(entry)) {
+            state.intact = false;
+            break;
+        }
+        memcpy(&entry, contents->data() + offset, sizeof(entry));
+        offset += sizeof(entry);
+
+        if (contents->size() - offset < entry.size) {
+            state.intact = false;
+            break;
+        }
+        std::string data = contents->substr(offset, entry.size);
+        offset += entry.size;
+
+        PersistentProperties::PersistentPropertyRecord record;
+        if (JournalChecksum(data) != entry.checksum || !record.ParseFromString(data)) {
+            state.intact = false;
+            break;
+        }
+        if (!IsPersistentPropertyName(record.name())) {
+            return Error() << "Unable to load persistent property journal: property '"
+                           << record.name() << "' doesn't start with 'persist.' or 'next_boot.'";
+        }
+        SetPersistentProperty(record.name(), record.value(), persistent_properties);
+        state.entries++;
+    }
+    if (!state.intact) {
+        LOG(WARNING) << "Persistent property journal ends in an incomplete entry, a previous "
+                        "persistent property write may have failed";
+    }
+    return state;
+}
+
+// Records a single change in the journal. If |create| is true, the journal is started over for
+// the main file identified by |journal_id|.
+Result<void> AppendToJournal(uint64_t journal_id, bool create, const std::string& name,
+                             const std::string& value) {
+    PersistentProperties::PersistentPropertyRecord record;
+    record.set_name(name);
+    record.set_value(value);
+    std::string data;
+    if (!record.SerializeToString(&data)) {
+        return Error() << "Unable to serialize property";
+    }
+
+    std::string buffer;
+    if (create) {
+        JournalHeader header = {.magic = kJournalMagic, .reserved = 0, .journal_id = journal_id};
+        buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    JournalEntryHeader entry = {.size = static_cast<uint32_t>(data.size()),
+                                .checksum = JournalChecksum(data)};
+    buffer.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    buffer.append(data);
+
+    const std::string filename = JournalFilename();
+    int flags = O_WRONLY | O_NOFOLLOW | O_CLOEXEC | (create ? O_CREAT | O_TRUNC : O_APPEND);
+    unique_fd fd(TEMP_FAILURE_RETRY(open(filename.c_str(), flags, 0600)));
+    if (fd == -1) {
+        return ErrnoError() << "Could not open persistent property journal";
+    }
+    if (!WriteStringToFd(buffer, fd)) {
+        return ErrnoError() << "Unable to write persistent property journal";
+    }
+    if (fsync(fd.get()) < 0) {
+        return ErrnoError() << "Unable to sync persistent property journal";
+    }
+    if (create) {
+        // Make sure the new journal itself survives a crash, not just its contents.
+        return FsyncPersistentPropertyDir();
+    }
+    return {};
+}
+
+Result<PersistentProperties> LoadPersistentPropertyFileAndJournal(JournalState* journal) {
     auto file_contents = ReadPersistentPropertyFile();
     if (!file_contents.ok()) return file_contents.error();
 
     auto persistent_properties = ParsePersistentPropertyFile(*file_contents);
+    if (persistent_properties.ok()) {
+        auto state = ReplayJournal(&persistent_properties.value());
+        if (!state.ok()) {
+            persistent_properties = state.error();
+        } else if (journal) {
+            *journal = *state;
+        }
+    }
     if (!persistent_properties.ok()) {
         // If the file cannot be parsed in either format, then we don't have any recovery
         // mechanisms, so we delete it to allow for future writes to take place successfully.
         unlink(persistent_property_filename.c_str());
+        unlink(JournalFilename().c_str());
     }
     return persistent_properties;
 }
 
+}  // namespace
+
+Result<PersistentProperties> LoadPersistentPropertyFile() {
+    return LoadPersistentPropertyFileAndJournal(nullptr);
+}
+
 Result<void> WritePersistentPropertyFile(const PersistentProperties& persistent_properties) {
     const std::string temp_filename = persistent_property_filename + ".tmp";
     unique_fd fd(TEMP_FAILURE_RETRY(
@@ -178,6 +363,14 @@ Result<void> WritePersistentPropertyFile(const PersistentProperties& persistent_
     if (!persistent_properties.SerializeToString(&serialized_string)) {
         return Error() << "Unable to serialize properties";
     }
+    // Give the new file a fresh journal id, which retires any existing journal even if we crash
+    // before removing it. Parsing concatenated messages merges them, so appending a message that
+    // only holds the id overrides any id in |persistent_properties| without copying it.
+    PersistentProperties journal_id;
+    journal_id.set_journal_id((uint64_t{std::random_device{}()} << 32) | std::random_device{}());
+    if (!journal_id.AppendToString(&serialized_string)) {
+        return Error() << "Unable to serialize properties";
+    }
     if (!WriteStringToFd(serialized_string, fd)) {
         return ErrnoError() << "Unable to write file contents";
     }
@@ -194,13 +387,11 @@ Result<void> WritePersistentPropertyFile(const PersistentProperties& persistent_
     // directories must be fsync()'ed otherwise, the rename is not necessarily written to storage.
     // Note in this case, that the source and destination directories are the same, so only one
     // fsync() is required.
-    auto dir = Dirname(persistent_property_filename);
-    auto dir_fd = unique_fd{open(dir.c_str(), O_DIRECTORY | O_RDONLY | O_CLOEXEC)};
-    if (dir_fd < 0) {
-        return ErrnoError() << "Unable to open persistent properties directory for fsync()";
+    if (auto result = FsyncPersistentPropertyDir(); !result.ok()) {
+        return result;
     }
-    fsync(dir_fd.get());
 
+    unlink(JournalFilename().c_str());
     return {};
 }
 
@@ -223,26 +414,30 @@ PersistentProperties LoadPersistentPropertiesFromMemory() {
 }
 
 // Persistent properties are not written often, so we rather not keep any data in memory and read
-// then rewrite the persistent property file for each update.
+// the persistent property file for each update. The change itself is appended to the journal, and
+// the whole file is only rewritten when the journal is compacted.
 void WritePersistentProperty(const std::string& name, const std::string& value) {
-    auto persistent_properties = LoadPersistentPropertyFile();
+    JournalState journal;
+    auto persistent_properties = LoadPersistentPropertyFileAndJournal(&journal);
 
+    bool recovered = false;
     if (!persistent_properties.ok()) {
         LOG(ERROR) << "Recovering persistent properties from memory: "
                    << persistent_properties.error();
         persistent_properties = LoadPersistentPropertiesFromMemory();
+        recovered = true;
     }
-    auto it = std::find_if(persistent_properties->mutable_properties()->begin(),
-                           persistent_properties->mutable_properties()->end(),
-                           [&name](const auto& record) { return record.name() == name; });
-    if (it != persistent_properties->mutable_properties()->end()) {
-        if (it->value() == value) {
+    if (!SetPersistentProperty(name, value, &persistent_properties.value())) {
+        return;
+    }
+
+    if (!recovered && journal.intact && journal.entries < kMaxJournalEntries) {
+        auto result = AppendToJournal(persistent_properties->journal_id(), journal.entries == 0,
+                                      name, value);
+        if (result.ok()) {
             return;
         }
-        it->set_name(name);
-        it->set_value(value);
-    } else {
-        AddPersistentProperty(name, value, &persistent_properties.value());
+        LOG(ERROR) << "Could not journal persistent property, rewriting file: " << result.error();
     }
 
     if (auto result = WritePersistentPropertyFile(*persistent_properties); !result.ok()) {
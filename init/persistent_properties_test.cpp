@@ -21,9 +21,11 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <string>
 #include <vector>
 
 #include <android-base/file.h>
+#include <android-base/scopeguard.h>
 #include <gtest/gtest.h>
 
 #include "util.h"
@@ -238,5 +240,88 @@ TEST(persistent_properties, StagedPersistProperty) {
     CheckPropertiesEqual(expected_persistent_properties, second_read_back_properties);
 }
 
+TEST(persistent_properties, JournaledUpdates) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    persistent_property_filename = tf.path;
+    const std::string journal = tf.path + ".journal"s;
+    auto guard = android::base::make_scope_guard([&journal] { unlink(journal.c_str()); });
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties = {
+            {"persist.sys.locale", "en-US"},
+            {"persist.sys.timezone", "America/Los_Angeles"},
+    };
+    ASSERT_RESULT_OK(
+            WritePersistentPropertyFile(VectorToPersistentProperties(persistent_properties)));
+    std::string file_contents;
+    ASSERT_TRUE(android::base::ReadFileToString(tf.path, &file_contents));
+
+    WritePersistentProperty("persist.sys.locale", "pt-BR");
+    WritePersistentProperty("persist.test.numbers", "12345");
+
+    // The changes went to the journal, and the main file is untouched.
+    std::string new_file_contents;
+    ASSERT_TRUE(android::base::ReadFileToString(tf.path, &new_file_contents));
+    EXPECT_EQ(file_contents, new_file_contents);
+    EXPECT_EQ(access(journal.c_str(), F_OK), 0);
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties_expected = {
+            {"persist.sys.locale", "pt-BR"},
+            {"persist.sys.timezone", "America/Los_Angeles"},
+            {"persist.test.numbers", "12345"},
+    };
+    CheckPropertiesEqual(persistent_properties_expected, LoadPersistentProperties());
+
+    // Rewriting the main file retires the journal.
+    ASSERT_RESULT_OK(
+            WritePersistentPropertyFile(VectorToPersistentProperties(persistent_properties)));
+    EXPECT_NE(access(journal.c_str(), F_OK), 0);
+    CheckPropertiesEqual(persistent_properties, LoadPersistentProperties());
+}
+
+TEST(persistent_properties, JournalCompaction) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    persistent_property_filename = tf.path;
+    const std::string journal = tf.path + ".journal"s;
+    auto guard = android::base::make_scope_guard([&journal] { unlink(journal.c_str()); });
+
+    ASSERT_RESULT_OK(WritePersistentPropertyFile(VectorToPersistentProperties({})));
+
+    // Eventually the journal is folded back into the main file and started over.
+    bool compacted = false;
+    for (int i = 0; i < 1000 && !compacted; i++) {
+        WritePersistentProperty("persist.test.counter", std::to_string(i));
+        compacted = access(journal.c_str(), F_OK) != 0;
+        CheckPropertiesEqual({{"persist.test.counter", std::to_string(i)}},
+                             LoadPersistentProperties());
+    }
+    EXPECT_TRUE(compacted);
+}
+
+TEST(persistent_properties, TornJournalEntry) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    persistent_property_filename = tf.path;
+    const std::string journal = tf.path + ".journal"s;
+    auto guard = android::base::make_scope_guard([&journal] { unlink(journal.c_str()); });
+
+    ASSERT_RESULT_OK(WritePersistentPropertyFile(
+            VectorToPersistentProperties({{"persist.sys.locale", "en-US"}})));
+    WritePersistentProperty("persist.sys.locale", "pt-BR");
+    WritePersistentProperty("persist.sys.timezone", "America/Los_Angeles");
+
+    // Simulate a crash in the middle of appending the last entry.
+    struct stat sb;
+    ASSERT_EQ(stat(journal.c_str(), &sb), 0);
+    ASSERT_EQ(truncate(journal.c_str(), sb.st_size - 1), 0);
+    CheckPropertiesEqual({{"persist.sys.locale", "pt-BR"}}, LoadPersistentProperties());
+
+    // The next write must not land behind the torn entry, where it would never be replayed.
+    WritePersistentProperty("persist.test.numbers", "12345");
+    CheckPropertiesEqual({{"persist.sys.locale", "pt-BR"}, {"persist.test.numbers", "12345"}},
+                         LoadPersistentProperties());
+}
+
 }  // namespace init
 }  // namespace android
@@ -39,6 +39,7 @@
 #define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
 #include <sys/_system_properties.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -46,6 +47,7 @@
 #include <queue>
 #include <string_view>
 #include <thread>
+#include <tuple>
 #include <vector>
 
 #include <InitProperties.sysprop.h>
@@ -70,6 +72,7 @@
 #include "epoll.h"
 #include "init.h"
 #include "persistent_properties.h"
+#include "property_subscriptions.h"
 #include "property_type.h"
 #include "proto_utils.h"
 #include "second_stage_resources.h"
@@ -116,17 +119,21 @@ constexpr auto LEGACY_ID_PROP = "ro.build.legacy.id";
 constexpr auto VBMETA_DIGEST_PROP = "ro.boot.vbmeta.digest";
 constexpr auto DIGEST_SIZE_USED = 8;
 
-static bool persistent_properties_loaded = false;
+static std::atomic<bool> persistent_properties_loaded = false;
 
 static int from_init_socket = -1;
 static int init_socket = -1;
 static bool accept_messages = false;
 static std::mutex accept_messages_lock;
 static std::mutex selinux_check_access_lock;
+// Serializes writes to the property areas together with the NotifyPropertyChange() that follows
+// each one, so that ActionManager sees property changes in the order they were applied.
+static std::mutex property_write_lock;
 static std::thread property_service_thread;
 static std::thread property_service_for_system_thread;
 
 static std::unique_ptr<PersistWriteThread> persist_write_thread;
+static std::unique_ptr<PropertySubscriptions> property_subscriptions;
 
 static PropertyInfoAreaFile property_info_area;
 
@@ -191,6 +198,11 @@ static bool CheckMacPerms(const std::string& name, const char* target_context,
 }
 
 void NotifyPropertyChange(const std::string& name, const std::string& value) {
+    if (property_subscriptions) {
+        auto pi = __system_property_find(name.c_str());
+        property_subscriptions->Notify(name, value, pi ? __system_property_serial(pi) : 0);
+    }
+
     // If init hasn't started its main loop, then it won't be handling property changed messages
     // anyway, so there's no need to try to send them.
     auto lock = std::lock_guard{accept_messages_lock};
@@ -402,6 +414,7 @@ static std::optional<uint32_t> PropertySet(const std::string& name, const std::s
         return {PROP_ERROR_INVALID_VALUE};
     }
 
+    auto lock = std::lock_guard{property_write_lock};
     if (name == "sys.powerctl") {
         // No action here - NotifyPropertyChange will trigger the appropriate action, and since this
         // can come to the second thread, we mustn't call out to the __system_property_* functions
@@ -679,23 +692,9 @@ uint32_t HandlePropertySetNoSocket(const std::string& name, const std::string& v
     return *ret;
 }
 
-static void handle_property_set_fd(int fd) {
+static void HandlePropertySetRequest(SocketConnection socket) {
     static constexpr uint32_t kDefaultSocketTimeout = 2000; /* ms */
 
-    int s = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
-    if (s == -1) {
-        return;
-    }
-
-    ucred cr;
-    socklen_t cr_size = sizeof(cr);
-    if (getsockopt(s, SOL_SOCKET, SO_PEERCRED, &cr, &cr_size) < 0) {
-        close(s);
-        PLOG(ERROR) << "sys_prop: unable to get SO_PEERCRED";
-        return;
-    }
-
-    SocketConnection socket(s, cr);
     uint32_t timeout_ms = kDefaultSocketTimeout;
 
     uint32_t cmd = 0;
@@ -776,6 +775,79 @@ static void handle_property_set_fd(int fd) {
     }
 }
 
+// Runs HandlePropertySetRequest() for accepted connections on a fixed pool of threads. Reading
+// the request and checking permissions happen in parallel, so one slow client or SELinux lookup
+// no longer holds up every other setprop queued behind it. The property writes themselves are
+// still serialized by property_write_lock.
+class PropertySetWorkers {
+  public:
+    explicit PropertySetWorkers(size_t num_threads);
+    void Enqueue(SocketConnection socket);
+
+  private:
+    void Work();
+
+  private:
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<SocketConnection> work_;
+};
+
+PropertySetWorkers::PropertySetWorkers(size_t num_threads) {
+    for (size_t i = 0; i < num_threads; i++) {
+        threads_.emplace_back([this]() -> void { Work(); });
+    }
+}
+
+void PropertySetWorkers::Work() {
+    while (true) {
+        SocketConnection socket;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            while (work_.empty()) {
+                cv_.wait(lock);
+            }
+
+            socket = std::move(work_.front());
+            work_.pop_front();
+        }
+
+        HandlePropertySetRequest(std::move(socket));
+    }
+}
+
+void PropertySetWorkers::Enqueue(SocketConnection socket) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_.emplace_back(std::move(socket));
+    }
+    cv_.notify_one();
+}
+
+static void handle_property_set_fd(int fd, PropertySetWorkers* workers) {
+    int s = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (s == -1) {
+        return;
+    }
+
+    ucred cr;
+    socklen_t cr_size = sizeof(cr);
+    if (getsockopt(s, SOL_SOCKET, SO_PEERCRED, &cr, &cr_size) < 0) {
+        close(s);
+        PLOG(ERROR) << "sys_prop: unable to get SO_PEERCRED";
+        return;
+    }
+
+    SocketConnection socket(s, cr);
+    if (workers) {
+        workers->Enqueue(std::move(socket));
+        return;
+    }
+    HandlePropertySetRequest(std::move(socket));
+}
+
 uint32_t InitPropertySet(const std::string& name, const std::string& value) {
     ucred cr = {.pid = 1, .uid = 0, .gid = 0};
     std::string error;
@@ -787,33 +859,31 @@ uint32_t InitPropertySet(const std::string& name, const std::string& value) {
     return result;
 }
 
-static Result<void> load_properties_from_file(const char*, const char*,
-                                              std::map<std::string, std::string>*);
+// A property file and the files it imports, read and parsed but not yet checked against the
+// property contexts. Parsing only reads files and properties, so it is safe to do for several
+// files in parallel; the permission checks go through libselinux and are done when applying.
+struct PropertyFileContents {
+    Result<void> result;
+    // The file and the files it imports, in the order they were read.
+    std::vector<std::string> filenames;
+    // Properties in the order they are set, with the index of the file setting them.
+    std::vector<std::tuple<std::string, std::string, size_t>> properties;
+};
+
+static Result<void> ParsePropertyFile(const char* filename, const char* filter,
+                                      PropertyFileContents* contents);
 
 /*
  * Filter is used to decide which properties to load: NULL loads all keys,
  * "ro.foo.*" is a prefix match, and "ro.foo.bar" is an exact match.
  */
 static void LoadProperties(char* data, const char* filter, const char* filename,
-                           std::map<std::string, std::string>* properties) {
+                           PropertyFileContents* contents) {
     char *key, *value, *eol, *sol, *tmp, *fn;
     size_t flen = 0;
 
-    static constexpr const char* const kVendorPathPrefixes[4] = {
-            "/vendor",
-            "/odm",
-            "/vendor_dlkm",
-            "/odm_dlkm",
-    };
-
-    const char* context = kInitContext;
-    if (SelinuxGetVendorAndroidVersion() >= __ANDROID_API_P__) {
-        for (const auto& vendor_path_prefix : kVendorPathPrefixes) {
-            if (StartsWith(filename, vendor_path_prefix)) {
-                context = kVendorContext;
-            }
-        }
-    }
+    const size_t source = contents->filenames.size();
+    contents->filenames.emplace_back(filename);
 
     if (filter) {
         flen = strlen(filter);
@@ -849,7 +919,7 @@ static void LoadProperties(char* data, const char* filter, const char* filename,
                 continue;
             }
 
-            if (auto res = load_properties_from_file(expanded_filename->c_str(), key, properties);
+            if (auto res = ParsePropertyFile(expanded_filename->c_str(), key, contents);
                 !res.ok()) {
                 LOG(WARNING) << res.error();
             }
@@ -878,29 +948,15 @@ static void LoadProperties(char* data, const char* filter, const char* filename,
                 continue;
             }
 
-            ucred cr = {.pid = 1, .uid = 0, .gid = 0};
-            std::string error;
-            if (CheckPermissions(key, value, context, cr, &error) == PROP_SUCCESS) {
-                auto it = properties->find(key);
-                if (it == properties->end()) {
-                    (*properties)[key] = value;
-                } else if (it->second != value) {
-                    LOG(WARNING) << "Overriding previous property '" << key << "':'" << it->second
-                                 << "' with new value '" << value << "'";
-                    it->second = value;
-                }
-            } else {
-                LOG(ERROR) << "Do not have permissions to set '" << key << "' to '" << value
-                           << "' in property file '" << filename << "': " << error;
-            }
+            contents->properties.emplace_back(key, value, source);
         }
     }
 }
 
 // Filter is used to decide which properties to load: NULL loads all keys,
 // "ro.foo.*" is a prefix match, and "ro.foo.bar" is an exact match.
-static Result<void> load_properties_from_file(const char* filename, const char* filter,
-                                              std::map<std::string, std::string>* properties) {
+static Result<void> ParsePropertyFile(const char* filename, const char* filter,
+                                      PropertyFileContents* contents) {
     Timer t;
     auto file_contents = ReadFile(filename);
     if (!file_contents.ok()) {
@@ -909,18 +965,110 @@ static Result<void> load_properties_from_file(const char* filename, const char*
     }
     file_contents->push_back('\n');
 
-    LoadProperties(file_contents->data(), filter, filename, properties);
+    LoadProperties(file_contents->data(), filter, filename, contents);
     LOG(VERBOSE) << "(Loading properties from " << filename << " took " << t << ".)";
     return {};
 }
 
-static void LoadPropertiesFromSecondStageRes(std::map<std::string, std::string>* properties) {
+// Adds the properties of |contents| that init may set to |properties|, overriding earlier
+// values.
+static void ApplyProperties(const PropertyFileContents& contents,
+                            std::map<std::string, std::string>* properties) {
+    static constexpr const char* const kVendorPathPrefixes[4] = {
+            "/vendor",
+            "/odm",
+            "/vendor_dlkm",
+            "/odm_dlkm",
+    };
+
+    std::vector<const char*> contexts;
+    for (const auto& filename : contents.filenames) {
+        const char* context = kInitContext;
+        if (SelinuxGetVendorAndroidVersion() >= __ANDROID_API_P__) {
+            for (const auto& vendor_path_prefix : kVendorPathPrefixes) {
+                if (StartsWith(filename, vendor_path_prefix)) {
+                    context = kVendorContext;
+                }
+            }
+        }
+        contexts.emplace_back(context);
+    }
+
+    for (const auto& [key, value, source] : contents.properties) {
+        ucred cr = {.pid = 1, .uid = 0, .gid = 0};
+        std::string error;
+        if (CheckPermissions(key, value, contexts[source], cr, &error) == PROP_SUCCESS) {
+            auto it = properties->find(key);
+            if (it == properties->end()) {
+                properties->emplace(key, value);
+            } else if (it->second != value) {
+                LOG(WARNING) << "Overriding previous property '" << key << "':'" << it->second
+                             << "' with new value '" << value << "'";
+                it->second = value;
+            }
+        } else {
+            LOG(ERROR) << "Do not have permissions to set '" << key << "' to '" << value
+                       << "' in property file '" << contents.filenames[source] << "': " << error;
+        }
+    }
+}
+
+static Result<void> load_properties_from_file(const char* filename, const char* filter,
+                                              std::map<std::string, std::string>* properties) {
+    PropertyFileContents contents;
+    if (auto res = ParsePropertyFile(filename, filter, &contents); !res.ok()) {
+        return res;
+    }
+    ApplyProperties(contents, properties);
+    return {};
+}
+
+// Reads and parses a set of property files in parallel, so that the reads from the different
+// partitions overlap, ahead of applying them one by one in order of precedence.
+class PropertyFilePrefetcher {
+  public:
+    explicit PropertyFilePrefetcher(const std::vector<std::string>& filenames) {
+        for (const auto& filename : filenames) {
+            files_[filename];
+        }
+        std::vector<std::thread> threads;
+        for (auto& [filename, contents] : files_) {
+            threads.emplace_back([&filename, &contents] {
+                contents.result = ParsePropertyFile(filename.c_str(), nullptr, &contents);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Same as load_properties_from_file() without a filter, using the prefetched contents if
+    // the file is one of them.
+    Result<void> Load(const std::string& filename,
+                      std::map<std::string, std::string>* properties) const {
+        auto it = files_.find(filename);
+        if (it == files_.end()) {
+            return load_properties_from_file(filename.c_str(), nullptr, properties);
+        }
+        if (!it->second.result.ok()) {
+            return it->second.result.error();
+        }
+        ApplyProperties(it->second, properties);
+        return {};
+    }
+
+  private:
+    std::map<std::string, PropertyFileContents> files_;
+};
+
+static void LoadPropertiesFromSecondStageRes(const PropertyFilePrefetcher& files,
+                                             std::map<std::string, std::string>* properties) {
     std::string prop = GetRamdiskPropForSecondStage();
     if (access(prop.c_str(), R_OK) != 0) {
         CHECK(errno == ENOENT) << "Cannot access " << prop << ": " << strerror(errno);
         return;
     }
-    if (auto res = load_properties_from_file(prop.c_str(), nullptr, properties); !res.ok()) {
+    if (auto res = files.Load(prop, properties); !res.ok()) {
         LOG(WARNING) << res.error();
     }
 }
@@ -1239,9 +1387,29 @@ void PropertyLoadBootDefaults() {
     // property files, regardless of if they are "ro." properties or not.
     std::map<std::string, std::string> properties;
 
+    // Order matters when applying the files, but not when reading them.
+    std::vector<std::string> filenames = {
+            GetRamdiskPropForSecondStage(),
+            "/system/build.prop",
+            "/system_dlkm/etc/build.prop",
+            "/vendor/default.prop",
+            "/vendor/build.prop",
+            "/vendor_dlkm/etc/build.prop",
+            "/odm_dlkm/etc/build.prop",
+            kDebugRamdiskProp,
+    };
+    if (IsRecoveryMode()) {
+        filenames.emplace_back("/prop.default");
+    }
+    for (const auto& partition : {"system_ext", "odm", "product"}) {
+        filenames.emplace_back("/"s + partition + "/etc/build.prop");
+        filenames.emplace_back("/"s + partition + "/default.prop");
+        filenames.emplace_back("/"s + partition + "/build.prop");
+    }
+    const PropertyFilePrefetcher files(filenames);
+
     if (IsRecoveryMode()) {
-        if (auto res = load_properties_from_file("/prop.default", nullptr, &properties);
-            !res.ok()) {
+        if (auto res = files.Load("/prop.default", &properties); !res.ok()) {
             LOG(ERROR) << res.error();
         }
     }
@@ -1249,10 +1417,10 @@ void PropertyLoadBootDefaults() {
     // /<part>/etc/build.prop is the canonical location of the build-time properties since S.
     // Falling back to /<part>/defalt.prop and /<part>/build.prop only when legacy path has to
     // be supported, which is controlled by the support_legacy_path_until argument.
-    const auto load_properties_from_partition = [&properties](const std::string& partition,
-                                                              int support_legacy_path_until) {
+    const auto load_properties_from_partition = [&](const std::string& partition,
+                                                    int support_legacy_path_until) {
         auto path = "/" + partition + "/etc/build.prop";
-        if (load_properties_from_file(path.c_str(), nullptr, &properties).ok()) {
+        if (files.Load(path, &properties).ok()) {
             return;
         }
         // To read ro.<partition>.build.version.sdk, temporarily load the legacy paths into a
@@ -1261,8 +1429,8 @@ void PropertyLoadBootDefaults() {
         std::map<std::string, std::string> temp;
         auto legacy_path1 = "/" + partition + "/default.prop";
         auto legacy_path2 = "/" + partition + "/build.prop";
-        load_properties_from_file(legacy_path1.c_str(), nullptr, &temp);
-        load_properties_from_file(legacy_path2.c_str(), nullptr, &temp);
+        files.Load(legacy_path1, &temp);
+        files.Load(legacy_path2, &temp);
         bool support_legacy_path = false;
         auto version_prop_name = "ro." + partition + ".build.version.sdk";
         auto it = temp.find(version_prop_name);
@@ -1278,8 +1446,8 @@ void PropertyLoadBootDefaults() {
             // We don't update temp into properties directly as it might skip any (future) logic
             // for resolving duplicates implemented in load_properties_from_file.  Instead, read
             // the files again into the properties map.
-            load_properties_from_file(legacy_path1.c_str(), nullptr, &properties);
-            load_properties_from_file(legacy_path2.c_str(), nullptr, &properties);
+            files.Load(legacy_path1, &properties);
+            files.Load(legacy_path2, &properties);
         } else {
             LOG(FATAL) << legacy_path1 << " and " << legacy_path2 << " were not loaded "
                        << "because " << version_prop_name << "(" << it->second << ") is newer "
@@ -1289,31 +1457,29 @@ void PropertyLoadBootDefaults() {
 
     // Order matters here. The more the partition is specific to a product, the higher its
     // precedence is.
-    LoadPropertiesFromSecondStageRes(&properties);
+    LoadPropertiesFromSecondStageRes(files, &properties);
 
     // system should have build.prop, unlike the other partitions
-    if (auto res = load_properties_from_file("/system/build.prop", nullptr, &properties);
-        !res.ok()) {
+    if (auto res = files.Load("/system/build.prop", &properties); !res.ok()) {
         LOG(WARNING) << res.error();
     }
 
     load_properties_from_partition("system_ext", /* support_legacy_path_until */ 30);
-    load_properties_from_file("/system_dlkm/etc/build.prop", nullptr, &properties);
+    files.Load("/system_dlkm/etc/build.prop", &properties);
     // TODO(b/117892318): uncomment the following condition when vendor.imgs for aosp_* targets are
     // all updated.
     // if (SelinuxGetVendorAndroidVersion() <= __ANDROID_API_R__) {
-    load_properties_from_file("/vendor/default.prop", nullptr, &properties);
+    files.Load("/vendor/default.prop", &properties);
     // }
-    load_properties_from_file("/vendor/build.prop", nullptr, &properties);
-    load_properties_from_file("/vendor_dlkm/etc/build.prop", nullptr, &properties);
-    load_properties_from_file("/odm_dlkm/etc/build.prop", nullptr, &properties);
+    files.Load("/vendor/build.prop", &properties);
+    files.Load("/vendor_dlkm/etc/build.prop", &properties);
+    files.Load("/odm_dlkm/etc/build.prop", &properties);
     load_properties_from_partition("odm", /* support_legacy_path_until */ 28);
     load_properties_from_partition("product", /* support_legacy_path_until */ 30);
 
     if (access(kDebugRamdiskProp, R_OK) == 0) {
         LOG(INFO) << "Loading " << kDebugRamdiskProp;
-        if (auto res = load_properties_from_file(kDebugRamdiskProp, nullptr, &properties);
-            !res.ok()) {
+        if (auto res = files.Load(kDebugRamdiskProp, &properties); !res.ok()) {
             LOG(WARNING) << res.error();
         }
     }
@@ -1552,7 +1718,15 @@ static void PropertyServiceThread(int fd, bool listen_init) {
         LOG(FATAL) << result.error();
     }
 
-    if (auto result = epoll.RegisterHandler(fd, std::bind(handle_property_set_fd, fd));
+    // With a single worker there is nothing to overlap, so keep handling requests inline.
+    std::unique_ptr<PropertySetWorkers> workers;
+    auto num_workers = android::base::GetUintProperty<size_t>("ro.property_service.num_workers", 4);
+    if (num_workers > 1) {
+        workers = std::make_unique<PropertySetWorkers>(num_workers);
+    }
+
+    if (auto result = epoll.RegisterHandler(fd, std::bind(handle_property_set_fd, fd,
+                                                          workers.get()));
         !result.ok()) {
         LOG(FATAL) << result.error();
     }
@@ -1596,7 +1770,10 @@ void PersistWriteThread::Work() {
 
         // Perform write/fsync outside the lock.
         WritePersistentProperty(std::get<0>(item), std::get<1>(item));
-        NotifyPropertyChange(std::get<0>(item), std::get<1>(item));
+        {
+            auto lock = std::lock_guard{property_write_lock};
+            NotifyPropertyChange(std::get<0>(item), std::get<1>(item));
+        }
 
         SocketConnection& socket = std::get<2>(item);
         socket.SendUint32(PROP_SUCCESS);
@@ -1628,9 +1805,31 @@ void StartThread(const char* name, int mode, int gid, std::thread& t, bool liste
     t.swap(new_thread);
 }
 
+static void StartPropertySubscriptions() {
+    auto socket = CreateSocket(kPropertySubscriptionSocket,
+                               SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, /*passcred=*/false,
+                               /*should_listen=*/true, 0666, /*uid=*/0, /*gid=*/0,
+                               /*socketcon=*/{});
+    if (!socket.ok()) {
+        LOG(ERROR) << "Could not create the property subscription socket: " << socket.error();
+        return;
+    }
+    auto subscriptions =
+            std::make_unique<PropertySubscriptions>(unique_fd(*socket), CanReadProperty);
+    if (auto result = subscriptions->Start(); !result.ok()) {
+        LOG(ERROR) << "Could not start property subscriptions: " << result.error();
+        return;
+    }
+    property_subscriptions = std::move(subscriptions);
+}
+
 void StartPropertyService(int* epoll_socket) {
     InitPropertySet("ro.property_service.version", "2");
 
+    if (android::base::GetBoolProperty("ro.property_service.subscriptions", false)) {
+        StartPropertySubscriptions();
+    }
+
     int sockets[2];
     if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0) {
         PLOG(FATAL) << "Failed to socketpair() between property_service and init";
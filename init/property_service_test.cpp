@@ -18,6 +18,8 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 
+#include <chrono>
+
 #define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
 #include <sys/_system_properties.h>
 
@@ -77,6 +79,34 @@ TEST(property_service, non_utf8_value) {
     EXPECT_TRUE(SetProperty("property_service_utf8_test", "\xF0\x90\x80\x80"));
 }
 
+TEST(property_service, stalled_client_does_not_block_others) {
+    if (getuid() != 0) {
+        GTEST_SKIP() << "Skipping test, must be run as root.";
+        return;
+    }
+
+    // Open a connection and never finish sending the request...
+    int fd = socket(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ASSERT_NE(fd, -1);
+    auto guard = android::base::make_scope_guard([fd]() { close(fd); });
+
+    static const char* property_service_socket = "/dev/socket/" PROP_SERVICE_NAME;
+    sockaddr_un addr = {};
+    addr.sun_family = AF_LOCAL;
+    strlcpy(addr.sun_path, property_service_socket, sizeof(addr.sun_path));
+
+    socklen_t addr_len = strlen(property_service_socket) + offsetof(sockaddr_un, sun_path) + 1;
+    ASSERT_NE(connect(fd, reinterpret_cast<sockaddr*>(&addr), addr_len), -1);
+
+    uint32_t msg = PROP_MSG_SETPROP2;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(msg)), send(fd, &msg, sizeof(msg), 0));
+
+    // ...and check that other requests are served well before its 2s receive timeout.
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(SetProperty("property_service_stall_test", "done"));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
 TEST(property_service, userspace_reboot_not_supported) {
     if (getuid() != 0) {
         GTEST_SKIP() << "Skipping test, must be run as root.";
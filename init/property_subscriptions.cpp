@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "property_subscriptions.h"
+
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string_view>
+
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <selinux/selinux.h>
+
+using android::base::StartsWith;
+using android::base::unique_fd;
+
+namespace android {
+namespace init {
+
+static bool ParseUint32(std::string_view* data, uint32_t* value) {
+    if (data->size() < sizeof(*value)) return false;
+    memcpy(value, data->data(), sizeof(*value));
+    data->remove_prefix(sizeof(*value));
+    return true;
+}
+
+static bool ParseString(std::string_view* data, std::string* value) {
+    uint32_t size;
+    if (!ParseUint32(data, &size) || data->size() < size) return false;
+    *value = data->substr(0, size);
+    data->remove_prefix(size);
+    return true;
+}
+
+static void AppendUint32(std::string* data, uint32_t value) {
+    data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void AppendString(std::string* data, const std::string& value) {
+    AppendUint32(data, value.size());
+    data->append(value);
+}
+
+PropertySubscriptions::PropertySubscriptions(unique_fd socket, CanReadCallback can_read)
+    : socket_(std::move(socket)), can_read_(std::move(can_read)) {}
+
+PropertySubscriptions::~PropertySubscriptions() {
+    if (!thread_.joinable()) return;
+    {
+        auto lock = std::lock_guard{lock_};
+        stopping_ = true;
+    }
+    uint64_t wake = 1;
+    TEMP_FAILURE_RETRY(write(wake_fd_.get(), &wake, sizeof(wake)));
+    thread_.join();
+}
+
+Result<void> PropertySubscriptions::Start() {
+    wake_fd_.reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (wake_fd_ == -1) {
+        return ErrnoError() << "eventfd() failed";
+    }
+    if (auto result = epoll_.Open(); !result.ok()) {
+        return result.error();
+    }
+    if (auto result = epoll_.RegisterHandler(socket_.get(), [this] { HandleAccept(); });
+        !result.ok()) {
+        return result.error();
+    }
+    if (auto result = epoll_.RegisterHandler(wake_fd_.get(), [this] { HandleChanges(); });
+        !result.ok()) {
+        return result.error();
+    }
+    thread_ = std::thread(&PropertySubscriptions::Run, this);
+    return {};
+}
+
+void PropertySubscriptions::Notify(const std::string& name, const std::string& value,
+                                   uint32_t serial) {
+    bool wake;
+    {
+        auto lock = std::lock_guard{lock_};
+        // The thread drains all queued changes each time it is woken up.
+        wake = changes_.empty();
+        changes_.emplace_back(name, Change{value, serial});
+    }
+    if (wake) {
+        uint64_t one = 1;
+        if (TEMP_FAILURE_RETRY(write(wake_fd_.get(), &one, sizeof(one))) == -1) {
+            PLOG(ERROR) << "Failed to wake up the property subscription thread";
+        }
+    }
+}
+
+void PropertySubscriptions::Run() {
+    while (true) {
+        {
+            auto lock = std::lock_guard{lock_};
+            if (stopping_) return;
+        }
+        if (auto result = epoll_.Wait(std::nullopt); !result.ok()) {
+            LOG(ERROR) << result.error();
+        }
+    }
+}
+
+void PropertySubscriptions::HandleAccept() {
+    unique_fd socket(accept4(socket_.get(), nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK));
+    if (socket == -1) {
+        PLOG(ERROR) << "Failed to accept a property subscriber";
+        return;
+    }
+
+    char* source_context = nullptr;
+    if (getpeercon(socket.get(), &source_context) != 0) {
+        PLOG(ERROR) << "Unable to accept a property subscriber: getpeercon() failed";
+        return;
+    }
+    Subscriber subscriber;
+    subscriber.source_context = source_context;
+    freecon(source_context);
+
+    // Edge triggered, so that a subscriber is only flushed again once its socket has drained.
+    int fd = socket.get();
+    if (auto result = epoll_.RegisterHandler(
+                fd, [this, fd] { HandleSubscriber(fd); }, EPOLLIN | EPOLLOUT | EPOLLET);
+        !result.ok()) {
+        LOG(ERROR) << "Unable to accept a property subscriber: " << result.error();
+        return;
+    }
+    subscriber.socket = std::move(socket);
+    subscribers_.emplace(fd, std::move(subscriber));
+}
+
+void PropertySubscriptions::HandleSubscriber(int fd) {
+    auto it = subscribers_.find(fd);
+    if (it == subscribers_.end()) return;
+    auto& subscriber = it->second;
+
+    char buffer[kMaxPacketSize];
+    while (true) {
+        ssize_t size = TEMP_FAILURE_RETRY(recv(fd, buffer, sizeof(buffer), MSG_TRUNC));
+        if (size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (size <= 0) {
+            if (size == -1) PLOG(ERROR) << "Failed to read from a property subscriber";
+            Disconnect(fd);
+            return;
+        }
+
+        std::string_view data(buffer, std::min<size_t>(size, sizeof(buffer)));
+        uint32_t count;
+        bool ok = static_cast<size_t>(size) <= sizeof(buffer) && ParseUint32(&data, &count);
+        std::vector<std::string> prefixes;
+        for (uint32_t i = 0; ok && i < count; i++) {
+            ok = ParseString(&data, &prefixes.emplace_back());
+        }
+        if (!ok || !data.empty()) {
+            LOG(ERROR) << "Disconnecting property subscriber with a malformed subscription";
+            Disconnect(fd);
+            return;
+        }
+        subscriber.prefixes = std::move(prefixes);
+
+        // Let the client know that its subscription is in effect.
+        uint32_t no_changes = 0;
+        if (TEMP_FAILURE_RETRY(send(fd, &no_changes, sizeof(no_changes),
+                                    MSG_DONTWAIT | MSG_NOSIGNAL)) == -1) {
+            PLOG(ERROR) << "Failed to acknowledge a property subscription";
+        }
+    }
+    Flush(&subscriber);
+}
+
+void PropertySubscriptions::HandleChanges() {
+    uint64_t counter;
+    TEMP_FAILURE_RETRY(read(wake_fd_.get(), &counter, sizeof(counter)));
+
+    std::vector<std::pair<std::string, Change>> changes;
+    {
+        auto lock = std::lock_guard{lock_};
+        changes.swap(changes_);
+    }
+
+    std::vector<int> overflowed;
+    for (auto& [fd, subscriber] : subscribers_) {
+        for (const auto& [name, change] : changes) {
+            bool subscribed = std::any_of(
+                    subscriber.prefixes.begin(), subscriber.prefixes.end(),
+                    [&name](const auto& prefix) { return StartsWith(name, prefix); });
+            if (!subscribed) continue;
+
+            auto [can_read, inserted] = subscriber.can_read.emplace(name, false);
+            if (inserted) {
+                can_read->second = can_read_(subscriber.source_context, name);
+            }
+            if (can_read->second) {
+                subscriber.pending[name] = change;
+            }
+        }
+        if (subscriber.pending.size() > kMaxPendingChanges) {
+            overflowed.emplace_back(fd);
+        } else {
+            Flush(&subscriber);
+        }
+    }
+    for (int fd : overflowed) {
+        LOG(ERROR) << "Disconnecting property subscriber that fell more than "
+                   << kMaxPendingChanges << " changes behind";
+        Disconnect(fd);
+    }
+}
+
+void PropertySubscriptions::Flush(Subscriber* subscriber) {
+    while (!subscriber->pending.empty()) {
+        std::string packet;
+        AppendUint32(&packet, 0);
+        uint32_t count = 0;
+        auto it = subscriber->pending.begin();
+        for (; it != subscriber->pending.end(); ++it) {
+            const auto& [name, change] = *it;
+            size_t size = 3 * sizeof(uint32_t) + name.size() + change.value.size();
+            if (count > 0 && packet.size() + size > kMaxPacketSize) break;
+            AppendString(&packet, name);
+            AppendString(&packet, change.value);
+            AppendUint32(&packet, change.serial);
+            count++;
+        }
+        memcpy(packet.data(), &count, sizeof(count));
+
+        if (TEMP_FAILURE_RETRY(send(subscriber->socket.get(), packet.data(), packet.size(),
+                                    MSG_DONTWAIT | MSG_NOSIGNAL)) == -1) {
+            // On EAGAIN, the changes stay pending, and are coalesced with later ones until the
+            // socket becomes writable again.
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                PLOG(ERROR) << "Failed to send property changes to a subscriber";
+            }
+            return;
+        }
+        subscriber->pending.erase(subscriber->pending.begin(), it);
+    }
+}
+
+void PropertySubscriptions::Disconnect(int fd) {
+    if (auto result = epoll_.UnregisterHandler(fd); !result.ok()) {
+        LOG(ERROR) << result.error();
+    }
+    subscribers_.erase(fd);
+}
+
+}  // namespace init
+}  // namespace android
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/unique_fd.h>
+
+#include "epoll.h"
+#include "result.h"
+
+namespace android {
+namespace init {
+
+static constexpr const char kPropertySubscriptionSocket[] = "property_service_subscribe";
+
+// Sends batches of property changes to clients that subscribed to them by name prefix, so that
+// they don't have to poll or wait on each property separately.
+//
+// Clients connect to a SOCK_SEQPACKET socket and send a packet holding a uint32_t count of
+// prefixes, followed by each prefix as a uint32_t length and its characters. Sending another such
+// packet replaces the prefixes, and each one is acknowledged with a packet of 0 changes once it is
+// in effect. Each packet sent back holds a uint32_t count of changes, followed by the name and
+// value of each change in the same string format, and then its uint32_t serial.
+//
+// Changes are coalesced per client, so a client only receives the latest value of a property that
+// changed several times since its last batch. Nothing is sent to a client whose socket is full
+// until it drains, and clients that fall more than kMaxPendingChanges behind are disconnected.
+class PropertySubscriptions {
+  public:
+    static constexpr size_t kMaxPendingChanges = 4096;
+    static constexpr size_t kMaxPacketSize = 16 * 1024;
+
+    using CanReadCallback =
+            std::function<bool(const std::string& source_context, const std::string& name)>;
+
+    // |socket| is the listening socket. |can_read| decides whether a client with the given
+    // SELinux context may be told about changes to a property.
+    PropertySubscriptions(android::base::unique_fd socket, CanReadCallback can_read);
+    ~PropertySubscriptions();
+
+    Result<void> Start();
+
+    // Queues a change for the subscribers of |name|. This only takes a lock and is safe to call
+    // while holding property_write_lock.
+    void Notify(const std::string& name, const std::string& value, uint32_t serial);
+
+  private:
+    struct Change {
+        std::string value;
+        uint32_t serial;
+    };
+
+    struct Subscriber {
+        android::base::unique_fd socket;
+        std::string source_context;
+        std::vector<std::string> prefixes;
+        // Whether this subscriber may read each property it has been sent, by name.
+        std::map<std::string, bool> can_read;
+        // Changes not sent yet, by name.
+        std::map<std::string, Change> pending;
+    };
+
+    void Run();
+    void HandleAccept();
+    void HandleSubscriber(int fd);
+    void HandleChanges();
+    void Flush(Subscriber* subscriber);
+    void Disconnect(int fd);
+
+    android::base::unique_fd socket_;
+    android::base::unique_fd wake_fd_;
+    CanReadCallback can_read_;
+    Epoll epoll_;
+    std::thread thread_;
+    // Only accessed from thread_.
+    std::map<int, Subscriber> subscribers_;
+
+    std::mutex lock_;
+    std::vector<std::pair<std::string, Change>> changes_;
+    bool stopping_ = false;
+};
+
+}  // namespace init
+}  // namespace android
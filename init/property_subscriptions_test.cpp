@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "property_subscriptions.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <gtest/gtest.h>
+
+using android::base::unique_fd;
+
+namespace android {
+namespace init {
+
+static void AppendUint32(std::string* data, uint32_t value) {
+    data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void AppendString(std::string* data, const std::string& value) {
+    AppendUint32(data, value.size());
+    data->append(value);
+}
+
+static uint32_t ReadUint32(const std::string& data, size_t* offset) {
+    uint32_t value = 0;
+    if (*offset + sizeof(value) <= data.size()) {
+        memcpy(&value, data.data() + *offset, sizeof(value));
+    }
+    *offset += sizeof(value);
+    return value;
+}
+
+static std::string ReadString(const std::string& data, size_t* offset) {
+    uint32_t size = ReadUint32(data, offset);
+    std::string value = data.substr(std::min(*offset, data.size()), size);
+    *offset += size;
+    return value;
+}
+
+class PropertySubscriptionsTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        auto path = std::string(dir_.path) + "/socket";
+        sockaddr_un addr = {.sun_family = AF_UNIX};
+        strlcpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path));
+
+        unique_fd listener(socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0));
+        ASSERT_NE(-1, listener.get());
+        ASSERT_EQ(0, bind(listener.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+        ASSERT_EQ(0, listen(listener.get(), 8));
+
+        subscriptions_ = std::make_unique<PropertySubscriptions>(
+                std::move(listener),
+                [](const std::string&, const std::string& name) { return name != "test.secret"; });
+        ASSERT_RESULT_OK(subscriptions_->Start());
+
+        client_.reset(socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0));
+        ASSERT_NE(-1, client_.get());
+        ASSERT_EQ(0, connect(client_.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+    }
+
+    void Subscribe(const std::vector<std::string>& prefixes) {
+        std::string packet;
+        AppendUint32(&packet, prefixes.size());
+        for (const auto& prefix : prefixes) {
+            AppendString(&packet, prefix);
+        }
+        ASSERT_EQ(static_cast<ssize_t>(packet.size()),
+                  send(client_.get(), packet.data(), packet.size(), 0));
+        // Wait for the acknowledgement.
+        std::vector<std::pair<std::string, std::string>> changes;
+        ASSERT_NO_FATAL_FAILURE(Receive(&changes));
+        ASSERT_TRUE(changes.empty());
+    }
+
+    void Receive(std::vector<std::pair<std::string, std::string>>* changes) {
+        std::string packet(PropertySubscriptions::kMaxPacketSize, '\0');
+        ssize_t size = TEMP_FAILURE_RETRY(recv(client_.get(), packet.data(), packet.size(), 0));
+        ASSERT_GT(size, 0);
+        packet.resize(size);
+
+        size_t offset = 0;
+        uint32_t count = ReadUint32(packet, &offset);
+        for (uint32_t i = 0; i < count; i++) {
+            auto name = ReadString(packet, &offset);
+            auto value = ReadString(packet, &offset);
+            ReadUint32(packet, &offset);
+            changes->emplace_back(name, value);
+        }
+        ASSERT_EQ(packet.size(), offset);
+    }
+
+    TemporaryDir dir_;
+    std::unique_ptr<PropertySubscriptions> subscriptions_;
+    unique_fd client_;
+};
+
+TEST_F(PropertySubscriptionsTest, SendsSubscribedChanges) {
+    ASSERT_NO_FATAL_FAILURE(Subscribe({"test.", "other.exact"}));
+
+    subscriptions_->Notify("test.a", "1", 1);
+    subscriptions_->Notify("unrelated.a", "1", 1);
+    subscriptions_->Notify("test.secret", "1", 1);
+    subscriptions_->Notify("other.exact", "1", 1);
+    subscriptions_->Notify("test.a", "2", 2);
+    subscriptions_->Notify("test.done", "1", 1);
+
+    // Changes may arrive in any number of batches, and repeated changes may be coalesced.
+    std::map<std::string, std::string> values;
+    while (!values.count("test.done")) {
+        std::vector<std::pair<std::string, std::string>> changes;
+        ASSERT_NO_FATAL_FAILURE(Receive(&changes));
+        for (const auto& [name, value] : changes) {
+            values[name] = value;
+        }
+    }
+    EXPECT_EQ((std::map<std::string, std::string>{
+                      {"test.a", "2"}, {"other.exact", "1"}, {"test.done", "1"}}),
+              values);
+}
+
+TEST_F(PropertySubscriptionsTest, MalformedSubscriptionDisconnects) {
+    uint32_t count = 1;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(count)), send(client_.get(), &count, sizeof(count), 0));
+
+    char byte;
+    EXPECT_EQ(0, TEMP_FAILURE_RETRY(recv(client_.get(), &byte, sizeof(byte), 0)));
+}
+
+}  // namespace init
+}  // namespace android
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rc_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+
+#include "system/core/init/rc_cache.pb.h"
+#include "util.h"
+
+using android::base::unique_fd;
+using android::base::WriteStringToFd;
+
+namespace android {
+namespace init {
+
+void RcCache::Load() {
+    entries_.clear();
+    dirty_ = false;
+
+    auto contents = ReadFile(path_);
+    if (!contents.ok()) {
+        if (contents.error().code() != ENOENT) {
+            LOG(WARNING) << "Unable to read rc cache '" << path_ << "': " << contents.error();
+        }
+        return;
+    }
+
+    RcCacheFile cache_file;
+    if (!cache_file.ParseFromString(*contents)) {
+        LOG(WARNING) << "Unable to parse rc cache '" << path_ << "'";
+        return;
+    }
+    if (cache_file.fingerprint() != fingerprint_) {
+        LOG(INFO) << "Discarding rc cache '" << path_ << "' from a different build";
+        return;
+    }
+
+    for (const auto& entry : cache_file.entries()) {
+        auto& cached = entries_[entry.path()];
+        cached.stamp = {
+                .dev = static_cast<dev_t>(entry.dev()),
+                .ino = static_cast<ino_t>(entry.ino()),
+                .size = static_cast<off_t>(entry.size()),
+                .mtime_ns = entry.mtime_ns(),
+        };
+        cached.lines.reserve(entry.lines_size());
+        for (const auto& line : entry.lines()) {
+            cached.lines.emplace_back(ConfigLine{
+                    .line = line.line(),
+                    .args = {line.args().begin(), line.args().end()},
+            });
+        }
+    }
+}
+
+const ConfigLines* RcCache::Lookup(const std::string& path, FileStamp* stamp) {
+    *stamp = {};
+
+    // Mirror ReadFile(), which doesn't follow symlinks and refuses group or world writable files.
+    struct stat sb;
+    if (lstat(path.c_str(), &sb) < 0 || !S_ISREG(sb.st_mode) ||
+        (sb.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        return nullptr;
+    }
+    *stamp = {
+            .dev = sb.st_dev,
+            .ino = sb.st_ino,
+            .size = sb.st_size,
+            .mtime_ns = sb.st_mtim.tv_sec * 1000000000LL + sb.st_mtim.tv_nsec,
+    };
+
+    auto it = entries_.find(path);
+    if (it == entries_.end() || it->second.stamp != *stamp) {
+        return nullptr;
+    }
+    it->second.used = true;
+    return &it->second.lines;
+}
+
+void RcCache::Store(const std::string& path, const FileStamp& stamp, ConfigLines lines) {
+    if (stamp == FileStamp{}) {
+        return;
+    }
+    entries_[path] = {.stamp = stamp, .lines = std::move(lines), .used = true};
+    dirty_ = true;
+}
+
+Result<void> RcCache::Save() {
+    bool unused = std::any_of(entries_.begin(), entries_.end(),
+                              [](const auto& entry) { return !entry.second.used; });
+    if (!dirty_ && !unused) {
+        return {};
+    }
+
+    RcCacheFile cache_file;
+    cache_file.set_fingerprint(fingerprint_);
+    for (const auto& [path, entry] : entries_) {
+        if (!entry.used) {
+            continue;
+        }
+        auto cached = cache_file.add_entries();
+        cached->set_path(path);
+        cached->set_dev(entry.stamp.dev);
+        cached->set_ino(entry.stamp.ino);
+        cached->set_size(entry.stamp.size);
+        cached->set_mtime_ns(entry.stamp.mtime_ns);
+        for (const auto& line : entry.lines) {
+            auto cached_line = cached->add_lines();
+            cached_line->set_line(line.line);
+            for (const auto& arg : line.args) {
+                cached_line->add_args(arg);
+            }
+        }
+    }
+
+    std::string contents;
+    if (!cache_file.SerializeToString(&contents)) {
+        return Error() << "Unable to serialize rc cache";
+    }
+
+    // A cache cut short at a message boundary would still parse, and silently drop lines, so it
+    // must be fully on disk before it replaces the old one.
+    const std::string temp_path = path_ + ".tmp";
+    unique_fd fd(TEMP_FAILURE_RETRY(
+            open(temp_path.c_str(), O_WRONLY | O_CREAT | O_NOFOLLOW | O_TRUNC | O_CLOEXEC, 0600)));
+    if (fd == -1) {
+        return ErrnoError() << "Could not open temporary rc cache";
+    }
+    if (!WriteStringToFd(contents, fd) || fsync(fd.get()) < 0) {
+        int saved_errno = errno;
+        unlink(temp_path.c_str());
+        return Error(saved_errno) << "Unable to write rc cache";
+    }
+    fd.reset();
+
+    if (rename(temp_path.c_str(), path_.c_str()) < 0) {
+        int saved_errno = errno;
+        unlink(temp_path.c_str());
+        return Error(saved_errno) << "Unable to rename rc cache";
+    }
+    dirty_ = false;
+    return {};
+}
+
+}  // namespace init
+}  // namespace android
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+
+#include "parser.h"
+#include "result.h"
+
+namespace android {
+namespace init {
+
+// Keeps the tokenized contents of .rc files across boots, so that files which haven't changed
+// don't need to be read and tokenized again. The parsed Actions and Services themselves can't be
+// cached, since they hold builtin functions and depend on the state of the running system, so
+// the cached lines are still fed through the section parsers.
+//
+// Entries are validated against the device, inode, size and mtime of the file. Since partition
+// images are built with fixed timestamps, the whole cache is also tied to a fingerprint of the
+// builds it was created from. Entries for files that weren't parsed during this boot are dropped
+// when the cache is saved.
+class RcCache {
+  public:
+    struct FileStamp {
+        dev_t dev = 0;
+        ino_t ino = 0;
+        off_t size = 0;
+        int64_t mtime_ns = 0;
+
+        bool operator==(const FileStamp&) const = default;
+    };
+
+    RcCache(const std::string& path, const std::string& fingerprint)
+        : path_(path), fingerprint_(fingerprint) {}
+
+    // Reads the cache from |path|. A missing or unreadable cache, or one created for a different
+    // |fingerprint|, is treated as empty.
+    void Load();
+
+    // Returns the cached lines for |path| if its entry is still current, and otherwise nullptr.
+    // |stamp| is set to the file's current stamp, or left empty if it can't be stat'ed, and
+    // should be passed to Store() along with the freshly tokenized lines.
+    const ConfigLines* Lookup(const std::string& path, FileStamp* stamp);
+    void Store(const std::string& path, const FileStamp& stamp, ConfigLines lines);
+
+    // Writes the cache back to |path| if it changed since Load().
+    Result<void> Save();
+
+  private:
+    struct Entry {
+        FileStamp stamp;
+        ConfigLines lines;
+        bool used = false;
+    };
+
+    std::string path_;
+    std::string fingerprint_;
+    std::map<std::string, Entry> entries_;
+    bool dirty_ = false;
+};
+
+}  // namespace init
+}  // namespace android
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rc_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "parser.h"
+
+using namespace std::string_literals;
+
+namespace android {
+namespace init {
+
+namespace {
+
+class RecordingSectionParser : public SectionParser {
+  public:
+    explicit RecordingSectionParser(std::vector<std::vector<std::string>>* lines)
+        : lines_(lines) {}
+
+    Result<void> ParseSection(std::vector<std::string>&& args, const std::string&,
+                              int line) override {
+        args.emplace_back(std::to_string(line));
+        lines_->emplace_back(std::move(args));
+        return {};
+    }
+
+    Result<void> ParseLineSection(std::vector<std::string>&& args, int line) override {
+        args.emplace_back(std::to_string(line));
+        lines_->emplace_back(std::move(args));
+        return {};
+    }
+
+  private:
+    std::vector<std::vector<std::string>>* lines_;
+};
+
+std::vector<std::vector<std::string>> ParseWithCache(const std::string& path, RcCache* cache) {
+    std::vector<std::vector<std::string>> lines;
+    Parser parser;
+    parser.AddSectionParser("on", std::make_unique<RecordingSectionParser>(&lines));
+    parser.set_rc_cache(cache);
+    EXPECT_TRUE(parser.ParseConfig(path));
+    return lines;
+}
+
+// Rewrites |path| with |contents|, keeping its size and timestamps.
+void RewriteKeepingStamp(const std::string& path, const std::string& contents) {
+    struct stat sb;
+    ASSERT_EQ(stat(path.c_str(), &sb), 0);
+    ASSERT_EQ(static_cast<off_t>(contents.size()), sb.st_size);
+    ASSERT_TRUE(android::base::WriteStringToFile(contents, path));
+    timespec times[2] = {sb.st_atim, sb.st_mtim};
+    ASSERT_EQ(utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+}
+
+}  // namespace
+
+TEST(rc_cache, ReplaysCachedLines) {
+    TemporaryDir dir;
+    const std::string rc = dir.path + "/test.rc"s;
+    const std::string cache_path = dir.path + "/rc_cache"s;
+    ASSERT_TRUE(android::base::WriteStringToFile("on boot\n\n    start \"a b\"\n", rc));
+    chmod(rc.c_str(), 0644);
+
+    RcCache cache(cache_path, "build1");
+    cache.Load();
+    auto expected = ParseWithCache(rc, &cache);
+    std::vector<std::vector<std::string>> lines = {{"on", "boot", "1"}, {"start", "a b", "3"}};
+    EXPECT_EQ(lines, expected);
+    ASSERT_RESULT_OK(cache.Save());
+
+    // Changing the file behind the cache's back shows that the cached lines are used.
+    RewriteKeepingStamp(rc, "on init\n\n    start \"a b\"\n");
+    RcCache reloaded(cache_path, "build1");
+    reloaded.Load();
+    EXPECT_EQ(expected, ParseWithCache(rc, &reloaded));
+
+    // A different build discards the cache.
+    RcCache other_build(cache_path, "build2");
+    other_build.Load();
+    lines = {{"on", "init", "1"}, {"start", "a b", "3"}};
+    EXPECT_EQ(lines, ParseWithCache(rc, &other_build));
+}
+
+TEST(rc_cache, ModifiedFileIsReparsed) {
+    TemporaryDir dir;
+    const std::string rc = dir.path + "/test.rc"s;
+    const std::string cache_path = dir.path + "/rc_cache"s;
+    ASSERT_TRUE(android::base::WriteStringToFile("on boot\n", rc));
+    chmod(rc.c_str(), 0644);
+
+    RcCache cache(cache_path, "build");
+    cache.Load();
+    ParseWithCache(rc, &cache);
+    ASSERT_RESULT_OK(cache.Save());
+
+    ASSERT_TRUE(android::base::WriteStringToFile("on early-boot\n", rc));
+    RcCache reloaded(cache_path, "build");
+    reloaded.Load();
+    std::vector<std::vector<std::string>> lines = {{"on", "early-boot", "1"}};
+    EXPECT_EQ(lines, ParseWithCache(rc, &reloaded));
+}
+
+}  // namespace init
+}  // namespace android
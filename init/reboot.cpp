@@ -33,10 +33,15 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <map>
 #include <memory>
+#include <numeric>
 #include <set>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include <InitProperties.sysprop.h>
@@ -180,6 +185,8 @@ class MountEntry {
         return android::base::StartsWith(mntent.mnt_fsname, "/data/");
     }
 
+    const std::string& mnt_dir() const { return mnt_dir_; }
+
   private:
     bool IsF2Fs() const { return mnt_type_ == "f2fs"; }
 
@@ -217,9 +224,37 @@ static Result<void> CallVdc(const std::string& system, const std::string& cmd) {
     return Error() << "'/system/bin/vdc " << system << " " << cmd << "' failed : " << status;
 }
 
-static void LogShutdownTime(UmountStat stat, Timer* t) {
+// Records how long each step of the shutdown sequence took.
+class ShutdownTimeline {
+  public:
+    // Ends the step that started when the previous one ended.
+    void EndStep(const std::string& name) {
+        auto now = boot_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - step_start_);
+        LOG(INFO) << "Shutdown step '" << name << "' took " << duration.count() << "ms";
+        steps_.emplace_back(name, duration);
+        step_start_ = now;
+    }
+
+    // Returns the steps as "name:ms,name:ms,...".
+    std::string ToString() const {
+        std::string result;
+        for (const auto& [name, duration] : steps_) {
+            if (!result.empty()) result += ',';
+            result += name + ":" + std::to_string(duration.count());
+        }
+        return result;
+    }
+
+  private:
+    boot_clock::time_point step_start_ = boot_clock::now();
+    std::vector<std::pair<std::string, std::chrono::milliseconds>> steps_;
+};
+
+static void LogShutdownTime(UmountStat stat, Timer* t, const ShutdownTimeline& timeline) {
     LOG(WARNING) << "powerctl_shutdown_time_ms:" << std::to_string(t->duration().count()) << ":"
                  << stat;
+    LOG(WARNING) << "powerctl_shutdown_timeline:" << timeline.ToString();
 }
 
 static bool IsDataMounted(const std::string& fstype) {
@@ -280,6 +315,52 @@ static void DumpUmountDebuggingInfo() {
     WriteStringToFile("w", PROC_SYSRQ);
 }
 
+static bool IsNestedMount(const std::string& dir, const std::string& other) {
+    if (dir.size() < other.size()) return IsNestedMount(other, dir);
+    return dir == other || other == "/" ||
+           (android::base::StartsWith(dir, other) && dir[other.size()] == '/');
+}
+
+// Unmounts |entries|, which are in reverse mount order. Mounts that are nested in one another are
+// unmounted in that order by the same thread, while independent mount trees are unmounted in
+// parallel, so that one slow unmount doesn't hold up the others.
+// Returns true if all entries were unmounted.
+static bool UmountEntries(std::vector<MountEntry>& entries, bool force) {
+    std::vector<size_t> tree(entries.size());
+    std::iota(tree.begin(), tree.end(), 0);
+    for (size_t i = 0; i < entries.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (tree[i] == tree[j] || !IsNestedMount(entries[i].mnt_dir(), entries[j].mnt_dir())) {
+                continue;
+            }
+            auto merged = tree[i];
+            std::replace(tree.begin(), tree.end(), merged, tree[j]);
+        }
+    }
+    std::map<size_t, std::vector<MountEntry*>> trees;
+    for (size_t i = 0; i < entries.size(); i++) {
+        trees[tree[i]].emplace_back(&entries[i]);
+    }
+
+    std::atomic<bool> unmount_done = true;
+    auto umount_tree = [&](const std::vector<MountEntry*>& tree_entries) {
+        for (auto entry : tree_entries) {
+            if (!entry->Umount(force)) unmount_done = false;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (auto it = std::next(trees.begin()); it != trees.end(); ++it) {
+        threads.emplace_back(umount_tree, std::cref(it->second));
+    }
+    if (!trees.empty()) {
+        umount_tree(trees.begin()->second);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return unmount_done;
+}
+
 static UmountStat UmountPartitions(std::chrono::milliseconds timeout) {
     Timer t;
     /* data partition needs all pending writes to be completed and all emulated partitions
@@ -297,16 +378,12 @@ static UmountStat UmountPartitions(std::chrono::milliseconds timeout) {
         }
         bool unmount_done = true;
         if (emulated_devices.size() > 0) {
-            for (auto& entry : emulated_devices) {
-                if (!entry.Umount(false)) unmount_done = false;
-            }
+            unmount_done = UmountEntries(emulated_devices, false);
             if (unmount_done) {
                 sync();
             }
         }
-        for (auto& entry : block_devices) {
-            if (!entry.Umount(timeout == 0ms)) unmount_done = false;
-        }
+        if (!UmountEntries(block_devices, timeout == 0ms)) unmount_done = false;
         if (unmount_done) {
             return UMOUNT_STAT_SUCCESS;
         }
@@ -615,6 +692,7 @@ static Result<void> UnmountAllApexes() {
 static void DoReboot(unsigned int cmd, const std::string& reason, const std::string& reboot_target,
                      bool run_fsck) {
     Timer t;
+    ShutdownTimeline timeline;
     LOG(INFO) << "Reboot start, reason: " << reason << ", reboot_target: " << reboot_target;
 
     bool is_thermal_shutdown = cmd == ANDROID_RB_THERMOFF;
@@ -731,16 +809,20 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
         }
     }
 
+    timeline.EndStep("prepare");
+
     // optional shutdown step
     // 1. terminate all services except shutdown critical ones. wait for delay to finish
     if (shutdown_timeout > 0ms) {
         StopServicesAndLogViolations(stop_first, shutdown_timeout / 2, true /* SIGTERM */);
+        timeline.EndStep("sigterm");
     }
     // Send SIGKILL to ones that didn't terminate cleanly.
     StopServicesAndLogViolations(stop_first, 0ms, false /* SIGKILL */);
     SubcontextTerminate();
     // Reap subcontext pids.
     ReapAnyOutstandingChildren();
+    timeline.EndStep("sigkill");
 
     // 3. send volume abort_fuse and volume shutdown to vold
     Service* vold_service = ServiceList::GetInstance().FindService("vold");
@@ -755,6 +837,7 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
     }
     // logcat stopped here
     StopServices(kDebuggingServices, 0ms, false /* SIGKILL */);
+    timeline.EndStep("vold");
     // 4. sync, try umount, and optionally run fsck for user shutdown
     {
         Timer sync_timer;
@@ -762,16 +845,20 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
         sync();
         LOG(INFO) << "sync() before umount took" << sync_timer;
     }
+    timeline.EndStep("sync");
     // 5. drop caches and disable zram backing device, if exist
     KillZramBackingDevice();
+    timeline.EndStep("zram");
 
     LOG(INFO) << "Ready to unmount apexes. So far shutdown sequence took " << t;
     // 6. unmount active apexes, otherwise they might prevent clean unmount of /data.
     if (auto ret = UnmountAllApexes(); !ret.ok()) {
         LOG(ERROR) << ret.error();
     }
+    timeline.EndStep("apexes");
     UmountStat stat =
             TryUmountAndFsck(cmd, run_fsck, shutdown_timeout - t.duration(), &reboot_semaphore);
+    timeline.EndStep("umount");
     // Follow what linux shutdown is doing: one more sync with little bit delay
     {
         Timer sync_timer;
@@ -780,7 +867,8 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
         LOG(INFO) << "sync() after umount took" << sync_timer;
     }
     if (!is_thermal_shutdown) std::this_thread::sleep_for(100ms);
-    LogShutdownTime(stat, &t);
+    timeline.EndStep("final_sync");
+    LogShutdownTime(stat, &t, timeline);
 
     // Send signal to terminate reboot monitor thread.
     reboot_monitor_run = false;
@@ -16,6 +16,15 @@
 
 #include "selabel.h"
 
+#include <errno.h>
+#include <stdlib.h>
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <android-base/thread_annotations.h>
 #include <selinux/android.h>
 
 namespace android {
@@ -24,8 +33,62 @@ namespace init {
 namespace {
 
 selabel_handle* sehandle = nullptr;
+
+// selabel_lookup() matches the path against every file_contexts regex, which adds up during
+// coldboot, when ueventd looks up every device node, and again for nodes that see more than one
+// uevent. Results are memoized per exact key, since a context can't be derived from the contexts
+// of other paths. The cache belongs to sehandle, so it is dropped whenever file contexts are
+// reloaded; a kernel policy reload does not change the result of a lookup. ueventd's children
+// inherit whatever their parent cached before forking.
+constexpr size_t kMaxCachedLookups = 4096;
+
+std::mutex cache_lock;
+std::unordered_map<std::string, std::optional<std::string>> cached_lookups GUARDED_BY(cache_lock);
+
+std::string CacheKey(const std::string& key, const std::vector<std::string>& aliases, int type) {
+    std::string cache_key = std::to_string(type);
+    cache_key.push_back('\0');
+    cache_key.append(key);
+    for (const auto& alias : aliases) {
+        cache_key.push_back('\0');
+        cache_key.append(alias);
+    }
+    return cache_key;
+}
+
+// Returns the cached result of a lookup, or calls |lookup| to fill it in. |lookup| returns false,
+// with errno set by selabel, if there is no context for the key.
+template <typename F>
+bool CachedLookup(const std::string& cache_key, std::string* result, F lookup) {
+    {
+        auto lock = std::lock_guard{cache_lock};
+        if (auto it = cached_lookups.find(cache_key); it != cached_lookups.end()) {
+            if (!it->second) return false;
+            *result = *it->second;
+            return true;
+        }
+    }
+
+    std::optional<std::string> context;
+    if (std::string value; lookup(&value)) {
+        context = std::move(value);
+    } else if (errno != ENOENT) {
+        // Only remember that a key has no context, not that the lookup itself failed.
+        return false;
+    }
+
+    auto lock = std::lock_guard{cache_lock};
+    if (cached_lookups.size() >= kMaxCachedLookups) {
+        cached_lookups.clear();
+    }
+    cached_lookups.emplace(cache_key, context);
+    if (!context) return false;
+    *result = std::move(*context);
+    return true;
 }
 
+}  // namespace
+
 // selinux_android_file_context_handle() takes on the order of 10+ms to run, so we want to cache
 // its value.  selinux_android_restorecon() also needs an sehandle for file context look up.  It
 // will create and store its own copy, but selinux_android_set_sehandle() can be used to provide
@@ -33,6 +96,9 @@ selabel_handle* sehandle = nullptr;
 void SelabelInitialize() {
     sehandle = selinux_android_file_context_handle();
     selinux_android_set_sehandle(sehandle);
+
+    auto lock = std::lock_guard{cache_lock};
+    cached_lookups.clear();
 }
 
 // A C++ wrapper around selabel_lookup() using the cached sehandle.
@@ -42,13 +108,15 @@ bool SelabelLookupFileContext(const std::string& key, int type, std::string* res
 
     if (!sehandle) return true;
 
-    char* context;
-    if (selabel_lookup(sehandle, &context, key.c_str(), type) != 0) {
-        return false;
-    }
-    *result = context;
-    free(context);
-    return true;
+    return CachedLookup(CacheKey(key, {}, type), result, [&](std::string* value) {
+        char* context;
+        if (selabel_lookup(sehandle, &context, key.c_str(), type) != 0) {
+            return false;
+        }
+        *value = context;
+        free(context);
+        return true;
+    });
 }
 
 // A C++ wrapper around selabel_lookup_best_match() using the cached sehandle.
@@ -60,19 +128,21 @@ bool SelabelLookupFileContextBestMatch(const std::string& key,
 
     if (!sehandle) return true;
 
-    std::vector<const char*> c_aliases;
-    for (const auto& alias : aliases) {
-        c_aliases.emplace_back(alias.c_str());
-    }
-    c_aliases.emplace_back(nullptr);
+    return CachedLookup(CacheKey(key, aliases, type), result, [&](std::string* value) {
+        std::vector<const char*> c_aliases;
+        for (const auto& alias : aliases) {
+            c_aliases.emplace_back(alias.c_str());
+        }
+        c_aliases.emplace_back(nullptr);
 
-    char* context;
-    if (selabel_lookup_best_match(sehandle, &context, key.c_str(), &c_aliases[0], type) != 0) {
-        return false;
-    }
-    *result = context;
-    free(context);
-    return true;
+        char* context;
+        if (selabel_lookup_best_match(sehandle, &context, key.c_str(), &c_aliases[0], type) != 0) {
+            return false;
+        }
+        *value = context;
+        free(context);
+        return true;
+    });
 }
 
 }  // namespace init
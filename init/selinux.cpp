@@ -366,11 +366,13 @@ bool OpenSplitPolicy(PolicyFile* policy_file) {
     }
     compile_args.push_back(nullptr);
 
+    Timer compile_timer;
     if (!ForkExecveAndWaitForCompletion(compile_args[0], (char**)compile_args.data())) {
         unlink(compiled_sepolicy);
         return false;
     }
     unlink(compiled_sepolicy);
+    setenv(kEnvSelinuxCompileMs, std::to_string(compile_timer.duration().count()).c_str(), 1);
 
     policy_file->fd = std::move(compiled_sepolicy_fd);
     policy_file->path = compiled_sepolicy;
@@ -399,9 +401,11 @@ void ReadPolicy(std::string* policy) {
         LOG(FATAL) << "Unable to open SELinux policy";
     }
 
+    Timer read_timer;
     if (!android::base::ReadFdToString(policy_file.fd, policy)) {
         PLOG(FATAL) << "Failed to read policy file: " << policy_file.path;
     }
+    setenv(kEnvSelinuxReadMs, std::to_string(read_timer.duration().count()).c_str(), 1);
 }
 
 void SelinuxSetEnforcement() {
@@ -617,9 +621,11 @@ static void LoadSelinuxPolicy(std::string& policy) {
     LOG(INFO) << "Loading SELinux policy";
 
     set_selinuxmnt("/sys/fs/selinux");
+    Timer load_timer;
     if (security_load_policy(policy.data(), policy.size()) < 0) {
         PLOG(FATAL) << "SELinux:  Could not load policy";
     }
+    setenv(kEnvSelinuxLoadMs, std::to_string(load_timer.duration().count()).c_str(), 1);
 }
 
 // Encapsulates steps to load SELinux policy in Microdroid.
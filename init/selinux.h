@@ -35,6 +35,10 @@ void SelinuxSetupKernelLogging();
 int SelinuxGetVendorAndroidVersion();
 
 static constexpr char kEnvSelinuxStartedAt[] = "SELINUX_STARTED_AT";
+// Durations of the individual policy loading phases, reported as ro.boottime.init.selinux.*.
+static constexpr char kEnvSelinuxCompileMs[] = "SELINUX_COMPILE_MS";
+static constexpr char kEnvSelinuxReadMs[] = "SELINUX_READ_MS";
+static constexpr char kEnvSelinuxLoadMs[] = "SELINUX_LOAD_MS";
 
 }  // namespace init
 }  // namespace android
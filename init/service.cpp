@@ -53,6 +53,7 @@
 #ifdef INIT_FULL_SOURCES
 #include <android/api-level.h>
 
+#include "bootchart.h"
 #include "mount_namespace.h"
 #include "reboot_utils.h"
 #include "selinux.h"
@@ -287,6 +288,11 @@ void Service::Reap(const siginfo_t& siginfo) {
         f(siginfo);
     }
 
+    // The child may have died before reaching execv(); publish whatever it got through.
+    if (start_times_) {
+        PublishStartTimes();
+    }
+
     if ((siginfo.si_code != CLD_EXITED || siginfo.si_status != 0) && on_failure_reboot_target_) {
         LOG(ERROR) << "Service " << name_
                    << " has 'reboot_on_failure' option and failed, shutting down system.";
@@ -416,6 +422,9 @@ void Service::DumpState() const {
     LOG(INFO) << "service " << name_;
     LOG(INFO) << "  class '" << Join(classnames_, " ") << "'";
     LOG(INFO) << "  exec " << Join(args_, " ");
+    if (!last_start_times_.empty()) {
+        LOG(INFO) << "  start times (us) " << last_start_times_;
+    }
     for (const auto& socket : sockets_) {
         LOG(INFO) << "  socket " << socket.name;
     }
@@ -534,6 +543,7 @@ void Service::RunService(const std::vector<Descriptor>& descriptors,
     if (auto result = EnterNamespaces(namespaces_, name_, mount_namespace_); !result.ok()) {
         LOG(FATAL) << "Service '" << name_ << "' failed to set up namespaces: " << result.error();
     }
+    RecordStartPhase(ServiceStartTimes::kNamespaces);
 
     for (const auto& [key, value] : once_environment_vars_) {
         setenv(key.c_str(), value.c_str(), 1);
@@ -575,11 +585,14 @@ void Service::RunService(const std::vector<Descriptor>& descriptors,
             LOG(ERROR) << "failed to set task profiles";
         }
     }
+    RecordStartPhase(ServiceStartTimes::kTaskProfiles);
 
     // As requested, set our gid, supplemental gids, uid, context, and
     // priority. Aborts on failure.
     SetProcessAttributesAndCaps(std::move(setsid_finished));
+    RecordStartPhase(ServiceStartTimes::kAttributes);
 
+    RecordStartPhase(ServiceStartTimes::kExec);
     if (!ExpandArgsAndExecv(args_, sigstop_)) {
         PLOG(ERROR) << "cannot execv('" << args_[0]
                     << "'). See the 'Debugging init' section of init's README.md for tips";
@@ -587,6 +600,15 @@ void Service::RunService(const std::vector<Descriptor>& descriptors,
 }
 
 Result<void> Service::Start() {
+    OR_RETURN(BeginStart());
+    if (!start_pending()) {
+        return {};
+    }
+    return FinishStart();
+}
+
+Result<void> Service::BeginStart() {
+    auto begin_time = boot_clock::now();
     auto reboot_on_failure = make_scope_guard([this] {
         if (on_failure_reboot_target_) {
             trigger_shutdown(*on_failure_reboot_target_);
@@ -621,6 +643,11 @@ Result<void> Service::Start() {
         return {};
     }
 
+    start_times_ = ServiceStartTimes::Create();
+    if (start_times_) {
+        start_times_->Record(ServiceStartTimes::kBegin, begin_time);
+    }
+
     // cgroups_activated is used for communication from the parent to the child
     // while setsid_finished is used for communication from the child process to
     // the parent process. These two communication channels are separate because
@@ -650,6 +677,7 @@ Result<void> Service::Start() {
         }
         scon = *result;
     }
+    RecordStartPhase(ServiceStartTimes::kContext);
 
     if (!mount_namespace_.has_value()) {
         // remember from which mount namespace the service should start
@@ -676,6 +704,7 @@ Result<void> Service::Start() {
             LOG(INFO) << "Could not open file '" << file.name << "': " << result.error();
         }
     }
+    RecordStartPhase(ServiceStartTimes::kDescriptors);
 
     pid_t pid = -1;
     if (namespaces_.flags) {
@@ -699,6 +728,7 @@ Result<void> Service::Start() {
         pid_ = 0;
         return ErrnoError() << "Failed to fork";
     }
+    RecordStartPhase(ServiceStartTimes::kFork);
 
     once_environment_vars_.clear();
 
@@ -716,6 +746,29 @@ Result<void> Service::Start() {
     start_order_ = next_start_order_++;
     process_cgroup_empty_ = false;
 
+    // The child now waits for cgroups_activated, which FinishStart() sends once the parent-side
+    // setup is done.
+    pending_start_ = std::make_unique<PendingStart>(PendingStart{
+            .cgroups_activated = std::move(cgroups_activated),
+            .setsid_finished = std::move(setsid_finished),
+            .begin_time = begin_time,
+    });
+    reboot_on_failure.Disable();
+    return {};
+}
+
+Result<void> Service::FinishStart() {
+    auto reboot_on_failure = make_scope_guard([this] {
+        if (on_failure_reboot_target_) {
+            trigger_shutdown(*on_failure_reboot_target_);
+        }
+    });
+
+    CHECK(pending_start_) << "FinishStart() without BeginStart() for service '" << name_ << "'";
+    auto pending_start = std::move(pending_start_);
+    auto& cgroups_activated = pending_start->cgroups_activated;
+    auto& setsid_finished = pending_start->setsid_finished;
+
     if (CgroupsAvailable()) {
         bool use_memcg = swappiness_ != -1 || soft_limit_in_bytes_ != -1 || limit_in_bytes_ != -1 ||
                          limit_percent_ != -1 || !limit_property_.empty();
@@ -748,11 +801,12 @@ Result<void> Service::Start() {
     }
 
     cgroups_activated.Close();
+    RecordStartPhase(ServiceStartTimes::kCgroups);
 
     // Call setpgid() from the parent process to make sure that this call has
     // finished before the parent process calls kill(-pgid, ...).
     if (!RequiresConsole(proc_attr_)) {
-        if (setpgid(pid, pid) < 0) {
+        if (setpgid(pid_, pid_) < 0) {
             switch (errno) {
                 case EACCES:  // Child has already performed setpgid() followed by execve().
                 case ESRCH:   // Child process no longer exists.
@@ -780,10 +834,37 @@ Result<void> Service::Start() {
     reboot_on_failure.Disable();
 
     LOG(INFO) << "... started service '" << name_ << "' has pid " << pid_;
+    BootchartLogServiceStart(name_, pid_, boot_clock::now() - pending_start->begin_time);
 
     return {};
 }
 
+void Service::RecordStartPhase(ServiceStartTimes::Phase phase) {
+    if (start_times_) {
+        start_times_->Record(phase);
+    }
+}
+
+void Service::MaybePublishStartTimes() {
+    if (start_times_ && start_times_->Recorded(ServiceStartTimes::kExec)) {
+        PublishStartTimes();
+    }
+}
+
+void Service::PublishStartTimes() {
+    last_start_times_ = start_times_->Format();
+    start_times_.reset();
+
+    if ((flags_ & SVC_TEMPORARY) != 0) {
+        return;
+    }
+    // Like ro.boottime.<name>, this only describes the first start.
+    std::string property = "ro.boottime.init.start." + name_;
+    if (GetProperty(property, "").empty()) {
+        SetProperty(property, last_start_times_);
+    }
+}
+
 // Set mount namespace for the service.
 // The reason why remember the mount namespace:
 //   If this service is started before APEXes and corresponding linker configuration
@@ -866,6 +947,15 @@ Result<void> Service::StartIfNotDisabled() {
     return {};
 }
 
+Result<void> Service::BeginStartIfNotDisabled() {
+    if (!(flags_ & SVC_DISABLED)) {
+        return BeginStart();
+    } else {
+        flags_ |= SVC_DISABLED_START;
+    }
+    return {};
+}
+
 Result<void> Service::Enable() {
     flags_ &= ~(SVC_DISABLED | SVC_RC_DISABLED);
     if (flags_ & SVC_DISABLED_START) {
@@ -36,6 +36,7 @@
 #include "keyword_map.h"
 #include "mount_namespace.h"
 #include "parser.h"
+#include "service_start_times.h"
 #include "service_utils.h"
 #include "subcontext.h"
 
@@ -87,6 +88,18 @@ class Service {
     Result<void> ExecStart();
     Result<void> Start();
     Result<void> StartIfNotDisabled();
+    // Start() in two halves. BeginStart() returns as soon as the service is forked, and
+    // FinishStart() does the parent's remaining setup (cgroups, memcg, lmkd) and lets the child
+    // continue. Callers starting several services can fork all of them first, so that each child's
+    // own pre-exec setup overlaps with the parent setting up the others. If start_pending() is
+    // true after BeginStart(), FinishStart() must be called before anything else is done with
+    // the service.
+    Result<void> BeginStart();
+    Result<void> BeginStartIfNotDisabled();
+    Result<void> FinishStart();
+    bool start_pending() const { return pending_start_ != nullptr; }
+    // Publishes the phase timings of the last start once the child has reached execv().
+    void MaybePublishStartTimes();
     Result<void> Enable();
     void Reset();
     void Stop();
@@ -172,8 +185,17 @@ class Service {
     void RunService(const std::vector<Descriptor>& descriptors, InterprocessFifo cgroups_activated,
                     InterprocessFifo setsid_finished);
     void SetMountNamespace();
+    void RecordStartPhase(ServiceStartTimes::Phase phase);
+    void PublishStartTimes();
     static ::android::base::unique_fd CreateSigchldFd();
 
+    // State handed from BeginStart() to FinishStart().
+    struct PendingStart {
+        InterprocessFifo cgroups_activated;
+        InterprocessFifo setsid_finished;
+        android::base::boot_clock::time_point begin_time;
+    };
+
     static unsigned long next_start_order_;
     static bool is_exec_service_running_;
 
@@ -248,6 +270,11 @@ class Service {
 
     std::optional<std::string> on_failure_reboot_target_;
 
+    std::unique_ptr<PendingStart> pending_start_;
+
+    std::unique_ptr<ServiceStartTimes> start_times_;  // until published
+    std::string last_start_times_;                    // as published
+
     std::string filename_;
 };
 
@@ -37,9 +37,82 @@ size_t ServiceList::CheckAllCommands() {
 }
 
 void ServiceList::AddService(std::unique_ptr<Service> service) {
+    IndexService(service.get());
     services_.emplace_back(std::move(service));
 }
 
+void ServiceList::IndexService(Service* svc) {
+    // emplace() keeps an existing entry, so the first service added with a name or interface
+    // stays the one that is found.
+    services_by_name_.emplace(svc->name(), svc);
+    for (const auto& interface : svc->interfaces()) {
+        services_by_interface_.emplace(interface, svc);
+    }
+    if (svc->pid() > 0) {
+        services_by_pid_[svc->pid()] = svc;
+    }
+}
+
+void ServiceList::UnindexService(const Service& svc) {
+    if (auto it = services_by_name_.find(svc.name());
+        it != services_by_name_.end() && it->second == &svc) {
+        services_by_name_.erase(it);
+    }
+    for (const auto& interface : svc.interfaces()) {
+        if (auto it = services_by_interface_.find(interface);
+            it != services_by_interface_.end() && it->second == &svc) {
+            services_by_interface_.erase(it);
+        }
+    }
+    std::erase_if(services_by_pid_, [&svc](const auto& entry) { return entry.second == &svc; });
+}
+
+void ServiceList::ReindexAfterRemoval(const Service& svc) {
+    auto reindex = [this](auto* index, const std::string& key, auto provides) {
+        if (index->count(key)) return;
+        for (const auto& s : services_) {
+            if (provides(*s)) {
+                index->emplace(key, s.get());
+                return;
+            }
+        }
+    };
+    reindex(&services_by_name_, svc.name(),
+            [&svc](const Service& s) { return s.name() == svc.name(); });
+    for (const auto& interface : svc.interfaces()) {
+        reindex(&services_by_interface_, interface,
+                [&interface](const Service& s) { return s.interfaces().count(interface) > 0; });
+    }
+}
+
+Service* ServiceList::FindService(const std::string& name) const {
+    auto it = services_by_name_.find(name);
+    return it != services_by_name_.end() ? it->second : nullptr;
+}
+
+Service* ServiceList::FindServiceByPid(pid_t pid) const {
+    if (auto it = services_by_pid_.find(pid);
+        it != services_by_pid_.end() && it->second->pid() == pid) {
+        return it->second;
+    }
+
+    // Rebuild the whole cache, so the pids of services started since the last miss are found
+    // without scanning again.
+    services_by_pid_.clear();
+    Service* found = nullptr;
+    for (const auto& s : services_) {
+        if (s->pid() <= 0) continue;
+        services_by_pid_.emplace(s->pid(), s.get());
+        if (!found && s->pid() == pid) found = s.get();
+    }
+    return found;
+}
+
+Service* ServiceList::FindInterface(const std::string& interface_name) const {
+    auto it = services_by_interface_.find(interface_name);
+    return it != services_by_interface_.end() ? it->second : nullptr;
+}
+
 // Shutdown services in the opposite order that they were started.
 const std::vector<Service*> ServiceList::services_in_shutdown_order() const {
     std::vector<Service*> shutdown_services;
@@ -59,7 +132,11 @@ void ServiceList::RemoveService(const Service& svc) {
         return;
     }
 
+    // Keep the service alive until it is no longer indexed, since |svc| may refer to it.
+    std::unique_ptr<Service> removed = std::move(*svc_it);
     services_.erase(svc_it);
+    UnindexService(*removed);
+    ReindexAfterRemoval(*removed);
 }
 
 void ServiceList::DumpState() const {
@@ -16,8 +16,11 @@
 
 #pragma once
 
+#include <sys/types.h>
+
 #include <iterator>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/logging.h>
@@ -40,12 +43,30 @@ class ServiceList {
     void RemoveService(const Service& svc);
     template <class UnaryPredicate>
     void RemoveServiceIf(UnaryPredicate predicate) {
-        services_.erase(std::remove_if(services_.begin(), services_.end(), predicate),
-                        services_.end());
+        auto it = std::stable_partition(services_.begin(), services_.end(),
+                                        [&predicate](const std::unique_ptr<Service>& s) {
+                                            return !predicate(s);
+                                        });
+        // Keep the removed services alive until they are no longer indexed.
+        std::vector<std::unique_ptr<Service>> removed(std::make_move_iterator(it),
+                                                      std::make_move_iterator(services_.end()));
+        services_.erase(it, services_.end());
+        for (const auto& svc : removed) {
+            UnindexService(*svc);
+        }
+        for (const auto& svc : removed) {
+            ReindexAfterRemoval(*svc);
+        }
     }
 
-    template <typename T, typename F = decltype(&Service::name)>
-    Service* FindService(T value, F function = &Service::name) const {
+    // Looks up a service by name, or by pid, through an index. These are the lookups done for
+    // every start, stop, control message and reaped child, so they must not scan all services.
+    Service* FindService(const std::string& name) const;
+    Service* FindServiceByPid(pid_t pid) const;
+
+    // Scans all services for the first one for which |function| returns |value|.
+    template <typename T, typename F>
+    Service* FindService(T value, F function) const {
         auto svc = std::find_if(services_.begin(), services_.end(),
                                 [&function, &value](const std::unique_ptr<Service>& s) {
                                     return std::invoke(function, s) == value;
@@ -67,15 +88,7 @@ class ServiceList {
         return matches;
     }
 
-    Service* FindInterface(const std::string& interface_name) {
-        for (const auto& svc : services_) {
-            if (svc->interfaces().count(interface_name) > 0) {
-                return svc.get();
-            }
-        }
-
-        return nullptr;
-    }
+    Service* FindInterface(const std::string& interface_name) const;
 
     void DumpState() const;
 
@@ -93,8 +106,22 @@ class ServiceList {
     auto size() const { return services_.size(); }
 
   private:
+    void IndexService(Service* svc);
+    void UnindexService(const Service& svc);
+    // Once |svc| is no longer in services_, indexes the next service with its name or any of
+    // its interfaces, if one was hidden behind it.
+    void ReindexAfterRemoval(const Service& svc);
+
     std::vector<std::unique_ptr<Service>> services_;
 
+    // The first service in services_ with each name and interface, as FindService() and
+    // FindInterface() would find by scanning services_.
+    std::unordered_map<std::string, Service*> services_by_name_;
+    std::unordered_map<std::string, Service*> services_by_interface_;
+    // Pids change as services start and stop without ServiceList being told, so this is only a
+    // cache. Entries are checked against Service::pid() and refreshed on a miss.
+    mutable std::unordered_map<pid_t, Service*> services_by_pid_;
+
     bool post_data_ = false;
     std::vector<std::string> delayed_service_names_;
 };
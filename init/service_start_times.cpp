@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "service_start_times.h"
+
+#include <inttypes.h>
+#include <sys/mman.h>
+
+#include <iterator>
+#include <new>
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+using android::base::boot_clock;
+using android::base::StringAppendF;
+
+namespace android {
+namespace init {
+
+static constexpr const char* kPhaseNames[] = {
+        "begin",         "context",    "descriptors", "fork", "cgroups", "namespaces",
+        "task_profiles", "attributes", "exec",
+};
+static_assert(std::size(kPhaseNames) == ServiceStartTimes::kNumPhases);
+
+static constexpr size_t kMappingSize = sizeof(std::atomic<int64_t>) * ServiceStartTimes::kNumPhases;
+
+std::unique_ptr<ServiceStartTimes> ServiceStartTimes::Create() {
+    void* addr = mmap(nullptr, kMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                      -1, 0);
+    if (addr == MAP_FAILED) {
+        PLOG(ERROR) << "Could not map service start times";
+        return nullptr;
+    }
+    auto times = static_cast<std::atomic<int64_t>*>(addr);
+    for (int i = 0; i < kNumPhases; i++) {
+        new (&times[i]) std::atomic<int64_t>(0);
+    }
+    return std::unique_ptr<ServiceStartTimes>(new ServiceStartTimes(times));
+}
+
+ServiceStartTimes::~ServiceStartTimes() {
+    munmap(times_, kMappingSize);
+}
+
+void ServiceStartTimes::Record(Phase phase, boot_clock::time_point time) {
+    // kExec is the child's last phase, so once it is seen all of the others are visible too.
+    times_[phase].store(time.time_since_epoch().count(), std::memory_order_release);
+}
+
+bool ServiceStartTimes::Recorded(Phase phase) const {
+    return times_[phase].load(std::memory_order_acquire) != 0;
+}
+
+std::string ServiceStartTimes::Format() const {
+    int64_t begin = times_[kBegin].load(std::memory_order_acquire);
+    std::string result;
+    for (int i = kBegin + 1; i < kNumPhases; i++) {
+        int64_t time = times_[i].load(std::memory_order_acquire);
+        if (time == 0) {
+            continue;
+        }
+        StringAppendF(&result, "%s%s:%" PRId64, result.empty() ? "" : ",", kPhaseNames[i],
+                      (time - begin) / 1000);
+    }
+    return result;
+}
+
+}  // namespace init
+}  // namespace android
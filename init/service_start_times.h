@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <android-base/chrono_utils.h>
+
+namespace android {
+namespace init {
+
+// Boot clock timestamps of the phases of one Service::Start(). They live in a shared anonymous
+// mapping so that the child can record the phases it runs between fork() and execv(), which the
+// parent otherwise never hears about.
+class ServiceStartTimes {
+  public:
+    enum Phase {
+        kBegin,
+        // Recorded by init.
+        kContext,      // The SELinux context of the service is known.
+        kDescriptors,  // Sockets and files are created.
+        kFork,
+        kCgroups,  // The process group is set up and the child has been told to continue.
+        // Recorded by the child.
+        kNamespaces,
+        kTaskProfiles,
+        kAttributes,  // Ids, capabilities, setexeccon() and priority are set.
+        kExec,        // About to call execv().
+        kNumPhases,
+    };
+
+    // Returns nullptr if the mapping cannot be created, in which case the start isn't timed.
+    static std::unique_ptr<ServiceStartTimes> Create();
+
+    ServiceStartTimes(const ServiceStartTimes&) = delete;
+    ServiceStartTimes& operator=(const ServiceStartTimes&) = delete;
+    ~ServiceStartTimes();
+
+    void Record(Phase phase,
+                android::base::boot_clock::time_point time = android::base::boot_clock::now());
+    bool Recorded(Phase phase) const;
+
+    // Returns 'phase:offset,...' for every phase that was reached, where offset is the time since
+    // kBegin in microseconds.
+    std::string Format() const;
+
+  private:
+    explicit ServiceStartTimes(std::atomic<int64_t>* times) : times_(times) {}
+
+    std::atomic<int64_t>* times_;
+};
+
+}  // namespace init
+}  // namespace android
@@ -29,11 +29,13 @@
 #include <android-base/strings.h>
 #include <selinux/selinux.h>
 #include <sys/signalfd.h>
+#include <sys/wait.h>
 #include "lmkd_service.h"
 #include "reboot.h"
 #include "service.h"
 #include "service_list.h"
 #include "service_parser.h"
+#include "service_start_times.h"
 #include "util.h"
 
 using ::android::base::ReadFileToString;
@@ -79,6 +81,7 @@ TEST(service, pod_initialized) {
     EXPECT_EQ(0, service_in_old_memory->priority());
     EXPECT_EQ(DEFAULT_OOM_SCORE_ADJUST, service_in_old_memory->oom_score_adjust());
     EXPECT_FALSE(service_in_old_memory->process_cgroup_empty());
+    EXPECT_FALSE(service_in_old_memory->start_pending());
 
     for (std::size_t i = 0; i < memory_size; ++i) {
         old_memory[i] = 0xFF;
@@ -99,6 +102,7 @@ TEST(service, pod_initialized) {
     EXPECT_EQ(0, service_in_old_memory2->priority());
     EXPECT_EQ(DEFAULT_OOM_SCORE_ADJUST, service_in_old_memory2->oom_score_adjust());
     EXPECT_FALSE(service_in_old_memory->process_cgroup_empty());
+    EXPECT_FALSE(service_in_old_memory2->start_pending());
 }
 
 TEST(service, make_temporary_oneshot_service_invalid_syntax) {
@@ -281,5 +285,35 @@ service $name /system/bin/yes
 
 INSTANTIATE_TEST_SUITE_P(service, ServiceStopTest, testing::Values(false, true));
 
+TEST(service, start_times_format) {
+    auto start_times = ServiceStartTimes::Create();
+    ASSERT_NE(start_times, nullptr);
+    EXPECT_EQ(start_times->Format(), "");
+
+    auto begin = android::base::boot_clock::now();
+    start_times->Record(ServiceStartTimes::kBegin, begin);
+    start_times->Record(ServiceStartTimes::kFork, begin + 1500us);
+    start_times->Record(ServiceStartTimes::kExec, begin + 2ms);
+    EXPECT_TRUE(start_times->Recorded(ServiceStartTimes::kFork));
+    EXPECT_FALSE(start_times->Recorded(ServiceStartTimes::kCgroups));
+    EXPECT_EQ(start_times->Format(), "fork:1500,exec:2000");
+}
+
+TEST(service, start_times_recorded_by_child) {
+    auto start_times = ServiceStartTimes::Create();
+    ASSERT_NE(start_times, nullptr);
+    start_times->Record(ServiceStartTimes::kBegin);
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        start_times->Record(ServiceStartTimes::kExec);
+        _exit(0);
+    }
+    int status;
+    ASSERT_EQ(pid, TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)));
+    EXPECT_TRUE(start_times->Recorded(ServiceStartTimes::kExec));
+}
+
 }  // namespace init
 }  // namespace android
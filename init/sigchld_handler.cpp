@@ -16,10 +16,12 @@
 
 #include "sigchld_handler.h"
 
+#include <poll.h>
 #include <signal.h>
 #include <string.h>
 #include <sys/signalfd.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -29,6 +31,7 @@
 #include <android-base/logging.h>
 #include <android-base/scopeguard.h>
 #include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
 
 #include <thread>
 
@@ -42,6 +45,7 @@ using android::base::make_scope_guard;
 using android::base::ReadFileToString;
 using android::base::StringPrintf;
 using android::base::Timer;
+using android::base::unique_fd;
 
 namespace android {
 namespace init {
@@ -76,7 +80,7 @@ static pid_t ReapOneProcess() {
     if (SubcontextChildReap(pid)) {
         name = "Subcontext";
     } else {
-        service = ServiceList::GetInstance().FindService(pid, &Service::pid);
+        service = ServiceList::GetInstance().FindServiceByPid(pid);
 
         if (service) {
             name = StringPrintf("Service '%s' (pid %d)", service->name().c_str(), pid);
@@ -129,6 +133,16 @@ std::set<pid_t> ReapAnyOutstandingChildren() {
     }
 }
 
+bool ReapAnyOutstandingChildren(std::chrono::milliseconds time_slice) {
+    Timer t;
+    while (ReapOneProcess() > 0) {
+        if (t.duration() >= time_slice) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static void ReapAndRemove(std::vector<pid_t>& alive_pids) {
     for (auto pid : ReapAnyOutstandingChildren()) {
         const auto it = std::find(alive_pids.begin(), alive_pids.end(), pid);
@@ -147,6 +161,29 @@ static void HandleSignal(int signal_fd) {
     }
 }
 
+// Waits for up to |timeout| for any of |alive_pids| to exit, using a pidfd per pid. Pids that no
+// longer exist are removed from |alive_pids|. Returns false if pidfds are not supported.
+static bool WaitForPidfds(std::vector<pid_t>& alive_pids, std::chrono::milliseconds timeout) {
+    std::vector<unique_fd> pidfds;
+    std::vector<pollfd> fds;
+    for (auto it = alive_pids.begin(); it != alive_pids.end();) {
+        unique_fd pidfd(syscall(__NR_pidfd_open, *it, 0));
+        if (pidfd == -1) {
+            if (errno != ESRCH) return false;
+            it = alive_pids.erase(it);
+            continue;
+        }
+        fds.push_back({.fd = pidfd.get(), .events = POLLIN});
+        pidfds.emplace_back(std::move(pidfd));
+        ++it;
+    }
+    if (!fds.empty() && TEMP_FAILURE_RETRY(poll(fds.data(), fds.size(), timeout.count())) == -1) {
+        PLOG(WARNING) << "poll() on pidfds failed";
+        return false;
+    }
+    return true;
+}
+
 void WaitToBeReaped(int sigchld_fd, const std::vector<pid_t>& pids,
                     std::chrono::milliseconds timeout) {
     Timer t;
@@ -179,7 +216,10 @@ void WaitToBeReaped(int sigchld_fd, const std::vector<pid_t>& pids,
                 LOG(WARNING) << "Epoll::Wait() failed " << result.error();
             }
         }
-        std::this_thread::sleep_for(50ms);
+        // Without the SIGCHLD fd, wait for the pids themselves rather than polling.
+        if (!WaitForPidfds(alive_pids, std::max(timeout - t.duration(), 0ms))) {
+            std::this_thread::sleep_for(50ms);
+        }
         ReapAndRemove(alive_pids);
     }
     LOG(INFO) << "Waiting for " << pids.size() << " pids to be reaped took " << t << " with "
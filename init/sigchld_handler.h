@@ -26,6 +26,10 @@ namespace init {
 
 std::set<pid_t> ReapAnyOutstandingChildren();
 
+// Reaps children until none are left or |time_slice| has passed, so that a burst of exits doesn't
+// stall everything else. Returns false if children may be left to reap.
+bool ReapAnyOutstandingChildren(std::chrono::milliseconds time_slice);
+
 void WaitToBeReaped(int sigchld_fd, const std::vector<pid_t>& pids,
                     std::chrono::milliseconds timeout);
 
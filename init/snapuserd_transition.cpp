@@ -27,6 +27,7 @@
 #include <string_view>
 #include <thread>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
@@ -305,6 +306,9 @@ bool SnapuserdSelinuxHelper::TestSnapuserdIsReady() {
 }
 
 void SnapuserdSelinuxHelper::RelaunchFirstStageSnapuserd() {
+    // I/O to the snapshotted partitions stalls from the moment the first-stage daemon detaches
+    // until the new daemon serves its first read.
+    android::base::Timer stall;
     if (!sm_->DetachFirstStageSnapuserdForSelinux()) {
         LOG(FATAL) << "Could not perform selinux transition";
     }
@@ -343,8 +347,10 @@ void SnapuserdSelinuxHelper::RelaunchFirstStageSnapuserd() {
         if (!TestSnapuserdIsReady()) {
             PLOG(FATAL) << "snapuserd daemon failed to launch";
         } else {
-            LOG(INFO) << "snapuserd daemon is up and running";
+            LOG(INFO) << "snapuserd daemon is up and running, I/O stalled for " << stall;
         }
+        setenv(kEnvSnapuserdTransitionStallMs, std::to_string(stall.duration().count()).c_str(),
+               1);
 
         return;
     }
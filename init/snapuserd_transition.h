@@ -29,6 +29,10 @@
 namespace android {
 namespace init {
 
+// How long, in ms, I/O to the snapshotted partitions stalled while snapuserd was relaunched for the
+// SELinux transition. Passed from the SELinux setup stage to second stage init.
+static constexpr char kEnvSnapuserdTransitionStallMs[] = "SNAPUSERD_TRANSITION_STALL_MS";
+
 // Fork and exec a new copy of snapuserd.
 void LaunchFirstStageSnapuserd();
 
@@ -22,6 +22,7 @@
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
@@ -66,8 +67,9 @@ class SubcontextProcess {
     void MainLoop();
 
   private:
-    void RunCommand(const SubcontextCommand::ExecuteCommand& execute_command,
-                    SubcontextReply* reply) const;
+    Result<void> RunCommand(const SubcontextCommand::ExecuteCommand& execute_command) const;
+    void RunCommands(const SubcontextCommand::ExecuteBatchCommand& execute_batch_command,
+                     SubcontextReply* reply) const;
     void ExpandArgs(const SubcontextCommand::ExpandArgsCommand& expand_args_command,
                     SubcontextReply* reply) const;
 
@@ -76,8 +78,19 @@ class SubcontextProcess {
     const int init_fd_;
 };
 
-void SubcontextProcess::RunCommand(const SubcontextCommand::ExecuteCommand& execute_command,
-                                   SubcontextReply* reply) const {
+// Batch replies stop once they grow past half of a message, and truncate error strings to a quarter
+// of one, so that they can always be sent.
+constexpr size_t kMaxBatchReplySize = kBufferSize / 2;
+constexpr size_t kMaxBatchErrorLength = kBufferSize / 4;
+
+void SetFailure(const ResultError<>& error, SubcontextReply::Failure* failure,
+                size_t max_length = std::string::npos) {
+    failure->set_error_string(error.message().substr(0, max_length));
+    failure->set_error_errno(error.code());
+}
+
+Result<void> SubcontextProcess::RunCommand(
+        const SubcontextCommand::ExecuteCommand& execute_command) const {
     // Need to use ArraySplice instead of this code.
     auto args = std::vector<std::string>();
     for (const auto& string : execute_command.args()) {
@@ -85,19 +98,30 @@ void SubcontextProcess::RunCommand(const SubcontextCommand::ExecuteCommand& exec
     }
 
     auto map_result = function_map_->Find(args);
-    Result<void> result;
     if (!map_result.ok()) {
-        result = Error() << "Cannot find command: " << map_result.error();
-    } else {
-        result = RunBuiltinFunction(map_result->function, args, context_);
+        return Error() << "Cannot find command: " << map_result.error();
     }
+    return RunBuiltinFunction(map_result->function, args, context_);
+}
 
-    if (result.ok()) {
-        reply->set_success(true);
-    } else {
-        auto* failure = reply->mutable_failure();
-        failure->set_error_string(result.error().message());
-        failure->set_error_errno(result.error().code());
+void SubcontextProcess::RunCommands(
+        const SubcontextCommand::ExecuteBatchCommand& execute_batch_command,
+        SubcontextReply* reply) const {
+    auto* execute_batch_reply = reply->mutable_execute_batch_reply();
+    for (const auto& execute_command : execute_batch_command.commands()) {
+        android::base::Timer t;
+        auto result = RunCommand(execute_command);
+
+        auto* command_reply = execute_batch_reply->add_command_replies();
+        command_reply->set_duration_ms(t.duration().count());
+        if (!result.ok()) {
+            SetFailure(result.error(), command_reply->mutable_failure(), kMaxBatchErrorLength);
+        }
+
+        // Init has to act on a shutdown before running anything else.
+        if (!shutdown_command.empty() || reply->ByteSizeLong() > kMaxBatchReplySize) {
+            return;
+        }
     }
 }
 
@@ -149,7 +173,15 @@ void SubcontextProcess::MainLoop() {
         auto reply = SubcontextReply();
         switch (subcontext_command.command_case()) {
             case SubcontextCommand::kExecuteCommand: {
-                RunCommand(subcontext_command.execute_command(), &reply);
+                if (auto result = RunCommand(subcontext_command.execute_command()); result.ok()) {
+                    reply.set_success(true);
+                } else {
+                    SetFailure(result.error(), reply.mutable_failure());
+                }
+                break;
+            }
+            case SubcontextCommand::kExecuteBatchCommand: {
+                RunCommands(subcontext_command.execute_batch_command(), &reply);
                 break;
             }
             case SubcontextCommand::kExpandArgsCommand: {
@@ -316,6 +348,52 @@ Result<void> Subcontext::Execute(const std::vector<std::string>& args) {
     return {};
 }
 
+Result<std::vector<Subcontext::CommandResult>> Subcontext::ExecuteBatch(
+        const std::vector<std::vector<std::string>>& commands) {
+    auto subcontext_command = SubcontextCommand();
+    auto* execute_batch_command = subcontext_command.mutable_execute_batch_command();
+    for (const auto& args : commands) {
+        auto* execute_command = execute_batch_command->add_commands();
+        std::copy(args.begin(), args.end(),
+                  RepeatedPtrFieldBackInserter(execute_command->mutable_args()));
+        // Leave whatever doesn't fit for the next batch.
+        if (subcontext_command.ByteSizeLong() > kBufferSize &&
+            execute_batch_command->commands_size() > 1) {
+            execute_batch_command->mutable_commands()->RemoveLast();
+            break;
+        }
+    }
+
+    auto subcontext_reply = TransmitMessage(subcontext_command);
+    if (!subcontext_reply.ok()) {
+        return subcontext_reply.error();
+    }
+
+    if (subcontext_reply->reply_case() != SubcontextReply::kExecuteBatchReply) {
+        return Error() << "Unexpected message type from subcontext: "
+                       << subcontext_reply->reply_case();
+    }
+
+    auto& reply = subcontext_reply->execute_batch_reply();
+    if (reply.command_replies_size() == 0 ||
+        reply.command_replies_size() > execute_batch_command->commands_size()) {
+        return Error() << "Subcontext replied for " << reply.command_replies_size() << " of "
+                       << execute_batch_command->commands_size() << " commands";
+    }
+
+    auto results = std::vector<CommandResult>{};
+    for (const auto& command_reply : reply.command_replies()) {
+        auto& result = results.emplace_back(CommandResult{
+                .duration = std::chrono::milliseconds(command_reply.duration_ms()),
+        });
+        if (command_reply.has_failure()) {
+            auto& failure = command_reply.failure();
+            result.result = ResultError<>(failure.error_string(), failure.error_errno());
+        }
+    }
+    return results;
+}
+
 Result<std::vector<std::string>> Subcontext::ExpandArgs(const std::vector<std::string>& args) {
     auto subcontext_command = SubcontextCommand{};
     std::copy(args.begin(), args.end(),
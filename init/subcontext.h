@@ -18,6 +18,7 @@
 
 #include <signal.h>
 
+#include <chrono>
 #include <string>
 #include <vector>
 
@@ -45,7 +46,17 @@ class Subcontext {
         }
     }
 
+    struct CommandResult {
+        Result<void> result;
+        std::chrono::milliseconds duration;
+    };
+
     Result<void> Execute(const std::vector<std::string>& args);
+    // Executes |commands| in order in a single round trip, and returns the result of each command
+    // that ran. That can be fewer than were passed, if one of them triggers a shutdown or they do
+    // not all fit in one message. The rest are left for the caller to send.
+    Result<std::vector<CommandResult>> ExecuteBatch(
+            const std::vector<std::vector<std::string>>& commands);
     Result<std::vector<std::string>> ExpandArgs(const std::vector<std::string>& args);
     void Restart();
     bool PathMatchesSubcontext(const std::string& path) const;
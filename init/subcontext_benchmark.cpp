@@ -48,6 +48,35 @@ static void BenchmarkSuccess(benchmark::State& state) {
 
 BENCHMARK(BenchmarkSuccess);
 
+static void BenchmarkBatchSuccess(benchmark::State& state) {
+    if (getuid() != 0) {
+        state.SkipWithError("Skipping benchmark, must be run as root.");
+        return;
+    }
+    char* context;
+    if (getcon(&context) != 0) {
+        state.SkipWithError("getcon() failed");
+        return;
+    }
+
+    auto subcontext = Subcontext({"path"}, context);
+    free(context);
+
+    auto commands = std::vector<std::vector<std::string>>(
+            state.range(0), std::vector<std::string>{"return_success"});
+    while (state.KeepRunning()) {
+        subcontext.ExecuteBatch(commands);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+
+    if (subcontext.pid() > 0) {
+        kill(subcontext.pid(), SIGTERM);
+        kill(subcontext.pid(), SIGKILL);
+    }
+}
+
+BENCHMARK(BenchmarkBatchSuccess)->Arg(8)->Arg(32);
+
 BuiltinFunctionMap BuildTestFunctionMap() {
     auto function = [](const BuiltinArguments& args) { return Result<void>{}; };
     BuiltinFunctionMap test_function_map = {
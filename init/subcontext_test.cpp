@@ -148,6 +148,56 @@ TEST(subcontext, TriggerShutdown) {
     EXPECT_EQ(kTestShutdownCommand, trigger_shutdown_command);
 }
 
+TEST(subcontext, ExecuteBatch) {
+    RunTest([](auto& subcontext) {
+        auto commands = std::vector<std::vector<std::string>>{
+                {"add_word", "batched"},
+                {"add_word", "words"},
+                {"return_words_as_error"},
+                {"generate_sane_error"},
+                {"unknown_command"},
+        };
+        auto results = subcontext.ExecuteBatch(commands);
+        ASSERT_RESULT_OK(results);
+        ASSERT_EQ(commands.size(), results->size());
+        EXPECT_RESULT_OK((*results)[0].result);
+        EXPECT_RESULT_OK((*results)[1].result);
+        ASSERT_FALSE((*results)[2].result.ok());
+        EXPECT_EQ("batched words", (*results)[2].result.error().message());
+        ASSERT_FALSE((*results)[3].result.ok());
+        EXPECT_EQ("Sane error!", (*results)[3].result.error().message());
+        EXPECT_FALSE((*results)[4].result.ok());
+    });
+}
+
+TEST(subcontext, ExecuteBatchStopsAtShutdown) {
+    static std::string trigger_shutdown_command;
+    trigger_shutdown = [](const std::string& command) { trigger_shutdown_command = command; };
+    RunTest([](auto& subcontext) {
+        auto commands = std::vector<std::vector<std::string>>{
+                {"add_word", "before"},
+                {"trigger_shutdown", "reboot,test-batch"},
+                {"add_word", "after"},
+        };
+        auto results = subcontext.ExecuteBatch(commands);
+        ASSERT_RESULT_OK(results);
+        ASSERT_EQ(2U, results->size());
+        EXPECT_RESULT_OK((*results)[1].result);
+    });
+    EXPECT_EQ("reboot,test-batch", trigger_shutdown_command);
+}
+
+TEST(subcontext, ExecuteBatchSplitsLongBatches) {
+    RunTest([](auto& subcontext) {
+        auto commands = std::vector<std::vector<std::string>>(
+                8, std::vector<std::string>{"add_word", std::string(1024, 'w')});
+        auto results = subcontext.ExecuteBatch(commands);
+        ASSERT_RESULT_OK(results);
+        EXPECT_LT(0U, results->size());
+        EXPECT_GT(commands.size(), results->size());
+    });
+}
+
 TEST(subcontext, ExpandArgs) {
     RunTest([](auto& subcontext) {
         auto args = std::vector<std::string>{
@@ -21,15 +21,23 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <charconv>
 #include <memory>
 
 #include <android-base/logging.h>
 #include <cutils/uevent.h>
+#include <cutils/uevent_view.h>
 
 namespace android {
 namespace init {
 
-static void ParseEvent(const char* msg, Uevent* uevent) {
+static int ParseUeventInt(std::string_view value) {
+    int result = 0;
+    std::from_chars(value.data(), value.data() + value.size(), result);
+    return result;
+}
+
+static void ParseEvent(const char* msg, size_t length, Uevent* uevent) {
     uevent->partition_num = -1;
     uevent->major = -1;
     uevent->minor = -1;
@@ -41,42 +49,28 @@ static void ParseEvent(const char* msg, Uevent* uevent) {
     uevent->device_name.clear();
     uevent->modalias.clear();
     // currently ignoring SEQNUM
-    while (*msg) {
-        if (!strncmp(msg, "ACTION=", 7)) {
-            msg += 7;
-            uevent->action = msg;
-        } else if (!strncmp(msg, "DEVPATH=", 8)) {
-            msg += 8;
-            uevent->path = msg;
-        } else if (!strncmp(msg, "SUBSYSTEM=", 10)) {
-            msg += 10;
-            uevent->subsystem = msg;
-        } else if (!strncmp(msg, "FIRMWARE=", 9)) {
-            msg += 9;
-            uevent->firmware = msg;
-        } else if (!strncmp(msg, "MAJOR=", 6)) {
-            msg += 6;
-            uevent->major = atoi(msg);
-        } else if (!strncmp(msg, "MINOR=", 6)) {
-            msg += 6;
-            uevent->minor = atoi(msg);
-        } else if (!strncmp(msg, "PARTN=", 6)) {
-            msg += 6;
-            uevent->partition_num = atoi(msg);
-        } else if (!strncmp(msg, "PARTNAME=", 9)) {
-            msg += 9;
-            uevent->partition_name = msg;
-        } else if (!strncmp(msg, "DEVNAME=", 8)) {
-            msg += 8;
-            uevent->device_name = msg;
-        } else if (!strncmp(msg, "MODALIAS=", 9)) {
-            msg += 9;
-            uevent->modalias = msg;
+    for (const auto& [key, value] : UeventView(msg, length)) {
+        if (key == "ACTION") {
+            uevent->action = value;
+        } else if (key == "DEVPATH") {
+            uevent->path = value;
+        } else if (key == "SUBSYSTEM") {
+            uevent->subsystem = value;
+        } else if (key == "FIRMWARE") {
+            uevent->firmware = value;
+        } else if (key == "MAJOR") {
+            uevent->major = ParseUeventInt(value);
+        } else if (key == "MINOR") {
+            uevent->minor = ParseUeventInt(value);
+        } else if (key == "PARTN") {
+            uevent->partition_num = ParseUeventInt(value);
+        } else if (key == "PARTNAME") {
+            uevent->partition_name = value;
+        } else if (key == "DEVNAME") {
+            uevent->device_name = value;
+        } else if (key == "MODALIAS") {
+            uevent->modalias = value;
         }
-
-        // advance to after the next \0
-        while (*msg++)
-            ;
     }
 
     if (LOG_UEVENTS) {
@@ -86,25 +80,65 @@ static void ParseEvent(const char* msg, Uevent* uevent) {
     }
 }
 
-UeventListener::UeventListener(size_t uevent_socket_rcvbuf_size) {
+UeventListener::UeventListener(size_t uevent_socket_rcvbuf_size) : batch_(new Batch) {
     device_fd_.reset(uevent_open_socket(uevent_socket_rcvbuf_size, true));
     if (device_fd_ == -1) {
         LOG(FATAL) << "Could not open uevent socket";
     }
 
     fcntl(device_fd_.get(), F_SETFL, O_NONBLOCK);
+
+    batch_->buffers.reset(new char[UEVENT_BATCH_SIZE * (UEVENT_MSG_LEN + 2)]);
 }
 
-ReadUeventResult UeventListener::ReadUevent(Uevent* uevent) const {
-    char msg[UEVENT_MSG_LEN + 2];
-    int n = uevent_kernel_multicast_recv(device_fd_.get(), msg, UEVENT_MSG_LEN);
+// Refills the batch with as many pending uevents as one recvmmsg() returns.
+bool UeventListener::ReceiveBatch() const {
+    Batch& b = *batch_;
+    for (unsigned int i = 0; i < UEVENT_BATCH_SIZE; i++) {
+        b.iovecs[i] = {b.buffers.get() + i * (UEVENT_MSG_LEN + 2), UEVENT_MSG_LEN};
+        b.headers[i].msg_hdr = {
+                .msg_name = &b.addrs[i],
+                .msg_namelen = sizeof(b.addrs[i]),
+                .msg_iov = &b.iovecs[i],
+                .msg_iovlen = 1,
+                .msg_control = b.controls[i],
+                .msg_controllen = sizeof(b.controls[i]),
+        };
+        b.headers[i].msg_len = 0;
+    }
+
+    int n = TEMP_FAILURE_RETRY(recvmmsg(device_fd_.get(), b.headers, UEVENT_BATCH_SIZE, 0, nullptr));
     if (n <= 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
             PLOG(ERROR) << "Error reading from Uevent Fd";
         }
+        b.count = b.next = 0;
+        return false;
+    }
+    b.count = n;
+    b.next = 0;
+    return true;
+}
+
+ReadUeventResult UeventListener::ReadUevent(Uevent* uevent) const {
+    Batch& b = *batch_;
+    if (b.next == b.count && !ReceiveBatch()) {
         return ReadUeventResult::kFailed;
     }
-    if (n >= UEVENT_MSG_LEN) {
+
+    unsigned int i = b.next++;
+    msghdr& hdr = b.headers[i].msg_hdr;
+    size_t n = b.headers[i].msg_len;
+    char* msg = static_cast<char*>(b.iovecs[i].iov_base);
+
+    // Same checks as uevent_kernel_multicast_recv(): only accept multicast
+    // messages that carry credentials and originate from the kernel.
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    if (cmsg == nullptr || cmsg->cmsg_type != SCM_CREDENTIALS || b.addrs[i].nl_pid != 0 ||
+        b.addrs[i].nl_groups == 0) {
+        return ReadUeventResult::kInvalid;
+    }
+    if (n >= UEVENT_MSG_LEN || (hdr.msg_flags & MSG_TRUNC)) {
         LOG(ERROR) << "Uevent overflowed buffer, discarding";
         return ReadUeventResult::kInvalid;
     }
@@ -112,7 +146,7 @@ ReadUeventResult UeventListener::ReadUevent(Uevent* uevent) const {
     msg[n] = '\0';
     msg[n + 1] = '\0';
 
-    ParseEvent(msg, uevent);
+    ParseEvent(msg, n, uevent);
 
     return ReadUeventResult::kSuccess;
 }
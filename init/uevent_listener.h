@@ -19,8 +19,12 @@
 
 #include <dirent.h>
 
+#include <linux/netlink.h>
+#include <sys/socket.h>
+
 #include <chrono>
 #include <functional>
+#include <memory>
 #include <optional>
 
 #include <android-base/unique_fd.h>
@@ -29,6 +33,9 @@
 
 #define UEVENT_MSG_LEN 8192
 
+// Number of uevents pulled from the socket with one recvmmsg() call.
+#define UEVENT_BATCH_SIZE 16
+
 namespace android {
 namespace init {
 
@@ -58,8 +65,23 @@ class UeventListener {
   private:
     ReadUeventResult ReadUevent(Uevent* uevent) const;
     ListenerAction RegenerateUeventsForDir(DIR* d, const ListenerCallback& callback) const;
+    bool ReceiveBatch() const;
 
     android::base::unique_fd device_fd_;
+
+    // Messages received by the last recvmmsg() but not yet returned by
+    // ReadUevent(). They are kept across calls so that a callback returning
+    // kStop never loses the rest of a batch.
+    struct Batch {
+        std::unique_ptr<char[]> buffers;
+        mmsghdr headers[UEVENT_BATCH_SIZE];
+        iovec iovecs[UEVENT_BATCH_SIZE];
+        sockaddr_nl addrs[UEVENT_BATCH_SIZE];
+        char controls[UEVENT_BATCH_SIZE][CMSG_SPACE(sizeof(ucred))];
+        unsigned int count = 0;
+        unsigned int next = 0;
+    };
+    std::unique_ptr<Batch> batch_;
 };
 
 }  // namespace init
@@ -24,10 +24,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <set>
 #include <thread>
 
@@ -88,13 +91,16 @@
 // 1) ueventd regenerates uevents by doing the /sys traversal and listens to the netlink socket for
 //    the generated uevents.  It writes these uevents into a queue represented by a vector.
 //
-// 2) ueventd forks 'n' separate uevent handler subprocesses and has each of them to handle the
-//    uevents in the queue based on a starting offset (their process number) and a stride (the total
-//    number of processes).  Note that no IPC happens at this point and only const functions from
-//    DeviceHandler should be called from this context.
+// 2) ueventd forks 'n' separate uevent handler subprocesses.  Each of them repeatedly claims the
+//    next chunk of the queue from a counter in a shared anonymous mapping and handles it, so that a
+//    subprocess that happens to get slow uevents does not leave the others idle.  Apart from that
+//    counter no IPC happens at this point, and only const functions from DeviceHandler should be
+//    called from this context.
 //
 // 3) In parallel to the subprocesses handling the uevents, the main thread of ueventd calls
-//    selinux_android_restorecon() recursively on /sys/class, /sys/block, and /sys/devices.
+//    selinux_android_restorecon() recursively on /sys.  With parallel_restorecon enabled, the
+//    entries of the configured directories are instead put in a second queue, which the
+//    subprocesses claim from once they run out of uevents, and which the main thread works on too.
 //
 // 4) Once the restorecon operation finishes, the main thread calls waitpid() to wait for all
 //    subprocess handlers to complete and exit.  Once this happens, it marks coldboot as having
@@ -126,11 +132,17 @@ class ColdBoot {
     void Run();
 
   private:
-    void UeventHandlerMain(unsigned int process_num, unsigned int total_processes);
+    // Shared with the subprocesses, which claim work by bumping these.
+    struct WorkQueue {
+        std::atomic<size_t> next_uevent;
+        std::atomic<size_t> next_restorecon;
+    };
+
+    void UeventHandlerMain();
     void RegenerateUevents();
     void ForkSubProcesses();
     void WaitForSubProcesses();
-    void RestoreConHandler(unsigned int process_num, unsigned int total_processes);
+    void RestoreConHandler(unsigned int process_num);
     void GenerateRestoreCon(const std::string& directory);
 
     UeventListener& uevent_listener_;
@@ -146,22 +158,36 @@ class ColdBoot {
     std::vector<std::string> restorecon_queue_;
 
     std::vector<std::string> parallel_restorecon_queue_;
+
+    WorkQueue* work_queue_ = nullptr;
 };
 
-void ColdBoot::UeventHandlerMain(unsigned int process_num, unsigned int total_processes) {
-    for (unsigned int i = process_num; i < uevent_queue_.size(); i += total_processes) {
-        auto& uevent = uevent_queue_[i];
+// Large enough to keep the shared counter from being contended, small enough that the subprocesses
+// finish at about the same time.
+static constexpr size_t kUeventChunkSize = 16;
 
-        for (auto& uevent_handler : uevent_handlers_) {
-            uevent_handler->HandleUevent(uevent);
+void ColdBoot::UeventHandlerMain() {
+    while (true) {
+        size_t begin = work_queue_->next_uevent.fetch_add(kUeventChunkSize);
+        if (begin >= uevent_queue_.size()) {
+            break;
+        }
+        size_t end = std::min(begin + kUeventChunkSize, uevent_queue_.size());
+        for (size_t i = begin; i < end; ++i) {
+            auto& uevent = uevent_queue_[i];
+
+            for (auto& uevent_handler : uevent_handlers_) {
+                uevent_handler->HandleUevent(uevent);
+            }
         }
     }
 }
 
-void ColdBoot::RestoreConHandler(unsigned int process_num, unsigned int total_processes) {
+void ColdBoot::RestoreConHandler(unsigned int process_num) {
     android::base::Timer t_process;
 
-    for (unsigned int i = process_num; i < restorecon_queue_.size(); i += total_processes) {
+    size_t i;
+    while ((i = work_queue_->next_restorecon.fetch_add(1)) < restorecon_queue_.size()) {
         android::base::Timer t;
         auto& dir = restorecon_queue_[i];
 
@@ -192,17 +218,14 @@ void ColdBoot::GenerateRestoreCon(const std::string& directory) {
     while ((dent = readdir(dir.get())) != NULL) {
         if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0) continue;
 
-        struct stat st;
-        if (fstatat(dirfd(dir.get()), dent->d_name, &st, 0) == -1) continue;
-
-        if (S_ISDIR(st.st_mode)) {
-            std::string fullpath = directory + "/" + dent->d_name;
-            auto parallel_restorecon =
-                std::find(parallel_restorecon_queue_.begin(),
-                    parallel_restorecon_queue_.end(), fullpath);
-            if (parallel_restorecon == parallel_restorecon_queue_.end()) {
-                restorecon_queue_.emplace_back(fullpath);
-            }
+        // Files are queued as well as directories, so that everything below |directory| is
+        // relabeled, as it would be by a recursive restorecon of it.
+        std::string fullpath = directory + "/" + dent->d_name;
+        auto parallel_restorecon =
+            std::find(parallel_restorecon_queue_.begin(),
+                parallel_restorecon_queue_.end(), fullpath);
+        if (parallel_restorecon == parallel_restorecon_queue_.end()) {
+            restorecon_queue_.emplace_back(fullpath);
         }
     }
 }
@@ -222,9 +245,9 @@ void ColdBoot::ForkSubProcesses() {
         }
 
         if (pid == 0) {
-            UeventHandlerMain(i, num_handler_subprocesses_);
+            UeventHandlerMain();
             if (enable_parallel_restorecon_) {
-                RestoreConHandler(i, num_handler_subprocesses_);
+                RestoreConHandler(i);
             }
             _exit(EXIT_SUCCESS);
         }
@@ -284,14 +307,26 @@ void ColdBoot::Run() {
         }
     }
 
+    void* work_queue = mmap(nullptr, sizeof(WorkQueue), PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (work_queue == MAP_FAILED) {
+        PLOG(FATAL) << "Could not map the cold boot work queue";
+    }
+    work_queue_ = new (work_queue) WorkQueue{};
+
     ForkSubProcesses();
 
-    if (!enable_parallel_restorecon_) {
+    if (enable_parallel_restorecon_) {
+        RestoreConHandler(num_handler_subprocesses_);
+    } else {
         selinux_android_restorecon("/sys", SELINUX_ANDROID_RESTORECON_RECURSE);
     }
 
     WaitForSubProcesses();
 
+    munmap(work_queue_, sizeof(WorkQueue));
+    work_queue_ = nullptr;
+
     android::base::SetProperty(kColdBootDoneProp, "true");
     LOG(INFO) << "Coldboot took " << cold_boot_timer.duration().count() / 1000.0f << " seconds";
 }
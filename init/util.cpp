@@ -36,6 +36,7 @@
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/scopeguard.h>
 #include <android-base/strings.h>
@@ -560,8 +561,7 @@ Result<MountAllOptions> ParseMountAll(const std::vector<std::string>& args) {
     return MountAllOptions{rc_paths, fstab_path, mode, import_rc};
 }
 
-Result<std::pair<int, std::vector<std::string>>> ParseRestorecon(
-        const std::vector<std::string>& args) {
+Result<RestoreconOptions> ParseRestorecon(const std::vector<std::string>& args) {
     struct flag_type {
         const char* name;
         int value;
@@ -574,8 +574,11 @@ Result<std::pair<int, std::vector<std::string>>> ParseRestorecon(
             {"--data-data", SELINUX_ANDROID_RESTORECON_DATADATA},
             {0, 0}};
 
+    constexpr size_t kMaxRestoreconJobs = 16;
+
     int flag = 0;
     std::vector<std::string> paths;
+    size_t jobs = 1;
 
     bool in_flags = true;
     for (size_t i = 1; i < args.size(); ++i) {
@@ -583,6 +586,13 @@ Result<std::pair<int, std::vector<std::string>>> ParseRestorecon(
             if (!in_flags) {
                 return Error() << "flags must precede paths";
             }
+            if (android::base::StartsWith(args[i], "--jobs=")) {
+                auto count = args[i].substr(strlen("--jobs="));
+                if (!android::base::ParseUint(count, &jobs, kMaxRestoreconJobs) || jobs == 0) {
+                    return Error() << "bad job count " << args[i];
+                }
+                continue;
+            }
             bool found = false;
             for (size_t j = 0; flags[j].name; ++j) {
                 if (args[i] == flags[j].name) {
@@ -599,7 +609,7 @@ Result<std::pair<int, std::vector<std::string>>> ParseRestorecon(
             paths.emplace_back(args[i]);
         }
     }
-    return std::pair(flag, paths);
+    return RestoreconOptions{flag, paths, jobs};
 }
 
 Result<std::string> ParseSwaponAll(const std::vector<std::string>& args) {
@@ -86,8 +86,14 @@ struct MountAllOptions {
 
 Result<MountAllOptions> ParseMountAll(const std::vector<std::string>& args);
 
-Result<std::pair<int, std::vector<std::string>>> ParseRestorecon(
-        const std::vector<std::string>& args);
+struct RestoreconOptions {
+    int flags;
+    std::vector<std::string> paths;
+    // Worker threads for recursive relabeling, from --jobs=<n>.
+    size_t jobs;
+};
+
+Result<RestoreconOptions> ParseRestorecon(const std::vector<std::string>& args);
 
 Result<std::string> ParseSwaponAll(const std::vector<std::string>& args);
 
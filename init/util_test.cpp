@@ -23,6 +23,7 @@
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
 #include <gtest/gtest.h>
+#include <selinux/android.h>
 
 using namespace std::literals::string_literals;
 
@@ -183,5 +184,21 @@ TEST(util, CleanDirPath) {
     EXPECT_EQ("/foo/bar", CleanDirPath("//foo//bar"));
 }
 
+TEST(util, ParseRestoreconJobs) {
+    auto options = ParseRestorecon({"restorecon", "--recursive", "--jobs=4", "/data/foo"});
+    ASSERT_RESULT_OK(options);
+    EXPECT_EQ(SELINUX_ANDROID_RESTORECON_RECURSE, options->flags);
+    EXPECT_EQ(4U, options->jobs);
+    EXPECT_EQ(std::vector<std::string>{"/data/foo"}, options->paths);
+
+    options = ParseRestorecon({"restorecon", "/data/foo"});
+    ASSERT_RESULT_OK(options);
+    EXPECT_EQ(1U, options->jobs);
+
+    EXPECT_FALSE(ParseRestorecon({"restorecon", "--jobs=0", "/data/foo"}).ok());
+    EXPECT_FALSE(ParseRestorecon({"restorecon", "--jobs=100", "/data/foo"}).ok());
+    EXPECT_FALSE(ParseRestorecon({"restorecon", "/data/foo", "--jobs=2"}).ok());
+}
+
 }  // namespace init
 }  // namespace android
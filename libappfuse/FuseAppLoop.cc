@@ -86,10 +86,6 @@ bool HandleWrite(FuseAppLoop* loop, FuseBuffer* buffer, FuseAppLoopCallback* cal
 }
 
 bool HandleMessage(FuseAppLoop* loop, FuseBuffer* buffer, int fd, FuseAppLoopCallback* callback) {
-    if (!buffer->request.Read(fd)) {
-        return false;
-    }
-
     const uint32_t opcode = buffer->request.header.opcode;
     LOG(VERBOSE) << "Read a fuse packet, opcode=" << opcode;
     switch (opcode) {
@@ -134,13 +130,59 @@ FuseAppLoopCallback::~FuseAppLoopCallback() = default;
 FuseAppLoop::FuseAppLoop(base::unique_fd&& fd) : fd_(std::move(fd)) {}
 
 void FuseAppLoop::Break() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        broken_ = true;
+    }
+    buffer_returned_.notify_all();
+
     const int64_t value = 1;
     if (write(break_fd_, &value, sizeof(value)) == -1) {
         PLOG(ERROR) << "Failed to send a break event";
     }
 }
 
+std::unique_ptr<FuseBuffer> FuseAppLoop::AcquireBuffer() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    buffer_returned_.wait(lock, [this] {
+        return broken_ || !free_buffers_.empty() || buffer_count_ < kMaxBuffers;
+    });
+    if (broken_) {
+        return nullptr;
+    }
+    if (free_buffers_.empty()) {
+        buffer_count_++;
+        return std::make_unique<FuseBuffer>();
+    }
+    std::unique_ptr<FuseBuffer> buffer = std::move(free_buffers_.back());
+    free_buffers_.pop_back();
+    return buffer;
+}
+
+void FuseAppLoop::ReleaseBuffer(std::unique_ptr<FuseBuffer> buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_buffers_.push_back(std::move(buffer));
+    }
+    buffer_returned_.notify_one();
+}
+
+void FuseAppLoop::FinishRequest(uint64_t unique) {
+    std::unique_ptr<FuseBuffer> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = in_flight_writes_.find(unique);
+        if (it == in_flight_writes_.end()) {
+            return;
+        }
+        buffer = std::move(it->second);
+        in_flight_writes_.erase(it);
+    }
+    ReleaseBuffer(std::move(buffer));
+}
+
 bool FuseAppLoop::ReplySimple(uint64_t unique, int32_t result) {
+    FinishRequest(unique);
     if (result == -ENOSYS) {
         // We should not return -ENOSYS because the kernel stops delivering FUSE
         // command after receiving -ENOSYS as a result for the command.
@@ -183,6 +225,7 @@ bool FuseAppLoop::ReplyOpen(uint64_t unique, uint64_t fh) {
 
 bool FuseAppLoop::ReplyWrite(uint64_t unique, uint32_t size) {
     CHECK(size <= kFuseMaxWrite);
+    FinishRequest(unique);
     FuseSimpleResponse response;
     response.Reset(sizeof(fuse_write_out), kFuseSuccess, unique);
     response.write_out.size = size;
@@ -197,6 +240,11 @@ bool FuseAppLoop::ReplyRead(uint64_t unique, uint32_t size, const void* data) {
 }
 
 void FuseAppLoop::Start(FuseAppLoopCallback* callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        broken_ = false;
+    }
+
     break_fd_.reset(eventfd(/* initval */ 0, EFD_CLOEXEC));
     if (break_fd_.get() == -1) {
         PLOG(ERROR) << "Failed to open FD for break event";
@@ -223,7 +271,6 @@ void FuseAppLoop::Start(FuseAppLoopCallback* callback) {
     last_event = 0;
     break_event = 0;
 
-    FuseBuffer buffer;
     while (true) {
         if (!epoll_controller->Wait(1)) {
             break;
@@ -236,7 +283,31 @@ void FuseAppLoop::Start(FuseAppLoopCallback* callback) {
             break;
         }
 
-        if (!HandleMessage(this, &buffer, fd_, callback)) {
+        // Wait for a free buffer before reading, so that the number of writes
+        // held by the callback stays bounded.
+        std::unique_ptr<FuseBuffer> buffer = AcquireBuffer();
+        if (!buffer) {
+            break;
+        }
+        if (!buffer->request.Read(fd_)) {
+            ReleaseBuffer(std::move(buffer));
+            break;
+        }
+
+        // The callback may reply to FUSE_WRITE from another thread, so the
+        // buffer holding the data is kept until the reply for |unique| is sent.
+        FuseBuffer* const current = buffer.get();
+        if (current->request.header.opcode == FUSE_WRITE &&
+            current->request.write_in.size <= kFuseMaxWrite) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            in_flight_writes_[current->request.header.unique] = std::move(buffer);
+        }
+
+        const bool result = HandleMessage(this, current, fd_, callback);
+        if (buffer) {
+            ReleaseBuffer(std::move(buffer));
+        }
+        if (!result) {
             break;
         }
     }
@@ -32,6 +32,10 @@ namespace {
 
 enum class FuseBridgeState { kWaitToReadEither, kWaitToReadProxy, kWaitToWriteProxy, kClosing };
 
+// Upper bound of proxy replies forwarded per epoll event, so that a busy mount does not starve
+// the others sharing the loop.
+constexpr int kMaxRepliesPerTransfer = 16;
+
 struct FuseBridgeEntryEvent {
     FuseBridgeEntry* entry;
     int events;
@@ -104,7 +108,16 @@ class FuseBridgeEntry {
             case FuseBridgeState::kWaitToReadEither:
                 if (proxy_read_ready) {
                     state_ = ReadFromProxy();
-                } else if (device_read_ready) {
+                    // Replies that are already queued on the proxy socket are forwarded now
+                    // rather than costing an epoll round trip each.
+                    bool again = false;
+                    for (int i = 1; i < kMaxRepliesPerTransfer && !again &&
+                                    state_ == FuseBridgeState::kWaitToReadEither;
+                         i++) {
+                        state_ = ReadFromProxy(&again);
+                    }
+                }
+                if (device_read_ready && state_ == FuseBridgeState::kWaitToReadEither) {
                     state_ = ReadFromDevice(callback);
                 }
                 return;
@@ -131,13 +144,19 @@ class FuseBridgeEntry {
   private:
     friend class BridgeEpollController;
 
-    FuseBridgeState ReadFromProxy() {
+    // If |again| is given, the proxy is not known to be readable and running out of replies
+    // is reported through it instead of waiting on the proxy alone.
+    FuseBridgeState ReadFromProxy(bool* again = nullptr) {
         switch (buffer_.response.ReadOrAgain(proxy_fd_)) {
             case ResultOrAgain::kSuccess:
                 break;
             case ResultOrAgain::kFailure:
                 return FuseBridgeState::kClosing;
             case ResultOrAgain::kAgain:
+                if (again) {
+                    *again = true;
+                    return FuseBridgeState::kWaitToReadEither;
+                }
                 return FuseBridgeState::kWaitToReadProxy;
         }
 
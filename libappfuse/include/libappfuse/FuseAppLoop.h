@@ -17,8 +17,11 @@
 #ifndef ANDROID_LIBAPPFUSE_FUSEAPPLOOP_H_
 #define ANDROID_LIBAPPFUSE_FUSEAPPLOOP_H_
 
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 
@@ -34,6 +37,8 @@ class FuseAppLoopCallback {
    virtual void OnLookup(uint64_t unique, uint64_t inode) = 0;
    virtual void OnGetAttr(uint64_t unique, uint64_t inode) = 0;
    virtual void OnFsync(uint64_t unique, uint64_t inode) = 0;
+   // |data| stays valid until ReplyWrite() or ReplySimple() is called for
+   // |unique|, which may happen from another thread after OnWrite returns.
    virtual void OnWrite(uint64_t unique, uint64_t inode, uint64_t offset, uint32_t size,
                         const void* data) = 0;
    virtual void OnRead(uint64_t unique, uint64_t inode, uint64_t offset, uint32_t size) = 0;
@@ -57,11 +62,26 @@ class FuseAppLoop final {
     bool ReplyRead(uint64_t unique, uint32_t size, const void* data);
 
   private:
+    // Maximum number of FUSE_WRITE requests whose buffers can be held by the
+    // callback at once. The loop stops reading new requests when all of them
+    // are in flight.
+    static constexpr size_t kMaxBuffers = 4;
+
+    std::unique_ptr<FuseBuffer> AcquireBuffer();
+    void ReleaseBuffer(std::unique_ptr<FuseBuffer> buffer);
+    void FinishRequest(uint64_t unique);
+
     base::unique_fd fd_;
     base::unique_fd break_fd_;
 
-    // Lock for multi-threading.
+    // Lock for the buffer pool, which is shared between the loop thread and
+    // threads replying to requests.
     std::mutex mutex_;
+    std::condition_variable buffer_returned_;
+    std::vector<std::unique_ptr<FuseBuffer>> free_buffers_;
+    std::unordered_map<uint64_t, std::unique_ptr<FuseBuffer>> in_flight_writes_;
+    size_t buffer_count_ = 0;
+    bool broken_ = false;
 };
 
 bool StartFuseAppLoop(int fd, FuseAppLoopCallback* callback);
@@ -21,6 +21,8 @@
 #include <android-base/logging.h>
 #include <android-base/unique_fd.h>
 #include <gtest/gtest.h>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
 #include "libappfuse/EpollController.h"
@@ -37,11 +39,23 @@ struct CallbackRequest {
   uint64_t inode;
 };
 
+struct DeferredWrite {
+  uint64_t unique;
+  uint32_t size;
+  const void* data;
+};
+
 class Callback : public FuseAppLoopCallback {
  public:
   std::vector<CallbackRequest> requests;
   FuseAppLoop* loop;
 
+  // When set, OnWrite records the request instead of replying to it.
+  bool defer_writes = false;
+  std::mutex deferred_mutex;
+  std::condition_variable deferred_cv;
+  std::vector<DeferredWrite> deferred_writes;
+
   void OnGetAttr(uint64_t seq, uint64_t inode) override {
       EXPECT_NE(FUSE_ROOT_ID, static_cast<int>(inode));
       EXPECT_TRUE(loop->ReplyGetAttr(seq, inode, kTestFileSize, S_IFREG | 0777));
@@ -58,8 +72,14 @@ class Callback : public FuseAppLoopCallback {
   }
 
   void OnWrite(uint64_t seq, uint64_t inode, uint64_t offset ATTRIBUTE_UNUSED,
-               uint32_t size ATTRIBUTE_UNUSED, const void* data ATTRIBUTE_UNUSED) override {
+               uint32_t size, const void* data) override {
       requests.push_back({.code = FUSE_WRITE, .inode = inode});
+      if (defer_writes) {
+          std::lock_guard<std::mutex> lock(deferred_mutex);
+          deferred_writes.push_back({.unique = seq, .size = size, .data = data});
+          deferred_cv.notify_all();
+          return;
+      }
       loop->ReplyWrite(seq, 0);
   }
 
@@ -282,6 +302,50 @@ TEST_F(FuseAppLoopTest, Write) {
   CheckCallback(sizeof(fuse_write_in), FUSE_WRITE, sizeof(fuse_write_out));
 }
 
+TEST_F(FuseAppLoopTest, DeferredWrites) {
+  callback_.defer_writes = true;
+
+  constexpr uint32_t kWriteSize = 16;
+  for (uint64_t unique = 1; unique <= 2; unique++) {
+    request_.Reset(sizeof(fuse_write_in) + kWriteSize, FUSE_WRITE, unique);
+    request_.header.nodeid = 10;
+    request_.write_in.size = kWriteSize;
+    memset(request_.write_data, 'a' + unique, kWriteSize);
+    ASSERT_TRUE(request_.Write(sockets_[0]));
+  }
+
+  std::vector<DeferredWrite> writes;
+  {
+    std::unique_lock<std::mutex> lock(callback_.deferred_mutex);
+    callback_.deferred_cv.wait(
+        lock, [this] { return callback_.deferred_writes.size() == 2u; });
+    writes = callback_.deferred_writes;
+  }
+
+  // Both requests are in flight, and each still has its own data.
+  for (const DeferredWrite& write : writes) {
+    ASSERT_EQ(kWriteSize, write.size);
+    const char* data = static_cast<const char*>(write.data);
+    for (uint32_t i = 0; i < kWriteSize; i++) {
+      EXPECT_EQ(static_cast<char>('a' + write.unique), data[i]);
+    }
+  }
+
+  // Reply out of order from a thread other than the loop.
+  EXPECT_TRUE(loop_->ReplyWrite(writes[1].unique, kWriteSize));
+  EXPECT_TRUE(loop_->ReplyWrite(writes[0].unique, kWriteSize));
+
+  ASSERT_TRUE(response_.Read(sockets_[0]));
+  EXPECT_EQ(kFuseSuccess, response_.header.error);
+  EXPECT_EQ(2u, response_.header.unique);
+  EXPECT_EQ(kWriteSize, response_.write_out.size);
+
+  ASSERT_TRUE(response_.Read(sockets_[0]));
+  EXPECT_EQ(kFuseSuccess, response_.header.error);
+  EXPECT_EQ(1u, response_.header.unique);
+  EXPECT_EQ(kWriteSize, response_.write_out.size);
+}
+
 TEST_F(FuseAppLoopTest, Break) {
     // Ensure that the loop started.
     request_.Reset(sizeof(fuse_open_in), FUSE_OPEN, 1);
@@ -210,5 +210,41 @@ TEST_F(FuseBridgeLoopTest, Proxy) {
   Close();
 }
 
+TEST_F(FuseBridgeLoopTest, ProxyQueuedReplies) {
+  constexpr uint64_t kRequestCount = 4;
+  for (uint64_t unique = 1; unique <= kRequestCount; unique++) {
+    memset(&request_, 0, sizeof(FuseRequest));
+    request_.header.opcode = FUSE_GETATTR;
+    request_.header.unique = unique;
+    request_.header.len = sizeof(fuse_in_header);
+    ASSERT_TRUE(request_.Write(dev_sockets_[0]));
+
+    memset(&request_, 0, sizeof(FuseRequest));
+    ASSERT_TRUE(request_.Read(proxy_sockets_[1]));
+    EXPECT_EQ(unique, request_.header.unique);
+  }
+
+  // Queue all replies before the loop gets to any of them.
+  for (uint64_t unique = 1; unique <= kRequestCount; unique++) {
+    memset(&response_, 0, sizeof(FuseResponse));
+    response_.header.len = sizeof(fuse_out_header);
+    response_.header.unique = unique;
+    response_.header.error = kFuseSuccess;
+    ASSERT_TRUE(response_.Write(proxy_sockets_[1]));
+  }
+
+  for (uint64_t unique = 1; unique <= kRequestCount; unique++) {
+    memset(&response_, 0, sizeof(FuseResponse));
+    ASSERT_TRUE(response_.Read(dev_sockets_[0]));
+    EXPECT_EQ(unique, response_.header.unique);
+    EXPECT_EQ(kFuseSuccess, response_.header.error);
+  }
+
+  // The loop still serves the device afterwards.
+  CheckProxy(FUSE_OPEN);
+  CheckProxy(FUSE_RELEASE);
+  Close();
+}
+
 }  // namespace fuse
 }  // namespace android
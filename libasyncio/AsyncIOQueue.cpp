@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <asyncio/AsyncIOQueue.h>
+
+#include <asyncio/AsyncIO.h>
+#include <errno.h>
+#include <liburing.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace android {
+
+namespace {
+
+class AioQueue : public AsyncIOQueue {
+  public:
+    ~AioQueue() override {
+        if (ctx_) io_destroy(ctx_);
+    }
+
+    bool Init(unsigned int depth) {
+        if (io_setup(depth, &ctx_) < 0) return false;
+        iocbs_.resize(depth);
+        free_.reserve(depth);
+        for (unsigned int i = depth; i > 0; i--) free_.push_back(&iocbs_[i - 1]);
+        events_.resize(depth);
+        return true;
+    }
+
+    Backend backend() const override { return Backend::kAio; }
+
+    bool PrepRead(int fd, void* buf, size_t len, off64_t offset, uint64_t user_data) override {
+        return Prep(fd, buf, len, offset, user_data, true);
+    }
+
+    bool PrepWrite(int fd, const void* buf, size_t len, off64_t offset,
+                   uint64_t user_data) override {
+        return Prep(fd, buf, len, offset, user_data, false);
+    }
+
+    int Submit() override {
+        int submitted = 0;
+        while (!pending_.empty()) {
+            int rc = io_submit(ctx_, pending_.size(), pending_.data());
+            if (rc < 0) return submitted ? submitted : -errno;
+            // io_submit() may accept only a prefix of the batch.
+            pending_.erase(pending_.begin(), pending_.begin() + rc);
+            submitted += rc;
+            if (rc == 0) break;
+        }
+        return submitted;
+    }
+
+    int Wait(Completion* out, size_t min, size_t max) override {
+        max = std::min(max, events_.size());
+        int rc;
+        do {
+            rc = io_getevents(ctx_, std::min(min, max), max, events_.data(), nullptr);
+        } while (rc < 0 && errno == EINTR);
+        if (rc < 0) return -errno;
+        for (int i = 0; i < rc; i++) {
+            iocb* cb = reinterpret_cast<iocb*>(events_[i].obj);
+            out[i].user_data = cb->aio_data;
+            out[i].result = events_[i].res;
+            free_.push_back(cb);
+        }
+        return rc;
+    }
+
+  private:
+    bool Prep(int fd, const void* buf, size_t len, off64_t offset, uint64_t user_data, bool read) {
+        if (free_.empty()) return false;
+        iocb* cb = free_.back();
+        free_.pop_back();
+        io_prep(cb, fd, buf, len, offset, read);
+        cb->aio_data = user_data;
+        pending_.push_back(cb);
+        return true;
+    }
+
+    aio_context_t ctx_ = 0;
+    std::vector<iocb> iocbs_;
+    std::vector<iocb*> free_;
+    std::vector<iocb*> pending_;
+    std::vector<io_event> events_;
+};
+
+class UringQueue : public AsyncIOQueue {
+  public:
+    ~UringQueue() override {
+        if (initialized_) io_uring_queue_exit(&ring_);
+    }
+
+    bool Init(unsigned int depth) {
+        if (io_uring_queue_init(depth, &ring_, 0) < 0) return false;
+        initialized_ = true;
+        return true;
+    }
+
+    Backend backend() const override { return Backend::kIoUring; }
+
+    bool PrepRead(int fd, void* buf, size_t len, off64_t offset, uint64_t user_data) override {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        if (!sqe) return false;
+        int index = FindBuffer(buf, len);
+        if (index >= 0) {
+            io_uring_prep_read_fixed(sqe, fd, buf, len, offset, index);
+        } else {
+            io_uring_prep_read(sqe, fd, buf, len, offset);
+        }
+        Finish(sqe, fd, user_data);
+        return true;
+    }
+
+    bool PrepWrite(int fd, const void* buf, size_t len, off64_t offset,
+                   uint64_t user_data) override {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        if (!sqe) return false;
+        int index = FindBuffer(buf, len);
+        if (index >= 0) {
+            io_uring_prep_write_fixed(sqe, fd, buf, len, offset, index);
+        } else {
+            io_uring_prep_write(sqe, fd, buf, len, offset);
+        }
+        Finish(sqe, fd, user_data);
+        return true;
+    }
+
+    int Submit() override { return io_uring_submit(&ring_); }
+
+    int Wait(Completion* out, size_t min, size_t max) override {
+        io_uring_cqe* cqe;
+        int rc = io_uring_wait_cqe_nr(&ring_, &cqe, std::min(min, max));
+        if (rc == -EAGAIN && min == 0) return 0;
+        if (rc < 0) return rc;
+
+        size_t count = 0;
+        unsigned int head;
+        io_uring_for_each_cqe(&ring_, head, cqe) {
+            if (count == max) break;
+            out[count].user_data = cqe->user_data;
+            out[count].result = cqe->res;
+            count++;
+        }
+        io_uring_cq_advance(&ring_, count);
+        return count;
+    }
+
+    bool RegisterBuffers(const struct iovec* iovecs, size_t count) override {
+        if (!buffers_.empty()) io_uring_unregister_buffers(&ring_);
+        buffers_.clear();
+        if (io_uring_register_buffers(&ring_, iovecs, count) < 0) return false;
+        buffers_.assign(iovecs, iovecs + count);
+        return true;
+    }
+
+    bool RegisterFiles(const int* fds, size_t count) override {
+        if (!files_.empty()) io_uring_unregister_files(&ring_);
+        files_.clear();
+        if (io_uring_register_files(&ring_, fds, count) < 0) return false;
+        files_.assign(fds, fds + count);
+        return true;
+    }
+
+  private:
+    int FindBuffer(const void* buf, size_t len) const {
+        auto start = reinterpret_cast<uintptr_t>(buf);
+        for (size_t i = 0; i < buffers_.size(); i++) {
+            auto base = reinterpret_cast<uintptr_t>(buffers_[i].iov_base);
+            if (start >= base && start + len <= base + buffers_[i].iov_len) return i;
+        }
+        return -1;
+    }
+
+    void Finish(io_uring_sqe* sqe, int fd, uint64_t user_data) {
+        auto it = std::find(files_.begin(), files_.end(), fd);
+        if (it != files_.end()) {
+            sqe->fd = it - files_.begin();
+            io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+        }
+        sqe->user_data = user_data;
+    }
+
+    io_uring ring_;
+    bool initialized_ = false;
+    std::vector<struct iovec> buffers_;
+    std::vector<int> files_;
+};
+
+}  // namespace
+
+std::unique_ptr<AsyncIOQueue> AsyncIOQueue::Create(unsigned int depth, bool force_aio) {
+    if (!force_aio) {
+        auto uring = std::make_unique<UringQueue>();
+        if (uring->Init(depth)) return uring;
+    }
+    auto aio = std::make_unique<AioQueue>();
+    if (aio->Init(depth)) return aio;
+    return nullptr;
+}
+
+}  // namespace android
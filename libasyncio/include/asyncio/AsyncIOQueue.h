@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <memory>
+
+namespace android {
+
+/**
+ * A queue of asynchronous file reads and writes.
+ *
+ * Requests are only handed to the kernel by Submit(), so a batch of Prep*()
+ * calls costs a single system call. Create() picks io_uring when the kernel
+ * supports it and falls back to Linux AIO (io_submit) otherwise; with AIO,
+ * only O_DIRECT IO is truly asynchronous.
+ *
+ * A queue is not thread-safe.
+ */
+class AsyncIOQueue {
+  public:
+    enum class Backend { kIoUring, kAio };
+
+    struct Completion {
+        uint64_t user_data;
+        // Bytes transferred, or a negative errno.
+        int64_t result;
+    };
+
+    // Creates a queue that can hold up to |depth| requests in flight.
+    // |force_aio| skips io_uring, for comparing the two backends.
+    static std::unique_ptr<AsyncIOQueue> Create(unsigned int depth, bool force_aio = false);
+
+    virtual ~AsyncIOQueue() = default;
+
+    virtual Backend backend() const = 0;
+
+    // Queue a read or write of |len| bytes at |offset|. |user_data| is
+    // returned in the request's Completion. Returns false if the queue is
+    // full.
+    virtual bool PrepRead(int fd, void* buf, size_t len, off64_t offset, uint64_t user_data) = 0;
+    virtual bool PrepWrite(int fd, const void* buf, size_t len, off64_t offset,
+                           uint64_t user_data) = 0;
+
+    // Hands every prepared request to the kernel. Returns the number
+    // submitted, or a negative errno.
+    virtual int Submit() = 0;
+
+    // Waits for at least |min| completions and returns up to |max| of them
+    // in |out|. Returns the number returned, or a negative errno.
+    virtual int Wait(Completion* out, size_t min, size_t max) = 0;
+
+    // Registers buffers and files with the kernel so that requests using
+    // them skip per-request page pinning and fd lookups. Requests whose
+    // buffer lies inside a registered buffer, or whose fd was registered,
+    // use them automatically. Only supported by io_uring; returns false
+    // otherwise, which callers may ignore.
+    virtual bool RegisterBuffers(const struct iovec* iovecs, size_t count) {
+        (void)iovecs;
+        (void)count;
+        return false;
+    }
+    virtual bool RegisterFiles(const int* fds, size_t count) {
+        (void)fds;
+        (void)count;
+        return false;
+    }
+};
+
+}  // namespace android
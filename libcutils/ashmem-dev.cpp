@@ -26,6 +26,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/ashmem.h>
+#include <linux/falloc.h>
 #include <linux/memfd.h>
 #include <log/log.h>
 #include <pthread.h>
@@ -39,6 +40,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <unordered_map>
+#include <vector>
+
 #include <android-base/file.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
@@ -447,3 +451,135 @@ int ashmem_get_size_region(int fd)
 
     return __ashmem_check_failure(fd, TEMP_FAILURE_RETRY(ioctl(fd, ASHMEM_GET_SIZE, NULL)));
 }
+
+/*
+ * The region pool. Size classes are one page and each power of two number of
+ * pages up to (1 << (kAshmemPoolClasses - 1)) pages. Pooled regions have had
+ * their pages dropped, so the pool only holds file descriptors.
+ */
+static constexpr size_t kAshmemPoolClasses = 9;
+static constexpr size_t kAshmemPoolMaxPerClass = 4;
+static const char kAshmemPoolName[] = "ashmem_pool";
+
+struct ashmem_pool {
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<int> regions[kAshmemPoolClasses];
+    /* The size class of each pooled region that has been handed out. */
+    std::unordered_map<int, size_t> in_use;
+    ashmem_pool_stats stats = {};
+};
+
+static ashmem_pool& get_ashmem_pool() {
+    static ashmem_pool* pool = new ashmem_pool;
+    return *pool;
+}
+
+int ashmem_pool_create_region(size_t size)
+{
+    size_t size_class = 0;
+    size_t class_size = getpagesize();
+    while (class_size < size && size_class < kAshmemPoolClasses) {
+        class_size *= 2;
+        size_class++;
+    }
+
+    ashmem_pool& pool = get_ashmem_pool();
+    if (size_class == kAshmemPoolClasses || !has_memfd_support()) {
+        int fd = ashmem_create_region(kAshmemPoolName, size);
+        if (fd >= 0) {
+            pthread_mutex_lock(&pool.lock);
+            pool.stats.created++;
+            pthread_mutex_unlock(&pool.lock);
+        }
+        return fd;
+    }
+
+    int fd = -1;
+    pthread_mutex_lock(&pool.lock);
+    if (!pool.regions[size_class].empty()) {
+        fd = pool.regions[size_class].back();
+        pool.regions[size_class].pop_back();
+        pool.in_use.emplace(fd, size_class);
+        pool.stats.reused++;
+        pool.stats.pooled_regions--;
+        pool.stats.pooled_bytes -= class_size;
+    }
+    pthread_mutex_unlock(&pool.lock);
+    if (fd >= 0) {
+        return fd;
+    }
+
+    fd = memfd_create_region(kAshmemPoolName, class_size);
+    if (fd < 0) {
+        return fd;
+    }
+    pthread_mutex_lock(&pool.lock);
+    pool.in_use.emplace(fd, size_class);
+    pool.stats.created++;
+    pthread_mutex_unlock(&pool.lock);
+    return fd;
+}
+
+void ashmem_pool_release_region(int fd)
+{
+    ashmem_pool& pool = get_ashmem_pool();
+    size_t size_class = kAshmemPoolClasses;
+    pthread_mutex_lock(&pool.lock);
+    auto it = pool.in_use.find(fd);
+    if (it != pool.in_use.end()) {
+        size_class = it->second;
+        pool.in_use.erase(it);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    /* A region that has been made read-only can't be handed out as read-write
+     * again. Punching a hole over the whole region frees its pages, and makes
+     * it read back as zeroes.
+     */
+    size_t class_size = static_cast<size_t>(getpagesize()) << size_class;
+    bool reusable = size_class < kAshmemPoolClasses &&
+                    fcntl(fd, F_GET_SEALS) == (F_SEAL_GROW | F_SEAL_SHRINK) &&
+                    fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, class_size) == 0;
+
+    pthread_mutex_lock(&pool.lock);
+    if (reusable && pool.regions[size_class].size() < kAshmemPoolMaxPerClass) {
+        pool.regions[size_class].push_back(fd);
+        pool.stats.released++;
+        pool.stats.pooled_regions++;
+        pool.stats.pooled_bytes += class_size;
+        fd = -1;
+    } else {
+        pool.stats.discarded++;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+void ashmem_pool_get_stats(struct ashmem_pool_stats* stats)
+{
+    ashmem_pool& pool = get_ashmem_pool();
+    pthread_mutex_lock(&pool.lock);
+    *stats = pool.stats;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+void ashmem_pool_trim()
+{
+    ashmem_pool& pool = get_ashmem_pool();
+    std::vector<int> fds;
+    pthread_mutex_lock(&pool.lock);
+    for (auto& regions : pool.regions) {
+        fds.insert(fds.end(), regions.begin(), regions.end());
+        regions.clear();
+    }
+    pool.stats.pooled_regions = 0;
+    pool.stats.pooled_bytes = 0;
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int fd : fds) {
+        close(fd);
+    }
+}
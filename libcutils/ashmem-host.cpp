@@ -24,6 +24,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -94,3 +95,35 @@ int ashmem_get_size_region(int fd)
 
     return buf.st_size;
 }
+
+/*
+ * There is no memfd sealing on the host to tell whether a region is still
+ * writable, so the pool never reuses regions and only keeps the counts.
+ */
+static pthread_mutex_t ashmem_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static ashmem_pool_stats ashmem_pool_counters;
+
+int ashmem_pool_create_region(size_t size) {
+    int fd = ashmem_create_region(nullptr, size);
+    if (fd != -1) {
+        pthread_mutex_lock(&ashmem_pool_lock);
+        ashmem_pool_counters.created++;
+        pthread_mutex_unlock(&ashmem_pool_lock);
+    }
+    return fd;
+}
+
+void ashmem_pool_release_region(int fd) {
+    close(fd);
+    pthread_mutex_lock(&ashmem_pool_lock);
+    ashmem_pool_counters.discarded++;
+    pthread_mutex_unlock(&ashmem_pool_lock);
+}
+
+void ashmem_pool_get_stats(struct ashmem_pool_stats* stats) {
+    pthread_mutex_lock(&ashmem_pool_lock);
+    *stats = ashmem_pool_counters;
+    pthread_mutex_unlock(&ashmem_pool_lock);
+}
+
+void ashmem_pool_trim() {}
@@ -286,3 +286,51 @@ TEST(AshmemTest, ForkMultiRegionTest) {
         EXPECT_EQ(0, munmap(region, size));
     }
 }
+
+TEST(AshmemTest, PoolTest) {
+    const size_t size = 3 * getpagesize();
+    ashmem_pool_trim();
+    ashmem_pool_stats before;
+    ashmem_pool_get_stats(&before);
+
+    int fd = ashmem_pool_create_region(size);
+    ASSERT_GE(fd, 0);
+    ASSERT_TRUE(ashmem_valid(fd));
+    const size_t region_size = ashmem_get_size_region(fd);
+    ASSERT_GE(region_size, size);
+    void* region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT_NE(MAP_FAILED, region);
+    memset(region, 0xff, region_size);
+    EXPECT_EQ(0, munmap(region, region_size));
+    ashmem_pool_release_region(fd);
+
+    ashmem_pool_stats after;
+    ashmem_pool_get_stats(&after);
+    EXPECT_EQ(before.created + 1, after.created);
+    EXPECT_EQ(before.released + before.discarded + 1, after.released + after.discarded);
+    if (after.released == before.released) {
+        // The pool doesn't reuse regions without memfd.
+        return;
+    }
+    EXPECT_EQ(1U, after.pooled_regions);
+    EXPECT_EQ(region_size, after.pooled_bytes);
+
+    // A region of the same size class comes back, writable and zeroed.
+    unique_fd reused(ashmem_pool_create_region(region_size));
+    ASSERT_GE(reused, 0);
+    ashmem_pool_get_stats(&after);
+    EXPECT_EQ(before.reused + 1, after.reused);
+    EXPECT_EQ(0U, after.pooled_regions);
+    ASSERT_EQ(region_size, static_cast<size_t>(ashmem_get_size_region(reused)));
+    std::vector<uint8_t> zeroes(region_size);
+    ASSERT_NO_FATAL_FAILURE(TestMmap(reused, region_size, PROT_READ | PROT_WRITE, &region));
+    EXPECT_EQ(0, memcmp(region, zeroes.data(), region_size));
+    EXPECT_EQ(0, munmap(region, region_size));
+
+    // Read-only regions can't be handed out again.
+    ASSERT_EQ(0, ashmem_set_prot_region(reused, PROT_READ));
+    ashmem_pool_release_region(reused.release());
+    ashmem_pool_get_stats(&after);
+    EXPECT_EQ(before.discarded + 1, after.discarded);
+    EXPECT_EQ(0U, after.pooled_regions);
+}
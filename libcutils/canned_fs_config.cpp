@@ -18,62 +18,124 @@
 #include <private/canned_fs_config.h>
 #include <private/fs_config.h>
 
+#include <android-base/mapped_file.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#include <algorithm>
-#include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using android::base::ConsumePrefix;
-using android::base::StartsWith;
-using android::base::Tokenize;
+using android::base::MappedFile;
+using android::base::unique_fd;
 
 struct Entry {
-    std::string path;
+    // Points into one of canned_files, which are kept mapped.
+    std::string_view path;
     unsigned uid;
     unsigned gid;
     unsigned mode;
     uint64_t capabilities;
 };
 
+static std::vector<std::unique_ptr<MappedFile>> canned_files;
 static std::vector<Entry> canned_data;
 
+// Open addressing index of canned_data by path, holding index + 1 or 0 for an empty slot. Its size
+// is a power of two, at least twice the number of entries.
+static std::vector<uint32_t> canned_index;
+
+static size_t canned_slot(std::string_view path) {
+    return std::hash<std::string_view>()(path) & (canned_index.size() - 1);
+}
+
+static void rebuild_canned_index() {
+    size_t size = 16;
+    while (size < canned_data.size() * 2) size *= 2;
+    canned_index.assign(size, 0);
+
+    for (size_t i = 0; i < canned_data.size(); i++) {
+        size_t slot = canned_slot(canned_data[i].path);
+        while (canned_index[slot] != 0) {
+            // There can be multiple entries for the same path. Then the one that comes the last
+            // wins. This is to allow overriding platform provided fs_config with a user provided
+            // fs_config by appending the latter to the former.
+            if (canned_data[canned_index[slot] - 1].path == canned_data[i].path) break;
+            slot = (slot + 1) & (size - 1);
+        }
+        canned_index[slot] = i + 1;
+    }
+}
+
+static std::vector<std::string_view> tokenize(std::string_view line) {
+    std::vector<std::string_view> tokens;
+    while (!line.empty()) {
+        size_t end = line.find(' ');
+        if (end != 0) tokens.push_back(line.substr(0, end));
+        if (end == std::string_view::npos) break;
+        line.remove_prefix(end + 1);
+    }
+    return tokens;
+}
+
 int load_canned_fs_config(const char* fn) {
-    std::ifstream input(fn);
-    for (std::string line; std::getline(input, line);) {
+    std::string_view data;
+    unique_fd fd(TEMP_FAILURE_RETRY(open(fn, O_RDONLY | O_CLOEXEC)));
+    struct stat st;
+    if (fd != -1 && fstat(fd.get(), &st) == 0 && st.st_size > 0) {
+        auto file = MappedFile::FromFd(fd, 0, st.st_size, PROT_READ);
+        if (file == nullptr) {
+            std::cerr << "failed to map " << fn << ": " << strerror(errno) << std::endl;
+            return -1;
+        }
+        data = std::string_view(file->data(), file->size());
+        canned_files.emplace_back(std::move(file));
+    }
+
+    while (!data.empty()) {
+        size_t eol = data.find('\n');
+        std::string_view line = data.substr(0, eol);
+        data.remove_prefix(eol == std::string_view::npos ? data.size() : eol + 1);
+
         // Historical: the root dir can be represented as a space character.
         // e.g. " 1000 1000 0755" is parsed as
         // path = " ", uid = 1000, gid = 1000, mode = 0755.
         // But at the same time, we also have accepted
         // "/ 1000 1000 0755".
-        if (StartsWith(line, " ")) {
-            line.insert(line.begin(), '/');
+        std::vector<std::string_view> tokens = tokenize(line);
+        if (line.starts_with(" ")) {
+            tokens.insert(tokens.begin(), std::string_view("/"));
         }
-
-        std::vector<std::string> tokens = Tokenize(line, " ");
         if (tokens.size() < 4) {
             std::cerr << "Ill-formed line: " << line << " in " << fn << std::endl;
             return -1;
         }
 
         // Historical: remove the leading '/' if exists.
-        std::string path(tokens[0].front() == '/' ? std::string(tokens[0], 1) : tokens[0]);
+        std::string_view path = tokens[0];
+        ConsumePrefix(&path, "/");
 
         Entry e{
-                .path = std::move(path),
-                .uid = static_cast<unsigned int>(atoi(tokens[1].c_str())),
-                .gid = static_cast<unsigned int>(atoi(tokens[2].c_str())),
+                .path = path,
+                .uid = static_cast<unsigned int>(atoi(std::string(tokens[1]).c_str())),
+                .gid = static_cast<unsigned int>(atoi(std::string(tokens[2]).c_str())),
                 // mode is in octal
-                .mode = static_cast<unsigned int>(strtol(tokens[3].c_str(), nullptr, 8)),
+                .mode = static_cast<unsigned int>(
+                        strtol(std::string(tokens[3]).c_str(), nullptr, 8)),
                 .capabilities = 0,
         };
 
@@ -89,18 +151,10 @@ int load_canned_fs_config(const char* fn) {
             std::cerr << "info: ignored token \"" << sv << "\" in " << fn << std::endl;
         }
 
-        canned_data.emplace_back(std::move(e));
+        canned_data.emplace_back(e);
     }
 
-    // Note: we used to sort the entries by path names. This was to improve the lookup performance
-    // by doing binary search. However, this is no longer the case. The lookup performance is not
-    // critical because this tool runs on the host, not on the device. Now, there can be multiple
-    // entries for the same path. Then the one that comes the last wins. This is to allow overriding
-    // platform provided fs_config with a user provided fs_config by appending the latter to the
-    // former.
-    //
-    // To implement the strategy, reverse the entries order, and search from the top.
-    std::reverse(canned_data.begin(), canned_data.end());
+    rebuild_canned_index();
 
     std::cout << "loaded " << canned_data.size() << " fs_config entries" << std::endl;
     return 0;
@@ -112,13 +166,16 @@ void canned_fs_config(const char* path, [[maybe_unused]] int dir,
     if (path != nullptr && path[0] == '/') path++;  // canned paths lack the leading '/'
 
     const Entry* found = nullptr;
-    // canned_data is already reversed. First match wins.
-    for (const auto& entry : canned_data) {
-        if (path == entry.path) {
-            found = &entry;
-            break;
+    if (!canned_index.empty()) {
+        std::string_view key(path);
+        for (size_t slot = canned_slot(key); canned_index[slot] != 0;
+             slot = (slot + 1) & (canned_index.size() - 1)) {
+            const Entry& entry = canned_data[canned_index[slot] - 1];
+            if (entry.path == key) {
+                found = &entry;
+                break;
+            }
         }
-        continue;
     }
 
     if (found == nullptr) {
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <private/canned_fs_config.h>
+
+#include <string>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <gtest/gtest.h>
+
+// The canned config is global, so everything is loaded and checked in one test.
+TEST(canned_fs_config, load_and_lookup) {
+    TemporaryFile platform;
+    ASSERT_TRUE(android::base::WriteStringToFile(" 0 0 0755\n"
+                                                 "system 0 2000 0751 selabel=u:object_r:foo:s0\n"
+                                                 "/system/bin/sh 0 2000 0755\n"
+                                                 "system/bin/ping 0 2000 0750 capabilities=0x2000\n",
+                                                 platform.path));
+    ASSERT_EQ(0, load_canned_fs_config(platform.path));
+
+    // Many entries, so that the index has to grow, with the override for system/bin/sh in the
+    // middle of them. The last entry for a path wins.
+    std::string overrides;
+    for (int i = 0; i < 1000; i++) {
+        overrides += android::base::StringPrintf("system/app/%d 1000 %d 0644\n", i, i);
+        if (i == 500) overrides += "system/bin/sh 1 2 0700\n";
+    }
+    TemporaryFile user;
+    ASSERT_TRUE(android::base::WriteStringToFile(overrides, user.path));
+    ASSERT_EQ(0, load_canned_fs_config(user.path));
+
+    unsigned uid, gid, mode;
+    uint64_t capabilities;
+    canned_fs_config("/", 1, nullptr, &uid, &gid, &mode, &capabilities);
+    EXPECT_EQ(0755U, mode);
+    canned_fs_config("", 1, nullptr, &uid, &gid, &mode, &capabilities);
+    EXPECT_EQ(0755U, mode);
+
+    canned_fs_config("system", 1, nullptr, &uid, &gid, &mode, &capabilities);
+    EXPECT_EQ(2000U, gid);
+    EXPECT_EQ(0751U, mode);
+
+    canned_fs_config("/system/bin/ping", 0, nullptr, &uid, &gid, &mode, &capabilities);
+    EXPECT_EQ(0750U, mode);
+    EXPECT_EQ(0x2000U, capabilities);
+
+    canned_fs_config("system/bin/sh", 0, nullptr, &uid, &gid, &mode, &capabilities);
+    EXPECT_EQ(1U, uid);
+    EXPECT_EQ(2U, gid);
+    EXPECT_EQ(0700U, mode);
+    EXPECT_EQ(0U, capabilities);
+
+    for (int i = 0; i < 1000; i++) {
+        std::string path = android::base::StringPrintf("system/app/%d", i);
+        canned_fs_config(path.c_str(), 0, nullptr, &uid, &gid, &mode, &capabilities);
+        EXPECT_EQ(static_cast<unsigned>(i), gid) << path;
+    }
+
+    EXPECT_EXIT(canned_fs_config("system/app/1000", 0, nullptr, &uid, &gid, &mode, &capabilities),
+                testing::ExitedWithCode(1), "failed to find system/app/1000");
+}
+
+TEST(canned_fs_config, ill_formed_line) {
+    TemporaryFile bad;
+    ASSERT_TRUE(android::base::WriteStringToFile("system/bin/sh 0 2000\n", bad.path));
+    EXPECT_EQ(-1, load_canned_fs_config(bad.path));
+}
@@ -310,7 +310,10 @@ void config_load(cnode *root, char *data)
 
 void config_load_file(cnode *root, const char *fn)
 {
-    char* data = static_cast<char*>(load_file(fn, nullptr));
+    // The parser writes terminators into the data and keeps pointers into it, so a private
+    // mapping only copies the pages that it touches.
+    char* data = static_cast<char*>(load_file_mapped(fn, nullptr));
+    if (data == nullptr) data = static_cast<char*>(load_file(fn, nullptr));
     config_load(root, data);
     // TODO: deliberate leak :-/
 }
@@ -33,7 +33,10 @@
 #include <sys/types.h>
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include <android-base/file.h>
 #include <android-base/strings.h>
 #include <cutils/fs.h>
 #include <log/log.h>
@@ -279,41 +282,48 @@ static bool is_partition(const std::string& path) {
     return false;
 }
 
+// Logical partitions whose files also match the patterns of the partition itself.
+static constexpr const char* kLogicalPartitions[] = {"system/product/", "system/system_ext/",
+                                                     "system/vendor/", "vendor/odm/"};
+
+// no FNM_PATHNAME is set in order to match a/b/c/d with a/*
+// FNM_ESCAPE is set in order to prevent using \\? and \\* and maintenance issues.
+static constexpr int kFnmFlags = FNM_NOESCAPE;
+
+// Massage pattern and input so that they can be used by fnmatch where
+// directories have to end with /.
+static void fs_config_massage(bool dir, std::string* pattern, std::string* input) {
+    if (!dir) return;
+
+    if (input && !EndsWith(*input, "/")) {
+        input->append("/");
+    }
+
+    if (pattern && !EndsWith(*pattern, "/*")) {
+        if (EndsWith(*pattern, "/")) {
+            pattern->append("*");
+        } else {
+            pattern->append("/*");
+        }
+    }
+}
+
 // alias prefixes of "<partition>/<stuff>" to "system/<partition>/<stuff>" or
 // "system/<partition>/<stuff>" to "<partition>/<stuff>"
 static bool fs_config_cmp(bool dir, const char* prefix, size_t len, const char* path, size_t plen) {
     std::string pattern(prefix, len);
     std::string input(path, plen);
 
-    // Massage pattern and input so that they can be used by fnmatch where
-    // directories have to end with /.
-    if (dir) {
-        if (!EndsWith(input, "/")) {
-            input.append("/");
-        }
-
-        if (!EndsWith(pattern, "/*")) {
-            if (EndsWith(pattern, "/")) {
-                pattern.append("*");
-            } else {
-                pattern.append("/*");
-            }
-        }
-    }
+    fs_config_massage(dir, &pattern, &input);
 
-    // no FNM_PATHNAME is set in order to match a/b/c/d with a/*
-    // FNM_ESCAPE is set in order to prevent using \\? and \\* and maintenance issues.
-    const int fnm_flags = FNM_NOESCAPE;
-    if (fnmatch(pattern.c_str(), input.c_str(), fnm_flags) == 0) return true;
+    if (fnmatch(pattern.c_str(), input.c_str(), kFnmFlags) == 0) return true;
 
     // Check match between logical partition's files and patterns.
-    static constexpr const char* kLogicalPartitions[] = {"system/product/", "system/system_ext/",
-                                                         "system/vendor/", "vendor/odm/"};
     for (auto& logical_partition : kLogicalPartitions) {
         if (StartsWith(input, logical_partition)) {
             std::string input_in_partition = input.substr(input.find('/') + 1);
             if (!is_partition(input_in_partition)) continue;
-            if (fnmatch(pattern.c_str(), input_in_partition.c_str(), fnm_flags) == 0) {
+            if (fnmatch(pattern.c_str(), input_in_partition.c_str(), kFnmFlags) == 0) {
                 return true;
             }
         }
@@ -406,3 +416,146 @@ void fs_config(const char* path, int dir, const char* target_out_path, unsigned*
         *capabilities = 0;
     }
 }
+
+// The rules for directories or for files, in the order that get_fs_config()
+// tries them, indexed so that most lookups don't have to call fnmatch.
+struct fs_config_table {
+    struct rule {
+        std::string pattern;  // massaged for fnmatch
+        std::string literal;  // the part of pattern before its first wildcard
+        struct fs_config conf;
+    };
+    std::vector<rule> rules;
+
+    // The first rule for each pattern without wildcards, which for files is
+    // the path it matches. Directory patterns all have a trailing "/*", so
+    // these are by the literal prefix ending in '/' instead.
+    std::unordered_map<std::string, size_t> plain;
+    // The indices of the other rules, in order.
+    std::vector<size_t> wildcards;
+
+    void add(bool dir, std::string pattern, const struct fs_config& conf) {
+        fs_config_massage(dir, &pattern, nullptr);
+        size_t idx = rules.size();
+        std::string literal = pattern.substr(0, pattern.find_first_of("*?["));
+        if (literal.size() == pattern.size()) {
+            plain.emplace(literal, idx);
+        } else if (dir && literal.size() + 1 == pattern.size()) {
+            // The trailing '*' matches anything below the literal prefix.
+            plain.emplace(literal, idx);
+        } else {
+            wildcards.push_back(idx);
+        }
+        rules.push_back({std::move(pattern), std::move(literal), conf});
+    }
+
+    // Returns the index of the first rule that matches input, if it is
+    // before best, or else best.
+    size_t lookup(bool dir, const std::string& input, size_t best) const {
+        if (dir) {
+            for (size_t slash = input.find('/'); slash != std::string::npos;
+                 slash = input.find('/', slash + 1)) {
+                auto it = plain.find(input.substr(0, slash + 1));
+                if (it != plain.end() && it->second < best) best = it->second;
+            }
+        } else {
+            auto it = plain.find(input);
+            if (it != plain.end() && it->second < best) best = it->second;
+        }
+        for (size_t idx : wildcards) {
+            if (idx >= best) break;
+            const rule& r = rules[idx];
+            if (StartsWith(input, r.literal) &&
+                fnmatch(r.pattern.c_str(), input.c_str(), kFnmFlags) == 0) {
+                return idx;
+            }
+        }
+        return best;
+    }
+};
+
+struct fs_config_context {
+    fs_config_table dirs;
+    fs_config_table files;
+};
+
+static void fs_config_load(int dir, int which, const char* target_out_path,
+                           fs_config_table* table) {
+    int fd = fs_config_open(dir, which, target_out_path);
+    if (fd < 0) return;
+    std::string data;
+    bool ok = android::base::ReadFdToString(fd, &data);
+    close(fd);
+    if (!ok) {
+        ALOGE("%s could not be read", conf[which][dir]);
+        return;
+    }
+
+    size_t offset = 0;
+    while (data.size() - offset >= sizeof(fs_path_config_from_file)) {
+        fs_path_config_from_file header;
+        memcpy(&header, data.data() + offset, sizeof(header));
+        uint16_t host_len = header.len;
+        ssize_t remainder = host_len - sizeof(header);
+        if (remainder <= 0) {
+            ALOGE("%s len is corrupted", conf[which][dir]);
+            break;
+        }
+        if (data.size() - offset - sizeof(header) < static_cast<size_t>(remainder)) {
+            ALOGE("%s prefix is truncated", conf[which][dir]);
+            break;
+        }
+        const char* prefix = data.data() + offset + sizeof(header);
+        size_t len = strnlen(prefix, remainder);
+        if (len >= static_cast<size_t>(remainder)) {  // missing a terminating null
+            ALOGE("%s is corrupted", conf[which][dir]);
+            break;
+        }
+        table->add(dir, std::string(prefix, len),
+                   {header.uid, header.gid, header.mode, header.capabilities});
+        offset += host_len;
+    }
+}
+
+struct fs_config_context* fs_config_context_create(const char* target_out_path) {
+    auto ctx = new fs_config_context;
+    for (int dir = 0; dir < 2; ++dir) {
+        fs_config_table* table = dir ? &ctx->dirs : &ctx->files;
+        for (size_t which = 0; which < (sizeof(conf) / sizeof(conf[0])); ++which) {
+            fs_config_load(dir, which, target_out_path, table);
+        }
+        for (const struct fs_path_config* pc = dir ? android_dirs : android_files; pc->prefix;
+             pc++) {
+            table->add(dir, pc->prefix, {pc->uid, pc->gid, pc->mode, pc->capabilities});
+        }
+    }
+    return ctx;
+}
+
+void fs_config_context_destroy(struct fs_config_context* ctx) {
+    delete ctx;
+}
+
+bool fs_config_context_get(struct fs_config_context* ctx, const char* path, bool dir,
+                           struct fs_config* fs_conf) {
+    if (path[0] == '/') {
+        path++;
+    }
+
+    std::string input(path);
+    fs_config_massage(dir, nullptr, &input);
+
+    const fs_config_table& table = dir ? ctx->dirs : ctx->files;
+    size_t best = table.lookup(dir, input, SIZE_MAX);
+    for (auto& logical_partition : kLogicalPartitions) {
+        if (StartsWith(input, logical_partition)) {
+            std::string input_in_partition = input.substr(input.find('/') + 1);
+            if (!is_partition(input_in_partition)) continue;
+            best = table.lookup(dir, input_in_partition, best);
+        }
+    }
+    if (best == SIZE_MAX) return false;
+
+    *fs_conf = table.rules[best].conf;
+    return true;
+}
@@ -16,6 +16,7 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
 #include <string>
 
 #include <gtest/gtest.h>
@@ -25,6 +26,7 @@
 #include <android-base/strings.h>
 
 #include <private/android_filesystem_config.h>
+#include <private/fs_config.h>
 
 #include "fs_config.h"
 
@@ -258,3 +260,31 @@ TEST(fs_config, odm_files_alias) {
 TEST(fs_config, system_alias) {
     EXPECT_FALSE(check_fs_config_cmp(fs_config_cmp_tests));
 }
+
+static void check_context(fs_config_context* ctx, const fs_path_config* paths, bool dir) {
+    for (size_t idx = 0; paths[idx].prefix; ++idx) {
+        // Turn each pattern into a path that it matches, and look up that path and the same
+        // path below it, in the partition and in its system/ alias.
+        std::string path = paths[idx].prefix;
+        std::replace(path.begin(), path.end(), '*', 'x');
+        std::replace(path.begin(), path.end(), '?', 'x');
+        for (const std::string& p : {path, path + "/x", "system/" + path, "/" + path}) {
+            struct fs_config expected = {}, actual = {};
+            bool found = get_fs_config(p.c_str(), dir, nullptr, &expected);
+            EXPECT_EQ(found, fs_config_context_get(ctx, p.c_str(), dir, &actual)) << p;
+            if (!found) continue;
+            EXPECT_EQ(expected.uid, actual.uid) << p;
+            EXPECT_EQ(expected.gid, actual.gid) << p;
+            EXPECT_EQ(expected.mode, actual.mode) << p;
+            EXPECT_EQ(expected.capabilities, actual.capabilities) << p;
+        }
+    }
+}
+
+TEST(fs_config, context_matches_get_fs_config) {
+    fs_config_context* ctx = fs_config_context_create(nullptr);
+    ASSERT_NE(nullptr, ctx);
+    check_context(ctx, __for_testing_only__android_dirs, true);
+    check_context(ctx, __for_testing_only__android_files, false);
+    fs_config_context_destroy(ctx);
+}
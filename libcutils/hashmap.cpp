@@ -19,27 +19,53 @@
 #include <assert.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
+// Entries are kept in an array in the order they were added, and found
+// through an open addressing table of indices into that array. Lookups touch
+// one small index array and one entry, instead of a malloc()ed node per key.
+// Removing an entry only marks it (and its index) as removed, so it is safe
+// for a hashmapForEach() callback to remove the entry it is given; removed
+// entries are dropped the next time the arrays are rebuilt for a put.
 typedef struct Entry Entry;
 struct Entry {
     void* key;
-    int hash;
     void* value;
-    Entry* next;
+    int hash;
+    bool removed;
 };
 
+// Values in the index table other than indices into the entry array.
+static const int32_t kIndexEmpty = -1;
+static const int32_t kIndexRemoved = -2;
+
 struct Hashmap {
-    Entry** buckets;
-    size_t bucketCount;
+    Entry* entries;
+    size_t entryCount;     // Including removed entries.
+    size_t entryCapacity;
+    int32_t* index;
+    size_t indexCount;     // A power of 2.
     int (*hash)(void* key);
     bool (*equals)(void* keyA, void* keyB);
     pthread_mutex_t lock;
     size_t size;
 };
 
+// Returns the number of index slots to use for the given number of entries,
+// for a 0.75 load factor at most.
+static size_t indexCountFor(size_t entryCapacity) {
+    size_t minimumIndexCount = entryCapacity * 4 / 3;
+    size_t indexCount = 1;
+    while (indexCount <= minimumIndexCount) {
+        // Index count must be power of 2.
+        indexCount <<= 1;
+    }
+    return indexCount;
+}
+
 Hashmap* hashmapCreate(size_t initialCapacity,
         int (*hash)(void* key), bool (*equals)(void* keyA, void* keyB)) {
     assert(hash != NULL);
@@ -50,20 +76,19 @@ Hashmap* hashmapCreate(size_t initialCapacity,
         return NULL;
     }
 
-    // 0.75 load factor.
-    size_t minimumBucketCount = initialCapacity * 4 / 3;
-    map->bucketCount = 1;
-    while (map->bucketCount <= minimumBucketCount) {
-        // Bucket count must be power of 2.
-        map->bucketCount <<= 1;
-    }
-
-    map->buckets = static_cast<Entry**>(calloc(map->bucketCount, sizeof(Entry*)));
-    if (map->buckets == NULL) {
+    map->entryCapacity = initialCapacity > 0 ? initialCapacity : 1;
+    map->entries = static_cast<Entry*>(malloc(map->entryCapacity * sizeof(Entry)));
+    map->indexCount = indexCountFor(map->entryCapacity);
+    map->index = static_cast<int32_t*>(malloc(map->indexCount * sizeof(int32_t)));
+    if (map->entries == NULL || map->index == NULL) {
+        free(map->entries);
+        free(map->index);
         free(map);
         return NULL;
     }
+    memset(map->index, 0xff, map->indexCount * sizeof(int32_t));  // kIndexEmpty
 
+    map->entryCount = 0;
     map->size = 0;
 
     map->hash = hash;
@@ -93,39 +118,42 @@ static inline int hashKey(Hashmap* map, void* key) {
     return h;
 }
 
-static inline size_t calculateIndex(size_t bucketCount, int hash) {
-    return ((size_t) hash) & (bucketCount - 1);
+static inline size_t calculateIndex(size_t indexCount, int hash) {
+    return ((size_t) hash) & (indexCount - 1);
 }
 
-static void expandIfNecessary(Hashmap* map) {
-    // If the load factor exceeds 0.75...
-    if (map->size > (map->bucketCount * 3 / 4)) {
-        // Start off with a 0.33 load factor.
-        size_t newBucketCount = map->bucketCount << 1;
-        Entry** newBuckets = static_cast<Entry**>(calloc(newBucketCount, sizeof(Entry*)));
-        if (newBuckets == NULL) {
-            // Abort expansion.
-            return;
-        }
-
-        // Move over existing entries.
-        size_t i;
-        for (i = 0; i < map->bucketCount; i++) {
-            Entry* entry = map->buckets[i];
-            while (entry != NULL) {
-                Entry* next = entry->next;
-                size_t index = calculateIndex(newBucketCount, entry->hash);
-                entry->next = newBuckets[index];
-                newBuckets[index] = entry;
-                entry = next;
-            }
+// Rebuilds the arrays to hold up to entryCapacity entries, dropping removed
+// entries. Returns false, leaving the map as it was, if allocation fails.
+static bool rebuild(Hashmap* map, size_t entryCapacity) {
+    size_t indexCount = indexCountFor(entryCapacity);
+    Entry* entries = static_cast<Entry*>(malloc(entryCapacity * sizeof(Entry)));
+    int32_t* index = static_cast<int32_t*>(malloc(indexCount * sizeof(int32_t)));
+    if (entries == NULL || index == NULL) {
+        free(entries);
+        free(index);
+        return false;
+    }
+    memset(index, 0xff, indexCount * sizeof(int32_t));  // kIndexEmpty
+
+    size_t entryCount = 0;
+    for (size_t i = 0; i < map->entryCount; i++) {
+        if (map->entries[i].removed) continue;
+        size_t slot = calculateIndex(indexCount, map->entries[i].hash);
+        while (index[slot] != kIndexEmpty) {
+            slot = (slot + 1) & (indexCount - 1);
         }
-
-        // Copy over internals.
-        free(map->buckets);
-        map->buckets = newBuckets;
-        map->bucketCount = newBucketCount;
+        index[slot] = static_cast<int32_t>(entryCount);
+        entries[entryCount++] = map->entries[i];
     }
+
+    free(map->entries);
+    free(map->index);
+    map->entries = entries;
+    map->entryCount = entryCount;
+    map->entryCapacity = entryCapacity;
+    map->index = index;
+    map->indexCount = indexCount;
+    return true;
 }
 
 void hashmapLock(Hashmap* map) {
@@ -137,16 +165,8 @@ void hashmapUnlock(Hashmap* map) {
 }
 
 void hashmapFree(Hashmap* map) {
-    size_t i;
-    for (i = 0; i < map->bucketCount; i++) {
-        Entry* entry = map->buckets[i];
-        while (entry != NULL) {
-            Entry* next = entry->next;
-            free(entry);
-            entry = next;
-        }
-    }
-    free(map->buckets);
+    free(map->entries);
+    free(map->index);
     pthread_mutex_destroy(&map->lock);
     free(map);
 }
@@ -166,18 +186,6 @@ int hashmapHash(void* key, size_t keySize) {
     return h;
 }
 
-static Entry* createEntry(void* key, int hash, void* value) {
-    Entry* entry = static_cast<Entry*>(malloc(sizeof(Entry)));
-    if (entry == NULL) {
-        return NULL;
-    }
-    entry->key = key;
-    entry->hash = hash;
-    entry->value = value;
-    entry->next = NULL;
-    return entry;
-}
-
 static inline bool equalKeys(void* keyA, int hashA, void* keyB, int hashB,
         bool (*equals)(void*, void*)) {
     if (keyA == keyB) {
@@ -189,86 +197,91 @@ static inline bool equalKeys(void* keyA, int hashA, void* keyB, int hashB,
     return equals(keyA, keyB);
 }
 
-void* hashmapPut(Hashmap* map, void* key, void* value) {
-    int hash = hashKey(map, key);
-    size_t index = calculateIndex(map->bucketCount, hash);
-
-    Entry** p = &(map->buckets[index]);
+// Returns the index slot of the entry for the given key, or of the empty
+// slot that ends its probe sequence.
+static size_t findSlot(Hashmap* map, void* key, int hash) {
+    size_t slot = calculateIndex(map->indexCount, hash);
     while (true) {
-        Entry* current = *p;
-
-        // Add a new entry.
-        if (current == NULL) {
-            *p = createEntry(key, hash, value);
-            if (*p == NULL) {
-                errno = ENOMEM;
-                return NULL;
-            }
-            map->size++;
-            expandIfNecessary(map);
-            return NULL;
+        int32_t i = map->index[slot];
+        if (i == kIndexEmpty) {
+            return slot;
         }
-
-        // Replace existing entry.
-        if (equalKeys(current->key, current->hash, key, hash, map->equals)) {
-            void* oldValue = current->value;
-            current->value = value;
-            return oldValue;
+        if (i != kIndexRemoved) {
+            Entry* entry = &map->entries[i];
+            if (equalKeys(entry->key, entry->hash, key, hash, map->equals)) {
+                return slot;
+            }
         }
-
-        // Move to next entry.
-        p = &current->next;
+        slot = (slot + 1) & (map->indexCount - 1);
     }
 }
 
-void* hashmapGet(Hashmap* map, void* key) {
+void* hashmapPut(Hashmap* map, void* key, void* value) {
     int hash = hashKey(map, key);
-    size_t index = calculateIndex(map->bucketCount, hash);
+    size_t slot = findSlot(map, key, hash);
+
+    // Replace existing entry.
+    if (map->index[slot] != kIndexEmpty) {
+        Entry* entry = &map->entries[map->index[slot]];
+        void* oldValue = entry->value;
+        entry->value = value;
+        return oldValue;
+    }
 
-    Entry* entry = map->buckets[index];
-    while (entry != NULL) {
-        if (equalKeys(entry->key, entry->hash, key, hash, map->equals)) {
-            return entry->value;
+    // Make room for a new entry, growing if more than half of the entries
+    // are live, and otherwise only dropping the removed ones.
+    if (map->entryCount == map->entryCapacity) {
+        size_t entryCapacity = map->entryCapacity;
+        if (map->size >= entryCapacity / 2) {
+            entryCapacity *= 2;
+        }
+        if (!rebuild(map, entryCapacity)) {
+            errno = ENOMEM;
+            return NULL;
         }
-        entry = entry->next;
+        slot = findSlot(map, key, hash);
     }
 
+    map->index[slot] = static_cast<int32_t>(map->entryCount);
+    Entry* entry = &map->entries[map->entryCount++];
+    entry->key = key;
+    entry->hash = hash;
+    entry->value = value;
+    entry->removed = false;
+    map->size++;
     return NULL;
 }
 
-void* hashmapRemove(Hashmap* map, void* key) {
+void* hashmapGet(Hashmap* map, void* key) {
     int hash = hashKey(map, key);
-    size_t index = calculateIndex(map->bucketCount, hash);
-
-    // Pointer to the current entry.
-    Entry** p = &(map->buckets[index]);
-    Entry* current;
-    while ((current = *p) != NULL) {
-        if (equalKeys(current->key, current->hash, key, hash, map->equals)) {
-            void* value = current->value;
-            *p = current->next;
-            free(current);
-            map->size--;
-            return value;
-        }
+    size_t slot = findSlot(map, key, hash);
+    if (map->index[slot] == kIndexEmpty) {
+        return NULL;
+    }
+    return map->entries[map->index[slot]].value;
+}
 
-        p = &current->next;
+void* hashmapRemove(Hashmap* map, void* key) {
+    int hash = hashKey(map, key);
+    size_t slot = findSlot(map, key, hash);
+    if (map->index[slot] == kIndexEmpty) {
+        return NULL;
     }
 
-    return NULL;
+    Entry* entry = &map->entries[map->index[slot]];
+    map->index[slot] = kIndexRemoved;
+    entry->removed = true;
+    map->size--;
+    return entry->value;
 }
 
 void hashmapForEach(Hashmap* map, bool (*callback)(void* key, void* value, void* context),
                     void* context) {
-    size_t i;
-    for (i = 0; i < map->bucketCount; i++) {
-        Entry* entry = map->buckets[i];
-        while (entry != NULL) {
-            Entry *next = entry->next;
-            if (!callback(entry->key, entry->value, context)) {
-                return;
-            }
-            entry = next;
+    for (size_t i = 0; i < map->entryCount; i++) {
+        Entry* entry = &map->entries[i];
+        if (entry->removed) continue;
+        if (!callback(entry->key, entry->value, context)) {
+            return;
         }
     }
 }
@@ -33,6 +33,33 @@ int ashmem_pin_region(int fd, size_t offset, size_t len);
 int ashmem_unpin_region(int fd, size_t offset, size_t len);
 int ashmem_get_size_region(int fd);
 
+/*
+ * A per-process pool of regions for clients that create and free many short-lived regions.
+ *
+ * ashmem_pool_create_region() returns a zero-filled, read-write region of at least `size' bytes,
+ * rounded up to a power of two number of pages, reusing one released earlier if there is one.
+ * ashmem_pool_release_region() takes ownership of a region from ashmem_pool_create_region(), and
+ * keeps it for reuse, after dropping its contents, if it is still writable. Only release a region
+ * once it is unmapped and no other process holds it; otherwise close it as usual.
+ *
+ * Regions larger than the largest size class, and all regions on devices without memfd, are
+ * created and closed without being pooled.
+ */
+struct ashmem_pool_stats {
+    size_t created;        /* regions created because none of their size class were pooled */
+    size_t reused;         /* regions handed out again from the pool */
+    size_t released;       /* regions kept by the pool when they were released */
+    size_t discarded;      /* released regions that were closed instead */
+    size_t pooled_regions; /* regions in the pool now */
+    size_t pooled_bytes;   /* total size of the regions in the pool now */
+};
+
+int ashmem_pool_create_region(size_t size);
+void ashmem_pool_release_region(int fd);
+void ashmem_pool_get_stats(struct ashmem_pool_stats* stats);
+/* Closes the regions in the pool. */
+void ashmem_pool_trim(void);
+
 #ifdef __cplusplus
 }
 #endif
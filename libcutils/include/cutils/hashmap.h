@@ -77,8 +77,9 @@ void* hashmapGet(Hashmap* map, void* key);
 void* hashmapRemove(Hashmap* map, void* key);
 
 /**
- * Invokes the given callback on each entry in the map. Stops iterating if
- * the callback returns false.
+ * Invokes the given callback on each entry in the map, in the order the keys
+ * were first put. Stops iterating if the callback returns false. The callback
+ * may remove the entry it is given, but must not put new entries.
  */
 void hashmapForEach(Hashmap* map, bool (*callback)(void* key, void* value, void* context),
                     void* context);
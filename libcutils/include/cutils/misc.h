@@ -17,6 +17,9 @@
 #ifndef __CUTILS_MISC_H
 #define __CUTILS_MISC_H
 
+#include <stddef.h>
+#include <sys/types.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -28,6 +31,26 @@ extern "C" {
          */
 extern void *load_file(const char *fn, unsigned *sz);
 
+        /* Like load_file(), but maps the file privately instead of
+         * copying it, so the pages are shared with the page cache
+         * until they are written to.  The mapping is writable and
+         * null terminated.  Only works for non-empty regular files;
+         * returns 0 for anything else, so callers can fall back to
+         * load_file().  Release it with unload_file_mapped(), passing
+         * the size that was returned.
+         */
+extern void *load_file_mapped(const char *fn, unsigned *sz);
+extern void unload_file_mapped(void *data, unsigned sz);
+
+        /* Reads at most size - 1 bytes from the start of the file into
+         * buf, which the caller provides (usually on its stack), and
+         * null terminates it.  This is one open() and one pread(),
+         * which suits small sysfs and procfs attributes whose size
+         * can't be known in advance.  Returns the number of bytes
+         * read, or -1 with errno set on failure.
+         */
+extern ssize_t load_file_into(const char *fn, void *buf, size_t size);
+
         /* This is the range of UIDs (and GIDs) that are reserved
          * for assigning to applications.
          */
@@ -112,6 +112,26 @@ int property_set(const char *key, const char *value);
 
 int property_list(void (*propfn)(const char *key, const char *value, void *cookie), void *cookie);
 
+/* cached_property: a handle for reading one property repeatedly. The property
+** is looked up once, and each read only checks whether it changed since the
+** previous read; the value is copied and parsed again only if it did. Handles
+** may be used from several threads.
+**
+** cached_property_create returns NULL if the key is NULL. The property does
+** not need to exist yet.
+*/
+struct cached_property;
+struct cached_property* cached_property_create(const char* key);
+void cached_property_destroy(struct cached_property* prop);
+
+/* The cached_property_get* functions behave like their property_get*
+** counterparts, and return the default value if |prop| is NULL.
+*/
+int cached_property_get(struct cached_property* prop, char* value, const char* default_value);
+int8_t cached_property_get_bool(struct cached_property* prop, int8_t default_value);
+int64_t cached_property_get_int64(struct cached_property* prop, int64_t default_value);
+int32_t cached_property_get_int32(struct cached_property* prop, int32_t default_value);
+
 #if defined(__BIONIC_FORTIFY)
 #define __property_get_err_str "property_get() called with too small of a buffer"
 
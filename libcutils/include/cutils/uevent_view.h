@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CUTILS_UEVENT_VIEW_H
+#define __CUTILS_UEVENT_VIEW_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include <string_view>
+
+namespace android {
+
+/*
+ * Read-only view over a kobject uevent as received from a
+ * NETLINK_KOBJECT_UEVENT socket:
+ *
+ *     "<action>@<devpath>\0KEY=value\0KEY=value\0..."
+ *
+ * Iterating yields a key/value pair of string_views pointing into the
+ * original buffer for every "KEY=value" entry; the "<action>@<devpath>"
+ * header and any other entry without an '=' are skipped. Nothing is copied
+ * and the buffer does not need to be NUL terminated, but it must outlive the
+ * view and every string_view obtained from it.
+ */
+class UeventView {
+  public:
+    struct Field {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    class iterator {
+      public:
+        iterator(const char* pos, const char* end) : pos_(pos), end_(end) { Settle(); }
+
+        const Field& operator*() const { return field_; }
+        const Field* operator->() const { return &field_; }
+
+        iterator& operator++() {
+            pos_ = next_;
+            Settle();
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return pos_ == other.pos_; }
+        bool operator!=(const iterator& other) const { return pos_ != other.pos_; }
+
+      private:
+        // Advances pos_ to the next entry that contains an '=', filling in field_.
+        void Settle() {
+            while (pos_ < end_) {
+                const char* nul = static_cast<const char*>(memchr(pos_, '\0', end_ - pos_));
+                const char* entry_end = nul ? nul : end_;
+                next_ = nul ? nul + 1 : end_;
+
+                const char* eq = static_cast<const char*>(memchr(pos_, '=', entry_end - pos_));
+                if (eq != nullptr) {
+                    field_.key = std::string_view(pos_, eq - pos_);
+                    field_.value = std::string_view(eq + 1, entry_end - eq - 1);
+                    return;
+                }
+                pos_ = next_;
+            }
+            pos_ = end_;
+        }
+
+        const char* pos_;
+        const char* end_;
+        const char* next_ = nullptr;
+        Field field_;
+    };
+
+    UeventView(const char* data, size_t length) : data_(data), end_(data + length) {}
+
+    iterator begin() const { return iterator(data_, end_); }
+    iterator end() const { return iterator(end_, end_); }
+
+    // The "<action>@<devpath>" header, or an empty view if the first entry
+    // is not one.
+    std::string_view header() const {
+        const char* nul = static_cast<const char*>(memchr(data_, '\0', end_ - data_));
+        std::string_view first(data_, (nul ? nul : end_) - data_);
+        if (first.find('@') == std::string_view::npos || first.find('=') != std::string_view::npos) {
+            return {};
+        }
+        return first;
+    }
+
+    // Value of the first entry named key, or an empty view if there is none.
+    std::string_view Find(std::string_view key) const {
+        for (const Field& field : *this) {
+            if (field.key == key) return field.value;
+        }
+        return {};
+    }
+
+  private:
+    const char* data_;
+    const char* end_;
+};
+
+}  // namespace android
+
+#endif /* __CUTILS_UEVENT_VIEW_H */
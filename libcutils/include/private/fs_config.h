@@ -56,4 +56,17 @@ struct fs_config {
 bool get_fs_config(const char* path, bool dir, const char* target_out_path,
                    struct fs_config* conf);
 
+/*
+ * get_fs_config() reads the configuration files on every call. Callers that look up many paths,
+ * such as image builders, should instead load and index the configuration once with
+ * fs_config_context_create(), which takes the same target_out_path, and look paths up with
+ * fs_config_context_get(). The results are the same as get_fs_config()'s.
+ */
+struct fs_config_context;
+
+struct fs_config_context* fs_config_context_create(const char* target_out_path);
+void fs_config_context_destroy(struct fs_config_context* ctx);
+bool fs_config_context_get(struct fs_config_context* ctx, const char* path, bool dir,
+                           struct fs_config* conf);
+
 __END_DECLS
@@ -17,9 +17,13 @@
 
 #include <cutils/misc.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
-#include <fcntl.h>
 
 void *load_file(const char *fn, unsigned *_sz)
 {
@@ -51,3 +55,56 @@ oops:
     if(data != 0) free(data);
     return 0;
 }
+
+void* load_file_mapped(const char* fn, unsigned* _sz) {
+    int fd = open(fn, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        st.st_size >= static_cast<off_t>(UINT_MAX)) {
+        close(fd);
+        return nullptr;
+    }
+    size_t sz = st.st_size;
+
+    // Reserve room for the terminator first, so it lands in zero-filled anonymous memory even
+    // when the file ends exactly on a page boundary, and then map the file over the start.
+    void* data = mmap(nullptr, sz + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    if (mmap(data, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(data, sz + 1);
+        close(fd);
+        return nullptr;
+    }
+    close(fd);
+
+    if (_sz) *_sz = sz;
+    return data;
+}
+
+void unload_file_mapped(void* data, unsigned sz) {
+    if (data != nullptr) munmap(data, static_cast<size_t>(sz) + 1);
+}
+
+ssize_t load_file_into(const char* fn, void* buf, size_t size) {
+    if (size == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    int fd = open(fn, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    ssize_t n = TEMP_FAILURE_RETRY(pread(fd, buf, size - 1, 0));
+    int saved_errno = errno;
+    close(fd);
+    if (n < 0) {
+        errno = saved_errno;
+        return -1;
+    }
+    static_cast<char*>(buf)[n] = '\0';
+    return n;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cutils/misc.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+TEST(load_file, mapped_matches_copy) {
+    // One page exactly, so the terminator has to come from outside the file's mapping.
+    std::string content(getpagesize(), 'x');
+    TemporaryFile tf;
+    ASSERT_TRUE(android::base::WriteStringToFile(content, tf.path));
+
+    unsigned copy_size = 0;
+    char* copy = static_cast<char*>(load_file(tf.path, &copy_size));
+    ASSERT_NE(nullptr, copy);
+
+    unsigned mapped_size = 0;
+    char* mapped = static_cast<char*>(load_file_mapped(tf.path, &mapped_size));
+    ASSERT_NE(nullptr, mapped);
+    ASSERT_EQ(copy_size, mapped_size);
+    EXPECT_EQ(0, memcmp(copy, mapped, mapped_size + 1));
+
+    // The mapping is private, so writing to it leaves the file alone.
+    mapped[0] = 'y';
+    std::string reread;
+    ASSERT_TRUE(android::base::ReadFileToString(tf.path, &reread));
+    EXPECT_EQ(content, reread);
+
+    unload_file_mapped(mapped, mapped_size);
+    free(copy);
+}
+
+TEST(load_file, mapped_rejects_empty_and_missing) {
+    TemporaryFile tf;
+    EXPECT_EQ(nullptr, load_file_mapped(tf.path, nullptr));
+    EXPECT_EQ(nullptr, load_file_mapped("/does/not/exist", nullptr));
+}
+
+TEST(load_file, into_truncates_and_terminates) {
+    TemporaryFile tf;
+    ASSERT_TRUE(android::base::WriteStringToFile("Charging\n", tf.path));
+
+    char buf[32];
+    ASSERT_EQ(9, load_file_into(tf.path, buf, sizeof(buf)));
+    EXPECT_STREQ("Charging\n", buf);
+
+    char small[5];
+    ASSERT_EQ(4, load_file_into(tf.path, small, sizeof(small)));
+    EXPECT_STREQ("Char", small);
+
+    EXPECT_EQ(-1, load_file_into("/does/not/exist", buf, sizeof(buf)));
+    EXPECT_EQ(ENOENT, errno);
+}
@@ -27,6 +27,20 @@
 #include <android/fdsan.h>
 #endif
 
+// Recycling freed handles hides use-after-free from the sanitizers, so only
+// pool when none of them are watching the heap.
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(hwaddress_sanitizer)
+#define NATIVE_HANDLE_NO_POOL
+#endif
+#endif
+
+#if defined(__linux__) && !defined(NATIVE_HANDLE_NO_POOL)
+#define NATIVE_HANDLE_POOL
+#include <malloc.h>
+#include <pthread.h>
+#endif
+
 namespace {
 
 #if !defined(__BIONIC__)
@@ -81,6 +95,112 @@ void swap_fdsan_tags(const native_handle_t* handle, uint64_t expected_tag, uint6
     }
 }
 
+
+size_t handle_size(int numInts) {
+    return sizeof(native_handle_t) + sizeof(int) * numInts;
+}
+
+#ifdef NATIVE_HANDLE_POOL
+// Per-thread cache of freed handles, bucketed by how many fds + ints they
+// can hold. Graphics and media create and delete a handle per buffer, so
+// most allocations are served from the last few frees on the same thread.
+//
+// Every cached block is a plain malloc() block sized for its class; a
+// handle that came from the pool can still be released with free(), and a
+// malloc()ed handle passed to native_handle_delete() is cached according
+// to malloc_usable_size(), so neither direction has to know about the pool.
+constexpr int kPoolClassInts[] = {8, 16, 32, 64};
+constexpr size_t kPoolClasses = sizeof(kPoolClassInts) / sizeof(kPoolClassInts[0]);
+constexpr size_t kPoolDepth = 4;
+
+struct HandleCache {
+    native_handle_t* blocks[kPoolClasses][kPoolDepth];
+    size_t counts[kPoolClasses];
+    bool registered;
+    bool exited;
+};
+
+// Trivially destructible so that it stays usable while other thread exit
+// handlers run; the cached blocks are released via a pthread key instead.
+thread_local HandleCache gHandleCache;
+
+pthread_key_t gHandleCacheKey;
+bool gHandleCacheKeyValid;
+pthread_once_t gHandleCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+void handle_cache_thread_exit(void* arg) {
+    HandleCache* cache = static_cast<HandleCache*>(arg);
+    for (size_t c = 0; c < kPoolClasses; c++) {
+        for (size_t i = 0; i < cache->counts[c]; i++) {
+            free(cache->blocks[c][i]);
+        }
+        cache->counts[c] = 0;
+    }
+    // Handles deleted by later exit handlers go straight back to malloc.
+    cache->exited = true;
+}
+
+void handle_cache_create_key() {
+    gHandleCacheKeyValid = pthread_key_create(&gHandleCacheKey, handle_cache_thread_exit) == 0;
+}
+
+// Returns the smallest class that fits numInts, or -1 if it is too large to pool.
+int pool_class_for(int numInts) {
+    for (size_t c = 0; c < kPoolClasses; c++) {
+        if (numInts <= kPoolClassInts[c]) return c;
+    }
+    return -1;
+}
+
+native_handle_t* handle_alloc(int numInts) {
+    int c = pool_class_for(numInts);
+    if (c < 0) return static_cast<native_handle_t*>(malloc(handle_size(numInts)));
+
+    HandleCache& cache = gHandleCache;
+    if (cache.counts[c] > 0) {
+        return cache.blocks[c][--cache.counts[c]];
+    }
+    return static_cast<native_handle_t*>(malloc(handle_size(kPoolClassInts[c])));
+}
+
+void handle_free(native_handle_t* h) {
+    HandleCache& cache = gHandleCache;
+    if (cache.exited) {
+        free(h);
+        return;
+    }
+
+    // Bucket by what the block can actually hold, not by what it holds now:
+    // native_handle_clone() may have shrunk numFds, and callers are free to
+    // hand us handles they malloc()ed themselves.
+    size_t usable = malloc_usable_size(h);
+    int c = kPoolClasses - 1;
+    while (c >= 0 && handle_size(kPoolClassInts[c]) > usable) c--;
+    if (c < 0 || cache.counts[c] == kPoolDepth) {
+        free(h);
+        return;
+    }
+
+    if (!cache.registered) {
+        pthread_once(&gHandleCacheKeyOnce, handle_cache_create_key);
+        if (!gHandleCacheKeyValid || pthread_setspecific(gHandleCacheKey, &cache) != 0) {
+            free(h);
+            return;
+        }
+        cache.registered = true;
+    }
+    cache.blocks[c][cache.counts[c]++] = h;
+}
+#else
+native_handle_t* handle_alloc(int numInts) {
+    return static_cast<native_handle_t*>(malloc(handle_size(numInts)));
+}
+
+void handle_free(native_handle_t* h) {
+    free(h);
+}
+#endif  // NATIVE_HANDLE_POOL
+
 }  // anonymous namespace
 
 native_handle_t* native_handle_init(char* storage, int numFds, int numInts) {
@@ -103,8 +223,7 @@ native_handle_t* native_handle_create(int numFds, int numInts) {
         return NULL;
     }
 
-    size_t mallocSize = sizeof(native_handle_t) + (sizeof(int) * (numFds + numInts));
-    native_handle_t* h = static_cast<native_handle_t*>(malloc(mallocSize));
+    native_handle_t* h = handle_alloc(numFds + numInts);
     if (h) {
         h->version = sizeof(native_handle_t);
         h->numFds = numFds;
@@ -144,7 +263,7 @@ native_handle_t* native_handle_clone(const native_handle_t* handle) {
 int native_handle_delete(native_handle_t* h) {
     if (h) {
         if (h->version != sizeof(native_handle_t)) return -EINVAL;
-        free(h);
+        handle_free(h);
     }
     return 0;
 }
@@ -16,6 +16,11 @@
 
 #include <cutils/native_handle.h>
 
+#include <stdlib.h>
+
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 TEST(native_handle, native_handle_delete) {
@@ -25,3 +30,58 @@ TEST(native_handle, native_handle_delete) {
 TEST(native_handle, native_handle_close) {
     ASSERT_EQ(0, native_handle_close(nullptr));
 }
+
+TEST(native_handle, native_handle_create_delete_reuse) {
+    // Repeated create/delete cycles of mixed sizes must always hand out a
+    // correctly initialized handle with room for every fd and int.
+    for (int round = 0; round < 16; round++) {
+        for (int numInts : {0, 3, 8, 20, 60, 200}) {
+            native_handle_t* h = native_handle_create(1, numInts);
+            ASSERT_NE(nullptr, h);
+            EXPECT_EQ(static_cast<int>(sizeof(native_handle_t)), h->version);
+            EXPECT_EQ(1, h->numFds);
+            EXPECT_EQ(numInts, h->numInts);
+            h->data[0] = -1;
+            for (int i = 0; i < numInts; i++) h->data[1 + i] = i;
+            ASSERT_EQ(0, native_handle_delete(h));
+        }
+    }
+}
+
+TEST(native_handle, native_handle_delete_malloced) {
+    // Some callers allocate handles themselves; deleting those must not
+    // let a later, larger create() reuse a block that is too small.
+    native_handle_t* h =
+            static_cast<native_handle_t*>(malloc(sizeof(native_handle_t) + sizeof(int)));
+    ASSERT_NE(nullptr, h);
+    h->version = sizeof(native_handle_t);
+    h->numFds = 0;
+    h->numInts = 1;
+    ASSERT_EQ(0, native_handle_delete(h));
+
+    native_handle_t* big = native_handle_create(0, 64);
+    ASSERT_NE(nullptr, big);
+    for (int i = 0; i < 64; i++) big->data[i] = i;
+    ASSERT_EQ(0, native_handle_delete(big));
+}
+
+TEST(native_handle, native_handle_free) {
+    // Handles from native_handle_create() remain plain malloc() blocks.
+    native_handle_t* h = native_handle_create(0, 4);
+    ASSERT_NE(nullptr, h);
+    free(h);
+}
+
+TEST(native_handle, native_handle_threads) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([] {
+            for (int i = 0; i < 1000; i++) {
+                native_handle_t* h = native_handle_create(0, i % 40);
+                ASSERT_NE(nullptr, h);
+                ASSERT_EQ(0, native_handle_delete(h));
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+}
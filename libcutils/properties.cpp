@@ -22,31 +22,60 @@
 #include <string.h>
 #include <unistd.h>
 
-#include <android-base/properties.h>
+#include <limits>
+#include <mutex>
+#include <string>
 
-int8_t property_get_bool(const char* key, int8_t default_value) {
-    if (!key) return default_value;
-
-    int8_t result = default_value;
-    char buf[PROPERTY_VALUE_MAX] = {};
+#include <android-base/properties.h>
 
-    int len = property_get(key, buf, "");
+// Returns 1 or 0 for a boolean |buf| of |len| characters, or -1 if it is not one.
+static int8_t parse_bool(const char* buf, int len) {
     if (len == 1) {
         char ch = buf[0];
         if (ch == '0' || ch == 'n') {
-            result = false;
+            return false;
         } else if (ch == '1' || ch == 'y') {
-            result = true;
+            return true;
         }
     } else if (len > 1) {
         if (!strcmp(buf, "no") || !strcmp(buf, "false") || !strcmp(buf, "off")) {
-            result = false;
+            return false;
         } else if (!strcmp(buf, "yes") || !strcmp(buf, "true") || !strcmp(buf, "on")) {
-            result = true;
+            return true;
         }
     }
+    return -1;
+}
+
+static bool parse_int(const char* value, intmax_t* result) {
+    if (!*value) return false;
+
+    // libcutils unwisely allows octal, which libbase doesn't.
+    int saved_errno = errno;
+    errno = 0;
+    char* end = nullptr;
+    *result = strtoimax(value, &end, 0);
+    bool ok = errno != ERANGE && end != value;
+    errno = saved_errno;
+    return ok;
+}
+
+template <typename T>
+static T int_or_default(bool valid, intmax_t v, T default_value) {
+    if (valid && v >= std::numeric_limits<T>::min() && v <= std::numeric_limits<T>::max()) {
+        return v;
+    }
+    return default_value;
+}
+
+int8_t property_get_bool(const char* key, int8_t default_value) {
+    if (!key) return default_value;
+
+    char buf[PROPERTY_VALUE_MAX] = {};
 
-    return result;
+    int len = property_get(key, buf, "");
+    int8_t result = parse_bool(buf, len);
+    return result < 0 ? default_value : result;
 }
 
 template <typename T>
@@ -56,18 +85,9 @@ static T property_get_int(const char* key, T default_value) {
     char value[PROPERTY_VALUE_MAX] = {};
     if (property_get(key, value, "") < 1) return default_value;
 
-    // libcutils unwisely allows octal, which libbase doesn't.
-    T result = default_value;
-    int saved_errno = errno;
-    errno = 0;
-    char* end = nullptr;
-    intmax_t v = strtoimax(value, &end, 0);
-    if (errno != ERANGE && end != value && v >= std::numeric_limits<T>::min() &&
-        v <= std::numeric_limits<T>::max()) {
-        result = v;
-    }
-    errno = saved_errno;
-    return result;
+    intmax_t v;
+    bool valid = parse_int(value, &v);
+    return int_or_default(valid, v, default_value);
 }
 
 int64_t property_get_int64(const char* key, int64_t default_value) {
@@ -116,3 +136,117 @@ int property_list(void (*fn)(const char* name, const char* value, void* cookie),
 }
 
 #endif
+
+struct cached_property {
+    explicit cached_property(const char* key) : key(key) {}
+
+    std::mutex lock;
+    const std::string key;
+#if __has_include(<sys/system_properties.h>)
+    const prop_info* pi = nullptr;
+    // The serial of |pi| when |value| was read, or of the property area when the property was
+    // last found to be missing.
+    uint32_t serial = 0;
+    bool valid = false;
+#endif
+    char value[PROPERTY_VALUE_MAX] = {};
+    int len = 0;
+    // |value| parsed when it was read.
+    int8_t bool_value = -1;
+    bool int_valid = false;
+    intmax_t int_value = 0;
+};
+
+struct cached_property* cached_property_create(const char* key) {
+    if (!key) return nullptr;
+    return new cached_property(key);
+}
+
+void cached_property_destroy(struct cached_property* prop) {
+    delete prop;
+}
+
+#if __has_include(<sys/system_properties.h>)
+
+static void cached_property_read_callback(void* cookie, const char* /*name*/, const char* value,
+                                          unsigned serial) {
+    auto prop = reinterpret_cast<cached_property*>(cookie);
+    prop->len = snprintf(prop->value, sizeof(prop->value), "%s", value);
+    prop->serial = serial;
+}
+
+// Brings the cached value up to date. Called with |prop->lock| held.
+static void cached_property_update(cached_property* prop) {
+    if (!prop->pi) {
+        // Until the property exists, only look it up again when a property was added.
+        uint32_t area_serial = __system_property_area_serial();
+        if (prop->valid && area_serial == prop->serial) return;
+        prop->pi = __system_property_find(prop->key.c_str());
+        if (!prop->pi) {
+            prop->serial = area_serial;
+            prop->value[0] = '\0';
+            prop->len = 0;
+        }
+    } else if (prop->valid && __system_property_serial(prop->pi) == prop->serial) {
+        return;
+    }
+
+    if (prop->pi) {
+        __system_property_read_callback(prop->pi, cached_property_read_callback, prop);
+    }
+    prop->bool_value = parse_bool(prop->value, prop->len);
+    prop->int_valid = parse_int(prop->value, &prop->int_value);
+    prop->valid = true;
+}
+
+#else
+
+static void cached_property_update(cached_property* prop) {
+    prop->len = property_get(prop->key.c_str(), prop->value, "");
+    prop->bool_value = parse_bool(prop->value, prop->len);
+    prop->int_valid = parse_int(prop->value, &prop->int_value);
+}
+
+#endif
+
+int cached_property_get(struct cached_property* prop, char* value, const char* default_value) {
+    if (prop) {
+        std::lock_guard<std::mutex> guard(prop->lock);
+        cached_property_update(prop);
+        if (prop->len > 0) {
+            memcpy(value, prop->value, prop->len + 1);
+            return prop->len;
+        }
+    }
+    if (default_value) {
+        snprintf(value, PROPERTY_VALUE_MAX, "%s", default_value);
+        return strlen(value);
+    }
+    value[0] = '\0';
+    return 0;
+}
+
+int8_t cached_property_get_bool(struct cached_property* prop, int8_t default_value) {
+    if (!prop) return default_value;
+
+    std::lock_guard<std::mutex> guard(prop->lock);
+    cached_property_update(prop);
+    return prop->bool_value < 0 ? default_value : prop->bool_value;
+}
+
+template <typename T>
+static T cached_property_get_int(struct cached_property* prop, T default_value) {
+    if (!prop) return default_value;
+
+    std::lock_guard<std::mutex> guard(prop->lock);
+    cached_property_update(prop);
+    return int_or_default(prop->int_valid, prop->int_value, default_value);
+}
+
+int64_t cached_property_get_int64(struct cached_property* prop, int64_t default_value) {
+    return cached_property_get_int<int64_t>(prop, default_value);
+}
+
+int32_t cached_property_get_int32(struct cached_property* prop, int32_t default_value) {
+    return cached_property_get_int<int32_t>(prop, default_value);
+}
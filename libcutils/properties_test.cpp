@@ -376,4 +376,74 @@ TEST_F(PropertiesTest, property_get_int32) {
     }
 }
 
+TEST_F(PropertiesTest, cached_property_tracks_changes) {
+    // The property doesn't exist yet when the handle is created.
+    struct cached_property* prop = cached_property_create(PROPERTY_TEST_KEY);
+    ASSERT_NE(nullptr, prop);
+
+    EXPECT_EQ(0, cached_property_get(prop, mValue, NULL));
+    EXPECT_STREQ("", mValue);
+    EXPECT_EQ(3, cached_property_get(prop, mValue, "def"));
+    EXPECT_STREQ("def", mValue);
+
+    ASSERT_OK(property_set(PROPERTY_TEST_KEY, "hello"));
+    EXPECT_EQ(5, cached_property_get(prop, mValue, "def"));
+    EXPECT_STREQ("hello", mValue);
+    EXPECT_EQ(5, cached_property_get(prop, mValue, "def"));
+    EXPECT_STREQ("hello", mValue);
+
+    ASSERT_OK(property_set(PROPERTY_TEST_KEY, "true"));
+    EXPECT_EQ(1, cached_property_get_bool(prop, false));
+    EXPECT_EQ(-1, cached_property_get_int32(prop, -1));
+
+    ASSERT_OK(property_set(PROPERTY_TEST_KEY, "0x10"));
+    EXPECT_EQ(-1, cached_property_get_bool(prop, -1));
+    EXPECT_EQ(16, cached_property_get_int32(prop, -1));
+    EXPECT_EQ(16, cached_property_get_int64(prop, -1));
+
+    ASSERT_OK(property_set(PROPERTY_TEST_KEY, ""));
+    EXPECT_EQ(3, cached_property_get(prop, mValue, "def"));
+    EXPECT_STREQ("def", mValue);
+    EXPECT_EQ(-1, cached_property_get_int32(prop, -1));
+
+    cached_property_destroy(prop);
+}
+
+TEST_F(PropertiesTest, cached_property_matches_property_get) {
+    struct cached_property* prop = cached_property_create(PROPERTY_TEST_KEY);
+    ASSERT_NE(nullptr, prop);
+
+    const std::string intMaxString = ToString(INT32_MAX);
+    const std::string intStringOverflow = intMaxString + "0";
+    const char* setValues[] = {
+        "1", "0", "y", "n", "yes", "no", "on", "off", "true", "false", "-12345", "0xC0FFEE",
+        "01234", "  +0   ", intMaxString.c_str(), intStringOverflow.c_str(), "hello", " ",
+    };
+    for (const char* value : setValues) {
+        ASSERT_OK(property_set(PROPERTY_TEST_KEY, value));
+
+        char expected[PROPERTY_VALUE_MAX];
+        EXPECT_EQ(property_get(PROPERTY_TEST_KEY, expected, "def"),
+                  cached_property_get(prop, mValue, "def"));
+        EXPECT_STREQ(expected, mValue);
+        EXPECT_EQ(property_get_bool(PROPERTY_TEST_KEY, 2), cached_property_get_bool(prop, 2))
+                << "Property was set to '" << value << "'";
+        EXPECT_EQ(property_get_int32(PROPERTY_TEST_KEY, 7), cached_property_get_int32(prop, 7))
+                << "Property was set to '" << value << "'";
+        EXPECT_EQ(property_get_int64(PROPERTY_TEST_KEY, 7), cached_property_get_int64(prop, 7))
+                << "Property was set to '" << value << "'";
+    }
+
+    cached_property_destroy(prop);
+}
+
+TEST_F(PropertiesTest, cached_property_null) {
+    EXPECT_EQ(nullptr, cached_property_create(NULL));
+    EXPECT_EQ(3, cached_property_get(NULL, mValue, "def"));
+    EXPECT_STREQ("def", mValue);
+    EXPECT_EQ(1, cached_property_get_bool(NULL, true));
+    EXPECT_EQ(42, cached_property_get_int32(NULL, 42));
+    cached_property_destroy(NULL);
+}
+
 } // namespace android
@@ -46,8 +46,23 @@ static void *released_pointer;
 
 struct str_parms {
     Hashmap *map;
+    /* The copy of the string given to str_parms_create_str(), with its keys
+     * and values terminated in place. Keys and values that point into it are
+     * freed along with it rather than one by one.
+     */
+    char *buffer;
+    size_t buffer_size;
 };
 
+static void free_string(struct str_parms *str_parms, void *str)
+{
+    char *p = static_cast<char*>(str);
+    if (str_parms->buffer && p >= str_parms->buffer &&
+            p < str_parms->buffer + str_parms->buffer_size)
+        return;
+    free(str);
+}
+
 
 static bool str_eq(void *key_a, void *key_b)
 {
@@ -67,12 +82,12 @@ static int str_hash_fn(void *str)
     return (int)hash;
 }
 
-struct str_parms *str_parms_create(void)
+static struct str_parms *str_parms_create_with_capacity(size_t capacity)
 {
     str_parms* s = static_cast<str_parms*>(calloc(1, sizeof(str_parms)));
     if (!s) return NULL;
 
-    s->map = hashmapCreate(5, str_hash_fn, str_eq);
+    s->map = hashmapCreate(capacity, str_hash_fn, str_eq);
     if (!s->map) {
         free(s);
         return NULL;
@@ -81,6 +96,11 @@ struct str_parms *str_parms_create(void)
     return s;
 }
 
+struct str_parms *str_parms_create(void)
+{
+    return str_parms_create_with_capacity(5);
+}
+
 struct remove_ctxt {
     struct str_parms *str_parms;
     const char *key;
@@ -111,8 +131,8 @@ static bool remove_pair(void *key, void *value, void *context)
 
 do_remove:
     hashmapRemove(ctxt->str_parms->map, key);
-    free(key);
-    free(value);
+    free_string(ctxt->str_parms, key);
+    free_string(ctxt->str_parms, value);
     return should_continue;
 }
 
@@ -133,6 +153,7 @@ void str_parms_destroy(struct str_parms *str_parms)
 
     hashmapForEach(str_parms->map, remove_pair, &ctxt);
     hashmapFree(str_parms->map);
+    free(str_parms->buffer);
     free(str_parms);
 }
 
@@ -143,14 +164,22 @@ struct str_parms *str_parms_create_str(const char *_string)
     char *kvpair;
     char *tmpstr;
     int items = 0;
+    size_t capacity = 1;
 
-    str_parms = str_parms_create();
+    for (const char *p = _string; *p; p++) {
+        if (*p == ';')
+            capacity++;
+    }
+
+    str_parms = str_parms_create_with_capacity(capacity);
     if (!str_parms)
         goto err_create_str_parms;
 
-    str = strdup(_string);
+    str_parms->buffer_size = strlen(_string) + 1;
+    str = str_parms->buffer = static_cast<char*>(malloc(str_parms->buffer_size));
     if (!str)
         goto err_strdup;
+    memcpy(str, _string, str_parms->buffer_size);
 
     ALOGV("%s: source string == '%s'\n", __func__, _string);
 
@@ -164,26 +193,18 @@ struct str_parms *str_parms_create_str(const char *_string)
         if (eq == kvpair)
             goto next_pair;
 
+        key = kvpair;
         if (eq) {
-            key = strndup(kvpair, eq - kvpair);
-            if (*(++eq))
-                value = strdup(eq);
-            else
-                value = strdup("");
+            *eq = '\0';
+            value = eq + 1;
         } else {
-            key = strdup(kvpair);
-            value = strdup("");
+            value = kvpair + strlen(kvpair);
         }
 
-        /* if we replaced a value, free it */
+        /* if we replaced a value, free it; the map keeps the first key */
         old_val = hashmapPut(str_parms->map, key, value);
-        RELEASE_OWNERSHIP(value);
-        if (old_val) {
-            free(old_val);
-            free(key);
-        } else {
-            RELEASE_OWNERSHIP(key);
-        }
+        if (old_val)
+            free_string(str_parms, old_val);
 
         items++;
 next_pair:
@@ -193,8 +214,6 @@ next_pair:
     if (!items)
         ALOGV("%s: no items found in string\n", __func__);
 
-    free(str);
-
     return str_parms;
 
 err_strdup:
@@ -245,7 +264,8 @@ int str_parms_add_str(struct str_parms *str_parms, const char *key,
 clean_up:
     free(tmp_key);
     free(tmp_val);
-    free(old_val);
+    if (old_val)
+        free_string(str_parms, old_val);
     int result = -errno;
     errno = saved_errno;
     return result;
@@ -328,34 +348,41 @@ int str_parms_get_float(struct str_parms *str_parms, const char *key,
     return 0;
 }
 
-static bool combine_strings(void *key, void *value, void *context)
+static bool measure_pair(void *key, void *value, void *context)
 {
-    char** old_str = static_cast<char**>(context);
-    char *new_str;
-    int ret;
-
-    ret = asprintf(&new_str, "%s%s%s=%s",
-                   *old_str ? *old_str : "",
-                   *old_str ? ";" : "",
-                   (char *)key,
-                   (char *)value);
-    if (*old_str)
-        free(*old_str);
-
-    if (ret >= 0) {
-        *old_str = new_str;
-        return true;
-    }
+    size_t *len = static_cast<size_t*>(context);
+    *len += strlen((char *)key) + 1 + strlen((char *)value) + 1;
+    return true;
+}
 
-    *old_str = NULL;
-    return false;
+static bool append_pair(void *key, void *value, void *context)
+{
+    char **end = static_cast<char**>(context);
+    size_t key_len = strlen((char *)key);
+    size_t value_len = strlen((char *)value);
+
+    memcpy(*end, key, key_len);
+    (*end)[key_len] = '=';
+    memcpy(*end + key_len + 1, value, value_len);
+    (*end)[key_len + 1 + value_len] = ';';
+    *end += key_len + 1 + value_len + 1;
+    return true;
 }
 
 char *str_parms_to_str(struct str_parms *str_parms)
 {
-    char *str = NULL;
-    hashmapForEach(str_parms->map, combine_strings, &str);
-    return (str != NULL) ? str : strdup("");
+    /* Size the result first, so that it is built with one allocation. */
+    size_t len = 0;
+    hashmapForEach(str_parms->map, measure_pair, &len);
+    char *str = static_cast<char*>(malloc(len > 0 ? len : 1));
+    if (!str)
+        return NULL;
+
+    char *end = str;
+    hashmapForEach(str_parms->map, append_pair, &end);
+    /* Replace the last ';' with the terminator. */
+    str[len > 0 ? len - 1 : 0] = '\0';
+    return str;
 }
 
 static bool dump_entry(void* key, void* value, void* /*context*/) {
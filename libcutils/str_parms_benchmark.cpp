@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <cutils/str_parms.h>
+
+// A set_parameters() style string with the given number of pairs.
+static std::string MakeParams(size_t count) {
+    std::string params;
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) params += ';';
+        params += "audio_param_" + std::to_string(i) + "=" + std::to_string(i * 1000);
+    }
+    return params;
+}
+
+static void BM_str_parms_create_str(benchmark::State& state) {
+    std::string params = MakeParams(state.range(0));
+    for (auto _ : state) {
+        str_parms* parms = str_parms_create_str(params.c_str());
+        benchmark::DoNotOptimize(parms);
+        str_parms_destroy(parms);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_str_parms_create_str)->Range(1, 256);
+
+static void BM_str_parms_get_int(benchmark::State& state) {
+    std::string params = MakeParams(state.range(0));
+    str_parms* parms = str_parms_create_str(params.c_str());
+    std::string key = "audio_param_" + std::to_string(state.range(0) / 2);
+    for (auto _ : state) {
+        int value;
+        benchmark::DoNotOptimize(str_parms_get_int(parms, key.c_str(), &value));
+    }
+    str_parms_destroy(parms);
+}
+BENCHMARK(BM_str_parms_get_int)->Range(1, 256);
+
+static void BM_str_parms_to_str(benchmark::State& state) {
+    std::string params = MakeParams(state.range(0));
+    str_parms* parms = str_parms_create_str(params.c_str());
+    for (auto _ : state) {
+        char* str = str_parms_to_str(parms);
+        benchmark::DoNotOptimize(str);
+        free(str);
+    }
+    str_parms_destroy(parms);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_str_parms_to_str)->Range(1, 256);
+
+BENCHMARK_MAIN();
@@ -17,6 +17,8 @@
 #include <cutils/str_parms.h>
 #include <gtest/gtest.h>
 
+#include <string>
+
 static void test_str_parms_str(const char* str, const char* expected) {
     str_parms* str_parms = str_parms_create_str(str);
     str_parms_add_str(str_parms, "dude", "woah");
@@ -55,3 +57,49 @@ TEST(str_parms, put_ENOMEM) {
     ASSERT_EQ(ENOMEM, errno);
     test_str_parms_str("foo=bar;baz=", "foo=bar;baz=");
 }
+
+TEST(str_parms, replace_and_delete) {
+    str_parms* str_parms = str_parms_create_str("a=1;b=2;c=3");
+    // Replace values that were parsed, and values that were added.
+    ASSERT_EQ(0, str_parms_add_str(str_parms, "b", "two"));
+    ASSERT_EQ(0, str_parms_add_str(str_parms, "b", "deux"));
+    ASSERT_EQ(0, str_parms_add_int(str_parms, "d", 4));
+    str_parms_del(str_parms, "a");
+    ASSERT_EQ(0, str_parms_add_str(str_parms, "a", "one"));
+
+    char value[16];
+    ASSERT_EQ(4, str_parms_get_str(str_parms, "b", value, sizeof(value)));
+    EXPECT_STREQ("deux", value);
+    int i;
+    ASSERT_EQ(0, str_parms_get_int(str_parms, "c", &i));
+    EXPECT_EQ(3, i);
+    EXPECT_EQ(-ENOENT, str_parms_get_str(str_parms, "e", value, sizeof(value)));
+
+    // Keys keep their place when their value is replaced, and go to the end when re-added.
+    char* out_str = str_parms_to_str(str_parms);
+    EXPECT_STREQ("b=deux;c=3;d=4;a=one", out_str);
+    free(out_str);
+    str_parms_destroy(str_parms);
+}
+
+TEST(str_parms, many_keys) {
+    str_parms* str_parms = str_parms_create();
+    std::string expected;
+    for (int i = 0; i < 1000; i++) {
+        std::string key = "key" + std::to_string(i);
+        ASSERT_EQ(0, str_parms_add_int(str_parms, key.c_str(), i));
+        if (i % 3 == 0) {
+            str_parms_del(str_parms, key.c_str());
+        } else {
+            expected += (expected.empty() ? "" : ";") + key + "=" + std::to_string(i);
+        }
+    }
+    for (int i = 0; i < 1000; i++) {
+        std::string key = "key" + std::to_string(i);
+        EXPECT_EQ(i % 3 != 0, str_parms_has_key(str_parms, key.c_str()) != 0) << key;
+    }
+    char* out_str = str_parms_to_str(str_parms);
+    EXPECT_EQ(expected, out_str);
+    free(out_str);
+    str_parms_destroy(str_parms);
+}
@@ -190,7 +190,7 @@ void atrace_begin_body(const char* name)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("B|%d|", "%s", "", name, "");
+    atrace_write_event('B', name, false, 0);
 }
 
 void atrace_end_body()
@@ -202,7 +202,7 @@ void atrace_end_body()
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("E|%d", "%s", "", "", "");
+    atrace_write_event('E', nullptr, false, 0);
 }
 
 void atrace_async_begin_body(const char* name, int32_t cookie)
@@ -214,7 +214,7 @@ void atrace_async_begin_body(const char* name, int32_t cookie)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("S|%d|", "|%" PRId32, "", name, cookie);
+    atrace_write_event('S', name, true, cookie);
 }
 
 void atrace_async_end_body(const char* name, int32_t cookie)
@@ -226,7 +226,7 @@ void atrace_async_end_body(const char* name, int32_t cookie)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("F|%d|", "|%" PRId32, "", name, cookie);
+    atrace_write_event('F', name, true, cookie);
 }
 
 void atrace_async_for_track_begin_body(const char* track_name, const char* name, int32_t cookie) {
@@ -248,7 +248,7 @@ void atrace_async_for_track_end_body(const char* track_name, int32_t cookie) {
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("H|%d|", "|%" PRId32, "", track_name, cookie);
+    atrace_write_event('H', track_name, true, cookie);
 }
 
 void atrace_instant_body(const char* name) {
@@ -259,7 +259,7 @@ void atrace_instant_body(const char* name) {
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("I|%d|", "%s", "", name, "");
+    atrace_write_event('I', name, false, 0);
 }
 
 void atrace_instant_for_track_body(const char* track_name, const char* name) {
@@ -282,7 +282,7 @@ void atrace_int_body(const char* name, int32_t value)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("C|%d|", "|%" PRId32, "", name, value);
+    atrace_write_event('C', name, true, value);
 }
 
 void atrace_int64_body(const char* name, int64_t value)
@@ -294,5 +294,5 @@ void atrace_int64_body(const char* name, int64_t value)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("C|%d|", "|%" PRId64, "", name, value);
+    atrace_write_event('C', name, true, value);
 }
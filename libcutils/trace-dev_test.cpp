@@ -572,6 +572,19 @@ TEST_F(TraceDevTest, atrace_int64_body_normal) {
   ASSERT_STREQ(expected.c_str(), actual.c_str());
 }
 
+TEST_F(TraceDevTest, atrace_int64_body_negative) {
+  atrace_int64_body("fake_name", INT64_MIN);
+  atrace_int_body("fake_name", -1);
+
+  ASSERT_EQ(0, lseek(atrace_marker_fd, 0, SEEK_SET));
+
+  std::string actual;
+  ASSERT_TRUE(android::base::ReadFdToString(atrace_marker_fd, &actual));
+  std::string expected = android::base::StringPrintf(
+      "C|%d|fake_name|-9223372036854775808C|%d|fake_name|-1", getpid(), getpid());
+  ASSERT_STREQ(expected.c_str(), actual.c_str());
+}
+
 TEST_F(TraceDevTest, atrace_int64_body_exact) {
   std::string expected = android::base::StringPrintf("C|%d|", getpid());
   std::string name = MakeName(ATRACE_MESSAGE_LENGTH - expected.length() - 13);
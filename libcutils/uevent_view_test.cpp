@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/uevent_view.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using android::UeventView;
+
+TEST(uevent_view, fields) {
+    const char msg[] =
+            "add@/devices/virtual/block/loop0\0"
+            "ACTION=add\0"
+            "DEVPATH=/devices/virtual/block/loop0\0"
+            "SUBSYSTEM=block\0"
+            "MAJOR=7\0"
+            "EMPTY=\0"
+            "SEQNUM=1234";
+    UeventView uevent(msg, sizeof(msg));
+
+    EXPECT_EQ("add@/devices/virtual/block/loop0", uevent.header());
+
+    std::vector<std::pair<std::string, std::string>> fields;
+    for (const auto& [key, value] : uevent) {
+        fields.emplace_back(key, value);
+    }
+    std::vector<std::pair<std::string, std::string>> expected = {
+            {"ACTION", "add"},        {"DEVPATH", "/devices/virtual/block/loop0"},
+            {"SUBSYSTEM", "block"},   {"MAJOR", "7"},
+            {"EMPTY", ""},            {"SEQNUM", "1234"},
+    };
+    EXPECT_EQ(expected, fields);
+
+    EXPECT_EQ("block", uevent.Find("SUBSYSTEM"));
+    EXPECT_EQ("", uevent.Find("FIRMWARE"));
+    // a key must match completely, not just as a prefix
+    EXPECT_EQ("", uevent.Find("SUB"));
+}
+
+TEST(uevent_view, points_into_buffer) {
+    const char msg[] = "change@/x\0KEY=value";
+    UeventView uevent(msg, sizeof(msg) - 1);
+    std::string_view value = uevent.Find("KEY");
+    EXPECT_EQ("value", value);
+    EXPECT_EQ(msg + 14, value.data());
+}
+
+TEST(uevent_view, unterminated) {
+    // The last entry may run to the end of the buffer without a '\0'.
+    const char msg[] = {'A', '=', '1', '\0', 'B', '=', '2'};
+    UeventView uevent(msg, sizeof(msg));
+    EXPECT_EQ("", uevent.header());
+    EXPECT_EQ("1", uevent.Find("A"));
+    EXPECT_EQ("2", uevent.Find("B"));
+}
+
+TEST(uevent_view, empty) {
+    UeventView uevent("", 0);
+    EXPECT_TRUE(uevent.begin() == uevent.end());
+    EXPECT_EQ("", uevent.header());
+}
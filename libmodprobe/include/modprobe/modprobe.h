@@ -62,8 +62,28 @@ class Modprobe {
     bool ParseBlocklistCallback(const std::vector<std::string>& args);
     void ParseKernelCmdlineOptions();
     void ParseCfg(const std::string& cfg, std::function<bool(const std::vector<std::string>&)> f);
+    void BuildAliasIndex();
+    void FindAliasedModules(const std::string& name, std::set<uint32_t>* modules) const;
 
-    std::vector<std::pair<std::string, std::string>> module_aliases_;
+    struct AliasModule {
+        std::string name;
+        std::string canonical_name;
+    };
+    // Node of the alias index, a trie over the literal prefix of every alias
+    // pattern, ie. up to its first wildcard.
+    struct AliasTrieNode {
+        std::vector<std::pair<char, uint32_t>> children;
+        // Aliases without wildcards that end here.
+        std::vector<uint32_t> exact;
+        // Aliases whose first wildcard follows this prefix.
+        std::vector<uint32_t> wildcard;
+    };
+
+    // Alias patterns, and the index of their module in alias_modules_.
+    std::vector<std::pair<std::string, uint32_t>> module_aliases_;
+    std::vector<AliasModule> alias_modules_;
+    std::unordered_map<std::string, uint32_t> alias_module_ids_;
+    std::vector<AliasTrieNode> alias_trie_;
     std::unordered_map<std::string, std::vector<std::string>> module_deps_;
     std::vector<std::pair<std::string, std::string>> module_pre_softdep_;
     std::vector<std::pair<std::string, std::string>> module_post_softdep_;
@@ -21,8 +21,11 @@
 #include <sys/syscall.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <set>
+#include <shared_mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -106,7 +109,12 @@ bool Modprobe::ParseAliasCallback(const std::vector<std::string>& args) {
 
     const std::string& alias = *it++;
     const std::string& module_name = *it++;
-    this->module_aliases_.emplace_back(alias, module_name);
+    // Modules usually have many aliases; store each name once.
+    auto [id, inserted] = alias_module_ids_.emplace(module_name, alias_modules_.size());
+    if (inserted) {
+        alias_modules_.push_back({module_name, MakeCanonical(module_name)});
+    }
+    this->module_aliases_.emplace_back(alias, id->second);
 
     return true;
 }
@@ -346,6 +354,67 @@ Modprobe::Modprobe(const std::vector<std::string>& base_paths, const std::string
         AddOption("tcpci_max77759", "disable_cc_toggling_by_default", "1");
         AddOption("pogo_transport", "charging_only_by_default", "1");
     }
+
+    BuildAliasIndex();
+}
+
+// Coldboot resolves thousands of modaliases, and most alias patterns start
+// with a long literal prefix ("pci:v00008086d..."). Rather than running
+// fnmatch() against every alias, walk a trie of those prefixes so that only
+// the aliases sharing a prefix with the name need to be matched.
+void Modprobe::BuildAliasIndex() {
+    alias_trie_.clear();
+    alias_trie_.emplace_back();
+    for (uint32_t i = 0; i < module_aliases_.size(); i++) {
+        const std::string& alias = module_aliases_[i].first;
+        size_t prefix_len = std::min(alias.find_first_of("*?[\\"), alias.size());
+
+        uint32_t node = 0;
+        for (size_t j = 0; j < prefix_len; j++) {
+            auto& children = alias_trie_[node].children;
+            auto child = std::find_if(children.begin(), children.end(),
+                                      [&](const auto& entry) { return entry.first == alias[j]; });
+            if (child != children.end()) {
+                node = child->second;
+                continue;
+            }
+            children.emplace_back(alias[j], alias_trie_.size());
+            node = alias_trie_.size();
+            alias_trie_.emplace_back();
+        }
+        if (prefix_len == alias.size()) {
+            alias_trie_[node].exact.emplace_back(i);
+        } else {
+            alias_trie_[node].wildcard.emplace_back(i);
+        }
+    }
+    alias_module_ids_.clear();
+}
+
+void Modprobe::FindAliasedModules(const std::string& name, std::set<uint32_t>* modules) const {
+    uint32_t node = 0;
+    for (size_t depth = 0;; depth++) {
+        const auto& entry = alias_trie_[node];
+        for (uint32_t i : entry.wildcard) {
+            // The literal prefix already matched, so only match the rest.
+            const auto& [alias, module] = module_aliases_[i];
+            if (!fnmatch(alias.c_str() + depth, name.c_str() + depth, 0)) {
+                modules->emplace(module);
+            }
+        }
+        if (depth == name.size()) {
+            for (uint32_t i : entry.exact) {
+                modules->emplace(module_aliases_[i].second);
+            }
+            return;
+        }
+        auto child = std::find_if(entry.children.begin(), entry.children.end(),
+                                  [&](const auto& c) { return c.first == name[depth]; });
+        if (child == entry.children.end()) {
+            return;
+        }
+        node = child->second;
+    }
 }
 
 std::vector<std::string> Modprobe::GetDependencies(const std::string& module) {
@@ -403,8 +472,11 @@ bool Modprobe::InsmodWithDeps(const std::string& module_name, const std::string&
 bool Modprobe::LoadWithAliases(const std::string& module_name, bool strict,
                                const std::string& parameters) {
     auto canonical_name = MakeCanonical(module_name);
-    if (module_loaded_.count(canonical_name)) {
-        return true;
+    {
+        std::lock_guard guard(module_loaded_lock_);
+        if (module_loaded_.count(canonical_name)) {
+            return true;
+        }
     }
 
     std::set<std::string> modules_to_load = {canonical_name};
@@ -412,11 +484,16 @@ bool Modprobe::LoadWithAliases(const std::string& module_name, bool strict,
 
     // use aliases to expand list of modules to load (multiple modules
     // may alias themselves to the requested name)
-    for (const auto& [alias, aliased_module] : module_aliases_) {
-        if (fnmatch(alias.c_str(), module_name.c_str(), 0) != 0) continue;
-        LOG(VERBOSE) << "Found alias for '" << module_name << "': '" << aliased_module;
-        if (module_loaded_.count(MakeCanonical(aliased_module))) continue;
-        modules_to_load.emplace(aliased_module);
+    std::set<uint32_t> aliased_modules;
+    FindAliasedModules(module_name, &aliased_modules);
+    for (uint32_t id : aliased_modules) {
+        const auto& aliased_module = alias_modules_[id];
+        LOG(VERBOSE) << "Found alias for '" << module_name << "': '" << aliased_module.name;
+        {
+            std::lock_guard guard(module_loaded_lock_);
+            if (module_loaded_.count(aliased_module.canonical_name)) continue;
+        }
+        modules_to_load.emplace(aliased_module.name);
     }
 
     // attempt to load all modules aliased to this name
@@ -445,110 +522,138 @@ bool Modprobe::IsBlocklisted(const std::string& module_name) {
     return module_blocklist_.count(canonical_name) > 0;
 }
 
-// Another option to load kernel modules. load independent modules dependencies
-// in parallel and then update dependency list of other remaining modules,
-// repeat these steps until all modules are loaded.
+// Another option to load kernel modules. Every listed module and each of its hard dependencies
+// is a node of a dependency graph, and a node is loaded by the next free thread as soon as all of
+// its hard dependencies have been loaded, so no module waits for unrelated ones to finish. Modules
+// with the load_sequential=1 option are loaded while no other module is being loaded.
 // Discard all blocklist.
 // Softdeps are taken care in InsmodWithDeps().
 bool Modprobe::LoadModulesParallel(int num_threads) {
-    bool ret = true;
-    std::unordered_map<std::string, std::vector<std::string>> mod_with_deps;
+    struct Node {
+        bool visited = false;
+        bool sequential = false;
+        size_t pending_deps = 0;
+        std::vector<std::string> dependents;
+    };
+    std::unordered_map<std::string, Node> graph;
 
     // Get dependencies
+    std::vector<std::string> to_visit;
     for (const auto& module : module_load_) {
         // Skip blocklist modules
         if (IsBlocklisted(module)) {
             LOG(VERBOSE) << "LMP: Blocklist: Module " << module << " skipping...";
             continue;
         }
-        auto dependencies = GetDependencies(MakeCanonical(module));
-        if (dependencies.empty()) {
+        auto canonical_name = MakeCanonical(module);
+        if (GetDependencies(canonical_name).empty()) {
             LOG(ERROR) << "LMP: Hard-dep: Module " << module
                        << " not in .dep file";
             return false;
         }
-        mod_with_deps[MakeCanonical(module)] = dependencies;
-    }
-
-    while (!mod_with_deps.empty()) {
-        std::vector<std::thread> threads;
-        std::vector<std::string> mods_path_to_load;
-        std::mutex vector_lock;
+        to_visit.emplace_back(canonical_name);
+    }
+    while (!to_visit.empty()) {
+        auto module = std::move(to_visit.back());
+        to_visit.pop_back();
+        auto& node = graph[module];
+        if (node.visited) continue;
+        node.visited = true;
+
+        std::string str = "load_sequential=1";
+        if (auto options = module_options_.find(module); options != module_options_.end()) {
+            if (auto it = options->second.find(str); it != std::string::npos) {
+                options->second.erase(it, str.size());
+                node.sequential = true;
+            }
+        }
 
-        // Find independent modules
-        for (const auto& [it_mod, it_dep] : mod_with_deps) {
-            auto itd_last = it_dep.rbegin();
-            if (itd_last == it_dep.rend())
-                continue;
+        // The first entry is the module itself.
+        std::set<std::string> hard_deps;
+        auto dependencies = GetDependencies(module);
+        for (size_t i = 1; i < dependencies.size(); ++i) {
+            hard_deps.emplace(MakeCanonical(dependencies[i]));
+        }
+        hard_deps.erase(module);
 
-            auto cnd_last = MakeCanonical(*itd_last);
+        node.pending_deps = hard_deps.size();
+        for (const auto& dep : hard_deps) {
             // Hard-dependencies cannot be blocklisted
-            if (IsBlocklisted(cnd_last)) {
-                LOG(ERROR) << "LMP: Blocklist: Module-dep " << cnd_last
-                           << " : failed to load module " << it_mod;
+            if (IsBlocklisted(dep)) {
+                LOG(ERROR) << "LMP: Blocklist: Module-dep " << dep
+                           << " : failed to load module " << module;
                 return false;
             }
+            graph[dep].dependents.emplace_back(module);
+            to_visit.emplace_back(dep);
+        }
+    }
 
-            std::string str = "load_sequential=1";
-            auto it = module_options_[cnd_last].find(str);
-            if (it != std::string::npos) {
-                module_options_[cnd_last].erase(it, it + str.size());
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<std::string> ready;
+    size_t remaining = graph.size();
+    size_t loading = 0;
+    bool failed = false;
+    // Held exclusively while loading a load_sequential=1 module.
+    std::shared_mutex load_lock;
+
+    for (const auto& [module, node] : graph) {
+        if (node.pending_deps == 0) ready.emplace_back(module);
+    }
+
+    auto thread_function = [&] {
+        std::unique_lock lk(lock);
+        while (true) {
+            cv.wait(lk, [&] { return failed || remaining == 0 || !ready.empty() || loading == 0; });
+            if (failed || remaining == 0) return;
+            if (ready.empty()) {
+                LOG(ERROR) << "LMP: Dependency cycle among the " << remaining
+                           << " modules left to load";
+                failed = true;
+                cv.notify_all();
+                return;
+            }
 
-                if (!LoadWithAliases(cnd_last, true)) {
-                    return false;
-                }
+            auto module = std::move(ready.front());
+            ready.pop_front();
+            const auto& node = graph[module];
+            loading++;
+            lk.unlock();
+
+            bool loaded;
+            if (node.sequential) {
+                std::unique_lock load_guard(load_lock);
+                loaded = LoadWithAliases(module, true);
             } else {
-                if (std::find(mods_path_to_load.begin(), mods_path_to_load.end(),
-                            cnd_last) == mods_path_to_load.end()) {
-                    mods_path_to_load.emplace_back(cnd_last);
-                }
+                std::shared_lock load_guard(load_lock);
+                loaded = LoadWithAliases(module, true);
             }
-        }
-
-        // Load independent modules in parallel
-        auto thread_function = [&] {
-            std::unique_lock lk(vector_lock);
-            while (!mods_path_to_load.empty()) {
-                auto ret_load = true;
-                auto mod_to_load = std::move(mods_path_to_load.back());
-                mods_path_to_load.pop_back();
 
-                lk.unlock();
-                ret_load &= LoadWithAliases(mod_to_load, true);
-                lk.lock();
-                if (!ret_load) {
-                    ret &= ret_load;
+            lk.lock();
+            loading--;
+            if (!loaded) {
+                failed = true;
+            } else {
+                remaining--;
+                for (const auto& dependent : node.dependents) {
+                    if (--graph[dependent].pending_deps == 0) ready.emplace_back(dependent);
                 }
             }
-        };
-
-        std::generate_n(std::back_inserter(threads), num_threads,
-                        [&] { return std::thread(thread_function); });
-
-        // Wait for the threads.
-        for (auto& thread : threads) {
-            thread.join();
+            cv.notify_all();
         }
+    };
 
-        if (!ret) return ret;
+    std::vector<std::thread> threads;
+    std::generate_n(std::back_inserter(threads), std::max(num_threads, 1),
+                    [&] { return std::thread(thread_function); });
 
-        std::lock_guard guard(module_loaded_lock_);
-        // Remove loaded module form mod_with_deps and soft dependencies of other modules
-        for (const auto& module_loaded : module_loaded_)
-            mod_with_deps.erase(module_loaded);
-
-        // Remove loaded module form dependencies of other modules which are not loaded yet
-        for (const auto& module_loaded_path : module_loaded_paths_) {
-            for (auto& [mod, deps] : mod_with_deps) {
-                auto it = std::find(deps.begin(), deps.end(), module_loaded_path);
-                if (it != deps.end()) {
-                    deps.erase(it);
-                }
-            }
-        }
+    // Wait for the threads.
+    for (auto& thread : threads) {
+        thread.join();
     }
 
-    return ret;
+    return !failed;
 }
 
 bool Modprobe::LoadListedModules(bool strict) {
@@ -219,3 +219,92 @@ TEST(libmodprobe, ModuleDepLineWithoutColonIsSkipped) {
     Modprobe m({dir.path});
     EXPECT_FALSE(m.LoadWithAliases("no_colon", true));
 }
+
+TEST(libmodprobe, LoadModulesParallelLoadsDependenciesFirst) {
+    TemporaryDir dir;
+    auto dir_path = std::string(dir.path);
+    ASSERT_TRUE(android::base::WriteStringToFile("mod_a.ko: mod_b.ko mod_c.ko\n"
+                                                 "mod_b.ko: mod_c.ko\n"
+                                                 "mod_c.ko:\n"
+                                                 "mod_d.ko:\n"
+                                                 "mod_e.ko: mod_d.ko\n",
+                                                 dir_path + "/modules.dep", 0600, getuid(),
+                                                 getgid()));
+    ASSERT_TRUE(android::base::WriteStringToFile("mod_a.ko\nmod_e.ko\n", dir_path + "/modules.load",
+                                                 0600, getuid(), getgid()));
+
+    kernel_cmdline = "";
+    test_modules.clear();
+    for (const auto& module : {"mod_a", "mod_b", "mod_c", "mod_d", "mod_e"}) {
+        test_modules.emplace_back(dir_path + "/" + module + ".ko");
+    }
+    modules_loaded.clear();
+
+    // The test Insmod() isn't thread-safe, so this only checks the order the graph is walked in.
+    Modprobe m({dir.path}, "modules.load", false);
+    EXPECT_TRUE(m.LoadModulesParallel(1));
+    EXPECT_EQ(5, m.GetModuleCount());
+
+    auto position = [&](const std::string& module) {
+        return std::find(modules_loaded.begin(), modules_loaded.end(),
+                         dir_path + "/" + module + ".ko") -
+               modules_loaded.begin();
+    };
+    EXPECT_LT(position("mod_c"), position("mod_b"));
+    EXPECT_LT(position("mod_b"), position("mod_a"));
+    EXPECT_LT(position("mod_d"), position("mod_e"));
+}
+
+TEST(libmodprobe, LoadModulesParallelFailsOnModuleMissingFromDep) {
+    TemporaryDir dir;
+    auto dir_path = std::string(dir.path);
+    ASSERT_TRUE(android::base::WriteStringToFile("mod_a.ko:\n", dir_path + "/modules.dep", 0600,
+                                                 getuid(), getgid()));
+    ASSERT_TRUE(android::base::WriteStringToFile("mod_a.ko\nmod_b.ko\n", dir_path + "/modules.load",
+                                                 0600, getuid(), getgid()));
+
+    kernel_cmdline = "";
+    test_modules = {dir_path + "/mod_a.ko"};
+    modules_loaded.clear();
+
+    Modprobe m({dir.path}, "modules.load", false);
+    EXPECT_FALSE(m.LoadModulesParallel(4));
+    EXPECT_TRUE(modules_loaded.empty());
+}
+
+TEST(libmodprobe, LoadWithWildcardAliases) {
+    TemporaryDir dir;
+    auto dir_path = std::string(dir.path);
+    ASSERT_TRUE(android::base::WriteStringToFile("mod_a.ko:\nmod_b.ko:\nmod_c.ko:\nmod_d.ko:\n",
+                                                 dir_path + "/modules.dep", 0600, getuid(),
+                                                 getgid()));
+    ASSERT_TRUE(android::base::WriteStringToFile("alias pci:v00008086d*sv*sd* mod_a\n"
+                                                 "alias pci:v00008086d00001234* mod_b\n"
+                                                 "alias pci:v000010DEd* mod_c\n"
+                                                 "alias *:foo mod_c\n"
+                                                 "alias pci:v00008086 mod_d\n",
+                                                 dir_path + "/modules.alias", 0600, getuid(),
+                                                 getgid()));
+
+    kernel_cmdline = "";
+    test_modules.clear();
+    for (const auto& module : {"mod_a", "mod_b", "mod_c", "mod_d"}) {
+        test_modules.emplace_back(dir_path + "/" + module + ".ko");
+    }
+    modules_loaded.clear();
+
+    Modprobe m({dir.path}, "modules.load", false);
+    EXPECT_TRUE(m.LoadWithAliases("pci:v00008086d00001234sv00000000sd00000000", true));
+    std::vector<std::string> expected = {dir_path + "/mod_a.ko", dir_path + "/mod_b.ko"};
+    EXPECT_EQ(modules_loaded, expected);
+
+    EXPECT_FALSE(m.LoadWithAliases("pci:v00008087d00001234sv00000000sd00000000", true));
+    EXPECT_FALSE(m.LoadWithAliases("pci:v0000808", true));
+    EXPECT_EQ(modules_loaded, expected);
+
+    EXPECT_TRUE(m.LoadWithAliases("usb:foo", true));
+    EXPECT_TRUE(m.LoadWithAliases("pci:v00008086", true));
+    expected.emplace_back(dir_path + "/mod_c.ko");
+    expected.emplace_back(dir_path + "/mod_d.ko");
+    EXPECT_EQ(modules_loaded, expected);
+}
@@ -78,6 +78,30 @@ bool packagelist_parse(bool (*callback)(pkg_info* info, void* user_data), void*
 bool packagelist_parse_file(const char* path, bool (*callback)(pkg_info* info, void* user_data),
                             void* user_data);
 
+/**
+ * Finds the package called `name` in the system's default package list.
+ * Lines for other packages are skipped without being fully parsed.
+ * Returns a `pkg_info*` the caller owns and should free with packagelist_free(),
+ * or NULL if the package isn't listed (errno is 0) or the list couldn't be read or parsed
+ * (errno is set).
+ */
+pkg_info* packagelist_find_by_name(const char* name);
+
+/** Like packagelist_find_by_name(), but searches the given package list. */
+pkg_info* packagelist_find_by_name_file(const char* path, const char* name);
+
+/**
+ * Finds the first package with the given `uid` in the system's default package list.
+ * Lines for other uids are skipped without being fully parsed.
+ * Returns a `pkg_info*` the caller owns and should free with packagelist_free(),
+ * or NULL if no package has that uid (errno is 0) or the list couldn't be read or parsed
+ * (errno is set).
+ */
+pkg_info* packagelist_find_by_uid(uid_t uid);
+
+/** Like packagelist_find_by_uid(), but searches the given package list. */
+pkg_info* packagelist_find_by_uid_file(const char* path, uid_t uid);
+
 /** Frees the given `pkg_info`. */
 void packagelist_free(pkg_info* info);
 
@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/limits.h>
 
@@ -117,8 +118,74 @@ bool packagelist_parse_file(const char* path, bool (*callback)(pkg_info*, void*)
   return true;
 }
 
+static constexpr const char* kPackageListPath = "/data/system/packages.list";
+
 bool packagelist_parse(bool (*callback)(pkg_info*, void*), void* user_data) {
-  return packagelist_parse_file("/data/system/packages.list", callback, user_data);
+  return packagelist_parse_file(kPackageListPath, callback, user_data);
+}
+
+// Returns the first package whose line satisfies `matches`, which only sees
+// the raw line so that non-matching lines never pay for sscanf and allocation.
+template <typename Predicate>
+static pkg_info* find_in_file(const char* path, Predicate matches) {
+  std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(path, "re"), &fclose);
+  if (!fp) {
+    ALOGE("couldn't open '%s': %s", path, strerror(errno));
+    return nullptr;
+  }
+
+  size_t line_number = 0;
+  char* line = nullptr;
+  size_t allocated_length = 0;
+  pkg_info* result = nullptr;
+  errno = 0;
+  while (getline(&line, &allocated_length, fp.get()) > 0) {
+    ++line_number;
+    if (!matches(line)) continue;
+
+    std::unique_ptr<pkg_info, decltype(&packagelist_free)> info(
+        static_cast<pkg_info*>(calloc(1, sizeof(pkg_info))), &packagelist_free);
+    if (!info) {
+      ALOGE("%s:%zu: couldn't allocate pkg_info", path, line_number);
+      errno = ENOMEM;
+      break;
+    }
+    if (parse_line(path, line_number, line, info.get())) {
+      result = info.release();
+    } else {
+      errno = EINVAL;
+    }
+    break;
+  }
+  int saved_errno = errno;
+  free(line);
+  errno = saved_errno;
+  return result;
+}
+
+pkg_info* packagelist_find_by_name_file(const char* path, const char* name) {
+  size_t name_length = strlen(name);
+  return find_in_file(path, [name, name_length](const char* line) {
+    return !strncmp(line, name, name_length) && line[name_length] == ' ';
+  });
+}
+
+pkg_info* packagelist_find_by_name(const char* name) {
+  return packagelist_find_by_name_file(kPackageListPath, name);
+}
+
+pkg_info* packagelist_find_by_uid_file(const char* path, uid_t uid) {
+  return find_in_file(path, [uid](const char* line) {
+    const char* uid_field = strchr(line, ' ');
+    if (!uid_field) return false;
+    char* end;
+    unsigned long line_uid = strtoul(uid_field + 1, &end, 10);
+    return end != uid_field + 1 && *end == ' ' && line_uid == uid;
+  });
+}
+
+pkg_info* packagelist_find_by_uid(uid_t uid) {
+  return packagelist_find_by_uid_file(kPackageListPath, uid);
 }
 
 void packagelist_free(pkg_info* info) {
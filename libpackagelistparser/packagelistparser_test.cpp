@@ -16,6 +16,8 @@
 
 #include <packagelistparser/packagelistparser.h>
 
+#include <errno.h>
+
 #include <memory>
 
 #include <android-base/file.h>
@@ -115,6 +117,49 @@ TEST(packagelistparser, early_exit) {
   for (auto& package : packages) packagelist_free(package);
 }
 
+TEST(packagelistparser, find_by_name) {
+  TemporaryFile tf;
+  android::base::WriteStringToFile(
+      "com.test.a 10001 0 /data/user/0/com.test.a a none\n"
+      "com.test.ab 10002 1 /data/user/0/com.test.ab b 1023\n"
+      "com.test.abc 10003 0 /data/user/0/com.test.abc c none\n",
+      tf.path);
+
+  std::unique_ptr<pkg_info, decltype(&packagelist_free)> info(
+      packagelist_find_by_name_file(tf.path, "com.test.ab"), &packagelist_free);
+  ASSERT_NE(nullptr, info);
+  ASSERT_STREQ("com.test.ab", info->name);
+  ASSERT_EQ(10002, info->uid);
+  ASSERT_TRUE(info->debuggable);
+  ASSERT_STREQ("/data/user/0/com.test.ab", info->data_dir);
+  ASSERT_EQ(1U, info->gids.cnt);
+  ASSERT_EQ(1023U, info->gids.gids[0]);
+
+  ASSERT_EQ(nullptr, packagelist_find_by_name_file(tf.path, "com.test"));
+  ASSERT_EQ(nullptr, packagelist_find_by_name_file(tf.path, "com.test.abcd"));
+  ASSERT_EQ(0, errno);
+
+  ASSERT_EQ(nullptr, packagelist_find_by_name_file("/does/not/exist", "com.test.a"));
+  ASSERT_EQ(ENOENT, errno);
+}
+
+TEST(packagelistparser, find_by_uid) {
+  TemporaryFile tf;
+  android::base::WriteStringToFile(
+      "com.test.a 10001 0 / a none\n"
+      "com.test.b 100011 0 / b none\n"
+      "com.test.c 10011 0 / c none\n",
+      tf.path);
+
+  std::unique_ptr<pkg_info, decltype(&packagelist_free)> info(
+      packagelist_find_by_uid_file(tf.path, 10011), &packagelist_free);
+  ASSERT_NE(nullptr, info);
+  ASSERT_STREQ("com.test.c", info->name);
+  ASSERT_EQ(10011, info->uid);
+
+  ASSERT_EQ(nullptr, packagelist_find_by_uid_file(tf.path, 1001));
+}
+
 TEST(packagelistparser, system_package_list) {
   // Check that we can actually read the packages.list installed on the device.
   std::vector<pkg_info*> packages;
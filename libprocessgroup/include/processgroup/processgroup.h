@@ -49,6 +49,14 @@ bool SetProcessProfiles(uid_t uid, pid_t pid, std::initializer_list<std::string_
 bool SetTaskProfiles(pid_t tid, std::span<const std::string_view> profiles,
                      bool use_fd_cache = false);
 bool SetProcessProfiles(uid_t uid, pid_t pid, std::span<const std::string_view> profiles);
+// Apply the profiles to many threads, or many processes of one uid, at once. Each action runs for
+// the whole batch in one go, so a cgroup file is opened once for all of them rather than once per
+// thread.
+bool SetTaskProfiles(std::span<const pid_t> tids, std::initializer_list<std::string_view> profiles,
+                     bool use_fd_cache = false);
+bool SetProcessProfiles(uid_t uid, std::span<const pid_t> pids,
+                        std::initializer_list<std::string_view> profiles,
+                        bool use_fd_cache = false);
 #endif
 
 __BEGIN_DECLS
@@ -66,6 +74,10 @@ bool UsePerAppMemcg();
 // should be active again. E.g. Zygote specialization for child process.
 void DropTaskProfilesResourceCaching();
 
+// Compile the task profiles json files into a file that processes map instead of parsing the json
+// files. Used by init after setting up cgroups.
+bool WriteTaskProfilesRcFile();
+
 // Return 0 if all processes were killed and the cgroup was successfully removed.
 // Returns -1 in the case of an error occurring or if there are processes still running.
 int killProcessGroup(uid_t uid, pid_t initialPid, int signal);
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -63,6 +64,13 @@ extern int set_cpuset_policy(int tid, SchedPolicy policy);
  */
 extern int set_sched_policy(int tid, SchedPolicy policy);
 
+/* Same as set_sched_policy(), for each of the count threads in tids. The task profile for the
+ * policy is only looked up once, and the cgroup fds it uses stay cached, so this is cheaper than
+ * calling set_sched_policy() in a loop when moving many threads at once.
+ * Return value: 0 if every thread was moved, or -1 if any of them failed.
+ */
+extern int set_sched_policy_tids(const int* tids, size_t count, SchedPolicy policy);
+
 /* Return the policy associated with the cgroup of thread tid via policy pointer.
  * On platforms which support gettid(), zero tid means current thread.
  * Return value: 0 for success, or -1 for error and set errno.
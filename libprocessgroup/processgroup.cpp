@@ -37,6 +37,7 @@
 #include <mutex>
 #include <set>
 #include <string>
+#include <string_view>
 #include <thread>
 
 #include <android-base/file.h>
@@ -171,6 +172,10 @@ void DropTaskProfilesResourceCaching() {
     TaskProfiles::GetInstance().DropResourceCaching(ProfileAction::RCT_PROCESS);
 }
 
+bool WriteTaskProfilesRcFile() {
+    return TaskProfiles::WriteCompiledFile();
+}
+
 bool SetProcessProfiles(uid_t uid, pid_t pid, const std::vector<std::string>& profiles) {
     return TaskProfiles::GetInstance().SetProcessProfiles(
             uid, pid, std::span<const std::string>(profiles), false);
@@ -205,6 +210,18 @@ bool SetTaskProfiles(pid_t tid, std::span<const std::string_view> profiles, bool
     return TaskProfiles::GetInstance().SetTaskProfiles(tid, profiles, use_fd_cache);
 }
 
+bool SetTaskProfiles(std::span<const pid_t> tids, std::initializer_list<std::string_view> profiles,
+                     bool use_fd_cache) {
+    return TaskProfiles::GetInstance().SetTaskProfiles(
+            tids, std::span<const std::string_view>(profiles), use_fd_cache);
+}
+
+bool SetProcessProfiles(uid_t uid, std::span<const pid_t> pids,
+                        std::initializer_list<std::string_view> profiles, bool use_fd_cache) {
+    return TaskProfiles::GetInstance().SetProcessProfiles(
+            uid, pids, std::span<const std::string_view>(profiles), use_fd_cache);
+}
+
 // C wrapper for SetProcessProfiles.
 // No need to have this in the header file because this function is specifically for crosvm. Crosvm
 // which is written in Rust has its own declaration of this foreign function and doesn't rely on the
@@ -318,8 +335,11 @@ void removeAllEmptyProcessGroups() {
  * Process groups are primarily created by the Zygote, meaning that uid/pid groups are created by
  * the user root. Ownership for the newly created cgroup and all of its files must thus be
  * transferred for the user/group passed as uid/gid before system_server can properly access them.
+ * If |created| is not null, it is set to whether the directory was created by this call.
  */
-static bool MkdirAndChown(const std::string& path, mode_t mode, uid_t uid, gid_t gid) {
+static bool MkdirAndChown(const std::string& path, mode_t mode, uid_t uid, gid_t gid,
+                          bool* created = nullptr) {
+    if (created) *created = false;
     if (mkdir(path.c_str(), mode) == -1) {
         if (errno == EEXIST) {
             // Directory already exists and permissions have been set at the time it was created
@@ -335,25 +355,26 @@ static bool MkdirAndChown(const std::string& path, mode_t mode, uid_t uid, gid_t
         goto err;
     }
 
+    // A new cgroup has a few dozen files; change them relative to the directory rather than
+    // resolving the full path of each one in cgroupfs.
     struct dirent* dir_entry;
     while ((dir_entry = readdir(dir.get()))) {
         if (!strcmp("..", dir_entry->d_name)) {
             continue;
         }
 
-        std::string file_path = path + "/" + dir_entry->d_name;
-
-        if (lchown(file_path.c_str(), uid, gid) < 0) {
-            PLOG(ERROR) << "lchown failed for " << file_path;
+        if (fchownat(dirfd(dir.get()), dir_entry->d_name, uid, gid, AT_SYMLINK_NOFOLLOW) < 0) {
+            PLOG(ERROR) << "lchown failed for " << path << "/" << dir_entry->d_name;
             goto err;
         }
 
-        if (fchmodat(AT_FDCWD, file_path.c_str(), mode, AT_SYMLINK_NOFOLLOW) != 0) {
-            PLOG(ERROR) << "fchmodat failed for " << file_path;
+        if (fchmodat(dirfd(dir.get()), dir_entry->d_name, mode, AT_SYMLINK_NOFOLLOW) != 0) {
+            PLOG(ERROR) << "fchmodat failed for " << path << "/" << dir_entry->d_name;
             goto err;
         }
     }
 
+    if (created) *created = true;
     return true;
 err:
     int saved_errno = errno;
@@ -363,13 +384,16 @@ err:
     return false;
 }
 
-bool sendSignalToProcessGroup(uid_t uid, pid_t initialPid, int signal) {
+// Signals the processes of the cgroup at |cgroup_v2_path|, or only the process group of
+// |initialPid| if that is null because cgroups are not available. |kill_fd| is an open cgroup.kill
+// file of the cgroup, or -1 to open it here, so that callers that signal the same cgroup
+// repeatedly only open it once.
+static bool SendSignalToCgroup(uid_t uid, pid_t initialPid, int signal,
+                               const std::string* cgroup_v2_path_ptr, int kill_fd) {
     std::set<pid_t> pgids, pids;
 
-    if (CgroupsAvailable()) {
-        std::string hierarchy_root_path, cgroup_v2_path;
-        CgroupGetControllerPath(CGROUPV2_HIERARCHY_NAME, &hierarchy_root_path);
-        cgroup_v2_path = ConvertUidPidToPath(hierarchy_root_path.c_str(), uid, initialPid);
+    if (cgroup_v2_path_ptr != nullptr) {
+        const std::string& cgroup_v2_path = *cgroup_v2_path_ptr;
 
         if (signal == SIGKILL && CgroupKillAvailable()) {
             LOG(VERBOSE) << "Using " << PROCESSGROUP_CGROUP_KILL_FILE << " to SIGKILL "
@@ -383,7 +407,8 @@ bool sendSignalToProcessGroup(uid_t uid, pid_t initialPid, int signal) {
             }
 
             const std::string killfilepath = cgroup_v2_path + '/' + PROCESSGROUP_CGROUP_KILL_FILE;
-            if (WriteStringToFile("1", killfilepath)) {
+            if (kill_fd >= 0 ? TEMP_FAILURE_RETRY(pwrite(kill_fd, "1", 1, 0)) == 1
+                             : WriteStringToFile("1", killfilepath)) {
                 return true;
             } else {
                 PLOG(ERROR) << "Failed to write 1 to " << killfilepath;
@@ -466,6 +491,18 @@ bool sendSignalToProcessGroup(uid_t uid, pid_t initialPid, int signal) {
     return true;
 }
 
+bool sendSignalToProcessGroup(uid_t uid, pid_t initialPid, int signal) {
+    if (!CgroupsAvailable()) {
+        return SendSignalToCgroup(uid, initialPid, signal, nullptr, -1);
+    }
+
+    std::string hierarchy_root_path;
+    CgroupGetControllerPath(CGROUPV2_HIERARCHY_NAME, &hierarchy_root_path);
+    const std::string cgroup_v2_path =
+            ConvertUidPidToPath(hierarchy_root_path.c_str(), uid, initialPid);
+    return SendSignalToCgroup(uid, initialPid, signal, &cgroup_v2_path, -1);
+}
+
 template <typename T>
 static std::chrono::milliseconds toMillisec(T&& duration) {
     return std::chrono::duration_cast<std::chrono::milliseconds>(duration);
@@ -479,12 +516,11 @@ enum class populated_status
 };
 
 static populated_status cgroupIsPopulated(int events_fd) {
-    const std::string POPULATED_KEY("populated ");
-    const std::string::size_type MAX_EVENTS_FILE_SIZE = 32;
+    constexpr std::string_view POPULATED_KEY("populated ");
+    constexpr size_t MAX_EVENTS_FILE_SIZE = 32;
 
-    std::string buf;
-    buf.resize(MAX_EVENTS_FILE_SIZE);
-    ssize_t len = TEMP_FAILURE_RETRY(pread(events_fd, buf.data(), buf.size(), 0));
+    char data[MAX_EVENTS_FILE_SIZE];
+    ssize_t len = TEMP_FAILURE_RETRY(pread(events_fd, data, sizeof(data), 0));
     if (len == -1) {
         PLOG(ERROR) << "Could not read cgroup.events: ";
         // Potentially ENODEV if the cgroup has been removed since we opened this file, but that
@@ -497,10 +533,9 @@ static populated_status cgroupIsPopulated(int events_fd) {
         return populated_status::error;
     }
 
-    buf.resize(len);
-
-    const std::string::size_type pos = buf.find(POPULATED_KEY);
-    if (pos == std::string::npos) {
+    const std::string_view buf(data, len);
+    const size_t pos = buf.find(POPULATED_KEY);
+    if (pos == std::string_view::npos) {
         LOG(ERROR) << "Could not find populated key in cgroup.events";
         return populated_status::error;
     }
@@ -529,12 +564,14 @@ static int KillProcessGroup(
         return -1;
     }
 
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
     // Always attempt to send a kill signal to at least the initialPid, at least once, regardless of
     // whether its cgroup exists or not. This should only be necessary if a bug results in the
     // migration of the targeted process out of its cgroup, which we will also attempt to kill.
-    const bool signal_ret = sendSignalToProcessGroup(uid, initialPid, signal);
-
-    if (!CgroupsAvailable() || !signal_ret) return signal_ret ? 0 : -1;
+    if (!CgroupsAvailable()) {
+        return SendSignalToCgroup(uid, initialPid, signal, nullptr, -1) ? 0 : -1;
+    }
 
     std::string hierarchy_root_path;
     CgroupGetControllerPath(CGROUPV2_HIERARCHY_NAME, &hierarchy_root_path);
@@ -542,8 +579,19 @@ static int KillProcessGroup(
     const std::string cgroup_v2_path =
             ConvertUidPidToPath(hierarchy_root_path.c_str(), uid, initialPid);
 
+    // Keep cgroup.kill open for the signals that are resent while waiting below.
+    android::base::unique_fd kill_fd;
+    if (signal == SIGKILL && CgroupKillAvailable()) {
+        const std::string killfile = cgroup_v2_path + '/' + PROCESSGROUP_CGROUP_KILL_FILE;
+        kill_fd.reset(TEMP_FAILURE_RETRY(open(killfile.c_str(), O_WRONLY | O_CLOEXEC)));
+    }
+
+    if (!SendSignalToCgroup(uid, initialPid, signal, &cgroup_v2_path, kill_fd.get())) {
+        return -1;
+    }
+
     const std::string eventsfile = cgroup_v2_path + '/' + PROCESSGROUP_CGROUP_EVENTS_FILE;
-    android::base::unique_fd events_fd(open(eventsfile.c_str(), O_RDONLY));
+    android::base::unique_fd events_fd(open(eventsfile.c_str(), O_RDONLY | O_CLOEXEC));
     if (events_fd.get() == -1) {
         PLOG(WARNING) << "Error opening " << eventsfile << " for KillProcessGroup";
         return -1;
@@ -554,8 +602,6 @@ static int KillProcessGroup(
         .events = POLLPRI,
     };
 
-    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
-
     // The primary reason to loop here is to capture any new forks or migrations that could occur
     // after we send signals to the original set of processes, but before all of those processes
     // exit and the cgroup becomes unpopulated, or before we remove the cgroup. We try hard to
@@ -564,20 +610,26 @@ static int KillProcessGroup(
     // contention, and the amount of work that needs to be done in do_exit for each process
     // determines how long this will take.
     int ret;
+    bool signalled = true;
     do {
         populated_status populated;
         while ((populated = cgroupIsPopulated(events_fd.get())) == populated_status::populated &&
                std::chrono::steady_clock::now() < until) {
 
-            sendSignalToProcessGroup(uid, initialPid, signal);
+            // The signals were only just sent when this is first reached, so resending them
+            // before waiting would find nothing new.
+            if (!signalled) {
+                SendSignalToCgroup(uid, initialPid, signal, &cgroup_v2_path, kill_fd.get());
+            }
+            signalled = false;
             if (once) {
-                populated = cgroupIsPopulated(events_fd.get());
                 break;
             }
 
             const std::chrono::steady_clock::time_point poll_start =
                     std::chrono::steady_clock::now();
 
+            ret = 0;
             if (poll_start < until)
                 ret = TEMP_FAILURE_RETRY(poll(&fds, 1, toMillisec(until - poll_start).count()));
 
@@ -610,7 +662,9 @@ static int KillProcessGroup(
         if (ret)
             PLOG(ERROR) << "Unable to remove cgroup " << cgroup_v2_path;
         else
-            LOG(INFO) << "Removed cgroup " << cgroup_v2_path;
+            LOG(INFO) << "Removed cgroup " << cgroup_v2_path << " "
+                      << toMillisec(std::chrono::steady_clock::now() - start).count()
+                      << " ms after signalling it";
 
         if (isMemoryCgroupSupported() && UsePerAppMemcg()) {
             // This per-application memcg v1 case should eventually be removed after migration to
@@ -657,14 +711,19 @@ static int createProcessGroupInternal(uid_t uid, pid_t initialPid, std::string c
         cgroup_gid = cgroup_stat.st_gid;
     }
 
-    if (!MkdirAndChown(uid_path, cgroup_mode, cgroup_uid, cgroup_gid)) {
+    bool uid_path_created;
+    if (!MkdirAndChown(uid_path, cgroup_mode, cgroup_uid, cgroup_gid, &uid_path_created)) {
         PLOG(ERROR) << "Failed to make and chown " << uid_path;
         return -errno;
     }
-    if (activate_controllers) {
+    // Only the call creating the uid cgroup activates its controllers. Writing subtree_control
+    // takes the global cgroup lock even when nothing changes, and this runs on every app start.
+    if (activate_controllers && uid_path_created) {
         ret = CgroupMap::GetInstance().ActivateControllers(uid_path);
         if (ret) {
             LOG(ERROR) << "Failed to activate controllers in " << uid_path;
+            // Let the next process of this uid try again, unless it is already in use.
+            rmdir(uid_path.c_str());
             return ret;
         }
     }
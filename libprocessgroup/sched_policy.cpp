@@ -22,12 +22,22 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 #include <android-base/threads.h>
+#include <android-base/unique_fd.h>
 #include <cgroup_map.h>
 #include <processgroup/processgroup.h>
 
 using android::base::GetThreadId;
+using android::base::StringPrintf;
+using android::base::unique_fd;
 
 /* Re-map SP_DEFAULT to the system default policy, and leave other values unchanged.
  * Call this any place a SchedPolicy is used as an input parameter.
@@ -136,6 +146,16 @@ int set_sched_policy(pid_t tid, SchedPolicy policy) {
     return 0;
 }
 
+int set_sched_policy_tids(const int* tids, size_t count, SchedPolicy policy) {
+    const char* name = get_sched_policy_profile_name(_policy(policy));
+    if (name == nullptr) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return SetTaskProfiles(std::span<const pid_t>(tids, count), {name}, true) ? 0 : -1;
+}
+
 bool cpusets_enabled() {
     static bool enabled = (CgroupMap::GetInstance().FindController("cpuset").IsUsable());
     return enabled;
@@ -155,18 +175,94 @@ bool schedboost_enabled() {
     return enabled;
 }
 
-static int getCGroupSubsys(pid_t tid, const char* subsys, std::string& subgroup) {
+namespace {
+
+// How a controller's line in /proc/<tid>/cgroup starts. The cgroup map does not change once it is
+// loaded, so this is only worked out once per controller.
+struct TaskGroupTag {
+    bool usable = false;
+    std::string tag;
+};
+
+TaskGroupTag MakeTaskGroupTag(const char* subsys) {
+    TaskGroupTag result;
     auto controller = CgroupMap::GetInstance().FindController(subsys);
+    if (controller.IsUsable()) {
+        result.usable = true;
+        result.tag = controller.version() == 2 ? "0::" : StringPrintf(":%s:", controller.name());
+    }
+    return result;
+}
 
-    if (!controller.IsUsable()) return -1;
+const TaskGroupTag& SchedtuneTag() {
+    static const TaskGroupTag tag = MakeTaskGroupTag("schedtune");
+    return tag;
+}
 
-    if (!controller.GetTaskGroup(tid, &subgroup))
-        return -1;
+const TaskGroupTag& CpuTag() {
+    static const TaskGroupTag tag = MakeTaskGroupTag("cpu");
+    return tag;
+}
 
-    return 0;
+const TaskGroupTag& CpusetTag() {
+    static const TaskGroupTag tag = MakeTaskGroupTag("cpuset");
+    return tag;
 }
 
-static int get_sched_policy_from_group(const std::string& group, SchedPolicy* policy) {
+// The contents of /proc/<tid>/cgroup. The file is read once for all of the controllers, and only
+// needs an allocation if it doesn't fit on the stack.
+class TaskCgroups {
+  public:
+    bool Read(pid_t tid) {
+        char path[32];
+        snprintf(path, sizeof(path), "/proc/%d/cgroup", tid);
+        unique_fd fd(TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC)));
+        if (fd < 0) {
+            PLOG(ERROR) << "Failed to read " << path;
+            return false;
+        }
+        size_t size = 0;
+        while (size < sizeof(buf_)) {
+            ssize_t n = TEMP_FAILURE_RETRY(read(fd, buf_ + size, sizeof(buf_) - size));
+            if (n < 0) {
+                PLOG(ERROR) << "Failed to read " << path;
+                return false;
+            }
+            if (n == 0) {
+                content_ = std::string_view(buf_, size);
+                return true;
+            }
+            size += n;
+        }
+        if (!android::base::ReadFileToString(path, &overflow_)) {
+            PLOG(ERROR) << "Failed to read " << path;
+            return false;
+        }
+        content_ = overflow_;
+        return true;
+    }
+
+    // Same as CgroupController::GetTaskGroup().
+    bool GetGroup(const TaskGroupTag& tag, std::string_view* group) const {
+        if (!tag.usable) return false;
+        size_t start = content_.find(tag.tag);
+        if (start == std::string_view::npos) return false;
+
+        start = std::min(start + tag.tag.size() + 1, content_.size());  // skip '/'
+        size_t end = content_.find('\n', start);
+        *group = content_.substr(start, end == std::string_view::npos ? end : end - start);
+        return true;
+    }
+
+  private:
+    char buf_[1024];
+    std::string overflow_;
+    std::string_view content_;
+};
+
+}  // namespace
+
+static int get_sched_policy_from_group(std::string_view group, SchedPolicy* policy) {
     if (group.empty()) {
         *policy = SP_FOREGROUND;
     } else if (group == "foreground") {
@@ -191,24 +287,30 @@ int get_sched_policy(pid_t tid, SchedPolicy* policy) {
         tid = GetThreadId();
     }
 
-    std::string group;
-    if (schedboost_enabled()) {
-        if ((getCGroupSubsys(tid, "schedtune", group) < 0) &&
-            (getCGroupSubsys(tid, "cpu", group) < 0)) {
+    const bool schedboost = schedboost_enabled();
+    const bool cpusets = cpusets_enabled();
+    TaskCgroups cgroups;
+    if ((schedboost || cpusets) && !cgroups.Read(tid)) {
+        return -1;
+    }
+
+    std::string_view group;
+    if (schedboost) {
+        if (!cgroups.GetGroup(SchedtuneTag(), &group) && !cgroups.GetGroup(CpuTag(), &group)) {
             LOG(ERROR) << "Failed to find cpu cgroup for tid " << tid;
             return -1;
         }
         // Wipe invalid group to fallback to cpuset
         if (!group.empty()) {
             if (get_sched_policy_from_group(group, policy) < 0) {
-                group.clear();
+                group = {};
             } else {
                 return 0;
             }
         }
     }
 
-    if (cpusets_enabled() && getCGroupSubsys(tid, "cpuset", group) < 0) {
+    if (cpusets && !cgroups.GetGroup(CpusetTag(), &group)) {
         LOG(ERROR) << "Failed to find cpuset cgroup for tid " << tid;
         return -1;
     }
@@ -223,6 +325,10 @@ int set_sched_policy(int, SchedPolicy) {
     return 0;
 }
 
+int set_sched_policy_tids(const int*, size_t, SchedPolicy) {
+    return 0;
+}
+
 int get_sched_policy(int, SchedPolicy* policy) {
     *policy = SP_SYSTEM_DEFAULT;
     return 0;
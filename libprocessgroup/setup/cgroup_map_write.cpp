@@ -29,12 +29,18 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <android/cgrouprc.h>
 #include <json/reader.h>
@@ -47,7 +53,9 @@
 #include "cgroup_descriptor.h"
 
 using android::base::GetUintProperty;
+using android::base::StartsWith;
 using android::base::StringPrintf;
+using android::base::Timer;
 using android::base::unique_fd;
 
 namespace android {
@@ -275,6 +283,42 @@ static bool ReadDescriptors(std::map<std::string, CgroupDescriptor>* descriptors
     return true;
 }
 
+// Enables |controllers| in the cgroup.subtree_control file of |path|. The kernel applies a space
+// separated list of controllers all or nothing, so they are all enabled with a single write, and
+// only if that fails one at a time to find out which of them can't be. Returns the controllers
+// that could not be enabled, with the errno of their write.
+static std::vector<std::pair<const format::CgroupController*, int>> EnableSubtreeControllers(
+        const std::string& path, const std::vector<const format::CgroupController*>& controllers) {
+    std::vector<std::pair<const format::CgroupController*, int>> failed;
+    if (controllers.empty()) {
+        return failed;
+    }
+
+    const std::string subtree_control = path + "/cgroup.subtree_control";
+    std::string all;
+    for (const format::CgroupController* controller : controllers) {
+        if (!all.empty()) all += " ";
+        all += "+";
+        all += controller->name();
+    }
+    if (base::WriteStringToFile(all, subtree_control)) {
+        return failed;
+    }
+    if (controllers.size() == 1) {
+        failed.emplace_back(controllers.front(), errno);
+        return failed;
+    }
+
+    for (const format::CgroupController* controller : controllers) {
+        std::string str = "+";
+        str += controller->name();
+        if (!base::WriteStringToFile(str, subtree_control)) {
+            failed.emplace_back(controller, errno);
+        }
+    }
+    return failed;
+}
+
 // To avoid issues in sdk_mac build
 #if defined(__ANDROID__)
 
@@ -316,32 +360,43 @@ static bool MountV2CgroupController(const CgroupDescriptor& descriptor) {
     return true;
 }
 
-static bool ActivateV2CgroupController(const CgroupDescriptor& descriptor) {
-    const format::CgroupController* controller = descriptor.controller();
+// Sets up v2 controllers that share a directory: creates it, then activates all of them in it at
+// once. Returns whether each of |descriptors| was set up.
+static std::vector<bool> ActivateV2CgroupControllers(
+        const std::vector<CgroupDescriptor*>& descriptors) {
+    std::vector<bool> result(descriptors.size(), false);
+    std::vector<const format::CgroupController*> to_activate;
 
-    if (!Mkdir(controller->path(), descriptor.mode(), descriptor.uid(), descriptor.gid())) {
-        LOG(ERROR) << "Failed to create directory for " << controller->name() << " cgroup";
-        return false;
+    for (size_t i = 0; i < descriptors.size(); ++i) {
+        const CgroupDescriptor& descriptor = *descriptors[i];
+        const format::CgroupController* controller = descriptor.controller();
+
+        if (!Mkdir(controller->path(), descriptor.mode(), descriptor.uid(), descriptor.gid())) {
+            LOG(ERROR) << "Failed to create directory for " << controller->name() << " cgroup";
+            continue;
+        }
+        result[i] = true;
+
+        if (controller->flags() & CGROUPRC_CONTROLLER_FLAG_NEEDS_ACTIVATION) {
+            to_activate.push_back(controller);
+        }
     }
 
-    if (controller->flags() & CGROUPRC_CONTROLLER_FLAG_NEEDS_ACTIVATION) {
-        std::string str = "+";
-        str += controller->name();
-        std::string path = controller->path();
-        path += "/cgroup.subtree_control";
-
-        if (!base::WriteStringToFile(str, path)) {
-            if (IsOptionalController(controller)) {
-                PLOG(INFO) << "Failed to activate optional controller " << controller->name()
-                           << " at " << path;
-                return true;
-            }
-            PLOG(ERROR) << "Failed to activate controller " << controller->name();
-            return false;
+    const std::string path = descriptors.front()->controller()->path();
+    for (const auto& [controller, err] : EnableSubtreeControllers(path, to_activate)) {
+        errno = err;
+        if (IsOptionalController(controller)) {
+            PLOG(INFO) << "Failed to activate optional controller " << controller->name()
+                       << " at " << path << "/cgroup.subtree_control";
+            continue;
+        }
+        PLOG(ERROR) << "Failed to activate controller " << controller->name();
+        for (size_t i = 0; i < descriptors.size(); ++i) {
+            if (descriptors[i]->controller() == controller) result[i] = false;
         }
     }
 
-    return true;
+    return result;
 }
 
 static bool MountV1CgroupController(const CgroupDescriptor& descriptor) {
@@ -379,15 +434,10 @@ static bool MountV1CgroupController(const CgroupDescriptor& descriptor) {
     return true;
 }
 
+// Mounts a v1 controller or the v2 hierarchy.
 static bool SetupCgroup(const CgroupDescriptor& descriptor) {
-    const format::CgroupController* controller = descriptor.controller();
-
-    if (controller->version() == 2) {
-        if (!strcmp(controller->name(), CGROUPV2_HIERARCHY_NAME)) {
-            return MountV2CgroupController(descriptor);
-        } else {
-            return ActivateV2CgroupController(descriptor);
-        }
+    if (descriptor.controller()->version() == 2) {
+        return MountV2CgroupController(descriptor);
     } else {
         return MountV1CgroupController(descriptor);
     }
@@ -400,8 +450,118 @@ static bool SetupCgroup(const CgroupDescriptor&) {
     return false;
 }
 
+static std::vector<bool> ActivateV2CgroupControllers(
+        const std::vector<CgroupDescriptor*>& descriptors) {
+    return std::vector<bool>(descriptors.size(), false);
+}
+
 #endif
 
+static bool IsV2Controller(const CgroupDescriptor& descriptor) {
+    const format::CgroupController* controller = descriptor.controller();
+    return controller->version() == 2 && strcmp(controller->name(), CGROUPV2_HIERARCHY_NAME);
+}
+
+static bool IsUnder(const std::string& path, const std::string& parent) {
+    return path.size() > parent.size() && path[parent.size()] == '/' && StartsWith(path, parent);
+}
+
+// One unit of cgroup setup: mounting a v1 controller or the v2 hierarchy, or activating all the
+// v2 controllers that share a directory.
+struct CgroupSetupTask {
+    std::vector<CgroupDescriptor*> descriptors;
+};
+
+static void RunCgroupSetupTask(const CgroupSetupTask& task) {
+    Timer timer;
+    std::vector<bool> result;
+    std::string names;
+    if (IsV2Controller(*task.descriptors.front())) {
+        result = ActivateV2CgroupControllers(task.descriptors);
+    } else {
+        result.push_back(SetupCgroup(*task.descriptors.front()));
+    }
+
+    for (size_t i = 0; i < task.descriptors.size(); ++i) {
+        CgroupDescriptor* descriptor = task.descriptors[i];
+        const char* name = descriptor->controller()->name();
+        if (result[i]) {
+            descriptor->set_mounted(true);
+        } else {
+            // issue a warning and proceed with the next cgroup
+            LOG(WARNING) << "Failed to setup " << name << " cgroup";
+        }
+        if (!names.empty()) names += ", ";
+        names += name;
+    }
+    LOG(INFO) << "Setup of " << names << " cgroup took " << timer;
+}
+
+// Splits the setup of |descriptors| into stages that run one after the other: v2 controllers can
+// only be activated once the v2 hierarchy is mounted, and a controller mounted below another one
+// only once that one is. The tasks within a stage don't depend on each other.
+static std::vector<std::vector<CgroupSetupTask>> PlanCgroupSetup(
+        std::map<std::string, CgroupDescriptor>* descriptors) {
+    std::map<std::string, size_t> stages;
+
+    // There are only a handful of descriptors, and a stage only grows when it has to.
+    bool changed = true;
+    for (size_t pass = 0; changed && pass < descriptors->size(); ++pass) {
+        changed = false;
+        for (const auto& [name, descriptor] : *descriptors) {
+            for (const auto& [other_name, other] : *descriptors) {
+                bool depends =
+                        IsUnder(descriptor.controller()->path(), other.controller()->path()) ||
+                        (IsV2Controller(descriptor) && other_name == CGROUPV2_HIERARCHY_NAME);
+                if (depends && stages[name] <= stages[other_name]) {
+                    stages[name] = stages[other_name] + 1;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<CgroupSetupTask>> plan;
+    for (auto& [name, descriptor] : *descriptors) {
+        size_t stage = stages[name];
+        if (plan.size() <= stage) plan.resize(stage + 1);
+        std::vector<CgroupSetupTask>& tasks = plan[stage];
+
+        auto shared = tasks.end();
+        if (IsV2Controller(descriptor)) {
+            shared = std::find_if(tasks.begin(), tasks.end(), [&](const CgroupSetupTask& task) {
+                const CgroupDescriptor* first = task.descriptors.front();
+                return IsV2Controller(*first) &&
+                       !strcmp(first->controller()->path(), descriptor.controller()->path());
+            });
+        }
+        if (shared == tasks.end()) {
+            tasks.push_back({{&descriptor}});
+        } else {
+            shared->descriptors.push_back(&descriptor);
+        }
+    }
+    return plan;
+}
+
+// Mounts and configures all the controllers in |descriptors|, the ones that are independent of
+// each other concurrently: mounting is mostly waiting on the kernel, which doesn't serialize the
+// setup of different hierarchies. getpwnam() and getgrnam() are thread safe in bionic.
+static void SetupCgroups(std::map<std::string, CgroupDescriptor>* descriptors) {
+    for (const std::vector<CgroupSetupTask>& tasks : PlanCgroupSetup(descriptors)) {
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < tasks.size(); ++i) {
+            threads.emplace_back(RunCgroupSetupTask, std::cref(tasks[i]));
+        }
+        if (!tasks.empty()) {
+            RunCgroupSetupTask(tasks.front());
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+}
+
 static bool WriteRcFile(const std::map<std::string, CgroupDescriptor>& descriptors) {
     unique_fd fd(TEMP_FAILURE_RETRY(open(CGROUPS_RC_PATH, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC,
                                          S_IRUSR | S_IRGRP | S_IROTH)));
@@ -499,29 +659,30 @@ static bool CreateV2SubHierarchy(
 
     // Activate all v2 controllers in path so they can be activated in
     // children as they are created.
+    std::vector<const format::CgroupController*> controllers;
     for (const auto& [name, descriptor] : descriptors) {
         const format::CgroupController* controller = descriptor.controller();
         std::uint32_t flags = controller->flags();
         if (controller->version() == 2 && name != CGROUPV2_HIERARCHY_NAME &&
             flags & CGROUPRC_CONTROLLER_FLAG_NEEDS_ACTIVATION) {
-            std::string str("+");
-            str += controller->name();
-            if (!android::base::WriteStringToFile(str, path + "/cgroup.subtree_control")) {
-                if (flags & CGROUPRC_CONTROLLER_FLAG_OPTIONAL) {
-                    PLOG(WARNING) << "Activation of cgroup controller " << str << " failed in path "
-                                  << path;
-                } else {
-                    return false;
-                }
-            }
+            controllers.push_back(controller);
         }
     }
+    for (const auto& [controller, err] : EnableSubtreeControllers(path, controllers)) {
+        if (!(controller->flags() & CGROUPRC_CONTROLLER_FLAG_OPTIONAL)) {
+            return false;
+        }
+        errno = err;
+        PLOG(WARNING) << "Activation of cgroup controller +" << controller->name()
+                      << " failed in path " << path;
+    }
     return true;
 }
 
 bool CgroupSetup() {
     using namespace android::cgrouprc;
 
+    Timer total_timer;
     std::map<std::string, CgroupDescriptor> descriptors;
 
     if (getpid() != 1) {
@@ -543,14 +704,9 @@ bool CgroupSetup() {
     }
 
     // setup cgroups
-    for (auto& [name, descriptor] : descriptors) {
-        if (SetupCgroup(descriptor)) {
-            descriptor.set_mounted(true);
-        } else {
-            // issue a warning and proceed with the next cgroup
-            LOG(WARNING) << "Failed to setup " << name << " cgroup";
-        }
-    }
+    Timer step_timer;
+    SetupCgroups(&descriptors);
+    LOG(INFO) << "Mounting cgroups took " << step_timer;
 
     if (force_memcg_v2) {
         if (MGLRUDisabled().value_or(false)) {
@@ -572,13 +728,16 @@ bool CgroupSetup() {
                                                    : it->second.controller()->path();
 
         LOG(INFO) << "Using system/app isolation under: " << cgroup_v2_root;
+        step_timer = Timer();
         if (!CreateV2SubHierarchy(cgroup_v2_root + "/apps", descriptors) ||
             !CreateV2SubHierarchy(cgroup_v2_root + "/system", descriptors)) {
             return false;
         }
+        LOG(INFO) << "Creating system/app cgroup hierarchies took " << step_timer;
     }
 
     // mkdir <CGROUPS_RC_DIR> 0711 system system
+    step_timer = Timer();
     if (!Mkdir(android::base::Dirname(CGROUPS_RC_PATH), 0711, "system", "system")) {
         LOG(ERROR) << "Failed to create directory for " << CGROUPS_RC_PATH << " file";
         return false;
@@ -598,6 +757,8 @@ bool CgroupSetup() {
         PLOG(ERROR) << "fchmodat() failed";
         return false;
     }
+    LOG(INFO) << "Writing " << CGROUPS_RC_PATH << " took " << step_timer;
 
+    LOG(INFO) << "Cgroup setup took " << total_timer;
     return true;
 }
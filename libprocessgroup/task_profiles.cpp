@@ -19,6 +19,7 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <task_profiles.h>
 #include <string>
@@ -55,6 +56,9 @@ static constexpr const char* TASK_PROFILE_DB_VENDOR_FILE = "/vendor/etc/task_pro
 static constexpr const char* TEMPLATE_TASK_PROFILE_API_FILE =
         "/etc/task_profiles/task_profiles_%u.json";
 
+// Written by init from the files above, in the same directory as the cgroup.rc file.
+static constexpr const char* TASK_PROFILES_RC_PATH = "/dev/cgroup_info/task_profiles.rc";
+
 class FdCacheHelper {
   public:
     enum FdState {
@@ -188,6 +192,15 @@ bool ProfileAttribute::GetPathForUID(uid_t uid, std::string* path) const {
     return true;
 }
 
+bool ProfileAction::ExecuteForTasks(std::vector<pid_t>* tids) const {
+    return std::erase_if(*tids, [this](pid_t tid) { return !ExecuteForTask(tid); }) == 0;
+}
+
+bool ProfileAction::ExecuteForProcesses(uid_t uid, std::vector<pid_t>* pids) const {
+    return std::erase_if(*pids, [this, uid](pid_t pid) { return !ExecuteForProcess(uid, pid); }) ==
+           0;
+}
+
 bool SetClampsAction::ExecuteForProcess(uid_t, pid_t) const {
     // TODO: add support when kernel supports util_clamp
     LOG(WARNING) << "SetClampsAction::ExecuteForProcess is not supported";
@@ -404,6 +417,43 @@ ProfileAction::CacheUseResult SetCgroupAction::UseCachedFd(ResourceCacheType cac
     return ProfileAction::UNUSED;
 }
 
+bool SetCgroupAction::AddTidsToCgroup(std::vector<pid_t>* tids, int fd,
+                                      ResourceCacheType cache_type) const {
+    // Each write moves one task, but they can all go through the same fd.
+    size_t failed = std::erase_if(
+            *tids, [this, fd, cache_type](pid_t tid) { return !AddTidToCgroup(tid, fd, cache_type); });
+    if (failed != 0) {
+        LOG(ERROR) << "Failed to add " << failed << " tasks into cgroup";
+        return false;
+    }
+    return true;
+}
+
+ProfileAction::CacheUseResult SetCgroupAction::UseCachedFd(ResourceCacheType cache_type,
+                                                           std::vector<pid_t>* ids) const {
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    if (FdCacheHelper::IsCached(fd_[cache_type])) {
+        // fd is cached, reuse it for the whole batch
+        return AddTidsToCgroup(ids, fd_[cache_type], cache_type) ? ProfileAction::SUCCESS
+                                                                 : ProfileAction::FAIL;
+    }
+
+    if (fd_[cache_type] == FdCacheHelper::FDS_INACCESSIBLE) {
+        // no permissions to access the file, ignore
+        return ProfileAction::SUCCESS;
+    }
+
+    if (cache_type == ResourceCacheType::RCT_TASK &&
+        fd_[cache_type] == FdCacheHelper::FDS_APP_DEPENDENT) {
+        // application-dependent path can't be used with tid
+        LOG(ERROR) << Name() << ": application profile can't be applied to a thread";
+        ids->clear();
+        return ProfileAction::FAIL;
+    }
+
+    return ProfileAction::UNUSED;
+}
+
 bool SetCgroupAction::ExecuteForProcess(uid_t uid, pid_t pid) const {
     CacheUseResult result = UseCachedFd(ProfileAction::RCT_PROCESS, pid);
     if (result != ProfileAction::UNUSED) {
@@ -446,6 +496,52 @@ bool SetCgroupAction::ExecuteForTask(pid_t tid) const {
     return true;
 }
 
+bool SetCgroupAction::ExecuteForTasks(std::vector<pid_t>* tids) const {
+    CacheUseResult result = UseCachedFd(ProfileAction::RCT_TASK, tids);
+    if (result != ProfileAction::UNUSED) {
+        return result == ProfileAction::SUCCESS;
+    }
+
+    // fd was not cached, so open the tasks file once for the whole batch
+    std::string tasks_path = controller()->GetTasksFilePath(path_);
+    unique_fd tmp_fd(TEMP_FAILURE_RETRY(open(tasks_path.c_str(), O_WRONLY | O_CLOEXEC)));
+    if (tmp_fd < 0) {
+        PLOG(WARNING) << Name() << "::" << __func__ << ": failed to open " << tasks_path;
+        tids->clear();
+        return false;
+    }
+    return AddTidsToCgroup(tids, tmp_fd, RCT_TASK);
+}
+
+bool SetCgroupAction::ExecuteForProcesses(uid_t uid, std::vector<pid_t>* pids) const {
+    CacheUseResult result = UseCachedFd(ProfileAction::RCT_PROCESS, pids);
+    if (result != ProfileAction::UNUSED) {
+        return result == ProfileAction::SUCCESS;
+    }
+
+    // The procs path may depend on the pid, so reuse the open file for as long as consecutive
+    // processes share it.
+    std::string procs_path;
+    unique_fd tmp_fd;
+    size_t failed = std::erase_if(*pids, [&](pid_t pid) {
+        std::string path = controller()->GetProcsFilePath(path_, uid, pid);
+        if (path != procs_path || tmp_fd < 0) {
+            procs_path = std::move(path);
+            tmp_fd.reset(TEMP_FAILURE_RETRY(open(procs_path.c_str(), O_WRONLY | O_CLOEXEC)));
+            if (tmp_fd < 0) {
+                PLOG(WARNING) << Name() << "::" << __func__ << ": failed to open " << procs_path;
+                return true;
+            }
+        }
+        return !AddTidToCgroup(pid, tmp_fd, RCT_PROCESS);
+    });
+    if (failed != 0) {
+        LOG(ERROR) << "Failed to add " << failed << " processes into cgroup";
+        return false;
+    }
+    return true;
+}
+
 void SetCgroupAction::EnableResourceCaching(ResourceCacheType cache_type) {
     std::lock_guard<std::mutex> lock(fd_mutex_);
     // Return early to prevent unnecessary calls to controller_.Get{Tasks|Procs}FilePath() which
@@ -618,6 +714,40 @@ bool WriteFileAction::ExecuteForTask(pid_t tid) const {
     return WriteValueToFile(value_, ProfileAction::RCT_TASK, getuid(), tid, logfailures_);
 }
 
+bool WriteFileAction::ExecuteForTasks(std::vector<pid_t>* tids) const {
+    bool cached;
+    {
+        std::lock_guard<std::mutex> lock(fd_mutex_);
+        cached = fd_[ProfileAction::RCT_TASK] != FdCacheHelper::FDS_NOT_CACHED;
+    }
+    if (cached) {
+        // The cached fd is used, or the file is known to be unusable, without opening anything.
+        return ProfileAction::ExecuteForTasks(tids);
+    }
+
+    // fd was not cached, so open the file once for the whole batch
+    unique_fd tmp_fd(TEMP_FAILURE_RETRY(open(task_path_.c_str(), O_WRONLY | O_CLOEXEC)));
+    if (tmp_fd < 0) {
+        if (logfailures_) {
+            PLOG(WARNING) << Name() << "::" << __func__ << ": failed to open " << task_path_;
+        }
+        tids->clear();
+        return false;
+    }
+
+    const std::string value = StringReplace(value_, "<uid>", std::to_string(getuid()), true);
+    return std::erase_if(*tids, [&](pid_t tid) {
+               std::string tid_value = StringReplace(value, "<pid>", std::to_string(tid), true);
+               if (!WriteStringToFd(tid_value, tmp_fd)) {
+                   if (logfailures_) {
+                       PLOG(ERROR) << "Failed to write '" << tid_value << "' to " << task_path_;
+                   }
+                   return true;
+               }
+               return false;
+           }) == 0;
+}
+
 void WriteFileAction::EnableResourceCaching(ResourceCacheType cache_type) {
     std::lock_guard<std::mutex> lock(fd_mutex_);
     if (fd_[cache_type] != FdCacheHelper::FDS_NOT_CACHED) {
@@ -686,6 +816,20 @@ bool ApplyProfileAction::ExecuteForTask(pid_t tid) const {
     return true;
 }
 
+bool ApplyProfileAction::ExecuteForTasks(std::vector<pid_t>* tids) const {
+    for (const auto& profile : profiles_) {
+        profile->ExecuteForTasks(*tids);
+    }
+    return true;
+}
+
+bool ApplyProfileAction::ExecuteForProcesses(uid_t uid, std::vector<pid_t>* pids) const {
+    for (const auto& profile : profiles_) {
+        profile->ExecuteForProcesses(uid, *pids);
+    }
+    return true;
+}
+
 void ApplyProfileAction::EnableResourceCaching(ResourceCacheType cache_type) {
     for (const auto& profile : profiles_) {
         profile->EnableResourceCaching(cache_type);
@@ -744,6 +888,41 @@ bool TaskProfile::ExecuteForTask(pid_t tid) const {
     return true;
 }
 
+bool TaskProfile::ExecuteForTasks(std::span<const pid_t> tids) const {
+    std::vector<pid_t> pending(tids.begin(), tids.end());
+    for (pid_t& tid : pending) {
+        if (tid == 0) {
+            tid = GetThreadId();
+        }
+    }
+    bool success = true;
+    for (const auto& element : elements_) {
+        if (pending.empty()) {
+            break;
+        }
+        if (!element->ExecuteForTasks(&pending)) {
+            LOG(VERBOSE) << "Applying profile action " << element->Name() << " failed";
+            success = false;
+        }
+    }
+    return success;
+}
+
+bool TaskProfile::ExecuteForProcesses(uid_t uid, std::span<const pid_t> pids) const {
+    std::vector<pid_t> pending(pids.begin(), pids.end());
+    bool success = true;
+    for (const auto& element : elements_) {
+        if (pending.empty()) {
+            break;
+        }
+        if (!element->ExecuteForProcesses(uid, &pending)) {
+            LOG(VERBOSE) << "Applying profile action " << element->Name() << " failed";
+            success = false;
+        }
+    }
+    return success;
+}
+
 bool TaskProfile::ExecuteForUID(uid_t uid) const {
     for (const auto& element : elements_) {
         if (!element->ExecuteForUID(uid)) {
@@ -793,6 +972,7 @@ bool TaskProfile::IsValidForTask(pid_t tid) const {
 }
 
 void TaskProfiles::DropResourceCaching(ProfileAction::ResourceCacheType cache_type) const {
+    std::lock_guard<std::mutex> lock(lock_);
     for (auto& iter : profiles_) {
         iter.second->DropResourceCaching(cache_type);
     }
@@ -806,8 +986,31 @@ TaskProfiles& TaskProfiles::GetInstance() {
 }
 
 TaskProfiles::TaskProfiles() {
+    // Use the profiles compiled by init if they are there, so that only the profiles this process
+    // uses are read, and the json files are not parsed in every process.
+    file_ = TaskProfilesFile::Open(TASK_PROFILES_RC_PATH);
+    if (file_ == nullptr) {
+        LoadAll(CgroupMap::GetInstance(), &desc_);
+    }
+}
+
+bool TaskProfiles::WriteCompiledFile() {
+    TaskProfilesDescription desc;
+    LoadAll(CgroupMap::GetInstance(), &desc);
+    if (!TaskProfilesFile::Write(desc, TASK_PROFILES_RC_PATH)) {
+        return false;
+    }
+    // The file is created with init's umask.
+    if (fchmodat(AT_FDCWD, TASK_PROFILES_RC_PATH, 0644, AT_SYMLINK_NOFOLLOW) < 0) {
+        PLOG(ERROR) << "fchmodat() failed for " << TASK_PROFILES_RC_PATH;
+        return false;
+    }
+    return true;
+}
+
+void TaskProfiles::LoadAll(const CgroupMap& cg_map, TaskProfilesDescription* desc) {
     // load system task profiles
-    if (!Load(CgroupMap::GetInstance(), TASK_PROFILE_DB_FILE)) {
+    if (!Load(cg_map, TASK_PROFILE_DB_FILE, desc)) {
         LOG(ERROR) << "Loading " << TASK_PROFILE_DB_FILE << " for [" << getpid() << "] failed";
     }
 
@@ -817,7 +1020,7 @@ TaskProfiles::TaskProfiles() {
         std::string api_profiles_path =
                 android::base::StringPrintf(TEMPLATE_TASK_PROFILE_API_FILE, api_level);
         if (!access(api_profiles_path.c_str(), F_OK) || errno != ENOENT) {
-            if (!Load(CgroupMap::GetInstance(), api_profiles_path)) {
+            if (!Load(cg_map, api_profiles_path, desc)) {
                 LOG(ERROR) << "Loading " << api_profiles_path << " for [" << getpid() << "] failed";
             }
         }
@@ -825,13 +1028,14 @@ TaskProfiles::TaskProfiles() {
 
     // load vendor task profiles if the file exists
     if (!access(TASK_PROFILE_DB_VENDOR_FILE, F_OK) &&
-        !Load(CgroupMap::GetInstance(), TASK_PROFILE_DB_VENDOR_FILE)) {
+        !Load(cg_map, TASK_PROFILE_DB_VENDOR_FILE, desc)) {
         LOG(ERROR) << "Loading " << TASK_PROFILE_DB_VENDOR_FILE << " for [" << getpid()
                    << "] failed";
     }
 }
 
-bool TaskProfiles::Load(const CgroupMap& cg_map, const std::string& file_name) {
+bool TaskProfiles::Load(const CgroupMap& cg_map, const std::string& file_name,
+                        TaskProfilesDescription* desc) {
     std::string json_doc;
 
     if (!android::base::ReadFileToString(file_name, &json_doc)) {
@@ -860,15 +1064,8 @@ bool TaskProfiles::Load(const CgroupMap& cg_map, const std::string& file_name) {
             return false;
         }
 
-        auto controller = cg_map.FindController(controller_name);
-        if (controller.HasValue()) {
-            auto iter = attributes_.find(name);
-            if (iter == attributes_.end()) {
-                attributes_[name] =
-                        std::make_unique<ProfileAttribute>(controller, file_attr, file_v2_attr);
-            } else {
-                iter->second->Reset(controller, file_attr, file_v2_attr);
-            }
+        if (cg_map.FindController(controller_name).HasValue()) {
+            desc->attributes[name] = {controller_name, file_attr, file_v2_attr};
         } else {
             LOG(WARNING) << "Controller " << controller_name << " is not found";
         }
@@ -880,98 +1077,25 @@ bool TaskProfiles::Load(const CgroupMap& cg_map, const std::string& file_name) {
 
         std::string profile_name = profile_val["Name"].asString();
         const Json::Value& actions = profile_val["Actions"];
-        auto profile = std::make_shared<TaskProfile>(profile_name);
+        TaskProfilesDescription::Profile profile;
 
+        // Actions are checked when the profile is created, see CreateAction().
         for (Json::Value::ArrayIndex act_idx = 0; act_idx < actions.size(); ++act_idx) {
             const Json::Value& action_val = actions[act_idx];
-            std::string action_name = action_val["Name"].asString();
             const Json::Value& params_val = action_val["Params"];
-            if (action_name == "JoinCgroup") {
-                std::string controller_name = params_val["Controller"].asString();
-                std::string path = params_val["Path"].asString();
-
-                auto controller = cg_map.FindController(controller_name);
-                if (controller.HasValue()) {
-                    if (controller.version() == 1) {
-                        profile->Add(std::make_unique<SetCgroupAction>(controller, path));
-                    } else {
-                        LOG(WARNING) << "A JoinCgroup action in the " << profile_name
-                                     << " profile is used for controller " << controller_name
-                                     << " in the cgroup v2 hierarchy and will be ignored";
-                    }
-                } else {
-                    LOG(WARNING) << "JoinCgroup: controller " << controller_name << " is not found";
-                }
-            } else if (action_name == "SetTimerSlack") {
-                std::string slack_value = params_val["Slack"].asString();
-                char* end;
-                unsigned long slack;
-
-                slack = strtoul(slack_value.c_str(), &end, 10);
-                if (end > slack_value.c_str()) {
-                    profile->Add(std::make_unique<SetTimerSlackAction>(slack));
-                } else {
-                    LOG(WARNING) << "SetTimerSlack: invalid parameter: " << slack_value;
-                }
-            } else if (action_name == "SetAttribute") {
-                std::string attr_name = params_val["Name"].asString();
-                std::string attr_value = params_val["Value"].asString();
-                bool optional = strcmp(params_val["Optional"].asString().c_str(), "true") == 0;
-
-                auto iter = attributes_.find(attr_name);
-                if (iter != attributes_.end()) {
-                    profile->Add(std::make_unique<SetAttributeAction>(iter->second.get(),
-                                                                      attr_value, optional));
-                } else {
-                    LOG(WARNING) << "SetAttribute: unknown attribute: " << attr_name;
+            TaskProfilesDescription::Action& action = profile.actions.emplace_back();
+            action.name = action_val["Name"].asString();
+            if (!params_val.isObject()) continue;
+            for (const std::string& key : params_val.getMemberNames()) {
+                const Json::Value& value = params_val[key];
+                if (value.isConvertibleTo(Json::stringValue)) {
+                    action.params.emplace_back(key, value.asString());
                 }
-            } else if (action_name == "SetClamps") {
-                std::string boost_value = params_val["Boost"].asString();
-                std::string clamp_value = params_val["Clamp"].asString();
-                char* end;
-                unsigned long boost;
-
-                boost = strtoul(boost_value.c_str(), &end, 10);
-                if (end > boost_value.c_str()) {
-                    unsigned long clamp = strtoul(clamp_value.c_str(), &end, 10);
-                    if (end > clamp_value.c_str()) {
-                        profile->Add(std::make_unique<SetClampsAction>(boost, clamp));
-                    } else {
-                        LOG(WARNING) << "SetClamps: invalid parameter " << clamp_value;
-                    }
-                } else {
-                    LOG(WARNING) << "SetClamps: invalid parameter: " << boost_value;
-                }
-            } else if (action_name == "WriteFile") {
-                std::string attr_filepath = params_val["FilePath"].asString();
-                std::string attr_procfilepath = params_val["ProcFilePath"].asString();
-                std::string attr_value = params_val["Value"].asString();
-                // FilePath and Value are mandatory
-                if (!attr_filepath.empty() && !attr_value.empty()) {
-                    std::string attr_logfailures = params_val["LogFailures"].asString();
-                    bool logfailures = attr_logfailures.empty() || attr_logfailures == "true";
-                    profile->Add(std::make_unique<WriteFileAction>(attr_filepath, attr_procfilepath,
-                                                                   attr_value, logfailures));
-                } else if (attr_filepath.empty()) {
-                    LOG(WARNING) << "WriteFile: invalid parameter: "
-                                 << "empty filepath";
-                } else if (attr_value.empty()) {
-                    LOG(WARNING) << "WriteFile: invalid parameter: "
-                                 << "empty value";
-                }
-            } else {
-                LOG(WARNING) << "Unknown profile action: " << action_name;
             }
         }
-        auto iter = profiles_.find(profile_name);
-        if (iter == profiles_.end()) {
-            profiles_[profile_name] = profile;
-        } else {
-            // Move the content rather that replace the profile because old profile might be
-            // referenced from an aggregate profile if vendor overrides task profiles
-            profile->MoveTo(iter->second.get());
-            profile.reset();
-        }
+        // A later definition replaces the content of an earlier one, including for the
+        // aggregate profiles that refer to it by name.
+        desc->profiles[profile_name] = std::move(profile);
     }
 
     const Json::Value& aggregateprofiles_val = root["AggregateProfiles"];
@@ -980,7 +1104,8 @@ bool TaskProfiles::Load(const CgroupMap& cg_map, const std::string& file_name) {
 
         std::string aggregateprofile_name = aggregateprofile_val["Name"].asString();
         const Json::Value& aggregateprofiles = aggregateprofile_val["Profiles"];
-        std::vector<std::shared_ptr<TaskProfile>> profiles;
+        TaskProfilesDescription::Profile profile;
+        profile.aggregate = true;
         bool ret = true;
 
         for (Json::Value::ArrayIndex pf_idx = 0; pf_idx < aggregateprofiles.size(); ++pf_idx) {
@@ -990,40 +1115,184 @@ bool TaskProfiles::Load(const CgroupMap& cg_map, const std::string& file_name) {
                 LOG(WARNING) << "AggregateProfiles: recursive profile name: " << profile_name;
                 ret = false;
                 break;
-            } else if (profiles_.find(profile_name) == profiles_.end()) {
+            } else if (desc->profiles.find(profile_name) == desc->profiles.end()) {
                 LOG(WARNING) << "AggregateProfiles: undefined profile name: " << profile_name;
                 ret = false;
                 break;
             } else {
-                profiles.push_back(profiles_[profile_name]);
+                profile.profiles.push_back(profile_name);
             }
         }
         if (ret) {
-            auto profile = std::make_shared<TaskProfile>(aggregateprofile_name);
-            profile->Add(std::make_unique<ApplyProfileAction>(profiles));
-            profiles_[aggregateprofile_name] = profile;
+            desc->profiles[aggregateprofile_name] = std::move(profile);
         }
     }
 
     return true;
 }
 
-TaskProfile* TaskProfiles::GetProfile(std::string_view name) const {
-    auto iter = profiles_.find(name);
+std::unique_ptr<ProfileAction> TaskProfiles::CreateAction(
+        const std::string& profile_name, const TaskProfilesDescription::Action& action) const {
+    const CgroupMap& cg_map = CgroupMap::GetInstance();
+    const std::string& action_name = action.name;
 
-    if (iter != profiles_.end()) {
-        return iter->second.get();
+    if (action_name == "JoinCgroup") {
+        std::string controller_name = action.Param("Controller");
+        std::string path = action.Param("Path");
+
+        auto controller = cg_map.FindController(controller_name);
+        if (controller.HasValue()) {
+            if (controller.version() == 1) {
+                return std::make_unique<SetCgroupAction>(controller, path);
+            } else {
+                LOG(WARNING) << "A JoinCgroup action in the " << profile_name
+                             << " profile is used for controller " << controller_name
+                             << " in the cgroup v2 hierarchy and will be ignored";
+            }
+        } else {
+            LOG(WARNING) << "JoinCgroup: controller " << controller_name << " is not found";
+        }
+    } else if (action_name == "SetTimerSlack") {
+        std::string slack_value = action.Param("Slack");
+        char* end;
+        unsigned long slack;
+
+        slack = strtoul(slack_value.c_str(), &end, 10);
+        if (end > slack_value.c_str()) {
+            return std::make_unique<SetTimerSlackAction>(slack);
+        } else {
+            LOG(WARNING) << "SetTimerSlack: invalid parameter: " << slack_value;
+        }
+    } else if (action_name == "SetAttribute") {
+        std::string attr_name = action.Param("Name");
+        std::string attr_value = action.Param("Value");
+        bool optional = action.Param("Optional") == "true";
+
+        const IProfileAttribute* attribute = GetAttributeLocked(attr_name);
+        if (attribute != nullptr) {
+            return std::make_unique<SetAttributeAction>(attribute, attr_value, optional);
+        } else {
+            LOG(WARNING) << "SetAttribute: unknown attribute: " << attr_name;
+        }
+    } else if (action_name == "SetClamps") {
+        std::string boost_value = action.Param("Boost");
+        std::string clamp_value = action.Param("Clamp");
+        char* end;
+        unsigned long boost;
+
+        boost = strtoul(boost_value.c_str(), &end, 10);
+        if (end > boost_value.c_str()) {
+            unsigned long clamp = strtoul(clamp_value.c_str(), &end, 10);
+            if (end > clamp_value.c_str()) {
+                return std::make_unique<SetClampsAction>(boost, clamp);
+            } else {
+                LOG(WARNING) << "SetClamps: invalid parameter " << clamp_value;
+            }
+        } else {
+            LOG(WARNING) << "SetClamps: invalid parameter: " << boost_value;
+        }
+    } else if (action_name == "WriteFile") {
+        std::string attr_filepath = action.Param("FilePath");
+        std::string attr_procfilepath = action.Param("ProcFilePath");
+        std::string attr_value = action.Param("Value");
+        // FilePath and Value are mandatory
+        if (!attr_filepath.empty() && !attr_value.empty()) {
+            std::string attr_logfailures = action.Param("LogFailures");
+            bool logfailures = attr_logfailures.empty() || attr_logfailures == "true";
+            return std::make_unique<WriteFileAction>(attr_filepath, attr_procfilepath, attr_value,
+                                                     logfailures);
+        } else if (attr_filepath.empty()) {
+            LOG(WARNING) << "WriteFile: invalid parameter: "
+                         << "empty filepath";
+        } else if (attr_value.empty()) {
+            LOG(WARNING) << "WriteFile: invalid parameter: "
+                         << "empty value";
+        }
+    } else {
+        LOG(WARNING) << "Unknown profile action: " << action_name;
     }
     return nullptr;
 }
 
-const IProfileAttribute* TaskProfiles::GetAttribute(std::string_view name) const {
-    auto iter = attributes_.find(name);
+std::shared_ptr<TaskProfile> TaskProfiles::GetProfileLocked(std::string_view name,
+                                                             int depth) const {
+    auto iter = profiles_.find(name);
+    if (iter != profiles_.end()) {
+        return iter->second;
+    }
 
+    TaskProfilesDescription::Profile desc;
+    if (file_ != nullptr) {
+        if (!file_->FindProfile(name, &desc)) return nullptr;
+    } else {
+        auto desc_iter = desc_.profiles.find(name);
+        if (desc_iter == desc_.profiles.end()) return nullptr;
+        desc = desc_iter->second;
+    }
+
+    auto profile = std::make_shared<TaskProfile>(std::string(name));
+    if (desc.aggregate) {
+        // Overriding profiles can make aggregate profiles refer to each other.
+        if (depth >= kMaxAggregateDepth) {
+            LOG(WARNING) << "AggregateProfiles: " << name << " is nested too deeply";
+            return nullptr;
+        }
+        std::vector<std::shared_ptr<TaskProfile>> profiles;
+        for (const auto& profile_name : desc.profiles) {
+            auto element = GetProfileLocked(profile_name, depth + 1);
+            if (element == nullptr) {
+                LOG(WARNING) << "AggregateProfiles: undefined profile name: " << profile_name;
+                return nullptr;
+            }
+            profiles.push_back(std::move(element));
+        }
+        profile->Add(std::make_unique<ApplyProfileAction>(profiles));
+    } else {
+        for (const auto& action : desc.actions) {
+            auto element = CreateAction(profile->Name(), action);
+            if (element != nullptr) {
+                profile->Add(std::move(element));
+            }
+        }
+    }
+    profiles_.emplace(name, profile);
+    return profile;
+}
+
+const IProfileAttribute* TaskProfiles::GetAttributeLocked(std::string_view name) const {
+    auto iter = attributes_.find(name);
     if (iter != attributes_.end()) {
         return iter->second.get();
     }
-    return nullptr;
+
+    TaskProfilesDescription::Attribute desc;
+    if (file_ != nullptr) {
+        if (!file_->FindAttribute(name, &desc)) return nullptr;
+    } else {
+        auto desc_iter = desc_.attributes.find(name);
+        if (desc_iter == desc_.attributes.end()) return nullptr;
+        desc = desc_iter->second;
+    }
+
+    auto controller = CgroupMap::GetInstance().FindController(desc.controller);
+    if (!controller.HasValue()) {
+        LOG(WARNING) << "Controller " << desc.controller << " is not found";
+        return nullptr;
+    }
+    auto attribute = std::make_unique<ProfileAttribute>(controller, desc.file, desc.file_v2);
+    const IProfileAttribute* result = attribute.get();
+    attributes_.emplace(name, std::move(attribute));
+    return result;
+}
+
+TaskProfile* TaskProfiles::GetProfile(std::string_view name) const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return GetProfileLocked(name, 0).get();
+}
+
+const IProfileAttribute* TaskProfiles::GetAttribute(std::string_view name) const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return GetAttributeLocked(name);
 }
 
 template <typename T>
@@ -1087,6 +1356,50 @@ bool TaskProfiles::SetTaskProfiles(pid_t tid, std::span<const T> profiles, bool
     return success;
 }
 
+template <typename T>
+bool TaskProfiles::SetProcessProfiles(uid_t uid, std::span<const pid_t> pids,
+                                      std::span<const T> profiles, bool use_fd_cache) {
+    bool success = true;
+    for (const auto& name : profiles) {
+        TaskProfile* profile = GetProfile(name);
+        if (profile != nullptr) {
+            if (use_fd_cache) {
+                profile->EnableResourceCaching(ProfileAction::RCT_PROCESS);
+            }
+            if (!profile->ExecuteForProcesses(uid, pids)) {
+                LOG(WARNING) << "Failed to apply " << name << " process profile";
+                success = false;
+            }
+        } else {
+            LOG(WARNING) << "Failed to find " << name << " process profile";
+            success = false;
+        }
+    }
+    return success;
+}
+
+template <typename T>
+bool TaskProfiles::SetTaskProfiles(std::span<const pid_t> tids, std::span<const T> profiles,
+                                   bool use_fd_cache) {
+    bool success = true;
+    for (const auto& name : profiles) {
+        TaskProfile* profile = GetProfile(name);
+        if (profile != nullptr) {
+            if (use_fd_cache) {
+                profile->EnableResourceCaching(ProfileAction::RCT_TASK);
+            }
+            if (!profile->ExecuteForTasks(tids)) {
+                LOG(WARNING) << "Failed to apply " << name << " task profile";
+                success = false;
+            }
+        } else {
+            LOG(WARNING) << "Failed to find " << name << " task profile";
+            success = false;
+        }
+    }
+    return success;
+}
+
 template bool TaskProfiles::SetProcessProfiles(uid_t uid, pid_t pid,
                                                std::span<const std::string> profiles,
                                                bool use_fd_cache);
@@ -1099,3 +1412,9 @@ template bool TaskProfiles::SetTaskProfiles(pid_t tid, std::span<const std::stri
                                             bool use_fd_cache);
 template bool TaskProfiles::SetUserProfiles(uid_t uid, std::span<const std::string> profiles,
                                             bool use_fd_cache);
+template bool TaskProfiles::SetProcessProfiles(uid_t uid, std::span<const pid_t> pids,
+                                               std::span<const std::string_view> profiles,
+                                               bool use_fd_cache);
+template bool TaskProfiles::SetTaskProfiles(std::span<const pid_t> tids,
+                                            std::span<const std::string_view> profiles,
+                                            bool use_fd_cache);
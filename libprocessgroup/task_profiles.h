@@ -28,6 +28,7 @@
 
 #include <android-base/unique_fd.h>
 #include <cgroup_map.h>
+#include <task_profiles_file.h>
 
 class IProfileAttribute {
   public:
@@ -80,6 +81,13 @@ class ProfileAction {
     virtual bool ExecuteForTask(int) const { return false; }
     virtual bool ExecuteForUID(uid_t) const { return false; }
 
+    // Batched versions of the above for many threads, or many processes of one uid. Threads the
+    // action fails for are removed from the vector, so that the rest of a profile is not applied
+    // to them, the same as for a single thread. The default implementations call the single
+    // versions in a loop.
+    virtual bool ExecuteForTasks(std::vector<pid_t>* tids) const;
+    virtual bool ExecuteForProcesses(uid_t uid, std::vector<pid_t>* pids) const;
+
     virtual void EnableResourceCaching(ResourceCacheType) {}
     virtual void DropResourceCaching(ResourceCacheType) {}
     virtual bool IsValidForProcess(uid_t, pid_t) const { return false; }
@@ -147,6 +155,8 @@ class SetCgroupAction : public ProfileAction {
     const char* Name() const override { return "SetCgroup"; }
     bool ExecuteForProcess(uid_t uid, pid_t pid) const override;
     bool ExecuteForTask(pid_t tid) const override;
+    bool ExecuteForTasks(std::vector<pid_t>* tids) const override;
+    bool ExecuteForProcesses(uid_t uid, std::vector<pid_t>* pids) const override;
     void EnableResourceCaching(ResourceCacheType cache_type) override;
     void DropResourceCaching(ResourceCacheType cache_type) override;
     bool IsValidForProcess(uid_t uid, pid_t pid) const override;
@@ -161,7 +171,9 @@ class SetCgroupAction : public ProfileAction {
     mutable std::mutex fd_mutex_;
 
     bool AddTidToCgroup(pid_t tid, int fd, ResourceCacheType cache_type) const;
+    bool AddTidsToCgroup(std::vector<pid_t>* tids, int fd, ResourceCacheType cache_type) const;
     CacheUseResult UseCachedFd(ResourceCacheType cache_type, int id) const;
+    CacheUseResult UseCachedFd(ResourceCacheType cache_type, std::vector<pid_t>* ids) const;
 };
 
 // Write to file action
@@ -173,6 +185,7 @@ class WriteFileAction : public ProfileAction {
     const char* Name() const override { return "WriteFile"; }
     bool ExecuteForProcess(uid_t uid, pid_t pid) const override;
     bool ExecuteForTask(pid_t tid) const override;
+    bool ExecuteForTasks(std::vector<pid_t>* tids) const override;
     void EnableResourceCaching(ResourceCacheType cache_type) override;
     void DropResourceCaching(ResourceCacheType cache_type) override;
     bool IsValidForProcess(uid_t uid, pid_t pid) const override;
@@ -200,6 +213,10 @@ class TaskProfile {
     bool ExecuteForProcess(uid_t uid, pid_t pid) const;
     bool ExecuteForTask(pid_t tid) const;
     bool ExecuteForUID(uid_t uid) const;
+    // Same as ExecuteForTask() and ExecuteForProcess() for each thread or process, but with each
+    // action applied to all of them at once.
+    bool ExecuteForTasks(std::span<const pid_t> tids) const;
+    bool ExecuteForProcesses(uid_t uid, std::span<const pid_t> pids) const;
     void EnableResourceCaching(ProfileAction::ResourceCacheType cache_type);
     void DropResourceCaching(ProfileAction::ResourceCacheType cache_type);
     bool IsValidForProcess(uid_t uid, pid_t pid) const;
@@ -220,6 +237,8 @@ class ApplyProfileAction : public ProfileAction {
     const char* Name() const override { return "ApplyProfileAction"; }
     bool ExecuteForProcess(uid_t uid, pid_t pid) const override;
     bool ExecuteForTask(pid_t tid) const override;
+    bool ExecuteForTasks(std::vector<pid_t>* tids) const override;
+    bool ExecuteForProcesses(uid_t uid, std::vector<pid_t>* pids) const override;
     void EnableResourceCaching(ProfileAction::ResourceCacheType cache_type) override;
     void DropResourceCaching(ProfileAction::ResourceCacheType cache_type) override;
     bool IsValidForProcess(uid_t uid, pid_t pid) const override;
@@ -234,6 +253,10 @@ class TaskProfiles {
     // Should be used by all users
     static TaskProfiles& GetInstance();
 
+    // Compiles the profiles from the json files into a file that every process started afterwards
+    // maps instead of parsing the json files. Called by init once cgroups are set up.
+    static bool WriteCompiledFile();
+
     TaskProfile* GetProfile(std::string_view name) const;
     const IProfileAttribute* GetAttribute(std::string_view name) const;
     void DropResourceCaching(ProfileAction::ResourceCacheType cache_type) const;
@@ -243,14 +266,35 @@ class TaskProfiles {
     bool SetTaskProfiles(pid_t tid, std::span<const T> profiles, bool use_fd_cache);
     template <typename T>
     bool SetUserProfiles(uid_t uid, std::span<const T> profiles, bool use_fd_cache);
+    template <typename T>
+    bool SetProcessProfiles(uid_t uid, std::span<const pid_t> pids, std::span<const T> profiles,
+                            bool use_fd_cache);
+    template <typename T>
+    bool SetTaskProfiles(std::span<const pid_t> tids, std::span<const T> profiles,
+                         bool use_fd_cache);
 
   private:
+    // Limits how deeply aggregate profiles can refer to other aggregate profiles.
+    static constexpr int kMaxAggregateDepth = 16;
+
     TaskProfiles();
 
-    bool Load(const CgroupMap& cg_map, const std::string& file_name);
+    static void LoadAll(const CgroupMap& cg_map, TaskProfilesDescription* desc);
+    static bool Load(const CgroupMap& cg_map, const std::string& file_name,
+                     TaskProfilesDescription* desc);
+
+    std::unique_ptr<ProfileAction> CreateAction(const std::string& profile_name,
+                                                const TaskProfilesDescription::Action& action) const;
+    std::shared_ptr<TaskProfile> GetProfileLocked(std::string_view name, int depth) const;
+    const IProfileAttribute* GetAttributeLocked(std::string_view name) const;
+
+    // Profiles and attributes are created from one of these when they are first used.
+    std::unique_ptr<TaskProfilesFile> file_;
+    TaskProfilesDescription desc_;
 
-    std::map<std::string, std::shared_ptr<TaskProfile>, std::less<>> profiles_;
-    std::map<std::string, std::unique_ptr<IProfileAttribute>, std::less<>> attributes_;
+    mutable std::mutex lock_;
+    mutable std::map<std::string, std::shared_ptr<TaskProfile>, std::less<>> profiles_;
+    mutable std::map<std::string, std::unique_ptr<IProfileAttribute>, std::less<>> attributes_;
 };
 
 std::string ConvertUidToPath(const char* root_cgroup_path, uid_t uid);
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "libprocessgroup"
+
+#include <task_profiles_file.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+
+using android::base::MappedFile;
+using android::base::unique_fd;
+
+// The file is a header followed by arrays of the records below, and then by a table of
+// null-terminated strings that the records refer to by offset. Attributes and profiles are sorted
+// by name so that they can be binary searched.
+struct TaskProfilesFile::Header {
+    static constexpr uint32_t MAGIC = 0x43525054;  // "TPRC"
+    static constexpr uint32_t FILE_VERSION_1 = 1;
+    static constexpr uint32_t FILE_CURR_VERSION = FILE_VERSION_1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t attribute_count;
+    uint32_t profile_count;
+    uint32_t action_count;
+    uint32_t param_count;
+    uint32_t ref_count;
+    uint32_t strings_size;
+};
+
+struct TaskProfilesFile::Attribute {
+    uint32_t name;
+    uint32_t controller;
+    uint32_t file;
+    uint32_t file_v2;
+};
+
+struct TaskProfilesFile::Profile {
+    static constexpr uint32_t AGGREGATE = 1;
+
+    uint32_t name;
+    uint32_t flags;
+    // The range of actions, or of refs for an aggregate profile.
+    uint32_t first;
+    uint32_t count;
+};
+
+struct TaskProfilesFile::Action {
+    uint32_t name;
+    uint32_t first_param;
+    uint32_t param_count;
+};
+
+struct TaskProfilesFile::Param {
+    uint32_t key;
+    uint32_t value;
+};
+
+std::string TaskProfilesDescription::Action::Param(std::string_view key) const {
+    for (const auto& [k, v] : params) {
+        if (k == key) return v;
+    }
+    return {};
+}
+
+namespace {
+
+class StringTable {
+  public:
+    uint32_t Add(const std::string& s) {
+        auto [it, inserted] = offsets_.emplace(s, data_.size());
+        if (inserted) {
+            data_.append(s);
+            data_.push_back('\0');
+        }
+        return it->second;
+    }
+
+    const std::string& data() const { return data_; }
+
+  private:
+    std::map<std::string, uint32_t> offsets_;
+    std::string data_;
+};
+
+template <typename T>
+void Append(std::string* out, const std::vector<T>& records) {
+    out->append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+}
+
+bool InRange(uint32_t first, uint32_t count, uint32_t size) {
+    return first <= size && count <= size - first;
+}
+
+}  // namespace
+
+bool TaskProfilesFile::Write(const TaskProfilesDescription& desc, const std::string& path) {
+    StringTable strings;
+    std::vector<Attribute> attributes;
+    std::vector<Profile> profiles;
+    std::vector<Action> actions;
+    std::vector<Param> params;
+    std::vector<uint32_t> refs;
+
+    // std::map iterates in name order, which is the order that the reader searches in.
+    for (const auto& [name, attr] : desc.attributes) {
+        attributes.push_back({strings.Add(name), strings.Add(attr.controller),
+                              strings.Add(attr.file), strings.Add(attr.file_v2)});
+    }
+    for (const auto& [name, profile] : desc.profiles) {
+        if (profile.aggregate) {
+            profiles.push_back({strings.Add(name), Profile::AGGREGATE,
+                                static_cast<uint32_t>(refs.size()),
+                                static_cast<uint32_t>(profile.profiles.size())});
+            for (const auto& ref : profile.profiles) {
+                refs.push_back(strings.Add(ref));
+            }
+            continue;
+        }
+        profiles.push_back({strings.Add(name), 0, static_cast<uint32_t>(actions.size()),
+                            static_cast<uint32_t>(profile.actions.size())});
+        for (const auto& action : profile.actions) {
+            actions.push_back({strings.Add(action.name), static_cast<uint32_t>(params.size()),
+                               static_cast<uint32_t>(action.params.size())});
+            for (const auto& [key, value] : action.params) {
+                params.push_back({strings.Add(key), strings.Add(value)});
+            }
+        }
+    }
+    // Makes sure that the table isn't empty, so that it always ends with a terminator.
+    strings.Add("");
+
+    Header header = {
+            .magic = Header::MAGIC,
+            .version = Header::FILE_CURR_VERSION,
+            .attribute_count = static_cast<uint32_t>(attributes.size()),
+            .profile_count = static_cast<uint32_t>(profiles.size()),
+            .action_count = static_cast<uint32_t>(actions.size()),
+            .param_count = static_cast<uint32_t>(params.size()),
+            .ref_count = static_cast<uint32_t>(refs.size()),
+            .strings_size = static_cast<uint32_t>(strings.data().size()),
+    };
+
+    std::string content(reinterpret_cast<const char*>(&header), sizeof(header));
+    Append(&content, attributes);
+    Append(&content, profiles);
+    Append(&content, actions);
+    Append(&content, params);
+    Append(&content, refs);
+    content.append(strings.data());
+
+    unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC,
+                                         S_IRUSR | S_IRGRP | S_IROTH)));
+    if (fd < 0) {
+        PLOG(ERROR) << "open() failed for " << path;
+        return false;
+    }
+    if (!android::base::WriteStringToFd(content, fd)) {
+        PLOG(ERROR) << "write() failed for " << path;
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<TaskProfilesFile> TaskProfilesFile::Open(const std::string& path) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+        return nullptr;
+    }
+    auto map = MappedFile::FromFd(fd, 0, st.st_size, PROT_READ);
+    if (map == nullptr) {
+        PLOG(ERROR) << "Failed to map " << path;
+        return nullptr;
+    }
+
+    std::unique_ptr<TaskProfilesFile> file(new TaskProfilesFile(std::move(map)));
+    if (!file->Validate()) {
+        LOG(ERROR) << "Ignoring invalid task profiles file " << path;
+        return nullptr;
+    }
+    return file;
+}
+
+bool TaskProfilesFile::Validate() const {
+    const char* data = map_->data();
+    const auto* header = reinterpret_cast<const Header*>(data);
+    if (header->magic != Header::MAGIC || header->version != Header::FILE_CURR_VERSION) {
+        return false;
+    }
+
+    // This also rejects a file that is still being written.
+    uint64_t size = sizeof(Header) + uint64_t{header->attribute_count} * sizeof(Attribute) +
+                    uint64_t{header->profile_count} * sizeof(Profile) +
+                    uint64_t{header->action_count} * sizeof(Action) +
+                    uint64_t{header->param_count} * sizeof(Param) +
+                    uint64_t{header->ref_count} * sizeof(uint32_t) + header->strings_size;
+    if (size != map_->size() || header->strings_size == 0) {
+        return false;
+    }
+
+    auto* self = const_cast<TaskProfilesFile*>(this);
+    const char* p = data + sizeof(Header);
+    self->header_ = header;
+    self->attributes_ = reinterpret_cast<const Attribute*>(p);
+    p += header->attribute_count * sizeof(Attribute);
+    self->profiles_ = reinterpret_cast<const Profile*>(p);
+    p += header->profile_count * sizeof(Profile);
+    self->actions_ = reinterpret_cast<const Action*>(p);
+    p += header->action_count * sizeof(Action);
+    self->params_ = reinterpret_cast<const Param*>(p);
+    p += header->param_count * sizeof(Param);
+    self->refs_ = reinterpret_cast<const uint32_t*>(p);
+    p += header->ref_count * sizeof(uint32_t);
+    self->strings_ = p;
+
+    // Every string runs up to a terminator inside the table as long as the table ends with one.
+    const uint32_t strings_size = header->strings_size;
+    if (strings_[strings_size - 1] != '\0') {
+        return false;
+    }
+    auto valid_string = [strings_size](uint32_t offset) { return offset < strings_size; };
+
+    for (uint32_t i = 0; i < header->attribute_count; i++) {
+        const Attribute& attr = attributes_[i];
+        if (!valid_string(attr.name) || !valid_string(attr.controller) ||
+            !valid_string(attr.file) || !valid_string(attr.file_v2)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->profile_count; i++) {
+        const Profile& profile = profiles_[i];
+        uint32_t limit = (profile.flags & Profile::AGGREGATE) ? header->ref_count
+                                                                : header->action_count;
+        if (!valid_string(profile.name) || !InRange(profile.first, profile.count, limit)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->action_count; i++) {
+        const Action& action = actions_[i];
+        if (!valid_string(action.name) ||
+            !InRange(action.first_param, action.param_count, header->param_count)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->param_count; i++) {
+        if (!valid_string(params_[i].key) || !valid_string(params_[i].value)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->ref_count; i++) {
+        if (!valid_string(refs_[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TaskProfilesFile::FindAttribute(std::string_view name,
+                                     TaskProfilesDescription::Attribute* attr) const {
+    const Attribute* end = attributes_ + header_->attribute_count;
+    const Attribute* it = std::lower_bound(
+            attributes_, end, name,
+            [this](const Attribute& a, std::string_view n) { return String(a.name) < n; });
+    if (it == end || String(it->name) != name) {
+        return false;
+    }
+    attr->controller = String(it->controller);
+    attr->file = String(it->file);
+    attr->file_v2 = String(it->file_v2);
+    return true;
+}
+
+bool TaskProfilesFile::FindProfile(std::string_view name,
+                                   TaskProfilesDescription::Profile* profile) const {
+    const Profile* end = profiles_ + header_->profile_count;
+    const Profile* it = std::lower_bound(
+            profiles_, end, name,
+            [this](const Profile& p, std::string_view n) { return String(p.name) < n; });
+    if (it == end || String(it->name) != name) {
+        return false;
+    }
+
+    *profile = {};
+    if (it->flags & Profile::AGGREGATE) {
+        profile->aggregate = true;
+        for (uint32_t i = 0; i < it->count; i++) {
+            profile->profiles.emplace_back(String(refs_[it->first + i]));
+        }
+        return true;
+    }
+    for (uint32_t i = 0; i < it->count; i++) {
+        const Action& record = actions_[it->first + i];
+        TaskProfilesDescription::Action& action = profile->actions.emplace_back();
+        action.name = String(record.name);
+        for (uint32_t j = 0; j < record.param_count; j++) {
+            const Param& param = params_[record.first_param + j];
+            action.params.emplace_back(String(param.key), String(param.value));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <android-base/mapped_file.h>
+
+// The task profiles as they are after loading all of the JSON files in order, with later
+// definitions replacing earlier ones. Actions are kept as they are written in the JSON files, and
+// are only checked when the profile that uses them is loaded.
+struct TaskProfilesDescription {
+    struct Attribute {
+        std::string controller;
+        std::string file;
+        std::string file_v2;
+    };
+
+    struct Action {
+        std::string name;
+        std::vector<std::pair<std::string, std::string>> params;
+
+        // Same as reading the parameter from JSON: empty if it is missing.
+        std::string Param(std::string_view key) const;
+    };
+
+    struct Profile {
+        bool aggregate = false;
+        // For a normal profile.
+        std::vector<Action> actions;
+        // For an aggregate profile, the names of the profiles it applies.
+        std::vector<std::string> profiles;
+    };
+
+    std::map<std::string, Attribute, std::less<>> attributes;
+    std::map<std::string, Profile, std::less<>> profiles;
+};
+
+// A compiled task profiles file, mapped into memory. Attributes and profiles are looked up by name
+// without reading the rest of the file.
+class TaskProfilesFile {
+  public:
+    // Writes |desc| to |path| in the format read by Open().
+    static bool Write(const TaskProfilesDescription& desc, const std::string& path);
+
+    // Returns null if the file doesn't exist or isn't valid.
+    static std::unique_ptr<TaskProfilesFile> Open(const std::string& path);
+
+    bool FindAttribute(std::string_view name, TaskProfilesDescription::Attribute* attr) const;
+    bool FindProfile(std::string_view name, TaskProfilesDescription::Profile* profile) const;
+
+  private:
+    struct Header;
+    struct Attribute;
+    struct Profile;
+    struct Action;
+    struct Param;
+
+    explicit TaskProfilesFile(std::unique_ptr<android::base::MappedFile> map)
+        : map_(std::move(map)) {}
+    bool Validate() const;
+    std::string_view String(uint32_t offset) const { return strings_ + offset; }
+
+    std::unique_ptr<android::base::MappedFile> map_;
+    const Header* header_ = nullptr;
+    const Attribute* attributes_ = nullptr;
+    const Profile* profiles_ = nullptr;
+    const Action* actions_ = nullptr;
+    const Param* params_ = nullptr;
+    const uint32_t* refs_ = nullptr;
+    const char* strings_ = nullptr;
+};
@@ -15,6 +15,7 @@
  */
 
 #include "task_profiles.h"
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
 #include <gtest/gtest.h>
@@ -134,6 +135,22 @@ class ProfileAttributeMock : public IProfileAttribute {
     const std::string file_name_;
 };
 
+// Records the tasks it is applied to, and fails for odd ones.
+class RecordingAction : public ProfileAction {
+  public:
+    explicit RecordingAction(std::vector<pid_t>* applied) : applied_(applied) {}
+
+    const char* Name() const override { return "Recording"; }
+    bool ExecuteForTask(pid_t tid) const override {
+        applied_->push_back(tid);
+        return tid % 2 == 0;
+    }
+    bool ExecuteForProcess(uid_t, pid_t pid) const override { return ExecuteForTask(pid); }
+
+  private:
+    std::vector<pid_t>* applied_;
+};
+
 struct TestParam {
     const char* attr_name;
     const char* attr_value;
@@ -176,6 +193,96 @@ TEST_P(SetAttributeFixture, SetAttribute) {
     }
 }
 
+TEST(TaskProfileTest, ExecuteForTasksSkipsFailedTasks) {
+    std::vector<pid_t> first, second;
+    TaskProfile tp("test_profile");
+    tp.Add(std::make_unique<RecordingAction>(&first));
+    tp.Add(std::make_unique<RecordingAction>(&second));
+
+    const pid_t tids[] = {2, 3, 4, 5};
+    EXPECT_FALSE(tp.ExecuteForTasks(tids));
+    EXPECT_EQ((std::vector<pid_t>{2, 3, 4, 5}), first);
+    // The tasks the first action failed for don't get the rest of the profile, as with
+    // ExecuteForTask().
+    EXPECT_EQ((std::vector<pid_t>{2, 4}), second);
+
+    first.clear();
+    second.clear();
+    const pid_t pids[] = {6, 8};
+    EXPECT_TRUE(tp.ExecuteForProcesses(getuid(), pids));
+    EXPECT_EQ((std::vector<pid_t>{6, 8}), first);
+    EXPECT_EQ((std::vector<pid_t>{6, 8}), second);
+}
+
+TEST(TaskProfileTest, ApplyProfileActionForTasks) {
+    std::vector<pid_t> applied;
+    std::shared_ptr<TaskProfile> tp = std::make_shared<TaskProfile>("test_profile");
+    tp->Add(std::make_unique<RecordingAction>(&applied));
+    TaskProfile meta("meta_profile");
+    meta.Add(std::make_unique<ApplyProfileAction>(std::vector<std::shared_ptr<TaskProfile>>{tp}));
+
+    const pid_t tids[] = {0, 10};
+    EXPECT_TRUE(meta.ExecuteForTasks(tids));
+    // Zero means the calling thread.
+    EXPECT_EQ((std::vector<pid_t>{gettid(), 10}), applied);
+}
+
+TEST(TaskProfilesFileTest, RoundTrip) {
+    TaskProfilesDescription desc;
+    desc.attributes["UClampMax"] = {"cpu", "cpu.uclamp.max", ""};
+    desc.attributes["MemLimit"] = {"memory", "memory.limit_in_bytes", "memory.max"};
+    auto& profile = desc.profiles["HighPerformance"];
+    profile.actions.push_back({"JoinCgroup", {{"Controller", "cpu"}, {"Path", "top-app"}}});
+    profile.actions.push_back({"SetTimerSlack", {{"Slack", "50000"}}});
+    desc.profiles["Empty"] = {};
+    auto& aggregate = desc.profiles["SCHED_SP_TOP_APP"];
+    aggregate.aggregate = true;
+    aggregate.profiles = {"HighPerformance", "Empty"};
+
+    TemporaryFile tf;
+    ASSERT_TRUE(TaskProfilesFile::Write(desc, tf.path));
+    auto file = TaskProfilesFile::Open(tf.path);
+    ASSERT_NE(nullptr, file);
+
+    TaskProfilesDescription::Attribute attr;
+    ASSERT_TRUE(file->FindAttribute("MemLimit", &attr));
+    EXPECT_EQ("memory", attr.controller);
+    EXPECT_EQ("memory.limit_in_bytes", attr.file);
+    EXPECT_EQ("memory.max", attr.file_v2);
+    ASSERT_TRUE(file->FindAttribute("UClampMax", &attr));
+    EXPECT_EQ("", attr.file_v2);
+    EXPECT_FALSE(file->FindAttribute("UClampMin", &attr));
+
+    TaskProfilesDescription::Profile found;
+    ASSERT_TRUE(file->FindProfile("HighPerformance", &found));
+    EXPECT_FALSE(found.aggregate);
+    ASSERT_EQ(2u, found.actions.size());
+    EXPECT_EQ("JoinCgroup", found.actions[0].name);
+    EXPECT_EQ("top-app", found.actions[0].Param("Path"));
+    EXPECT_EQ("", found.actions[0].Param("Slack"));
+    EXPECT_EQ("50000", found.actions[1].Param("Slack"));
+    ASSERT_TRUE(file->FindProfile("Empty", &found));
+    EXPECT_TRUE(found.actions.empty());
+    ASSERT_TRUE(file->FindProfile("SCHED_SP_TOP_APP", &found));
+    EXPECT_TRUE(found.aggregate);
+    EXPECT_EQ((std::vector<std::string>{"HighPerformance", "Empty"}), found.profiles);
+    EXPECT_FALSE(file->FindProfile("LowPerformance", &found));
+}
+
+TEST(TaskProfilesFileTest, RejectsTruncatedFile) {
+    TaskProfilesDescription desc;
+    desc.profiles["HighPerformance"].actions.push_back({"SetTimerSlack", {{"Slack", "50000"}}});
+
+    TemporaryFile tf;
+    ASSERT_TRUE(TaskProfilesFile::Write(desc, tf.path));
+    std::string content;
+    ASSERT_TRUE(android::base::ReadFileToString(tf.path, &content));
+    ASSERT_EQ(0, truncate(tf.path, content.size() - 1));
+    EXPECT_EQ(nullptr, TaskProfilesFile::Open(tf.path));
+    ASSERT_EQ(0, truncate(tf.path, 0));
+    EXPECT_EQ(nullptr, TaskProfilesFile::Open(tf.path));
+}
+
 class TaskProfileFixture : public TestWithParam<TestParam> {
   public:
     ~TaskProfileFixture() = default;
@@ -324,6 +324,30 @@ struct sparse_file *sparse_file_import_auto(int fd, bool crc, bool verbose);
 int sparse_file_resparse(struct sparse_file *in_s, unsigned int max_len,
 		struct sparse_file **out_s, int out_s_count);
 
+/**
+ * sparse_file_import_resparse - import a sparse file and rechunk it while reading
+ *
+ * @fd - file descriptor to read from
+ * @verbose - print verbose errors while reading the sparse file
+ * @crc - verify the crc while reading the sparse file
+ * @max_len - maximum file size
+ * @callback - function called with each of the smaller sparse files
+ * @priv - value passed to the callback
+ *
+ * Same as sparse_file_import() followed by sparse_file_resparse(), but passes
+ * each smaller sparse file to the callback as soon as it has been read, so
+ * that only the chunks of one of them are held in memory at a time.  The
+ * sparse files passed to the callback refer to fd, and are destroyed when the
+ * callback returns.  If crc is true, the crc is only checked at the end of
+ * the file, after the callback has been called for the data it covers.
+ * Stops if the callback returns a negative value.
+ *
+ * Returns the number of sparse files passed to the callback, or a negative
+ * value on error.
+ */
+int sparse_file_import_resparse(int fd, bool verbose, bool crc, unsigned int max_len,
+		int (*callback)(void *priv, struct sparse_file *s), void *priv);
+
 /**
  * sparse_file_verbose - set a sparse file cookie to print verbose errors
  *
@@ -30,6 +30,10 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
 #include "defs.h"
 #include "output_file.h"
 #include "sparse_crc32.h"
@@ -59,6 +63,7 @@
 #define container_of(inner, outer_t, elem) ((outer_t*)((char*)(inner)-offsetof(outer_t, elem)))
 
 static constexpr size_t kMaxMmapSize = 256 * 1024 * 1024;
+static constexpr size_t kMaxCopySize = 1024 * 1024 * 1024;
 
 struct output_file_ops {
   int (*open)(struct output_file*, int fd);
@@ -66,6 +71,8 @@ struct output_file_ops {
   int (*pad)(struct output_file*, int64_t);
   int (*write)(struct output_file*, void*, size_t);
   void (*close)(struct output_file*);
+  /* Optional, writes len bytes of fd starting at offset without reading them into a buffer */
+  int (*copy)(struct output_file*, int fd, int64_t offset, uint64_t len);
 };
 
 struct sparse_file_ops {
@@ -170,12 +177,15 @@ static void file_close(struct output_file* out) {
   free(outn);
 }
 
+static int file_copy(struct output_file* out, int fd, int64_t offset, uint64_t len);
+
 static struct output_file_ops file_ops = {
     .open = file_open,
     .skip = file_skip,
     .pad = file_pad,
     .write = file_write,
     .close = file_close,
+    .copy = file_copy,
 };
 
 static int gz_file_open(struct output_file* out, int fd) {
@@ -341,6 +351,54 @@ static bool write_fd_chunk_range(int fd, int64_t offset, uint64_t len, T callbac
   return true;
 }
 
+/* Copies in the kernel where it can, which avoids mapping the source and copying it through user
+ * space, and lets file systems that support it share the blocks instead of copying them. */
+static int file_copy(struct output_file* out, int fd, int64_t offset, uint64_t len) {
+#ifdef __linux__
+  struct output_file_normal* outn = to_output_file_normal(out);
+  bool use_copy_file_range = true;
+
+  while (len > 0) {
+    size_t copy_len = std::min(len, static_cast<uint64_t>(kMaxCopySize));
+    ssize_t ret;
+    if (use_copy_file_range) {
+      off64_t in_offset = offset;
+      ret = copy_file_range(fd, &in_offset, outn->fd, nullptr, copy_len, 0);
+    } else {
+      off_t in_offset = offset;
+      ret = sendfile(outn->fd, fd, &in_offset, copy_len);
+    }
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      /* Not supported by the kernel or between these files */
+      if (use_copy_file_range && (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                                  errno == EOPNOTSUPP || errno == EBADF)) {
+        use_copy_file_range = false;
+        continue;
+      }
+      if (!use_copy_file_range && (errno == ENOSYS || errno == EINVAL)) {
+        break;
+      }
+      error_errno("%s", use_copy_file_range ? "copy_file_range" : "sendfile");
+      return -1;
+    }
+    if (ret == 0) {
+      error("unexpected end of file at offset %" PRIi64, offset);
+      return -1;
+    }
+    offset += ret;
+    len -= ret;
+  }
+#endif
+
+  bool ok = write_fd_chunk_range(fd, offset, len, [out](char* data, size_t size) -> bool {
+    return file_write(out, data, size) >= 0;
+  });
+  return ok ? 0 : -1;
+}
+
 static int write_sparse_skip_chunk(struct output_file* out, uint64_t skip_len) {
   chunk_header_t chunk_header;
   int ret;
@@ -464,15 +522,20 @@ static int write_sparse_fd_chunk(struct output_file* out, uint64_t len, int fd,
   ret = out->ops->write(out, &chunk_header, sizeof(chunk_header));
 
   if (ret < 0) return -1;
-  bool ok = write_fd_chunk_range(fd, offset, len, [&ret, out](char* data, size_t size) -> bool {
-    ret = out->ops->write(out, data, size);
-    if (ret < 0) return false;
-    if (out->use_crc) {
-      out->crc32 = sparse_crc32(out->crc32, data, size);
-    }
-    return true;
-  });
-  if (!ok) return -1;
+  if (out->ops->copy && !out->use_crc) {
+    ret = out->ops->copy(out, fd, offset, len);
+    if (ret < 0) return -1;
+  } else {
+    bool ok = write_fd_chunk_range(fd, offset, len, [&ret, out](char* data, size_t size) -> bool {
+      ret = out->ops->write(out, data, size);
+      if (ret < 0) return false;
+      if (out->use_crc) {
+        out->crc32 = sparse_crc32(out->crc32, data, size);
+      }
+      return true;
+    });
+    if (!ok) return -1;
+  }
   if (zero_len) {
     uint64_t len = zero_len;
     uint64_t write_len;
@@ -578,11 +641,16 @@ static int write_normal_fd_chunk(struct output_file* out, uint64_t len, int fd,
   int ret;
   uint64_t rnd_up_len = ALIGN(len, out->block_size);
 
-  bool ok = write_fd_chunk_range(fd, offset, len, [&ret, out](char* data, size_t size) -> bool {
-    ret = out->ops->write(out, data, size);
-    return ret >= 0;
-  });
-  if (!ok) return ret;
+  if (out->ops->copy) {
+    ret = out->ops->copy(out, fd, offset, len);
+    if (ret < 0) return ret;
+  } else {
+    bool ok = write_fd_chunk_range(fd, offset, len, [&ret, out](char* data, size_t size) -> bool {
+      ret = out->ops->write(out, data, size);
+      return ret >= 0;
+    });
+    if (!ok) return ret;
+  }
 
   if (rnd_up_len > len) {
     ret = out->ops->skip(out, rnd_up_len - len);
@@ -364,6 +364,108 @@ int sparse_file_resparse(struct sparse_file* in_s, unsigned int max_len, struct
   return c;
 }
 
+struct import_resparse_data {
+  unsigned int max_len;
+  /* Upper bound of the size of the chunks that have not been passed on yet */
+  int64_t pending_len;
+  int count;
+  int (*callback)(void* priv, struct sparse_file* s);
+  void* priv;
+};
+
+/*
+ * Moves the chunks of from that fit in max_len to a new sparse file.  Sets *more if chunks are left
+ * in from, and otherwise moves them back if keep_last is true.
+ */
+static int import_resparse_flush(struct import_resparse_data* data, struct sparse_file* from,
+                                 bool keep_last, bool* more) {
+  struct backed_block* bb;
+  struct sparse_file* s;
+  int ret;
+
+  s = sparse_file_new(from->block_size, from->len);
+  if (!s) {
+    return -ENOMEM;
+  }
+
+  if (move_chunks_up_to_len(from, s, data->max_len, &bb) < 0) {
+    sparse_file_destroy(s);
+    return -1;
+  }
+  *more = bb != nullptr;
+
+  if (!bb && keep_last) {
+    backed_block_list_move(s->backed_block_list, from->backed_block_list, nullptr, nullptr);
+    sparse_file_destroy(s);
+    return 0;
+  }
+
+  ret = data->callback(data->priv, s);
+  sparse_file_destroy(s);
+  if (ret < 0) {
+    return ret;
+  }
+
+  data->count++;
+  return 0;
+}
+
+static int import_resparse_chunk(void* priv, struct sparse_file* from, int64_t chunk_len) {
+  struct import_resparse_data* data = reinterpret_cast<import_resparse_data*>(priv);
+  bool more = true;
+  int ret;
+
+  /* Allow for a skip chunk in front of each chunk */
+  data->pending_len += chunk_len + sizeof(chunk_header_t);
+
+  while (more && data->pending_len > data->max_len) {
+    /* Keep the last chunks until they fill a file, so that later chunks can be added to it */
+    ret = import_resparse_flush(data, from, true, &more);
+    if (ret < 0) {
+      return ret;
+    }
+    data->pending_len = sparse_file_len(from, true, false);
+    if (data->pending_len < 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int sparse_file_import_resparse(int fd, bool verbose, bool crc, unsigned int max_len,
+                                int (*callback)(void* priv, struct sparse_file* s), void* priv) {
+  struct import_resparse_data data = {
+      .max_len = max_len,
+      .pending_len = 0,
+      .count = 0,
+      .callback = callback,
+      .priv = priv,
+  };
+  struct sparse_file* s;
+  bool more;
+  int ret;
+
+  ret = sparse_file_import_chunks(fd, verbose, crc, import_resparse_chunk, &data, &s);
+  if (ret < 0) {
+    return ret;
+  }
+
+  /* Pass on the rest, or a single empty file for an image without chunks */
+  if (backed_block_iter_new(s->backed_block_list) || data.count == 0) {
+    do {
+      ret = import_resparse_flush(&data, s, false, &more);
+      if (ret < 0) {
+        sparse_file_destroy(s);
+        return ret;
+      }
+    } while (more);
+  }
+
+  sparse_file_destroy(s);
+  return data.count;
+}
+
 void sparse_file_verbose(struct sparse_file* s) {
   s->verbose = true;
 }
@@ -32,6 +32,19 @@ struct sparse_file {
   struct output_file* out;
 };
 
+/*
+ * Called after each chunk of a sparse image is added to s while importing it, with the number of
+ * bytes the chunk takes up in the image.  A negative return value stops the import.
+ */
+typedef int (*sparse_chunk_cb)(void* priv, struct sparse_file* s, int64_t chunk_len);
+
+/*
+ * Same as sparse_file_import(), but calls chunk_cb after each chunk, which may move chunks out of
+ * the sparse file as it is being built.  Returns 0 and sets *out on success, or a negative errno.
+ */
+int sparse_file_import_chunks(int fd, bool verbose, bool crc, sparse_chunk_cb chunk_cb, void* priv,
+                              struct sparse_file** out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -374,7 +374,8 @@ static int process_chunk(struct sparse_file* s, SparseFileSource* source, unsign
   return 0;
 }
 
-static int sparse_file_read_sparse(struct sparse_file* s, SparseFileSource* source, bool crc) {
+static int sparse_file_read_sparse(struct sparse_file* s, SparseFileSource* source, bool crc,
+                                   sparse_chunk_cb chunk_cb = nullptr, void* priv = nullptr) {
   int ret;
   unsigned int i;
   sparse_header_t sparse_header;
@@ -448,6 +449,21 @@ static int sparse_file_read_sparse(struct sparse_file* s, SparseFileSource* sour
     }
 
     cur_block += ret;
+
+    if (chunk_cb) {
+      int64_t chunk_len = 0;
+      if (chunk_header.chunk_type == CHUNK_TYPE_RAW) {
+        chunk_len = CHUNK_HEADER_LEN + (int64_t)chunk_header.chunk_sz * s->block_size;
+      } else if (chunk_header.chunk_type == CHUNK_TYPE_FILL) {
+        chunk_len = CHUNK_HEADER_LEN + sizeof(uint32_t);
+      } else if (chunk_header.chunk_type == CHUNK_TYPE_DONT_CARE) {
+        chunk_len = CHUNK_HEADER_LEN;
+      }
+      ret = chunk_cb(priv, s, chunk_len);
+      if (ret < 0) {
+        return ret;
+      }
+    }
   }
 
   if (sparse_header.total_blks != cur_block) {
@@ -457,61 +473,98 @@ static int sparse_file_read_sparse(struct sparse_file* s, SparseFileSource* sour
   return 0;
 }
 
-static int do_sparse_file_read_normal(struct sparse_file* s, int fd, uint32_t* buf, int64_t offset,
-                                      int64_t remain) {
+/* Returns true if the block repeats a single 32-bit value, which is then a fill block. Comparing
+ * the block with itself shifted by one word lets the vectorized memcmp() of the C library do the
+ * work, and stops at the first difference for the common case of a data block. */
+static bool is_fill_block(const uint32_t* block, unsigned int block_size) {
+  return memcmp(block, block + 1, block_size - sizeof(uint32_t)) == 0;
+}
+
+/* Reads buffers of many blocks at a time, and adds each run of adjacent data blocks, or of fill
+ * blocks with the same value, to the sparse file as one chunk rather than one block at a time. */
+static int do_sparse_file_read_normal(struct sparse_file* s, int fd, uint32_t* buf,
+                                      unsigned int buf_size, int64_t offset, int64_t remain) {
   int ret;
   unsigned int block = offset / s->block_size;
   unsigned int to_read;
-  unsigned int i;
+  unsigned int pos;
+  unsigned int len;
   bool sparse_block;
 
+  /* The pending run of blocks */
+  unsigned int run_block = block;
+  int64_t run_offset = offset;
+  int64_t run_len = 0;
+  bool run_sparse = false;
+  uint32_t run_fill_val = 0;
+
   if (!buf) {
     return -ENOMEM;
   }
 
   while (remain > 0) {
-    to_read = std::min(remain, (int64_t)(s->block_size));
+    to_read = std::min(remain, (int64_t)buf_size);
     ret = read_all(fd, buf, to_read);
     if (ret < 0) {
       error("failed to read sparse file");
       return ret;
     }
 
-    if (to_read == s->block_size) {
-      sparse_block = true;
-      for (i = 1; i < s->block_size / sizeof(uint32_t); i++) {
-        if (buf[0] != buf[i]) {
-          sparse_block = false;
-          break;
+    for (pos = 0; pos < to_read; pos += len) {
+      const uint32_t* block_buf = (const uint32_t*)((const char*)buf + pos);
+      len = std::min(to_read - pos, s->block_size);
+      sparse_block = len == s->block_size && is_fill_block(block_buf, len);
+
+      if (run_len > 0 &&
+          (sparse_block != run_sparse || (sparse_block && block_buf[0] != run_fill_val))) {
+        /* TODO: add flag to use skip instead of fill for run_fill_val == 0 */
+        ret = run_sparse ? sparse_file_add_fill(s, run_fill_val, run_len, run_block)
+                         : sparse_file_add_fd(s, fd, run_offset, run_len, run_block);
+        if (ret < 0) {
+          return ret;
         }
+        run_len = 0;
       }
-    } else {
-      sparse_block = false;
-    }
+      if (run_len == 0) {
+        run_block = block;
+        run_offset = offset;
+        run_sparse = sparse_block;
+        run_fill_val = block_buf[0];
+      }
+      run_len += len;
 
-    if (sparse_block) {
-      /* TODO: add flag to use skip instead of fill for buf[0] == 0 */
-      sparse_file_add_fill(s, buf[0], to_read, block);
-    } else {
-      sparse_file_add_fd(s, fd, offset, to_read, block);
+      offset += len;
+      block++;
     }
 
     remain -= to_read;
-    offset += to_read;
-    block++;
+  }
+
+  if (run_len > 0) {
+    ret = run_sparse ? sparse_file_add_fill(s, run_fill_val, run_len, run_block)
+                     : sparse_file_add_fd(s, fd, run_offset, run_len, run_block);
+    if (ret < 0) {
+      return ret;
+    }
   }
 
   return 0;
 }
 
+/* Size of the buffer used to read a file, a multiple of the block size */
+static unsigned int read_buf_size(struct sparse_file* s) {
+  return std::max(s->block_size, (unsigned int)(COPY_BUF_SIZE / s->block_size * s->block_size));
+}
+
 static int sparse_file_read_normal(struct sparse_file* s, int fd) {
   int ret;
-  uint32_t* buf = (uint32_t*)malloc(s->block_size);
+  unsigned int buf_size = read_buf_size(s);
+  uint32_t* buf = (uint32_t*)malloc(buf_size);
 
   if (!buf)
     return -ENOMEM;
 
-  ret = do_sparse_file_read_normal(s, fd, buf, 0, s->len);
+  ret = do_sparse_file_read_normal(s, fd, buf, buf_size, 0, s->len);
   free(buf);
   return ret;
 }
@@ -519,7 +572,8 @@ static int sparse_file_read_normal(struct sparse_file* s, int fd) {
 #ifdef __linux__
 static int sparse_file_read_hole(struct sparse_file* s, int fd) {
   int ret;
-  uint32_t* buf = (uint32_t*)malloc(s->block_size);
+  unsigned int buf_size = read_buf_size(s);
+  uint32_t* buf = (uint32_t*)malloc(buf_size);
   int64_t end = 0;
   int64_t start = 0;
 
@@ -556,7 +610,7 @@ static int sparse_file_read_hole(struct sparse_file* s, int fd) {
       return -errno;
     }
 
-    ret = do_sparse_file_read_normal(s, fd, buf, start, end - start);
+    ret = do_sparse_file_read_normal(s, fd, buf, buf_size, start, end - start);
     if (ret) {
       free(buf);
       return ret;
@@ -591,8 +645,9 @@ int sparse_file_read(struct sparse_file* s, int fd, enum sparse_read_mode mode,
   }
 }
 
-static struct sparse_file* sparse_file_import_source(SparseFileSource* source, bool verbose,
-                                                     bool crc) {
+static int sparse_file_import_source(SparseFileSource* source, bool verbose, bool crc,
+                                     struct sparse_file** out, sparse_chunk_cb chunk_cb = nullptr,
+                                     void* priv = nullptr) {
   int ret;
   sparse_header_t sparse_header;
   int64_t len;
@@ -601,68 +656,77 @@ static struct sparse_file* sparse_file_import_source(SparseFileSource* source, b
   ret = source->ReadValue(&sparse_header, sizeof(sparse_header));
   if (ret < 0) {
     verbose_error(verbose, ret, "header");
-    return nullptr;
+    return ret;
   }
 
   if (sparse_header.magic != SPARSE_HEADER_MAGIC) {
     verbose_error(verbose, -EINVAL, "header magic");
-    return nullptr;
+    return -EINVAL;
   }
 
   if (sparse_header.major_version != SPARSE_HEADER_MAJOR_VER) {
     verbose_error(verbose, -EINVAL, "header major version");
-    return nullptr;
+    return -EINVAL;
   }
 
   if (sparse_header.file_hdr_sz < SPARSE_HEADER_LEN) {
-    return nullptr;
+    return -EINVAL;
   }
 
   if (sparse_header.chunk_hdr_sz < sizeof(chunk_header_t)) {
-    return nullptr;
+    return -EINVAL;
   }
 
   if (!sparse_header.blk_sz || (sparse_header.blk_sz % 4)) {
-    return nullptr;
+    return -EINVAL;
   }
 
   if (!sparse_header.total_blks) {
-    return nullptr;
+    return -EINVAL;
   }
 
   len = (int64_t)sparse_header.total_blks * sparse_header.blk_sz;
   s = sparse_file_new(sparse_header.blk_sz, len);
   if (!s) {
     verbose_error(verbose, -EINVAL, nullptr);
-    return nullptr;
+    return -ENOMEM;
   }
 
   ret = source->Rewind();
   if (ret < 0) {
     verbose_error(verbose, ret, "seeking");
     sparse_file_destroy(s);
-    return nullptr;
+    return ret;
   }
 
   s->verbose = verbose;
 
-  ret = sparse_file_read_sparse(s, source, crc);
+  ret = sparse_file_read_sparse(s, source, crc, chunk_cb, priv);
   if (ret < 0) {
     sparse_file_destroy(s);
-    return nullptr;
+    return ret;
   }
 
-  return s;
+  *out = s;
+  return 0;
 }
 
 struct sparse_file* sparse_file_import(int fd, bool verbose, bool crc) {
   SparseFileFdSource source(fd);
-  return sparse_file_import_source(&source, verbose, crc);
+  struct sparse_file* s;
+  return sparse_file_import_source(&source, verbose, crc, &s) < 0 ? nullptr : s;
+}
+
+int sparse_file_import_chunks(int fd, bool verbose, bool crc, sparse_chunk_cb chunk_cb, void* priv,
+                              struct sparse_file** out) {
+  SparseFileFdSource source(fd);
+  return sparse_file_import_source(&source, verbose, crc, out, chunk_cb, priv);
 }
 
 struct sparse_file* sparse_file_import_buf(char* buf, size_t len, bool verbose, bool crc) {
   SparseFileBufSource source(buf, len);
-  return sparse_file_import_source(&source, verbose, crc);
+  struct sparse_file* s;
+  return sparse_file_import_source(&source, verbose, crc, &s) < 0 ? nullptr : s;
 }
 
 struct sparse_file* sparse_file_import_auto(int fd, bool crc, bool verbose) {
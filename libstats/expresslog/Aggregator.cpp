@@ -0,0 +1,73 @@
+//
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Aggregator.h"
+
+#include <time.h>
+
+namespace android {
+namespace expresslog {
+
+namespace {
+
+int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}  // namespace
+
+Aggregator::Aggregator(int64_t metricIdHash, int slotCount,
+                       std::chrono::milliseconds flushInterval, Flusher flusher)
+    : mMetricIdHash(metricIdHash),
+      mSlotCount(slotCount),
+      mFlushIntervalNs(std::chrono::nanoseconds(flushInterval).count()),
+      mFlusher(flusher),
+      mCounts(new std::atomic<int64_t>[slotCount]()),
+      mNextFlushNs(nowNs() + mFlushIntervalNs) {
+}
+
+Aggregator::~Aggregator() {
+    flush();
+}
+
+void Aggregator::add(int slot, int64_t amount) {
+    if (slot < 0 || slot >= mSlotCount) {
+        return;
+    }
+    mCounts[slot].fetch_add(amount, std::memory_order_relaxed);
+
+    const int64_t now = nowNs();
+    int64_t next = mNextFlushNs.load(std::memory_order_relaxed);
+    // Only the thread that advances the deadline flushes.
+    if (now >= next && mNextFlushNs.compare_exchange_strong(next, now + mFlushIntervalNs,
+                                                            std::memory_order_relaxed)) {
+        flush();
+    }
+}
+
+void Aggregator::flush() {
+    for (int slot = 0; slot < mSlotCount; slot++) {
+        const int64_t count = mCounts[slot].exchange(0, std::memory_order_relaxed);
+        if (count != 0) {
+            mFlusher(mMetricIdHash, slot, count);
+        }
+    }
+}
+
+}  // namespace expresslog
+}  // namespace android
@@ -0,0 +1,62 @@
+//
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace android {
+namespace expresslog {
+
+/**
+ * Accumulates counts per slot (bin) of a metric and hands them to a flusher at most once per
+ * flush interval, and on destruction. Adding is lock free and safe from any thread.
+ */
+class Aggregator final {
+public:
+    using Flusher = void (*)(int64_t metricIdHash, int slot, int64_t count);
+
+    Aggregator(int64_t metricIdHash, int slotCount, std::chrono::milliseconds flushInterval,
+               Flusher flusher);
+    ~Aggregator();
+
+    Aggregator(const Aggregator&) = delete;
+    Aggregator& operator=(const Aggregator&) = delete;
+
+    /**
+     * Adds amount to the slot, flushing all slots when the interval has elapsed
+     */
+    void add(int slot, int64_t amount);
+
+    /**
+     * Hands all non-zero slot counts to the flusher and resets them
+     */
+    void flush();
+
+private:
+    const int64_t mMetricIdHash;
+    const int mSlotCount;
+    const int64_t mFlushIntervalNs;
+    const Flusher mFlusher;
+    const std::unique_ptr<std::atomic<int64_t>[]> mCounts;
+    std::atomic<int64_t> mNextFlushNs;
+};
+
+}  // namespace expresslog
+}  // namespace android
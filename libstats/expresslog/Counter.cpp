@@ -16,6 +16,8 @@
 
 #include "include/Counter.h"
 
+#include "Aggregator.h"
+
 #include <statslog_express.h>
 #include <string.h>
 #include <utils/hash/farmhash.h>
@@ -28,6 +30,33 @@ void Counter::logIncrement(const char* metricName, int64_t amount) {
     stats_write(EXPRESS_EVENT_REPORTED, metricIdHash, amount);
 }
 
+Counter::Counter(const char* metricId)
+    : mMetricIdHash(farmhash::Fingerprint64(metricId, strlen(metricId))) {
+}
+
+Counter::Counter(const char* metricId, std::chrono::milliseconds flushInterval)
+    : mMetricIdHash(farmhash::Fingerprint64(metricId, strlen(metricId))),
+      mAggregator(std::make_shared<Aggregator>(
+              mMetricIdHash, /*slotCount*/ 1, flushInterval,
+              [](int64_t metricIdHash, int /*slot*/, int64_t count) {
+                  stats_write(EXPRESS_EVENT_REPORTED, metricIdHash, count);
+              })) {
+}
+
+void Counter::increment(int64_t amount) const {
+    if (mAggregator) {
+        mAggregator->add(0, amount);
+    } else {
+        stats_write(EXPRESS_EVENT_REPORTED, mMetricIdHash, amount);
+    }
+}
+
+void Counter::flush() const {
+    if (mAggregator) {
+        mAggregator->flush();
+    }
+}
+
 void Counter::logIncrementWithUid(const char* metricName, int32_t uid, int64_t amount) {
     const int64_t metricIdHash = farmhash::Fingerprint64(metricName, strlen(metricName));
     stats_write(EXPRESS_UID_EVENT_REPORTED, metricIdHash, amount, uid);
@@ -23,6 +23,8 @@
 #include <string.h>
 #include <utils/hash/farmhash.h>
 
+#include "Aggregator.h"
+
 namespace android {
 namespace expresslog {
 
@@ -66,8 +68,23 @@ Histogram::Histogram(const char* metricName, std::shared_ptr<BinOptions> binOpti
       mBinOptions(std::move(binOptions)) {
 }
 
+Histogram::Histogram(const char* metricName, std::shared_ptr<BinOptions> binOptions,
+                     std::chrono::milliseconds flushInterval)
+    : mMetricIdHash(farmhash::Fingerprint64(metricName, strlen(metricName))),
+      mBinOptions(std::move(binOptions)),
+      mAggregator(std::make_shared<Aggregator>(
+              mMetricIdHash, mBinOptions->getBinsCount(), flushInterval,
+              [](int64_t metricIdHash, int binIndex, int64_t count) {
+                  stats_write(EXPRESS_HISTOGRAM_SAMPLE_REPORTED, metricIdHash, count, binIndex);
+              })) {
+}
+
 void Histogram::logSample(float sample) const {
     const int binIndex = mBinOptions->getBinForSample(sample);
+    if (mAggregator) {
+        mAggregator->add(binIndex, 1);
+        return;
+    }
     stats_write(EXPRESS_HISTOGRAM_SAMPLE_REPORTED, mMetricIdHash, /*count*/ 1, binIndex);
 }
 
@@ -76,5 +93,11 @@ void Histogram::logSampleWithUid(int32_t uid, float sample) const {
     stats_write(EXPRESS_UID_HISTOGRAM_SAMPLE_REPORTED, mMetricIdHash, /*count*/ 1, binIndex, uid);
 }
 
+void Histogram::flush() const {
+    if (mAggregator) {
+        mAggregator->flush();
+    }
+}
+
 }  // namespace expresslog
 }  // namespace android
@@ -17,15 +17,45 @@
 #pragma once
 #include <stdint.h>
 
+#include <chrono>
+#include <memory>
+
 namespace android {
 namespace expresslog {
 
+class Aggregator;
+
 /** Counter encapsulates StatsD write API calls */
 class Counter final {
 public:
     static void logIncrement(const char* metricId, int64_t amount = 1);
 
     static void logIncrementWithUid(const char* metricId, int32_t uid, int64_t amount = 1);
+
+    /**
+     * Counter for a single metric, the metric name is hashed once here instead of per call
+     */
+    explicit Counter(const char* metricId);
+
+    /**
+     * Aggregating counter, increments are summed in process and reported at most once per
+     * flushInterval, and when the last copy of the counter is destroyed
+     */
+    Counter(const char* metricId, std::chrono::milliseconds flushInterval);
+
+    /**
+     * Logs increment counter for the metric
+     */
+    void increment(int64_t amount = 1) const;
+
+    /**
+     * Reports any aggregated increments now
+     */
+    void flush() const;
+
+private:
+    const int64_t mMetricIdHash;
+    const std::shared_ptr<Aggregator> mAggregator;
 };
 
 }  // namespace expresslog
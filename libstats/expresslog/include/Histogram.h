@@ -17,11 +17,14 @@
 #pragma once
 #include <stdint.h>
 
+#include <chrono>
 #include <memory>
 
 namespace android {
 namespace expresslog {
 
+class Aggregator;
+
 /** Histogram encapsulates StatsD write API calls */
 class Histogram final {
 public:
@@ -67,6 +70,13 @@ public:
 
     Histogram(const char* metricName, std::shared_ptr<BinOptions> binOptions);
 
+    /**
+     * Aggregating histogram, per bin sample counts are summed in process and reported at most
+     * once per flushInterval, and when the last copy of the histogram is destroyed
+     */
+    Histogram(const char* metricName, std::shared_ptr<BinOptions> binOptions,
+              std::chrono::milliseconds flushInterval);
+
     /**
      * Logs increment sample count for automatically calculated bin
      */
@@ -77,9 +87,15 @@ public:
      */
     void logSampleWithUid(int32_t uid, float sample) const;
 
+    /**
+     * Reports any aggregated samples now
+     */
+    void flush() const;
+
 private:
     const int64_t mMetricIdHash;
     const std::shared_ptr<BinOptions> mBinOptions;
+    const std::shared_ptr<Aggregator> mAggregator;
 };
 
 }  // namespace expresslog
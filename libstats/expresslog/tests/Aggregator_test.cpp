@@ -0,0 +1,114 @@
+//
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Aggregator.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace expresslog {
+
+namespace {
+
+std::map<int, int64_t> gFlushed;
+int gFlushCalls;
+
+void recordFlush(int64_t metricIdHash, int slot, int64_t count) {
+    EXPECT_EQ(42, metricIdHash);
+    gFlushed[slot] += count;
+    gFlushCalls++;
+}
+
+void resetFlushed() {
+    gFlushed.clear();
+    gFlushCalls = 0;
+}
+
+}  // namespace
+
+TEST(Aggregator, flushesAccumulatedSlots) {
+    resetFlushed();
+    Aggregator aggregator(42, 3, std::chrono::hours(1), recordFlush);
+    aggregator.add(0, 1);
+    aggregator.add(0, 2);
+    aggregator.add(2, 5);
+    ASSERT_EQ(0, gFlushCalls);
+
+    aggregator.flush();
+    ASSERT_EQ(2, gFlushCalls);
+    ASSERT_EQ(3, gFlushed[0]);
+    ASSERT_EQ(5, gFlushed[2]);
+    ASSERT_EQ(0u, gFlushed.count(1));
+
+    // Nothing left to report
+    aggregator.flush();
+    ASSERT_EQ(2, gFlushCalls);
+}
+
+TEST(Aggregator, ignoresOutOfRangeSlots) {
+    resetFlushed();
+    Aggregator aggregator(42, 2, std::chrono::hours(1), recordFlush);
+    aggregator.add(-1, 1);
+    aggregator.add(2, 1);
+    aggregator.flush();
+    ASSERT_EQ(0, gFlushCalls);
+}
+
+TEST(Aggregator, flushesOnDestruction) {
+    resetFlushed();
+    {
+        Aggregator aggregator(42, 1, std::chrono::hours(1), recordFlush);
+        aggregator.add(0, 7);
+    }
+    ASSERT_EQ(1, gFlushCalls);
+    ASSERT_EQ(7, gFlushed[0]);
+}
+
+TEST(Aggregator, flushesWhenIntervalElapsed) {
+    resetFlushed();
+    Aggregator aggregator(42, 1, std::chrono::milliseconds(0), recordFlush);
+    aggregator.add(0, 1);
+    ASSERT_EQ(1, gFlushCalls);
+    ASSERT_EQ(1, gFlushed[0]);
+}
+
+TEST(Aggregator, countsAllConcurrentAdds) {
+    static std::atomic<int64_t> total;
+    total = 0;
+    {
+        Aggregator aggregator(42, 1, std::chrono::milliseconds(1),
+                              [](int64_t, int, int64_t count) { total += count; });
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++) {
+            threads.emplace_back([&aggregator] {
+                for (int j = 0; j < 10000; j++) {
+                    aggregator.add(0, 1);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    ASSERT_EQ(40000, total);
+}
+
+}  // namespace expresslog
+}  // namespace android
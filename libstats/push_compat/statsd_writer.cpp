@@ -41,6 +41,21 @@ static atomic_int dropped = 0;
 static atomic_int log_error = 0;
 static atomic_int atom_tag = 0;
 
+/*
+ * While statsd is down every write would otherwise pay a socket(),
+ * setsockopt(), connect() and close() to find out.  After a failed
+ * reconnect, hold off further attempts for a short while; the atoms are
+ * dropped and reported through the drop counter as before.
+ */
+static const int64_t kReconnectBackoffNs = 20 * 1000 * 1000;
+static atomic_llong next_reconnect_ns = 0;
+
+static int64_t statsdNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 void statsd_writer_init_lock() {
     /*
      * If we trigger a signal handler in the middle of locked activity and the
@@ -256,6 +271,9 @@ static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr) {
         case -ENOTCONN:
         case -ECONNREFUSED:
         case -ENOENT:
+            if (statsdNowNs() < atomic_load_explicit(&next_reconnect_ns, memory_order_relaxed)) {
+                return ret;
+            }
             if (statd_writer_trylock()) {
                 return ret; /* in a signal handler? try again when less stressed
                              */
@@ -265,6 +283,8 @@ static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr) {
             statsd_writer_init_unlock();
 
             if (ret < 0) {
+                atomic_store_explicit(&next_reconnect_ns, statsdNowNs() + kReconnectBackoffNs,
+                                      memory_order_relaxed);
                 return ret;
             }
 
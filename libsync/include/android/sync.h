@@ -37,6 +37,8 @@
  * break builds.
  */
 
+#include <stddef.h>
+
 #include "../ndk/sync.h"
 
 __BEGIN_DECLS
@@ -44,6 +46,24 @@ __BEGIN_DECLS
 /* timeout in msecs */
 int sync_wait(int fd, int timeout);
 
+/* Waits for any of the count fences in fds to signal, with a single poll().
+ * Returns the index of a signaled fence, or -1 with errno set to ETIME on
+ * timeout and EINVAL if a fence is invalid or in an error state.
+ */
+int sync_wait_any(const int* fds, size_t count, int timeout);
+
+/* Waits for all of the count fences in fds to signal. timeout (in msecs)
+ * bounds the whole wait, not each fence. Returns 0, or -1 with errno set as
+ * for sync_wait_any().
+ */
+int sync_wait_all(const int* fds, size_t count, int timeout);
+
+/* Merges the count fences in fds into a new fence, using a balanced tree of
+ * pairwise merges. The caller keeps ownership of fds. Returns the new fence
+ * fd, or -1 on error.
+ */
+int sync_merge_many(const char* name, const int* fds, size_t count);
+
 __END_DECLS
 
 #endif /* __SYS_CORE_SYNC_H */
@@ -23,6 +23,8 @@
 #include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <sys/ioctl.h>
 #include <sys/stat.h>
@@ -151,6 +153,128 @@ int sync_wait(int fd, int timeout)
     return ret;
 }
 
+static int64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static struct pollfd *alloc_fence_pollfds(const int *fds, size_t count)
+{
+    struct pollfd *pfds;
+    size_t i;
+
+    if (fds == NULL || count == 0 || count > INT32_MAX) {
+        errno = EINVAL;
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        if (fds[i] < 0) {
+            errno = EINVAL;
+            return NULL;
+        }
+    }
+
+    pfds = calloc(count, sizeof(*pfds));
+    if (pfds == NULL)
+        return NULL;
+    for (i = 0; i < count; i++) {
+        pfds[i].fd = fds[i];
+        pfds[i].events = POLLIN;
+    }
+    return pfds;
+}
+
+int sync_wait_any(const int *fds, size_t count, int timeout)
+{
+    struct pollfd *pfds;
+    size_t i;
+    int ret;
+
+    pfds = alloc_fence_pollfds(fds, count);
+    if (pfds == NULL)
+        return -1;
+
+    do {
+        ret = poll(pfds, count, timeout);
+    } while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+
+    if (ret == 0) {
+        errno = ETIME;
+        ret = -1;
+    } else if (ret > 0) {
+        ret = -1;
+        for (i = 0; i < count; i++) {
+            if (pfds[i].revents & (POLLERR | POLLNVAL)) {
+                ret = -1;
+                break;
+            }
+            if (ret < 0 && (pfds[i].revents & POLLIN))
+                ret = i;
+        }
+        if (ret < 0)
+            errno = EINVAL;
+    }
+
+    free(pfds);
+    return ret;
+}
+
+int sync_wait_all(const int *fds, size_t count, int timeout)
+{
+    struct pollfd *pfds;
+    size_t pending = count;
+    int64_t deadline = 0;
+    int remaining = timeout;
+    size_t i;
+    int ret = 0;
+
+    pfds = alloc_fence_pollfds(fds, count);
+    if (pfds == NULL)
+        return -1;
+
+    if (timeout > 0)
+        deadline = monotonic_ms() + timeout;
+
+    while (pending > 0) {
+        ret = poll(pfds, count, remaining);
+        if (ret == -1 && errno != EINTR && errno != EAGAIN)
+            break;
+        if (ret == 0) {
+            errno = ETIME;
+            ret = -1;
+            break;
+        }
+        if (ret > 0) {
+            for (i = 0; i < count; i++) {
+                if (pfds[i].fd < 0)
+                    continue;
+                if (pfds[i].revents & (POLLERR | POLLNVAL)) {
+                    errno = EINVAL;
+                    ret = -1;
+                    goto out;
+                }
+                if (pfds[i].revents & POLLIN) {
+                    // poll() ignores negative fds, so signaled fences drop out
+                    // of later iterations.
+                    pfds[i].fd = -1;
+                    pending--;
+                }
+            }
+            ret = 0;
+        }
+        if (timeout > 0) {
+            int64_t now = monotonic_ms();
+            remaining = now < deadline ? (int)(deadline - now) : 0;
+        }
+    }
+
+out:
+    free(pfds);
+    return ret;
+}
+
 static int legacy_sync_merge(const char *name, int fd1, int fd2)
 {
     struct sync_legacy_merge_data data;
@@ -206,6 +330,76 @@ int sync_merge(const char *name, int fd1, int fd2)
     return ret;
 }
 
+int sync_merge_many(const char *name, const int *fds, size_t count)
+{
+    int *level;
+    size_t level_count;
+    size_t i;
+    int ret;
+
+    if (fds == NULL || count == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (count == 1)
+        return fcntl(fds[0], F_DUPFD_CLOEXEC, 0);
+
+    // Merge pairwise, one level at a time, so every fence is copied
+    // O(log count) times instead of the O(count) a linear chain of merges
+    // would cost for the first fences.
+    level = malloc(((count + 1) / 2) * sizeof(*level));
+    if (level == NULL)
+        return -1;
+
+    level_count = 0;
+    for (i = 0; i + 1 < count; i += 2) {
+        ret = sync_merge(name, fds[i], fds[i + 1]);
+        if (ret < 0)
+            goto fail;
+        level[level_count++] = ret;
+    }
+    if (i < count) {
+        ret = fcntl(fds[i], F_DUPFD_CLOEXEC, 0);
+        if (ret < 0)
+            goto fail;
+        level[level_count++] = ret;
+    }
+
+    while (level_count > 1) {
+        size_t next_count = 0;
+        for (i = 0; i + 1 < level_count; i += 2) {
+            ret = sync_merge(name, level[i], level[i + 1]);
+            if (ret < 0) {
+                // Keep the unmerged tail so it's closed below.
+                memmove(&level[next_count], &level[i],
+                        (level_count - i) * sizeof(*level));
+                level_count = next_count + (level_count - i);
+                goto fail;
+            }
+            close(level[i]);
+            close(level[i + 1]);
+            level[next_count++] = ret;
+        }
+        if (i < level_count)
+            level[next_count++] = level[i];
+        level_count = next_count;
+    }
+
+    ret = level[0];
+    free(level);
+    return ret;
+
+fail:
+    {
+        int saved_errno = errno;
+        for (i = 0; i < level_count; i++)
+            close(level[i]);
+        free(level);
+        errno = saved_errno;
+    }
+    return -1;
+}
+
 static struct sync_fence_info_data *legacy_sync_fence_info(int fd)
 {
     struct sync_fence_info_data *legacy_info;
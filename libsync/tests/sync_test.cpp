@@ -477,6 +477,65 @@ TEST(FenceTest, MultiTimelineWait) {
     ASSERT_EQ(mergedFence.wait(100), 0);
 }
 
+TEST(FenceTest, MergeMany) {
+    SyncTimeline timeline;
+    vector<SyncFence> fences;
+    for (int i = 1; i <= 5; i++) {
+        fences.emplace_back(timeline, i);
+    }
+    vector<int> fds;
+    for (auto& fence : fences) {
+        fds.push_back(fence.getFd());
+    }
+
+    int merged = sync_merge_many("mergeMany", fds.data(), fds.size());
+    ASSERT_GE(merged, 0);
+
+    // The inputs stay open and owned by the caller.
+    for (auto& fence : fences) {
+        ASSERT_TRUE(fence.isValid());
+    }
+
+    ASSERT_EQ(sync_wait(merged, 0), -1);
+    ASSERT_EQ(errno, ETIME);
+    timeline.inc(4);
+    ASSERT_EQ(sync_wait(merged, 0), -1);
+    ASSERT_EQ(errno, ETIME);
+    timeline.inc(1);
+    ASSERT_EQ(sync_wait(merged, 0), 0);
+    close(merged);
+
+    ASSERT_EQ(sync_merge_many("mergeMany", fds.data(), 0), -1);
+    ASSERT_EQ(errno, EINVAL);
+}
+
+TEST(FenceTest, WaitAnyAll) {
+    SyncTimeline timelineA, timelineB;
+    SyncFence fenceA(timelineA, 1);
+    SyncFence fenceB(timelineB, 1);
+    int fds[] = {fenceA.getFd(), fenceB.getFd()};
+
+    ASSERT_EQ(sync_wait_any(fds, 2, 0), -1);
+    ASSERT_EQ(errno, ETIME);
+
+    timelineB.inc(1);
+    ASSERT_EQ(sync_wait_any(fds, 2, 0), 1);
+    ASSERT_EQ(sync_wait_all(fds, 2, 0), -1);
+    ASSERT_EQ(errno, ETIME);
+
+    thread signaler([&timelineA]() {
+        usleep(10000);
+        timelineA.inc(1);
+    });
+    ASSERT_EQ(sync_wait_all(fds, 2, 1000), 0);
+    signaler.join();
+    ASSERT_EQ(sync_wait_any(fds, 2, 0), 0);
+
+    int bad[] = {fenceA.getFd(), -1};
+    ASSERT_EQ(sync_wait_all(bad, 2, 0), -1);
+    ASSERT_EQ(errno, EINVAL);
+}
+
 TEST(FenceTest, GetInfoActive) {
     SyncTimeline timeline;
     ASSERT_TRUE(timeline.isValid());
@@ -18,6 +18,11 @@
 
 #include "SocketListener.h"
 
+#include <stdint.h>
+
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 class FrameworkCommand;
@@ -31,9 +36,22 @@ public:
     int errorRate;
 
 private:
+    /* Per-command dispatch statistics, guarded by mStatsLock */
+    struct CommandEntry {
+        FrameworkCommand* cmd;
+        uint64_t count = 0;
+        uint64_t errors = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+    };
+
     int mCommandCount;
     bool mWithSeq;
     std::vector<FrameworkCommand*> mCommands;
+    /* Keyed by command name; the first command registered under a name wins */
+    std::unordered_map<std::string_view, CommandEntry> mCommandIndex;
+    std::mutex mStatsLock;
+    uint64_t mUnknownCommands;
     bool mSkipToNextNullByte;
 
 public:
@@ -42,6 +60,9 @@ public:
     FrameworkListener(int sock);
     ~FrameworkListener() override {}
 
+    /* Writes the number of calls, errors and latency of each command to fd */
+    void dumpCommandStats(int fd);
+
   protected:
     void registerCmd(FrameworkCommand *cmd);
     bool onDataAvailable(SocketClient* c) override;
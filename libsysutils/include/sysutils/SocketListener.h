@@ -33,6 +33,7 @@ class SocketListener {
     int                     mCtrlPipe[2];
     pthread_t               mThread;
     bool                    mUseCmdNum;
+    int                     mEpollFd;
 
 public:
     SocketListener(const char *socketName, bool listen);
@@ -61,6 +62,7 @@ private:
     std::vector<SocketClient*> snapshotClients();
 
     bool release(SocketClient *c, bool wakeup);
+    bool watch(int fd);
     void runListener();
     void init(const char *socketName, int socketFd, bool listen, bool useCmdNum);
 };
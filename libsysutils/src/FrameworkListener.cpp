@@ -17,10 +17,15 @@
 #define LOG_TAG "FrameworkListener"
 
 #include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+
 #include <log/log.h>
 #include <sysutils/FrameworkCommand.h>
 #include <sysutils/FrameworkListener.h>
@@ -47,6 +52,7 @@ void FrameworkListener::init(const char* /*socketName*/, bool withSeq) {
     errorRate = 0;
     mCommandCount = 0;
     mWithSeq = withSeq;
+    mUnknownCommands = 0;
     mSkipToNextNullByte = false;
 }
 
@@ -89,26 +95,40 @@ bool FrameworkListener::onDataAvailable(SocketClient *c) {
 
 void FrameworkListener::registerCmd(FrameworkCommand *cmd) {
     mCommands.push_back(cmd);
+    mCommandIndex.try_emplace(cmd->getCommand(), CommandEntry{cmd});
+}
+
+void FrameworkListener::dumpCommandStats(int fd) {
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    for (auto* c : mCommands) {
+        const CommandEntry& entry = mCommandIndex.at(c->getCommand());
+        if (entry.cmd != c) {
+            continue;
+        }
+        uint64_t avgUs = entry.count ? entry.totalNs / entry.count / 1000 : 0;
+        dprintf(fd, "%s: count=%" PRIu64 " errors=%" PRIu64 " avg=%" PRIu64 "us max=%" PRIu64
+                "us\n", c->getCommand(), entry.count, entry.errors, avgUs, entry.maxNs / 1000);
+    }
+    dprintf(fd, "unrecognized: count=%" PRIu64 "\n", mUnknownCommands);
 }
 
+/*
+ * Arguments are unescaped in place: the unescaped text is never longer than
+ * the raw text, so it is written back into data and argv points into it.
+ */
 void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
     int argc = 0;
     char *argv[FrameworkListener::CMD_ARGS_MAX];
-    char tmp[CMD_BUF_SIZE];
     char *p = data;
-    char *q = tmp;
-    char *qlimit = tmp + sizeof(tmp) - 1;
+    char *q = data;
+    char *arg = data;
     bool esc = false;
     bool quote = false;
     bool haveCmdNum = !mWithSeq;
 
-    memset(argv, 0, sizeof(argv));
-    memset(tmp, 0, sizeof(tmp));
     while(*p) {
         if (*p == '\\') {
             if (esc) {
-                if (q >= qlimit)
-                    goto overflow;
                 *q++ = '\\';
                 esc = false;
             } else
@@ -117,16 +137,12 @@ void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
             continue;
         } else if (esc) {
             if (*p == '"') {
-                if (q >= qlimit)
-                    goto overflow;
                 *q++ = '"';
             } else if (*p == '\\') {
-                if (q >= qlimit)
-                    goto overflow;
                 *q++ = '\\';
             } else {
                 cli->sendMsg(500, "Unsupported escape sequence", false);
-                goto out;
+                return;
             }
             p++;
             esc = false;
@@ -142,27 +158,24 @@ void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
             continue;
         }
 
-        if (q >= qlimit)
-            goto overflow;
         *q = *p++;
         if (!quote && *q == ' ') {
-            *q = '\0';
+            *q++ = '\0';
             if (!haveCmdNum) {
                 char *endptr;
-                int cmdNum = (int)strtol(tmp, &endptr, 0);
+                int cmdNum = (int)strtol(arg, &endptr, 0);
                 if (endptr == nullptr || *endptr != '\0') {
                     cli->sendMsg(500, "Invalid sequence number", false);
-                    goto out;
+                    return;
                 }
                 cli->setCmdNum(cmdNum);
                 haveCmdNum = true;
             } else {
                 if (argc >= CMD_ARGS_MAX)
                     goto overflow;
-                argv[argc++] = strdup(tmp);
+                argv[argc++] = arg;
             }
-            memset(tmp, 0, sizeof(tmp));
-            q = tmp;
+            arg = q;
             continue;
         }
         q++;
@@ -171,7 +184,7 @@ void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
     *q = '\0';
     if (argc >= CMD_ARGS_MAX)
         goto overflow;
-    argv[argc++] = strdup(tmp);
+    argv[argc++] = arg;
 #if 0
     for (int k = 0; k < argc; k++) {
         SLOGD("arg[%d] = '%s'", k, argv[k]);
@@ -180,31 +193,45 @@ void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
 
     if (quote) {
         cli->sendMsg(500, "Unclosed quotes error", false);
-        goto out;
+        return;
     }
 
     if (errorRate && (++mCommandCount % errorRate == 0)) {
         /* ignore this command - let the timeout handler handle it */
         SLOGE("Faking a timeout");
-        goto out;
+        return;
     }
 
-    for (auto* c : mCommands) {
-        if (!strcmp(argv[0], c->getCommand())) {
-            if (c->runCommand(cli, argc, argv)) {
-                SLOGW("Handler '%s' error (%s)", c->getCommand(), strerror(errno));
+    {
+        auto it = mCommandIndex.find(argv[0]);
+        if (it == mCommandIndex.end()) {
+            {
+                std::lock_guard<std::mutex> lock(mStatsLock);
+                mUnknownCommands++;
             }
-            goto out;
+            cli->sendMsg(500, "Command not recognized", false);
+            return;
+        }
+
+        FrameworkCommand* c = it->second.cmd;
+        auto start = std::chrono::steady_clock::now();
+        bool failed = c->runCommand(cli, argc, argv) != 0;
+        if (failed) {
+            SLOGW("Handler '%s' error (%s)", c->getCommand(), strerror(errno));
         }
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+
+        std::lock_guard<std::mutex> lock(mStatsLock);
+        CommandEntry& entry = it->second;
+        entry.count++;
+        entry.errors += failed;
+        entry.totalNs += ns;
+        entry.maxNs = std::max(entry.maxNs, ns);
     }
-    cli->sendMsg(500, "Command not recognized", false);
-out:
-    int j;
-    for (j = 0; j < argc; j++)
-        free(argv[j]);
     return;
 
 overflow:
     cli->sendMsg(500, "Command too long", false);
-    goto out;
 }
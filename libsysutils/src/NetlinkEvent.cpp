@@ -38,6 +38,7 @@
 
 #include <android-base/parseint.h>
 #include <bpf/KernelUtils.h>
+#include <cutils/uevent_view.h>
 #include <log/log.h>
 #include <sysutils/NetlinkEvent.h>
 
@@ -686,37 +687,12 @@ bool NetlinkEvent::parseBinaryNetlinkMessage(char *buffer, int size) {
     return false;
 }
 
-/* If the string between 'str' and 'end' begins with 'prefixlen' characters
- * from the 'prefix' array, then return 'str + prefixlen', otherwise return
- * NULL.
- */
-static const char*
-has_prefix(const char* str, const char* end, const char* prefix, size_t prefixlen)
-{
-    if ((end - str) >= (ptrdiff_t)prefixlen &&
-        (prefixlen == 0 || !memcmp(str, prefix, prefixlen))) {
-        return str + prefixlen;
-    } else {
-        return nullptr;
-    }
-}
-
-/* Same as strlen(x) for constant string literals ONLY */
-#define CONST_STRLEN(x)  (sizeof(x)-1)
-
-/* Convenience macro to call has_prefix with a constant string literal  */
-#define HAS_CONST_PREFIX(str,end,prefix)  has_prefix((str),(end),prefix,CONST_STRLEN(prefix))
-
-
 /*
  * Parse an ASCII-formatted message from a NETLINK_KOBJECT_UEVENT
  * netlink socket.
  */
 bool NetlinkEvent::parseAsciiNetlinkMessage(char *buffer, int size) {
-    const char *s = buffer;
-    const char *end;
     int param_idx = 0;
-    int first = 1;
 
     if (size == 0)
         return false;
@@ -724,38 +700,33 @@ bool NetlinkEvent::parseAsciiNetlinkMessage(char *buffer, int size) {
     /* Ensure the buffer is zero-terminated, the code below depends on this */
     buffer[size-1] = '\0';
 
-    end = s + size;
-    while (s < end) {
-        if (first) {
-            const char *p;
-            /* buffer is 0-terminated, no need to check p < end */
-            for (p = s; *p != '@'; p++) {
-                if (!*p) { /* no '@', should not happen */
-                    return false;
-                }
-            }
-            mPath = strdup(p+1);
-            first = 0;
-        } else {
-            const char* a;
-            if ((a = HAS_CONST_PREFIX(s, end, "ACTION=")) != nullptr) {
-                if (!strcmp(a, "add"))
-                    mAction = Action::kAdd;
-                else if (!strcmp(a, "remove"))
-                    mAction = Action::kRemove;
-                else if (!strcmp(a, "change"))
-                    mAction = Action::kChange;
-            } else if ((a = HAS_CONST_PREFIX(s, end, "SEQNUM=")) != nullptr) {
-                if (!ParseInt(a, &mSeq)) {
-                    SLOGE("NetlinkEvent::parseAsciiNetlinkMessage: failed to parse SEQNUM=%s", a);
-                }
-            } else if ((a = HAS_CONST_PREFIX(s, end, "SUBSYSTEM=")) != nullptr) {
-                mSubsystem = strdup(a);
-            } else if (param_idx < NL_PARAMS_MAX) {
-                mParams[param_idx++] = strdup(s);
+    android::UeventView uevent(buffer, size);
+    std::string_view header = uevent.header();
+    if (header.empty()) { /* no '@', should not happen */
+        return false;
+    }
+    mPath = strdup(header.data() + header.find('@') + 1);
+
+    /* Every value is followed by a '\0' in buffer, so value.data() can be
+     * used as a C string. */
+    for (const auto& [key, value] : uevent) {
+        if (key == "ACTION") {
+            if (value == "add")
+                mAction = Action::kAdd;
+            else if (value == "remove")
+                mAction = Action::kRemove;
+            else if (value == "change")
+                mAction = Action::kChange;
+        } else if (key == "SEQNUM") {
+            if (!ParseInt(value.data(), &mSeq)) {
+                SLOGE("NetlinkEvent::parseAsciiNetlinkMessage: failed to parse SEQNUM=%s",
+                      value.data());
             }
+        } else if (key == "SUBSYSTEM") {
+            mSubsystem = strdup(value.data());
+        } else if (param_idx < NL_PARAMS_MAX) {
+            mParams[param_idx++] = strdup(key.data());
         }
-        s += strlen(s) + 1;
     }
     return true;
 }
@@ -18,13 +18,13 @@
 
 #include <errno.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <linux/netlink.h> /* out of order because must follow sys/socket.h */
 
-#include <cutils/uevent.h>
 #include <log/log.h>
 #include <sysutils/NetlinkEvent.h>
 
@@ -43,33 +43,65 @@ NetlinkListener::NetlinkListener(int socket, int format) :
                             SocketListener(socket, false), mFormat(format) {
 }
 
+/* Upper bound of messages handled per wakeup, so a flood can not starve
+ * the listener thread of its shutdown control pipe.
+ */
+static const int kMaxMessagesPerWakeup = 64;
+
+/* Same checks as uevent_kernel_recv(), but non-blocking so that a burst of
+ * messages can be drained with one poll() wakeup.
+ */
+static ssize_t netlinkRecv(int socket, void* buffer, size_t length, bool require_group) {
+    struct iovec iov = {buffer, length};
+    struct sockaddr_nl addr;
+    char control[CMSG_SPACE(sizeof(struct ucred))];
+    struct msghdr hdr = {
+        &addr, sizeof(addr), &iov, 1, control, sizeof(control), 0,
+    };
+
+    ssize_t n = TEMP_FAILURE_RETRY(recvmsg(socket, &hdr, MSG_DONTWAIT));
+    if (n <= 0) {
+        return n;
+    }
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    if (cmsg == NULL || cmsg->cmsg_type != SCM_CREDENTIALS || addr.nl_pid != 0 ||
+        (require_group && addr.nl_groups == 0)) {
+        /* clear residual potentially malicious data */
+        bzero(buffer, length);
+        errno = EIO;
+        return -1;
+    }
+    return n;
+}
+
 bool NetlinkListener::onDataAvailable(SocketClient *cli)
 {
     int socket = cli->getSocket();
-    ssize_t count;
-    uid_t uid = -1;
 
     bool require_group = true;
     if (mFormat == NETLINK_FORMAT_BINARY_UNICAST) {
         require_group = false;
     }
 
-    count = TEMP_FAILURE_RETRY(uevent_kernel_recv(socket,
-            mBuffer, sizeof(mBuffer), require_group, &uid));
-    if (count < 0) {
-        SLOGE("recvmsg failed (%s)", strerror(errno));
-        return false;
-    }
+    for (int i = 0; i < kMaxMessagesPerWakeup; ++i) {
+        ssize_t count = netlinkRecv(socket, mBuffer, sizeof(mBuffer), require_group);
+        if (count < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            SLOGE("recvmsg failed (%s)", strerror(errno));
+            return false;
+        }
 
-    NetlinkEvent *evt = new NetlinkEvent();
-    if (evt->decode(mBuffer, count, mFormat)) {
-        onEvent(evt);
-    } else if (mFormat != NETLINK_FORMAT_BINARY) {
-        // Don't complain if parseBinaryNetlinkMessage returns false. That can
-        // just mean that the buffer contained no messages we're interested in.
-        SLOGE("Error decoding NetlinkEvent");
+        NetlinkEvent evt;
+        if (evt.decode(mBuffer, count, mFormat)) {
+            onEvent(&evt);
+        } else if (mFormat != NETLINK_FORMAT_BINARY) {
+            // Don't complain if parseBinaryNetlinkMessage returns false. That can
+            // just mean that the buffer contained no messages we're interested in.
+            SLOGE("Error decoding NetlinkEvent");
+        }
     }
-
-    delete evt;
     return true;
 }
@@ -19,7 +19,7 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -36,6 +36,10 @@
 #define CtrlPipe_Shutdown 0
 #define CtrlPipe_Wakeup   1
 
+// Ready events collected per epoll_wait(), level triggered so the
+// remainder is simply picked up on the next pass.
+static constexpr int kMaxEvents = 32;
+
 SocketListener::SocketListener(const char *socketName, bool listen) {
     init(socketName, -1, listen, false);
 }
@@ -53,9 +57,23 @@ void SocketListener::init(const char *socketName, int socketFd, bool listen, boo
     mSocketName = socketName;
     mSock = socketFd;
     mUseCmdNum = useCmdNum;
+    mCtrlPipe[0] = -1;
+    mCtrlPipe[1] = -1;
+    mEpollFd = -1;
     pthread_mutex_init(&mClientsLock, nullptr);
 }
 
+bool SocketListener::watch(int fd) {
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        SLOGE("epoll_ctl add %d failed (%s)", fd, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
 SocketListener::~SocketListener() {
     if (mSocketName && mSock > -1)
         close(mSock);
@@ -64,6 +82,7 @@ SocketListener::~SocketListener() {
         close(mCtrlPipe[0]);
         close(mCtrlPipe[1]);
     }
+    if (mEpollFd != -1) close(mEpollFd);
     for (auto pair : mClients) {
         pair.second->decRef();
     }
@@ -100,6 +119,14 @@ int SocketListener::startListener(int backlog) {
         return -1;
     }
 
+    // The set is kept up to date as clients come and go, rather than
+    // rebuilding a pollfd for every client on every wakeup.
+    if ((mEpollFd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        SLOGE("epoll_create1 failed (%s)", strerror(errno));
+        return -1;
+    }
+    if (!watch(mCtrlPipe[0]) || !watch(mSock)) return -1;
+
     if (pthread_create(&mThread, nullptr, SocketListener::threadStart, this)) {
         SLOGE("pthread_create (%s)", strerror(errno));
         return -1;
@@ -127,6 +154,8 @@ int SocketListener::stopListener() {
     close(mCtrlPipe[1]);
     mCtrlPipe[0] = -1;
     mCtrlPipe[1] = -1;
+    close(mEpollFd);
+    mEpollFd = -1;
 
     if (mSocketName && mSock > -1) {
         close(mSock);
@@ -149,30 +178,26 @@ void *SocketListener::threadStart(void *obj) {
 }
 
 void SocketListener::runListener() {
-    while (true) {
-        std::vector<pollfd> fds;
-
-        pthread_mutex_lock(&mClientsLock);
-        fds.reserve(2 + mClients.size());
-        fds.push_back({.fd = mCtrlPipe[0], .events = POLLIN});
-        if (mListen) fds.push_back({.fd = mSock, .events = POLLIN});
-        for (auto pair : mClients) {
-            // NB: calling out to an other object with mClientsLock held (safe)
-            const int fd = pair.second->getSocket();
-            if (fd != pair.first) SLOGE("fd mismatch: %d != %d", fd, pair.first);
-            fds.push_back({.fd = fd, .events = POLLIN});
-        }
-        pthread_mutex_unlock(&mClientsLock);
+    struct epoll_event events[kMaxEvents];
+    std::vector<SocketClient*> pending;
+    pending.reserve(kMaxEvents);
 
+    while (true) {
         SLOGV("mListen=%d, mSocketName=%s", mListen, mSocketName);
-        int rc = TEMP_FAILURE_RETRY(poll(fds.data(), fds.size(), -1));
+        int rc = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd, events, kMaxEvents, -1));
         if (rc < 0) {
-            SLOGE("poll failed (%s) mListen=%d", strerror(errno), mListen);
+            SLOGE("epoll_wait failed (%s) mListen=%d", strerror(errno), mListen);
             sleep(1);
             continue;
         }
 
-        if (fds[0].revents & (POLLIN | POLLERR)) {
+        bool ctrl = false;
+        bool incoming = false;
+        for (int i = 0; i < rc; ++i) {
+            if (events[i].data.fd == mCtrlPipe[0]) ctrl = true;
+            if (mListen && events[i].data.fd == mSock) incoming = true;
+        }
+        if (ctrl) {
             char c = CtrlPipe_Shutdown;
             TEMP_FAILURE_RETRY(read(mCtrlPipe[0], &c, 1));
             if (c == CtrlPipe_Shutdown) {
@@ -180,7 +205,7 @@ void SocketListener::runListener() {
             }
             continue;
         }
-        if (mListen && (fds[1].revents & (POLLIN | POLLERR))) {
+        if (incoming) {
             int c = TEMP_FAILURE_RETRY(accept4(mSock, nullptr, nullptr, SOCK_CLOEXEC));
             if (c < 0) {
                 SLOGE("accept failed (%s)", strerror(errno));
@@ -188,21 +213,25 @@ void SocketListener::runListener() {
                 continue;
             }
             pthread_mutex_lock(&mClientsLock);
-            mClients[c] = new SocketClient(c, true, mUseCmdNum);
+            if (watch(c)) {
+                mClients[c] = new SocketClient(c, true, mUseCmdNum);
+            } else {
+                close(c);
+            }
             pthread_mutex_unlock(&mClientsLock);
         }
 
         // Add all active clients to the pending list first, so we can release
         // the lock before invoking the callbacks.
-        std::vector<SocketClient*> pending;
+        pending.clear();
         pthread_mutex_lock(&mClientsLock);
-        const int size = fds.size();
-        for (int i = mListen ? 2 : 1; i < size; ++i) {
-            const struct pollfd& p = fds[i];
-            if (p.revents & (POLLIN | POLLERR)) {
-                auto it = mClients.find(p.fd);
+        for (int i = 0; i < rc; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == mCtrlPipe[0] || (mListen && fd == mSock)) continue;
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                auto it = mClients.find(fd);
                 if (it == mClients.end()) {
-                    SLOGE("fd vanished: %d", p.fd);
+                    SLOGE("fd vanished: %d", fd);
                     continue;
                 }
                 SocketClient* c = it->second;
@@ -231,6 +260,10 @@ bool SocketListener::release(SocketClient* c, bool wakeup) {
         SLOGV("going to zap %d for %s", c->getSocket(), mSocketName);
         pthread_mutex_lock(&mClientsLock);
         ret = (mClients.erase(c->getSocket()) != 0);
+        if (ret) {
+            // Drop it from the set while the fd is surely still open.
+            epoll_ctl(mEpollFd, EPOLL_CTL_DEL, c->getSocket(), nullptr);
+        }
         pthread_mutex_unlock(&mClientsLock);
         if (ret) {
             ret = c->decRef();
@@ -172,6 +172,21 @@ TEST_F(FrameworkListenerTest, RejectsInvalidCommands) {
     testCommand("test \\a", "500 Unsupported escape sequence");
 }
 
+TEST_F(FrameworkListenerTest, DumpsCommandStats) {
+    testCommand("test arg1", "42 test,arg1");
+    testCommand("test arg2", "42 test,arg2");
+    testCommand("unknown", "500 Command not recognized");
+
+    // Commands are dispatched one at a time, so the stats of both "test"
+    // commands are recorded by the time "unknown" has been replied to.
+    TemporaryFile tf;
+    mListener->dumpCommandStats(tf.fd);
+    std::string dump;
+    ASSERT_TRUE(android::base::ReadFileToString(tf.path, &dump));
+    EXPECT_TRUE(android::base::StartsWith(dump, "test: count=2 errors=0 ")) << dump;
+    EXPECT_TRUE(android::base::EndsWith(dump, "\nunrecognized: count=1\n")) << dump;
+}
+
 TEST_F(FrameworkListenerTest, MultipleClients) {
     unique_fd client1 = clientSocket(mSocketPath);
     unique_fd client2 = clientSocket(mSocketPath);
@@ -245,6 +245,32 @@ int usb_device_bulk_transfer(struct usb_device *device,
                             unsigned int length,
                             unsigned int timeout);
 
+/* Reads or writes length bytes on a bulk endpoint, split into chunk_size URBs
+ * with up to depth of them in flight at once, so the host controller never
+ * idles between chunks the way it does with back-to-back
+ * usb_device_bulk_transfer() calls. A short read ends an IN transfer early.
+ * timeout (in milliseconds, 0 for none) applies to each URB's completion.
+ * The caller must not have other requests in flight on the device.
+ * Returns number of bytes transferred, or -1 with errno set for error.
+ */
+int usb_device_bulk_transfer_queued(struct usb_device *device,
+                                    int endpoint,
+                                    void* buffer,
+                                    unsigned int length,
+                                    unsigned int chunk_size,
+                                    unsigned int depth,
+                                    unsigned int timeout);
+
+/* Allocates a buffer mapped from usbfs. Transfers to or from it skip the
+ * kernel's copy into its own bounce buffer. Returns NULL if the kernel
+ * doesn't support usbfs mmap, in which case callers should fall back to
+ * ordinary memory. Free with usb_device_free_buffer().
+ */
+void *usb_device_alloc_buffer(struct usb_device *device, size_t size);
+
+/* Releases a buffer returned by usb_device_alloc_buffer() */
+void usb_device_free_buffer(struct usb_device *device, void *buffer, size_t size);
+
 /** Reset USB bus for the device */
 int usb_device_reset(struct usb_device *device);
 
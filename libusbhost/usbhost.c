@@ -29,6 +29,7 @@
 #include <stddef.h>
 
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/inotify.h>
@@ -60,7 +61,13 @@
 // Some devices fail to send string descriptors if we attempt reading > 255 bytes
 #define MAX_STRING_DESCRIPTOR_LENGTH    255
 
-#define MAX_USBFS_WD_COUNT      10
+// One watch for USB_FS_DIR itself, plus one per bus directory. Bus numbers are
+// allocated by the kernel starting at 1 and hosts with many controllers (hubs
+// on test racks, for example) easily exceed single digits.
+#define MAX_USBFS_WD_COUNT      128
+
+// Upper bound on URBs a single usb_device_bulk_transfer_queued() keeps in flight.
+#define MAX_QUEUED_BULK_URBS    64
 
 struct usb_host_context {
     int                         fd;
@@ -139,19 +146,30 @@ static void watch_existing_subdirs(struct usb_host_context *context,
                                    int *wds, int wd_count)
 {
     char path[100];
+    DIR *busdir;
+    struct dirent *de;
     int i, ret;
 
     wds[0] = inotify_add_watch(context->fd, USB_FS_DIR, IN_CREATE | IN_DELETE);
     if (wds[0] < 0)
         return;
 
-    /* watch existing subdirectories of USB_FS_DIR */
-    for (i = 1; i < wd_count; i++) {
-        snprintf(path, sizeof(path), USB_FS_DIR "/%03d", i);
+    /* watch existing subdirectories of USB_FS_DIR, without probing every
+     * possible bus number */
+    busdir = opendir(USB_FS_DIR);
+    if (busdir == 0)
+        return;
+    while ((de = readdir(busdir)) != 0) {
+        if (badname(de->d_name)) continue;
+        i = atoi(de->d_name);
+        if (i <= 0 || i >= wd_count) continue;
+
+        snprintf(path, sizeof(path), USB_FS_DIR "/%s", de->d_name);
         ret = inotify_add_watch(context->fd, path, IN_CREATE | IN_DELETE);
         if (ret >= 0)
             wds[i] = ret;
     }
+    closedir(busdir);
 }
 
 struct usb_host_context *usb_host_init()
@@ -223,7 +241,8 @@ int usb_host_load(struct usb_host_context *context,
 int usb_host_read_event(struct usb_host_context *context)
 {
     struct inotify_event* event;
-    char event_buf[512];
+    /* large enough to drain a burst of hotplug events with a single read */
+    char event_buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
     char path[100];
     int i, ret, done = 0;
     int offset = 0;
@@ -678,6 +697,142 @@ int usb_device_bulk_transfer(struct usb_device *device,
     return ioctl(device->fd, USBDEVFS_BULK, &ctrl);
 }
 
+static void discard_urbs(struct usb_device *device, struct usbdevfs_urb *urbs,
+                         int first, int count, int depth)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+        ioctl(device->fd, USBDEVFS_DISCARDURB, &urbs[(first + i) % depth]);
+}
+
+int usb_device_bulk_transfer_queued(struct usb_device *device,
+                                    int endpoint,
+                                    void* buffer,
+                                    unsigned int length,
+                                    unsigned int chunk_size,
+                                    unsigned int depth,
+                                    unsigned int timeout)
+{
+    const int is_in = (endpoint & USB_ENDPOINT_DIR_MASK) == USB_DIR_IN;
+    struct usbdevfs_urb *urbs;
+    unsigned int offset = 0;
+    int first = 0, in_flight = 0, submitted = 0;
+    int total = 0, error = 0, stopping = 0;
+
+    if (chunk_size == 0 || depth == 0 || length > INT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (depth > MAX_QUEUED_BULK_URBS)
+        depth = MAX_QUEUED_BULK_URBS;
+
+    urbs = calloc(depth, sizeof(*urbs));
+    if (!urbs)
+        return -1;
+
+    do {
+        /* keep the queue full */
+        while (!stopping && in_flight < (int)depth && offset < length) {
+            struct usbdevfs_urb *urb = &urbs[(first + in_flight) % depth];
+            unsigned int len = length - offset;
+            if (len > chunk_size)
+                len = chunk_size;
+
+            memset(urb, 0, sizeof(*urb));
+            urb->type = USBDEVFS_URB_TYPE_BULK;
+            urb->endpoint = endpoint;
+            urb->buffer = (char*)buffer + offset;
+            urb->buffer_length = len;
+            if (is_in) {
+                /* A short read ends the transfer: have the kernel cancel the
+                 * URBs queued behind it rather than fill them with the start
+                 * of the next transfer. */
+                urb->flags = USBDEVFS_URB_SHORT_NOT_OK;
+                if (submitted > 0)
+                    urb->flags |= USBDEVFS_URB_BULK_CONTINUATION;
+            }
+
+            if (TEMP_FAILURE_RETRY(ioctl(device->fd, USBDEVFS_SUBMITURB, urb)) < 0) {
+                error = errno;
+                stopping = 1;
+                discard_urbs(device, urbs, first, in_flight, depth);
+                break;
+            }
+            offset += len;
+            in_flight++;
+            submitted++;
+        }
+
+        if (in_flight == 0)
+            break;
+
+        if (timeout > 0 && !stopping) {
+            struct pollfd p = {.fd = device->fd, .events = POLLOUT, .revents = 0};
+            int res = TEMP_FAILURE_RETRY(poll(&p, 1, timeout));
+            if (res != 1 || !(p.revents & POLLOUT)) {
+                error = res == 0 ? ETIMEDOUT : (res < 0 ? errno : EIO);
+                stopping = 1;
+                discard_urbs(device, urbs, first, in_flight, depth);
+            }
+        }
+
+        /* Discarded URBs still have to be reaped before their memory can be
+         * released, so block once we're stopping. */
+        struct usbdevfs_urb *urb = NULL;
+        if (TEMP_FAILURE_RETRY(ioctl(device->fd, USBDEVFS_REAPURB, &urb)) < 0) {
+            if (!error)
+                error = errno;
+            break;
+        }
+        if (urb != &urbs[first]) {
+            /* completions on one endpoint arrive in submission order */
+            if (!error)
+                error = EIO;
+            break;
+        }
+        first = (first + 1) % depth;
+        in_flight--;
+
+        if (stopping)
+            continue;
+        if (urb->status == 0 || urb->status == -EREMOTEIO) {
+            total += urb->actual_length;
+            if (urb->actual_length < urb->buffer_length) {
+                stopping = 1;
+                discard_urbs(device, urbs, first, in_flight, depth);
+            }
+        } else {
+            error = -urb->status;
+            stopping = 1;
+            discard_urbs(device, urbs, first, in_flight, depth);
+        }
+    } while (in_flight > 0 || (!stopping && offset < length));
+
+    free(urbs);
+    if (error) {
+        errno = error;
+        return -1;
+    }
+    return total;
+}
+
+void *usb_device_alloc_buffer(struct usb_device *device, size_t size)
+{
+    void *buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, device->fd, 0);
+    if (buffer == MAP_FAILED) {
+        D("usb_device_alloc_buffer failed errno %d\n", errno);
+        return NULL;
+    }
+    return buffer;
+}
+
+void usb_device_free_buffer(struct usb_device *device __attribute__((unused)),
+                            void *buffer, size_t size)
+{
+    munmap(buffer, size);
+}
+
 int usb_device_reset(struct usb_device *device)
 {
     return ioctl(device->fd, USBDEVFS_RESET);
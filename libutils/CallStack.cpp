@@ -20,13 +20,26 @@
 #include <utils/Errors.h>
 #include <log/log.h>
 
+#include <string.h>
+
+#include <algorithm>
+
 #include <unwindstack/AndroidUnwinder.h>
+#include <unwindstack/Unwinder.h>
 
 #define CALLSTACK_WEAK  // Don't generate weak definitions.
 #include <utils/CallStack.h>
 
+// bionic's frame pointer walk, which is bounded by the thread's stack. It is weak so that the
+// slower checks below are used where it is not available.
+extern "C" size_t android_unsafe_frame_pointer_chase(uintptr_t* buf, size_t num_entries)
+        __attribute__((weak));
+
 namespace android {
 
+// The deepest stack that updatePcs() records.
+static constexpr size_t kMaxPcs = 64;
+
 CallStack::CallStack() {
 }
 
@@ -43,7 +56,7 @@ void CallStack::update(int32_t ignoreDepth, pid_t tid) {
         ignoreDepth = 0;
     }
 
-    mFrameLines.clear();
+    clear();
 
     unwindstack::AndroidLocalUnwinder unwinder;
     unwindstack::AndroidUnwinderData data;
@@ -61,6 +74,60 @@ void CallStack::update(int32_t ignoreDepth, pid_t tid) {
     }
 }
 
+void CallStack::updatePcs(int32_t ignoreDepth) {
+    if (ignoreDepth < 0) {
+        ignoreDepth = 0;
+    }
+
+    uintptr_t pcs[kMaxPcs];
+    setPcs(pcs, capturePcs(pcs, kMaxPcs, ignoreDepth + 1));
+}
+
+void CallStack::setPcs(const uintptr_t* pcs, size_t count) {
+    clear();
+    mPcs.appendArray(pcs, count);
+}
+
+__attribute__((noinline, no_sanitize("address", "hwaddress"))) size_t CallStack::capturePcs(
+        uintptr_t* pcs, size_t maxFrames, int32_t ignoreDepth) {
+    // Frame 0 is this function, as it is for update(). Neither walk below records it.
+    size_t skip = ignoreDepth > 0 ? static_cast<size_t>(ignoreDepth) - 1 : 0;
+    size_t count = 0;
+
+    if (android_unsafe_frame_pointer_chase != nullptr) {
+        // The chase records its own return address into this function first.
+        skip++;
+        count = std::min(android_unsafe_frame_pointer_chase(pcs, maxFrames), maxFrames);
+    } else {
+#if defined(__aarch64__) || defined(__i386__) || defined(__x86_64__)
+        // Without the stack bounds, only follow frames that move up the stack by plausible
+        // amounts.
+        struct FrameRecord {
+            const FrameRecord* next;
+            uintptr_t returnAddress;
+        };
+        static constexpr uintptr_t kMaxFrameSize = 1024 * 1024;
+        const FrameRecord* frame = static_cast<const FrameRecord*>(__builtin_frame_address(0));
+        while (count < maxFrames && frame->returnAddress != 0) {
+            pcs[count++] = frame->returnAddress;
+            uintptr_t current = reinterpret_cast<uintptr_t>(frame);
+            uintptr_t next = reinterpret_cast<uintptr_t>(frame->next);
+            if (next <= current || next - current > kMaxFrameSize ||
+                next % sizeof(uintptr_t) != 0) {
+                break;
+            }
+            frame = frame->next;
+        }
+#endif
+    }
+
+    if (skip >= count) {
+        return 0;
+    }
+    memmove(pcs, pcs + skip, (count - skip) * sizeof(uintptr_t));
+    return count - skip;
+}
+
 void CallStack::log(const char* logtag, android_LogPriority priority, const char* prefix) const {
     LogPrinter printer(logtag, priority, prefix, /*ignoreBlankLines*/false);
     print(printer);
@@ -81,6 +148,22 @@ String8 CallStack::toString(const char* prefix) const {
 }
 
 void CallStack::print(Printer& printer) const {
+    if (!mPcs.isEmpty()) {
+        unwindstack::AndroidLocalUnwinder unwinder;
+        unwindstack::ErrorData error;
+        if (!unwinder.Initialize(error)) {
+            ALOGW("%s: Failed to initialize the unwinder: %s", __FUNCTION__,
+                  unwindstack::GetErrorCodeString(error.code));
+        }
+        for (size_t i = 0; i < mPcs.size(); i++) {
+            unwindstack::FrameData frame = unwindstack::Unwinder::BuildFrameFromPcOnly(
+                    mPcs[i], unwinder.arch(), unwinder.GetMaps(), nullptr /* jit_debug */,
+                    unwinder.GetProcessMemory(), true /* resolve_names */);
+            frame.num = i;
+            printer.printLine(unwinder.FormatFrame(frame).c_str());
+        }
+        return;
+    }
     for (size_t i = 0; i < mFrameLines.size(); i++) {
         printer.printLine(mFrameLines[i].c_str());
     }
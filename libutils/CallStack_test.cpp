@@ -68,6 +68,32 @@ TEST(CallStackTest, thread_backtrace) {
     ASSERT_NE(-1, cs.toString().find("(ThreadBusyWait")) << "Full backtrace:\n" << cs.toString();
 }
 
+__attribute__((__noinline__)) extern "C" void DeferredCaller(android::CallStack* cs) {
+    cs->updatePcs();
+}
+
+TEST(CallStackTest, deferred_backtrace) {
+    android::CallStack cs;
+    DeferredCaller(&cs);
+    ASSERT_NE(0U, cs.size());
+
+    android::String8 backtrace = cs.toString();
+    ASSERT_NE(-1, backtrace.find("(DeferredCaller")) << "Full backtrace:\n" << backtrace;
+}
+
+TEST(CallStackTest, capture_pcs) {
+    uintptr_t pcs[2];
+    size_t count = android::CallStack::capturePcs(pcs, 2);
+    ASSERT_GT(count, 0U);
+    ASSERT_LE(count, 2U);
+
+    android::CallStack cs;
+    cs.setPcs(pcs, count);
+    EXPECT_EQ(count, cs.size());
+    cs.clear();
+    EXPECT_EQ(0U, cs.size());
+}
+
 #if defined(__ANDROID__)
 TEST(CallStackTest, log_stack) {
     android::CallStack::logStack("callstack_test");
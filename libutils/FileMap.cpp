@@ -42,6 +42,8 @@
 #include <errno.h>
 #include <assert.h>
 
+#include <vector>
+
 using namespace android;
 
 /*static*/ long FileMap::mPageSize = -1;
@@ -134,8 +136,15 @@ FileMap::~FileMap(void)
 // Returns "false" on failure.
 bool FileMap::create(const char* origFileName, int fd, off64_t offset, size_t length,
         bool readOnly)
+{
+    return create(origFileName, fd, offset, length, readOnly, 0);
+}
+
+bool FileMap::create(const char* origFileName, int fd, off64_t offset, size_t length,
+        bool readOnly, uint32_t createFlags)
 {
 #if defined(__MINGW32__)
+    (void)createFlags;
     int     adjust;
     off64_t adjOffset;
     size_t  adjLength;
@@ -199,6 +208,16 @@ bool FileMap::create(const char* origFileName, int fd, off64_t offset, size_t le
     int prot = PROT_READ;
     if (!readOnly) prot |= PROT_WRITE;
 
+    // Huge pages have to be requested before the pages are faulted in, so
+    // only let mmap() populate the map when they aren't wanted.
+    bool populate = (createFlags & CREATE_POPULATE) != 0;
+#if defined(MAP_POPULATE)
+    if (populate && (createFlags & CREATE_HUGEPAGE) == 0) {
+        flags |= MAP_POPULATE;
+        populate = false;
+    }
+#endif
+
     void* ptr = mmap64(nullptr, adjLength, prot, flags, fd, adjOffset);
     if (ptr == MAP_FAILED) {
         if (errno == EINVAL && length == 0) {
@@ -210,6 +229,23 @@ bool FileMap::create(const char* origFileName, int fd, off64_t offset, size_t le
         }
     }
     mBasePtr = ptr;
+
+    if (ptr != nullptr) {
+#if defined(MADV_HUGEPAGE)
+        if ((createFlags & CREATE_HUGEPAGE) != 0 && madvise(ptr, adjLength, MADV_HUGEPAGE) != 0) {
+            ALOGV("madvise(MADV_HUGEPAGE) failed: %s\n", strerror(errno));
+        }
+#endif
+        if (populate) {
+#if defined(MADV_POPULATE_READ)
+            if (madvise(ptr, adjLength, MADV_POPULATE_READ) != 0)
+#endif
+            {
+                // Older kernels can at least start reading the file in.
+                madvise(ptr, adjLength, MADV_WILLNEED);
+            }
+        }
+    }
 #endif // !defined(__MINGW32__)
 
     mFileName = origFileName != nullptr ? strdup(origFileName) : nullptr;
@@ -253,3 +289,30 @@ int FileMap::advise(MapAdvice /* advice */)
     return -1;
 }
 #endif
+
+#if defined(__linux__)
+ssize_t FileMap::getResidentPages(void) const
+{
+    if (mBasePtr == nullptr) {
+        return 0;
+    }
+
+    std::vector<unsigned char> residency((mBaseLength + mPageSize - 1) / mPageSize);
+    if (mincore(mBasePtr, mBaseLength, residency.data()) != 0) {
+        ALOGW("mincore(%p, %zu) failed: %s\n", mBasePtr, mBaseLength, strerror(errno));
+        return -1;
+    }
+
+    ssize_t resident = 0;
+    for (unsigned char page : residency) {
+        resident += page & 1;
+    }
+    return resident;
+}
+
+#else
+ssize_t FileMap::getResidentPages(void) const
+{
+    return -1;
+}
+#endif
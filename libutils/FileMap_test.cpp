@@ -16,6 +16,11 @@
 
 #include "utils/FileMap.h"
 
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
 #include <gtest/gtest.h>
 
 #include "android-base/file.h"
@@ -65,3 +70,22 @@ TEST(FileMap, offset_overflow) {
     android::FileMap m;
     ASSERT_FALSE(m.create("test", tf.fd, offset, length, true));
 }
+
+TEST(FileMap, populate_and_hugepage) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const std::string data(16 * pageSize, 'x');
+    ASSERT_TRUE(android::base::WriteFully(tf.fd, data.data(), data.size()));
+
+    android::FileMap m;
+    ASSERT_TRUE(m.create("test", tf.fd, 0, data.size(), true,
+                         android::FileMap::CREATE_POPULATE | android::FileMap::CREATE_HUGEPAGE));
+    ASSERT_EQ(data.size(), m.getDataLength());
+    ASSERT_EQ(0, memcmp(data.data(), m.getDataPtr(), data.size()));
+#if defined(__linux__)
+    // The file was just written, so all of it is in the page cache.
+    ASSERT_EQ(16, m.getResidentPages());
+#endif
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <utils/KeyedHashMap.h>
+#include <utils/KeyedVector.h>
+
+#include <vector>
+
+// Keys in a scattered order, so that KeyedVector inserts land throughout its storage.
+static std::vector<int> MakeKeys(size_t count) {
+    std::vector<int> keys(count);
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = static_cast<int>((i * 7919) % count);
+    }
+    return keys;
+}
+
+template <typename Map>
+static void BM_add(benchmark::State& state) {
+    std::vector<int> keys = MakeKeys(state.range(0));
+    for (auto _ : state) {
+        Map map;
+        for (int key : keys) {
+            map.add(key, key);
+        }
+        benchmark::DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_add, android::KeyedVector<int, int>)->Range(1 << 10, 1 << 17);
+BENCHMARK_TEMPLATE(BM_add, android::KeyedHashMap<int, int>)->Range(1 << 10, 1 << 17);
+
+template <typename Map>
+static void BM_indexOfKey(benchmark::State& state) {
+    std::vector<int> keys = MakeKeys(state.range(0));
+    Map map;
+    for (int key : keys) {
+        map.add(key, key);
+    }
+    for (auto _ : state) {
+        for (int key : keys) {
+            benchmark::DoNotOptimize(map.indexOfKey(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_indexOfKey, android::KeyedVector<int, int>)->Range(1 << 10, 1 << 17);
+BENCHMARK_TEMPLATE(BM_indexOfKey, android::KeyedHashMap<int, int>)->Range(1 << 10, 1 << 17);
+
+template <typename Map>
+static void BM_removeItem(benchmark::State& state) {
+    std::vector<int> keys = MakeKeys(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        Map map;
+        for (int key : keys) {
+            map.add(key, key);
+        }
+        state.ResumeTiming();
+        for (int key : keys) {
+            map.removeItem(key);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_removeItem, android::KeyedVector<int, int>)->Range(1 << 10, 1 << 17);
+BENCHMARK_TEMPLATE(BM_removeItem, android::KeyedHashMap<int, int>)->Range(1 << 10, 1 << 17);
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include <map>
+
+#include <gtest/gtest.h>
+#include <utils/KeyedHashMap.h>
+
+namespace {
+
+// All of these collide on the same hash.
+struct CollidingKey {
+    int k;
+
+    bool operator==(const CollidingKey& other) const { return k == other.k; }
+};
+
+}  // namespace
+
+namespace android {
+
+template <>
+inline hash_t hash_type(const CollidingKey&) {
+    return 42;
+}
+
+static void ExpectSameItems(const std::map<int, int>& expected, const KeyedHashMap<int, int>& map) {
+    ASSERT_EQ(expected.size(), map.size());
+    for (const auto& [key, value] : expected) {
+        ssize_t index = map.indexOfKey(key);
+        ASSERT_GE(index, 0) << "key " << key;
+        EXPECT_EQ(key, map.keyAt(index));
+        EXPECT_EQ(value, map.valueAt(index));
+        EXPECT_EQ(value, map.valueFor(key));
+    }
+}
+
+TEST(KeyedHashMapTest, AddFindReplace) {
+    KeyedHashMap<int, int> map;
+    EXPECT_TRUE(map.isEmpty());
+    EXPECT_EQ(NAME_NOT_FOUND, map.indexOfKey(1));
+
+    ssize_t index = map.add(1, 10);
+    ASSERT_GE(index, 0);
+    EXPECT_EQ(index, map.add(1, 11));
+    EXPECT_EQ(1U, map.size());
+    EXPECT_EQ(11, map.valueFor(1));
+
+    EXPECT_EQ(index, map.replaceValueFor(1, 12));
+    EXPECT_EQ(12, map.valueAt(index));
+    EXPECT_EQ(index, map.replaceValueAt(index, 13));
+    EXPECT_EQ(13, map[index]);
+    EXPECT_EQ(BAD_INDEX, map.replaceValueAt(1, 0));
+
+    map.editValueFor(1) = 14;
+    EXPECT_EQ(14, map.valueFor(1));
+    map.editValueAt(index) = 15;
+    EXPECT_EQ(15, map.valueFor(1));
+}
+
+TEST(KeyedHashMapTest, MatchesStdMap) {
+    KeyedHashMap<int, int> map;
+    std::map<int, int> expected;
+    srand(1);
+    for (int i = 0; i < 20000; i++) {
+        // Keys that are multiples of a power of two would collide without mixing the hash.
+        int key = (rand() % 2000) * 1024;
+        if (rand() % 3 == 0) {
+            ssize_t index = map.indexOfKey(key);
+            EXPECT_EQ(index >= 0 ? index : NAME_NOT_FOUND, map.removeItem(key));
+            EXPECT_EQ(index >= 0, expected.erase(key) == 1);
+        } else {
+            map.add(key, i);
+            expected[key] = i;
+        }
+    }
+    ExpectSameItems(expected, map);
+
+    KeyedHashMap<int, int> copy = map;
+    EXPECT_TRUE(copy.isIdenticalTo(map));
+    map.clear();
+    EXPECT_TRUE(map.isEmpty());
+    EXPECT_EQ(NAME_NOT_FOUND, map.indexOfKey(expected.begin()->first));
+    ExpectSameItems(expected, copy);
+}
+
+TEST(KeyedHashMapTest, RemoveItemsAt) {
+    KeyedHashMap<int, int> map;
+    std::map<int, int> expected;
+    for (int i = 0; i < 100; i++) {
+        map.add(i, -i);
+        expected[i] = -i;
+    }
+    EXPECT_EQ(BAD_VALUE, map.removeItemsAt(90, 11));
+
+    for (size_t i = 10; i < 20; i++) {
+        expected.erase(map.keyAt(i));
+    }
+    EXPECT_EQ(10, map.removeItemsAt(10, 10));
+    ExpectSameItems(expected, map);
+
+    // Remove the even keys while walking the items by index.
+    for (size_t i = 0; i < map.size();) {
+        if (map.keyAt(i) % 2 == 0) {
+            expected.erase(map.keyAt(i));
+            map.removeItemsAt(i);
+        } else {
+            i++;
+        }
+    }
+    ExpectSameItems(expected, map);
+}
+
+TEST(KeyedHashMapTest, CollidingKeys) {
+    KeyedHashMap<CollidingKey, int> map;
+    for (int i = 0; i < 50; i++) {
+        map.add(CollidingKey{i}, i);
+    }
+    for (int i = 0; i < 50; i += 2) {
+        EXPECT_GE(map.removeItem(CollidingKey{i}), 0);
+    }
+    ASSERT_EQ(25U, map.size());
+    for (int i = 0; i < 50; i++) {
+        ssize_t index = map.indexOfKey(CollidingKey{i});
+        if (i % 2) {
+            ASSERT_GE(index, 0);
+            EXPECT_EQ(i, map.valueAt(index));
+        } else {
+            EXPECT_EQ(NAME_NOT_FOUND, index);
+        }
+    }
+}
+
+TEST(KeyedHashMapTest, SetCapacity) {
+    KeyedHashMap<int, int> map;
+    ssize_t capacity = map.setCapacity(1000);
+    ASSERT_GE(capacity, 1000);
+    EXPECT_EQ(static_cast<size_t>(capacity), map.capacity());
+    for (int i = 0; i < 1000; i++) {
+        map.add(i, i);
+    }
+    EXPECT_EQ(static_cast<size_t>(capacity), map.capacity());
+
+    // The capacity is never reduced below the size.
+    EXPECT_EQ(capacity, map.setCapacity(10));
+}
+
+}  // namespace android
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/LatencyHistogram.h>
+
+namespace android {
+
+namespace {
+
+class LinePrinter : public Printer {
+  public:
+    void printLine(const char* string) override { lines.emplace_back(string); }
+
+    std::vector<std::string> lines;
+};
+
+}  // namespace
+
+TEST(LatencyHistogramTest, BucketBoundsCoverEveryLatency) {
+    nsecs_t lower = 0;
+    for (size_t i = 0; i < LatencyHistogram::kBucketCount; i++) {
+        nsecs_t upper = LatencyHistogram::bucketUpperBound(i);
+        ASSERT_GE(upper, lower);
+        EXPECT_EQ(i, LatencyHistogram::bucketIndex(lower));
+        EXPECT_EQ(i, LatencyHistogram::bucketIndex(upper));
+        // Each bucket is at most 25% wider than its lower bound.
+        EXPECT_LE(upper - lower + 1, std::max<nsecs_t>(1, lower / 4));
+        lower = upper + 1;
+    }
+    EXPECT_EQ(LatencyHistogram::kBucketCount - 1, LatencyHistogram::bucketIndex(lower));
+    EXPECT_EQ(LatencyHistogram::kBucketCount - 1, LatencyHistogram::bucketIndex(INT64_MAX));
+    EXPECT_EQ(0U, LatencyHistogram::bucketIndex(-1));
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+    LatencyHistogram histogram("percentiles");
+    EXPECT_EQ(0, histogram.snapshot().percentile(50));
+
+    for (nsecs_t i = 1; i <= 1000; i++) {
+        histogram.record(i * 1000);
+    }
+    LatencyHistogram::Snapshot s = histogram.snapshot();
+    EXPECT_EQ(1000U, s.count);
+    EXPECT_EQ(1000000, s.max);
+    EXPECT_EQ(500500, s.mean());
+
+    // Percentiles are rounded up to the end of their bucket.
+    EXPECT_GE(s.percentile(50), 500000);
+    EXPECT_LE(s.percentile(50), 500000 * 5 / 4);
+    EXPECT_GE(s.percentile(99), 990000);
+    EXPECT_LE(s.percentile(99), 1000000);
+    EXPECT_EQ(1000000, s.percentile(100));
+    EXPECT_EQ(LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(1000)),
+              s.percentile(0));
+
+    histogram.reset();
+    EXPECT_EQ(0U, histogram.snapshot().count);
+}
+
+TEST(LatencyHistogramTest, AggregatesThreads) {
+    LatencyHistogram histogram("threads");
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 16; i++) {
+        threads.emplace_back([&histogram, i] {
+            for (int j = 0; j < 1000; j++) {
+                histogram.record(i + 1);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    LatencyHistogram::Snapshot s = histogram.snapshot();
+    EXPECT_EQ(16000U, s.count);
+    EXPECT_EQ(16, s.max);
+    EXPECT_EQ(136000, s.sum);
+}
+
+TEST(LatencyHistogramTest, ForwardsSamples) {
+    std::vector<nsecs_t> samples;
+    LatencyHistogram histogram("forwards", [&samples](nsecs_t ns) { samples.push_back(ns); });
+    histogram.record(5);
+    histogram.record(7);
+    EXPECT_EQ((std::vector<nsecs_t>{5, 7}), samples);
+}
+
+static void scopedFunction() {
+    SCOPED_LATENCY("LatencyHistogramTest.scopedFunction");
+}
+
+TEST(LatencyHistogramTest, ScopedLatencyIsDumped) {
+    scopedFunction();
+    scopedFunction();
+
+    LinePrinter printer;
+    LatencyHistogram::dumpAll(printer);
+    bool found = false;
+    for (const auto& line : printer.lines) {
+        if (line.rfind("LatencyHistogramTest.scopedFunction: count=2 ", 0) == 0) found = true;
+    }
+    EXPECT_TRUE(found);
+}
+
+}  // namespace android
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LockProfiler"
+
+#include <utils/LockProfiler.h>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <utils/Printer.h>
+
+namespace android {
+
+namespace {
+
+enum SiteKind : uint64_t {
+    SITE_MUTEX = 0,
+    SITE_READ = 1,
+    SITE_WRITE = 2,
+    SITE_CONDITION = 3,
+};
+
+const char* const kSiteKindNames[] = {"mutex", "read", "write", "condition"};
+
+// Sites live in a fixed open-addressed table, so that recording never allocates or takes a
+// lock. The key is the return address shifted left by two, plus the SiteKind; zero is free.
+constexpr size_t kMaxSites = 1024;
+
+struct Site {
+    std::atomic<uint64_t> key;
+    std::atomic<uint64_t> waits;
+    std::atomic<uint64_t> waitNs;
+    std::atomic<uint64_t> maxWaitNs;
+    std::atomic<uint64_t> holdSamples;
+    std::atomic<uint64_t> holdNs;
+    std::atomic<uint64_t> maxHoldNs;
+};
+
+Site gSites[kMaxSites];
+std::atomic<uint64_t> gDroppedSites;
+std::atomic<bool> gEnabled = true;
+std::atomic<uint32_t> gSampleInterval = 16;
+
+// Locks of the calling thread whose hold time is being measured. Acquisitions sampled while
+// this is full are not measured.
+struct HeldLock {
+    const void* lock;
+    Site* site;
+    nsecs_t start;
+};
+
+constexpr size_t kMaxHeldLocks = 4;
+
+struct ThreadState {
+    uint32_t acquisitions;
+    size_t heldCount;
+    HeldLock held[kMaxHeldLocks];
+};
+
+thread_local ThreadState tState;
+
+nsecs_t now() {
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+void updateMax(std::atomic<uint64_t>& max, uint64_t value) {
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current &&
+           !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+Site* findSite(const void* pc, SiteKind kind) {
+    const uint64_t key = (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pc)) << 2) | kind;
+    size_t index = (key * 0x9e3779b97f4a7c15ull) >> 54;
+    for (size_t probes = 0; probes < kMaxSites; probes++, index = (index + 1) % kMaxSites) {
+        Site& site = gSites[index];
+        uint64_t current = site.key.load(std::memory_order_relaxed);
+        if (current == 0 &&
+            site.key.compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+            return &site;
+        }
+        if (current == key) {
+            return &site;
+        }
+    }
+    gDroppedSites.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void recordWait(Site* site, nsecs_t waitNs) {
+    if (site == nullptr) return;
+    site->waits.fetch_add(1, std::memory_order_relaxed);
+    site->waitNs.fetch_add(waitNs, std::memory_order_relaxed);
+    updateMax(site->maxWaitNs, waitNs);
+}
+
+void startHold(const void* lock, const void* pc, SiteKind kind, Site* site) {
+    uint32_t interval = gSampleInterval.load(std::memory_order_relaxed);
+    ThreadState& t = tState;
+    if (interval == 0 || ++t.acquisitions < interval) return;
+    t.acquisitions = 0;
+    if (t.heldCount == kMaxHeldLocks) return;
+    if (site == nullptr) site = findSite(pc, kind);
+    if (site == nullptr) return;
+    t.held[t.heldCount++] = {lock, site, now()};
+}
+
+void endHold(const void* lock) {
+    ThreadState& t = tState;
+    for (size_t i = t.heldCount; i-- > 0;) {
+        if (t.held[i].lock != lock) continue;
+        nsecs_t holdNs = now() - t.held[i].start;
+        Site* site = t.held[i].site;
+        site->holdSamples.fetch_add(1, std::memory_order_relaxed);
+        site->holdNs.fetch_add(holdNs, std::memory_order_relaxed);
+        updateMax(site->maxHoldNs, holdNs);
+        std::copy(t.held + i + 1, t.held + t.heldCount, t.held + i);
+        t.heldCount--;
+        return;
+    }
+}
+
+// Takes the lock with tryLock() first, so that only acquisitions that actually have to wait
+// pay for reading the clock.
+template <typename TryLock, typename Lock>
+status_t acquire(const void* lock, const void* pc, SiteKind kind, TryLock tryLock, Lock doLock) {
+    if (!gEnabled.load(std::memory_order_relaxed)) return -doLock();
+
+    Site* site = nullptr;
+    int err = tryLock();
+    if (err != 0) {
+        nsecs_t start = now();
+        err = doLock();
+        site = findSite(pc, kind);
+        recordWait(site, now() - start);
+    }
+    if (err == 0) startHold(lock, pc, kind, site);
+    return -err;
+}
+
+std::string describeSite(uintptr_t pc) {
+    char buf[64];
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(pc), &info) == 0 || info.dli_fname == nullptr) {
+        snprintf(buf, sizeof(buf), "0x%" PRIxPTR, pc);
+        return buf;
+    }
+    const char* slash = strrchr(info.dli_fname, '/');
+    std::string result = slash ? slash + 1 : info.dli_fname;
+    snprintf(buf, sizeof(buf), "+0x%" PRIxPTR, pc - reinterpret_cast<uintptr_t>(info.dli_fbase));
+    result += buf;
+    if (info.dli_sname != nullptr) {
+        int status;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        result += " (";
+        result += demangled ? demangled : info.dli_sname;
+        result += ")";
+        free(demangled);
+    }
+    return result;
+}
+
+}  // namespace
+
+void LockProfiler::setEnabled(bool enabled) {
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void LockProfiler::setSampleInterval(uint32_t interval) {
+    gSampleInterval.store(interval, std::memory_order_relaxed);
+}
+
+void LockProfiler::dump(Printer& printer) {
+    struct Row {
+        uint64_t key, waits, waitNs, maxWaitNs, holdSamples, holdNs, maxHoldNs;
+    };
+    std::vector<Row> rows;
+    for (const Site& site : gSites) {
+        Row row = {site.key.load(std::memory_order_relaxed),
+                   site.waits.load(std::memory_order_relaxed),
+                   site.waitNs.load(std::memory_order_relaxed),
+                   site.maxWaitNs.load(std::memory_order_relaxed),
+                   site.holdSamples.load(std::memory_order_relaxed),
+                   site.holdNs.load(std::memory_order_relaxed),
+                   site.maxHoldNs.load(std::memory_order_relaxed)};
+        if (row.key != 0 && (row.waits != 0 || row.holdSamples != 0)) rows.push_back(row);
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.waitNs != b.waitNs ? a.waitNs > b.waitNs : a.holdNs > b.holdNs;
+    });
+
+    printer.printFormatLine("Lock sites: %zu (%" PRIu64 " dropped), hold sample interval %" PRIu32,
+                            rows.size(), gDroppedSites.load(std::memory_order_relaxed),
+                            gSampleInterval.load(std::memory_order_relaxed));
+    for (const Row& row : rows) {
+        std::string where = describeSite(static_cast<uintptr_t>(row.key >> 2));
+        printer.printFormatLine(
+                "%s %s: waits=%" PRIu64 " wait=%.3fms max_wait=%.1fus hold_samples=%" PRIu64
+                " mean_hold=%.1fus max_hold=%.1fus",
+                kSiteKindNames[row.key & 3], where.c_str(), row.waits, row.waitNs / 1e6,
+                row.maxWaitNs / 1e3, row.holdSamples,
+                row.holdSamples ? row.holdNs / 1e3 / row.holdSamples : 0.0, row.maxHoldNs / 1e3);
+    }
+}
+
+// Sites stay registered, so that hold samples in progress keep pointing at the right one.
+void LockProfiler::reset() {
+    for (Site& site : gSites) {
+        site.waits.store(0, std::memory_order_relaxed);
+        site.waitNs.store(0, std::memory_order_relaxed);
+        site.maxWaitNs.store(0, std::memory_order_relaxed);
+        site.holdSamples.store(0, std::memory_order_relaxed);
+        site.holdNs.store(0, std::memory_order_relaxed);
+        site.maxHoldNs.store(0, std::memory_order_relaxed);
+    }
+    gDroppedSites.store(0, std::memory_order_relaxed);
+}
+
+status_t LockProfiler::lock(pthread_mutex_t* mutex) {
+    return acquire(
+            mutex, __builtin_return_address(0), SITE_MUTEX,
+            [mutex] { return pthread_mutex_trylock(mutex); },
+            [mutex] { return pthread_mutex_lock(mutex); });
+}
+
+void LockProfiler::unlock(pthread_mutex_t* mutex) {
+    if (tState.heldCount != 0) endHold(mutex);
+    pthread_mutex_unlock(mutex);
+}
+
+status_t LockProfiler::readLock(pthread_rwlock_t* rwlock) {
+    return acquire(
+            rwlock, __builtin_return_address(0), SITE_READ,
+            [rwlock] { return pthread_rwlock_tryrdlock(rwlock); },
+            [rwlock] { return pthread_rwlock_rdlock(rwlock); });
+}
+
+status_t LockProfiler::writeLock(pthread_rwlock_t* rwlock) {
+    return acquire(
+            rwlock, __builtin_return_address(0), SITE_WRITE,
+            [rwlock] { return pthread_rwlock_trywrlock(rwlock); },
+            [rwlock] { return pthread_rwlock_wrlock(rwlock); });
+}
+
+void LockProfiler::unlock(pthread_rwlock_t* rwlock) {
+    if (tState.heldCount != 0) endHold(rwlock);
+    pthread_rwlock_unlock(rwlock);
+}
+
+// The mutex is released for the duration of the wait, which ends its hold sample. Returns 0 if
+// profiling is disabled.
+nsecs_t LockProfiler::beginWait(pthread_mutex_t* mutex) {
+    if (tState.heldCount != 0) endHold(mutex);
+    return gEnabled.load(std::memory_order_relaxed) ? now() : 0;
+}
+
+// Waits on a condition are recorded as waits of the condition site; the hold time that follows
+// is sampled like any other acquisition.
+void LockProfiler::endWait(pthread_mutex_t* mutex, nsecs_t start) {
+    if (start == 0) return;
+    const void* pc = __builtin_return_address(0);
+    Site* site = findSite(pc, SITE_CONDITION);
+    recordWait(site, now() - start);
+    startHold(mutex, pc, SITE_CONDITION, site);
+}
+
+}  // namespace android
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/LockProfiler.h>
+#include <utils/Printer.h>
+
+namespace android {
+
+namespace {
+
+class LinePrinter : public Printer {
+  public:
+    void printLine(const char* string) override { lines.emplace_back(string); }
+
+    // The lines of the given kind, without the header line.
+    std::vector<std::string> sites(const std::string& kind) const {
+        std::vector<std::string> result;
+        for (const auto& line : lines) {
+            if (line.rfind(kind + " ", 0) == 0) result.push_back(line);
+        }
+        return result;
+    }
+
+    std::vector<std::string> lines;
+};
+
+class LockProfilerTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        LockProfiler::setEnabled(true);
+        LockProfiler::setSampleInterval(1);
+        LockProfiler::reset();
+    }
+
+    void TearDown() override {
+        LockProfiler::setSampleInterval(16);
+        LockProfiler::reset();
+    }
+};
+
+}  // namespace
+
+TEST_F(LockProfilerTest, RecordsContendedMutex) {
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    ASSERT_EQ(OK, LockProfiler::lock(&mutex));
+    std::thread waiter([&mutex] {
+        EXPECT_EQ(OK, LockProfiler::lock(&mutex));
+        LockProfiler::unlock(&mutex);
+    });
+    usleep(50000);
+    LockProfiler::unlock(&mutex);
+    waiter.join();
+
+    LinePrinter printer;
+    LockProfiler::dump(printer);
+    ASSERT_FALSE(printer.lines.empty());
+    std::vector<std::string> sites = printer.sites("mutex");
+    // The waiter's site comes first, as it has the most wait time.
+    ASSERT_EQ(2U, sites.size());
+    EXPECT_NE(std::string::npos, sites[0].find(" waits=1 ")) << sites[0];
+    EXPECT_NE(std::string::npos, sites[1].find(" waits=0 ")) << sites[1];
+    EXPECT_NE(std::string::npos, sites[1].find(" hold_samples=1 ")) << sites[1];
+}
+
+TEST_F(LockProfilerTest, RecordsReadAndWriteLocks) {
+    pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
+    ASSERT_EQ(OK, LockProfiler::readLock(&rwlock));
+    LockProfiler::unlock(&rwlock);
+    ASSERT_EQ(OK, LockProfiler::writeLock(&rwlock));
+    LockProfiler::unlock(&rwlock);
+
+    LinePrinter printer;
+    LockProfiler::dump(printer);
+    EXPECT_EQ(1U, printer.sites("read").size());
+    EXPECT_EQ(1U, printer.sites("write").size());
+}
+
+TEST_F(LockProfilerTest, RecordsConditionWaits) {
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    ASSERT_EQ(OK, LockProfiler::lock(&mutex));
+    nsecs_t start = LockProfiler::beginWait(&mutex);
+    EXPECT_NE(0, start);
+    LockProfiler::endWait(&mutex, start);
+    LockProfiler::unlock(&mutex);
+
+    LinePrinter printer;
+    LockProfiler::dump(printer);
+    std::vector<std::string> sites = printer.sites("condition");
+    ASSERT_EQ(1U, sites.size());
+    EXPECT_NE(std::string::npos, sites[0].find(" waits=1 ")) << sites[0];
+    EXPECT_NE(std::string::npos, sites[0].find(" hold_samples=1 ")) << sites[0];
+}
+
+TEST_F(LockProfilerTest, Disabled) {
+    LockProfiler::setEnabled(false);
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    ASSERT_EQ(OK, LockProfiler::lock(&mutex));
+    LockProfiler::unlock(&mutex);
+    EXPECT_EQ(0, LockProfiler::beginWait(&mutex));
+    LockProfiler::setEnabled(true);
+
+    LinePrinter printer;
+    LockProfiler::dump(printer);
+    EXPECT_TRUE(printer.sites("mutex").empty());
+}
+
+}  // namespace android
@@ -20,6 +20,7 @@
 #include <utils/Looper.h>
 
 #include <sys/eventfd.h>
+#include <algorithm>
 #include <cinttypes>
 
 namespace android {
@@ -32,6 +33,23 @@ epoll_event createEpollEvent(uint32_t events, uint64_t seq) {
     return {.events = events, .data = {.u64 = seq}};
 }
 
+// Removes the items matching |pred| in a single pass, keeping the others in order.
+template <typename T, typename Pred>
+void removeMessagesIf(Vector<T>& items, Pred pred) {
+    size_t count = items.size();
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (pred(items.itemAt(i))) continue;
+        if (kept != i) {
+            items.editItemAt(kept) = std::move(items.editItemAt(i));
+        }
+        kept++;
+    }
+    if (kept != count) {
+        items.removeItemsAt(kept, count - kept);
+    }
+}
+
 }  // namespace
 
 // --- WeakMessageHandler ---
@@ -239,7 +257,11 @@ int Looper::pollInner(int timeoutMillis) {
 
     // Poll.
     int result = POLL_WAKE;
-    mResponses.clear();
+    // Clearing a Vector reallocates its storage even when it is already empty, and most polls
+    // return no responses, so only clear it when there is something to drop.
+    if (!mResponses.isEmpty()) {
+        mResponses.clear();
+    }
     mResponseIndex = 0;
 
     // We are about to idle.
@@ -285,6 +307,11 @@ int Looper::pollInner(int timeoutMillis) {
     ALOGD("%p ~ pollOnce - handling events from %d fds", this, eventCount);
 #endif
 
+    // Make room for the whole batch up front rather than growing the vector once per event.
+    if (mResponses.capacity() < static_cast<size_t>(eventCount)) {
+        mResponses.setCapacity(eventCount);
+    }
+
     for (int i = 0; i < eventCount; i++) {
         const SequenceNumber seq = eventItems[i].data.u64;
         uint32_t epollEvents = eventItems[i].events;
@@ -626,9 +653,16 @@ void Looper::sendMessageAtTime(nsecs_t uptime, const sp<MessageHandler>& handler
     { // acquire lock
         AutoMutex _l(mLock);
 
+        // Insert after any message with the same uptime so that those are delivered in the order
+        // they were sent.  Most messages are sent in uptime order, so check the tail first.
         size_t messageCount = mMessageEnvelopes.size();
-        while (i < messageCount && uptime >= mMessageEnvelopes.itemAt(i).uptime) {
-            i += 1;
+        if (messageCount == 0 || uptime >= mMessageEnvelopes.itemAt(messageCount - 1).uptime) {
+            i = messageCount;
+        } else {
+            const MessageEnvelope* envelopes = mMessageEnvelopes.array();
+            i = std::upper_bound(envelopes, envelopes + messageCount, uptime,
+                                 [](nsecs_t u, const MessageEnvelope& e) { return u < e.uptime; }) -
+                envelopes;
         }
 
         MessageEnvelope messageEnvelope(uptime, handler, message);
@@ -657,12 +691,9 @@ void Looper::removeMessages(const sp<MessageHandler>& handler) {
     { // acquire lock
         AutoMutex _l(mLock);
 
-        for (size_t i = mMessageEnvelopes.size(); i != 0; ) {
-            const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(--i);
-            if (messageEnvelope.handler == handler) {
-                mMessageEnvelopes.removeAt(i);
-            }
-        }
+        removeMessagesIf(mMessageEnvelopes, [&](const MessageEnvelope& messageEnvelope) {
+            return messageEnvelope.handler == handler;
+        });
     } // release lock
 }
 
@@ -674,13 +705,9 @@ void Looper::removeMessages(const sp<MessageHandler>& handler, int what) {
     { // acquire lock
         AutoMutex _l(mLock);
 
-        for (size_t i = mMessageEnvelopes.size(); i != 0; ) {
-            const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(--i);
-            if (messageEnvelope.handler == handler
-                    && messageEnvelope.message.what == what) {
-                mMessageEnvelopes.removeAt(i);
-            }
-        }
+        removeMessagesIf(mMessageEnvelopes, [&](const MessageEnvelope& messageEnvelope) {
+            return messageEnvelope.handler == handler && messageEnvelope.message.what == what;
+        });
     } // release lock
 }
 
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <utils/Looper.h>
+
+#include <memory>
+#include <vector>
+
+#include "Looper_test_pipe.h"
+
+using android::Looper;
+using android::LooperCallback;
+using android::Message;
+using android::MessageHandler;
+using android::sp;
+
+namespace {
+
+class NoopCallback : public LooperCallback {
+  public:
+    int handleEvent(int /*fd*/, int /*events*/, void* /*data*/) override { return 1; }
+};
+
+class NoopHandler : public MessageHandler {
+  public:
+    void handleMessage(const Message& /*message*/) override {}
+};
+
+}  // namespace
+
+// Polls with nothing to do, which is the fixed cost of every wakeup.
+void BM_pollOnce_idle(benchmark::State& state) {
+    sp<Looper> looper = sp<Looper>::make(true);
+    for (auto _ : state) {
+        looper->pollOnce(0);
+    }
+}
+BENCHMARK(BM_pollOnce_idle);
+
+// Polls with state.range(0) readable fds, each of which has a callback.
+void BM_pollOnce_callbacks(benchmark::State& state) {
+    sp<Looper> looper = sp<Looper>::make(true);
+    sp<LooperCallback> callback = sp<NoopCallback>::make();
+    std::vector<std::unique_ptr<Pipe>> pipes;
+    for (int i = 0; i < state.range(0); i++) {
+        auto& pipe = pipes.emplace_back(std::make_unique<Pipe>());
+        // The fds are level triggered and never drained, so they stay ready.
+        pipe->writeSignal();
+        looper->addFd(pipe->receiveFd, Looper::POLL_CALLBACK, Looper::EVENT_INPUT, callback,
+                      nullptr);
+    }
+    for (auto _ : state) {
+        looper->pollOnce(0);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_pollOnce_callbacks)->Arg(1)->Arg(4)->Arg(16);
+
+// Polls with state.range(0) readable fds registered for identifiers, and collects all of them.
+void BM_pollOnce_identifiers(benchmark::State& state) {
+    sp<Looper> looper = sp<Looper>::make(true);
+    std::vector<std::unique_ptr<Pipe>> pipes;
+    for (int i = 0; i < state.range(0); i++) {
+        auto& pipe = pipes.emplace_back(std::make_unique<Pipe>());
+        pipe->writeSignal();
+        looper->addFd(pipe->receiveFd, i + 1, Looper::EVENT_INPUT, nullptr, nullptr);
+    }
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); i++) {
+            looper->pollOnce(0);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_pollOnce_identifiers)->Arg(1)->Arg(4)->Arg(16);
+
+// Posts state.range(0) messages that are due now, and dispatches them.
+void BM_sendMessage_dispatch(benchmark::State& state) {
+    sp<Looper> looper = sp<Looper>::make(true);
+    sp<MessageHandler> handler = sp<NoopHandler>::make();
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); i++) {
+            looper->sendMessage(handler, Message(i));
+        }
+        looper->pollOnce(0);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_sendMessage_dispatch)->Arg(1)->Arg(64)->Arg(1024);
+
+// Posts state.range(0) delayed messages in decreasing uptime order, then removes them.
+void BM_sendMessageAtTime_reversed(benchmark::State& state) {
+    sp<Looper> looper = sp<Looper>::make(true);
+    sp<MessageHandler> handler = sp<NoopHandler>::make();
+    nsecs_t future = systemTime(SYSTEM_TIME_MONOTONIC) + seconds_to_nanoseconds(3600);
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); i++) {
+            looper->sendMessageAtTime(future - i, handler, Message(i));
+        }
+        looper->removeMessages(handler);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_sendMessageAtTime_reversed)->Arg(64)->Arg(1024)->Arg(4096);
+
+BENCHMARK_MAIN();
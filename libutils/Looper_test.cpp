@@ -713,6 +713,36 @@ TEST_F(LooperTest, RemoveMessage_WhenRemovingSomeMessagesForHandler_ShouldRemove
             << "no more messages to handle";
 }
 
+TEST_F(LooperTest, SendMessageAtTime_WhenSentOutOfOrder_ShouldInvokeHandlersInUptimeOrder) {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    sp<StubMessageHandler> handler = new StubMessageHandler();
+    sp<StubMessageHandler> removedHandler = new StubMessageHandler();
+    mLooper->sendMessageAtTime(now - ms2ns(10), handler, Message(MSG_TEST1));
+    mLooper->sendMessageAtTime(now - ms2ns(30), handler, Message(MSG_TEST2));
+    mLooper->sendMessageAtTime(now - ms2ns(20), removedHandler, Message(MSG_TEST1));
+    mLooper->sendMessageAtTime(now - ms2ns(10), handler, Message(MSG_TEST3));
+    mLooper->sendMessageAtTime(now - ms2ns(30), handler, Message(MSG_TEST4));
+    mLooper->sendMessageAtTime(now - ms2ns(20), removedHandler, Message(MSG_TEST2));
+    mLooper->removeMessages(removedHandler);
+
+    int result = mLooper->pollOnce(0);
+
+    EXPECT_EQ(Looper::POLL_CALLBACK, result)
+            << "pollOnce result should be Looper::POLL_CALLBACK because messages were sent";
+    EXPECT_EQ(size_t(0), removedHandler->messages.size())
+            << "removed messages should not be handled";
+    ASSERT_EQ(size_t(4), handler->messages.size())
+            << "handled all messages that were not removed";
+    EXPECT_EQ(MSG_TEST2, handler->messages[0].what)
+            << "messages with the same uptime should be handled in the order they were sent";
+    EXPECT_EQ(MSG_TEST4, handler->messages[1].what)
+            << "messages with the same uptime should be handled in the order they were sent";
+    EXPECT_EQ(MSG_TEST1, handler->messages[2].what)
+            << "messages with the same uptime should be handled in the order they were sent";
+    EXPECT_EQ(MSG_TEST3, handler->messages[3].what)
+            << "messages with the same uptime should be handled in the order they were sent";
+}
+
 class LooperEventCallback : public LooperCallback {
   public:
     using Callback = std::function<int(int fd, int events)>;
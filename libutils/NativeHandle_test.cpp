@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include <gtest/gtest.h>
+#include <utils/NativeHandle.h>
+
+namespace android {
+
+namespace {
+
+native_handle_t* create_handle_with_fd(int* fd) {
+    native_handle_t* h = native_handle_create(1, 1);
+    *fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    h->data[0] = *fd;
+    h->data[1] = 42;
+    return h;
+}
+
+bool is_open(int fd) {
+    return fcntl(fd, F_GETFD) != -1;
+}
+
+}  // namespace
+
+TEST(UniqueNativeHandle, ClosesOwnedHandle) {
+    int fd;
+    {
+        UniqueNativeHandle handle(create_handle_with_fd(&fd), true);
+        ASSERT_TRUE(handle);
+        EXPECT_EQ(42, handle.handle()->data[1]);
+        EXPECT_TRUE(is_open(fd));
+    }
+    EXPECT_FALSE(is_open(fd));
+}
+
+TEST(UniqueNativeHandle, LeavesBorrowedHandle) {
+    int fd;
+    native_handle_t* h = create_handle_with_fd(&fd);
+    { UniqueNativeHandle handle(h, false); }
+    EXPECT_TRUE(is_open(fd));
+    native_handle_close(h);
+    native_handle_delete(h);
+}
+
+TEST(UniqueNativeHandle, Move) {
+    int fd;
+    UniqueNativeHandle a(create_handle_with_fd(&fd), true);
+    UniqueNativeHandle b(std::move(a));
+    EXPECT_FALSE(a);
+    ASSERT_TRUE(b);
+
+    UniqueNativeHandle c;
+    c = std::move(b);
+    EXPECT_FALSE(b);
+    EXPECT_TRUE(is_open(fd));
+
+    c.reset();
+    EXPECT_FALSE(c);
+    EXPECT_FALSE(is_open(fd));
+}
+
+TEST(UniqueNativeHandle, Release) {
+    int fd;
+    UniqueNativeHandle handle(create_handle_with_fd(&fd), true);
+    native_handle_t* h = handle.release();
+    EXPECT_FALSE(handle);
+    handle.reset();
+    EXPECT_TRUE(is_open(fd));
+    native_handle_close(h);
+    native_handle_delete(h);
+}
+
+TEST(UniqueNativeHandle, Share) {
+    int fd;
+    UniqueNativeHandle handle(create_handle_with_fd(&fd), true);
+    sp<NativeHandle> shared = handle.share();
+    EXPECT_FALSE(handle);
+    ASSERT_NE(nullptr, shared);
+    EXPECT_TRUE(is_open(fd));
+    shared.clear();
+    EXPECT_FALSE(is_open(fd));
+
+    EXPECT_EQ(nullptr, UniqueNativeHandle().share());
+}
+
+}  // namespace android
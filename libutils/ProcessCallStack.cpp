@@ -22,7 +22,12 @@
 #include <dirent.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <utils/Printer.h>
 
@@ -35,6 +40,9 @@ enum {
 
     // Dump related prettiness constants
     IGNORE_DEPTH_CURRENT_THREAD = 2,
+
+    // Other threads are unwound in parallel by up to this many helper threads
+    MAX_UNWIND_THREADS = 4,
 };
 
 static const char* CALL_STACK_PREFIX = "  ";
@@ -169,23 +177,54 @@ void ProcessCallStack::update() {
                   __FUNCTION__, strerror(-idx));
             continue;
         }
+    }
 
-        ThreadInfo& threadInfo = mThreadMap.editValueAt(static_cast<size_t>(idx));
+    /*
+     * Unwinding a thread mostly waits for it to handle a signal and for its stack to be read,
+     * so unwind the other threads in parallel. The map is not modified while they run, so the
+     * ThreadInfo pointers stay valid.
+     */
+    std::vector<std::pair<pid_t, ThreadInfo*>> others;
+    for (size_t i = 0; i < mThreadMap.size(); ++i) {
+        pid_t tid = mThreadMap.keyAt(i);
+        ThreadInfo& threadInfo = mThreadMap.editValueAt(i);
+
+        if (tid == selfPid) {
+            /*
+             * Ignore CallStack::update and ProcessCallStack::update for current thread
+             * - Every other thread doesn't need this since we call update off-thread
+             */
+            threadInfo.callStack.update(IGNORE_DEPTH_CURRENT_THREAD, tid);
+            threadInfo.threadName = getThreadName(tid);
+        } else {
+            others.emplace_back(tid, &threadInfo);
+        }
+    }
 
-        /*
-         * Ignore CallStack::update and ProcessCallStack::update for current thread
-         * - Every other thread doesn't need this since we call update off-thread
-         */
-        int ignoreDepth = (selfPid == tid) ? IGNORE_DEPTH_CURRENT_THREAD : 0;
+    std::atomic<size_t> next = 0;
+    auto unwindOthers = [&others, &next]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < others.size();) {
+            auto [tid, threadInfo] = others[i];
 
-        // Update thread's call stacks
-        threadInfo.callStack.update(ignoreDepth, tid);
+            // Update thread's call stacks
+            threadInfo->callStack.update(0, tid);
 
-        // Read/save thread name
-        threadInfo.threadName = getThreadName(tid);
+            // Read/save thread name
+            threadInfo->threadName = getThreadName(tid);
 
-        ALOGV("%s: Got call stack for tid %d (size %zu)",
-              __FUNCTION__, tid, threadInfo.callStack.size());
+            ALOGV("update: Got call stack for tid %d (size %zu)",
+                  tid, threadInfo->callStack.size());
+        }
+    };
+
+    std::vector<std::thread> helpers;
+    size_t helperCount = std::min<size_t>(MAX_UNWIND_THREADS, others.size());
+    for (size_t i = 1; i < helperCount; ++i) {
+        helpers.emplace_back(unwindOthers);
+    }
+    unwindOthers();
+    for (std::thread& helper : helpers) {
+        helper.join();
     }
 }
 
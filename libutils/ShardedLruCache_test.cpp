@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/ShardedLruCache.h>
+
+namespace android {
+
+namespace {
+
+class CountingListener : public OnEntryRemoved<int, std::string> {
+  public:
+    void setCache(ShardedLruCache<int, std::string>* cache) { mCache = cache; }
+
+    void operator()(int& key, std::string& value) override {
+        removedKeys.push_back(key);
+        lastValue = value;
+        if (mCache != nullptr) {
+            // The shard lock has been released, so calling back into the cache must not deadlock.
+            std::string unused;
+            EXPECT_FALSE(mCache->get(key, &unused));
+        }
+    }
+
+    std::vector<int> removedKeys;
+    std::string lastValue;
+
+  private:
+    ShardedLruCache<int, std::string>* mCache = nullptr;
+};
+
+}  // namespace
+
+TEST(ShardedLruCacheTest, PutGetRemove) {
+    ShardedLruCache<int, std::string> cache(100, 4);
+    std::string value;
+    EXPECT_FALSE(cache.get(1, &value));
+
+    EXPECT_TRUE(cache.put(1, "one"));
+    EXPECT_FALSE(cache.put(1, "uno"));
+    ASSERT_TRUE(cache.get(1, &value));
+    EXPECT_EQ("one", value);
+    EXPECT_EQ(1U, cache.size());
+
+    EXPECT_TRUE(cache.remove(1));
+    EXPECT_FALSE(cache.remove(1));
+    EXPECT_FALSE(cache.get(1, &value));
+    EXPECT_EQ(0U, cache.size());
+}
+
+TEST(ShardedLruCacheTest, EvictsLeastRecentlyUsed) {
+    // With a single shard the eviction order is exactly LRU.
+    CountingListener listener;
+    ShardedLruCache<int, std::string> cache(3, 1);
+    cache.setOnEntryRemovedListener(&listener);
+
+    cache.put(1, "one");
+    cache.put(2, "two");
+    cache.put(3, "three");
+    std::string value;
+    ASSERT_TRUE(cache.get(1, &value));
+
+    cache.put(4, "four");
+    ASSERT_EQ(1U, listener.removedKeys.size());
+    EXPECT_EQ(2, listener.removedKeys[0]);
+    EXPECT_EQ("two", listener.lastValue);
+    EXPECT_TRUE(cache.get(1, &value));
+    EXPECT_FALSE(cache.get(2, &value));
+    EXPECT_EQ(3U, cache.size());
+}
+
+TEST(ShardedLruCacheTest, EvictsByWeight) {
+    CountingListener listener;
+    ShardedLruCache<int, std::string> cache(10, 1);
+    cache.setOnEntryRemovedListener(&listener);
+
+    EXPECT_FALSE(cache.put(1, "too heavy", 11));
+    EXPECT_TRUE(cache.put(1, "one", 4));
+    EXPECT_TRUE(cache.put(2, "two", 4));
+    EXPECT_EQ(8U, cache.weight());
+
+    EXPECT_TRUE(cache.put(3, "three", 7));
+    EXPECT_EQ((std::vector<int>{1, 2}), listener.removedKeys);
+    EXPECT_EQ(1U, cache.size());
+    EXPECT_EQ(7U, cache.weight());
+}
+
+TEST(ShardedLruCacheTest, ListenerMayReenterCache) {
+    CountingListener listener;
+    ShardedLruCache<int, std::string> cache(1, 1);
+    listener.setCache(&cache);
+    cache.setOnEntryRemovedListener(&listener);
+
+    cache.put(1, "one");
+    cache.put(2, "two");
+    EXPECT_EQ(std::vector<int>{1}, listener.removedKeys);
+    cache.remove(2);
+    EXPECT_EQ((std::vector<int>{1, 2}), listener.removedKeys);
+}
+
+TEST(ShardedLruCacheTest, ClearNotifiesAndRecyclesNodes) {
+    CountingListener listener;
+    ShardedLruCache<int, std::string> cache(1000);
+    cache.setOnEntryRemovedListener(&listener);
+
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 500; i++) {
+            ASSERT_TRUE(cache.put(i, std::to_string(i)));
+        }
+        EXPECT_EQ(500U, cache.size());
+        cache.clear();
+        EXPECT_EQ(0U, cache.size());
+        EXPECT_EQ(0U, cache.weight());
+    }
+    EXPECT_EQ(1500U, listener.removedKeys.size());
+}
+
+TEST(ShardedLruCacheTest, ConcurrentAccess) {
+    constexpr int kThreads = 4;
+    constexpr int kKeys = 2048;
+    ShardedLruCache<int, std::string> cache(kKeys / 2);
+    std::atomic<int> mismatches = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&cache, &mismatches, t] {
+            std::string value;
+            for (int i = 0; i < 20000; i++) {
+                int key = (i * 7 + t * 13) % kKeys;
+                if (cache.get(key, &value)) {
+                    if (value != std::to_string(key)) mismatches++;
+                } else if (i % 5 == t) {
+                    cache.remove(key);
+                } else {
+                    cache.put(key, std::to_string(key));
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(0, mismatches);
+    EXPECT_LE(cache.weight(), static_cast<size_t>(kKeys / 2));
+}
+
+}  // namespace android
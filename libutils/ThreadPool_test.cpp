@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/ThreadPool.h>
+
+namespace android {
+
+TEST(ThreadPoolTest, RunsTasksAndReturnsResults) {
+    ThreadPool::Options options;
+    options.threadCount = 4;
+    ThreadPool pool(options);
+    EXPECT_EQ(4U, pool.threadCount());
+
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 100; i++) {
+        results.push_back(pool.submit([i] { return i * i; }));
+    }
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(i * i, results[i].get());
+    }
+
+    // Move-only tasks and results work too.
+    auto owned = std::make_unique<std::string>("owned");
+    std::future<std::unique_ptr<std::string>> moved =
+            pool.submit([owned = std::move(owned)]() mutable { return std::move(owned); });
+    EXPECT_EQ("owned", *moved.get());
+}
+
+TEST(ThreadPoolTest, TasksCanSubmitTasks) {
+    ThreadPool::Options options;
+    options.threadCount = 3;
+    ThreadPool pool(options);
+    std::atomic<int> leaves = 0;
+
+    // A tree of tasks, each spawning more from inside the pool, which other workers steal.
+    std::function<void(int)> spawn = [&](int depth) {
+        if (depth == 0) {
+            leaves++;
+            return;
+        }
+        for (int i = 0; i < 4; i++) {
+            pool.submit([&spawn, depth] { spawn(depth - 1); });
+        }
+    };
+    pool.submit([&spawn] { spawn(5); });
+    pool.waitForIdle();
+    EXPECT_EQ(4 * 4 * 4 * 4 * 4, leaves);
+}
+
+TEST(ThreadPoolTest, Cancellation) {
+    ThreadPool::Options options;
+    options.threadCount = 1;
+    ThreadPool pool(options);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    pool.submit([released] { released.wait(); });
+
+    CancellationToken token;
+    std::atomic<int> ran = 0;
+    std::future<bool> dropped = pool.submit(token, [&ran] { ran++; });
+    std::future<std::optional<int>> droppedValue = pool.submit(token, [] { return 1; });
+    std::future<bool> kept = pool.submit(CancellationToken(), [&ran] { ran++; });
+
+    // The only worker is blocked, so none of these have started.
+    token.cancel();
+    EXPECT_TRUE(token.isCancelled());
+    release.set_value();
+
+    EXPECT_FALSE(dropped.get());
+    EXPECT_EQ(std::nullopt, droppedValue.get());
+    EXPECT_TRUE(kept.get());
+    EXPECT_EQ(1, ran);
+}
+
+TEST(ThreadPoolTest, DestructorRunsQueuedTasks) {
+    std::atomic<int> ran = 0;
+    std::vector<size_t> started;
+    std::mutex startedLock;
+    {
+        ThreadPool::Options options;
+        options.threadCount = 2;
+        options.name = "test";
+        options.onWorkerStart = [&](size_t index) {
+            std::lock_guard<std::mutex> guard(startedLock);
+            started.push_back(index);
+        };
+        ThreadPool pool(options);
+        for (int i = 0; i < 1000; i++) {
+            pool.submit([&ran] { ran++; });
+        }
+    }
+    EXPECT_EQ(1000, ran);
+    EXPECT_EQ(2U, started.size());
+}
+
+}  // namespace android
@@ -28,10 +28,6 @@
 
 namespace android {
 
-static inline bool isDelimiter(char ch, const char* delimiters) {
-    return strchr(delimiters, ch) != nullptr;
-}
-
 Tokenizer::Tokenizer(const String8& filename, FileMap* fileMap, char* buffer,
         bool ownBuffer, size_t length) :
         mFilename(filename), mFileMap(fileMap),
@@ -111,31 +107,15 @@ String8 Tokenizer::getLocation() const {
 }
 
 String8 Tokenizer::peekRemainderOfLine() const {
-    const char* end = getEnd();
-    const char* eol = mCurrent;
-    while (eol != end) {
-        char ch = *eol;
-        if (ch == '\n') {
-            break;
-        }
-        eol += 1;
-    }
-    return String8(mCurrent, eol - mCurrent);
+    return String8(mCurrent, findEol(mCurrent) - mCurrent);
 }
 
 String8 Tokenizer::nextToken(const char* delimiters) {
 #if DEBUG_TOKENIZER
     ALOGD("nextToken");
 #endif
-    const char* end = getEnd();
     const char* tokenStart = mCurrent;
-    while (mCurrent != end) {
-        char ch = *mCurrent;
-        if (ch == '\n' || isDelimiter(ch, delimiters)) {
-            break;
-        }
-        mCurrent += 1;
-    }
+    mCurrent = DelimiterSet(delimiters).find(mCurrent, getEnd());
     return String8(tokenStart, mCurrent - tokenStart);
 }
 
@@ -143,13 +123,12 @@ void Tokenizer::nextLine() {
 #if DEBUG_TOKENIZER
     ALOGD("nextLine");
 #endif
-    const char* end = getEnd();
-    while (mCurrent != end) {
-        char ch = *(mCurrent++);
-        if (ch == '\n') {
-            mLineNumber += 1;
-            break;
-        }
+    const char* eol = findEol(mCurrent);
+    if (eol != getEnd()) {
+        mCurrent = eol + 1;
+        mLineNumber += 1;
+    } else {
+        mCurrent = eol;
     }
 }
 
@@ -157,14 +136,7 @@ void Tokenizer::skipDelimiters(const char* delimiters) {
 #if DEBUG_TOKENIZER
     ALOGD("skipDelimiters");
 #endif
-    const char* end = getEnd();
-    while (mCurrent != end) {
-        char ch = *mCurrent;
-        if (ch == '\n' || !isDelimiter(ch, delimiters)) {
-            break;
-        }
-        mCurrent += 1;
-    }
+    mCurrent = DelimiterSet(delimiters).skip(mCurrent, getEnd());
 }
 
 } // namespace android
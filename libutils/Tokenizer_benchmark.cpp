@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <dirent.h>
+#include <utils/Tokenizer.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using android::OK;
+using android::String8;
+using android::Tokenizer;
+
+namespace {
+
+constexpr char kWhitespace[] = " \t\r";
+
+// The directories the input stack loads key layouts, key character maps and input device
+// configurations from.
+const char* const kKeymapDirs[] = {"/system/usr/keylayout", "/system/usr/keychars",
+                                   "/system/usr/idc"};
+
+std::vector<std::string> KeymapFiles() {
+    std::vector<std::string> files;
+    for (const char* dir : kKeymapDirs) {
+        DIR* d = opendir(dir);
+        if (!d) continue;
+        while (dirent* entry = readdir(d)) {
+            if (entry->d_name[0] == '.') continue;
+            files.push_back(std::string(dir) + "/" + entry->d_name);
+        }
+        closedir(d);
+    }
+    return files;
+}
+
+// Files are read the way the parsers in libinput read them: one line at a time, skipping
+// comments, and splitting the rest on whitespace.
+template <bool kViews>
+size_t TokenizeAll(Tokenizer* tokenizer) {
+    size_t tokens = 0;
+    while (!tokenizer->isEof()) {
+        tokenizer->skipDelimiters(kWhitespace);
+        if (!tokenizer->isEol() && tokenizer->peekChar() != '#') {
+            while (!tokenizer->isEol()) {
+                if constexpr (kViews) {
+                    std::string_view token = tokenizer->nextTokenView(kWhitespace);
+                    benchmark::DoNotOptimize(token.data());
+                } else {
+                    String8 token = tokenizer->nextToken(kWhitespace);
+                    benchmark::DoNotOptimize(token.c_str());
+                }
+                tokens++;
+                tokenizer->skipDelimiters(kWhitespace);
+            }
+        }
+        tokenizer->nextLine();
+    }
+    return tokens;
+}
+
+// Opens and tokenizes every keymap file on the device, as at boot or input device hotplug.
+template <bool kViews>
+void BM_openAndTokenize(benchmark::State& state) {
+    const std::vector<std::string> files = KeymapFiles();
+    if (files.empty()) {
+        state.SkipWithError("No keymap files found");
+        return;
+    }
+    size_t tokens = 0;
+    for (auto _ : state) {
+        for (const std::string& file : files) {
+            Tokenizer* tokenizer;
+            if (Tokenizer::open(String8(file.c_str()), &tokenizer) != OK) {
+                state.SkipWithError("Tokenizer::open failed");
+                return;
+            }
+            tokens += TokenizeAll<kViews>(tokenizer);
+            delete tokenizer;
+        }
+    }
+    state.SetItemsProcessed(tokens);
+}
+BENCHMARK_TEMPLATE(BM_openAndTokenize, false);
+BENCHMARK_TEMPLATE(BM_openAndTokenize, true);
+
+// Tokenizes the contents of every keymap file, without the cost of opening them. Falls back to
+// generated key layout lines when there are no keymap files, as on the host.
+template <bool kViews>
+void BM_tokenize(benchmark::State& state) {
+    std::vector<std::string> contents;
+    for (const std::string& file : KeymapFiles()) {
+        std::ifstream in(file);
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        contents.push_back(buffer.str());
+    }
+    if (contents.empty()) {
+        std::string kl = "# Generated key layout\n";
+        for (int i = 1; i < 512; i++) {
+            kl += "key " + std::to_string(i) + "   KEYCODE_" + std::to_string(i) + "\n";
+        }
+        contents.push_back(kl);
+    }
+
+    size_t bytes = 0;
+    for (auto _ : state) {
+        for (const std::string& c : contents) {
+            Tokenizer* tokenizer;
+            Tokenizer::fromContents(String8("benchmark"), c.c_str(), &tokenizer);
+            TokenizeAll<kViews>(tokenizer);
+            delete tokenizer;
+            bytes += c.size();
+        }
+    }
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK_TEMPLATE(BM_tokenize, false);
+BENCHMARK_TEMPLATE(BM_tokenize, true);
+
+}  // namespace
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/Tokenizer.h>
+
+#include <memory>
+#include <string>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+using android::OK;
+using android::String8;
+using android::Tokenizer;
+
+static constexpr char kWhitespace[] = " \t\r";
+
+static std::unique_ptr<Tokenizer> FromContents(const char* contents) {
+    Tokenizer* tokenizer;
+    EXPECT_EQ(OK, Tokenizer::fromContents(String8("test"), contents, &tokenizer));
+    return std::unique_ptr<Tokenizer>(tokenizer);
+}
+
+TEST(Tokenizer, tokens_and_lines) {
+    auto tokenizer = FromContents("key 1   ESCAPE\n# comment\n\n  axis 0x00 X\n");
+
+    EXPECT_EQ("key", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->skipDelimiters(kWhitespace);
+    EXPECT_EQ("1", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->skipDelimiters(kWhitespace);
+    EXPECT_EQ("ESCAPE", tokenizer->nextTokenView(kWhitespace));
+    EXPECT_TRUE(tokenizer->isEol());
+    EXPECT_EQ("", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->nextLine();
+
+    EXPECT_EQ(2, tokenizer->getLineNumber());
+    EXPECT_EQ('#', tokenizer->peekChar());
+    EXPECT_EQ("# comment", tokenizer->peekRemainderOfLineView());
+    tokenizer->nextLine();
+    EXPECT_TRUE(tokenizer->isEol());
+    tokenizer->nextLine();
+
+    tokenizer->skipDelimiters(kWhitespace);
+    EXPECT_EQ(String8("axis"), tokenizer->nextToken(kWhitespace));
+    EXPECT_EQ(String8(" 0x00 X"), tokenizer->peekRemainderOfLine());
+    tokenizer->nextLine();
+    EXPECT_EQ(5, tokenizer->getLineNumber());
+    EXPECT_TRUE(tokenizer->isEof());
+    tokenizer->nextLine();
+    EXPECT_EQ(5, tokenizer->getLineNumber());
+}
+
+TEST(Tokenizer, last_line_without_newline) {
+    auto tokenizer = FromContents("a=b");
+
+    EXPECT_EQ("a", tokenizer->nextTokenView("="));
+    tokenizer->skipDelimiters("=");
+    EXPECT_EQ("b", tokenizer->peekRemainderOfLineView());
+    EXPECT_EQ("b", tokenizer->nextTokenView("="));
+    EXPECT_TRUE(tokenizer->isEof());
+    tokenizer->nextLine();
+    EXPECT_EQ(1, tokenizer->getLineNumber());
+}
+
+TEST(Tokenizer, newline_is_not_skipped_as_a_delimiter) {
+    auto tokenizer = FromContents("a \n b");
+
+    tokenizer->nextToken(kWhitespace);
+    tokenizer->skipDelimiters(" \n");
+    EXPECT_EQ('\n', tokenizer->peekChar());
+    EXPECT_EQ("", tokenizer->nextTokenView("\n"));
+}
+
+TEST(Tokenizer, embedded_nulls) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    const std::string contents("ab\0cd \0\0ef\n", 11);
+    ASSERT_TRUE(android::base::WriteStringToFd(contents, tf.fd));
+
+    Tokenizer* raw;
+    ASSERT_EQ(OK, Tokenizer::open(String8(tf.path), &raw));
+    std::unique_ptr<Tokenizer> tokenizer(raw);
+
+    EXPECT_EQ("ab", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->skipDelimiters(kWhitespace);
+    EXPECT_EQ("cd", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->skipDelimiters(kWhitespace);
+    EXPECT_EQ("ef", tokenizer->nextTokenView(kWhitespace));
+    EXPECT_TRUE(tokenizer->isEol());
+}
+
+TEST(Tokenizer, high_characters) {
+    auto tokenizer = FromContents("\xc3\xa9t\xc3\xa9\xff" "a");
+
+    EXPECT_EQ("\xc3\xa9t\xc3\xa9", tokenizer->nextTokenView("\xff"));
+    tokenizer->skipDelimiters("\xff");
+    EXPECT_EQ("a", tokenizer->nextTokenView("\xff"));
+}
@@ -55,6 +55,13 @@
 // log all reference counting operations
 #define PRINT_REFS 0
 
+// Count reference counting operations per class, and log the busiest classes at exit or from
+// printRefs(). This is much cheaper than DEBUG_REFS, and is meant for finding hot sp<> churn,
+// but every operation still updates a shared counter.
+#ifndef DEBUG_REFS_STATS
+#define DEBUG_REFS_STATS 0
+#endif
+
 #if !defined(ANDROID_UTILS_CALLSTACK_ENABLED)
 #if defined(__linux__)
 // CallStack is only supported on linux type platforms.
@@ -68,6 +75,17 @@
 #include "../../include/utils/CallStack.h"
 #endif
 
+#if DEBUG_REFS_STATS
+#include <inttypes.h>
+
+#include <algorithm>
+#include <vector>
+#if defined(__linux__)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#endif
+#endif
+
 // ---------------------------------------------------------------------------
 
 namespace android {
@@ -181,6 +199,100 @@ static void check_not_on_stack(const void* ptr) {
 
 // ---------------------------------------------------------------------------
 
+enum RefOp {
+    REF_OP_INC_STRONG,
+    REF_OP_DEC_STRONG,
+    REF_OP_ATTEMPT_INC_STRONG,
+    REF_OP_INC_WEAK,
+    REF_OP_DEC_WEAK,
+    REF_OP_COUNT,
+};
+
+#if DEBUG_REFS_STATS
+
+// Classes are told apart by the vtable pointer of the RefBase subobject, which works without
+// RTTI. An object that takes references to itself from its constructor or destructor is counted
+// against the class being constructed or destroyed at that point.
+struct RefStats {
+    std::atomic<const void*> type;
+    std::atomic<uint64_t> ops[REF_OP_COUNT];
+};
+
+static constexpr size_t kMaxRefStatsTypes = 4096;  // must be a power of two
+static RefStats gRefStats[kMaxRefStatsTypes];
+static std::atomic<uint64_t> gRefStatsDropped;
+
+static const void* refStatsType(const RefBase* base) {
+    return *reinterpret_cast<const void* const*>(base);
+}
+
+static void logRefStats() {
+    std::vector<std::pair<uint64_t, const RefStats*>> busiest;
+    for (const RefStats& stats : gRefStats) {
+        if (stats.type.load(std::memory_order_relaxed) == nullptr) continue;
+        uint64_t total = 0;
+        for (const auto& op : stats.ops) {
+            total += op.load(std::memory_order_relaxed);
+        }
+        busiest.emplace_back(total, &stats);
+    }
+    std::sort(busiest.begin(), busiest.end(), [](const auto& a, const auto& b) {
+        return a.first > b.first;
+    });
+
+    ALOGI("Reference counting operations by class (weak counts include those taken by strong "
+          "references):");
+    for (size_t i = 0; i < busiest.size() && i < 50; i++) {
+        const RefStats& stats = *busiest[i].second;
+        const void* type = stats.type.load(std::memory_order_relaxed);
+        String8 name = String8::format("%p", type);
+#if defined(__linux__)
+        Dl_info info;
+        if (dladdr(type, &info) != 0 && info.dli_sname != nullptr) {
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, nullptr);
+            name = demangled != nullptr ? demangled : info.dli_sname;
+            free(demangled);
+        }
+#endif
+        ALOGI("%10" PRIu64 " incStrong %" PRIu64 " decStrong %" PRIu64
+              " attemptIncStrong %" PRIu64 " incWeak %" PRIu64 " decWeak %" PRIu64 ": %s",
+              busiest[i].first, stats.ops[REF_OP_INC_STRONG].load(std::memory_order_relaxed),
+              stats.ops[REF_OP_DEC_STRONG].load(std::memory_order_relaxed),
+              stats.ops[REF_OP_ATTEMPT_INC_STRONG].load(std::memory_order_relaxed),
+              stats.ops[REF_OP_INC_WEAK].load(std::memory_order_relaxed),
+              stats.ops[REF_OP_DEC_WEAK].load(std::memory_order_relaxed), name.c_str());
+    }
+    uint64_t dropped = gRefStatsDropped.load(std::memory_order_relaxed);
+    if (dropped != 0) {
+        ALOGI("%" PRIu64 " operations on classes that did not fit in the table", dropped);
+    }
+}
+
+static void countRefOp(const void* type, RefOp op) {
+    static std::once_flag registered;
+    std::call_once(registered, [] { atexit(logRefStats); });
+
+    size_t i = (reinterpret_cast<uintptr_t>(type) >> 3) & (kMaxRefStatsTypes - 1);
+    for (size_t probe = 0; probe < kMaxRefStatsTypes; probe++) {
+        RefStats& stats = gRefStats[i];
+        const void* current = stats.type.load(std::memory_order_relaxed);
+        if (current == nullptr &&
+            stats.type.compare_exchange_strong(current, type, std::memory_order_relaxed)) {
+            current = type;
+        }
+        if (current == type) {
+            stats.ops[op].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        i = (i + 1) & (kMaxRefStatsTypes - 1);
+    }
+    gRefStatsDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+#endif  // DEBUG_REFS_STATS
+
+// ---------------------------------------------------------------------------
+
 class RefBase::weakref_impl : public RefBase::weakref_type
 {
 public:
@@ -443,6 +555,25 @@ private:
     bool mRetain;
 
 #endif
+
+public:
+#if DEBUG_REFS_STATS
+    // Strong operations are only made on live objects, so they can read the type from mBase and
+    // remember it for weak operations, which may come after the object is gone. Until then weak
+    // operations are counted against RefBase itself.
+    void countStrongOp(RefOp op) {
+        const void* type = refStatsType(mBase);
+        mStatsType.store(type, std::memory_order_relaxed);
+        countRefOp(type, op);
+    }
+    void countWeakOp(RefOp op) { countRefOp(mStatsType.load(std::memory_order_relaxed), op); }
+
+private:
+    std::atomic<const void*> mStatsType{refStatsType(mBase)};
+#else
+    void countStrongOp(RefOp) { }
+    void countWeakOp(RefOp) { }
+#endif
 };
 
 // ---------------------------------------------------------------------------
@@ -450,6 +581,7 @@ private:
 void RefBase::incStrong(const void* id) const
 {
     weakref_impl* const refs = mRefs;
+    refs->countStrongOp(REF_OP_INC_STRONG);
     refs->incWeak(id);
 
     refs->addStrongRef(id);
@@ -472,6 +604,7 @@ void RefBase::incStrong(const void* id) const
 
 void RefBase::incStrongRequireStrong(const void* id) const {
     weakref_impl* const refs = mRefs;
+    refs->countStrongOp(REF_OP_INC_STRONG);
     refs->incWeak(id);
 
     refs->addStrongRef(id);
@@ -487,6 +620,7 @@ void RefBase::incStrongRequireStrong(const void* id) const {
 void RefBase::decStrong(const void* id) const
 {
     weakref_impl* const refs = mRefs;
+    refs->countStrongOp(REF_OP_DEC_STRONG);
     refs->removeStrongRef(id);
     const int32_t c = refs->mStrong.fetch_sub(1, std::memory_order_release);
 #if PRINT_REFS
@@ -522,6 +656,7 @@ void RefBase::forceIncStrong(const void* id) const
     // Allows initial mStrong of 0 in addition to INITIAL_STRONG_VALUE.
     // TODO: Better document assumptions.
     weakref_impl* const refs = mRefs;
+    refs->countStrongOp(REF_OP_INC_STRONG);
     refs->incWeak(id);
 
     refs->addStrongRef(id);
@@ -556,6 +691,7 @@ RefBase* RefBase::weakref_type::refBase() const
 void RefBase::weakref_type::incWeak(const void* id)
 {
     weakref_impl* const impl = static_cast<weakref_impl*>(this);
+    impl->countWeakOp(REF_OP_INC_WEAK);
     impl->addWeakRef(id);
     const int32_t c __unused = impl->mWeak.fetch_add(1,
             std::memory_order_relaxed);
@@ -565,6 +701,7 @@ void RefBase::weakref_type::incWeak(const void* id)
 void RefBase::weakref_type::incWeakRequireWeak(const void* id)
 {
     weakref_impl* const impl = static_cast<weakref_impl*>(this);
+    impl->countWeakOp(REF_OP_INC_WEAK);
     impl->addWeakRef(id);
     const int32_t c __unused = impl->mWeak.fetch_add(1,
             std::memory_order_relaxed);
@@ -574,6 +711,7 @@ void RefBase::weakref_type::incWeakRequireWeak(const void* id)
 void RefBase::weakref_type::decWeak(const void* id)
 {
     weakref_impl* const impl = static_cast<weakref_impl*>(this);
+    impl->countWeakOp(REF_OP_DEC_WEAK);
     impl->removeWeakRef(id);
     const int32_t c = impl->mWeak.fetch_sub(1, std::memory_order_release);
     LOG_ALWAYS_FATAL_IF(BAD_WEAK(c), "decWeak called on %p too many times",
@@ -612,9 +750,10 @@ void RefBase::weakref_type::decWeak(const void* id)
 
 bool RefBase::weakref_type::attemptIncStrong(const void* id)
 {
+    weakref_impl* const impl = static_cast<weakref_impl*>(this);
+    impl->countWeakOp(REF_OP_ATTEMPT_INC_STRONG);
     incWeak(id);
 
-    weakref_impl* const impl = static_cast<weakref_impl*>(this);
     int32_t curCount = impl->mStrong.load(std::memory_order_relaxed);
 
     ALOG_ASSERT(curCount >= 0,
@@ -725,6 +864,7 @@ bool RefBase::weakref_type::attemptIncWeak(const void* id)
     }
 
     if (curCount > 0) {
+        impl->countWeakOp(REF_OP_INC_WEAK);
         impl->addWeakRef(id);
     }
 
@@ -741,6 +881,9 @@ int32_t RefBase::weakref_type::getWeakCount() const
 void RefBase::weakref_type::printRefs() const
 {
     static_cast<const weakref_impl*>(this)->printRefs();
+#if DEBUG_REFS_STATS
+    logRefStats();
+#endif
 }
 
 void RefBase::weakref_type::trackMe(bool enable, bool retain)
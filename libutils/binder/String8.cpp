@@ -205,17 +205,21 @@ void String8::setTo(const String8& other)
 
 status_t String8::setTo(const char* other)
 {
-    const char *newString = allocFromUTF8(other, strlen(other));
-    SharedBuffer::bufferFromData(mString)->release();
-    mString = newString;
-    if (mString) return OK;
-
-    mString = getEmptyString();
-    return NO_MEMORY;
+    return setTo(other, strlen(other));
 }
 
 status_t String8::setTo(const char* other, size_t len)
 {
+    // Reuse the buffer when nothing else refers to it and the length is unchanged, which is
+    // common when a String8 is refilled in a loop. |other| may point into the buffer.
+    const SharedBuffer* buf = SharedBuffer::bufferFromData(mString);
+    if (len > 0 && buf->size() == len + 1) {
+        if (SharedBuffer* editable = buf->attemptEdit()) {
+            memmove(editable->data(), other, len);
+            return OK;
+        }
+    }
+
     const char *newString = allocFromUTF8(other, len);
     SharedBuffer::bufferFromData(mString)->release();
     mString = newString;
@@ -291,13 +295,16 @@ status_t String8::appendFormatV(const char* fmt, va_list args)
 {
     int n, result = OK;
     va_list tmp_args;
+    // Most formatted strings are short, so format into the stack first and only format a second
+    // time, straight into the string, when the result doesn't fit.
+    char stackBuf[256];
 
     /* args is undefined after vsnprintf.
      * So we need a copy here to avoid the
      * second vsnprintf access undefined args.
      */
     va_copy(tmp_args, args);
-    n = vsnprintf(nullptr, 0, fmt, tmp_args);
+    n = vsnprintf(stackBuf, sizeof(stackBuf), fmt, tmp_args);
     va_end(tmp_args);
 
     if (n < 0) return UNKNOWN_ERROR;
@@ -309,10 +316,12 @@ status_t String8::appendFormatV(const char* fmt, va_list args)
             return NO_MEMORY;
         }
         char* buf = lockBuffer(oldLength + n);
-        if (buf) {
-            vsnprintf(buf + oldLength, n + 1, fmt, args);
-        } else {
+        if (buf == nullptr) {
             result = NO_MEMORY;
+        } else if (static_cast<size_t>(n) < sizeof(stackBuf)) {
+            memcpy(buf + oldLength, stackBuf, n + 1);
+        } else {
+            vsnprintf(buf + oldLength, n + 1, fmt, args);
         }
     }
     return result;
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <utils/String16.h>
+#include <utils/String8.h>
+
+static const char kShortString[] = "android.os.IServiceManager";
+
+void BM_String8_construct_short(benchmark::State& state) {
+    for (auto _ : state) {
+        android::String8 s(kShortString);
+        benchmark::DoNotOptimize(s.c_str());
+    }
+}
+BENCHMARK(BM_String8_construct_short);
+
+void BM_String8_copy(benchmark::State& state) {
+    android::String8 s(kShortString);
+    for (auto _ : state) {
+        android::String8 copy(s);
+        benchmark::DoNotOptimize(copy.c_str());
+    }
+}
+BENCHMARK(BM_String8_copy);
+
+void BM_String8_setTo_same_length(benchmark::State& state) {
+    android::String8 s(kShortString);
+    for (auto _ : state) {
+        s.setTo(kShortString);
+        benchmark::DoNotOptimize(s.c_str());
+    }
+}
+BENCHMARK(BM_String8_setTo_same_length);
+
+void BM_String8_format_short(benchmark::State& state) {
+    for (auto _ : state) {
+        android::String8 s = android::String8::format("ro.boottime.%s", "init");
+        benchmark::DoNotOptimize(s.c_str());
+    }
+}
+BENCHMARK(BM_String8_format_short);
+
+void BM_String8_appendFormat(benchmark::State& state) {
+    for (auto _ : state) {
+        android::String8 s;
+        for (int i = 0; i < 16; i++) {
+            s.appendFormat("%d,", i);
+        }
+        benchmark::DoNotOptimize(s.c_str());
+    }
+}
+BENCHMARK(BM_String8_appendFormat);
+
+void BM_String8_from_String16(benchmark::State& state) {
+    android::String16 s16(kShortString);
+    for (auto _ : state) {
+        android::String8 s(s16);
+        benchmark::DoNotOptimize(s.c_str());
+    }
+}
+BENCHMARK(BM_String8_from_String16);
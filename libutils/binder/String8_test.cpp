@@ -20,6 +20,7 @@
 #include <utils/String16.h>
 #include <utils/String8.h>
 #include <compare>
+#include <string>
 #include <utility>
 
 #include <gtest/gtest.h>
@@ -117,6 +118,31 @@ TEST_F(String8Test, append) {
     EXPECT_STREQ("foobar", s.c_str());
 }
 
+TEST_F(String8Test, setToSameLength) {
+    String8 s("foobar");
+    String8 copy(s);
+
+    // The buffer is shared with |copy|, which must not change.
+    EXPECT_EQ(OK, s.setTo("bazqux"));
+    EXPECT_STREQ("bazqux", s.c_str());
+    EXPECT_STREQ("foobar", copy.c_str());
+
+    EXPECT_EQ(OK, s.setTo("foobar"));
+    EXPECT_STREQ("foobar", s.c_str());
+    EXPECT_EQ(6U, s.length());
+}
+
+TEST_F(String8Test, appendFormat) {
+    String8 s("x");
+    EXPECT_EQ(OK, s.appendFormat("%d-%s", 42, "y"));
+    EXPECT_STREQ("x42-y", s.c_str());
+
+    // Longer than the stack buffer used for short results.
+    std::string longString(1000, 'a');
+    EXPECT_EQ(OK, s.appendFormat("%s", longString.c_str()));
+    EXPECT_EQ(("x42-y" + longString), s.c_str());
+}
+
 TEST_F(String8Test, removeAll) {
     String8 s("Hello, world!");
 
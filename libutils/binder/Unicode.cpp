@@ -17,6 +17,7 @@
 #define LOG_TAG "unicode"
 
 #include <limits.h>
+#include <string.h>
 #include <utils/Unicode.h>
 
 #include <log/log.h>
@@ -51,6 +52,45 @@ static const char32_t kFirstByteMark[] = {
     0x00000000, 0x00000000, 0x000000C0, 0x000000E0, 0x000000F0
 };
 
+// Most strings are entirely or mostly ASCII, so the conversions below handle
+// ASCII runs a 64-bit word at a time: eight UTF-8 bytes or four UTF-16 code
+// units. The copy loops have a fixed trip count and go through a local
+// buffer, so they compile to vector widen and narrow instructions on targets
+// that have them. Each word also
+// tells us how many leading characters are ASCII, so a run that ends partway
+// through a word is still consumed in one step.
+static const uint64_t kAsciiMask8  = 0x8080808080808080ULL;
+static const uint64_t kAsciiMask16 = 0xff80ff80ff80ff80ULL;
+
+// Returns the number of leading bytes of |bits| that are zero, in memory order.
+static inline size_t leading_zero_bytes(uint64_t bits)
+{
+    if (bits == 0) {
+        return sizeof(bits);
+    }
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return __builtin_clzll(bits) / 8;
+#else
+    return __builtin_ctzll(bits) / 8;
+#endif
+}
+
+// Returns how many of the 8 bytes at |p| are ASCII before the first that isn't.
+static inline size_t ascii_prefix8(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return leading_zero_bytes(v & kAsciiMask8);
+}
+
+// Returns how many of the 4 code units at |p| are ASCII before the first that isn't.
+static inline size_t ascii_prefix16(const char16_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return leading_zero_bytes(v & kAsciiMask16) / sizeof(char16_t);
+}
+
 // --------------------------------------------------------------------------
 // UTF-32
 // --------------------------------------------------------------------------
@@ -302,6 +342,20 @@ ssize_t utf16_to_utf8_length(const char16_t *src, size_t src_len)
     size_t utf8_len = 0;
 
     while (in < end) {
+        if (*in < 0x0080) {
+            while (end - in >= 4) {
+                size_t n = ascii_prefix16(in);
+                utf8_len += n;
+                in += n;
+                if (n < 4) {
+                    break;
+                }
+            }
+            if (in == end) {
+                break;
+            }
+        }
+
         char16_t w = *in++;
         if (w < 0x0080) [[likely]] {
             utf8_len += 1;
@@ -343,6 +397,26 @@ void utf16_to_utf8(const char16_t* src, size_t src_len, char* dst, size_t dst_le
     };
 
     while (in < in_end) {
+        if (*in < 0x0080) {
+            while (in_end - in >= 4 && out_end - out >= 4) {
+                // Units past the ASCII prefix are overwritten below.
+                size_t n = ascii_prefix16(in);
+                char narrow[4];
+                for (int i = 0; i < 4; i++) {
+                    narrow[i] = (char)in[i];
+                }
+                memcpy(out, narrow, sizeof(narrow));
+                in += n;
+                out += n;
+                if (n < 4) {
+                    break;
+                }
+            }
+            if (in == in_end) {
+                break;
+            }
+        }
+
         char16_t w = *in++;
         if (w < 0x0080) [[likely]] {
             if (out + 1 > out_end)
@@ -417,6 +491,20 @@ ssize_t utf8_to_utf16_length(const uint8_t* u8str, size_t u8len, bool overreadIs
     size_t utf16_len = 0;
 
     while (in < in_end) {
+        if ((*in & 0x80) == 0) {
+            while (in_end - in >= 8) {
+                size_t n = ascii_prefix8(in);
+                utf16_len += n;
+                in += n;
+                if (n < 8) {
+                    break;
+                }
+            }
+            if (in == in_end) {
+                break;
+            }
+        }
+
         uint8_t c = *in;
         utf16_len++;
         if ((c & 0x80) == 0) [[likely]] {
@@ -485,6 +573,26 @@ char16_t* utf8_to_utf16_no_null_terminator(
     };
 
     while (in < in_end && out < out_end) {
+        if ((*in & 0x80) == 0) {
+            while (in_end - in >= 8 && out_end - out >= 8) {
+                // Units past the ASCII prefix are overwritten below.
+                size_t n = ascii_prefix8(in);
+                char16_t wide[8];
+                for (int i = 0; i < 8; i++) {
+                    wide[i] = (char16_t)in[i];
+                }
+                memcpy(out, wide, sizeof(wide));
+                in += n;
+                out += n;
+                if (n < 8) {
+                    break;
+                }
+            }
+            if (in == in_end || out == out_end) {
+                break;
+            }
+        }
+
         c = *in++;
         if ((c & 0x80) == 0) [[likely]] {
             *out++ = (char16_t)(c);
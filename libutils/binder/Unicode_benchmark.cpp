@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <utils/Unicode.h>
+
+// Typical binder interface descriptor.
+static const char kInterface[] = "android.hardware.graphics.composer3.IComposerCallback";
+
+// Property-sized value with a few non-ASCII characters mixed in.
+static const char kMixed[] = "Pixel \xe2\x84\xa2 build f\xc3\xbcr Test \xf0\x9f\x98\x80 ok";
+
+// Mostly non-ASCII text, e.g. a localized string.
+static const char kCjk[] =
+        "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae\xe3\x83\x86\xe3\x82\xad\xe3\x82\xb9"
+        "\xe3\x83\x88\xe3\x81\xa7\xe3\x81\x99";
+
+static std::string MakeLongAscii() {
+    std::string s;
+    while (s.size() < 4096) {
+        s += kInterface;
+    }
+    return s;
+}
+
+static void BenchUtf8ToUtf16(benchmark::State& state, const std::string& input) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(input.data());
+    std::vector<char16_t> dst(input.size() + 1);
+    for (auto _ : state) {
+        ssize_t len = utf8_to_utf16_length(src, input.size());
+        utf8_to_utf16(src, input.size(), dst.data(), len + 1);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+
+static void BenchUtf16ToUtf8(benchmark::State& state, const std::string& input) {
+    std::vector<char16_t> src(input.size() + 1);
+    size_t src_len = utf8_to_utf16(reinterpret_cast<const uint8_t*>(input.data()), input.size(),
+                                   src.data(), src.size()) -
+                     src.data();
+    std::vector<char> dst(input.size() + 1);
+    for (auto _ : state) {
+        ssize_t len = utf16_to_utf8_length(src.data(), src_len);
+        utf16_to_utf8(src.data(), src_len, dst.data(), len + 1);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * src_len * sizeof(char16_t));
+}
+
+void BM_utf8_to_utf16_interface(benchmark::State& state) {
+    BenchUtf8ToUtf16(state, kInterface);
+}
+BENCHMARK(BM_utf8_to_utf16_interface);
+
+void BM_utf8_to_utf16_mixed(benchmark::State& state) {
+    BenchUtf8ToUtf16(state, kMixed);
+}
+BENCHMARK(BM_utf8_to_utf16_mixed);
+
+void BM_utf8_to_utf16_cjk(benchmark::State& state) {
+    BenchUtf8ToUtf16(state, kCjk);
+}
+BENCHMARK(BM_utf8_to_utf16_cjk);
+
+void BM_utf8_to_utf16_long_ascii(benchmark::State& state) {
+    BenchUtf8ToUtf16(state, MakeLongAscii());
+}
+BENCHMARK(BM_utf8_to_utf16_long_ascii);
+
+void BM_utf16_to_utf8_interface(benchmark::State& state) {
+    BenchUtf16ToUtf8(state, kInterface);
+}
+BENCHMARK(BM_utf16_to_utf8_interface);
+
+void BM_utf16_to_utf8_mixed(benchmark::State& state) {
+    BenchUtf16ToUtf8(state, kMixed);
+}
+BENCHMARK(BM_utf16_to_utf8_mixed);
+
+void BM_utf16_to_utf8_cjk(benchmark::State& state) {
+    BenchUtf16ToUtf8(state, kCjk);
+}
+BENCHMARK(BM_utf16_to_utf8_cjk);
+
+void BM_utf16_to_utf8_long_ascii(benchmark::State& state) {
+    BenchUtf16ToUtf8(state, MakeLongAscii());
+}
+BENCHMARK(BM_utf16_to_utf8_long_ascii);
@@ -129,6 +129,39 @@ TEST_F(UnicodeTest, UTF8toUTF16Normal) {
     });
 }
 
+// Exercises the ASCII fast path with runs that are longer than, shorter than,
+// and interrupted by multi-byte sequences.
+TEST_F(UnicodeTest, UTF8toUTF16LongMixed) {
+    TestUTF8toUTF16({
+        'a', 'n', 'd', 'r', 'o', 'i', 'd', '.', 'o', 's', '.',
+        0xE2, 0x8C, 0xA3,       // U+2323
+        'I', 'S', 'e', 'r', 'v', 'i', 'c', 'e', 'M',
+        0xF0, 0x90, 0x80, 0x80, // U+10000
+        'a', 'n',
+        0xC4, 0x80,             // U+0100
+        'a', 'g', 'e', 'r', '0', '1', '2', '3', '4', '5', '6', '7',
+    }, {
+        'a', 'n', 'd', 'r', 'o', 'i', 'd', '.', 'o', 's', '.',
+        0x2323,
+        'I', 'S', 'e', 'r', 'v', 'i', 'c', 'e', 'M',
+        0xD800, 0xDC00,
+        'a', 'n',
+        0x0100,
+        'a', 'g', 'e', 'r', '0', '1', '2', '3', '4', '5', '6', '7',
+    });
+}
+
+TEST_F(UnicodeTest, UTF8toUTF16ShortBuffer) {
+    static const uint8_t kInput[] = "0123456789abcdefghij";
+    char16_t output[13];
+    char16_t* end = utf8_to_utf16(kInput, sizeof(kInput) - 1, output, 13);
+    EXPECT_EQ(output + 12, end);
+    for (size_t i = 0; i < 12; i++) {
+        EXPECT_EQ(kInput[i], output[i]);
+    }
+    EXPECT_EQ(0, output[12]) << "should be null terminated";
+}
+
 TEST_F(UnicodeTest, UTF8toUTF16Invalid) {
     // TODO: The current behavior of utf8_to_utf16 is to treat invalid
     // leading byte (>= 0xf8) as a 4-byte UTF8 sequence, and to treat
@@ -173,6 +206,26 @@ TEST_F(UnicodeTest, UTF16toUTF8ASCII) {
         "ASCII codepoints in UTF16 should give a length of 1 in UTF8");
 }
 
+TEST_F(UnicodeTest, UTF16toUTF8LongMixed) {
+    TestUTF16toUTF8({
+        'a', 'n', 'd', 'r', 'o', 'i', 'd', '.', 'o',
+        0x2323,
+        'I', 'S', 'e', 'r', 'v',
+        0xD800, 0xDC00,
+        'i', 'c', 'e',
+        0x0100,
+        'M', 'a', 'n', 'a', 'g', 'e', 'r', '0', '1',
+    }, {
+        'a', 'n', 'd', 'r', 'o', 'i', 'd', '.', 'o',
+        (char)0xE2, (char)0x8C, (char)0xA3,
+        'I', 'S', 'e', 'r', 'v',
+        (char)0xF0, (char)0x90, (char)0x80, (char)0x80,
+        'i', 'c', 'e',
+        (char)0xC4, (char)0x80,
+        'M', 'a', 'n', 'a', 'g', 'e', 'r', '0', '1',
+    });
+}
+
 TEST_F(UnicodeTest, UTF16toUTF8Plane1) {
     TestUTF16toUTF8(
         { 0x2323 },  // U+2323 SMILE
@@ -35,10 +35,21 @@ namespace android {
 
 const size_t kMinVectorCapacity = 4;
 
+// Vectors grow geometrically by kVectorGrowthNumerator / kVectorGrowthDenominator, so that
+// appending is amortized O(1). A larger factor trades memory for fewer reallocations.
+const size_t kVectorGrowthNumerator = 3;
+const size_t kVectorGrowthDenominator = 2;
+static_assert(kVectorGrowthNumerator > kVectorGrowthDenominator);
+
 static inline size_t max(size_t a, size_t b) {
     return a>b ? a : b;
 }
 
+// Copying such items already amounts to moving them.
+static inline bool isTriviallyCopyable(uint32_t flags) {
+    return (flags & VectorImpl::HAS_TRIVIAL_COPY) && (flags & VectorImpl::HAS_TRIVIAL_DTOR);
+}
+
 // ----------------------------------------------------------------------------
 
 VectorImpl::VectorImpl(size_t itemSize, uint32_t flags)
@@ -391,9 +402,15 @@ void* VectorImpl::_grow(size_t where, size_t amount)
         // capacity without the +1. The old calculation wouldn't work properly
         // if x was zero.
         //
-        // This approximates the old calculation, using (x + (x/2) + 1) instead.
+        // This approximates the old calculation, using (x + (x/2) + 1) instead, or in
+        // general x + (x/denominator)*(numerator-denominator) + 1.
         size_t new_capacity = 0;
-        LOG_ALWAYS_FATAL_IF(__builtin_add_overflow(new_size, (new_size / 2), &new_capacity),
+        size_t growth = 0;
+        LOG_ALWAYS_FATAL_IF(
+                __builtin_mul_overflow(new_size / kVectorGrowthDenominator,
+                                       kVectorGrowthNumerator - kVectorGrowthDenominator, &growth),
+                "new_capacity overflow");
+        LOG_ALWAYS_FATAL_IF(__builtin_add_overflow(new_size, growth, &new_capacity),
                             "new_capacity overflow");
         LOG_ALWAYS_FATAL_IF(
                 __builtin_add_overflow(new_capacity, static_cast<size_t>(1u), &new_capacity),
@@ -404,13 +421,17 @@ void* VectorImpl::_grow(size_t where, size_t amount)
         LOG_ALWAYS_FATAL_IF(__builtin_mul_overflow(new_capacity, mItemSize, &new_alloc_size),
                             "new_alloc_size overflow");
 
+        // When no other vector shares the storage, the items can be moved into the new
+        // storage rather than copied and then destroyed along with the old one.
+        const SharedBuffer* cur_sb = mStorage ? SharedBuffer::bufferFromData(mStorage) : nullptr;
+        const bool relocate = cur_sb && !isTriviallyCopyable(mFlags) && cur_sb->onlyOwner();
+
         // ALOGV("grow vector %p, new_capacity=%d", this, (int)new_capacity);
         if ((mStorage) &&
             (mCount==where) &&
-            (mFlags & HAS_TRIVIAL_COPY) &&
-            (mFlags & HAS_TRIVIAL_DTOR))
+            (((mFlags & HAS_TRIVIAL_COPY) && (mFlags & HAS_TRIVIAL_DTOR)) ||
+             (relocate && (mFlags & HAS_TRIVIAL_MOVE))))
         {
-            const SharedBuffer* cur_sb = SharedBuffer::bufferFromData(mStorage);
             SharedBuffer* sb = cur_sb->editResize(new_alloc_size);
             if (sb) {
                 mStorage = sb->data();
@@ -421,15 +442,26 @@ void* VectorImpl::_grow(size_t where, size_t amount)
             SharedBuffer* sb = SharedBuffer::alloc(new_alloc_size);
             if (sb) {
                 void* array = sb->data();
-                if (where != 0) {
-                    _do_copy(array, mStorage, where);
-                }
-                if (where != mCount) {
-                    const void* from = reinterpret_cast<const uint8_t *>(mStorage) + where*mItemSize;
-                    void* dest = reinterpret_cast<uint8_t *>(array) + (where+amount)*mItemSize;
-                    _do_copy(dest, from, mCount-where);
+                const void* from = reinterpret_cast<const uint8_t *>(mStorage) + where*mItemSize;
+                void* dest = reinterpret_cast<uint8_t *>(array) + (where+amount)*mItemSize;
+                if (relocate) {
+                    if (where != 0) {
+                        _do_move_forward(array, mStorage, where);
+                    }
+                    if (where != mCount) {
+                        _do_move_forward(dest, from, mCount-where);
+                    }
+                    // The items have all been moved out, so only the memory is left to free.
+                    SharedBuffer::dealloc(cur_sb);
+                } else {
+                    if (where != 0) {
+                        _do_copy(array, mStorage, where);
+                    }
+                    if (where != mCount) {
+                        _do_copy(dest, from, mCount-where);
+                    }
+                    release_storage();
                 }
-                release_storage();
                 mStorage = const_cast<void*>(array);
             } else {
                 return nullptr;
@@ -473,30 +505,49 @@ void VectorImpl::_shrink(size_t where, size_t amount)
         // we are always reducing the capacity of the underlying SharedBuffer.
         // In other words, (old_capacity * mItemSize) did not overflow, and
         // where < (where + amount) < new_capacity < old_capacity.
+        const SharedBuffer* cur_sb = SharedBuffer::bufferFromData(mStorage);
+        const bool relocate = !isTriviallyCopyable(mFlags) && cur_sb->onlyOwner();
         if ((where == new_size) &&
             (mFlags & HAS_TRIVIAL_COPY) &&
             (mFlags & HAS_TRIVIAL_DTOR))
         {
-            const SharedBuffer* cur_sb = SharedBuffer::bufferFromData(mStorage);
             SharedBuffer* sb = cur_sb->editResize(new_capacity * mItemSize);
             if (sb) {
                 mStorage = sb->data();
             } else {
                 return;
             }
+        } else if ((where == new_size) && relocate && (mFlags & HAS_TRIVIAL_MOVE)) {
+            _do_destroy(reinterpret_cast<uint8_t *>(mStorage) + where*mItemSize, amount);
+            SharedBuffer* sb = cur_sb->editResize(new_capacity * mItemSize);
+            if (sb) {
+                mStorage = sb->data();
+            }
+            // Otherwise the items are gone, and the storage just stays larger than needed.
         } else {
             SharedBuffer* sb = SharedBuffer::alloc(new_capacity * mItemSize);
             if (sb) {
                 void* array = sb->data();
-                if (where != 0) {
-                    _do_copy(array, mStorage, where);
-                }
-                if (where != new_size) {
-                    const void* from = reinterpret_cast<const uint8_t *>(mStorage) + (where+amount)*mItemSize;
-                    void* dest = reinterpret_cast<uint8_t *>(array) + where*mItemSize;
-                    _do_copy(dest, from, new_size - where);
+                const void* from = reinterpret_cast<const uint8_t *>(mStorage) + (where+amount)*mItemSize;
+                void* dest = reinterpret_cast<uint8_t *>(array) + where*mItemSize;
+                if (relocate) {
+                    _do_destroy(reinterpret_cast<uint8_t *>(mStorage) + where*mItemSize, amount);
+                    if (where != 0) {
+                        _do_move_backward(array, mStorage, where);
+                    }
+                    if (where != new_size) {
+                        _do_move_backward(dest, from, new_size - where);
+                    }
+                    SharedBuffer::dealloc(cur_sb);
+                } else {
+                    if (where != 0) {
+                        _do_copy(array, mStorage, where);
+                    }
+                    if (where != new_size) {
+                        _do_copy(dest, from, new_size - where);
+                    }
+                    release_storage();
                 }
-                release_storage();
                 mStorage = const_cast<void*>(array);
             } else{
                 return;
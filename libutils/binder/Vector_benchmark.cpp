@@ -15,6 +15,9 @@
  */
 
 #include <benchmark/benchmark.h>
+#include <utils/KeyedVector.h>
+#include <utils/SortedVector.h>
+#include <utils/String8.h>
 #include <utils/Vector.h>
 #include <vector>
 
@@ -50,4 +53,55 @@ void BM_prepend_std_vector(benchmark::State& state) {
 }
 BENCHMARK(BM_prepend_std_vector);
 
+void BM_fill_android_vector_string8(benchmark::State& state) {
+    android::String8 s("android.hardware.foo");
+    for (auto _ : state) {
+        android::Vector<android::String8> v;
+        for (int i = 0; i < state.range(0); i++) {
+            v.push(s);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_fill_android_vector_string8)->Arg(16)->Arg(1024);
+
+void BM_insert_sorted_vector(benchmark::State& state) {
+    for (auto _ : state) {
+        android::SortedVector<int> v;
+        // Interleave both ends so that inserts land throughout the vector.
+        for (int i = 0; i < state.range(0); i++) {
+            v.add((i % 2) ? i : -i);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_insert_sorted_vector)->Arg(16)->Arg(1024);
+
+void BM_insert_keyed_vector_string8(benchmark::State& state) {
+    for (auto _ : state) {
+        android::KeyedVector<int, android::String8> v;
+        for (int i = 0; i < state.range(0); i++) {
+            v.add((i % 2) ? i : -i, android::String8("value"));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_insert_keyed_vector_string8)->Arg(16)->Arg(1024);
+
+void BM_remove_keyed_vector_string8(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        android::KeyedVector<int, android::String8> v;
+        for (int i = 0; i < state.range(0); i++) {
+            v.add(i, android::String8("value"));
+        }
+        state.ResumeTiming();
+        for (int i = 0; i < state.range(0); i++) {
+            v.removeItem(i);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_remove_keyed_vector_string8)->Arg(16)->Arg(1024);
+
 BENCHMARK_MAIN();
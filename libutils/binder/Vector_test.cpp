@@ -25,6 +25,29 @@
 
 namespace android {
 
+// Counts live instances and copies, to check how Vector moves its items around.
+struct Tracked {
+    static int live;
+    static int copies;
+
+    explicit Tracked(int v = 0) : value(v) { live++; }
+    Tracked(const Tracked& other) : value(other.value) {
+        live++;
+        copies++;
+    }
+    Tracked& operator=(const Tracked& other) = default;
+    ~Tracked() { live--; }
+
+    int value;
+};
+int Tracked::live = 0;
+int Tracked::copies = 0;
+
+struct RelocatableTracked : Tracked {
+    using Tracked::Tracked;
+};
+ANDROID_TRIVIAL_MOVE_TRAIT(RelocatableTracked)
+
 class VectorTest : public testing::Test {
 protected:
     virtual void SetUp() {
@@ -135,6 +158,60 @@ TEST_F(VectorTest, editArray_Shared) {
   }
 }
 
+template <typename T>
+static void GrowAndShrink() {
+  Tracked::live = 0;
+  {
+    Vector<T> vector;
+    for (int i = 0; i < 64; i++) {
+      vector.insertAt(T(i), i / 2);
+    }
+    EXPECT_EQ(64, Tracked::live);
+
+    // Shares the storage, which must then be copied rather than moved.
+    Vector<T> shared = vector;
+    vector.removeItemsAt(1, 60);
+    EXPECT_EQ(64 + 4, Tracked::live);
+    ASSERT_EQ(4U, vector.size());
+    EXPECT_EQ(shared[0].value, vector[0].value);
+    EXPECT_EQ(shared[61].value, vector[1].value);
+    EXPECT_EQ(shared[63].value, vector[3].value);
+
+    shared.clear();
+    EXPECT_EQ(4, Tracked::live);
+    vector.removeItemsAt(0, 3);
+    EXPECT_EQ(1, Tracked::live);
+  }
+  EXPECT_EQ(0, Tracked::live);
+}
+
+TEST_F(VectorTest, GrowAndShrink) {
+  GrowAndShrink<Tracked>();
+}
+
+TEST_F(VectorTest, GrowAndShrink_Relocatable) {
+  GrowAndShrink<RelocatableTracked>();
+}
+
+TEST_F(VectorTest, _grow_RelocatesUnsharedItems) {
+  Tracked::copies = 0;
+  Vector<RelocatableTracked> vector;
+  for (int i = 0; i < 64; i++) {
+    vector.insertAt(RelocatableTracked(i), 0);
+  }
+  // Each item is copied in once, and never again when the storage grows.
+  EXPECT_EQ(64, Tracked::copies);
+  for (int i = 0; i < 64; i++) {
+    EXPECT_EQ(63 - i, vector[i].value);
+  }
+
+  vector.removeItemsAt(0, 62);
+  EXPECT_EQ(64, Tracked::copies);
+  ASSERT_EQ(2U, vector.size());
+  EXPECT_EQ(1, vector[0].value);
+  EXPECT_EQ(0, vector[1].value);
+}
+
 TEST_F(VectorTest, removeItemsAt_overflow) {
     android::Vector<int> v;
     for (int i = 0; i < 666; i++) v.add(i);
@@ -79,6 +79,9 @@ struct aggregate_traits {
 #define ANDROID_TRIVIAL_COPY_TRAIT( T ) \
     template<> struct trait_trivial_copy< T >   { enum { value = true }; };
 
+// A type with a trivial move can be relocated to another address with memmove(), with nothing
+// left to destroy at the old one. This holds for most types that only own pointers or handles,
+// such as String8, and opting them in lets Vector<> insert and regrow without copying.
 #define ANDROID_TRIVIAL_MOVE_TRAIT( T ) \
     template<> struct trait_trivial_move< T >   { enum { value = true }; };
 
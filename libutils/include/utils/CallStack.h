@@ -55,12 +55,30 @@ public:
     ~CallStack();
 
     // Reset the stack frames (same as creating an empty call stack).
-    void clear() { mFrameLines.clear(); }
+    void clear() {
+        mFrameLines.clear();
+        mPcs.clear();
+    }
 
     // Immediately collect the stack traces for the specified thread.
     // The default is to dump the stack of the current call.
     void update(int32_t ignoreDepth = 1, pid_t tid = -1);
 
+    // Collect only the program counters of the current thread's stack by following frame
+    // pointers, and defer symbolizing them until the stack is printed. This is much cheaper than
+    // update() for stacks that are usually thrown away, but only sees frames that were built with
+    // frame pointers.
+    void updatePcs(int32_t ignoreDepth = 1);
+
+    // Replace the stack with the given program counters, for example ones collected with
+    // capturePcs() in a signal handler. They are symbolized when the stack is printed.
+    void setPcs(const uintptr_t* pcs, size_t count);
+
+    // Write up to |maxFrames| program counters of the current thread's stack to |pcs| by following
+    // frame pointers, and return how many were written. This does not allocate or take locks, so
+    // it is safe to call from a signal handler.
+    static size_t capturePcs(uintptr_t* pcs, size_t maxFrames, int32_t ignoreDepth = 1);
+
     // Dump a stack trace to the log using the supplied logtag.
     void log(const char* logtag,
              android_LogPriority priority = ANDROID_LOG_DEBUG,
@@ -73,10 +91,11 @@ public:
     String8 toString(const char* prefix = nullptr) const;
 
     // Dump a serialized representation of the stack trace to the specified printer.
+    // Stacks collected with updatePcs() or setPcs() are symbolized here on every call.
     void print(Printer& printer) const;
 
     // Get the count of stack frames that are in this call stack.
-    size_t size() const { return mFrameLines.size(); }
+    size_t size() const { return mPcs.isEmpty() ? mFrameLines.size() : mPcs.size(); }
 
     // DO NOT USE ANYTHING BELOW HERE. The following public members are expected
     // to disappear again shortly, once a better replacement facility exists.
@@ -164,6 +183,8 @@ public:
 #endif // CALLSTACK_WEAKS_AVAILABLE
 
     Vector<String8> mFrameLines;
+    // Set instead of mFrameLines when symbolization is deferred.
+    Vector<uintptr_t> mPcs;
 };
 
 }  // namespace android
@@ -115,7 +115,14 @@ inline Condition::~Condition() {
     pthread_cond_destroy(&mCond);
 }
 inline status_t Condition::wait(Mutex& mutex) {
+#if defined(ANDROID_UTILS_LOCK_PROFILING)
+    nsecs_t start = LockProfiler::beginWait(&mutex.mMutex);
+    status_t err = -pthread_cond_wait(&mCond, &mutex.mMutex);
+    LockProfiler::endWait(&mutex.mMutex, start);
+    return err;
+#else
     return -pthread_cond_wait(&mCond, &mutex.mMutex);
+#endif
 }
 inline status_t Condition::waitRelative(Mutex& mutex, nsecs_t reltime) {
     struct timespec ts;
@@ -147,7 +154,14 @@ inline status_t Condition::waitRelative(Mutex& mutex, nsecs_t reltime) {
 
     ts.tv_sec = (time_sec > LONG_MAX) ? LONG_MAX : static_cast<long>(time_sec);
 
+#if defined(ANDROID_UTILS_LOCK_PROFILING)
+    nsecs_t start = LockProfiler::beginWait(&mutex.mMutex);
+    status_t err = -pthread_cond_timedwait(&mCond, &mutex.mMutex, &ts);
+    LockProfiler::endWait(&mutex.mMutex, start);
+    return err;
+#else
     return -pthread_cond_timedwait(&mCond, &mutex.mMutex, &ts);
+#endif
 }
 inline void Condition::signal() {
     pthread_cond_signal(&mCond);
@@ -20,6 +20,7 @@
 #ifndef __LIBS_FILE_MAP_H
 #define __LIBS_FILE_MAP_H
 
+#include <stdint.h>
 #include <sys/types.h>
 
 #include <utils/Compat.h>
@@ -66,6 +67,25 @@ public:
     bool create(const char* origFileName, int fd,
                 off64_t offset, size_t length, bool readOnly);
 
+    /*
+     * Flags for the create() overload that takes them.  Both are only
+     * hints, and are ignored where the system doesn't support them.
+     */
+    enum CreateFlags {
+        // Fault the whole map in up front, rather than a page at a time
+        // on first access.  Worth it for large maps that are read soon.
+        CREATE_POPULATE = 1 << 0,
+        // Ask for transparent huge pages, which cuts the number of faults
+        // and TLB entries further where the file system supports them.
+        CREATE_HUGEPAGE = 1 << 1,
+    };
+
+    /*
+     * Same as above, with a combination of CreateFlags.
+     */
+    bool create(const char* origFileName, int fd,
+                off64_t offset, size_t length, bool readOnly, uint32_t createFlags);
+
     ~FileMap(void);
 
     /*
@@ -103,6 +123,16 @@ public:
      */
     int advise(MapAdvice advice);
 
+    /*
+     * Return the number of pages of the map that are in memory, or -1 if
+     * this is not supported.  Accessing any other page is a major fault
+     * that has to wait for storage, so checking this after create() or
+     * advise() shows how much of the file they brought in.  (Minor faults
+     * on pages that are in memory but not yet mapped show up in
+     * getrusage().)
+     */
+    ssize_t getResidentPages(void) const;
+
 protected:
 
 private:
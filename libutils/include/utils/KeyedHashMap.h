@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_KEYED_HASH_MAP_H
+#define ANDROID_KEYED_HASH_MAP_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include <log/log.h>
+#include <utils/Errors.h>
+#include <utils/TypeHelpers.h>
+#include <utils/Vector.h>
+
+// ---------------------------------------------------------------------------
+
+namespace android {
+
+/*
+ * A hash map with the same interface as KeyedVector, for code that uses a KeyedVector with
+ * many keys and can't easily move to std::unordered_map. Adding, finding and removing a key
+ * take constant time on average, rather than a binary search plus an O(n) memmove.
+ *
+ * The items are kept in a dense array, so they can still be walked by index with keyAt() and
+ * valueAt(), and found through an open-addressing table of indices into that array. Unlike
+ * KeyedVector, the items are not sorted by key: they are in the order they were added, except
+ * that removing an item moves the last one into its place. Removing items while walking them by
+ * index still works, as long as the loop does not advance past an index it just removed.
+ *
+ * KEY needs operator== and a hash_type() specialization, as for LruCache.
+ */
+template <typename KEY, typename VALUE>
+class KeyedHashMap
+{
+public:
+    typedef KEY    key_type;
+    typedef VALUE  value_type;
+
+    inline                  KeyedHashMap();
+
+    /*
+     * empty the map
+     */
+
+            void            clear();
+
+    /*!
+     * map stats
+     */
+
+    //! returns number of items in the map
+    inline  size_t          size() const                { return mItems.size(); }
+    //! returns whether or not the map is empty
+    inline  bool            isEmpty() const             { return mItems.isEmpty(); }
+    //! returns how many items can be stored without rehashing
+    inline  size_t          capacity() const            { return mSlots.size() / 4 * 3; }
+    //! sets the capacity. capacity can never be reduced less than size()
+            ssize_t         setCapacity(size_t size);
+
+    // returns true if the arguments is known to be identical to this map
+    inline bool isIdenticalTo(const KeyedHashMap& rhs) const;
+
+    /*!
+     * accessors
+     */
+    const VALUE& valueFor(const KEY& key) const;
+    const VALUE& valueAt(size_t index) const;
+    const KEY& keyAt(size_t index) const;
+    ssize_t indexOfKey(const KEY& key) const;
+    const VALUE& operator[](size_t index) const;
+
+    /*!
+     * modifying the map
+     */
+
+            VALUE&          editValueFor(const KEY& key);
+            VALUE&          editValueAt(size_t index);
+
+            /*!
+             * add/insert/replace items
+             */
+
+            ssize_t         add(const KEY& key, const VALUE& item);
+            ssize_t         replaceValueFor(const KEY& key, const VALUE& item);
+            ssize_t         replaceValueAt(size_t index, const VALUE& item);
+
+    /*!
+     * remove items
+     */
+
+            ssize_t         removeItem(const KEY& key);
+            ssize_t         removeItemsAt(size_t index, size_t count = 1);
+
+private:
+    struct Slot {
+        // 1 + the index of the item in mItems, or 0 if the slot is empty.
+        uint32_t item;
+        hash_t hash;
+    };
+
+    static constexpr uint32_t kMinSlotBits = 3;
+
+    // Maps a hash to its preferred slot. Keys such as small integers hash to themselves, so this
+    // spreads them over the table with a multiplicative (Fibonacci) hash.
+    inline  size_t          homeSlot(hash_t hash) const {
+        return static_cast<uint32_t>(uint64_t(hash) * 2654435769u) >> (32 - mSlotBits);
+    }
+
+            // Returns the index of the item with |key|, or NAME_NOT_FOUND. Either way |*slot| is
+            // set to the slot that holds the item, or to the empty slot where it would go.
+            ssize_t         find(const KEY& key, hash_t hash, size_t* slot) const;
+            size_t          slotOfItem(size_t index) const;
+            void            rehash(uint32_t slotBits);
+            void            removeItemAt(size_t index);
+
+            Vector< key_value_pair_t<KEY, VALUE> >  mItems;
+            std::vector<Slot>                       mSlots;
+            uint32_t                                mSlotBits;
+};
+
+// ---------------------------------------------------------------------------
+// No user serviceable parts from here...
+// ---------------------------------------------------------------------------
+
+template<typename KEY, typename VALUE> inline
+KeyedHashMap<KEY,VALUE>::KeyedHashMap()
+    : mSlotBits(0)
+{
+}
+
+template<typename KEY, typename VALUE> inline
+void KeyedHashMap<KEY,VALUE>::clear() {
+    mItems.clear();
+    mSlots.clear();
+    mSlotBits = 0;
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t KeyedHashMap<KEY,VALUE>::setCapacity(size_t size) {
+    if (size > UINT32_MAX / 2) return NO_MEMORY;
+    uint32_t slotBits = mSlotBits ? mSlotBits : kMinSlotBits;
+    while ((size_t(1) << slotBits) / 4 * 3 < size) {
+        slotBits++;
+    }
+    if (slotBits != mSlotBits) {
+        rehash(slotBits);
+    }
+    ssize_t result = mItems.setCapacity(size);
+    return result < 0 ? result : static_cast<ssize_t>(capacity());
+}
+
+template<typename KEY, typename VALUE> inline
+bool KeyedHashMap<KEY,VALUE>::isIdenticalTo(const KeyedHashMap<KEY,VALUE>& rhs) const {
+    return mItems.array() == rhs.mItems.array();
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t KeyedHashMap<KEY,VALUE>::find(const KEY& key, hash_t hash, size_t* slot) const {
+    if (mSlots.empty()) return NAME_NOT_FOUND;
+    const size_t mask = mSlots.size() - 1;
+    // The table is never full, so there is always an empty slot to stop at.
+    for (size_t i = homeSlot(hash); ; i = (i + 1) & mask) {
+        const Slot& s = mSlots[i];
+        if (s.item == 0) {
+            *slot = i;
+            return NAME_NOT_FOUND;
+        }
+        if (s.hash == hash && mItems.itemAt(s.item - 1).key == key) {
+            *slot = i;
+            return static_cast<ssize_t>(s.item - 1);
+        }
+    }
+}
+
+template<typename KEY, typename VALUE> inline
+size_t KeyedHashMap<KEY,VALUE>::slotOfItem(size_t index) const {
+    const size_t mask = mSlots.size() - 1;
+    size_t i = homeSlot(hash_type(mItems.itemAt(index).key));
+    while (mSlots[i].item != index + 1) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+template<typename KEY, typename VALUE> inline
+void KeyedHashMap<KEY,VALUE>::rehash(uint32_t slotBits) {
+    std::vector<Slot> oldSlots(size_t(1) << slotBits, Slot{0, 0});
+    oldSlots.swap(mSlots);
+    mSlotBits = slotBits;
+    const size_t mask = mSlots.size() - 1;
+    for (const Slot& s : oldSlots) {
+        if (s.item == 0) continue;
+        size_t i = homeSlot(s.hash);
+        while (mSlots[i].item != 0) {
+            i = (i + 1) & mask;
+        }
+        mSlots[i] = s;
+    }
+}
+
+template<typename KEY, typename VALUE> inline
+void KeyedHashMap<KEY,VALUE>::removeItemAt(size_t index) {
+    const size_t mask = mSlots.size() - 1;
+
+    // Empty the item's slot, and shift back the items after it that would otherwise no longer be
+    // reachable from their home slot. This keeps probe sequences free of tombstones.
+    size_t hole = slotOfItem(index);
+    for (size_t i = (hole + 1) & mask; mSlots[i].item != 0; i = (i + 1) & mask) {
+        // Distances are computed modulo the table size, without relying on unsigned wraparound.
+        size_t home = homeSlot(mSlots[i].hash);
+        if (((i + mSlots.size() - home) & mask) >= ((i + mSlots.size() - hole) & mask)) {
+            mSlots[hole] = mSlots[i];
+            hole = i;
+        }
+    }
+    mSlots[hole].item = 0;
+
+    // Keep the items dense by moving the last one into the gap.
+    const size_t last = mItems.size() - 1;
+    if (index != last) {
+        mSlots[slotOfItem(last)].item = index + 1;
+        key_value_pair_t<KEY, VALUE>* items = mItems.editArray();
+        items[index] = items[last];
+    }
+    mItems.removeItemsAt(last);
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t KeyedHashMap<KEY,VALUE>::indexOfKey(const KEY& key) const {
+    size_t slot;
+    return find(key, hash_type(key), &slot);
+}
+
+template<typename KEY, typename VALUE> inline
+const VALUE& KeyedHashMap<KEY,VALUE>::valueFor(const KEY& key) const {
+    ssize_t i = this->indexOfKey(key);
+    LOG_ALWAYS_FATAL_IF(i<0, "%s: key not found", __PRETTY_FUNCTION__);
+    return mItems.itemAt(i).value;
+}
+
+template<typename KEY, typename VALUE> inline
+const VALUE& KeyedHashMap<KEY,VALUE>::valueAt(size_t index) const {
+    return mItems.itemAt(index).value;
+}
+
+template<typename KEY, typename VALUE> inline
+const VALUE& KeyedHashMap<KEY,VALUE>::operator[] (size_t index) const {
+    return valueAt(index);
+}
+
+template<typename KEY, typename VALUE> inline
+const KEY& KeyedHashMap<KEY,VALUE>::keyAt(size_t index) const {
+    return mItems.itemAt(index).key;
+}
+
+template<typename KEY, typename VALUE> inline
+VALUE& KeyedHashMap<KEY,VALUE>::editValueFor(const KEY& key) {
+    ssize_t i = this->indexOfKey(key);
+    LOG_ALWAYS_FATAL_IF(i<0, "%s: key not found", __PRETTY_FUNCTION__);
+    return mItems.editItemAt(static_cast<size_t>(i)).value;
+}
+
+template<typename KEY, typename VALUE> inline
+VALUE& KeyedHashMap<KEY,VALUE>::editValueAt(size_t index) {
+    return mItems.editItemAt(index).value;
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t KeyedHashMap<KEY,VALUE>::add(const KEY& key, const VALUE& value) {
+    const hash_t hash = hash_type(key);
+    size_t slot;
+    ssize_t index = find(key, hash, &slot);
+    if (index >= 0) {
+        // Like KeyedVector, adding an existing key replaces its value.
+        mItems.editItemAt(static_cast<size_t>(index)).value = value;
+        return index;
+    }
+    if (mItems.size() >= capacity()) {
+        if (mItems.size() >= UINT32_MAX / 2) return NO_MEMORY;
+        rehash(mSlotBits ? mSlotBits + 1 : kMinSlotBits);
+        find(key, hash, &slot);
+    }
+    index = mItems.add(key_value_pair_t<KEY,VALUE>(key, value));
+    if (index >= 0) {
+        mSlots[slot] = Slot{static_cast<uint32_t>(index + 1), hash};
+    }
+    return index;
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t KeyedHashMap<KEY,VALUE>::replaceValueFor(const KEY& key, const VALUE& value) {
+    return add(key, value);
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t KeyedHashMap<KEY,VALUE>::replaceValueAt(size_t index, const VALUE& item) {
+    if (index<size()) {
+        mItems.editItemAt(index).value = item;
+        return static_cast<ssize_t>(index);
+    }
+    return BAD_INDEX;
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t KeyedHashMap<KEY,VALUE>::removeItem(const KEY& key) {
+    ssize_t index = indexOfKey(key);
+    if (index >= 0) {
+        removeItemAt(static_cast<size_t>(index));
+    }
+    return index;
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t KeyedHashMap<KEY, VALUE>::removeItemsAt(size_t index, size_t count) {
+    size_t end;
+    LOG_ALWAYS_FATAL_IF(__builtin_add_overflow(index, count, &end), "overflow: index=%zu count=%zu",
+                        index, count);
+    if (end > size()) return BAD_VALUE;
+    // Remove from the end of the range, so that the items moved into the gaps all come from
+    // after the range.
+    while (end > index) {
+        removeItemAt(--end);
+    }
+    return static_cast<ssize_t>(index);
+}
+
+}  // namespace android
+
+// ---------------------------------------------------------------------------
+
+#endif // ANDROID_KEYED_HASH_MAP_H
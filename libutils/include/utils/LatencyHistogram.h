@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <utils/Printer.h>
+#include <utils/Timers.h>
+
+// SCOPED_LATENCY records the time from its location until the end of its enclosing scope into a
+// static histogram called name, which must be a string literal.
+#define _LATENCY_PASTE(x, y) x##y
+#define LATENCY_PASTE(x, y) _LATENCY_PASTE(x, y)
+#define SCOPED_LATENCY(name)                                                                   \
+    static ::android::LatencyHistogram LATENCY_PASTE(___latency_histogram, __LINE__)(name);     \
+    ::android::ScopedLatency LATENCY_PASTE(___latency, __LINE__)(                              \
+            LATENCY_PASTE(___latency_histogram, __LINE__))
+
+namespace android {
+
+/**
+ * An always-on latency distribution that is cheap enough to update on hot paths.
+ *
+ * Latencies go into log-linear buckets, four per power of two of nanoseconds, so that the bounds
+ * of a bucket are within 25% of each other. Recording is a few relaxed atomic operations on one
+ * of a fixed set of cache-line-aligned shards, picked once per thread, so threads recording into
+ * the same histogram do not contend for a lock or a cache line. The shards are only summed up
+ * when a snapshot is taken.
+ *
+ * Every histogram is listed by dumpAll() for as long as it exists.
+ */
+class LatencyHistogram {
+  public:
+    static constexpr size_t kSubBucketBits = 2;
+    static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+    // Latencies of 2^kMaxExponent ns (about nine minutes) and more land in the last bucket.
+    static constexpr size_t kMaxExponent = 39;
+    static constexpr size_t kBucketCount = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+    // Called with every latency recorded, eg. to forward samples to expresslog.
+    using OnRecord = std::function<void(nsecs_t)>;
+
+    struct Snapshot {
+        uint64_t count = 0;
+        nsecs_t sum = 0;
+        nsecs_t max = 0;
+        std::array<uint64_t, kBucketCount> buckets = {};
+
+        nsecs_t mean() const { return count ? sum / static_cast<nsecs_t>(count) : 0; }
+
+        // The latency that percent of the samples do not exceed, rounded up to the upper bound
+        // of its bucket. Zero if there are no samples.
+        nsecs_t percentile(double percent) const {
+            if (count == 0) return 0;
+            double rank = std::ceil(std::clamp(percent, 0.0, 100.0) / 100.0 * count);
+            uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(rank));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBucketCount; i++) {
+                seen += buckets[i];
+                if (seen >= target) return std::min(bucketUpperBound(i), max);
+            }
+            return max;
+        }
+    };
+
+    explicit LatencyHistogram(const char* name, OnRecord onRecord = nullptr)
+        : mName(name), mOnRecord(std::move(onRecord)), mShards(new Shard[kShardCount]) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.lock);
+        r.histograms.push_back(this);
+    }
+
+    ~LatencyHistogram() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.lock);
+        r.histograms.erase(std::find(r.histograms.begin(), r.histograms.end(), this));
+    }
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    const char* name() const { return mName; }
+
+    void record(nsecs_t latency) {
+        latency = std::max<nsecs_t>(latency, 0);
+        Shard& shard = mShards[shardIndex()];
+        shard.buckets[bucketIndex(latency)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(latency, std::memory_order_relaxed);
+        nsecs_t max = shard.max.load(std::memory_order_relaxed);
+        while (latency > max &&
+               !shard.max.compare_exchange_weak(max, latency, std::memory_order_relaxed)) {
+        }
+        if (mOnRecord) mOnRecord(latency);
+    }
+
+    // Samples recorded concurrently may or may not be included.
+    Snapshot snapshot() const {
+        Snapshot s;
+        for (size_t i = 0; i < kShardCount; i++) {
+            const Shard& shard = mShards[i];
+            for (size_t j = 0; j < kBucketCount; j++) {
+                uint64_t n = shard.buckets[j].load(std::memory_order_relaxed);
+                s.buckets[j] += n;
+                s.count += n;
+            }
+            s.sum += shard.sum.load(std::memory_order_relaxed);
+            s.max = std::max(s.max, shard.max.load(std::memory_order_relaxed));
+        }
+        return s;
+    }
+
+    // Samples recorded concurrently may be partially cleared.
+    void reset() {
+        for (size_t i = 0; i < kShardCount; i++) {
+            Shard& shard = mShards[i];
+            for (auto& bucket : shard.buckets) bucket.store(0, std::memory_order_relaxed);
+            shard.sum.store(0, std::memory_order_relaxed);
+            shard.max.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Prints one line with the sample count, mean, common percentiles and maximum.
+    void dump(Printer& printer) const {
+        Snapshot s = snapshot();
+        printer.printFormatLine(
+                "%s: count=%" PRIu64 " mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus"
+                " max=%.1fus",
+                mName, s.count, toUs(s.mean()), toUs(s.percentile(50)), toUs(s.percentile(90)),
+                toUs(s.percentile(99)), toUs(s.percentile(99.9)), toUs(s.max));
+    }
+
+    // Dumps every histogram of the process, in the order they were created.
+    static void dumpAll(Printer& printer) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.lock);
+        for (const LatencyHistogram* h : r.histograms) h->dump(printer);
+    }
+
+    static size_t bucketIndex(nsecs_t latency) {
+        if (latency <= 0) return 0;
+        uint64_t v = std::min<uint64_t>(latency, (1ull << kMaxExponent) - 1);
+        if (v < kSubBuckets) return v;
+        size_t exponent = 63 - __builtin_clzll(v);
+        size_t sub = (v >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+        return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+    }
+
+    // The largest latency that falls in bucket index.
+    static nsecs_t bucketUpperBound(size_t index) {
+        if (index < kSubBuckets) return index;
+        size_t exponent = index / kSubBuckets + kSubBucketBits - 1;
+        uint64_t width = 1ull << (exponent - kSubBucketBits);
+        uint64_t lower = (kSubBuckets + index % kSubBuckets) * width;
+        return lower + width - 1;
+    }
+
+  private:
+    static constexpr size_t kShardCount = 8;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[kBucketCount] = {};
+        std::atomic<nsecs_t> sum = 0;
+        std::atomic<nsecs_t> max = 0;
+    };
+
+    struct Registry {
+        std::mutex lock;
+        std::vector<const LatencyHistogram*> histograms;
+    };
+
+    // Leaked, so that static histograms can unregister during exit.
+    static Registry& registry() {
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    // Threads are spread over the shards in the order they first record.
+    static size_t shardIndex() {
+        static std::atomic<size_t> next = 0;
+        thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % kShardCount;
+        return index;
+    }
+
+    static double toUs(nsecs_t ns) { return ns / 1000.0; }
+
+    const char* mName;
+    const OnRecord mOnRecord;
+    std::unique_ptr<Shard[]> mShards;
+};
+
+/**
+ * Records the time from its construction to its destruction into a histogram.
+ */
+class ScopedLatency {
+  public:
+    explicit ScopedLatency(LatencyHistogram& histogram)
+        : mHistogram(histogram), mStart(systemTime(SYSTEM_TIME_MONOTONIC)) {}
+
+    ~ScopedLatency() { mHistogram.record(systemTime(SYSTEM_TIME_MONOTONIC) - mStart); }
+
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+  private:
+    LatencyHistogram& mHistogram;
+    nsecs_t mStart;
+};
+
+}  // namespace android
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+class Printer;
+
+/*
+ * Lock contention profiling for Mutex, RWLock and Condition.
+ *
+ * Code compiled with ANDROID_UTILS_LOCK_PROFILING defined routes Mutex::lock() and unlock(),
+ * RWLock::readLock(), writeLock() and unlock(), and Condition::wait() and waitRelative() through
+ * these functions. Without it the wrappers stay plain pthread calls. The lock classes have the
+ * same layout either way, so profiled and unprofiled code can share locks.
+ *
+ * Statistics are kept per lock site: the return address of the call to the profiler, which is
+ * where the lock was taken when the inline wrappers are inlined. Every acquisition that has to
+ * wait is counted along with its wait time. One in every sample interval acquisitions of each
+ * thread also has its hold time measured, up to the matching unlock from the same thread.
+ *
+ * Linux and Android only.
+ */
+class LockProfiler {
+  public:
+    // Profiling is enabled by default; disabling it leaves only a flag check on each call.
+    static void setEnabled(bool enabled);
+    // Measure the hold time of one in every interval acquisitions; 0 turns hold times off.
+    static void setSampleInterval(uint32_t interval);
+
+    // Prints one line per lock site, the sites with the most total wait time first.
+    static void dump(Printer& printer);
+    static void reset();
+
+    // Called by the lock wrappers.
+    static status_t lock(pthread_mutex_t* mutex);
+    static void unlock(pthread_mutex_t* mutex);
+    static status_t readLock(pthread_rwlock_t* rwlock);
+    static status_t writeLock(pthread_rwlock_t* rwlock);
+    static void unlock(pthread_rwlock_t* rwlock);
+    // Bracket a wait on a condition that releases and reacquires mutex.
+    static nsecs_t beginWait(pthread_mutex_t* mutex);
+    static void endWait(pthread_mutex_t* mutex, nsecs_t start);
+};
+
+}  // namespace android
@@ -504,6 +504,10 @@ private:
     static void initEpollEvent(struct epoll_event* eventItem);
 };
 
+// Lets the message queue shift envelopes with memmove() rather than by copying each one, which
+// would also adjust the reference count of each handler.
+ANDROID_TRIVIAL_MOVE_TRAIT(Looper::MessageEnvelope)
+
 } // namespace android
 
 #endif // UTILS_LOOPER_H
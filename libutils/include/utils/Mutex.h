@@ -28,6 +28,12 @@
 #include <utils/Errors.h>
 #include <utils/Timers.h>
 
+// Define ANDROID_UTILS_LOCK_PROFILING for a whole module to profile its locks; see
+// <utils/LockProfiler.h>.
+#if defined(ANDROID_UTILS_LOCK_PROFILING) && !defined(_WIN32)
+#include <utils/LockProfiler.h>
+#endif
+
 // Enable thread safety attributes only with clang.
 // The attributes can be safely erased when compiling with other compilers.
 #if defined(__clang__) && (!defined(SWIG))
@@ -180,10 +186,18 @@ inline Mutex::~Mutex() {
     pthread_mutex_destroy(&mMutex);
 }
 inline status_t Mutex::lock() {
+#if defined(ANDROID_UTILS_LOCK_PROFILING)
+    return LockProfiler::lock(&mMutex);
+#else
     return -pthread_mutex_lock(&mMutex);
+#endif
 }
 inline void Mutex::unlock() {
+#if defined(ANDROID_UTILS_LOCK_PROFILING)
+    LockProfiler::unlock(&mMutex);
+#else
     pthread_mutex_unlock(&mMutex);
+#endif
 }
 inline status_t Mutex::tryLock() {
     return -pthread_mutex_trylock(&mMutex);
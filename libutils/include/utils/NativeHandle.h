@@ -17,11 +17,10 @@
 #ifndef ANDROID_NATIVE_HANDLE_H
 #define ANDROID_NATIVE_HANDLE_H
 
+#include <cutils/native_handle.h>
 #include <utils/RefBase.h>
 #include <utils/StrongPointer.h>
 
-typedef struct native_handle native_handle_t;
-
 namespace android {
 
 class NativeHandle : public LightRefBase<NativeHandle> {
@@ -53,6 +52,78 @@ private:
     NativeHandle& operator=(const NativeHandle&);
 };
 
+// Move-only owner of a native_handle_t, for call sites that hand a handle
+// along a single path and don't need NativeHandle's shared ownership. It
+// lives inline in its owner, so unlike sp<NativeHandle> there is no extra
+// heap allocation or atomic refcount per handle.
+class UniqueNativeHandle {
+public:
+    UniqueNativeHandle() : mHandle(nullptr), mOwnsHandle(false) {}
+
+    // Declare whether the wrapper owns the handle (so that it should close
+    // and delete it upon destruction) or only borrows it.
+    UniqueNativeHandle(native_handle_t* handle, bool ownsHandle)
+        : mHandle(handle), mOwnsHandle(handle != nullptr && ownsHandle) {}
+
+    ~UniqueNativeHandle() { reset(); }
+
+    UniqueNativeHandle(UniqueNativeHandle&& other) noexcept
+        : mHandle(other.mHandle), mOwnsHandle(other.mOwnsHandle) {
+        other.mHandle = nullptr;
+        other.mOwnsHandle = false;
+    }
+
+    UniqueNativeHandle& operator=(UniqueNativeHandle&& other) noexcept {
+        if (this != &other) {
+            reset(other.mHandle, other.mOwnsHandle);
+            other.mHandle = nullptr;
+            other.mOwnsHandle = false;
+        }
+        return *this;
+    }
+
+    const native_handle_t* handle() const {
+        return mHandle;
+    }
+
+    explicit operator bool() const {
+        return mHandle != nullptr;
+    }
+
+    // Close and delete the current handle if it is owned, then take handle.
+    void reset(native_handle_t* handle = nullptr, bool ownsHandle = true) {
+        if (mOwnsHandle) {
+            native_handle_close(mHandle);
+            native_handle_delete(mHandle);
+        }
+        mHandle = handle;
+        mOwnsHandle = handle != nullptr && ownsHandle;
+    }
+
+    // Give up ownership without closing anything; the caller becomes
+    // responsible for the returned handle.
+    native_handle_t* release() {
+        native_handle_t* handle = mHandle;
+        mHandle = nullptr;
+        mOwnsHandle = false;
+        return handle;
+    }
+
+    // Convert into the refcounted wrapper when shared ownership is needed
+    // after all.
+    sp<NativeHandle> share() {
+        bool ownsHandle = mOwnsHandle;
+        return NativeHandle::create(release(), ownsHandle);
+    }
+
+private:
+    native_handle_t* mHandle;
+    bool mOwnsHandle;
+
+    UniqueNativeHandle(const UniqueNativeHandle&) = delete;
+    UniqueNativeHandle& operator=(const UniqueNativeHandle&) = delete;
+};
+
 } // namespace android
 
 #endif // ANDROID_NATIVE_HANDLE_H
@@ -27,6 +27,10 @@
 #include <utils/Errors.h>
 #include <utils/ThreadDefs.h>
 
+#if defined(ANDROID_UTILS_LOCK_PROFILING) && !defined(_WIN32)
+#include <utils/LockProfiler.h>
+#endif
+
 // ---------------------------------------------------------------------------
 namespace android {
 // ---------------------------------------------------------------------------
@@ -102,19 +106,31 @@ inline RWLock::~RWLock() {
     pthread_rwlock_destroy(&mRWLock);
 }
 inline status_t RWLock::readLock() {
+#if defined(ANDROID_UTILS_LOCK_PROFILING)
+    return LockProfiler::readLock(&mRWLock);
+#else
     return -pthread_rwlock_rdlock(&mRWLock);
+#endif
 }
 inline status_t RWLock::tryReadLock() {
     return -pthread_rwlock_tryrdlock(&mRWLock);
 }
 inline status_t RWLock::writeLock() {
+#if defined(ANDROID_UTILS_LOCK_PROFILING)
+    return LockProfiler::writeLock(&mRWLock);
+#else
     return -pthread_rwlock_wrlock(&mRWLock);
+#endif
 }
 inline status_t RWLock::tryWriteLock() {
     return -pthread_rwlock_trywrlock(&mRWLock);
 }
 inline void RWLock::unlock() {
+#if defined(ANDROID_UTILS_LOCK_PROFILING)
+    LockProfiler::unlock(&mRWLock);
+#else
     pthread_rwlock_unlock(&mRWLock);
+#endif
 }
 
 #endif // !defined(_WIN32)
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UTILS_SHARDED_LRU_CACHE_H
+#define ANDROID_UTILS_SHARDED_LRU_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "utils/LruCache.h"  // OnEntryRemoved
+#include "utils/TypeHelpers.h"  // hash_t
+
+namespace android {
+
+/**
+ * A thread-safe LRU cache, for caches that are hit from many threads at once.
+ *
+ * Keys are spread over independently locked shards by hash, so that threads looking up different
+ * keys rarely contend. Each shard evicts its own least recently used entries, so eviction order
+ * is only LRU within a shard, and each shard gets an equal part of the weight budget, rounded up.
+ *
+ * Each entry has a weight, 1 by default, and the cache evicts entries once their total weight
+ * exceeds maxWeight. Passing each entry's size in bytes makes a byte-bounded cache.
+ *
+ * The listener, if any, is called for each removed or evicted entry after the shard lock has been
+ * released, so it may call back into the cache. It may be called from any thread that modifies
+ * the cache.
+ *
+ * Entries are linked into their shard's LRU list and hash chains without separate allocations,
+ * and the nodes are recycled through a per-shard free list.
+ *
+ * TKey needs operator== and a hash_type() specialization, as for LruCache.
+ */
+template <typename TKey, typename TValue>
+class ShardedLruCache {
+  public:
+    static constexpr size_t kDefaultShardCount = 16;
+
+    // |shardCount| is rounded up to a power of two.
+    explicit ShardedLruCache(size_t maxWeight, size_t shardCount = kDefaultShardCount);
+    ~ShardedLruCache();
+
+    ShardedLruCache(const ShardedLruCache&) = delete;
+    ShardedLruCache& operator=(const ShardedLruCache&) = delete;
+
+    // Must be set before the cache is shared between threads.
+    void setOnEntryRemovedListener(OnEntryRemoved<TKey, TValue>* listener) { mListener = listener; }
+
+    // Copies the value for |key| into |*outValue| and marks it as most recently used. Returns
+    // false if |key| is not in the cache.
+    bool get(const TKey& key, TValue* outValue);
+
+    // Adds |key|, as LruCache::put() does, and returns false if it is already in the cache or
+    // weighs more than a shard may hold.
+    bool put(const TKey& key, const TValue& value, size_t weight = 1);
+
+    bool remove(const TKey& key);
+    void clear();
+
+    size_t size() const;
+    size_t weight() const;
+
+  private:
+    struct Node {
+        Node(const TKey& k, const TValue& v, hash_t h, size_t w)
+            : key(k), value(v), hash(h), weight(w) {}
+
+        TKey key;
+        TValue value;
+        hash_t hash;
+        size_t weight;
+        // LRU list, from oldest to youngest.
+        Node* older = nullptr;
+        Node* younger = nullptr;
+        // Hash chain.
+        Node* nextInBucket = nullptr;
+    };
+
+    // Hands out nodes from chunks, and keeps freed nodes to reuse them.
+    class NodePool {
+      public:
+        ~NodePool() {
+            for (void* chunk : mChunks) {
+                ::operator delete(chunk);
+            }
+        }
+
+        Node* allocate(const TKey& key, const TValue& value, hash_t hash, size_t weight) {
+            void* storage;
+            if (mFree != nullptr) {
+                storage = mFree;
+                mFree = mFree->next;
+            } else {
+                if (mNextInChunk == kChunkSize) {
+                    mChunks.push_back(::operator new(sizeof(Storage) * kChunkSize));
+                    mNextInChunk = 0;
+                }
+                storage = static_cast<Storage*>(mChunks.back()) + mNextInChunk++;
+            }
+            return new (storage) Node(key, value, hash, weight);
+        }
+
+        void free(Node* node) {
+            node->~Node();
+            Storage* storage = reinterpret_cast<Storage*>(node);
+            storage->next = mFree;
+            mFree = storage;
+        }
+
+      private:
+        static constexpr size_t kChunkSize = 64;
+
+        union Storage {
+            Storage* next;
+            alignas(Node) unsigned char node[sizeof(Node)];
+        };
+
+        std::vector<void*> mChunks;
+        size_t mNextInChunk = kChunkSize;
+        Storage* mFree = nullptr;
+    };
+
+    struct Removed {
+        TKey key;
+        TValue value;
+    };
+
+    // Aligned to keep shards that are locked by different threads off the same cache line.
+    struct alignas(64) Shard {
+        Node* find(const TKey& key, hash_t hash) const;
+        void insert(Node* node);
+        // Unlinks |node| from its bucket and the LRU list, and frees it.
+        void erase(Node* node, std::vector<Removed>* removed);
+        void attachYoungest(Node* node);
+        void detach(Node* node);
+
+        mutable std::mutex lock;
+        std::vector<Node*> buckets;
+        size_t count = 0;
+        size_t weight = 0;
+        Node* oldest = nullptr;
+        Node* youngest = nullptr;
+        NodePool pool;
+    };
+
+    // hash_type() is the identity for integers, so mix all of the bits into both ends of the hash
+    // before using them (this is the MurmurHash3 finalizer).
+    static hash_t mix(hash_t hash) {
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+        return hash;
+    }
+
+    // Buckets use the low bits of the mixed hash, so pick the shard from the high bits.
+    Shard& shardFor(hash_t mixed) { return mShards[(uint64_t(mixed) * mShardCount) >> 32]; }
+    void notify(std::vector<Removed>* removed);
+
+    std::unique_ptr<Shard[]> mShards;
+    size_t mShardCount;
+    size_t mMaxShardWeight;
+    OnEntryRemoved<TKey, TValue>* mListener;
+};
+
+// Implementation is here, because it's fully templated
+template <typename TKey, typename TValue>
+ShardedLruCache<TKey, TValue>::ShardedLruCache(size_t maxWeight, size_t shardCount)
+    : mShardCount(1), mListener(nullptr) {
+    while (mShardCount < shardCount) {
+        mShardCount *= 2;
+    }
+    mShards.reset(new Shard[mShardCount]);
+    mMaxShardWeight = (maxWeight + mShardCount - 1) / mShardCount;
+}
+
+template <typename TKey, typename TValue>
+ShardedLruCache<TKey, TValue>::~ShardedLruCache() {
+    clear();
+}
+
+template <typename TKey, typename TValue>
+bool ShardedLruCache<TKey, TValue>::get(const TKey& key, TValue* outValue) {
+    const hash_t hash = mix(hash_type(key));
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    Node* node = shard.find(key, hash);
+    if (node == nullptr) {
+        return false;
+    }
+    shard.detach(node);
+    shard.attachYoungest(node);
+    *outValue = node->value;
+    return true;
+}
+
+template <typename TKey, typename TValue>
+bool ShardedLruCache<TKey, TValue>::put(const TKey& key, const TValue& value, size_t weight) {
+    if (weight > mMaxShardWeight) {
+        return false;
+    }
+    const hash_t hash = mix(hash_type(key));
+    Shard& shard = shardFor(hash);
+    std::vector<Removed> evicted;
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        if (shard.find(key, hash) != nullptr) {
+            return false;
+        }
+        while (shard.weight + weight > mMaxShardWeight) {
+            shard.erase(shard.oldest, mListener ? &evicted : nullptr);
+        }
+        shard.insert(shard.pool.allocate(key, value, hash, weight));
+    }
+    notify(&evicted);
+    return true;
+}
+
+template <typename TKey, typename TValue>
+bool ShardedLruCache<TKey, TValue>::remove(const TKey& key) {
+    const hash_t hash = mix(hash_type(key));
+    Shard& shard = shardFor(hash);
+    std::vector<Removed> removed;
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        Node* node = shard.find(key, hash);
+        if (node == nullptr) {
+            return false;
+        }
+        shard.erase(node, mListener ? &removed : nullptr);
+    }
+    notify(&removed);
+    return true;
+}
+
+template <typename TKey, typename TValue>
+void ShardedLruCache<TKey, TValue>::clear() {
+    for (size_t i = 0; i < mShardCount; i++) {
+        Shard& shard = mShards[i];
+        std::vector<Removed> removed;
+        {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            while (shard.oldest != nullptr) {
+                shard.erase(shard.oldest, mListener ? &removed : nullptr);
+            }
+        }
+        notify(&removed);
+    }
+}
+
+template <typename TKey, typename TValue>
+size_t ShardedLruCache<TKey, TValue>::size() const {
+    size_t count = 0;
+    for (size_t i = 0; i < mShardCount; i++) {
+        std::lock_guard<std::mutex> guard(mShards[i].lock);
+        count += mShards[i].count;
+    }
+    return count;
+}
+
+template <typename TKey, typename TValue>
+size_t ShardedLruCache<TKey, TValue>::weight() const {
+    size_t weight = 0;
+    for (size_t i = 0; i < mShardCount; i++) {
+        std::lock_guard<std::mutex> guard(mShards[i].lock);
+        weight += mShards[i].weight;
+    }
+    return weight;
+}
+
+template <typename TKey, typename TValue>
+void ShardedLruCache<TKey, TValue>::notify(std::vector<Removed>* removed) {
+    if (mListener == nullptr) return;
+    for (Removed& entry : *removed) {
+        (*mListener)(entry.key, entry.value);
+    }
+}
+
+template <typename TKey, typename TValue>
+typename ShardedLruCache<TKey, TValue>::Node* ShardedLruCache<TKey, TValue>::Shard::find(
+        const TKey& key, hash_t hash) const {
+    if (buckets.empty()) return nullptr;
+    for (Node* node = buckets[hash & (buckets.size() - 1)]; node != nullptr;
+         node = node->nextInBucket) {
+        if (node->hash == hash && node->key == key) {
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+template <typename TKey, typename TValue>
+void ShardedLruCache<TKey, TValue>::Shard::insert(Node* node) {
+    if (count >= buckets.size()) {
+        // Keep the load factor at most 1.
+        std::vector<Node*> oldBuckets(buckets.empty() ? 16 : buckets.size() * 2, nullptr);
+        oldBuckets.swap(buckets);
+        for (Node* chain : oldBuckets) {
+            while (chain != nullptr) {
+                Node* next = chain->nextInBucket;
+                Node*& bucket = buckets[chain->hash & (buckets.size() - 1)];
+                chain->nextInBucket = bucket;
+                bucket = chain;
+                chain = next;
+            }
+        }
+    }
+    Node*& bucket = buckets[node->hash & (buckets.size() - 1)];
+    node->nextInBucket = bucket;
+    bucket = node;
+    attachYoungest(node);
+    count++;
+    weight += node->weight;
+}
+
+template <typename TKey, typename TValue>
+void ShardedLruCache<TKey, TValue>::Shard::erase(Node* node, std::vector<Removed>* removed) {
+    Node** link = &buckets[node->hash & (buckets.size() - 1)];
+    while (*link != node) {
+        link = &(*link)->nextInBucket;
+    }
+    *link = node->nextInBucket;
+    detach(node);
+    count--;
+    weight -= node->weight;
+    if (removed != nullptr) {
+        removed->push_back(Removed{std::move(node->key), std::move(node->value)});
+    }
+    pool.free(node);
+}
+
+template <typename TKey, typename TValue>
+void ShardedLruCache<TKey, TValue>::Shard::attachYoungest(Node* node) {
+    node->older = youngest;
+    node->younger = nullptr;
+    if (youngest != nullptr) {
+        youngest->younger = node;
+    } else {
+        oldest = node;
+    }
+    youngest = node;
+}
+
+template <typename TKey, typename TValue>
+void ShardedLruCache<TKey, TValue>::Shard::detach(Node* node) {
+    if (node->older != nullptr) {
+        node->older->younger = node->younger;
+    } else {
+        oldest = node->younger;
+    }
+    if (node->younger != nullptr) {
+        node->younger->older = node->older;
+    } else {
+        youngest = node->older;
+    }
+    node->older = nullptr;
+    node->younger = nullptr;
+}
+
+}  // namespace android
+
+#endif  // ANDROID_UTILS_SHARDED_LRU_CACHE_H
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <system/thread_defs.h>
+#include <utils/AndroidThreads.h>
+
+namespace android {
+
+/**
+ * Lets the owner of tasks stop the ones that have not started yet, and lets running tasks that
+ * poll it stop early. Copies share the same state.
+ */
+class CancellationToken {
+  public:
+    CancellationToken() : mCancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() { mCancelled->store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return mCancelled->load(std::memory_order_relaxed); }
+
+  private:
+    std::shared_ptr<std::atomic<bool>> mCancelled;
+};
+
+/**
+ * A fixed set of worker threads that run submitted tasks.
+ *
+ * Each worker has its own queue. Tasks submitted from a worker go to the front of that worker's
+ * queue, which keeps related work on one thread while its data is still in cache, and tasks
+ * submitted from other threads are spread over the workers. A worker whose queue is empty steals
+ * the oldest task from another worker's queue before going to sleep.
+ *
+ * Destroying the pool runs the tasks that have already been submitted, and then joins the
+ * workers. Cancel their tokens first to drop the ones that have not started.
+ */
+class ThreadPool {
+  public:
+    struct Options {
+        // Zero uses one worker per CPU.
+        size_t threadCount = 0;
+        // Workers are named "<name>:<index>".
+        const char* name = "ThreadPool";
+        // One of the ANDROID_PRIORITY constants, applied to each worker on Android.
+        int priority = ANDROID_PRIORITY_DEFAULT;
+        // Called on each worker before it runs any task, with the worker's index. Use this to
+        // apply task profiles or other per-thread settings.
+        std::function<void(size_t)> onWorkerStart;
+    };
+
+    ThreadPool() : ThreadPool(Options()) {}
+    explicit ThreadPool(Options options);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t threadCount() const { return mWorkers.size(); }
+
+    /**
+     * Queues |f| to run on a worker, and returns a future for its result.
+     */
+    template <typename F>
+    std::future<std::invoke_result_t<std::decay_t<F>>> submit(F&& f);
+
+    /**
+     * Same as above, but |f| is not run if |token| is cancelled before a worker gets to it. The
+     * future then holds std::nullopt, or false for a task that returns void.
+     */
+    template <typename F>
+    auto submit(const CancellationToken& token, F&& f);
+
+    /**
+     * Blocks until every submitted task, including ones submitted while waiting, has finished.
+     * Must not be called from a task.
+     */
+    void waitForIdle();
+
+  private:
+    class Task {
+      public:
+        virtual ~Task() {}
+        virtual void run() = 0;
+    };
+
+    template <typename F>
+    class TaskImpl : public Task {
+      public:
+        explicit TaskImpl(F&& f) : mF(std::move(f)) {}
+        void run() override { mF(); }
+
+      private:
+        F mF;
+    };
+
+    struct Worker {
+        std::mutex lock;
+        std::deque<std::unique_ptr<Task>> tasks;
+        std::thread thread;
+    };
+
+    template <typename F>
+    void enqueue(F&& f);
+    std::unique_ptr<Task> takeTask(size_t self);
+    void workerLoop(size_t self);
+
+    // The pool whose worker is the calling thread, if any, and that worker's index.
+    static ThreadPool*& currentPool() {
+        static thread_local ThreadPool* pool = nullptr;
+        return pool;
+    }
+    static size_t& currentWorker() {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::atomic<size_t> mNextWorker{0};
+    // Tasks in the queues, for waking workers.
+    std::atomic<size_t> mQueued{0};
+
+    std::mutex mLock;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mIdle;
+    // Tasks queued or running, guarded by mLock.
+    size_t mPending = 0;
+    bool mStopping = false;
+};
+
+// Implementation is here, because it's mostly templated
+inline ThreadPool::ThreadPool(Options options) {
+    size_t count = options.threadCount;
+    if (count == 0) {
+        count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < count; i++) {
+        mWorkers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < count; i++) {
+        mWorkers[i]->thread = std::thread([this, i, options] {
+            char name[64];
+            snprintf(name, sizeof(name), "%s:%zu", options.name, i);
+            androidSetThreadName(name);
+#if defined(__ANDROID__)
+            androidSetThreadPriority(0, options.priority);
+#endif
+            if (options.onWorkerStart) {
+                options.onWorkerStart(i);
+            }
+            workerLoop(i);
+        });
+    }
+}
+
+inline ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mStopping = true;
+    }
+    mWorkAvailable.notify_all();
+    for (auto& worker : mWorkers) {
+        worker->thread.join();
+    }
+}
+
+template <typename F>
+std::future<std::invoke_result_t<std::decay_t<F>>> ThreadPool::submit(F&& f) {
+    using R = std::invoke_result_t<std::decay_t<F>>;
+    std::promise<R> promise;
+    std::future<R> future = promise.get_future();
+    enqueue([promise = std::move(promise), f = std::forward<F>(f)]() mutable {
+        if constexpr (std::is_void_v<R>) {
+            f();
+            promise.set_value();
+        } else {
+            promise.set_value(f());
+        }
+    });
+    return future;
+}
+
+template <typename F>
+auto ThreadPool::submit(const CancellationToken& token, F&& f) {
+    using R = std::invoke_result_t<std::decay_t<F>>;
+    using Result = std::conditional_t<std::is_void_v<R>, bool, std::optional<R>>;
+    std::promise<Result> promise;
+    std::future<Result> future = promise.get_future();
+    enqueue([promise = std::move(promise), token, f = std::forward<F>(f)]() mutable {
+        if (token.isCancelled()) {
+            if constexpr (std::is_void_v<R>) {
+                promise.set_value(false);
+            } else {
+                promise.set_value(std::nullopt);
+            }
+        } else if constexpr (std::is_void_v<R>) {
+            f();
+            promise.set_value(true);
+        } else {
+            promise.set_value(f());
+        }
+    });
+    return future;
+}
+
+template <typename F>
+void ThreadPool::enqueue(F&& f) {
+    auto task = std::make_unique<TaskImpl<std::decay_t<F>>>(std::forward<F>(f));
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mPending++;
+    }
+
+    if (currentPool() == this) {
+        Worker& worker = *mWorkers[currentWorker()];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.tasks.push_front(std::move(task));
+    } else {
+        size_t index = mNextWorker.fetch_add(1, std::memory_order_relaxed) % mWorkers.size();
+        Worker& worker = *mWorkers[index];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.tasks.push_back(std::move(task));
+    }
+    mQueued.fetch_add(1, std::memory_order_release);
+
+    // Taking the lock orders this with a worker that is about to sleep.
+    { std::lock_guard<std::mutex> guard(mLock); }
+    mWorkAvailable.notify_one();
+}
+
+inline std::unique_ptr<ThreadPool::Task> ThreadPool::takeTask(size_t self) {
+    const size_t count = mWorkers.size();
+    for (size_t i = 0; i < count; i++) {
+        Worker& worker = *mWorkers[(self + i) % count];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (worker.tasks.empty()) continue;
+
+        std::unique_ptr<Task> task;
+        if (i == 0) {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        } else {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+        mQueued.fetch_sub(1, std::memory_order_relaxed);
+        return task;
+    }
+    return nullptr;
+}
+
+inline void ThreadPool::workerLoop(size_t self) {
+    currentPool() = this;
+    currentWorker() = self;
+
+    while (true) {
+        std::unique_ptr<Task> task = takeTask(self);
+        if (task != nullptr) {
+            task->run();
+            task.reset();
+
+            std::lock_guard<std::mutex> guard(mLock);
+            if (--mPending == 0) {
+                mIdle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mLock);
+        mWorkAvailable.wait(lock, [this] {
+            return mQueued.load(std::memory_order_acquire) != 0 || mStopping;
+        });
+        if (mStopping && mQueued.load(std::memory_order_acquire) == 0) {
+            break;
+        }
+    }
+
+    currentPool() = nullptr;
+}
+
+inline void ThreadPool::waitForIdle() {
+    std::unique_lock<std::mutex> lock(mLock);
+    mIdle.wait(lock, [this] { return mPending == 0; });
+}
+
+}  // namespace android
@@ -18,10 +18,17 @@
 #define _UTILS_TOKENIZER_H
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 #include <utils/Errors.h>
 #include <utils/FileMap.h>
 #include <utils/String8.h>
 
+#if __has_include(<string_view>)
+#include <string_view>
+#define HAS_STRING_VIEW
+#endif
+
 namespace android {
 
 /**
@@ -88,6 +95,16 @@ public:
      */
     String8 peekRemainderOfLine() const;
 
+#ifdef HAS_STRING_VIEW
+    /**
+     * Like peekRemainderOfLine(), but returns a view into the contents instead of a copy.
+     * The view is valid for as long as the tokenizer.
+     */
+    inline std::string_view peekRemainderOfLineView() const {
+        return std::string_view(mCurrent, findEol(mCurrent) - mCurrent);
+    }
+#endif
+
     /**
      * Gets the character at the current position and advances past it.
      * Returns null at end of file.
@@ -103,6 +120,18 @@ public:
      */
     String8 nextToken(const char* delimiters);
 
+#ifdef HAS_STRING_VIEW
+    /**
+     * Like nextToken(), but returns a view into the contents instead of a copy, so that
+     * tokenizing doesn't allocate. The view is valid for as long as the tokenizer.
+     */
+    inline std::string_view nextTokenView(const char* delimiters) {
+        const char* tokenStart = mCurrent;
+        mCurrent = DelimiterSet(delimiters).find(mCurrent, getEnd());
+        return std::string_view(tokenStart, mCurrent - tokenStart);
+    }
+#endif
+
     /**
      * Advances to the next line.
      * Does nothing if already at the end of the file.
@@ -116,6 +145,52 @@ public:
     void skipDelimiters(const char* delimiters);
 
 private:
+    /*
+     * The delimiters of a call as a bitmap, along with the newline and null characters that
+     * always end a token, so that each character is checked with a single lookup rather than
+     * with a strchr() over the delimiters.
+     */
+    class DelimiterSet {
+    public:
+        inline explicit DelimiterSet(const char* delimiters) : mBits() {
+            add('\n');
+            add('\0');
+            for (; *delimiters; delimiters++) {
+                add(*delimiters);
+            }
+        }
+
+        inline bool contains(char ch) const {
+            uint8_t c = static_cast<uint8_t>(ch);
+            return (mBits[c >> 6] >> (c & 63)) & 1;
+        }
+
+        // Returns the first delimiter in [begin, end), or end.
+        inline const char* find(const char* begin, const char* end) const {
+            while (begin != end && !contains(*begin)) {
+                begin++;
+            }
+            return begin;
+        }
+
+        // Returns the first character in [begin, end) that isn't a delimiter or is a newline,
+        // or end.
+        inline const char* skip(const char* begin, const char* end) const {
+            while (begin != end && *begin != '\n' && contains(*begin)) {
+                begin++;
+            }
+            return begin;
+        }
+
+    private:
+        inline void add(char ch) {
+            uint8_t c = static_cast<uint8_t>(ch);
+            mBits[c >> 6] |= uint64_t(1) << (c & 63);
+        }
+
+        uint64_t mBits[4];
+    };
+
     Tokenizer(const Tokenizer& other); // not copyable
 
     String8 mFilename;
@@ -129,8 +204,19 @@ private:
 
     inline const char* getEnd() const { return mBuffer + mLength; }
 
+    // Returns the newline that ends the line at p, or the end of the contents.
+    inline const char* findEol(const char* p) const {
+        if (p == getEnd()) {
+            return p;
+        }
+        const void* eol = memchr(p, '\n', getEnd() - p);
+        return eol ? static_cast<const char*>(eol) : getEnd();
+    }
+
 };
 
 } // namespace android
 
+#undef HAS_STRING_VIEW
+
 #endif // _UTILS_TOKENIZER_H
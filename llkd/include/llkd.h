@@ -49,6 +49,10 @@ unsigned llkCheckMilliseconds(void);
 #define LLK_CHECK_MS_PROPERTY           "ro.llk.check_ms"
 /* LLK_CHECK_MS_DEFAULT = actual timeout_ms / LLK_CHECKS_PER_TIMEOUT_DEFAULT */
 #define LLK_CHECKS_PER_TIMEOUT_DEFAULT  5
+#define LLK_PSI_PROPERTY                "ro.llk.psi"
+#define LLK_PSI_DEFAULT                 false
+#define LLK_PSI_CHECK_MS_PROPERTY       "ro.llk.psi.check_ms"
+/* LLK_PSI_CHECK_MS_DEFAULT = actual timeout_ms / 2 */
 #define LLK_CHECK_STACK_PROPERTY        "ro.llk.stack"
 #define LLK_CHECK_STACK_DEFAULT         \
     "cma_alloc,__get_user_pages,bit_wait_io,wait_on_page_bit_killable"
@@ -75,6 +79,7 @@ __BEGIN_DECLS
 bool llkInit(const char* threadname = nullptr);
 __END_DECLS
 std::chrono::milliseconds llkCheck(bool checkRunning = false);
+void llkSleep(std::chrono::milliseconds timeout);
 
 /* clang-format off */
 #define LLK_TIMEOUT_MS_DEFAULT  std::chrono::duration_cast<milliseconds>(std::chrono::minutes(10))
@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <poll.h>
 #include <pwd.h>  // getpwuid()
 #include <signal.h>
 #include <stdint.h>
@@ -37,6 +38,7 @@
 
 #include <chrono>
 #include <ios>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <unordered_map>
@@ -48,6 +50,7 @@
 #include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <cutils/android_get_control_file.h>
 #include <log/log_main.h>
 
@@ -86,6 +89,9 @@ enum {                                               // enum of state indexes
 milliseconds llkStateTimeoutMs[llkNumStates];        // timeout override for each detection state
 milliseconds llkCheckMs;                             // checking interval to inspect any
                                                      // persistent live-locked states
+bool llkPsiEnable = LLK_PSI_DEFAULT;                 // pressure event driven checks
+milliseconds llkPsiCheckMs;                          // idle checking interval when
+                                                     // pressure event driven
 bool llkLowRam;                                      // ro.config.low_ram
 bool llkEnableSysrqT = LLK_ENABLE_SYSRQ_T_DEFAULT;   // sysrq stack trace dump
 bool khtEnable = LLK_ENABLE_DEFAULT;                 // [khungtaskd] panic
@@ -177,6 +183,8 @@ class dir {
 
     operator bool() const { return fd >= 0; }
 
+    int get() const { return fd; }
+
     void reset(void) {
         if (fd >= 0) {
             ::close(fd);
@@ -233,6 +241,30 @@ std::string ReadFile(std::string&& path) {
     return content;
 }
 
+// Read the head of /proc/<tid>/<node> into a caller supplied buffer relative
+// to an already open /proc directory, saving the path walk and the string
+// churn of ReadFile() for the per-thread, per-cycle hot path.  The content is
+// always nul terminated, returning false on error or if empty.
+bool ReadProcFileAt(int dirfd, const char* tid, const char* node, char* buf, size_t len) {
+    if (__predict_false(dirfd < 0) || __predict_false(len == 0)) return false;
+    char path[32];
+    auto rc = ::snprintf(path, sizeof(path), "%s%s", tid, node);
+    if (__predict_false((rc <= 0) || (size_t(rc) >= sizeof(path)))) return false;
+    android::base::unique_fd fd(::openat(dirfd, path, O_CLOEXEC | O_RDONLY));
+    if (fd < 0) {
+        PLOG(DEBUG) << "Read " << procdir << path << " failed";
+        return false;
+    }
+    auto size = TEMP_FAILURE_RETRY(::read(fd, buf, len - 1));
+    if (size <= 0) {
+        PLOG(DEBUG) << "Read " << procdir << path << " failed";
+        buf[0] = '\0';
+        return false;
+    }
+    buf[size] = '\0';
+    return true;
+}
+
 std::string llkProcGetName(pid_t tid, const char* node = "/cmdline") {
     std::string content = ReadFile(procdir + std::to_string(tid) + node);
     static constexpr char needles[] = " \t\r\n";  // including trailing nul
@@ -396,6 +428,10 @@ struct proc {
 
 std::unordered_map<pid_t, proc> tids;
 
+// Recycled tids nodes, saves allocator churn as threads come and go.
+std::vector<decltype(tids)::node_type> tidsPool;
+constexpr size_t tidsPoolMax = 256;
+
 // Check range and setup defaults, in order of propagation:
 //     llkTimeoutMs
 //     llkCheckMs
@@ -422,12 +458,46 @@ void llkValidate() {
     }
 
     llkCheckMs = std::max(llkCheckMs, LLK_CHECK_MS_MINIMUM);
+    if (llkPsiCheckMs == 0ms) {
+        llkPsiCheckMs = llkTimeoutMs / 2;
+    }
+    llkPsiCheckMs = std::min(std::max(llkPsiCheckMs, llkCheckMs), llkTimeoutMs);
     if (llkCycle == 0ms) {
         llkCycle = llkCheckMs;
     }
     llkCycle = std::min(llkCycle, llkCheckMs);
 }
 
+// Pressure stall triggers.  A livelock blocking on I/O or memory reclaim
+// shows up as pressure well before any of our timeouts expire, so when
+// nothing is suspect we can sample at the relaxed llkPsiCheckMs interval
+// and let a trigger wake us up early.  The window is a multiple of 2s as
+// required for unprivileged triggers.
+constexpr const char* llkPsiResources[] = {"/proc/pressure/io", "/proc/pressure/memory"};
+constexpr char llkPsiTrigger[] = "some 200000 2000000";
+std::vector<android::base::unique_fd> llkPsiFds;
+bool llkPsiPending;  // trigger fired since the last check
+
+void llkPsiInit() {
+    for (auto resource : llkPsiResources) {
+        android::base::unique_fd fd(::open(resource, O_RDWR | O_NONBLOCK | O_CLOEXEC));
+        if (fd < 0) {
+            PLOG(WARNING) << "open " << resource << " failed";
+            continue;
+        }
+        // kernel expects the trigger to be nul terminated
+        if (TEMP_FAILURE_RETRY(::write(fd, llkPsiTrigger, sizeof(llkPsiTrigger))) !=
+            sizeof(llkPsiTrigger)) {
+            PLOG(WARNING) << "write " << resource << " trigger failed";
+            continue;
+        }
+        llkPsiFds.emplace_back(std::move(fd));
+    }
+    if (llkPsiFds.empty()) {
+        LOG(WARNING) << "no pressure triggers, falling back to " << LLK_CHECK_MS_PROPERTY;
+    }
+}
+
 milliseconds llkGetTimespecDiffMs(timespec* from, timespec* to) {
     return duration_cast<milliseconds>(seconds(to->tv_sec - from->tv_sec)) +
            duration_cast<milliseconds>(nanoseconds(to->tv_nsec - from->tv_nsec));
@@ -595,14 +665,27 @@ proc* llkTidLookup(pid_t tid) {
     return &search->second;
 }
 
+void llkTidRecycle(decltype(tids)::node_type&& node) {
+    if (node && (tidsPool.size() < tidsPoolMax)) tidsPool.emplace_back(std::move(node));
+}
+
 void llkTidRemove(pid_t tid) {
-    tids.erase(tid);
+    llkTidRecycle(tids.extract(tid));
 }
 
 proc* llkTidAlloc(pid_t tid, pid_t pid, pid_t ppid, const char* comm, int time, char state,
                   bool frozen) {
-    auto it = tids.emplace(std::make_pair(tid, proc(tid, pid, ppid, comm, time, state, frozen)));
-    return &it.first->second;
+    if (tidsPool.empty()) {
+        auto it =
+            tids.emplace(std::make_pair(tid, proc(tid, pid, ppid, comm, time, state, frozen)));
+        return &it.first->second;
+    }
+    auto node = std::move(tidsPool.back());
+    tidsPool.pop_back();
+    node.key() = tid;
+    node.mapped() = proc(tid, pid, ppid, comm, time, state, frozen);
+    auto it = tids.insert(std::move(node));
+    return &it.position->second;
 }
 
 std::string llkFormat(milliseconds ms) {
@@ -915,6 +998,8 @@ void llkLogConfig(void) {
               << "\n"
 #endif
               << LLK_CHECK_MS_PROPERTY "=" << llkFormat(llkCheckMs) << "\n"
+              << LLK_PSI_PROPERTY "=" << llkFormat(llkPsiEnable) << "\n"
+              << LLK_PSI_CHECK_MS_PROPERTY "=" << llkFormat(llkPsiCheckMs) << "\n"
 #ifdef __PTRACE_ENABLED__
               << LLK_CHECK_STACK_PROPERTY "=" << llkFormat(llkCheckStackSymbols) << "\n"
               << LLK_IGNORELIST_STACK_PROPERTY "=" << llkFormat(llkIgnorelistStack) << "\n"
@@ -943,7 +1028,7 @@ void* llkThread(void* obj) {
     llkRunning = true;
     llkLogConfig();
     while (llkRunning) {
-        ::usleep(duration_cast<microseconds>(llkCheck(true)).count());
+        llkSleep(llkCheck(true));
     }
     // NOTREACHED
     LOG(INFO) << "exiting";
@@ -971,8 +1056,17 @@ milliseconds llkCheck(bool checkRunning) {
     ::clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
     auto ms = llkGetTimespecDiffMs(&last, &now);
     if (ms < llkCycle) {
-        return llkCycle - ms;
+        if (!llkPsiPending) {
+            return llkCycle - ms;
+        }
+        // Woken early by a pressure trigger, but still rate limited.
+        if (ms < LLK_CHECK_MS_MINIMUM) {
+            return LLK_CHECK_MS_MINIMUM - ms;
+        }
+        // The state durations accumulate llkCycle, account actual time.
+        llkCycle = ms;
     }
+    llkPsiPending = false;
     last = now;
 
     LOG(VERBOSE) << "opendir(\"" << procdir << "\")";
@@ -999,6 +1093,7 @@ milliseconds llkCheck(bool checkRunning) {
     auto myPid = ::getpid();
     auto myTid = ::gettid();
     auto dump = true;
+    auto suspect = false;
     for (auto dp = llkTopDirectory.read(); dp != nullptr; dp = llkTopDirectory.read()) {
         std::string piddir;
 
@@ -1020,9 +1115,11 @@ milliseconds llkCheck(bool checkRunning) {
                 continue;
             }
 
-            // Get the process stat
-            std::string stat = ReadFile(piddir + "/stat");
-            if (stat.empty()) {
+            // Get the process stat, only the fields up to stime are of
+            // interest so a truncated read is fine.
+            char stat[512];
+            if (!ReadProcFileAt(llkTopDirectory.get(), tp->d_name, "/stat", stat,
+                                sizeof(stat))) {
                 continue;
             }
             unsigned tid = -1;
@@ -1035,7 +1132,7 @@ milliseconds llkCheck(bool checkRunning) {
             pdir[0] = '\0';
             // tid should not change value
             auto match = ::sscanf(
-                stat.c_str(),
+                stat,
                 "%u (%" ___STRING(
                     TASK_COMM_LEN) "[^)]) %c %u %*d %*d %*d %*d %*d %*d %*d %*d %*d %u %u %d",
                 &tid, pdir, &state, &ppid, &utime, &stime, &dummy);
@@ -1048,18 +1145,12 @@ milliseconds llkCheck(bool checkRunning) {
                 continue;
             }
 
-            // Get the process cgroup
-            auto cgroup = ReadFile(piddir + "/cgroup");
-            auto frozen = cgroup.find(":freezer:/frozen") != std::string::npos;
-
             auto procp = llkTidLookup(tid);
             if (procp == nullptr) {
-                procp = llkTidAlloc(tid, pid, ppid, pdir, utime + stime, state, frozen);
+                procp = llkTidAlloc(tid, pid, ppid, pdir, utime + stime, state, false);
             } else {
                 // comm can change ...
                 procp->setComm(pdir);
-                // frozen can change, too...
-                procp->setFrozen(frozen);
                 procp->updated = true;
                 // pid/ppid/tid wrap?
                 if (((procp->update != prevUpdate) && (procp->update != llkUpdate)) ||
@@ -1099,6 +1190,11 @@ milliseconds llkCheck(bool checkRunning) {
             if ((tid == myTid) || llkSkipPid(tid)) {
                 continue;
             }
+
+            // Get the process cgroup, deferred until here as the bulk of
+            // threads are not in a monitored state. frozen can change, too...
+            procp->setFrozen(ReadFile(piddir + "/cgroup").find(":freezer:/frozen") !=
+                             std::string::npos);
             if (procp->isFrozen()) {
                 break;
             }
@@ -1137,6 +1233,11 @@ milliseconds llkCheck(bool checkRunning) {
 
 #ifdef __PTRACE_ENABLED__
             auto stuck = llkCheckStack(procp, piddir);
+            if (procp->stack != char(-1)) suspect = true;
+#endif
+            // Candidate, keep sampling at llkCheckMs until it resolves.
+            if (llkIsMonitorState(state)) suspect = true;
+#ifdef __PTRACE_ENABLED__
             if (llkIsMonitorState(state)) {
                 if (procp->count >= llkStateTimeoutMs[(state == 'Z') ? llkStateZ : llkStateD]) {
                     stuck = true;
@@ -1246,7 +1347,9 @@ milliseconds llkCheck(bool checkRunning) {
                 LOG(VERBOSE) << "thread " << p->second.ppid << ppidCmdline << "->" << p->second.pid
                              << pidCmdline << "->" << p->second.tid << tidCmdline << " removed";
             }
-            p = tids.erase(p);
+            auto next = std::next(p);
+            llkTidRecycle(tids.extract(p));
+            p = next;
         } else {
             ++p;
         }
@@ -1255,7 +1358,7 @@ milliseconds llkCheck(bool checkRunning) {
         llkTopDirectory.reset();
     }
 
-    llkCycle = llkCheckMs;
+    llkCycle = (!llkPsiFds.empty() && !suspect) ? llkPsiCheckMs : llkCheckMs;
 
     timespec end;
     ::clock_gettime(CLOCK_MONOTONIC_COARSE, &end);
@@ -1269,6 +1372,31 @@ milliseconds llkCheck(bool checkRunning) {
     return llkCycle - ms;
 }
 
+void llkSleep(milliseconds timeout) {
+    if (llkPsiFds.empty() || llkPsiPending) {
+        ::usleep(duration_cast<microseconds>(timeout).count());
+        return;
+    }
+    pollfd fds[ARRAY_SIZE(llkPsiResources)];
+    nfds_t nfds = 0;
+    for (auto& fd : llkPsiFds) {
+        fds[nfds++] = {.fd = fd.get(), .events = POLLPRI, .revents = 0};
+    }
+    auto ms = std::min(timeout, milliseconds(std::numeric_limits<int>::max()));
+    // EINTR from our own watchdog alarm is as good as a timeout.
+    if (::poll(fds, nfds, ms.count()) <= 0) return;
+    for (nfds_t i = nfds; i-- > 0;) {
+        if (fds[i].revents & POLLERR) {
+            // trigger destroyed, do not spin on it.
+            LOG(WARNING) << "pressure trigger lost";
+            llkPsiFds.erase(llkPsiFds.begin() + i);
+        } else if (fds[i].revents & POLLPRI) {
+            LOG(VERBOSE) << "pressure trigger";
+            llkPsiPending = true;
+        }
+    }
+}
+
 unsigned llkCheckMilliseconds() {
     return duration_cast<milliseconds>(llkCheck()).count();
 }
@@ -1315,7 +1443,12 @@ bool llkInit(const char* threadname) {
     llkStateTimeoutMs[llkStateStack] = GetUintProperty(LLK_STACK_TIMEOUT_MS_PROPERTY, llkTimeoutMs);
 #endif
     llkCheckMs = GetUintProperty(LLK_CHECK_MS_PROPERTY, llkCheckMs);
+    llkPsiCheckMs = GetUintProperty(LLK_PSI_CHECK_MS_PROPERTY, llkPsiCheckMs);
     llkValidate();  // validate all (effectively minus llkTimeoutMs)
+    llkPsiEnable = android::base::GetBoolProperty(LLK_PSI_PROPERTY, llkPsiEnable);
+    if (llkEnable && llkPsiEnable) {
+        llkPsiInit();
+    }
 #ifdef __PTRACE_ENABLED__
     if (debuggable) {
         llkCheckStackSymbols = llkSplit(LLK_CHECK_STACK_PROPERTY, LLK_CHECK_STACK_DEFAULT);
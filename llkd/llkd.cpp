@@ -41,7 +41,7 @@ int main(int, char**) {
 
     while (true) {
         if (enabled) {
-            ::usleep(duration_cast<microseconds>(llkCheck()).count());
+            llkSleep(llkCheck());
         } else {
             ::pause();
         }
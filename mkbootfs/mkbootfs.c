@@ -30,44 +30,57 @@
 struct fs_config_entry {
     char* name;
     int uid, gid, mode;
+    int order;
 };
 
+// Sorted by name, one entry per name, so that lookups are a binary search
+// rather than a scan of the whole file for every archived path.
 static struct fs_config_entry* canned_config = NULL;
+static int canned_config_count = 0;
+static struct fs_config_entry* canned_default = NULL;
 static const char* target_out_path = NULL;
 
 #define TRAILER "TRAILER!!!"
 
 static int total_size = 0;
 
+static int compare_canned_name(const void* key, const void* entry) {
+    return strcmp((const char*)key, ((const struct fs_config_entry*)entry)->name);
+}
+
 static void fix_stat(const char *path, struct stat *s)
 {
-    uint64_t capabilities;
     if (canned_config) {
         // Use the list of file uid/gid/modes loaded from the file
         // given with -f.
 
-        struct fs_config_entry* empty_path_config = NULL;
-        struct fs_config_entry* p;
-        for (p = canned_config; p->name; ++p) {
-            if (!p->name[0]) {
-                empty_path_config = p;
-            }
-            if (strcmp(p->name, path) == 0) {
-                s->st_uid = p->uid;
-                s->st_gid = p->gid;
-                s->st_mode = p->mode | (s->st_mode & ~07777);
-                return;
-            }
+        struct fs_config_entry* p = bsearch(path, canned_config, canned_config_count,
+                                            sizeof(*canned_config), compare_canned_name);
+        if (p == NULL) {
+            if (canned_default == NULL) errx(1, "no canned config for '%s'", path);
+            p = canned_default;
         }
-        s->st_uid = empty_path_config->uid;
-        s->st_gid = empty_path_config->gid;
-        s->st_mode = empty_path_config->mode | (s->st_mode & ~07777);
+        s->st_uid = p->uid;
+        s->st_gid = p->gid;
+        s->st_mode = p->mode | (s->st_mode & ~07777);
     } else {
-        // Use the compiled-in fs_config() function.
-        unsigned st_mode = s->st_mode;
+        // Use the compiled-in fs_config() rules. The context reads the
+        // config files under target_out_path once rather than per file.
+        static struct fs_config_context* ctx = NULL;
+        struct fs_config conf;
         int is_dir = S_ISDIR(s->st_mode) || strcmp(path, TRAILER) == 0;
-        fs_config(path, is_dir, target_out_path, &s->st_uid, &s->st_gid, &st_mode, &capabilities);
-        s->st_mode = (typeof(s->st_mode)) st_mode;
+        if (!ctx) {
+            ctx = fs_config_context_create(target_out_path);
+        }
+        if (fs_config_context_get(ctx, path, is_dir, &conf)) {
+            s->st_uid = conf.uid;
+            s->st_gid = conf.gid;
+            s->st_mode = conf.mode | (s->st_mode & S_IFMT);
+        } else {
+            s->st_uid = AID_ROOT;
+            s->st_gid = AID_ROOT;
+            s->st_mode = (is_dir ? 0755 : 0644) | (s->st_mode & S_IFMT);
+        }
     }
 
     if (S_ISREG(s->st_mode) || S_ISDIR(s->st_mode) || S_ISLNK(s->st_mode)) {
@@ -252,6 +265,41 @@ static void archive(const char* start, const char* prefix) {
     _archive_dir(in, out, strlen(in), strlen(out));
 }
 
+static int compare_canned_entries(const void* a, const void* b) {
+    const struct fs_config_entry* ea = a;
+    const struct fs_config_entry* eb = b;
+    int rc = strcmp(ea->name, eb->name);
+    return rc != 0 ? rc : ea->order - eb->order;
+}
+
+static void index_canned_config(int used)
+{
+    int i, unique;
+
+    // The last entry with an empty path is the default for unlisted files.
+    for (i = 0; i < used; ++i) {
+        if (!canned_config[i].name[0]) canned_default = &canned_config[i];
+    }
+    if (canned_default) {
+        struct fs_config_entry* d = malloc(sizeof(*d));
+        if (d == NULL) errx(1, "failed to allocate memory");
+        *d = *canned_default;
+        canned_default = d;
+    }
+
+    // Sort by name and keep only the first entry for each name, which is
+    // the one a linear scan would have found.
+    qsort(canned_config, used, sizeof(*canned_config), compare_canned_entries);
+    unique = 0;
+    for (i = 0; i < used; ++i) {
+        if (unique > 0 && !strcmp(canned_config[unique - 1].name, canned_config[i].name)) {
+            continue;
+        }
+        canned_config[unique++] = canned_config[i];
+    }
+    canned_config_count = unique;
+}
+
 static void read_canned_config(char* filename)
 {
     int allocated = 8;
@@ -285,6 +333,7 @@ static void read_canned_config(char* filename)
         }
         cc->gid = atoi(strtok(NULL, " \n"));
         cc->mode = strtol(strtok(NULL, " \n"), NULL, 8);
+        cc->order = used;
         ++used;
     }
     if (used >= allocated) {
@@ -294,6 +343,7 @@ static void read_canned_config(char* filename)
         if (canned_config == NULL) errx(1, "failed to reallocate memory");
     }
     canned_config[used].name = NULL;
+    index_canned_config(used);
 
     free(line);
     fclose(fp);
@@ -422,6 +472,11 @@ int main(int argc, char *argv[])
 {
     int opt, unused;
 
+    // The archive is written with many small printf()/putchar() calls; a
+    // large buffer turns them into a few big writes to the output pipe.
+    static char stdout_buf[1024 * 1024];
+    setvbuf(stdout, stdout_buf, _IOFBF, sizeof(stdout_buf));
+
     while ((opt = getopt_long(argc, argv, "hd:f:n:", long_options, &unused)) != -1) {
         switch (opt) {
         case 'd':
@@ -65,8 +65,22 @@ struct PropertyInfoAreaHeader {
   uint32_t contexts_offset;
   uint32_t types_offset;
   uint32_t root_offset;
+  // Only present from version 2 on. Points to a hash table of the children of the root node:
+  // a uint32_t count of buckets, which is a power of 2, followed by the buckets, each holding
+  // either 0 for an empty bucket or 1 + the index of a child, probed linearly from
+  // PropertyNameHash(child name) modulo the count.
+  uint32_t root_children_table_offset;
 };
 
+// FNV-1a hash of a '.' separated piece of a property name, for root_children_table_offset.
+inline uint32_t PropertyNameHash(const char* name, uint32_t namelen) {
+  uint32_t hash = 2166136261u;
+  for (uint32_t i = 0; i < namelen; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(name[i])) * 16777619u;
+  }
+  return hash;
+}
+
 class SerializedData {
  public:
   uint32_t size() const {
@@ -103,6 +117,7 @@ class TrieNode {
   const char* name() const {
     return serialized_data_->c_string(node_property_entry()->name_offset);
   }
+  uint32_t namelen() const { return node_property_entry()->namelen; }
 
   uint32_t context_index() const { return node_property_entry()->context_index; }
   uint32_t type_index() const { return node_property_entry()->type_index; }
@@ -176,6 +191,7 @@ class PropertyInfoArea : private SerializedData {
  private:
   void CheckPrefixMatch(const char* remaining_name, const TrieNode& trie_node,
                         uint32_t* context_index, uint32_t* type_index) const;
+  bool FindRootChildForString(const char* name, uint32_t namelen, TrieNode* child) const;
 
   const PropertyInfoAreaHeader* header() const {
     return reinterpret_cast<const PropertyInfoAreaHeader*>(data_base());
@@ -184,6 +200,9 @@ class PropertyInfoArea : private SerializedData {
   uint32_t contexts_array_offset() const { return contexts_offset() + sizeof(uint32_t); }
   uint32_t types_offset() const { return header()->types_offset; }
   uint32_t types_array_offset() const { return types_offset() + sizeof(uint32_t); }
+  uint32_t root_children_table_offset() const {
+    return current_version() >= 2 ? header()->root_children_table_offset : 0;
+  }
 
   TrieNode trie(uint32_t offset) const {
     if (offset != 0 && offset > size()) return TrieNode();
@@ -69,14 +69,13 @@ int PropertyInfoArea::FindTypeIndex(const char* type) const {
 // Used to traverse the Trie in GetPropertyInfoIndexes().
 bool TrieNode::FindChildForString(const char* name, uint32_t namelen, TrieNode* child) const {
   auto node_index = Find(trie_node_base_->num_child_nodes, [this, name, namelen](auto array_offset) {
-    const char* child_name = child_node(array_offset).name();
-    int cmp = strncmp(child_name, name, namelen);
-    if (cmp == 0 && child_name[namelen] != '\0') {
-      // We use strncmp() since name isn't null terminated, but we don't want to match only a
-      // prefix of a child node's name, so we check here if we did only match a prefix and
-      // return 1, to indicate to the binary search to search earlier in the array for the real
-      // match.
-      return 1;
+    auto candidate = child_node(array_offset);
+    uint32_t child_namelen = candidate.namelen();
+    // Compare with memcmp() over the known lengths rather than strncmp(), which has to look for
+    // the terminator. If only a prefix of the longer name matched, the shorter one sorts first.
+    int cmp = memcmp(candidate.name(), name, child_namelen < namelen ? child_namelen : namelen);
+    if (cmp == 0 && child_namelen != namelen) {
+      return child_namelen < namelen ? -1 : 1;
     }
     return cmp;
   });
@@ -88,6 +87,24 @@ bool TrieNode::FindChildForString(const char* name, uint32_t namelen, TrieNode*
   return true;
 }
 
+// Looks up a child of the root node in the hash table written by the serializer since version 2.
+// The root node has by far the most children, so this replaces the longest binary search.
+bool PropertyInfoArea::FindRootChildForString(const char* name, uint32_t namelen,
+                                              TrieNode* child) const {
+  const uint32_t* table = uint32_array(root_children_table_offset());
+  const uint32_t mask = table[0] - 1;
+  const uint32_t* buckets = table + 1;
+  auto root = root_node();
+  for (uint32_t i = PropertyNameHash(name, namelen) & mask;; i = (i + 1) & mask) {
+    if (buckets[i] == 0) return false;
+    auto candidate = root.child_node(buckets[i] - 1);
+    if (candidate.namelen() == namelen && !memcmp(candidate.name(), name, namelen)) {
+      *child = candidate;
+      return true;
+    }
+  }
+}
+
 void PropertyInfoArea::CheckPrefixMatch(const char* remaining_name, const TrieNode& trie_node,
                                         uint32_t* context_index, uint32_t* type_index) const {
   const uint32_t remaining_name_size = strlen(remaining_name);
@@ -113,6 +130,7 @@ void PropertyInfoArea::GetPropertyInfoIndexes(const char* name, uint32_t* contex
   uint32_t return_type_index = ~0u;
   const char* remaining_name = name;
   auto trie_node = root_node();
+  bool use_root_children_table = root_children_table_offset() != 0;
   while (true) {
     const char* sep = strchr(remaining_name, '.');
 
@@ -134,9 +152,13 @@ void PropertyInfoArea::GetPropertyInfoIndexes(const char* name, uint32_t* contex
 
     const uint32_t substr_size = sep - remaining_name;
     TrieNode child_node;
-    if (!trie_node.FindChildForString(remaining_name, substr_size, &child_node)) {
+    bool found = use_root_children_table
+                     ? FindRootChildForString(remaining_name, substr_size, &child_node)
+                     : trie_node.FindChildForString(remaining_name, substr_size, &child_node);
+    if (!found) {
       break;
     }
+    use_root_children_table = false;
 
     trie_node = child_node;
     remaining_name = sep + 1;
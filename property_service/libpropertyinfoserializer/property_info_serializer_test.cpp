@@ -39,7 +39,7 @@ TEST(propertyinfoserializer, TrieNodeCheck) {
   auto property_info_area = reinterpret_cast<const PropertyInfoArea*>(serialized_trie.data());
 
   // Initial checks for property area.
-  EXPECT_EQ(1U, property_info_area->current_version());
+  EXPECT_EQ(2U, property_info_area->current_version());
   EXPECT_EQ(1U, property_info_area->minimum_supported_version());
 
   // Check the root node
@@ -887,5 +887,40 @@ TEST(propertyinfoserializer, GetPropertyInfo_empty_context_and_type) {
   EXPECT_STREQ("5th", type);
 }
 
+TEST(propertyinfoserializer, GetPropertyInfo_without_root_children_table) {
+  auto property_info = std::vector<PropertyInfoEntry>{
+      {"persist.radio", "1st", "1st", false},   {"persist.radio.exact", "2nd", "2nd", true},
+      {"ro.boot.", "3rd", "3rd", false},        {"ro.build.version", "4th", "4th", true},
+      {"sys.usb.state", "5th", "5th", true},    {"vendor", "6th", "6th", false},
+      {"vendor.", "7th", "7th", false},         {"wifi.interface", "8th", "8th", true},
+  };
+
+  auto serialized_trie = std::string();
+  auto build_trie_error = std::string();
+  ASSERT_TRUE(BuildTrie(property_info, "default", "default", &serialized_trie, &build_trie_error))
+      << build_trie_error;
+
+  // Pretend this is a version 1 file, which does not have the root children table, so the lookups
+  // fall back to searching the root node's children.
+  auto version_1_trie = serialized_trie;
+  reinterpret_cast<PropertyInfoAreaHeader*>(version_1_trie.data())->current_version = 1;
+
+  auto property_info_area = reinterpret_cast<const PropertyInfoArea*>(serialized_trie.data());
+  auto version_1_area = reinterpret_cast<const PropertyInfoArea*>(version_1_trie.data());
+  for (const char* name :
+       {"persist.radio.exact", "persist.radio.other", "persist.radiox", "persist", "ro.boot.serial",
+        "ro.build.version", "ro.build", "sys.usb.state", "sys.usb", "vendor", "vendor.foo",
+        "vendorfoo.bar", "wifi.interface", "wifi", "unknown.property", "", "."}) {
+    const char* context;
+    const char* type;
+    const char* version_1_context;
+    const char* version_1_type;
+    property_info_area->GetPropertyInfo(name, &context, &type);
+    version_1_area->GetPropertyInfo(name, &version_1_context, &version_1_type);
+    EXPECT_STREQ(version_1_context, context) << name;
+    EXPECT_STREQ(version_1_type, type) << name;
+  }
+}
+
 }  // namespace properties
 }  // namespace android
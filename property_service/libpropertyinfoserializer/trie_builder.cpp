@@ -51,34 +51,34 @@ bool TrieBuilder::AddToTrie(const std::string& name, const std::string* context,
   }
 
   // Move us to the final node that we care about, adding incremental nodes if necessary.
-  while (name_pieces.size() > 1) {
-    auto child = current_node->FindChild(name_pieces.front());
+  for (size_t i = 0; i + 1 < name_pieces.size(); ++i) {
+    auto child = current_node->FindChild(name_pieces[i]);
     if (child == nullptr) {
-      child = current_node->AddChild(name_pieces.front());
+      child = current_node->AddChild(name_pieces[i]);
     }
     if (child == nullptr) {
       *error = "Unable to allocate Trie node";
       return false;
     }
     current_node = child;
-    name_pieces.erase(name_pieces.begin());
   }
+  const std::string& last_piece = name_pieces.back();
 
   // Store our context based on what type of match it is.
   if (exact) {
-    if (!current_node->AddExactMatchContext(name_pieces.front(), context, type)) {
+    if (!current_node->AddExactMatchContext(last_piece, context, type)) {
       *error = "Duplicate exact match detected for '" + name + "'";
       return false;
     }
   } else if (!ends_with_dot) {
-    if (!current_node->AddPrefixContext(name_pieces.front(), context, type)) {
+    if (!current_node->AddPrefixContext(last_piece, context, type)) {
       *error = "Duplicate prefix match detected for '" + name + "'";
       return false;
     }
   } else {
-    auto child = current_node->FindChild(name_pieces.front());
+    auto child = current_node->FindChild(last_piece);
     if (child == nullptr) {
-      child = current_node->AddChild(name_pieces.front());
+      child = current_node->AddChild(last_piece);
     }
     if (child == nullptr) {
       *error = "Unable to allocate Trie node";
@@ -20,6 +20,8 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace android {
@@ -38,28 +40,26 @@ class TrieBuilderNode {
  public:
   TrieBuilderNode(const std::string& name) : property_entry_(name, nullptr, nullptr) {}
 
+  // Large property_contexts files put many entries under a single node, so lookups and
+  // duplicate checks go through hash indexes rather than scanning the vectors.
   TrieBuilderNode* FindChild(const std::string& name) {
-    for (auto& child : children_) {
-      if (child.name() == name) return &child;
-    }
-    return nullptr;
+    auto it = child_index_.find(name);
+    return it != child_index_.end() ? &children_[it->second] : nullptr;
   }
 
   const TrieBuilderNode* FindChild(const std::string& name) const {
-    for (const auto& child : children_) {
-      if (child.name() == name) return &child;
-    }
-    return nullptr;
+    auto it = child_index_.find(name);
+    return it != child_index_.end() ? &children_[it->second] : nullptr;
   }
 
-  TrieBuilderNode* AddChild(const std::string& name) { return &children_.emplace_back(name); }
+  TrieBuilderNode* AddChild(const std::string& name) {
+    child_index_.emplace(name, children_.size());
+    return &children_.emplace_back(name);
+  }
 
   bool AddPrefixContext(const std::string& prefix, const std::string* context,
                         const std::string* type) {
-    if (std::find_if(prefixes_.begin(), prefixes_.end(),
-                     [&prefix](const auto& t) { return t.name == prefix; }) != prefixes_.end()) {
-      return false;
-    }
+    if (!prefix_names_.emplace(prefix).second) return false;
 
     prefixes_.emplace_back(prefix, context, type);
     return true;
@@ -67,11 +67,7 @@ class TrieBuilderNode {
 
   bool AddExactMatchContext(const std::string& exact_match, const std::string* context,
                             const std::string* type) {
-    if (std::find_if(exact_matches_.begin(), exact_matches_.end(), [&exact_match](const auto& t) {
-          return t.name == exact_match;
-        }) != exact_matches_.end()) {
-      return false;
-    }
+    if (!exact_match_names_.emplace(exact_match).second) return false;
 
     exact_matches_.emplace_back(exact_match, context, type);
     return true;
@@ -83,7 +79,7 @@ class TrieBuilderNode {
   const std::string* type() const { return property_entry_.type; }
   void set_type(const std::string* type) { property_entry_.type = type; }
 
-  const PropertyEntryBuilder property_entry() const { return property_entry_; }
+  const PropertyEntryBuilder& property_entry() const { return property_entry_; }
 
   const std::vector<TrieBuilderNode>& children() const { return children_; }
   const std::vector<PropertyEntryBuilder>& prefixes() const { return prefixes_; }
@@ -94,6 +90,9 @@ class TrieBuilderNode {
   std::vector<TrieBuilderNode> children_;
   std::vector<PropertyEntryBuilder> prefixes_;
   std::vector<PropertyEntryBuilder> exact_matches_;
+  std::unordered_map<std::string, size_t> child_index_;
+  std::unordered_set<std::string> prefix_names_;
+  std::unordered_set<std::string> exact_match_names_;
 };
 
 class TrieBuilder {
@@ -102,7 +101,7 @@ class TrieBuilder {
   bool AddToTrie(const std::string& name, const std::string& context, const std::string& type,
                  bool exact, std::string* error);
 
-  const TrieBuilderNode builder_root() const { return builder_root_; }
+  const TrieBuilderNode& builder_root() const { return builder_root_; }
   const std::set<std::string>& contexts() const { return contexts_; }
   const std::set<std::string>& types() const { return types_; }
 
@@ -125,5 +125,35 @@ TEST(propertyinfoserializer, BuildTrie_Simple) {
   }
 }
 
+TEST(propertyinfoserializer, BuildTrie_ManyEntries) {
+  auto trie_builder = TrieBuilder("default", "default_type");
+
+  auto error = std::string();
+  for (int i = 0; i < 10000; ++i) {
+    auto index = std::to_string(i);
+    EXPECT_TRUE(trie_builder.AddToTrie("wide." + index + ".", "ctx", "type", false, &error));
+    EXPECT_TRUE(trie_builder.AddToTrie("wide.prop" + index, "ctx", "type", true, &error));
+    EXPECT_TRUE(trie_builder.AddToTrie("wide.prefix" + index, "ctx", "type", false, &error));
+  }
+  EXPECT_FALSE(trie_builder.AddToTrie("wide.prop1234", "ctx", "type", true, &error));
+  EXPECT_EQ("Duplicate exact match detected for 'wide.prop1234'", error);
+  EXPECT_FALSE(trie_builder.AddToTrie("wide.prefix1234", "ctx", "type", false, &error));
+  EXPECT_EQ("Duplicate prefix match detected for 'wide.prefix1234'", error);
+
+  auto* wide_node = trie_builder.builder_root().FindChild("wide");
+  ASSERT_NE(nullptr, wide_node);
+  EXPECT_EQ(10000U, wide_node->children().size());
+  EXPECT_EQ(10000U, wide_node->exact_matches().size());
+  EXPECT_EQ(10000U, wide_node->prefixes().size());
+  EXPECT_EQ("prop9999", wide_node->exact_matches()[9999].name);
+
+  auto* child = wide_node->FindChild("4321");
+  ASSERT_NE(nullptr, child);
+  EXPECT_EQ("4321", child->name());
+  ASSERT_NE(nullptr, child->context());
+  EXPECT_EQ("ctx", *child->context());
+  EXPECT_EQ(nullptr, wide_node->FindChild("10000"));
+}
+
 }  // namespace properties
 }  // namespace android
@@ -16,9 +16,19 @@
 
 #include "trie_serializer.h"
 
+#include <algorithm>
+
 namespace android {
 namespace properties {
 
+template <typename T>
+static std::vector<const T*> PointersTo(const std::vector<T>& items) {
+  std::vector<const T*> pointers;
+  pointers.reserve(items.size());
+  for (const auto& item : items) pointers.emplace_back(&item);
+  return pointers;
+}
+
 // Serialized strings contains:
 // 1) A uint32_t count of elements in the below array
 // 2) A sorted array of uint32_t offsets pointing to null terminated strings
@@ -61,11 +71,14 @@ uint32_t TrieSerializer::WriteTrieNode(const TrieBuilderNode& builder_node) {
 
   trie->property_entry = WritePropertyEntry(builder_node.property_entry());
 
+  // The builder's vectors are sorted through pointers, so that serializing doesn't copy each
+  // subtree once per level of the trie.
+
   // Write prefix matches
-  auto sorted_prefix_matches = builder_node.prefixes();
+  auto sorted_prefix_matches = PointersTo(builder_node.prefixes());
   // Prefixes are sorted by descending length
   std::sort(sorted_prefix_matches.begin(), sorted_prefix_matches.end(),
-            [](const auto& lhs, const auto& rhs) { return lhs.name.size() > rhs.name.size(); });
+            [](const auto* lhs, const auto* rhs) { return lhs->name.size() > rhs->name.size(); });
 
   trie->num_prefixes = sorted_prefix_matches.size();
 
@@ -73,15 +86,15 @@ uint32_t TrieSerializer::WriteTrieNode(const TrieBuilderNode& builder_node) {
   trie->prefix_entries = prefix_entries_array_offset;
 
   for (unsigned int i = 0; i < sorted_prefix_matches.size(); ++i) {
-    uint32_t property_entry_offset = WritePropertyEntry(sorted_prefix_matches[i]);
+    uint32_t property_entry_offset = WritePropertyEntry(*sorted_prefix_matches[i]);
     arena_->uint32_array(prefix_entries_array_offset)[i] = property_entry_offset;
   }
 
   // Write exact matches
-  auto sorted_exact_matches = builder_node.exact_matches();
+  auto sorted_exact_matches = PointersTo(builder_node.exact_matches());
   // Exact matches are sorted alphabetically
   std::sort(sorted_exact_matches.begin(), sorted_exact_matches.end(),
-            [](const auto& lhs, const auto& rhs) { return lhs.name < rhs.name; });
+            [](const auto* lhs, const auto* rhs) { return lhs->name < rhs->name; });
 
   trie->num_exact_matches = sorted_exact_matches.size();
 
@@ -90,32 +103,58 @@ uint32_t TrieSerializer::WriteTrieNode(const TrieBuilderNode& builder_node) {
   trie->exact_match_entries = exact_match_entries_array_offset;
 
   for (unsigned int i = 0; i < sorted_exact_matches.size(); ++i) {
-    uint32_t property_entry_offset = WritePropertyEntry(sorted_exact_matches[i]);
+    uint32_t property_entry_offset = WritePropertyEntry(*sorted_exact_matches[i]);
     arena_->uint32_array(exact_match_entries_array_offset)[i] = property_entry_offset;
   }
 
   // Write children
-  auto sorted_children = builder_node.children();
+  auto sorted_children = PointersTo(builder_node.children());
   std::sort(sorted_children.begin(), sorted_children.end(),
-            [](const auto& lhs, const auto& rhs) { return lhs.name() < rhs.name(); });
+            [](const auto* lhs, const auto* rhs) { return lhs->name() < rhs->name(); });
 
   trie->num_child_nodes = sorted_children.size();
   uint32_t children_offset_array_offset = arena_->AllocateUint32Array(sorted_children.size());
   trie->child_nodes = children_offset_array_offset;
 
   for (unsigned int i = 0; i < sorted_children.size(); ++i) {
-    arena_->uint32_array(children_offset_array_offset)[i] = WriteTrieNode(sorted_children[i]);
+    uint32_t child_offset = WriteTrieNode(*sorted_children[i]);
+    arena_->uint32_array(children_offset_array_offset)[i] = child_offset;
   }
   return trie_offset;
 }
 
+uint32_t TrieSerializer::WriteRootChildrenTable() {
+  // Hash the names first, as allocating from the arena may move the data TrieNodes point to.
+  auto root_node = serialized_info()->root_node();
+  std::vector<uint32_t> hashes;
+  for (uint32_t i = 0; i < root_node.num_child_nodes(); ++i) {
+    auto child = root_node.child_node(i);
+    hashes.emplace_back(PropertyNameHash(child.name(), child.namelen()));
+  }
+
+  // Keep the table at most half full, so that probing always reaches an empty bucket quickly.
+  uint32_t num_buckets = 1;
+  while (num_buckets < hashes.size() * 2) num_buckets <<= 1;
+
+  uint32_t table_offset = arena_->AllocateUint32Array(num_buckets + 1);
+  uint32_t* table = arena_->uint32_array(table_offset);
+  table[0] = num_buckets;
+  uint32_t* buckets = table + 1;
+  for (uint32_t i = 0; i < hashes.size(); ++i) {
+    uint32_t bucket = hashes[i] & (num_buckets - 1);
+    while (buckets[bucket] != 0) bucket = (bucket + 1) & (num_buckets - 1);
+    buckets[bucket] = i + 1;
+  }
+  return table_offset;
+}
+
 TrieSerializer::TrieSerializer() {}
 
 std::string TrieSerializer::SerializeTrie(const TrieBuilder& trie_builder) {
   arena_.reset(new TrieNodeArena());
 
   auto header = arena_->AllocateObject<PropertyInfoAreaHeader>(nullptr);
-  header->current_version = 1;
+  header->current_version = 2;
   header->minimum_supported_version = 1;
 
   // Store where we're about to write the contexts.
@@ -132,6 +171,10 @@ std::string TrieSerializer::SerializeTrie(const TrieBuilder& trie_builder) {
   uint32_t root_trie_offset = WriteTrieNode(trie_builder.builder_root());
   header->root_offset = root_trie_offset;
 
+  header->size = arena_->size();
+  uint32_t root_children_table_offset = WriteRootChildrenTable();
+  header->root_children_table_offset = root_children_table_offset;
+
   // Record the real size now that we've written everything
   header->size = arena_->size();
 
@@ -42,6 +42,10 @@ class TrieSerializer {
   // Returns the offset within arena.
   uint32_t WriteTrieNode(const TrieBuilderNode& builder_node);
 
+  // Writes the hash table of the root node's children, see
+  // PropertyInfoAreaHeader::root_children_table_offset. Returns the offset within arena.
+  uint32_t WriteRootChildrenTable();
+
   const PropertyInfoArea* serialized_info() const {
     return reinterpret_cast<const PropertyInfoArea*>(arena_->data().data());
   }
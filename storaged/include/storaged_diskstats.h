@@ -19,7 +19,10 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include <aidl/android/hardware/health/IHealth.h>
+#include <android-base/unique_fd.h>
 
 // number of attributes diskstats has
 #define DISK_STATS_SIZE ( 11 )
@@ -114,42 +117,72 @@ struct disk_perf {
     }
 };
 
+// Sums are kept as integers so that a long run of add()/evict() pairs is
+// exact and does not drift; only the final mean/std are computed in floating
+// point. The square sum cannot overflow for any realistic window: a kbyte/s
+// reading would need to exceed 10^9 before five squares overflow uint64_t.
 class stream_stats {
 private:
-    double mSum;
-    double mSquareSum;
+    uint64_t mSum;
+    uint64_t mSquareSum;
     uint32_t mCnt;
 public:
     stream_stats() : mSum(0), mSquareSum(0), mCnt(0) {};
     ~stream_stats() {};
     double get_mean() {
-        return mSum / mCnt;
+        return (double)mSum / mCnt;
     }
     double get_std() {
-        return sqrt(mSquareSum / mCnt - mSum * mSum / (mCnt * mCnt));
+        double mean = (double)mSum / mCnt;
+        return sqrt((double)mSquareSum / mCnt - mean * mean);
     }
     void add(uint32_t num) {
-        mSum += (double)num;
-        mSquareSum += (double)num * (double)num;
+        mSum += num;
+        mSquareSum += (uint64_t)num * num;
         mCnt++;
     }
     void evict(uint32_t num) {
-        if (mSum < num || mSquareSum < (double)num * (double)num) return;
-        mSum -= (double)num;
-        mSquareSum -= (double)num * (double)num;
+        if (mCnt == 0 || mSum < num || mSquareSum < (uint64_t)num * num) return;
+        mSum -= num;
+        mSquareSum -= (uint64_t)num * num;
         mCnt--;
     }
 };
 
+// Fixed capacity FIFO of the most recent perf samples. Storage is allocated
+// once up front so the sampling path does not touch the heap.
+class disk_perf_ring {
+private:
+    std::vector<struct disk_perf> mSlots;
+    size_t mHead;
+    size_t mSize;
+public:
+    explicit disk_perf_ring(size_t capacity) : mSlots(capacity), mHead(0), mSize(0) {}
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    struct disk_perf& front() { return mSlots[mHead]; }
+    void push(const struct disk_perf& perf) {
+        if (mSize == mSlots.size()) pop();
+        mSlots[(mHead + mSize) % mSlots.size()] = perf;
+        mSize++;
+    }
+    void pop() {
+        if (mSize == 0) return;
+        mHead = (mHead + 1) % mSlots.size();
+        mSize--;
+    }
+};
+
 class disk_stats_monitor {
 private:
     FRIEND_TEST(storaged_test, disk_stats_monitor);
     const char* const DISK_STATS_PATH;
+    android::base::unique_fd mStatsFd;  /* DISK_STATS_PATH, opened on first use */
     struct disk_stats mPrevious;
     struct disk_stats mAccumulate;      /* reset after stall */
     struct disk_stats mAccumulate_pub;  /* reset after publish */
     bool mStall;
-    std::queue<struct disk_perf> mBuffer;
+    disk_perf_ring mBuffer;
     struct {
         stream_stats read_perf;           // read speed (bytes/s)
         stream_stats read_ios;            // read I/Os per second
@@ -186,6 +219,8 @@ public:
         mAccumulate(),
         mAccumulate_pub(),
         mStall(false),
+        // one spare slot: update() pushes before it evicts the oldest sample
+        mBuffer(window_size + 1),
         mValid(false),
         mWindow(window_size),
         mSigma(sigma),
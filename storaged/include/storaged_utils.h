@@ -28,6 +28,7 @@ using namespace android::os::storaged;
 
 // Diskstats
 bool parse_disk_stats(const char* disk_stats_path, struct disk_stats* stats);
+bool parse_disk_stats(int fd, struct disk_stats* stats);
 struct disk_perf get_disk_perf(struct disk_stats* stats);
 void get_inc_disk_stats(const struct disk_stats* prev, const struct disk_stats* curr, struct disk_stats* inc);
 void add_disk_stats(struct disk_stats* src, struct disk_stats* dst);
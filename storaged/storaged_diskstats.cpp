@@ -16,12 +16,12 @@
 
 #define LOG_TAG "storaged"
 
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <unistd.h>
 
-#include <sstream>
-
-#include <android-base/file.h>
+#include <android-base/unique_fd.h>
 #include <android-base/logging.h>
 #include <log/log_event_list.h>
 
@@ -61,6 +61,21 @@ void log_event_disk_stats(struct disk_stats* stats, const char* type) {
         << LOG_ID_EVENTS;
 }
 
+// Parses the leading DISK_STATS_SIZE fields of a /sys/block/<dev>/stat line.
+// Newer kernels append discard and flush counters, which are ignored.
+bool parse_disk_stats_line(const char* p, const char* end, uint64_t* fields) {
+    for (uint i = 0; i < DISK_STATS_SIZE; ++i) {
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        if (p == end || *p < '0' || *p > '9') return false;
+        uint64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + (*p++ - '0');
+        }
+        fields[i] = value;
+    }
+    return true;
+}
+
 } // namespace
 
 bool get_time(struct timespec* ts) {
@@ -81,29 +96,46 @@ void init_disk_stats_other(const struct timespec& ts, struct disk_stats* stats)
     stats->io_avg = (double)stats->io_in_flight;
 }
 
-bool parse_disk_stats(const char* disk_stats_path, struct disk_stats* stats) {
+bool parse_disk_stats(int fd, struct disk_stats* stats) {
     // Get time
     struct timespec ts;
     if (!get_time(&ts)) {
         return false;
     }
 
-    std::string buffer;
-    if (!android::base::ReadFileToString(disk_stats_path, &buffer)) {
-        PLOG(ERROR) << disk_stats_path << ": ReadFileToString failed.";
+    // The stat file is a single line of at most 17 counters; sysfs regenerates
+    // it on every read from offset 0, so the fd can be reused across samples.
+    char buffer[256];
+    ssize_t len = TEMP_FAILURE_RETRY(pread(fd, buffer, sizeof(buffer), 0));
+    if (len < 0) {
+        PLOG(ERROR) << "pread diskstats failed";
+        return false;
+    }
+
+    uint64_t fields[DISK_STATS_SIZE];
+    if (!parse_disk_stats_line(buffer, buffer + len, fields)) {
+        LOG(ERROR) << "Malformed diskstats: " << std::string(buffer, len);
         return false;
     }
 
     // Regular diskstats entries
-    std::stringstream ss(buffer);
     for (uint i = 0; i < DISK_STATS_SIZE; ++i) {
-        ss >> *((uint64_t*)stats + i);
+        *((uint64_t*)stats + i) = fields[i];
     }
     // Other entries
     init_disk_stats_other(ts, stats);
     return true;
 }
 
+bool parse_disk_stats(const char* disk_stats_path, struct disk_stats* stats) {
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(disk_stats_path, O_RDONLY | O_CLOEXEC)));
+    if (fd < 0) {
+        PLOG(ERROR) << disk_stats_path << ": open failed.";
+        return false;
+    }
+    return parse_disk_stats(fd.get(), stats);
+}
+
 void convert_hal_disk_stats(struct disk_stats* dst, const DiskStats& src) {
     dst->read_ios = src.reads;
     dst->read_merges = src.readMerges;
@@ -300,7 +332,16 @@ void disk_stats_monitor::update() {
             return;
         }
     } else {
-        if (!parse_disk_stats(DISK_STATS_PATH, &curr)) {
+        if (mStatsFd < 0) {
+            mStatsFd.reset(TEMP_FAILURE_RETRY(open(DISK_STATS_PATH, O_RDONLY | O_CLOEXEC)));
+            if (mStatsFd < 0) {
+                PLOG(ERROR) << DISK_STATS_PATH << ": open failed.";
+                return;
+            }
+        }
+        if (!parse_disk_stats(mStatsFd.get(), &curr)) {
+            // Reopen on the next sample in case the device node went away.
+            mStatsFd.reset();
             return;
         }
     }
@@ -19,9 +19,12 @@
 #include <stdint.h>
 #include <time.h>
 
+#include <charconv>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
 #include <android/content/pm/IPackageManagerNative.h>
 #include <android-base/file.h>
@@ -55,22 +58,49 @@ std::unordered_map<uint32_t, uid_info> uid_monitor::get_uid_io_stats()
     return get_uid_io_stats_locked();
 };
 
+namespace {
+
+/* parse all of s as a decimal number, like ParseUint/ParseInt but without copying s */
+template <typename T>
+bool parse_number(std::string_view s, T* out)
+{
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), *out);
+    return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+/* split s on sep into fields, without allocating; returns the number of fields found */
+template <size_t N>
+size_t split_fields(std::string_view s, char sep, std::string_view (&fields)[N])
+{
+    size_t n = 0;
+    size_t start = 0;
+    while (n < N) {
+        size_t end = s.find(sep, start);
+        fields[n++] = s.substr(start, end - start);
+        if (end == std::string_view::npos) break;
+        start = end + 1;
+    }
+    return n;
+}
+
+} // namespace
+
 /* return true on parse success and false on failure */
-bool uid_info::parse_uid_io_stats(std::string&& s)
+bool uid_info::parse_uid_io_stats(std::string_view s)
 {
-    std::vector<std::string> fields = Split(s, " ");
-    if (fields.size() < 11 ||
-        !ParseUint(fields[0],  &uid) ||
-        !ParseUint(fields[1],  &io[FOREGROUND].rchar) ||
-        !ParseUint(fields[2],  &io[FOREGROUND].wchar) ||
-        !ParseUint(fields[3],  &io[FOREGROUND].read_bytes) ||
-        !ParseUint(fields[4],  &io[FOREGROUND].write_bytes) ||
-        !ParseUint(fields[5],  &io[BACKGROUND].rchar) ||
-        !ParseUint(fields[6],  &io[BACKGROUND].wchar) ||
-        !ParseUint(fields[7],  &io[BACKGROUND].read_bytes) ||
-        !ParseUint(fields[8],  &io[BACKGROUND].write_bytes) ||
-        !ParseUint(fields[9],  &io[FOREGROUND].fsync) ||
-        !ParseUint(fields[10], &io[BACKGROUND].fsync)) {
+    std::string_view fields[11];
+    if (split_fields(s, ' ', fields) < 11 ||
+        !parse_number(fields[0],  &uid) ||
+        !parse_number(fields[1],  &io[FOREGROUND].rchar) ||
+        !parse_number(fields[2],  &io[FOREGROUND].wchar) ||
+        !parse_number(fields[3],  &io[FOREGROUND].read_bytes) ||
+        !parse_number(fields[4],  &io[FOREGROUND].write_bytes) ||
+        !parse_number(fields[5],  &io[BACKGROUND].rchar) ||
+        !parse_number(fields[6],  &io[BACKGROUND].wchar) ||
+        !parse_number(fields[7],  &io[BACKGROUND].read_bytes) ||
+        !parse_number(fields[8],  &io[BACKGROUND].write_bytes) ||
+        !parse_number(fields[9],  &io[FOREGROUND].fsync) ||
+        !parse_number(fields[10], &io[BACKGROUND].fsync)) {
         LOG(WARNING) << "Invalid uid I/O stats: \"" << s << "\"";
         return false;
     }
@@ -78,27 +108,36 @@ bool uid_info::parse_uid_io_stats(std::string&& s)
 }
 
 /* return true on parse success and false on failure */
-bool task_info::parse_task_io_stats(std::string&& s)
+bool task_info::parse_task_io_stats(std::string_view s)
 {
-    std::vector<std::string> fields = Split(s, ",");
-    size_t size = fields.size();
-    if (size < 13 ||
-        !ParseInt(fields[size - 11],  &pid) ||
-        !ParseUint(fields[size - 10],  &io[FOREGROUND].rchar) ||
-        !ParseUint(fields[size - 9],  &io[FOREGROUND].wchar) ||
-        !ParseUint(fields[size - 8],  &io[FOREGROUND].read_bytes) ||
-        !ParseUint(fields[size - 7],  &io[FOREGROUND].write_bytes) ||
-        !ParseUint(fields[size - 6],  &io[BACKGROUND].rchar) ||
-        !ParseUint(fields[size - 5],  &io[BACKGROUND].wchar) ||
-        !ParseUint(fields[size - 4],  &io[BACKGROUND].read_bytes) ||
-        !ParseUint(fields[size - 3], &io[BACKGROUND].write_bytes) ||
-        !ParseUint(fields[size - 2], &io[FOREGROUND].fsync) ||
-        !ParseUint(fields[size - 1], &io[BACKGROUND].fsync)) {
+    // "task,<comm>,<pid>,<10 stats>", where comm may itself contain commas, so
+    // the numbers are the last 11 fields.
+    std::string_view fields[11];
+    size_t end = s.size();
+    size_t n = 0;
+    for (; n < 11; n++) {
+        size_t comma = (end == 0) ? std::string_view::npos : s.rfind(',', end - 1);
+        if (comma == std::string_view::npos) break;
+        fields[10 - n] = s.substr(comma + 1, end - comma - 1);
+        end = comma;
+    }
+    size_t comm_start = s.find(',');
+    if (n < 11 || comm_start == std::string_view::npos || comm_start >= end ||
+        !parse_number(fields[0],  &pid) ||
+        !parse_number(fields[1],  &io[FOREGROUND].rchar) ||
+        !parse_number(fields[2],  &io[FOREGROUND].wchar) ||
+        !parse_number(fields[3],  &io[FOREGROUND].read_bytes) ||
+        !parse_number(fields[4],  &io[FOREGROUND].write_bytes) ||
+        !parse_number(fields[5],  &io[BACKGROUND].rchar) ||
+        !parse_number(fields[6],  &io[BACKGROUND].wchar) ||
+        !parse_number(fields[7],  &io[BACKGROUND].read_bytes) ||
+        !parse_number(fields[8],  &io[BACKGROUND].write_bytes) ||
+        !parse_number(fields[9],  &io[FOREGROUND].fsync) ||
+        !parse_number(fields[10], &io[BACKGROUND].fsync)) {
         LOG(WARNING) << "Invalid task I/O stats: \"" << s << "\"";
         return false;
     }
-    comm = Join(std::vector<std::string>(
-                fields.begin() + 1, fields.end() - 11), ',');
+    comm = s.substr(comm_start + 1, end - comm_start - 1);
     return true;
 }
 
@@ -159,33 +198,38 @@ std::unordered_map<uint32_t, uid_info> uid_monitor::get_uid_io_stats_locked()
         return uid_io_stats;
     }
 
-    std::vector<std::string> io_stats = Split(std::move(buffer), "\n");
     uid_info u;
     vector<int> uids;
     vector<std::string*> uid_names;
 
-    for (uint32_t i = 0; i < io_stats.size(); i++) {
-        if (io_stats[i].empty()) {
+    std::string_view remaining = buffer;
+    while (!remaining.empty()) {
+        size_t eol = remaining.find('\n');
+        std::string_view line = remaining.substr(0, eol);
+        remaining.remove_prefix(eol == std::string_view::npos ? remaining.size() : eol + 1);
+        if (line.empty()) {
             continue;
         }
 
-        if (io_stats[i].compare(0, 4, "task")) {
-            if (!u.parse_uid_io_stats(std::move(io_stats[i])))
+        if (line.compare(0, 4, "task")) {
+            if (!u.parse_uid_io_stats(line))
                 continue;
-            uid_io_stats[u.uid] = u;
-            uid_io_stats[u.uid].name = std::to_string(u.uid);
+            uid_info& entry = uid_io_stats[u.uid];
+            entry = u;
             uids.push_back(u.uid);
-            uid_names.push_back(&uid_io_stats[u.uid].name);
-            if (last_uid_io_stats_.find(u.uid) == last_uid_io_stats_.end()) {
+            uid_names.push_back(&entry.name);
+            auto last = last_uid_io_stats_.find(u.uid);
+            if (last == last_uid_io_stats_.end()) {
+                entry.name = std::to_string(u.uid);
                 refresh_uid_names = true;
             } else {
-                uid_io_stats[u.uid].name = last_uid_io_stats_[u.uid].name;
+                entry.name = last->second.name;
             }
         } else {
             task_info t;
-            if (!t.parse_task_io_stats(std::move(io_stats[i])))
+            if (!t.parse_task_io_stats(line))
                 continue;
-            uid_io_stats[u.uid].tasks[t.pid] = t;
+            uid_io_stats[u.uid].tasks[t.pid] = std::move(t);
         }
     }
 
@@ -229,7 +273,7 @@ void uid_monitor::add_records_locked(uint64_t curr_ts)
                 if (!p_task.second.is_zero())
                     record.ios.task_ios[p_task.first] = p_task.second;
             }
-            new_records.entries.push_back(record);
+            new_records.entries.push_back(std::move(record));
         }
     }
 
@@ -243,7 +287,7 @@ void uid_monitor::add_records_locked(uint64_t curr_ts)
     // make some room for new records
     maybe_shrink_history_for_items(new_records.entries.size());
 
-    io_history_[curr_ts] = new_records;
+    io_history_[curr_ts] = std::move(new_records);
 }
 
 void uid_monitor::maybe_shrink_history_for_items(size_t nitems) {
@@ -379,16 +423,27 @@ void uid_monitor::report(unordered_map<int, StoragedProto>* protos)
 
 namespace {
 
+// Most counters in a record are zero (a task rarely does foreground and
+// background I/O with the charger both on and off), so only the non-zero ones
+// are written out. Unset fields read back as zero in get_io_usage_proto.
 void set_io_usage_proto(IOUsage* usage_proto, const io_usage& usage)
 {
-    usage_proto->set_rd_fg_chg_on(usage.bytes[READ][FOREGROUND][CHARGER_ON]);
-    usage_proto->set_rd_fg_chg_off(usage.bytes[READ][FOREGROUND][CHARGER_OFF]);
-    usage_proto->set_rd_bg_chg_on(usage.bytes[READ][BACKGROUND][CHARGER_ON]);
-    usage_proto->set_rd_bg_chg_off(usage.bytes[READ][BACKGROUND][CHARGER_OFF]);
-    usage_proto->set_wr_fg_chg_on(usage.bytes[WRITE][FOREGROUND][CHARGER_ON]);
-    usage_proto->set_wr_fg_chg_off(usage.bytes[WRITE][FOREGROUND][CHARGER_OFF]);
-    usage_proto->set_wr_bg_chg_on(usage.bytes[WRITE][BACKGROUND][CHARGER_ON]);
-    usage_proto->set_wr_bg_chg_off(usage.bytes[WRITE][BACKGROUND][CHARGER_OFF]);
+    if (usage.bytes[READ][FOREGROUND][CHARGER_ON])
+        usage_proto->set_rd_fg_chg_on(usage.bytes[READ][FOREGROUND][CHARGER_ON]);
+    if (usage.bytes[READ][FOREGROUND][CHARGER_OFF])
+        usage_proto->set_rd_fg_chg_off(usage.bytes[READ][FOREGROUND][CHARGER_OFF]);
+    if (usage.bytes[READ][BACKGROUND][CHARGER_ON])
+        usage_proto->set_rd_bg_chg_on(usage.bytes[READ][BACKGROUND][CHARGER_ON]);
+    if (usage.bytes[READ][BACKGROUND][CHARGER_OFF])
+        usage_proto->set_rd_bg_chg_off(usage.bytes[READ][BACKGROUND][CHARGER_OFF]);
+    if (usage.bytes[WRITE][FOREGROUND][CHARGER_ON])
+        usage_proto->set_wr_fg_chg_on(usage.bytes[WRITE][FOREGROUND][CHARGER_ON]);
+    if (usage.bytes[WRITE][FOREGROUND][CHARGER_OFF])
+        usage_proto->set_wr_fg_chg_off(usage.bytes[WRITE][FOREGROUND][CHARGER_OFF]);
+    if (usage.bytes[WRITE][BACKGROUND][CHARGER_ON])
+        usage_proto->set_wr_bg_chg_on(usage.bytes[WRITE][BACKGROUND][CHARGER_ON]);
+    if (usage.bytes[WRITE][BACKGROUND][CHARGER_OFF])
+        usage_proto->set_wr_bg_chg_off(usage.bytes[WRITE][BACKGROUND][CHARGER_OFF]);
 }
 
 void get_io_usage_proto(io_usage* usage, const IOUsage& io_proto)
@@ -504,7 +559,7 @@ void uid_monitor::load_uid_io_proto(userid_t user_id, const UidIOUsage& uid_io_p
                     &record.ios.task_ios[task_io_proto.task_name()],
                     task_io_proto.ios());
             }
-            recs->entries.push_back(record);
+            recs->entries.push_back(std::move(record));
         }
 
         // We already added items, so this will just cull down to the maximum
@@ -23,6 +23,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <android-base/file.h>
 #include <gtest/gtest.h>
 
 #include <aidl/android/hardware/health/IHealth.h>
@@ -94,6 +95,44 @@ TEST(storaged_test, retvals) {
     EXPECT_EQ(stats, old_stats);
 }
 
+TEST(storaged_test, parse_disk_stats_fd) {
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+
+    // 5.x kernels append discard and flush counters after the first 11 fields
+    ASSERT_TRUE(android::base::WriteStringToFd(
+            "   12345      678   901234    5678    4321      87  65432    1098"
+            "        3     7654    32109        0        0        0        0"
+            "       11       22\n",
+            tf.fd));
+
+    struct disk_stats stats = {};
+    ASSERT_TRUE(parse_disk_stats(tf.fd, &stats));
+    EXPECT_EQ(12345u, stats.read_ios);
+    EXPECT_EQ(678u, stats.read_merges);
+    EXPECT_EQ(901234u, stats.read_sectors);
+    EXPECT_EQ(5678u, stats.read_ticks);
+    EXPECT_EQ(4321u, stats.write_ios);
+    EXPECT_EQ(87u, stats.write_merges);
+    EXPECT_EQ(65432u, stats.write_sectors);
+    EXPECT_EQ(1098u, stats.write_ticks);
+    EXPECT_EQ(3u, stats.io_in_flight);
+    EXPECT_EQ(7654u, stats.io_ticks);
+    EXPECT_EQ(32109u, stats.io_in_queue);
+
+    // the same fd is re-read from the start on every sample
+    struct disk_stats again = {};
+    ASSERT_TRUE(parse_disk_stats(tf.fd, &again));
+    EXPECT_EQ(stats, again);
+
+    // a truncated line is rejected without touching the output
+    TemporaryFile short_tf;
+    ASSERT_NE(short_tf.fd, -1);
+    ASSERT_TRUE(android::base::WriteStringToFd("1 2 3 4 5\n", short_tf.fd));
+    EXPECT_FALSE(parse_disk_stats(short_tf.fd, &again));
+    EXPECT_EQ(stats, again);
+}
+
 TEST(storaged_test, disk_stats) {
     struct disk_stats stats = {};
     auto disk_stats_path = get_disk_stats_path();
@@ -33,7 +33,9 @@
 #include <trusty/tipc.h>
 #include <unistd.h>
 #include <algorithm>
+#include <future>
 #include <string>
+#include <utility>
 
 #include "apploader_ipc.h"
 
@@ -52,7 +54,10 @@ static const struct option _lopts[] = {
 };
 
 static const char* usage =
-        "Usage: %s [options] package-file\n"
+        "Usage: %s [options] package-file...\n"
+        "\n"
+        "Loads each package in turn; the next package is read while the\n"
+        "previous one is being loaded by Trusty.\n"
         "\n"
         "options:\n"
         "  -h, --help            prints this message and exit\n"
@@ -243,13 +248,23 @@ static ssize_t read_response(int tipc_fd) {
     return static_cast<ssize_t>(resp.error);
 }
 
-static ssize_t send_app_package(const char* package_file_name) {
+struct app_package {
+    unique_fd fd;
+    off64_t size = 0;
+};
+
+static app_package load_app_package(const char* package_file_name) {
+    app_package package;
+    package.fd = read_file(package_file_name, &package.size);
+    return package;
+}
+
+static ssize_t send_app_package(const char* package_file_name, const app_package& package) {
     ssize_t rc = 0;
     int tipc_fd = -1;
-    off64_t package_size;
 
-    unique_fd package_fd = read_file(package_file_name, &package_size);
-    if (!package_fd.ok()) {
+    if (!package.fd.ok()) {
+        LOG(ERROR) << "Failed to read package " << package_file_name;
         rc = -1;
         goto err_read_file;
     }
@@ -263,7 +278,7 @@ static ssize_t send_app_package(const char* package_file_name) {
         goto err_tipc_connect;
     }
 
-    rc = send_load_message(tipc_fd, package_fd, package_size);
+    rc = send_load_message(tipc_fd, package.fd, package.size);
     if (rc < 0) {
         LOG(ERROR) << "Failed to send package: " << rc;
         goto err_send;
@@ -280,10 +295,22 @@ err_read_file:
 
 int main(int argc, char** argv) {
     parse_options(argc, argv);
-    if (optind + 1 != argc) {
+    if (optind >= argc) {
         print_usage_and_exit(argv[0], EXIT_FAILURE);
     }
 
-    int rc = send_app_package(argv[optind]);
-    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    // Read the next package into its dmabuf while Trusty verifies and loads
+    // the current one, so at most two packages are resident at a time.
+    bool failed = false;
+    auto next = std::async(std::launch::async, load_app_package, argv[optind]);
+    for (int i = optind; i < argc; i++) {
+        app_package package = next.get();
+        if (i + 1 < argc) {
+            next = std::async(std::launch::async, load_app_package, argv[i + 1]);
+        }
+        if (send_app_package(argv[i], package) != 0) {
+            failed = true;
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
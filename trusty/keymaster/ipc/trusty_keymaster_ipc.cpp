@@ -79,15 +79,13 @@ std::variant<int, std::vector<uint8_t>> trusty_keymaster_call_2(uint32_t cmd, vo
         return -EINVAL;
     }
 
-    size_t msg_size = in_size + sizeof(struct keymaster_message);
-    struct keymaster_message* msg = reinterpret_cast<struct keymaster_message*>(malloc(msg_size));
-    if (!msg) {
-        ALOGE("failed to allocate msg buffer\n");
-        return -EINVAL;
-    }
-
-    msg->cmd = cmd;
-    memcpy(msg->payload, in, in_size);
+    // Send the header and the caller's payload as one message straight from
+    // their own buffers rather than copying both into a fresh allocation.
+    struct keymaster_message msg_header = {.cmd = cmd};
+    struct iovec tx[2] = {
+            {.iov_base = &msg_header, .iov_len = sizeof(msg_header)},
+            {.iov_base = in, .iov_len = in_size},
+    };
 
     nsecs_t start_time_ns = systemTime(SYSTEM_TIME_MONOTONIC);
     bool timed_out = false;
@@ -116,12 +114,11 @@ std::variant<int, std::vector<uint8_t>> trusty_keymaster_call_2(uint32_t cmd, vo
         break;
     }
 
-    ssize_t rc = write(handle_, msg, msg_size);
+    ssize_t rc = writev(handle_, tx, in_size ? 2 : 1);
     if (timed_out) {
         ALOGW("write for cmd %d finished after %lld nsecs", cmd,
               (long long)(systemTime(SYSTEM_TIME_MONOTONIC) - start_time_ns));
     }
-    free(msg);
 
     if (rc < 0) {
         ALOGE("failed to send cmd (%d) to %s: %s\n", cmd, KEYMASTER_PORT, strerror(errno));
@@ -118,6 +118,7 @@ static const char* usage_long =
         "   writev       - writev test\n"
         "   readv        - readv test\n"
         "   send-fd      - transmit dma_buf to trusty, use as shm\n"
+        "   echo-sweep   - echo latency and throughput from 64 bytes up to msgsize\n"
         "\n";
 
 struct tipc_test_params {
@@ -985,6 +986,67 @@ uint64_t get_time_us(void) {
     return spec.tv_sec * 1000000 + spec.tv_nsec / 1000;
 }
 
+static int echo_sweep_test(const struct tipc_test_params* params) {
+    int ret = 0;
+    int echo_fd = -1;
+    char* tx_buf = NULL;
+    char* rx_buf = NULL;
+    size_t msg_len = params->msgsize < 64 ? params->msgsize : 64;
+
+    tx_buf = malloc(params->msgsize);
+    rx_buf = malloc(params->msgsize);
+    if (!tx_buf || !rx_buf) {
+        fprintf(stderr, "Failed to allocate %u byte buffers\n", params->msgsize);
+        ret = -1;
+        goto cleanup;
+    }
+
+    echo_fd = tipc_connect(params->dev_name, echo_name);
+    if (echo_fd < 0) {
+        fprintf(stderr, "Failed to connect to service\n");
+        ret = echo_fd;
+        goto cleanup;
+    }
+
+    for (; msg_len && msg_len <= params->msgsize; msg_len *= 2) {
+        uint i;
+        uint64_t start = get_time_us();
+
+        memset(tx_buf, (int)msg_len, msg_len);
+        for (i = 0; i < params->repeat; i++) {
+            ssize_t rc = write(echo_fd, tx_buf, msg_len);
+            if ((size_t)rc != msg_len) {
+                /* the echo service caps its message size; stop at the first refusal */
+                fprintf(stderr, "%s: write of %zu bytes failed: %s\n", __func__, msg_len,
+                        strerror(errno));
+                goto cleanup;
+            }
+
+            rc = read(echo_fd, rx_buf, msg_len);
+            if ((size_t)rc != msg_len || memcmp(tx_buf, rx_buf, msg_len)) {
+                fprintf(stderr, "%s: bad echo for %zu bytes\n", __func__, msg_len);
+                ret = -1;
+                goto cleanup;
+            }
+        }
+
+        uint64_t elapsed = get_time_us() - start;
+        if (!params->silent && params->repeat && elapsed) {
+            printf("%s: %7zu bytes: %8" PRIu64 " us/msg %10.2f KiB/s\n", __func__, msg_len,
+                   elapsed / params->repeat,
+                   (double)msg_len * params->repeat * 1000000 / elapsed / 1024);
+        }
+    }
+
+cleanup:
+    if (echo_fd >= 0) {
+        tipc_close(echo_fd);
+    }
+    free(tx_buf);
+    free(rx_buf);
+    return ret;
+}
+
 static const struct tipc_test_def tipc_tests[] = {
         {"connect", connect_test},
         {"connect_foo", connect_foo},
@@ -1001,6 +1063,7 @@ static const struct tipc_test_def tipc_tests[] = {
         {"writev", writev_test},
         {"readv", readv_test},
         {"send-fd", send_fd_test},
+        {"echo-sweep", echo_sweep_test},
 };
 
 tipc_test_func_t get_test_function(const struct tipc_test_params* params) {
@@ -20,6 +20,7 @@
 #include <inttypes.h>
 #include <libgen.h>
 #include <linux/fs.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,6 +37,8 @@
 
 #define FD_TBL_SIZE 64
 #define MAX_READ_SIZE 4096
+#define FSYNC_MAX_THREADS 4
+#define MAX_PENDING_PARENT_DIRS 8
 
 #define ALTERNATE_DATA_DIR "alternate/"
 
@@ -322,21 +325,63 @@ err_response:
     return ipc_respond(msg, NULL, 0);
 }
 
-static void sync_parent(const char* path, struct watcher* watcher) {
-    int parent_fd;
+/*
+ * Parent directories of files created since the last checkpoint. Their
+ * entries only need to be durable by the time Trusty commits, so they are
+ * synced together with the dirty files in storage_sync_checkpoint instead of
+ * once per create.
+ */
+static char* pending_parent_dirs[MAX_PENDING_PARENT_DIRS];
+static uint num_pending_parent_dirs;
+
+static void sync_dir(const char* dir_path, struct watcher* watcher) {
+    int dir_fd;
     watch_progress(watcher, "syncing parent");
-    char* parent_path = dirname(path);
-    parent_fd = TEMP_FAILURE_RETRY(open(parent_path, O_RDONLY));
-    if (parent_fd >= 0) {
-        fsync(parent_fd);
-        close(parent_fd);
+    dir_fd = TEMP_FAILURE_RETRY(open(dir_path, O_RDONLY));
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
     } else {
-        ALOGE("%s: failed to open parent directory \"%s\" for sync: %s\n", __func__, parent_path,
+        ALOGE("%s: failed to open parent directory \"%s\" for sync: %s\n", __func__, dir_path,
               strerror(errno));
     }
     watch_progress(watcher, "done syncing parent");
 }
 
+static void sync_parent(const char* path, struct watcher* watcher) {
+    char* path_copy = strdup(path);
+    if (path_copy == NULL) {
+        ALOGE("%s: failed to copy path \"%s\"\n", __func__, path);
+        return;
+    }
+    char* parent_path = dirname(path_copy);
+
+    for (uint i = 0; i < num_pending_parent_dirs; i++) {
+        if (!strcmp(pending_parent_dirs[i], parent_path)) {
+            free(path_copy);
+            return;
+        }
+    }
+
+    /* too many distinct directories to track, sync this one right away */
+    char* parent_copy = num_pending_parent_dirs < MAX_PENDING_PARENT_DIRS
+                                ? strdup(parent_path) : NULL;
+    if (parent_copy == NULL) {
+        sync_dir(parent_path, watcher);
+    } else {
+        pending_parent_dirs[num_pending_parent_dirs++] = parent_copy;
+    }
+    free(path_copy);
+}
+
+static void clear_pending_parent_dirs(void) {
+    for (uint i = 0; i < num_pending_parent_dirs; i++) {
+        free(pending_parent_dirs[i]);
+        pending_parent_dirs[i] = NULL;
+    }
+    num_pending_parent_dirs = 0;
+}
+
 static struct storage_mapping_node* get_storage_mapping_entry(const char* source) {
     struct storage_mapping_node* curr = storage_mapping_head;
     for (; curr != NULL; curr = curr->next) {
@@ -851,22 +896,99 @@ int storage_init(const char* dirname, struct storage_mapping_node* mappings,
     return 0;
 }
 
+struct fsync_job {
+    int fd;
+    /* directory entries must be flushed with fsync, file contents only need fdatasync */
+    bool is_dir;
+    int error;
+    pthread_t thread;
+    bool started;
+};
+
+static void* fsync_job_run(void* arg) {
+    struct fsync_job* job = arg;
+    int rc = job->is_dir ? fsync(job->fd) : fdatasync(job->fd);
+    job->error = rc < 0 ? errno : 0;
+    return NULL;
+}
+
+/*
+ * fsync each of the |count| jobs, up to FSYNC_MAX_THREADS at a time. The files
+ * are independent, so letting the filesystem see the flushes together lets it
+ * fold them into fewer journal commits instead of paying for one per file.
+ */
+static void fsync_jobs(struct fsync_job* jobs, uint count) {
+    for (uint base = 0; base < count; base += FSYNC_MAX_THREADS) {
+        uint end = base + FSYNC_MAX_THREADS < count ? base + FSYNC_MAX_THREADS : count;
+
+        /* the first job of each batch runs on this thread */
+        for (uint i = base + 1; i < end; i++) {
+            jobs[i].started =
+                    pthread_create(&jobs[i].thread, NULL, fsync_job_run, &jobs[i]) == 0;
+            if (!jobs[i].started) {
+                fsync_job_run(&jobs[i]);
+            }
+        }
+        fsync_job_run(&jobs[base]);
+        for (uint i = base + 1; i < end; i++) {
+            if (jobs[i].started) {
+                pthread_join(jobs[i].thread, NULL);
+            }
+        }
+    }
+}
+
 int storage_sync_checkpoint(struct watcher* watcher) {
-    int rc;
+    int rc = 0;
 
     watch_progress(watcher, "sync fd table");
     /* sync fd table and reset it to clean state first */
-    for (uint fd = 0; fd < FD_TBL_SIZE; fd++) {
-        if (fd_state[fd] == SS_DIRTY) {
-            if (fs_state == SS_CLEAN) {
-                /* need to sync individual fd */
-                rc = fsync(fd);
-                if (rc < 0) {
-                    ALOGE("fsync for fd=%d failed: %s\n", fd, strerror(errno));
-                    return rc;
-                }
+    if (fs_state == SS_CLEAN) {
+        /* need to sync individual fds and the directories of newly created files */
+        struct fsync_job jobs[FD_TBL_SIZE + MAX_PENDING_PARENT_DIRS];
+        uint njobs = 0;
+        for (uint fd = 0; fd < FD_TBL_SIZE; fd++) {
+            if (fd_state[fd] == SS_DIRTY) {
+                jobs[njobs++] = (struct fsync_job){.fd = fd};
+            }
+        }
+        uint nfile_jobs = njobs;
+        for (uint i = 0; i < num_pending_parent_dirs; i++) {
+            int dir_fd = TEMP_FAILURE_RETRY(open(pending_parent_dirs[i], O_RDONLY));
+            if (dir_fd < 0) {
+                ALOGE("%s: failed to open parent directory \"%s\" for sync: %s\n", __func__,
+                      pending_parent_dirs[i], strerror(errno));
+                continue;
+            }
+            jobs[njobs++] = (struct fsync_job){.fd = dir_fd, .is_dir = true};
+        }
+        clear_pending_parent_dirs();
+
+        fsync_jobs(jobs, njobs);
+
+        /* directory sync failures are logged but not fatal, as before */
+        for (uint i = nfile_jobs; i < njobs; i++) {
+            close(jobs[i].fd);
+        }
+        for (uint i = 0; i < nfile_jobs; i++) {
+            if (jobs[i].error) {
+                ALOGE("fsync for fd=%d failed: %s\n", jobs[i].fd, strerror(jobs[i].error));
+                errno = jobs[i].error;
+                rc = -1;
+            } else {
+                fd_state[jobs[i].fd] = SS_CLEAN; /* set to clean */
+            }
+        }
+        if (rc < 0) {
+            return rc;
+        }
+    } else {
+        /* the sync() below covers every dirty fd and directory */
+        clear_pending_parent_dirs();
+        for (uint fd = 0; fd < FD_TBL_SIZE; fd++) {
+            if (fd_state[fd] == SS_DIRTY) {
+                fd_state[fd] = SS_CLEAN; /* set to clean */
             }
-            fd_state[fd] = SS_CLEAN; /* set to clean */
         }
     }
 
@@ -16,9 +16,11 @@
 
 #include "watchdog.h"
 
+#include <array>
 #include <chrono>
 #include <cstdint>
 #include <optional>
+#include <sstream>
 #include <thread>
 #include <vector>
 
@@ -85,6 +87,65 @@ std::chrono::milliseconds watcher::Elapsed(watcher::clock::time_point end) {
 
 namespace {
 
+// Log2-bucketed latencies of finished requests, per command. Logged and reset
+// every kLogInterval requests so slow media shows up in the log without
+// needing the watchdog to trip.
+class LatencyHistogram {
+  private:
+    static constexpr size_t kNumCommands = 16;
+    // Bucket i counts requests that took less than 2^i ms; the last bucket
+    // counts everything slower.
+    static constexpr size_t kNumBuckets = 12;
+    static constexpr uint32_t kLogInterval = 1000;
+
+  public:
+    void Record(uint32_t cmd, std::chrono::milliseconds elapsed);
+
+  private:
+    void Log();
+
+    std::array<std::array<uint32_t, kNumBuckets>, kNumCommands> counts_ = {};
+    uint32_t total_ = 0;
+};
+
+void LatencyHistogram::Record(uint32_t cmd, std::chrono::milliseconds elapsed) {
+    size_t index = cmd >> STORAGE_REQ_SHIFT;
+    if (index >= kNumCommands) {
+        return;
+    }
+    size_t bucket = 0;
+    while (bucket + 1 < kNumBuckets && elapsed.count() >= (1LL << bucket)) {
+        bucket++;
+    }
+    counts_[index][bucket]++;
+    if (++total_ >= kLogInterval) {
+        Log();
+    }
+}
+
+void LatencyHistogram::Log() {
+    for (size_t index = 0; index < kNumCommands; index++) {
+        const auto& buckets = counts_[index];
+        std::ostringstream line;
+        bool any = false;
+        for (size_t bucket = 0; bucket < kNumBuckets; bucket++) {
+            if (!buckets[bucket]) continue;
+            any = true;
+            if (bucket + 1 < kNumBuckets) {
+                line << " <" << (1LL << bucket) << "ms:" << buckets[bucket];
+            } else {
+                line << " >=" << (1LL << (bucket - 1)) << "ms:" << buckets[bucket];
+            }
+        }
+        if (any) {
+            LOG(INFO) << "Storageproxyd latency cmd: " << (index << STORAGE_REQ_SHIFT)
+                      << line.str();
+        }
+    }
+    counts_ = {};
+    total_ = 0;
+}
+
 class Watchdog {
   private:
     static constexpr std::chrono::milliseconds kDefaultTimeoutMs = std::chrono::milliseconds(500);
@@ -108,6 +169,9 @@ class Watchdog {
     std::thread watchdog_thread_;
     bool done_;
 
+    // Only touched by the main thread, in UnRegisterWatch.
+    LatencyHistogram latencies_;
+
     void WatchdogLoop();
     void LogWatchdogTriggerLocked();
 };
@@ -150,6 +214,7 @@ void Watchdog::UnRegisterWatch(struct watcher* watcher) {
             LOG(ERROR) << "Unregistering watcher that doesn't match current watcher";
         }
         watcher_->LogFinished();
+        latencies_.Record(watcher_->cmd_, watcher_->Elapsed(watcher::clock::now()));
         watcher_.reset(nullptr);
     }
     watcher_change_.notify_one();